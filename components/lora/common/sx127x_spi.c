@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, SX127x SPI burst transfers
+ *
+ */
+
+#include "sdkconfig.h"
+
+#if CONFIG_LUA_RTOS_LORA_HW_TYPE_SX1276 || CONFIG_LUA_RTOS_LORA_HW_TYPE_SX1272
+
+#include "esp_attr.h"
+
+#include <string.h>
+
+#include "sx127x_spi.h"
+
+void IRAM_ATTR sx127x_spi_write(sx127x_spi_t *spi, uint8_t addr, const uint8_t *data, uint8_t len) {
+	spi->select(spi->arg);
+
+	spi->tx[0] = addr | 0x80;
+	memcpy(&spi->tx[1], data, len);
+
+	spi->xfer(spi->arg, len + 1, spi->tx, NULL);
+
+	spi->deselect(spi->arg);
+}
+
+void IRAM_ATTR sx127x_spi_read(sx127x_spi_t *spi, uint8_t addr, uint8_t *data, uint8_t len) {
+	spi->select(spi->arg);
+
+	spi->tx[0] = addr & 0x7f;
+	memset(&spi->tx[1], 0x00, len);
+
+	spi->xfer(spi->arg, len + 1, spi->tx, spi->rx);
+
+	memcpy(data, &spi->rx[1], len);
+
+	spi->deselect(spi->arg);
+}
+
+void IRAM_ATTR sx127x_spi_write_reg(sx127x_spi_t *spi, uint8_t addr, uint8_t data) {
+	sx127x_spi_write(spi, addr, &data, 1);
+}
+
+uint8_t IRAM_ATTR sx127x_spi_read_reg(sx127x_spi_t *spi, uint8_t addr) {
+	uint8_t data;
+
+	sx127x_spi_read(spi, addr, &data, 1);
+
+	return data;
+}
+
+#endif
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, SX127x SPI burst transfers
+ *
+ */
+
+/*
+ * SX127x radios auto-increment the register address while NSS is low, and
+ * the FIFO register (0x00) reads / writes consecutive bytes of the FIFO. So a
+ * whole register range, or a whole FIFO, can be moved in a single SPI
+ * transaction made of the address byte followed by the data.
+ *
+ * This module builds these transactions. The bus access is done through
+ * select / transfer / deselect functions, so the same code is used with the
+ * SPI driver, or with a simulated radio. The transaction buffers are shared,
+ * so they are only used between select, that takes the bus, and deselect.
+ */
+
+#include "sdkconfig.h"
+
+#if CONFIG_LUA_RTOS_LORA_HW_TYPE_SX1276 || CONFIG_LUA_RTOS_LORA_HW_TYPE_SX1272
+
+#ifndef _SX127X_SPI_H
+#define _SX127X_SPI_H
+
+#include <stdint.h>
+
+// Max data bytes in a burst (a full FIFO)
+#define SX127X_SPI_BURST_MAX 255
+
+// Take the bus and start a transaction (NSS low)
+typedef void (*sx127x_spi_select_t)(void *arg);
+
+// Transfer len bytes in the current transaction. rx can be NULL.
+typedef void (*sx127x_spi_xfer_t)(void *arg, uint32_t len, uint8_t *tx, uint8_t *rx);
+
+// End the transaction (NSS high) and release the bus
+typedef void (*sx127x_spi_deselect_t)(void *arg);
+
+typedef struct {
+	sx127x_spi_select_t select;     // Select function
+	sx127x_spi_xfer_t xfer;         // Transfer function
+	sx127x_spi_deselect_t deselect; // Deselect function
+	void *arg;                      // Argument for the bus functions
+
+	// Transaction buffers (address + data). Word aligned, so they can be
+	// used for DMA when the structure is in internal RAM.
+	uint8_t tx[SX127X_SPI_BURST_MAX + 1] __attribute__((aligned(4)));
+	uint8_t rx[SX127X_SPI_BURST_MAX + 1] __attribute__((aligned(4)));
+} sx127x_spi_t;
+
+/**
+ * @brief Write consecutive registers, or the FIFO, in a single SPI transaction.
+ *
+ * @param spi SPI burst context.
+ * @param addr First register address.
+ * @param data Data to write.
+ * @param len Number of bytes to write.
+ */
+void sx127x_spi_write(sx127x_spi_t *spi, uint8_t addr, const uint8_t *data, uint8_t len);
+
+/**
+ * @brief Read consecutive registers, or the FIFO, in a single SPI transaction.
+ *
+ * @param spi SPI burst context.
+ * @param addr First register address.
+ * @param data Buffer to store the read data.
+ * @param len Number of bytes to read.
+ */
+void sx127x_spi_read(sx127x_spi_t *spi, uint8_t addr, uint8_t *data, uint8_t len);
+
+/**
+ * @brief Write a register.
+ */
+void sx127x_spi_write_reg(sx127x_spi_t *spi, uint8_t addr, uint8_t data);
+
+/**
+ * @brief Read a register.
+ */
+uint8_t sx127x_spi_read_reg(sx127x_spi_t *spi, uint8_t addr);
+
+#endif /* _SX127X_SPI_H */
+
+#endif
@@ -24,13 +24,19 @@ Maintainer: Michael Coracin
 #include <stdbool.h>    /* bool type */
 #include <sys/time.h>   /* timeval */
 
+#include "sdkconfig.h"
+
 #include "loragw_hal.h"
 #include "loragw_gps.h"
 
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC CONSTANTS ----------------------------------------------------- */
 
+#ifdef CONFIG_LUA_RTOS_LORA_GW_JIT_QUEUE_SIZE
+#define JIT_QUEUE_MAX           CONFIG_LUA_RTOS_LORA_GW_JIT_QUEUE_SIZE /* Maximum number of packets to be stored in JiT queue */
+#else
 #define JIT_QUEUE_MAX           32  /* Maximum number of packets to be stored in JiT queue */
+#endif
 #define JIT_NUM_BEACON_IN_QUEUE 3   /* Number of beacons to be loaded in JiT queue at any time */
 
 /* -------------------------------------------------------------------------- */
@@ -68,8 +74,12 @@ struct jit_node_s {
 };
 
 struct jit_queue_s {
-    uint8_t num_pkt;                /* Total number of packets in the queue (downlinks, beacons...) */
-    uint8_t num_beacon;             /* Number of beacons in the queue */
+    uint16_t num_pkt;               /* Total number of packets in the queue (downlinks, beacons...) */
+    uint16_t num_beacon;            /* Number of beacons in the queue */
+    uint32_t max_pre_delay;         /* Highest pre_delay of the queued packets */
+    uint32_t max_post_delay;        /* Highest post_delay of the queued packets */
+    uint16_t order[JIT_QUEUE_MAX];  /* Indexes of used nodes, in ascending order of packet timestamp */
+    uint16_t free[JIT_QUEUE_MAX];   /* Indexes of free nodes (stack) */
     struct jit_node_s nodes[JIT_QUEUE_MAX]; /* Nodes/packets array in the queue */
 };
 
@@ -101,6 +111,19 @@ This function is used to reset every elements in the allocated queue.
 */
 void jit_queue_init(struct jit_queue_s *queue);
 
+/**
+@brief Check if the transmission windows of two packets overlap
+
+@param p1_count_us[in] Timestamp of packet 1
+@param p1_pre_delay[in] Time reserved before the timestamp of packet 1
+@param p1_post_delay[in] Time reserved after the timestamp of packet 1
+@param p2_count_us[in] Timestamp of packet 2
+@param p2_pre_delay[in] Time reserved before the timestamp of packet 2
+@param p2_post_delay[in] Time reserved after the timestamp of packet 2
+@return true if packets collide, false otherwise
+*/
+bool jit_collision_test(uint32_t p1_count_us, uint32_t p1_pre_delay, uint32_t p1_post_delay, uint32_t p2_count_us, uint32_t p2_pre_delay, uint32_t p2_post_delay);
+
 /**
 @brief Add a packet in a Just-in-Time queue
 
@@ -110,6 +133,9 @@ void jit_queue_init(struct jit_queue_s *queue);
 @param pkt_type[in] Type of packet to be queued: Downlink, Beacon
 @return success if the function was able to queue the packet
 
+The queue keeps its packets in timestamp order, so the collision checks only look at
+the packets that are near the new packet's timestamp.
+
 This function is typically used when a packet is received from server for downlink.
 It will check if packet can be queued, with several criterias. Once the packet is queued, it has to be
 sent over the air. So all checks should happen before the packet being actually in the queue.
@@ -120,7 +146,7 @@ enum jit_error_e jit_enqueue(struct jit_queue_s *queue, struct timeval *time, st
 @brief Dequeue a packet from a Just-in-Time queue
 
 @param queue[in/out] Just in Time queue from which the packet should be removed
-@param index[in] in the queue where to get the packet to be removed
+@param index[in] node index in the queue where to get the packet to be removed
 @param packet[out] that was at index
 @param pkt_type[out] Type of packet dequeued: Downlink, Beacon
 @return success if the function was able to dequeue the packet
@@ -135,7 +161,7 @@ enum jit_error_e jit_dequeue(struct jit_queue_s *queue, int index, struct lgw_pk
 
 @param queue[in] Just in Time queue to parse for peeking a packet
 @param time[in] Current concentrator time
-@param pkt_idx[out] Packet index which is soon to be dequeued.
+@param pkt_idx[out] Node index of the packet which is soon to be dequeued.
 @return success if the function was able to parse the queue. pkt_idx is set to -1 if no packet found.
 
 This function is typically used to check in JiT queue if there is a packet soon to be sent.
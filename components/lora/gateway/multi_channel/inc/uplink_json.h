@@ -0,0 +1,87 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    LoRa concentrator : PUSH_DATA JSON serializer
+        Builds the rxpk and stat objects of the Semtech UDP protocol without
+        printf, using integer and fixed-point number emission. The output is
+        the same that the printf formats used before produced.
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+
+#ifndef _LORA_PKTFWD_UPLINK_JSON_H
+#define _LORA_PKTFWD_UPLINK_JSON_H
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdint.h>     /* C99 types */
+#include <time.h>       /* timespec */
+
+#include "loragw_hal.h"
+#include "loragw_gps.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC CONSTANTS ----------------------------------------------------- */
+
+#define UPLINK_JSON_RXPK_SIZE   540     /* Maximum size of a rxpk object, with the null char */
+#define UPLINK_JSON_STAT_SIZE   160     /* Maximum size of a stat object, with the null char, without the time string */
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC TYPES --------------------------------------------------------- */
+
+struct uplink_json_stat_s {
+    const char *time;               /* Report time, as a string */
+    const struct coord_s *coord;    /* Gateway coordinates, NULL if unknown */
+    uint32_t rxnb;                  /* Number of radio packets received */
+    uint32_t rxok;                  /* Number of radio packets received with a valid CRC */
+    uint32_t rxfw;                  /* Number of radio packets forwarded */
+    double ackr;                    /* Percentage of upstream datagrams that were acknowledged */
+    uint32_t dwnb;                  /* Number of downlink datagrams received */
+    uint32_t txnb;                  /* Number of packets emitted */
+};
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS PROTOTYPES ------------------------------------------ */
+
+/**
+@brief Write a number with a fixed number of decimals, as printf("%.<decimals>f") does
+
+@param out pointer to a string where the function will write the number (at least 32 chars)
+@param value number to write
+@param decimals number of decimals (0 to 6)
+@return length of the resulting string (w/o null char)
+*/
+int uplink_json_fixed(char *out, double value, int decimals);
+
+/**
+@brief Serialize a received packet as a rxpk JSON object
+
+@param out pointer to a string where the function will write the object
+@param max_len max length of the out string (including null char)
+@param p received packet
+@param utc packet RX time (GPS based), NULL if not available
+@return >0 length of the resulting string (w/o null char), -1 for error
+*/
+int uplink_json_rxpk(char *out, int max_len, const struct lgw_pkt_rx_s *p, const struct timespec *utc);
+
+/**
+@brief Serialize a status report as a stat JSON member
+
+@param out pointer to a string where the function will write the report
+@param max_len max length of the out string (including null char)
+@param stat status report
+@return >0 length of the resulting string (w/o null char), -1 for error
+*/
+int uplink_json_stat(char *out, int max_len, const struct uplink_json_stat_s *stat);
+
+#endif
+
+/* --- EOF ------------------------------------------------------------------ */
@@ -62,12 +62,11 @@ uint8_t char_to_code(char x);
 /* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
 
 char code_to_char(uint8_t x) {
-    if (x <= 25) {
-        return 'A' + x;
-    } else if ((x >= 26) && (x <= 51)) {
-        return 'a' + (x-26);
-    } else if ((x >= 52) && (x <= 61)) {
-        return '0' + (x-52);
+    /* RFC 1421 characters for codes 0 to 63, looked up instead of compared range by range */
+    static const char code_table[64] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    if (x <= 61) {
+        return code_table[x];
     } else if (x == 62) {
         return code_62;
     } else if (x == 63) {
@@ -20,8 +20,7 @@ Maintainer: Michael Coracin
 
 #if CONFIG_LUA_RTOS_LORA_HW_TYPE_SX1301
 
-#define _GNU_SOURCE     /* needed for qsort_r to be defined */
-#include <stdlib.h>     /* qsort_r */
+#include <stdlib.h>
 #include <stdio.h>      /* printf, fprintf, snprintf, fopen, fputs */
 #include <string.h>     /* memset, memcpy */
 #include <pthread.h>
@@ -36,6 +35,13 @@ Maintainer: Michael Coracin
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE MACROS ------------------------------------------------------- */
 
+/* Timestamp ordering, handling the roll-over of the 32 bits concentrator counter.
+ * Valid while all the compared timestamps are less than 2^31 us apart, that is
+ * granted because enqueued packets are never more than TX_MAX_ADVANCE_DELAY in
+ * advance of the current time.
+ */
+#define JIT_BEFORE(a, b)        ((int32_t)((uint32_t)(a) - (uint32_t)(b)) < 0)
+
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE CONSTANTS & TYPES -------------------------------------------- */
 #define TX_START_DELAY          1500    /* microseconds */
@@ -56,6 +62,150 @@ static pthread_mutex_t mx_jit_queue = PTHREAD_MUTEX_INITIALIZER; /* control acce
 /* -------------------------------------------------------------------------- */
 /* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
 
+/* Position in queue->order of the first packet with a timestamp not before count_us */
+static int jit_lower_bound(struct jit_queue_s *queue, uint32_t count_us) {
+    int low = 0;
+    int high = queue->num_pkt;
+    int mid;
+
+    while (low < high) {
+        mid = (low + high) / 2;
+        if (JIT_BEFORE(queue->nodes[queue->order[mid]].pkt.count_us, count_us)) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+/* Position in queue->order of a node, -1 if the node is not in use */
+static int jit_position(struct jit_queue_s *queue, int index) {
+    int pos;
+
+    for (pos = jit_lower_bound(queue, queue->nodes[index].pkt.count_us); pos < queue->num_pkt; pos++) {
+        if (queue->order[pos] == index) {
+            return pos;
+        }
+
+        if (queue->nodes[queue->order[pos]].pkt.count_us != queue->nodes[index].pkt.count_us) {
+            break;
+        }
+    }
+
+    return -1;
+}
+
+/* Index of the first enqueued node colliding with a packet, -1 if there are no collisions.
+ * Only the nodes with a timestamp in the window [count_us - pre_delay - max_post_delay - margin,
+ * count_us + post_delay + max_pre_delay + margin] can collide, and this window is found with a
+ * binary search on the ordered nodes.
+ */
+static int jit_collision_find(struct jit_queue_s *queue, uint32_t count_us, uint32_t pre_delay, uint32_t post_delay, enum jit_pkt_type_e pkt_type) {
+    uint32_t window_start = count_us - (pre_delay + queue->max_post_delay + TX_MARGIN_DELAY);
+    uint32_t window_end = count_us + (post_delay + queue->max_pre_delay + TX_MARGIN_DELAY);
+    uint32_t target_pre_delay;
+    struct jit_node_s *node;
+    int pos;
+
+    for (pos = jit_lower_bound(queue, window_start); pos < queue->num_pkt; pos++) {
+        node = &queue->nodes[queue->order[pos]];
+
+        if (JIT_BEFORE(window_end, node->pkt.count_us)) {
+            break;
+        }
+
+        /* We ignore Beacon Guard for Class A/C downlinks */
+        if (((pkt_type == JIT_PKT_TYPE_DOWNLINK_CLASS_A) || (pkt_type == JIT_PKT_TYPE_DOWNLINK_CLASS_C)) && (node->pkt_type == JIT_PKT_TYPE_BEACON)) {
+            target_pre_delay = TX_START_DELAY;
+        } else {
+            target_pre_delay = node->pre_delay;
+        }
+
+        /* Check if there is a collision
+         *  Warning: unsigned arithmetic (handle roll-over)
+         *      t_packet_new - pre_delay_packet_new < t_packet_prev + post_delay_packet_prev (OVERLAP on post delay)
+         *      t_packet_new + post_delay_packet_new > t_packet_prev - pre_delay_packet_prev (OVERLAP on pre delay)
+         */
+        if (jit_collision_test(count_us, pre_delay, post_delay, node->pkt.count_us, target_pre_delay, node->post_delay) == true) {
+            return queue->order[pos];
+        }
+    }
+
+    return -1;
+}
+
+/* Insert a packet in a free node, keeping the timestamp order */
+static void jit_insert(struct jit_queue_s *queue, struct lgw_pkt_tx_s *packet, enum jit_pkt_type_e pkt_type, uint32_t pre_delay, uint32_t post_delay) {
+    int index = queue->free[JIT_QUEUE_MAX - 1 - queue->num_pkt];
+    int pos = jit_lower_bound(queue, packet->count_us);
+
+    memcpy(&(queue->nodes[index].pkt), packet, sizeof(struct lgw_pkt_tx_s));
+    queue->nodes[index].pre_delay = pre_delay;
+    queue->nodes[index].post_delay = post_delay;
+    queue->nodes[index].pkt_type = pkt_type;
+
+    memmove(&queue->order[pos + 1], &queue->order[pos], (queue->num_pkt - pos) * sizeof(queue->order[0]));
+    queue->order[pos] = index;
+
+    if (pkt_type == JIT_PKT_TYPE_BEACON) {
+        queue->num_beacon++;
+    }
+    queue->num_pkt++;
+
+    if (pre_delay > queue->max_pre_delay) {
+        queue->max_pre_delay = pre_delay;
+    }
+    if (post_delay > queue->max_post_delay) {
+        queue->max_post_delay = post_delay;
+    }
+}
+
+/* Remove the packet at a position of the timestamp order, and free it's node */
+static void jit_remove(struct jit_queue_s *queue, int pos) {
+    int index = queue->order[pos];
+    struct jit_node_s *node = &queue->nodes[index];
+    int i;
+
+    memmove(&queue->order[pos], &queue->order[pos + 1], (queue->num_pkt - pos - 1) * sizeof(queue->order[0]));
+
+    queue->num_pkt--;
+    queue->free[JIT_QUEUE_MAX - 1 - queue->num_pkt] = index;
+    if (node->pkt_type == JIT_PKT_TYPE_BEACON) {
+        queue->num_beacon--;
+    }
+
+    /* Update the collision window bounds */
+    if ((node->pre_delay == queue->max_pre_delay) || (node->post_delay == queue->max_post_delay)) {
+        queue->max_pre_delay = 0;
+        queue->max_post_delay = 0;
+        for (i=0; i<queue->num_pkt; i++) {
+            if (queue->nodes[queue->order[i]].pre_delay > queue->max_pre_delay) {
+                queue->max_pre_delay = queue->nodes[queue->order[i]].pre_delay;
+            }
+            if (queue->nodes[queue->order[i]].post_delay > queue->max_post_delay) {
+                queue->max_post_delay = queue->nodes[queue->order[i]].post_delay;
+            }
+        }
+    }
+
+    memset(node, 0, sizeof(struct jit_node_s));
+}
+
+/* Drop a packet that was missed for peeking */
+static void jit_drop(struct jit_queue_s *queue, int pos, uint32_t time_us) {
+    struct jit_node_s *node = &queue->nodes[queue->order[pos]];
+
+    if (node->pkt_type == JIT_PKT_TYPE_BEACON) {
+        MSG("WARNING: --- Beacon dropped (current_time=%u, packet_time=%u) ---\n", time_us, node->pkt.count_us);
+    } else {
+        MSG("WARNING: --- Packet dropped (current_time=%u, packet_time=%u) ---\n", time_us, node->pkt.count_us);
+    }
+
+    jit_remove(queue, pos);
+}
+
 /* -------------------------------------------------------------------------- */
 /* --- PUBLIC FUNCTIONS DEFINITION ----------------------------------------- */
 
@@ -92,40 +242,12 @@ void jit_queue_init(struct jit_queue_s *queue) {
     for (i=0; i<JIT_QUEUE_MAX; i++) {
         queue->nodes[i].pre_delay = 0;
         queue->nodes[i].post_delay = 0;
-    }
 
-    pthread_mutex_unlock(&mx_jit_queue);
-}
-
-#if 0
-int compare(const void *a, const void *b, void *arg)
-{
-    struct jit_node_s *p = (struct jit_node_s *)a;
-    struct jit_node_s *q = (struct jit_node_s *)b;
-    int *counter = (int *)arg;
-    int p_count, q_count;
-
-    p_count = p->pkt.count_us;
-    q_count = q->pkt.count_us;
-
-    if (p_count > q_count)
-        *counter = *counter + 1;
-
-    return p_count - q_count;
-}
-#endif
-
-void jit_sort_queue(struct jit_queue_s *queue) {
-    int counter = 0;
-
-    if (queue->num_pkt == 0) {
-        return;
+        /* All nodes are free, node 0 is the first to be used */
+        queue->free[i] = JIT_QUEUE_MAX - 1 - i;
     }
 
-    MSG_DEBUG(DEBUG_JIT, "sorting queue in ascending order packet timestamp - queue size:%u\n", queue->num_pkt);
-    // TO DO
-    //qsort_r(queue->nodes, queue->num_pkt, sizeof(queue->nodes[0]), compare, &counter);
-    MSG_DEBUG(DEBUG_JIT, "sorting queue done - swapped:%d\n", counter);
+    pthread_mutex_unlock(&mx_jit_queue);
 }
 
 bool jit_collision_test(uint32_t p1_count_us, uint32_t p1_pre_delay, uint32_t p1_post_delay, uint32_t p2_count_us, uint32_t p2_pre_delay, uint32_t p2_post_delay) {
@@ -139,12 +261,13 @@ bool jit_collision_test(uint32_t p1_count_us, uint32_t p1_pre_delay, uint32_t p1
 
 enum jit_error_e jit_enqueue(struct jit_queue_s *queue, struct timeval *time, struct lgw_pkt_tx_s *packet, enum jit_pkt_type_e pkt_type) {
     int i = 0;
+    int collision;
     uint32_t time_us = time->tv_sec * 1000000UL + time->tv_usec; /* convert time in µs */
     uint32_t packet_post_delay = 0;
     uint32_t packet_pre_delay = 0;
-    uint32_t target_pre_delay = 0;
     enum jit_error_e err_collision = JIT_ERROR_OK;
     uint32_t asap_count_us;
+    struct jit_node_s *node;
 
     MSG_DEBUG(DEBUG_JIT, "Current concentrator time is %u, pkt_type=%d\n", time_us, pkt_type);
 
@@ -196,26 +319,24 @@ enum jit_error_e jit_enqueue(struct jit_queue_s *queue, struct timeval *time, st
             */
 
             /* First, try if the ASAP time collides with an already enqueued downlink */
-            for (i=0; i<queue->num_pkt; i++) {
-                if (jit_collision_test(asap_count_us, packet_pre_delay, packet_post_delay, queue->nodes[i].pkt.count_us, queue->nodes[i].pre_delay, queue->nodes[i].post_delay) == true) {
-                    MSG_DEBUG(DEBUG_JIT, "DEBUG: cannot insert IMMEDIATE downlink at count_us=%u, collides with %u (index=%d)\n", asap_count_us, queue->nodes[i].pkt.count_us, i);
-                    break;
-                }
-            }
-            if (i == queue->num_pkt) {
+            collision = jit_collision_find(queue, asap_count_us, packet_pre_delay, packet_post_delay, pkt_type);
+            if (collision < 0) {
                 /* No collision with ASAP time, we can insert it */
                 MSG_DEBUG(DEBUG_JIT, "DEBUG: insert IMMEDIATE downlink ASAP at %u (no collision)\n", asap_count_us);
             } else {
-                /* Search for the best slot then */
+                MSG_DEBUG(DEBUG_JIT, "DEBUG: cannot insert IMMEDIATE downlink at count_us=%u, collides with %u (index=%d)\n", asap_count_us, queue->nodes[collision].pkt.count_us, collision);
+
+                /* Search for the best slot then, just after each enqueued packet, in timestamp order */
                 for (i=0; i<queue->num_pkt; i++) {
-                    asap_count_us = queue->nodes[i].pkt.count_us + queue->nodes[i].post_delay + packet_pre_delay + TX_JIT_DELAY + TX_MARGIN_DELAY;
+                    node = &queue->nodes[queue->order[i]];
+                    asap_count_us = node->pkt.count_us + node->post_delay + packet_pre_delay + TX_JIT_DELAY + TX_MARGIN_DELAY;
                     if (i == (queue->num_pkt - 1)) {
                         /* Last packet index, we can insert after this one */
                         MSG_DEBUG(DEBUG_JIT, "DEBUG: insert IMMEDIATE downlink, last in JiT queue (count_us=%u)\n", asap_count_us);
                     } else {
-                        /* Check if packet can be inserted between this index and the next one */
-                        MSG_DEBUG(DEBUG_JIT, "DEBUG: try to insert IMMEDIATE downlink (count_us=%u) between index %d and index %d?\n", asap_count_us, i, i+1);
-                        if (jit_collision_test(asap_count_us, packet_pre_delay, packet_post_delay, queue->nodes[i+1].pkt.count_us, queue->nodes[i+1].pre_delay, queue->nodes[i+1].post_delay) == true) {
+                        /* Check if packet can be inserted after this packet */
+                        MSG_DEBUG(DEBUG_JIT, "DEBUG: try to insert IMMEDIATE downlink (count_us=%u) after position %d?\n", asap_count_us, i);
+                        if (jit_collision_find(queue, asap_count_us, packet_pre_delay, packet_post_delay, pkt_type) >= 0) {
                             MSG_DEBUG(DEBUG_JIT, "DEBUG: failed to insert IMMEDIATE downlink (count_us=%u), continue...\n", asap_count_us);
                             continue;
                         } else {
@@ -268,56 +389,33 @@ enum jit_error_e jit_enqueue(struct jit_queue_s *queue, struct timeval *time, st
      *        - Valid for both Downlinks and beacon packets
      *        - Beacon guard can be ignored if we try to queue a Class A downlink
      */
-    for (i=0; i<queue->num_pkt; i++) {
-        /* We ignore Beacon Guard for Class A/C downlinks */
-        if (((pkt_type == JIT_PKT_TYPE_DOWNLINK_CLASS_A) || (pkt_type == JIT_PKT_TYPE_DOWNLINK_CLASS_C)) && (queue->nodes[i].pkt_type == JIT_PKT_TYPE_BEACON)) {
-            target_pre_delay = TX_START_DELAY;
-        } else {
-            target_pre_delay = queue->nodes[i].pre_delay;
-        }
-
-        /* Check if there is a collision
-         *  Warning: unsigned arithmetic (handle roll-over)
-         *      t_packet_new - pre_delay_packet_new < t_packet_prev + post_delay_packet_prev (OVERLAP on post delay)
-         *      t_packet_new + post_delay_packet_new > t_packet_prev - pre_delay_packet_prev (OVERLAP on pre delay)
-         */
-        if (jit_collision_test(packet->count_us, packet_pre_delay, packet_post_delay, queue->nodes[i].pkt.count_us, target_pre_delay, queue->nodes[i].post_delay) == true) {
-            switch (queue->nodes[i].pkt_type) {
-                case JIT_PKT_TYPE_DOWNLINK_CLASS_A:
-                case JIT_PKT_TYPE_DOWNLINK_CLASS_B:
-                case JIT_PKT_TYPE_DOWNLINK_CLASS_C:
-                    MSG_DEBUG(DEBUG_JIT_ERROR, "ERROR: Packet (type=%d) REJECTED, collision with packet already programmed at %u (%u)\n", pkt_type, queue->nodes[i].pkt.count_us, packet->count_us);
-                    err_collision = JIT_ERROR_COLLISION_PACKET;
-                    break;
-                case JIT_PKT_TYPE_BEACON:
-                    if (pkt_type != JIT_PKT_TYPE_BEACON) {
-                        /* do not overload logs for beacon/beacon collision, as it is expected to happen with beacon pre-scheduling algorith used */
-                        MSG_DEBUG(DEBUG_JIT_ERROR, "ERROR: Packet (type=%d) REJECTED, collision with beacon already programmed at %u (%u)\n", pkt_type, queue->nodes[i].pkt.count_us, packet->count_us);
-                    }
-                    err_collision = JIT_ERROR_COLLISION_BEACON;
-                    break;
-                default:
-                    MSG("ERROR: Unknown packet type, should not occur, BUG?\n");
-                    assert(0);
-                    break;
-            }
-            pthread_mutex_unlock(&mx_jit_queue);
-            return err_collision;
+    collision = jit_collision_find(queue, packet->count_us, packet_pre_delay, packet_post_delay, pkt_type);
+    if (collision >= 0) {
+        switch (queue->nodes[collision].pkt_type) {
+            case JIT_PKT_TYPE_DOWNLINK_CLASS_A:
+            case JIT_PKT_TYPE_DOWNLINK_CLASS_B:
+            case JIT_PKT_TYPE_DOWNLINK_CLASS_C:
+                MSG_DEBUG(DEBUG_JIT_ERROR, "ERROR: Packet (type=%d) REJECTED, collision with packet already programmed at %u (%u)\n", pkt_type, queue->nodes[collision].pkt.count_us, packet->count_us);
+                err_collision = JIT_ERROR_COLLISION_PACKET;
+                break;
+            case JIT_PKT_TYPE_BEACON:
+                if (pkt_type != JIT_PKT_TYPE_BEACON) {
+                    /* do not overload logs for beacon/beacon collision, as it is expected to happen with beacon pre-scheduling algorith used */
+                    MSG_DEBUG(DEBUG_JIT_ERROR, "ERROR: Packet (type=%d) REJECTED, collision with beacon already programmed at %u (%u)\n", pkt_type, queue->nodes[collision].pkt.count_us, packet->count_us);
+                }
+                err_collision = JIT_ERROR_COLLISION_BEACON;
+                break;
+            default:
+                MSG("ERROR: Unknown packet type, should not occur, BUG?\n");
+                assert(0);
+                break;
         }
+        pthread_mutex_unlock(&mx_jit_queue);
+        return err_collision;
     }
 
-    /* Finally enqueue it */
-    /* Insert packet at the end of the queue */
-    memcpy(&(queue->nodes[queue->num_pkt].pkt), packet, sizeof(struct lgw_pkt_tx_s));
-    queue->nodes[queue->num_pkt].pre_delay = packet_pre_delay;
-    queue->nodes[queue->num_pkt].post_delay = packet_post_delay;
-    queue->nodes[queue->num_pkt].pkt_type = pkt_type;
-    if (pkt_type == JIT_PKT_TYPE_BEACON) {
-        queue->num_beacon++;
-    }
-    queue->num_pkt++;
-    /* Sort the queue in ascending order of packet timestamp */
-    jit_sort_queue(queue);
+    /* Finally enqueue it, in ascending order of packet timestamp */
+    jit_insert(queue, packet, pkt_type, packet_pre_delay, packet_post_delay);
 
     /* Done */
     pthread_mutex_unlock(&mx_jit_queue);
@@ -330,6 +428,8 @@ enum jit_error_e jit_enqueue(struct jit_queue_s *queue, struct timeval *time, st
 }
 
 enum jit_error_e jit_dequeue(struct jit_queue_s *queue, int index, struct lgw_pkt_tx_s *packet, enum jit_pkt_type_e *pkt_type) {
+    int pos;
+
     if (packet == NULL) {
         MSG("ERROR: invalid parameter\n");
         return JIT_ERROR_INVALID;
@@ -347,21 +447,21 @@ enum jit_error_e jit_dequeue(struct jit_queue_s *queue, int index, struct lgw_pk
 
     pthread_mutex_lock(&mx_jit_queue);
 
+    pos = jit_position(queue, index);
+    if (pos < 0) {
+        pthread_mutex_unlock(&mx_jit_queue);
+        MSG("ERROR: invalid parameter\n");
+        return JIT_ERROR_INVALID;
+    }
+
     /* Dequeue requested packet */
     memcpy(packet, &(queue->nodes[index].pkt), sizeof(struct lgw_pkt_tx_s));
-    queue->num_pkt--;
     *pkt_type = queue->nodes[index].pkt_type;
     if (*pkt_type == JIT_PKT_TYPE_BEACON) {
-        queue->num_beacon--;
         MSG_DEBUG(DEBUG_BEACON, "--- Beacon dequeued ---\n");
     }
 
-    /* Replace dequeued packet with last packet of the queue */
-    memcpy(&(queue->nodes[index]), &(queue->nodes[queue->num_pkt]), sizeof(struct jit_node_s));
-    memset(&(queue->nodes[queue->num_pkt]), 0, sizeof(struct jit_node_s));
-
-    /* Sort queue in ascending order of packet timestamp */
-    jit_sort_queue(queue);
+    jit_remove(queue, pos);
 
     /* Done */
     pthread_mutex_unlock(&mx_jit_queue);
@@ -375,9 +475,8 @@ enum jit_error_e jit_dequeue(struct jit_queue_s *queue, int index, struct lgw_pk
 
 enum jit_error_e jit_peek(struct jit_queue_s *queue, struct timeval *time, int *pkt_idx) {
     /* Return index of node containing a packet inline with given time */
-    int i = 0;
-    int idx_highest_priority = -1;
     uint32_t time_us;
+    struct jit_node_s *node;
 
     if ((time == NULL) || (pkt_idx == NULL)) {
         MSG("ERROR: invalid parameter\n");
@@ -392,54 +491,41 @@ enum jit_error_e jit_peek(struct jit_queue_s *queue, struct timeval *time, int *
 
     pthread_mutex_lock(&mx_jit_queue);
 
-    /* Search for highest priority packet to be sent */
-    for (i=0; i<queue->num_pkt; i++) {
-        /* First check if that packet is outdated:
-         *  If a packet seems too much in advance, and was not rejected at enqueue time,
-         *  it means that we missed it for peeking, we need to drop it
-         *
-         *  Warning: unsigned arithmetic
-         *      t_packet > t_current + TX_MAX_ADVANCE_DELAY
-         */
-        if ((queue->nodes[i].pkt.count_us - time_us) >= TX_MAX_ADVANCE_DELAY) {
-            /* We drop the packet to avoid lock-up */
-            queue->num_pkt--;
-            if (queue->nodes[i].pkt_type == JIT_PKT_TYPE_BEACON) {
-                queue->num_beacon--;
-                MSG("WARNING: --- Beacon dropped (current_time=%u, packet_time=%u) ---\n", time_us, queue->nodes[i].pkt.count_us);
-            } else {
-                MSG("WARNING: --- Packet dropped (current_time=%u, packet_time=%u) ---\n", time_us, queue->nodes[i].pkt.count_us);
-            }
-
-            /* Replace dropped packet with last packet of the queue */
-            memcpy(&(queue->nodes[i]), &(queue->nodes[queue->num_pkt]), sizeof(struct jit_node_s));
-            memset(&(queue->nodes[queue->num_pkt]), 0, sizeof(struct jit_node_s));
-
-            /* Sort queue in ascending order of packet timestamp */
-            jit_sort_queue(queue);
+    /* First drop the outdated packets:
+     *  If a packet seems too much in advance, and was not rejected at enqueue time,
+     *  it means that we missed it for peeking, we need to drop it
+     *
+     *  Warning: unsigned arithmetic
+     *      t_packet > t_current + TX_MAX_ADVANCE_DELAY
+     *
+     *  Missed packets are before the current time, so they are at the start of the
+     *  timestamp order, and packets too much in advance are at the end.
+     */
+    while ((queue->num_pkt > 0) && ((queue->nodes[queue->order[0]].pkt.count_us - time_us) >= TX_MAX_ADVANCE_DELAY)) {
+        jit_drop(queue, 0, time_us);
+    }
 
-            /* restart loop  after purge to find packet to be sent */
-            i = 0;
-            continue;
-        }
+    while ((queue->num_pkt > 0) && ((queue->nodes[queue->order[queue->num_pkt - 1]].pkt.count_us - time_us) >= TX_MAX_ADVANCE_DELAY)) {
+        jit_drop(queue, queue->num_pkt - 1, time_us);
+    }
 
-        /* Then look for highest priority packet to be sent:
-         *  Warning: unsigned arithmetic (handle roll-over)
-         *      t_packet < t_highest
-         */
-        if ((idx_highest_priority == -1) || (((queue->nodes[i].pkt.count_us - time_us) < (queue->nodes[idx_highest_priority].pkt.count_us - time_us)))) {
-            idx_highest_priority = i;
-        }
+    if (queue->num_pkt == 0) {
+        *pkt_idx = -1;
+        pthread_mutex_unlock(&mx_jit_queue);
+        return JIT_ERROR_OK;
     }
 
+    /* The highest priority packet to be sent is the first in timestamp order */
+    node = &queue->nodes[queue->order[0]];
+
     /* Peek criteria 1: look for a packet to be sent in next TX_JIT_DELAY ms timeframe
      *  Warning: unsigned arithmetic (handle roll-over)
      *      t_packet < t_current + TX_JIT_DELAY
      */
-    if ((queue->nodes[idx_highest_priority].pkt.count_us - time_us) < TX_JIT_DELAY) {
-        *pkt_idx = idx_highest_priority;
+    if ((node->pkt.count_us - time_us) < TX_JIT_DELAY) {
+        *pkt_idx = queue->order[0];
         MSG_DEBUG(DEBUG_JIT, "peek packet with count_us=%u at index %d\n",
-            queue->nodes[idx_highest_priority].pkt.count_us, idx_highest_priority);
+            node->pkt.count_us, queue->order[0]);
     } else {
         *pkt_idx = -1;
     }
@@ -451,7 +537,6 @@ enum jit_error_e jit_peek(struct jit_queue_s *queue, struct timeval *time, int *
 
 void jit_print_queue(struct jit_queue_s *queue, bool show_all, int debug_level) {
     int i = 0;
-    int loop_end;
 
     if (jit_queue_is_empty(queue)) {
         MSG_DEBUG(debug_level, "INFO: [jit] queue is empty\n");
@@ -460,12 +545,20 @@ void jit_print_queue(struct jit_queue_s *queue, bool show_all, int debug_level)
 
         MSG_DEBUG(debug_level, "INFO: [jit] queue contains %d packets:\n", queue->num_pkt);
         MSG_DEBUG(debug_level, "INFO: [jit] queue contains %d beacons:\n", queue->num_beacon);
-        loop_end = (show_all == true) ? JIT_QUEUE_MAX : queue->num_pkt;
-        for (i=0; i<loop_end; i++) {
-            MSG_DEBUG(debug_level, " - node[%d]: count_us=%u - type=%d\n",
-                        i,
-                        queue->nodes[i].pkt.count_us,
-                        queue->nodes[i].pkt_type);
+        if (show_all == true) {
+            for (i=0; i<JIT_QUEUE_MAX; i++) {
+                MSG_DEBUG(debug_level, " - node[%d]: count_us=%u - type=%d\n",
+                            i,
+                            queue->nodes[i].pkt.count_us,
+                            queue->nodes[i].pkt_type);
+            }
+        } else {
+            for (i=0; i<queue->num_pkt; i++) {
+                MSG_DEBUG(debug_level, " - node[%d]: count_us=%u - type=%d\n",
+                            queue->order[i],
+                            queue->nodes[queue->order[i]].pkt.count_us,
+                            queue->nodes[queue->order[i]].pkt_type);
+            }
         }
 
         pthread_mutex_unlock(&mx_jit_queue);
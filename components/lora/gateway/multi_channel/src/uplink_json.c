@@ -0,0 +1,370 @@
+/*
+ / _____)             _              | |
+( (____  _____ ____ _| |_ _____  ____| |__
+ \____ \| ___ |    (_   _) ___ |/ ___)  _ \
+ _____) ) ____| | | || |_| ____( (___| | | |
+(______/|_____)_|_|_| \__)_____)\____)_| |_|
+  (C)2013 Semtech-Cycleo
+
+Description:
+    LoRa concentrator : PUSH_DATA JSON serializer
+
+License: Revised BSD License, see LICENSE.TXT file include in the project
+*/
+
+#include "sdkconfig.h"
+
+#if CONFIG_LUA_RTOS_LORA_HW_TYPE_SX1301
+
+/* -------------------------------------------------------------------------- */
+/* --- DEPENDANCIES --------------------------------------------------------- */
+
+#include <stdio.h>      /* snprintf */
+#include <stdint.h>     /* C99 types */
+#include <string.h>     /* memcpy, strlen */
+
+#include "base64.h"
+#include "uplink_json.h"
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE MACROS ------------------------------------------------------- */
+
+/* Copy a constant key fragment, and advance the output pointer */
+#define PUT_STR(o, s)   do { memcpy((o), (s), sizeof(s) - 1); (o) += sizeof(s) - 1; } while (0)
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE CONSTANTS ---------------------------------------------------- */
+
+static const uint32_t pow10[] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+
+/* -------------------------------------------------------------------------- */
+/* --- PRIVATE FUNCTIONS DEFINITION ----------------------------------------- */
+
+/* Write an unsigned integer, as printf("%u") does */
+static char *put_uint(char *out, uint32_t value) {
+    char digits[10];
+    int n = 0;
+
+    do {
+        digits[n++] = '0' + (value % 10);
+        value /= 10;
+    } while (value);
+
+    while (n) {
+        *out++ = digits[--n];
+    }
+
+    return out;
+}
+
+/* Write a signed integer, as printf("%i") does */
+static char *put_int(char *out, int32_t value) {
+    if (value < 0) {
+        *out++ = '-';
+        return put_uint(out, -(uint32_t)value);
+    }
+
+    return put_uint(out, value);
+}
+
+/* Write an unsigned integer with leading zeros, as printf("%0<width>u") does */
+static char *put_uint_pad(char *out, uint32_t value, int width) {
+    int i;
+
+    for (i=width-1; i>=0; i--) {
+        out[i] = '0' + (value % 10);
+        value /= 10;
+    }
+
+    return out + width;
+}
+
+/* Convert a number of days since 1970-01-01 to a civil date (proleptic Gregorian calendar) */
+static void civil_from_days(int32_t days, int32_t *year, uint32_t *month, uint32_t *day) {
+    int32_t era;
+    uint32_t doe, yoe, doy, mp;
+
+    days += 719468;
+    era = ((days >= 0) ? days : (days - 146096)) / 146097;
+    doe = (uint32_t)(days - era * 146097);
+    yoe = (doe - doe/1460 + doe/36524 - doe/146096) / 365;
+    doy = doe - (365*yoe + yoe/4 - yoe/100);
+    mp = (5*doy + 2) / 153;
+
+    *day = doy - (153*mp + 2)/5 + 1;
+    *month = (mp < 10) ? (mp + 3) : (mp - 9);
+    *year = (int32_t)yoe + era * 400 + (*month <= 2);
+}
+
+/* Write an UTC time in ISO 8601 format, with microseconds */
+static char *put_time(char *out, const struct timespec *utc) {
+    int64_t sec = utc->tv_sec;
+    int32_t days, year;
+    uint32_t sod, month, day;
+
+    days = (int32_t)(sec / 86400);
+    if ((sec % 86400) < 0) {
+        days--;
+    }
+    sod = (uint32_t)(sec - (int64_t)days * 86400);
+
+    civil_from_days(days, &year, &month, &day);
+
+    out = put_uint_pad(out, year, 4);
+    *out++ = '-';
+    out = put_uint_pad(out, month, 2);
+    *out++ = '-';
+    out = put_uint_pad(out, day, 2);
+    *out++ = 'T';
+    out = put_uint_pad(out, sod / 3600, 2);
+    *out++ = ':';
+    out = put_uint_pad(out, (sod / 60) % 60, 2);
+    *out++ = ':';
+    out = put_uint_pad(out, sod % 60, 2);
+    *out++ = '.';
+    out = put_uint_pad(out, utc->tv_nsec / 1000, 6);
+    *out++ = 'Z';
+
+    return out;
+}
+
+/* -------------------------------------------------------------------------- */
+/* --- PUBLIC FUNCTIONS DEFINITION ------------------------------------------ */
+
+int uplink_json_fixed(char *out, double value, int decimals) {
+    union {
+        double d;
+        uint64_t u;
+    } bits;
+    uint64_t mant, lo_part, hi_part, lo, hi, q;
+    int exp, shift, round_bit, sticky;
+    char *start = out;
+
+    bits.d = value;
+    exp = (bits.u >> 52) & 0x7ff;
+    mant = bits.u & ((1ULL << 52) - 1);
+
+    /* Not a number, infinite, or too big for the fixed-point path */
+    if ((exp >= 1023 + 40) || (decimals < 0) || (decimals > 6)) {
+        int n = snprintf(out, 32, "%.*f", decimals, value);
+        return (n < 32) ? n : 31;
+    }
+
+    /* value = mant * 2^exp */
+    if (exp == 0) {
+        exp = -1074;
+    } else {
+        mant |= (1ULL << 52);
+        exp -= 1075;
+    }
+
+    /* 128 bits product: mant * 10^decimals = hi * 2^64 + lo */
+    lo_part = (mant & 0xffffffff) * pow10[decimals];
+    hi_part = (mant >> 32) * pow10[decimals];
+    lo = lo_part + (hi_part << 32);
+    hi = (hi_part >> 32) + (lo < lo_part);
+
+    if (exp >= 0) {
+        /* Integer, value * 10^decimals is less than 2^60 */
+        q = lo << exp;
+    } else {
+        /* Shift right, rounding half to even as printf does */
+        shift = -exp;
+        if (shift >= 128) {
+            q = 0;
+            round_bit = 0;
+            sticky = 1;
+        } else if (shift > 64) {
+            q = hi >> (shift - 64);
+            round_bit = (hi >> (shift - 65)) & 1;
+            sticky = (lo != 0) || ((hi & ((1ULL << (shift - 65)) - 1)) != 0);
+        } else if (shift == 64) {
+            q = hi;
+            round_bit = lo >> 63;
+            sticky = (lo & ((1ULL << 63) - 1)) != 0;
+        } else {
+            q = (lo >> shift) | (hi << (64 - shift));
+            round_bit = (lo >> (shift - 1)) & 1;
+            sticky = (lo & ((1ULL << (shift - 1)) - 1)) != 0;
+        }
+
+        if (round_bit && (sticky || (q & 1))) {
+            q++;
+        }
+    }
+
+    if (bits.u >> 63) {
+        *out++ = '-';
+    }
+
+    /* Integer part, then decimals */
+    if ((q / pow10[decimals]) > 0xffffffff) {
+        out += sprintf(out, "%llu", (unsigned long long)(q / pow10[decimals]));
+    } else {
+        out = put_uint(out, (uint32_t)(q / pow10[decimals]));
+    }
+
+    if (decimals > 0) {
+        *out++ = '.';
+        out = put_uint_pad(out, (uint32_t)(q % pow10[decimals]), decimals);
+    }
+
+    *out = 0;
+
+    return out - start;
+}
+
+int uplink_json_rxpk(char *out, int max_len, const struct lgw_pkt_rx_s *p, const struct timespec *utc) {
+    char *start = out;
+    int j;
+
+    if ((out == NULL) || (p == NULL) || (max_len < UPLINK_JSON_RXPK_SIZE)) {
+        return -1;
+    }
+
+    /* RAW timestamp, 8-17 useful chars */
+    PUT_STR(out, "{\"tmst\":");
+    out = put_uint(out, p->count_us);
+
+    /* Packet RX time (GPS based), 37 useful chars */
+    if (utc != NULL) {
+        PUT_STR(out, ",\"time\":\"");
+        out = put_time(out, utc);
+        *out++ = '"';
+    }
+
+    /* Packet concentrator channel, RF chain & RX frequency, 34-36 useful chars */
+    PUT_STR(out, ",\"chan\":");
+    out = put_uint(out, p->if_chain);
+    PUT_STR(out, ",\"rfch\":");
+    out = put_uint(out, p->rf_chain);
+    PUT_STR(out, ",\"freq\":");
+    out = put_uint(out, p->freq_hz / 1000000);
+    *out++ = '.';
+    out = put_uint_pad(out, p->freq_hz % 1000000, 6);
+
+    /* Packet status, 9-10 useful chars */
+    switch (p->status) {
+        case STAT_CRC_OK:   PUT_STR(out, ",\"stat\":1");  break;
+        case STAT_CRC_BAD:  PUT_STR(out, ",\"stat\":-1"); break;
+        case STAT_NO_CRC:   PUT_STR(out, ",\"stat\":0");  break;
+        default:
+            return -1;
+    }
+
+    /* Packet modulation, 13-14 useful chars */
+    if (p->modulation == MOD_LORA) {
+        PUT_STR(out, ",\"modu\":\"LORA\"");
+
+        /* Lora datarate & bandwidth, 16-19 useful chars */
+        switch (p->datarate) {
+            case DR_LORA_SF7:   PUT_STR(out, ",\"datr\":\"SF7");  break;
+            case DR_LORA_SF8:   PUT_STR(out, ",\"datr\":\"SF8");  break;
+            case DR_LORA_SF9:   PUT_STR(out, ",\"datr\":\"SF9");  break;
+            case DR_LORA_SF10:  PUT_STR(out, ",\"datr\":\"SF10"); break;
+            case DR_LORA_SF11:  PUT_STR(out, ",\"datr\":\"SF11"); break;
+            case DR_LORA_SF12:  PUT_STR(out, ",\"datr\":\"SF12"); break;
+            default:
+                return -1;
+        }
+
+        switch (p->bandwidth) {
+            case BW_125KHZ: PUT_STR(out, "BW125\""); break;
+            case BW_250KHZ: PUT_STR(out, "BW250\""); break;
+            case BW_500KHZ: PUT_STR(out, "BW500\""); break;
+            default:
+                return -1;
+        }
+
+        /* Packet ECC coding rate, 11-13 useful chars */
+        switch (p->coderate) {
+            case CR_LORA_4_5:   PUT_STR(out, ",\"codr\":\"4/5\""); break;
+            case CR_LORA_4_6:   PUT_STR(out, ",\"codr\":\"4/6\""); break;
+            case CR_LORA_4_7:   PUT_STR(out, ",\"codr\":\"4/7\""); break;
+            case CR_LORA_4_8:   PUT_STR(out, ",\"codr\":\"4/8\""); break;
+            case 0:             PUT_STR(out, ",\"codr\":\"OFF\""); break; /* treat the CR0 case (mostly false sync) */
+            default:
+                return -1;
+        }
+
+        /* Lora SNR, 11-13 useful chars */
+        PUT_STR(out, ",\"lsnr\":");
+        out += uplink_json_fixed(out, p->snr, 1);
+    } else if (p->modulation == MOD_FSK) {
+        PUT_STR(out, ",\"modu\":\"FSK\"");
+
+        /* FSK datarate, 11-14 useful chars */
+        PUT_STR(out, ",\"datr\":");
+        out = put_uint(out, p->datarate);
+    } else {
+        return -1;
+    }
+
+    /* Packet RSSI, payload size, 18-23 useful chars */
+    PUT_STR(out, ",\"rssi\":");
+    out += uplink_json_fixed(out, p->rssi, 0);
+    PUT_STR(out, ",\"size\":");
+    out = put_uint(out, p->size);
+
+    /* Packet base64-encoded payload, 14-350 useful chars, encoded in place */
+    PUT_STR(out, ",\"data\":\"");
+    j = bin_to_b64(p->payload, p->size, out, 341); /* 255 bytes = 340 chars in b64 + null char */
+    if (j < 0) {
+        return -1;
+    }
+    out += j;
+
+    /* End of packet serialization */
+    *out++ = '"';
+    *out++ = '}';
+    *out = 0;
+
+    return out - start;
+}
+
+int uplink_json_stat(char *out, int max_len, const struct uplink_json_stat_s *stat) {
+    char *start = out;
+    int len;
+
+    if ((out == NULL) || (stat == NULL) || (stat->time == NULL)) {
+        return -1;
+    }
+
+    len = strlen(stat->time);
+    if (max_len < (UPLINK_JSON_STAT_SIZE + len)) {
+        return -1;
+    }
+
+    PUT_STR(out, "\"stat\":{\"time\":\"");
+    memcpy(out, stat->time, len);
+    out += len;
+    *out++ = '"';
+
+    if (stat->coord != NULL) {
+        PUT_STR(out, ",\"lati\":");
+        out += uplink_json_fixed(out, stat->coord->lat, 5);
+        PUT_STR(out, ",\"long\":");
+        out += uplink_json_fixed(out, stat->coord->lon, 5);
+        PUT_STR(out, ",\"alti\":");
+        out = put_int(out, stat->coord->alt);
+    }
+
+    PUT_STR(out, ",\"rxnb\":");
+    out = put_uint(out, stat->rxnb);
+    PUT_STR(out, ",\"rxok\":");
+    out = put_uint(out, stat->rxok);
+    PUT_STR(out, ",\"rxfw\":");
+    out = put_uint(out, stat->rxfw);
+    PUT_STR(out, ",\"ackr\":");
+    out += uplink_json_fixed(out, stat->ackr, 1);
+    PUT_STR(out, ",\"dwnb\":");
+    out = put_uint(out, stat->dwnb);
+    PUT_STR(out, ",\"txnb\":");
+    out = put_uint(out, stat->txnb);
+    *out++ = '}';
+    *out = 0;
+
+    return out - start;
+}
+
+#endif
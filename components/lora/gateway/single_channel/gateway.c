@@ -239,9 +239,10 @@ static void clear_irq_flags(uint8_t flags) {
 static void set_freq(uint8_t freq_idx) {
     uint64_t frf = (((uint64_t)freq[freq_idx]) << 19) / 32000000;
 
-    stx1276_write_reg(spi_device, SX1276_REG_FR_MSB, (uint8_t)(frf >> 16));
-    stx1276_write_reg(spi_device, SX1276_REG_FR_MID, (uint8_t)(frf >> 8));
-    stx1276_write_reg(spi_device, SX1276_REG_FR_LSB, (uint8_t)(frf >> 0));
+    uint8_t data[3] = {(uint8_t)(frf >> 16), (uint8_t)(frf >> 8), (uint8_t)(frf >> 0)};
+
+    // FR_MSB, FR_MID and FR_LSB in one transaction
+    stx1276_write_buff(spi_device, SX1276_REG_FR_MSB, data, 3);
 }
 
 static void set_rate(uint8_t sf_idx, uint8_t crc) {
@@ -733,6 +734,8 @@ driver_error_t *lora_gw_setup(int band, const char *host, int port, int frequenc
         return error;
     }
 
+    stx1276_setup(spi_device);
+
 #if CONFIG_LUA_RTOS_USE_HARDWARE_LOCKS
     // Lock pins
     if ((error = lora_gw_lock_resources(0))) {
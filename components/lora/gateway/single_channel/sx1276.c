@@ -48,6 +48,7 @@
 #if CONFIG_LUA_RTOS_LORA_HW_TYPE_SX1276 || CONFIG_LUA_RTOS_LORA_HW_TYPE_SX1272
 
 #include "sx1276.h"
+#include "sx127x_spi.h"
 
 #include <sys/driver.h>
 #include <sys/delay.h>
@@ -84,25 +85,43 @@ void sx1276_reset(uint8_t val) {
 	#endif
 }
 
+static void IRAM_ATTR stx1276_select(void *arg) {
+	spi_ll_select((int)arg);
+}
+
+static void IRAM_ATTR stx1276_xfer(void *arg, uint32_t len, uint8_t *tx, uint8_t *rx) {
+	spi_ll_bulk_transfer((int)arg, len, tx, rx);
+}
+
+static void IRAM_ATTR stx1276_deselect(void *arg) {
+	spi_ll_deselect((int)arg);
+}
+
+// Burst transfers with the radio, each access is a single SPI transaction
+static sx127x_spi_t stx1276_spi = {
+	.select = stx1276_select,
+	.xfer = stx1276_xfer,
+	.deselect = stx1276_deselect,
+};
+
+void stx1276_setup(int spi_device) {
+	stx1276_spi.arg = (void *)spi_device;
+}
+
 void IRAM_ATTR stx1276_read_reg(int spi_device, uint8_t addr, uint8_t *data) {
-	spi_ll_select(spi_device);
-	spi_ll_transfer(spi_device, addr & 0x7f, NULL);
-	spi_ll_transfer(spi_device, 0xff, data);
-	spi_ll_deselect(spi_device);
+	*data = sx127x_spi_read_reg(&stx1276_spi, addr);
 }
 
 void IRAM_ATTR stx1276_write_reg(int spi_device, uint8_t addr, uint8_t data) {
-	spi_ll_select(spi_device);
-	spi_ll_transfer(spi_device, addr | 0x80, NULL);
-	spi_ll_transfer(spi_device, data, NULL);
-	spi_ll_deselect(spi_device);
+	sx127x_spi_write_reg(&stx1276_spi, addr, data);
 }
 
 void IRAM_ATTR stx1276_read_buff(int spi_device, uint8_t addr, uint8_t *data, uint8_t len) {
-	spi_ll_select(spi_device);
-	spi_ll_transfer(spi_device, addr & 0x7f, NULL);
-	spi_ll_bulk_read(spi_device, len, data);
-	spi_ll_deselect(spi_device);
+	sx127x_spi_read(&stx1276_spi, addr, data, len);
+}
+
+void IRAM_ATTR stx1276_write_buff(int spi_device, uint8_t addr, const uint8_t *data, uint8_t len) {
+	sx127x_spi_write(&stx1276_spi, addr, data, len);
 }
 
 #endif
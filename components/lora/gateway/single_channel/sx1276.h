@@ -141,9 +141,14 @@
 
 
 void sx1276_reset(uint8_t val);
+
+// Set the SPI device of the radio, before any register access. The
+// register access functions expect the same device.
+void stx1276_setup(int spi_device);
 void stx1276_read_reg(int spi_device, uint8_t addr, uint8_t *data);
 void stx1276_write_reg(int spi_device, uint8_t addr, uint8_t data);
 void stx1276_read_buff(int spi_device, uint8_t addr, uint8_t *data, uint8_t len);
+void stx1276_write_buff(int spi_device, uint8_t addr, const uint8_t *data, uint8_t len);
 
 #endif
 
@@ -31,8 +31,6 @@
 
 #include "oslmic.h"
 
-#define AES_MICSUB 0x30 // internal use only
-
 static const u4_t AES_RCON[10] = { 
     0x01000000, 0x02000000, 0x04000000, 0x08000000, 0x10000000, 
     0x20000000, 0x40000000, 0x80000000, 0x1B000000, 0x36000000
@@ -197,7 +195,7 @@ static const u4_t AES_E4[256] = {
   0x4141C382, 0x9999B029, 0x2D2D775A, 0x0F0F111E, 0xB0B0CB7B, 0x5454FCA8, 0xBBBBD66D, 0x16163A2C, 
 };
 
-#define msbf4_read(p)    ((p)[0]<<24 | (p)[1]<<16 | (p)[2]<<8 | (p)[3])
+#define msbf4_read(p)    ((u4_t)(p)[0]<<24 | (u4_t)(p)[1]<<16 | (u4_t)(p)[2]<<8 | (p)[3])
 #define msbf4_write(p,v) (p)[0]=(v)>>24,(p)[1]=(v)>>16,(p)[2]=(v)>>8,(p)[3]=(v)
 #define swapmsbf(x)      ( (x&0xFF)<<24 | (x&0xFF00)<<8 | (x&0xFF0000)>>8 | (x>>24) )
 
@@ -247,145 +245,191 @@ static void aesroundkeys () {
     }
 }
 
-u4_t os_aes (u1_t mode, xref2u1_t buf, u2_t len) {
-        
-        aesroundkeys();
-
-        if( mode & AES_MICNOAUX ) {
-            AESAUX[0] = AESAUX[1] = AESAUX[2] = AESAUX[3] = 0;
-        } else {
-            AESAUX[0] = swapmsbf(AESAUX[0]);
-            AESAUX[1] = swapmsbf(AESAUX[1]);
-            AESAUX[2] = swapmsbf(AESAUX[2]);
-            AESAUX[3] = swapmsbf(AESAUX[3]);
+// encrypt one 16-byte block in place with the roundkeys in AESKEY
+static void aesblock (xref2u1_t blk) {
+    u4_t a0, a1, a2, a3;
+    u4_t t0, t1, t2, t3;
+    u4_t *ki, *ke;
+
+    a0 = msbf4_read(blk+0);
+    a1 = msbf4_read(blk+4);
+    a2 = msbf4_read(blk+8);
+    a3 = msbf4_read(blk+12);
+
+    ki = AESKEY;
+    ke = ki + 8*4;
+    a0 ^= ki[0];
+    a1 ^= ki[1];
+    a2 ^= ki[2];
+    a3 ^= ki[3];
+    do {
+        AES_key4 (t1,t2,t3,t0,4);
+        AES_expr4(t1,t2,t3,t0,a0);
+        AES_expr4(t2,t3,t0,t1,a1);
+        AES_expr4(t3,t0,t1,t2,a2);
+        AES_expr4(t0,t1,t2,t3,a3);
+
+        AES_key4 (a1,a2,a3,a0,8);
+        AES_expr4(a1,a2,a3,a0,t0);
+        AES_expr4(a2,a3,a0,a1,t1);
+        AES_expr4(a3,a0,a1,a2,t2);
+        AES_expr4(a0,a1,a2,a3,t3);
+    } while( (ki+=8) < ke );
+
+    AES_key4 (t1,t2,t3,t0,4);
+    AES_expr4(t1,t2,t3,t0,a0);
+    AES_expr4(t2,t3,t0,t1,a1);
+    AES_expr4(t3,t0,t1,t2,a2);
+    AES_expr4(t0,t1,t2,t3,a3);
+
+    AES_expr(a0,t0,t1,t2,t3,8);
+    AES_expr(a1,t1,t2,t3,t0,9);
+    AES_expr(a2,t2,t3,t0,t1,10);
+    AES_expr(a3,t3,t0,t1,t2,11);
+
+    msbf4_write(blk+0,  a0);
+    msbf4_write(blk+4,  a1);
+    msbf4_write(blk+8,  a2);
+    msbf4_write(blk+12, a3);
+}
+
+// ================================================================================
+// Software backend (lookup tables)
+
+static void aes_sw_begin (xref2cu1_t key) {
+    if( key != AESkey ) {
+        os_copyMem(AESkey, key, 16);
+    }
+    aesroundkeys();
+}
+
+static void aes_sw_ecb (xref2u1_t buf, u2_t nblk) {
+    for( ; nblk; nblk--, buf += 16 ) {
+        aesblock(buf);
+    }
+}
+
+static void aes_sw_cbc (xref2u1_t x, xref2cu1_t buf, u2_t nblk) {
+    int i;
+
+    for( ; nblk; nblk--, buf += 16 ) {
+        for( i=0; i<16; i++ ) {
+            x[i] ^= buf[i];
         }
+        aesblock(x);
+    }
+}
+
+static void aes_sw_end (void) {
+}
+
+const struct os_aes_backend os_aes_sw = {
+    .begin = aes_sw_begin,
+    .ecb   = aes_sw_ecb,
+    .cbc   = aes_sw_cbc,
+    .end   = aes_sw_end,
+};
 
-        while( (signed char)len > 0 ) {
-            u4_t a0, a1, a2, a3;
-            u4_t t0, t1, t2, t3;
-            u4_t *ki, *ke;
-
-            t0 = t1 = t2 = t3 = 0;
-            a0 = a1 = a2 = a3 = 0;
-
-            // load input block
-            if( (mode & AES_CTR) || ((mode & AES_MIC) && (mode & AES_MICNOAUX)==0) ) { // load CTR block or first MIC block
-                a0 = AESAUX[0];
-                a1 = AESAUX[1];
-                a2 = AESAUX[2];
-                a3 = AESAUX[3];
-            }
-            else if( (mode & AES_MIC) && len <= 16 ) { // last MIC block
-                a0 = a1 = a2 = a3 = 0; // load null block
-                mode |= ((len == 16) ? 1 : 2) << 4; // set MICSUB: CMAC subkey K1 or K2
-            } else
-        LOADDATA: { // load data block (partially)
-                for(t0=0; t0<16; t0++) {
-                    t1 = (t1<<8) | ((t0<len) ? buf[t0] : (t0==len) ? 0x80 : 0x00);
-                    if((t0&3)==3) {
-                        a0 = a1;
-                        a1 = a2;
-                        a2 = a3;
-                        a3 = t1;
-                    }
-                } 
-                if( mode & AES_MIC ) {
-                    a0 ^= AESAUX[0];
-                    a1 ^= AESAUX[1];
-                    a2 ^= AESAUX[2];
-                    a3 ^= AESAUX[3];
-                }
-            }
-
-            // perform AES encryption on block in a0-a3
-            ki = AESKEY;
-            ke = ki + 8*4;
-            a0 ^= ki[0];
-            a1 ^= ki[1];
-            a2 ^= ki[2];
-            a3 ^= ki[3];
-            do {
-                AES_key4 (t1,t2,t3,t0,4);
-                AES_expr4(t1,t2,t3,t0,a0);
-                AES_expr4(t2,t3,t0,t1,a1);
-                AES_expr4(t3,t0,t1,t2,a2);
-                AES_expr4(t0,t1,t2,t3,a3);
-
-                AES_key4 (a1,a2,a3,a0,8);
-                AES_expr4(a1,a2,a3,a0,t0);
-                AES_expr4(a2,a3,a0,a1,t1);
-                AES_expr4(a3,a0,a1,a2,t2);
-                AES_expr4(a0,a1,a2,a3,t3);
-            } while( (ki+=8) < ke );
-
-            AES_key4 (t1,t2,t3,t0,4);
-            AES_expr4(t1,t2,t3,t0,a0);
-            AES_expr4(t2,t3,t0,t1,a1);
-            AES_expr4(t3,t0,t1,t2,a2);
-            AES_expr4(t0,t1,t2,t3,a3);
-
-            AES_expr(a0,t0,t1,t2,t3,8);
-            AES_expr(a1,t1,t2,t3,t0,9);
-            AES_expr(a2,t2,t3,t0,t1,10);
-            AES_expr(a3,t3,t0,t1,t2,11);
-            // result of AES encryption in a0-a3
-
-            if( mode & AES_MIC ) {
-                if( (t1 = (mode & AES_MICSUB) >> 4) != 0 ) { // last block
-                    do {
-                        // compute CMAC subkey K1 and K2
-                        t0 = a0 >> 31; // save MSB
-                        a0 = (a0 << 1) | (a1 >> 31);
-                        a1 = (a1 << 1) | (a2 >> 31);
-                        a2 = (a2 << 1) | (a3 >> 31);
-                        a3 = (a3 << 1);
-                        if( t0 ) a3 ^= 0x87;
-                    } while( --t1 );
-
-                    AESAUX[0] ^= a0;
-                    AESAUX[1] ^= a1;
-                    AESAUX[2] ^= a2;
-                    AESAUX[3] ^= a3;
-                    mode &= ~AES_MICSUB;
-                    goto LOADDATA;
-                } else {
-                    // save cipher block as new iv
-                    AESAUX[0] = a0;
-                    AESAUX[1] = a1;
-                    AESAUX[2] = a2;
-                    AESAUX[3] = a3;
-                }
-            } else { // CIPHER
-                if( mode & AES_CTR ) { // xor block (partially)
-                    t0 = (len > 16) ? 16: len;
-                    for(t1=0; t1<t0; t1++) {
-                        buf[t1] ^= (a0>>24);
-                        a0 <<= 8;
-                        if((t1&3)==3) {
-                            a0 = a1;
-                            a1 = a2;
-                            a2 = a3;
-                        }
-                    }
-                    // update counter
-                    AESAUX[3]++;
-                } else { // ECB
-                    // store block
-                    msbf4_write(buf+0,  a0);
-                    msbf4_write(buf+4,  a1);
-                    msbf4_write(buf+8,  a2);
-                    msbf4_write(buf+12, a3);
-                }
-            }
-
-            // update block state
-            if( (mode & AES_MIC)==0 || (mode & AES_MICNOAUX) ) {
-                buf += 16;
-                len -= 16;
-            }
-            mode |= AES_MICNOAUX;
+#if CONFIG_LUA_RTOS_LORA_HW_AES
+const struct os_aes_backend* os_aes_backend = &os_aes_hw;
+#else
+const struct os_aes_backend* os_aes_backend = &os_aes_sw;
+#endif
+
+// ================================================================================
+// Modes on top of the backend
+
+// CMAC subkey generation: multiply k by x in GF(2^128)
+static void aescmacshift (xref2u1_t k) {
+    u1_t msb = k[0] & 0x80;
+    int i;
+
+    for( i=0; i<15; i++ ) {
+        k[i] = (k[i] << 1) | (k[i+1] >> 7);
+    }
+    k[15] = (k[15] << 1) ^ (msb ? 0x87 : 0x00);
+}
+
+// AES-CMAC (RFC 4493) of buf, prefixed by the B0 block in AESaux unless
+// AES_MICNOAUX is set. All the full blocks before the last one are chained
+// in a single backend run.
+static u4_t aescmac (const struct os_aes_backend* be, u1_t mode, xref2cu1_t buf, u2_t len) {
+    u1_t x[16], k[16];
+    u2_t n;
+    int i;
+
+    // subkey K1 = L.x, L = E(0)
+    os_clearMem(k, 16);
+    be->ecb(k, 1);
+    aescmacshift(k);
+
+    if( mode & AES_MICNOAUX ) {
+        os_clearMem(x, 16);
+    } else {
+        os_copyMem(x, AESaux, 16);
+        be->ecb(x, 1);
+    }
+
+    n = (len > 0) ? (len - 1) / 16 : 0;
+    be->cbc(x, buf, n);
+    buf += 16 * n;
+    len -= 16 * n;
+
+    // last block, xored with K1 if complete, or padded and xored with K2
+    if( len < 16 ) {
+        aescmacshift(k);
+    }
+    for( i=0; i<16; i++ ) {
+        k[i] ^= (i < len) ? buf[i] : (i == len) ? 0x80 : 0x00;
+    }
+    be->cbc(x, k, 1);
+
+    return msbf4_read(x);
+}
+
+// AES-CTR of buf, counter blocks start at AESaux. The keystream is generated
+// in runs of AES_CTR_RUN blocks.
+#define AES_CTR_RUN 4
+
+static void aesctr (const struct os_aes_backend* be, xref2u1_t buf, u2_t len) {
+    u1_t ks[AES_CTR_RUN*16];
+    u2_t n, i;
+    int j;
+
+    while( len > 0 ) {
+        n = (len + 15) / 16;
+        if( n > AES_CTR_RUN ) {
+            n = AES_CTR_RUN;
+        }
+
+        for( i=0; i<n; i++ ) {
+            os_copyMem(ks + 16*i, AESaux, 16);
+            // 32-bit big endian block counter in the last word
+            for( j=15; j>=12 && ++AESaux[j] == 0; j-- );
+        }
+        be->ecb(ks, n);
+
+        for( i=0; i<16*n && len > 0; i++, len-- ) {
+            *buf++ ^= ks[i];
         }
-        return AESAUX[0];
+    }
+}
+
+u4_t os_aes (u1_t mode, xref2u1_t buf, u2_t len) {
+    const struct os_aes_backend* be = os_aes_backend;
+    u4_t mic = 0;
+
+    be->begin(AESkey);
+    if( mode & AES_MIC ) {
+        mic = aescmac(be, mode, buf, len);
+    } else if( mode & AES_CTR ) {
+        aesctr(be, buf, len);
+    } else { // ECB
+        be->ecb(buf, (len + 15) / 16);
+    }
+    be->end();
+
+    return mic;
 }
 
 #endif
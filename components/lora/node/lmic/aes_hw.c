@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, LMIC AES backend on the ESP32 AES accelerator
+ *
+ */
+
+#include "sdkconfig.h"
+
+#if CONFIG_LUA_RTOS_LORA_HW_TYPE_SX1276 || CONFIG_LUA_RTOS_LORA_HW_TYPE_SX1272
+#if CONFIG_LUA_RTOS_LORA_HW_AES
+
+#include "oslmic.h"
+
+#include "rom/aes.h"
+#include "hwcrypto/aes.h"
+
+// os_aes backend on the ESP32 AES accelerator. The engine is taken and the
+// key is loaded once per os_aes call, and the blocks of the run are pushed
+// through the engine back to back.
+
+static void aes_hw_begin (xref2cu1_t key) {
+    esp_aes_acquire_hardware();
+    ets_aes_setkey_enc(key, AES128);
+}
+
+static void aes_hw_ecb (xref2u1_t buf, u2_t nblk) {
+    for( ; nblk; nblk--, buf += 16 ) {
+        ets_aes_crypt(buf, buf);
+    }
+}
+
+static void aes_hw_cbc (xref2u1_t x, xref2cu1_t buf, u2_t nblk) {
+    int i;
+
+    for( ; nblk; nblk--, buf += 16 ) {
+        for( i=0; i<16; i++ ) {
+            x[i] ^= buf[i];
+        }
+        ets_aes_crypt(x, x);
+    }
+}
+
+static void aes_hw_end (void) {
+    esp_aes_release_hardware();
+}
+
+const struct os_aes_backend os_aes_hw = {
+    .begin = aes_hw_begin,
+    .ecb   = aes_hw_ecb,
+    .cbc   = aes_hw_cbc,
+    .end   = aes_hw_end,
+};
+
+#endif
+#endif
@@ -18,6 +18,8 @@
 
 #include <sys/driver.h>
 
+#include "lmic_txq.h"
+
 #ifdef __cplusplus
 extern "C"{
 #endif
@@ -72,6 +74,20 @@ void hal_pin_rst (u1_t val);
  */
 u1_t hal_spi (u1_t outval);
 
+/*
+ * perform a burst SPI transaction with radio, in a single bus transfer.
+ *   - write register address 'addr'
+ *   - write 'len' bytes from 'buf' to consecutive registers, or to the FIFO
+ */
+void hal_spi_write (u1_t addr, const u1_t* buf, u1_t len);
+
+/*
+ * perform a burst SPI transaction with radio, in a single bus transfer.
+ *   - write register address 'addr'
+ *   - read 'len' bytes from consecutive registers, or from the FIFO, into 'buf'
+ */
+void hal_spi_read (u1_t addr, u1_t* buf, u1_t len);
+
 /*
  * disable all CPU interrupts.
  *   - might be invoked nested
@@ -94,13 +110,20 @@ void hal_resume(void);
  */
 void hal_sleep (void);
 
+/*
+ * put system and CPU in low-power mode, sleep until interrupt, or until
+ * specified timestamp (in ticks) is reached (hardware timer wakeup).
+ */
+void hal_sleepUntil (u8_t time);
+
 /*
  * return 32-bit system time in ticks.
  */
 u8_t hal_ticks (void);
 
 /*
- * busy-wait until specified timestamp (in ticks) is reached.
+ * wait until specified timestamp (in ticks) is reached.
+ *   - the task sleeps for the far part of the wait, and busy-waits the rest
  */
 void hal_waitUntil (u8_t time);
 
@@ -118,7 +141,33 @@ u1_t hal_checkTimer (u8_t targettime);
  */
 void hal_failed (char *file, int line);
 
-void hal_lmic_tx(int port, uint8_t *payload, uint8_t payload_len, uint8_t cnf);
+/*
+ * queue an uplink, without blocking.
+ *   - payload is freed when the uplink is handed to LMIC, or dropped
+ *   - done is called with a LMIC_TXQ_xxx status when the uplink completes
+ *   - return 0 if queued, 1 if queued dropping the uplink returned in dropped,
+ *     -1 if the queue is full
+ *   - the caller completes the dropped uplink, once it doesn't hold any lock
+ */
+int hal_lmic_tx(int port, uint8_t *payload, uint8_t payload_len, uint8_t cnf, uint8_t prio, lmic_txq_done_t *done, void *arg, lmic_txq_entry_t *dropped);
+
+/*
+ * complete the uplink in progress with a LMIC_TXQ_xxx status, called on EV_TXCOMPLETE.
+ */
+void hal_lmic_tx_complete(int status);
+
+/*
+ * complete the uplink in progress with LMIC_TXQ_FAILED, called on EV_RESET, as
+ *   LMIC drops it without EV_TXCOMPLETE.
+ */
+void hal_lmic_reset();
+
+/*
+ * return 1 if called from the LMIC run loop thread, where the event and the
+ *   completion callbacks run, and where waiting for LMIC deadlocks.
+ */
+int hal_lmic_in_run_loop();
+
 void hal_lmic_join();
 
 #ifdef __cplusplus
@@ -37,9 +37,11 @@
 #include "freertos/timers.h"
 #include "freertos/event_groups.h"
 #include "freertos/queue.h"
+#include "freertos/task.h"
 
 #include "esp_system.h"
 #include "esp_attr.h"
+#include "esp_timer.h"
 #include "esp_intr.h"
 #include "soc/gpio_reg.h"
 #include "soc/rtc_cntl_reg.h"
@@ -61,6 +63,9 @@
 #include <drivers/spi.h>
 #include <drivers/power_bus.h>
 
+#include "sx127x_spi.h"
+#include "lmic_txq.h"
+
 #define LMIC_HAL_INTERRUPTS 0
 
 /*
@@ -73,16 +78,45 @@ static struct timeval start_tv;
 
 static int spi_device;
 
+static void radio_spi_select(void *arg);
+static void radio_spi_xfer(void *arg, uint32_t len, uint8_t *tx, uint8_t *rx);
+static void radio_spi_deselect(void *arg);
+
+// Burst transfers with the radio
+static sx127x_spi_t radio_spi = {
+	.select = radio_spi_select,
+	.xfer = radio_spi_xfer,
+	.deselect = radio_spi_deselect,
+};
+
 #if LMIC_HAL_INTERRUPTS
 static int nestedInterrupts  = 0;
 #endif
 
+// Uplinks waiting for LMIC, protected by lmic_hal_mtx
+static lmic_txq_t txq;
+
+// Job that wakes up the run loop when the duty cycle gate of txq opens
+static osjob_t txq_job;
+
+// Hardware timer that wakes up the run loop for the next timed job
+static esp_timer_handle_t wakeup_timer;
+
+// A DIO interrupt is pending
+static volatile uint8_t dio_pending = 0;
+
+// Sleep with the task for waits longer than this, busy-wait the rest
+#define HAL_WAIT_SPIN_TICKS us2osticks(portTICK_PERIOD_MS * 1000)
+
  /*
   * This is an event group handler for sleep / resume os_runloop.
   * When os_runloop has nothing to do waits for an event.
   */
  #define evLMIC_SLEEP ( 1 << 0 )
 
+// Task handle for LMIC run loop
+extern TaskHandle_t xRunLoop;
+
 // This queue is for resume the os_runloop loop
 xQueueHandle lmicSleepEvent;
 
@@ -102,9 +136,16 @@ xQueueHandle lmicCommand;
  static void IRAM_ATTR dio_intr_handler(void* arg) {
 	uint32_t d = 1;
 
+	// The flag is checked on every wakeup, so the interrupt is not lost if the
+	// queue is full with a pending resume
+	dio_pending = 1;
 	xQueueSendFromISR(lmicSleepEvent, &d, NULL);
 }
 
+static void wakeup_timer_cb(void *arg) {
+	hal_resume();
+}
+
 #if CONFIG_LUA_RTOS_USE_HARDWARE_LOCKS
 driver_error_t *lmic_lock_resources(int unit, void *resources) {
 	driver_error_t *error;
@@ -205,6 +246,20 @@ driver_error_t *hal_init (void) {
 	// Create mutex
     mtx_init(&lmic_hal_mtx, NULL, NULL, 0);
 
+    lmic_txq_init(&txq);
+
+    // Create the wakeup timer
+    esp_timer_create_args_t timer_args = {
+    	.callback = wakeup_timer_cb,
+		.arg = NULL,
+		.dispatch_method = ESP_TIMER_TASK,
+		.name = "lmic"
+    };
+
+    if (esp_timer_create(&timer_args, &wakeup_timer) != ESP_OK) {
+		return driver_error(LORA_DRIVER, LORA_ERR_NO_MEM, NULL);
+    }
+
     // Get start time
 	gettimeofday(&start_tv, NULL);
 
@@ -273,6 +328,26 @@ u1_t IRAM_ATTR hal_spi (u1_t outval) {
 	return readed;
 }
 
+static void IRAM_ATTR radio_spi_select(void *arg) {
+	spi_ll_select(spi_device);
+}
+
+static void IRAM_ATTR radio_spi_xfer(void *arg, uint32_t len, uint8_t *tx, uint8_t *rx) {
+	spi_ll_bulk_transfer(spi_device, len, tx, rx);
+}
+
+static void IRAM_ATTR radio_spi_deselect(void *arg) {
+	spi_ll_deselect(spi_device);
+}
+
+void IRAM_ATTR hal_spi_write (u1_t addr, const u1_t* buf, u1_t len) {
+	sx127x_spi_write(&radio_spi, addr, buf, len);
+}
+
+void IRAM_ATTR hal_spi_read (u1_t addr, u1_t* buf, u1_t len) {
+	sx127x_spi_read(&radio_spi, addr, buf, len);
+}
+
 void IRAM_ATTR hal_disableIRQs (void) {
 #if LMIC_HAL_INTERRUPTS
 	mtx_lock(&lmic_hal_mtx);
@@ -307,11 +382,24 @@ void hal_sleep (void) {
 	uint32_t d = 0;
 
 	xQueueReceive(lmicSleepEvent, &d, portMAX_DELAY);
-	if (d == 1) {
+	if (dio_pending) {
+		dio_pending = 0;
 		radio_irq_handler(0);
 	}
 }
 
+void hal_sleepUntil (u8_t time) {
+	u8_t now = hal_ticks();
+
+	if (time <= now) {
+		return;
+	}
+
+	esp_timer_start_once(wakeup_timer, (time - now) * US_PER_OSTICK);
+	hal_sleep();
+	esp_timer_stop(wakeup_timer);
+}
+
 /*
  * In ESP32 RTC runs at 150.000 hz.
  *
@@ -350,9 +438,16 @@ static u1_t is_close(u8_t target) {
 }
 
 /*
- * busy-wait until specified timestamp (in ticks) is reached.
+ * wait until specified timestamp (in ticks) is reached.
  */
 void hal_waitUntil (u8_t time) {
+	u8_t now = hal_ticks();
+
+	// Sleep the far part, leaving one system tick for the task wakeup latency
+	if ((time > now) && (time - now > 2 * HAL_WAIT_SPIN_TICKS)) {
+		vTaskDelay((time - now - HAL_WAIT_SPIN_TICKS) / HAL_WAIT_SPIN_TICKS);
+	}
+
     while (!is_close(time)) {
     	udelay(US_PER_OSTICK);
     }
@@ -378,18 +473,107 @@ void hal_failed (char *file, int line) {
 	for(;;);
 }
 
-void hal_lmic_tx(int port, uint8_t *payload, uint8_t payload_len, uint8_t cnf) {
-	lmic_command_t command;
+/*
+ * Earliest time for the next uplink, by the duty cycle of the bands with
+ * enabled channels, and the global duty cycle.
+ */
+static ostime_t duty_gate() {
+	ostime_t gate = os_getTime();
+
+#if defined(CFG_eu868)
+	ostime_t avail;
+	u1_t found = 0;
+	u1_t chnl;
+
+	for (chnl = 0; chnl < MAX_CHANNELS; chnl++) {
+		if (LMIC.channelMap & (1 << chnl)) {
+			avail = LMIC.bands[LMIC.channelFreq[chnl] & 0x3].avail;
+			if (!found || ((s8_t)(avail - gate) < 0)) {
+				gate = avail;
+				found = 1;
+			}
+		}
+	}
+#endif
 
-	command.command = LMICTx;
-	command.tx.port = port;
-	command.tx.payload = payload;
-	command.tx.payload_len = payload_len;
-	command.tx.cnf = cnf;
+	if (LMIC.globalDutyRate && ((s8_t)(LMIC.globalDutyAvail - gate) > 0)) {
+		gate = LMIC.globalDutyAvail;
+	}
 
-	xQueueSend(lmicCommand, &command, portMAX_DELAY);
+	return gate;
+}
+
+static void txq_gate_func(osjob_t *job) {
+	// Nothing to do, the run loop dispatches the uplink in the next iteration
+}
+
+int hal_lmic_tx(int port, uint8_t *payload, uint8_t payload_len, uint8_t cnf, uint8_t prio, lmic_txq_done_t *done, void *arg, lmic_txq_entry_t *dropped) {
+	lmic_txq_entry_t entry;
+	int res;
+
+	entry.payload = payload;
+	entry.len = payload_len;
+	entry.port = port;
+	entry.cnf = cnf;
+	entry.prio = prio;
+	entry.done = done;
+	entry.arg = arg;
+
+	mtx_lock(&lmic_hal_mtx);
+	res = lmic_txq_put(&txq, &entry, dropped);
+	mtx_unlock(&lmic_hal_mtx);
+
+	if (res < 0) {
+		return -1;
+	}
+
+	if (res > 0) {
+		free(dropped->payload);
+		dropped->payload = NULL;
+	}
 
 	hal_resume();
+
+	return res;
+}
+
+void hal_lmic_tx_complete(int status) {
+	lmic_txq_entry_t entry;
+	int res;
+
+	ostime_t gate = duty_gate();
+
+	mtx_lock(&lmic_hal_mtx);
+	res = lmic_txq_complete(&txq, gate, &entry);
+	mtx_unlock(&lmic_hal_mtx);
+
+	// Wake up the run loop when the duty cycle gate opens, for the uplinks
+	// queued until then
+	os_setTimedCallback(&txq_job, gate, txq_gate_func);
+
+	if (res && entry.done) {
+		entry.done(entry.arg, status);
+	}
+}
+
+void hal_lmic_reset() {
+	lmic_txq_entry_t entry;
+	int res;
+
+	mtx_lock(&lmic_hal_mtx);
+	res = lmic_txq_reset(&txq, &entry);
+	mtx_unlock(&lmic_hal_mtx);
+
+	// The duty cycle state is reset too, don't wait for the old gate
+	os_clearCallback(&txq_job);
+
+	if (res && entry.done) {
+		entry.done(entry.arg, LMIC_TXQ_FAILED);
+	}
+}
+
+int hal_lmic_in_run_loop() {
+	return (xRunLoop == xTaskGetCurrentTaskHandle());
 }
 
 void hal_lmic_join() {
@@ -404,16 +588,44 @@ void hal_lmic_join() {
 
 void hal_lmic_command() {
 	lmic_command_t command;
+	lmic_txq_entry_t entry;
+	ostime_t now;
+	int res;
 
 	if (xQueueReceive(lmicCommand, &command, 0)) {
-		if (command.command == LMICTx) {
-			LMIC_setTxData2(command.tx.port, command.tx.payload,  command.tx.payload_len,  command.tx.cnf);
-
-			free(command.tx.payload);
-		} else if (command.command == LMICJoin) {
+		if (command.command == LMICJoin) {
 			LMIC_startJoining();
 		}
 	}
+
+	// Hand the next uplink to LMIC, when LMIC is idle
+	if (LMIC.opmode & (OP_JOINING | OP_TXDATA | OP_POLL | OP_TXRXPEND)) {
+		return;
+	}
+
+	now = os_getTime();
+
+	mtx_lock(&lmic_hal_mtx);
+	res = lmic_txq_get(&txq, now, &entry);
+	mtx_unlock(&lmic_hal_mtx);
+
+	if (!res) {
+		return;
+	}
+
+	res = LMIC_setTxData2(entry.port, entry.payload, entry.len, entry.cnf);
+	free(entry.payload);
+
+	if (res != 0) {
+		// Rejected by LMIC, so EV_TXCOMPLETE won't come for it
+		mtx_lock(&lmic_hal_mtx);
+		lmic_txq_complete(&txq, now, &entry);
+		mtx_unlock(&lmic_hal_mtx);
+
+		if (entry.done) {
+			entry.done(entry.arg, LMIC_TXQ_FAILED);
+		}
+	}
 }
 
 #endif
@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, LMIC uplink queue
+ *
+ */
+
+#include "sdkconfig.h"
+
+#if CONFIG_LUA_RTOS_LORA_HW_TYPE_SX1276 || CONFIG_LUA_RTOS_LORA_HW_TYPE_SX1272
+
+#include "lmic_txq.h"
+
+#include <string.h>
+
+void lmic_txq_init(lmic_txq_t *q) {
+	memset(q, 0, sizeof(lmic_txq_t));
+}
+
+int lmic_txq_put(lmic_txq_t *q, const lmic_txq_entry_t *e, lmic_txq_entry_t *dropped) {
+	int ret = 0;
+	int pos;
+
+	if (q->count == LMIC_TXQ_SIZE) {
+		// Full, drop the last uplink if it has a lower priority
+		if (q->entry[q->count - 1].prio >= e->prio) {
+			return -1;
+		}
+
+		*dropped = q->entry[--q->count];
+		ret = 1;
+	}
+
+	// Insert after the uplinks with the same or a higher priority
+	for (pos = q->count; (pos > 0) && (q->entry[pos - 1].prio < e->prio); pos--);
+
+	memmove(&q->entry[pos + 1], &q->entry[pos], (q->count - pos) * sizeof(lmic_txq_entry_t));
+	q->entry[pos] = *e;
+	q->count++;
+
+	return ret;
+}
+
+int lmic_txq_get(lmic_txq_t *q, uint64_t now, lmic_txq_entry_t *e) {
+	if (q->inflight || (q->count == 0) || ((int64_t)(now - q->gate) < 0)) {
+		return 0;
+	}
+
+	*e = q->entry[0];
+
+	q->count--;
+	memmove(&q->entry[0], &q->entry[1], q->count * sizeof(lmic_txq_entry_t));
+
+	q->current = *e;
+	q->inflight = 1;
+
+	return 1;
+}
+
+int lmic_txq_complete(lmic_txq_t *q, uint64_t gate, lmic_txq_entry_t *e) {
+	if (!q->inflight) {
+		return 0;
+	}
+
+	*e = q->current;
+
+	q->inflight = 0;
+	q->gate = gate;
+
+	return 1;
+}
+
+int lmic_txq_reset(lmic_txq_t *q, lmic_txq_entry_t *e) {
+	int ret = q->inflight;
+
+	if (ret) {
+		*e = q->current;
+	}
+
+	q->inflight = 0;
+	q->gate = 0;
+
+	return ret;
+}
+
+int lmic_txq_count(lmic_txq_t *q) {
+	return q->count;
+}
+
+#endif
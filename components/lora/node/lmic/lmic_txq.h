@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, LMIC uplink queue
+ *
+ */
+
+/*
+ * Uplinks waiting to be handed to LMIC, so that the sender doesn't block while
+ * a previous uplink is in progress.
+ *
+ * Uplinks are kept in dispatch order: higher priority first, and in arrival
+ * order for the same priority. Only one uplink is handed to LMIC at a time, and
+ * not before the duty cycle gate set on the completion of the previous one,
+ * so the priority is applied when the radio can really transmit.
+ *
+ * The queue doesn't lock, and doesn't call the completion callbacks. The owner
+ * does it, outside its critical section, with the entries returned by the
+ * queue functions.
+ */
+
+#ifndef _LMIC_TXQ_H
+#define _LMIC_TXQ_H
+
+#include "sdkconfig.h"
+
+#include <stdint.h>
+
+#ifndef CONFIG_LUA_RTOS_LORA_TX_QUEUE_SIZE
+#define CONFIG_LUA_RTOS_LORA_TX_QUEUE_SIZE 8
+#endif
+
+#define LMIC_TXQ_SIZE CONFIG_LUA_RTOS_LORA_TX_QUEUE_SIZE
+
+// Completion status
+#define LMIC_TXQ_DONE       0 // Transmitted, and acknowledged if confirmed
+#define LMIC_TXQ_NOT_ACKED  1 // Confirmed uplink not acknowledged
+#define LMIC_TXQ_DROPPED    2 // Dropped to make room for a higher priority uplink
+#define LMIC_TXQ_FAILED     3 // Rejected by LMIC, or lost on a LMIC reset
+
+typedef void (lmic_txq_done_t)(void *arg, int status);
+
+typedef struct {
+	uint8_t *payload;       // Payload
+	uint8_t len;            // Payload length
+	uint8_t port;           // Port
+	uint8_t cnf;            // Confirmed?
+	uint8_t prio;           // Priority, higher values are sent first
+	lmic_txq_done_t *done;  // Completion callback, or NULL
+	void *arg;              // Argument for the completion callback
+} lmic_txq_entry_t;
+
+typedef struct {
+	lmic_txq_entry_t entry[LMIC_TXQ_SIZE]; // Queued uplinks, in dispatch order
+	uint8_t count;                         // Number of queued uplinks
+	uint8_t inflight;                      // An uplink is handed to LMIC
+	lmic_txq_entry_t current;              // Uplink handed to LMIC
+	uint64_t gate;                         // No dispatch before this time
+} lmic_txq_t;
+
+/**
+ * @brief Initialize an uplink queue.
+ *
+ * @param q Queue.
+ */
+void lmic_txq_init(lmic_txq_t *q);
+
+/**
+ * @brief Queue an uplink. If the queue is full, the last uplink in dispatch
+ *        order is dropped if it has a lower priority.
+ *
+ * @param q Queue.
+ * @param e Uplink to queue.
+ * @param dropped Dropped uplink, if any.
+ *
+ * @return 0 if queued, 1 if queued dropping an uplink, -1 if the queue is full.
+ */
+int lmic_txq_put(lmic_txq_t *q, const lmic_txq_entry_t *e, lmic_txq_entry_t *dropped);
+
+/**
+ * @brief Get the next uplink to hand to LMIC, if no uplink is in progress and
+ *        the duty cycle gate is open.
+ *
+ * @param q Queue.
+ * @param now Current time.
+ * @param e Uplink to hand to LMIC.
+ *
+ * @return 1 if there's an uplink, 0 if not.
+ */
+int lmic_txq_get(lmic_txq_t *q, uint64_t now, lmic_txq_entry_t *e);
+
+/**
+ * @brief Complete the uplink in progress.
+ *
+ * @param q Queue.
+ * @param gate Earliest time for the next uplink, by duty cycle.
+ * @param e Completed uplink.
+ *
+ * @return 1 if there was an uplink in progress, 0 if not.
+ */
+int lmic_txq_complete(lmic_txq_t *q, uint64_t gate, lmic_txq_entry_t *e);
+
+/**
+ * @brief Reset the queue state after a LMIC reset, that drops the uplink in
+ *        progress without completing it, and the duty cycle state. Queued
+ *        uplinks are kept.
+ *
+ * @param q Queue.
+ * @param e Uplink that was in progress.
+ *
+ * @return 1 if there was an uplink in progress, 0 if not.
+ */
+int lmic_txq_reset(lmic_txq_t *q, lmic_txq_entry_t *e);
+
+/**
+ * @brief Get the number of queued uplinks, not counting the one in progress.
+ *
+ * @param q Queue.
+ */
+int lmic_txq_count(lmic_txq_t *q);
+
+#endif /* _LMIC_TXQ_H */
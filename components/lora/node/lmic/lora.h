@@ -58,6 +58,9 @@ typedef enum {
 #define LORA_ERR_INVALID_BAND                       (DRIVER_EXCEPTION_BASE(LORA_DRIVER_ID) | 11)
 #define LORA_ERR_NOT_ALLOWED                        (DRIVER_EXCEPTION_BASE(LORA_DRIVER_ID) | 12)
 #define LORA_ERR_INVALID_FREQ                       (DRIVER_EXCEPTION_BASE(LORA_DRIVER_ID) | 13)
+#define LORA_ERR_TX_QUEUE_FULL                      (DRIVER_EXCEPTION_BASE(LORA_DRIVER_ID) | 14)
+#define LORA_ERR_TX_DROPPED                         (DRIVER_EXCEPTION_BASE(LORA_DRIVER_ID) | 15)
+#define LORA_ERR_TX_FAILED                          (DRIVER_EXCEPTION_BASE(LORA_DRIVER_ID) | 16)
 
 extern const int lora_errors;
 extern const int lora_error_map;
@@ -85,11 +88,25 @@ extern const int lora_error_map;
 
 typedef void (lora_rx)(int port, char *payload);
 
+// Transmission completion status
+#define LORA_TX_DONE      0 // Transmitted, and acknowledged if confirmed
+#define LORA_TX_NOT_ACKED 1 // Confirmed transmission not acknowledged
+#define LORA_TX_DROPPED   2 // Dropped from the queue by a higher priority transmission
+#define LORA_TX_FAILED    3 // Rejected by the LoRa WAN stack, or lost on a stack reset
+
+// Transmission priority used by lora_tx
+#define LORA_TX_PRIO_DEFAULT 1
+
+// Transmission completion callback, called from the LoRa WAN thread, where
+// lora_tx and lora_join fail with LORA_ERR_NOT_ALLOWED
+typedef void (lora_tx_done)(void *arg, int status);
+
 driver_error_t *lora_setup(int band);
 driver_error_t *lora_mac_set(const char command, const char *value);
 driver_error_t *lora_mac_get(const char command, char **value);
 driver_error_t *lora_join();
 driver_error_t *lora_tx(int cnf, int port, const char *data);
+driver_error_t *lora_tx_async(int cnf, int port, const char *data, int prio, lora_tx_done *done, void *arg);
 
 void lora_set_rx_callback(lora_rx *callback);
 void _lora_init();
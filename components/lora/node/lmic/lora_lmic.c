@@ -72,6 +72,9 @@ DRIVER_REGISTER_BEGIN(LORA,lora, 0,_lora_init,NULL);
 	DRIVER_REGISTER_ERROR(LORA, lora, InvalidBand, "invalid band for your location", LORA_ERR_INVALID_BAND);
 	DRIVER_REGISTER_ERROR(LORA, lora, NotAllowed, "not allowed", LORA_ERR_NOT_ALLOWED);
     DRIVER_REGISTER_ERROR(LORA, lora, InvalidFreq, "invalid frequency for your location", LORA_ERR_INVALID_FREQ);
+    DRIVER_REGISTER_ERROR(LORA, lora, TxQueueFull, "transmission queue is full", LORA_ERR_TX_QUEUE_FULL);
+    DRIVER_REGISTER_ERROR(LORA, lora, TxDropped, "transmission dropped by a higher priority one", LORA_ERR_TX_DROPPED);
+    DRIVER_REGISTER_ERROR(LORA, lora, TxFailed, "transmission rejected", LORA_ERR_TX_FAILED);
 DRIVER_REGISTER_END(LORA,lora, 0,_lora_init,NULL);
 
 #define evLORA_INITED 	       	 ( 1 << 0 )
@@ -79,6 +82,8 @@ DRIVER_REGISTER_END(LORA,lora, 0,_lora_init,NULL);
 #define evLORA_JOIN_DENIED     	 ( 1 << 2 )
 #define evLORA_TX_COMPLETE    	 ( 1 << 3 )
 #define evLORA_ACK_NOT_RECEIVED  ( 1 << 4 )
+#define evLORA_TX_DROPPED        ( 1 << 5 )
+#define evLORA_TX_FAILED         ( 1 << 6 )
 
 extern uint8_t flash_unique_id[8];
 
@@ -88,6 +93,9 @@ static osjob_t initjob;
 // Mutext for lora 
 static struct mtx lora_mtx;
 
+// Mutex for synchronous transmissions, that share the completion events
+static struct mtx lora_tx_mtx;
+
 // Event group handler for sync LMIC events with driver functions
 static EventGroupHandle_t loraEvent;
 
@@ -120,7 +128,7 @@ RTC_DATA_ATTR static u1_t APPSKEY[16] = {0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0};
 
 static u1_t session_init = 0;
 
-// Current message id. We put this in RTC memory for survive a deep sleep.
+// Next uplink frame counter. We put this in RTC memory for survive a deep sleep.
 // ABP needs to keep msgid in sequence between tranfers.
 RTC_DATA_ATTR static u4_t msgid = 0;
 
@@ -194,13 +202,15 @@ void onEvent (ev_t ev) {
 	      break;
 
 	    case EV_TXCOMPLETE:
+		  msgid = LMIC.seqnoUp;
+
 		  if (LMIC.pendTxConf) {
 			  if (LMIC.txrxFlags & TXRX_ACK) {
-		  		  xEventGroupSetBits(loraEvent, evLORA_TX_COMPLETE);
+				  hal_lmic_tx_complete(LMIC_TXQ_DONE);
 			  }
 
 			  if (LMIC.txrxFlags & TXRX_NACK) {
-		  		  xEventGroupSetBits(loraEvent, evLORA_ACK_NOT_RECEIVED);
+				  hal_lmic_tx_complete(LMIC_TXQ_NOT_ACKED);
 			  }
 		  } else {
 		      if (LMIC.dataLen && lora_rx_callback) {
@@ -215,7 +225,7 @@ void onEvent (ev_t ev) {
 				  }
 		      }
 
-		      xEventGroupSetBits(loraEvent, evLORA_TX_COMPLETE);
+			  hal_lmic_tx_complete(LMIC_TXQ_DONE);
 		  }
 
 	      break;
@@ -224,6 +234,8 @@ void onEvent (ev_t ev) {
 	      break;
 
 	    case EV_RESET:
+	      // The uplink in progress, if any, is lost
+	      hal_lmic_reset();
 	      break;
 
 	    case EV_RXCOMPLETE:
@@ -274,6 +286,7 @@ static void lora_init(osjob_t *j) {
         // deep sleep, were session data is stored into RTC memory
         syslog(LOG_DEBUG, "lora: restore session from RTC");
         LMIC_setSession (0x1, DEVADDR, NWKSKEY, APPSKEY);
+        LMIC.seqnoUp = msgid;
         session_init = 1;
     }
 
@@ -499,6 +512,11 @@ driver_error_t *lora_mac_get(const char command, char **value) {
 }
 
 driver_error_t *lora_join() {
+	// The join completes in the LMIC thread, so it can't wait from there
+	if (hal_lmic_in_run_loop()) {
+		return driver_error(LORA_DRIVER, LORA_ERR_NOT_ALLOWED, "from a LoRa WAN callback");
+	}
+
     mtx_lock(&lora_mtx);
 
     // Sanity checks
@@ -550,9 +568,21 @@ driver_error_t *lora_join() {
 	return driver_error(LORA_DRIVER, LORA_ERR_UNEXPECTED_RESPONSE, NULL);
 }
 
-driver_error_t *lora_tx(int cnf, int port, const char *data) {
+// Completion of a synchronous transmission
+static void lora_tx_sync_done(void *arg, int status) {
+	switch (status) {
+		case LORA_TX_DONE:      xEventGroupSetBits(loraEvent, evLORA_TX_COMPLETE); break;
+		case LORA_TX_NOT_ACKED: xEventGroupSetBits(loraEvent, evLORA_ACK_NOT_RECEIVED); break;
+		case LORA_TX_DROPPED:   xEventGroupSetBits(loraEvent, evLORA_TX_DROPPED); break;
+		default:                xEventGroupSetBits(loraEvent, evLORA_TX_FAILED); break;
+	}
+}
+
+driver_error_t *lora_tx_async(int cnf, int port, const char *data, int prio, lora_tx_done *done, void *arg) {
+	lmic_txq_entry_t dropped;
 	uint8_t *payload;
 	uint8_t payload_len;
+	int res;
 	
     mtx_lock(&lora_mtx);
 
@@ -565,6 +595,7 @@ driver_error_t *lora_tx(int cnf, int port, const char *data) {
         if (!session_init) {
             // Session data is available, so set session if it has not yet been done
             LMIC_setSession (0x1, DEVADDR, NWKSKEY, APPSKEY);
+            LMIC.seqnoUp = msgid;
             session_init = 1;
         }
     } else {
@@ -591,33 +622,68 @@ driver_error_t *lora_tx(int cnf, int port, const char *data) {
 	// Convert input payload (coded in hex string) into a byte buffer
 	hex_string_to_val((char *)data, (char *)payload, payload_len, 0);
 
-	// Put message id
-	msgid++;
-
-	LMIC.seqnoUp = msgid;
-	payload[payload_len] = msgid;
-
 	// Set DR
 	if (!adr) {
 		LMIC_setDrTxpow(current_dr, 14);
 	}
 
-	// Send
-	hal_lmic_tx(port, payload, payload_len, cnf);
+	// Queue, the frame counter is set by LMIC when the uplink is sent
+	res = hal_lmic_tx(port, payload, payload_len, cnf, prio, done, arg, &dropped);
+	if (res < 0) {
+		free(payload);
+		mtx_unlock(&lora_mtx);
+		return driver_error(LORA_DRIVER, LORA_ERR_TX_QUEUE_FULL, NULL);
+	}
+
+	mtx_unlock(&lora_mtx);
+
+	// Complete the dropped transmission without the lock, its callback
+	// can transmit again
+	if ((res > 0) && dropped.done) {
+		dropped.done(dropped.arg, LORA_TX_DROPPED);
+	}
+
+	return NULL;
+}
+
+driver_error_t *lora_tx(int cnf, int port, const char *data) {
+	driver_error_t *error;
+
+	// The transmission completes in the LMIC thread, so it can't wait from
+	// there, use lora_tx_async instead
+	if (hal_lmic_in_run_loop()) {
+		return driver_error(LORA_DRIVER, LORA_ERR_NOT_ALLOWED, "from a LoRa WAN callback, use an asynchronous transmission");
+	}
+
+	mtx_lock(&lora_tx_mtx);
+
+	xEventGroupClearBits(loraEvent, evLORA_TX_COMPLETE | evLORA_ACK_NOT_RECEIVED | evLORA_TX_DROPPED | evLORA_TX_FAILED);
+
+	if ((error = lora_tx_async(cnf, port, data, LORA_TX_PRIO_DEFAULT, lora_tx_sync_done, NULL))) {
+		mtx_unlock(&lora_tx_mtx);
+		return error;
+	}
 
 	// Wait for one of the expected events
-    EventBits_t uxBits = xEventGroupWaitBits(loraEvent, evLORA_TX_COMPLETE | evLORA_ACK_NOT_RECEIVED, pdTRUE, pdFALSE, portMAX_DELAY);
+    EventBits_t uxBits = xEventGroupWaitBits(loraEvent, evLORA_TX_COMPLETE | evLORA_ACK_NOT_RECEIVED | evLORA_TX_DROPPED | evLORA_TX_FAILED, pdTRUE, pdFALSE, portMAX_DELAY);
+
+	mtx_unlock(&lora_tx_mtx);
+
     if (uxBits & (evLORA_TX_COMPLETE)) {
-	    mtx_unlock(&lora_mtx);   
 		return NULL;
     }
 
     if (uxBits & (evLORA_ACK_NOT_RECEIVED)) {
-        mtx_unlock(&lora_mtx);
         return driver_error(LORA_DRIVER, LORA_ERR_TRANSMISSION_FAIL_ACK_NOT_RECEIVED, NULL);
     }
-	
-	mtx_unlock(&lora_mtx);
+
+    if (uxBits & (evLORA_TX_DROPPED)) {
+        return driver_error(LORA_DRIVER, LORA_ERR_TX_DROPPED, NULL);
+    }
+
+    if (uxBits & (evLORA_TX_FAILED)) {
+        return driver_error(LORA_DRIVER, LORA_ERR_TX_FAILED, NULL);
+    }
 
     return driver_error(LORA_DRIVER, LORA_ERR_UNEXPECTED_RESPONSE, NULL);
 }
@@ -646,7 +712,8 @@ void os_getDevKey (u1_t* buf) {
 
 void _lora_init() {
     // Create lora mutex
-    mtx_init(&lora_mtx, NULL, NULL, 0);
+    mtx_init(&lora_mtx, "lora", NULL, 0);
+    mtx_init(&lora_tx_mtx, "lora_tx", NULL, 0);
 
     // LMIC need to mantain some information in RTC
     status_set(STATUS_NEED_RTC_SLOW_MEM, 0x00000000);
@@ -0,0 +1,87 @@
+/*******************************************************************************
+ * Copyright (c) 2014-2015 IBM Corporation.
+ * All rights reserved. This program and the accompanying materials
+ * are made available under the terms of the Eclipse Public License v1.0
+ * which accompanies this distribution, and is available at
+ * http://www.eclipse.org/legal/epl-v10.html
+ *
+ * Contributors:
+ *    IBM Zurich Research Lab - initial API, implementation and documentation
+ *******************************************************************************/
+
+#include "sdkconfig.h"
+
+#if CONFIG_LUA_RTOS_LORA_HW_TYPE_SX1276 || CONFIG_LUA_RTOS_LORA_HW_TYPE_SX1272
+
+#include "oslmic.h"
+
+// Deadlines are compared by difference, not by absolute value
+#define DEADLINE_AFTER(a,b) ((s8_t)((a) - (b)) > 0)
+
+static u1_t unlinkjob (osjob_t** pnext, osjob_t* job) {
+    for( ; *pnext; pnext = &((*pnext)->next)) {
+        if(*pnext == job) { // unlink
+            *pnext = job->next;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void os_schedClear (struct os_sched* s, xref2osjob_t job) {
+    if( !unlinkjob(&s->scheduledjobs, job) )
+        unlinkjob(&s->runnablejobs, job);
+}
+
+void os_schedRun (struct os_sched* s, xref2osjob_t job, osjobcb_t cb) {
+    osjob_t** pnext;
+    // remove if job was already queued
+    os_schedClear(s, job);
+    // fill-in job
+    job->func = cb;
+    job->next = NULL;
+    // add to end of run queue
+    for(pnext=&s->runnablejobs; *pnext; pnext=&((*pnext)->next));
+    *pnext = job;
+}
+
+void os_schedTimed (struct os_sched* s, xref2osjob_t job, ostime_t time, osjobcb_t cb) {
+    osjob_t** pnext;
+    // remove if job was already queued
+    os_schedClear(s, job);
+    // fill-in job
+    job->deadline = time;
+    job->func = cb;
+    job->next = NULL;
+    // insert into schedule, after the jobs with the same deadline
+    for(pnext=&s->scheduledjobs; *pnext; pnext=&((*pnext)->next)) {
+        if( DEADLINE_AFTER((*pnext)->deadline, time) ) {
+            // enqueue before next element and stop
+            job->next = *pnext;
+            break;
+        }
+    }
+    *pnext = job;
+}
+
+xref2osjob_t os_schedNext (struct os_sched* s, ostime_t now) {
+    osjob_t* j = NULL;
+
+    if( s->runnablejobs ) {
+        j = s->runnablejobs;
+        s->runnablejobs = j->next;
+    } else if( s->scheduledjobs && !DEADLINE_AFTER(s->scheduledjobs->deadline, now) ) { // expired timed job
+        j = s->scheduledjobs;
+        s->scheduledjobs = j->next;
+    }
+    return j;
+}
+
+bit_t os_schedWakeup (struct os_sched* s, ostime_t* time) {
+    if( !s->scheduledjobs )
+        return 0;
+    *time = s->scheduledjobs->deadline;
+    return 1;
+}
+
+#endif
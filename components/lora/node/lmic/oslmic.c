@@ -37,10 +37,7 @@ void *os_runloop(void *pvParameters);
 TaskHandle_t xRunLoop = NULL;
 
 // RUNTIME STATE
-static struct {
-    osjob_t* scheduledjobs;
-    osjob_t* runnablejobs;
-} OS;
+static struct os_sched OS;
 
 driver_error_t *os_init () {
 	driver_error_t *error;
@@ -92,93 +89,57 @@ driver_error_t *os_init () {
     return NULL;
 }
 
-static u1_t unlinkjob (osjob_t** pnext, osjob_t* job) {
-    for( ; *pnext; pnext = &((*pnext)->next)) {
-        if(*pnext == job) { // unlink
-            *pnext = job->next;
-            return 1;
-        }
-    }
-    return 0;
-}
-
 // clear scheduled job
 void IRAM_ATTR os_clearCallback (osjob_t* job) {
     hal_disableIRQs();
-    unlinkjob(&OS.scheduledjobs, job);
-	unlinkjob(&OS.runnablejobs, job);
+    os_schedClear(&OS, job);
     hal_enableIRQs();
     hal_resume();
 }
 
 // schedule immediately runnable job
 void IRAM_ATTR os_setCallback (osjob_t* job, osjobcb_t cb) {
-    osjob_t** pnext;
     hal_disableIRQs();
-    // remove if job was already queued
-    os_clearCallback(job);
-    // fill-in job
-    job->func = cb;
-    job->next = NULL;
-    // add to end of run queue
-    for(pnext=&OS.runnablejobs; *pnext; pnext=&((*pnext)->next));
-    *pnext = job;
+    os_schedRun(&OS, job, cb);
     hal_enableIRQs();
     hal_resume();
 }
 
 // schedule timed job
 void os_setTimedCallback (osjob_t* job, ostime_t time, osjobcb_t cb) {
-    osjob_t** pnext;
     hal_disableIRQs();
-    // remove if job was already queued
-    os_clearCallback(job);
-    // fill-in job
-    job->deadline = time;
-    job->func = cb;
-    job->next = NULL;
-    // insert into schedule
-    for(pnext=&OS.scheduledjobs; *pnext; pnext=&((*pnext)->next)) {
-        if((*pnext)->deadline - time > 0) { // (cmp diff, not abs!)
-            // enqueue before next element and stop
-            job->next = *pnext;
-            break;
-        }
-    }
-    *pnext = job;
+    os_schedTimed(&OS, job, time, cb);
     hal_enableIRQs();
     hal_resume();
 }
 
 // LMIC run loop, as a FreeRTOS task
 void *os_runloop(void *pvParameters) {
+	xRunLoop = xTaskGetCurrentTaskHandle();
+
 	for(;;) {
-	    osjob_t *j = NULL;
+	    osjob_t *j;
+	    ostime_t wakeup;
+	    bit_t timed;
 
 	    hal_disableIRQs();
 
+	    // Is there any command?
 	    hal_lmic_command();
 
-	    // check for runnable jobs
-		j = NULL;
-	    if(OS.runnablejobs) {
-	        j = OS.runnablejobs;
-	        OS.runnablejobs = j->next;
-	    } else if(OS.scheduledjobs && hal_checkTimer(OS.scheduledjobs->deadline)) { // check for expired timed jobs
-	        j = OS.scheduledjobs;
-	        OS.scheduledjobs = j->next;
-	    }
-
-	    // Is there any command?
+	    // check for runnable jobs, or expired timed jobs
+	    j = os_schedNext(&OS, os_getTime());
+	    timed = os_schedWakeup(&OS, &wakeup);
 
 	    hal_enableIRQs();
 
 	    if (j) { // run job callback
 	        j->func(j);
+	    } else if (timed) {
+	        // sleep until the next timed job, a radio interrupt, or a command
+	        hal_sleepUntil(wakeup);
 	    } else {
-	    	if (!OS.scheduledjobs) {
-	    		hal_sleep();
-	    	}
+	        hal_sleep();
 	    }
 	}
 
@@ -133,6 +133,21 @@ struct osjob_t {
 };
 TYPEDEF_xref2osjob_t;
 
+// Job lists of the run loop. These functions don't lock, the os_ functions
+// call them with IRQs disabled.
+struct os_sched {
+    osjob_t* scheduledjobs;   // timed jobs, by deadline
+    osjob_t* runnablejobs;    // immediately runnable jobs, in FIFO order
+};
+
+void os_schedClear (struct os_sched* s, xref2osjob_t job);
+void os_schedRun (struct os_sched* s, xref2osjob_t job, osjobcb_t cb);
+void os_schedTimed (struct os_sched* s, xref2osjob_t job, ostime_t time, osjobcb_t cb);
+//! Unlink and return the next job to run at time now, or NULL.
+xref2osjob_t os_schedNext (struct os_sched* s, ostime_t now);
+//! Get the deadline of the next timed job. Return 0 if there are no timed jobs.
+bit_t os_schedWakeup (struct os_sched* s, ostime_t* time);
+
 
 #ifndef HAS_os_calls
 
@@ -283,6 +298,21 @@ extern xref2u1_t AESaux;
 u4_t os_aes (u1_t mode, xref2u1_t buf, u2_t len);
 #endif
 
+// Block cipher used by os_aes. begin loads the key and takes the engine,
+// then any number of runs can be done until end is called.
+struct os_aes_backend {
+    void (*begin) (xref2cu1_t key);
+    void (*ecb)   (xref2u1_t buf, u2_t nblk);               // encrypt nblk blocks in place
+    void (*cbc)   (xref2u1_t x, xref2cu1_t buf, u2_t nblk); // x = E(x ^ block) for each block
+    void (*end)   (void);
+};
+
+extern const struct os_aes_backend os_aes_sw;   // lookup tables, reference
+#if CONFIG_LUA_RTOS_LORA_HW_AES
+extern const struct os_aes_backend os_aes_hw;   // ESP32 AES accelerator
+#endif
+extern const struct os_aes_backend* os_aes_backend;
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -267,37 +267,23 @@ static u1_t randbuf[16];
 #endif
 
 
+// Register and FIFO accesses are done in a single SPI transaction each
 static void IRAM_ATTR writeReg (u1_t addr, u1_t data ) {
-    hal_pin_nss(0);
-    hal_spi(addr | 0x80);
-    hal_spi(data);
-    hal_pin_nss(1);
+    hal_spi_write(addr, &data, 1);
 }
 
 static u1_t IRAM_ATTR readReg (u1_t addr) {
-    hal_pin_nss(0);
-    hal_spi(addr & 0x7F);
-    u1_t val = hal_spi(0x00);
-    hal_pin_nss(1);
+    u1_t val;
+    hal_spi_read(addr, &val, 1);
     return val;
 }
 
 static void writeBuf (u1_t addr, xref2u1_t buf, u1_t len) {
-    hal_pin_nss(0);
-    hal_spi(addr | 0x80);
-    for (u1_t i=0; i<len; i++) {
-        hal_spi(buf[i]);
-    }
-    hal_pin_nss(1);
+    hal_spi_write(addr, buf, len);
 }
 
 static void IRAM_ATTR readBuf (u1_t addr, xref2u1_t buf, u1_t len) {
-    hal_pin_nss(0);
-    hal_spi(addr & 0x7F);
-    for (u1_t i=0; i<len; i++) {
-        buf[i] = hal_spi(0x00);
-    }
-    hal_pin_nss(1);
+    hal_spi_read(addr, buf, len);
 }
 
 static void IRAM_ATTR opmode (u1_t mode) {
@@ -396,9 +382,8 @@ static void configLoraModem () {
 static void configChannel () {
     // set frequency: FQ = (FRF * 32 Mhz) / (2 ^ 19)
     uint64_t frf = ((uint64_t)LMIC.freq << 19) / 32000000;
-    writeReg(RegFrfMsb, (u1_t)(frf>>16));
-    writeReg(RegFrfMid, (u1_t)(frf>> 8));
-    writeReg(RegFrfLsb, (u1_t)(frf>> 0));
+    u1_t frfbuf[3] = { (u1_t)(frf>>16), (u1_t)(frf>> 8), (u1_t)(frf>> 0) };
+    writeBuf(RegFrfMsb, frfbuf, 3); // RegFrfMsb, RegFrfMid, RegFrfLsb
 }
 
 
@@ -723,9 +708,8 @@ int radio_init () {
 
     // Sets a Frequency in HF band
     u4_t frf = 868000000;
-    writeReg(RegFrfMsb, (u1_t)(frf>>16));
-    writeReg(RegFrfMid, (u1_t)(frf>> 8));
-    writeReg(RegFrfLsb, (u1_t)(frf>> 0));
+    u1_t frfbuf[3] = { (u1_t)(frf>>16), (u1_t)(frf>> 8), (u1_t)(frf>> 0) };
+    writeBuf(RegFrfMsb, frfbuf, 3); // RegFrfMsb, RegFrfMid, RegFrfLsb
 
     // Launch Rx chain calibration for HF band
     writeReg(FSKRegImageCal, (readReg(FSKRegImageCal) & RF_IMAGECAL_IMAGECAL_MASK)|RF_IMAGECAL_IMAGECAL_START);
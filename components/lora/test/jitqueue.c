@@ -0,0 +1,379 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, LoRa gateway JiT queue test cases
+ *
+ */
+
+#include "sdkconfig.h"
+
+#if CONFIG_LUA_RTOS_LORA_HW_TYPE_SX1301
+
+#include "unity.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "jitqueue.h"
+
+#define TX_START_DELAY       1500
+#define TX_MARGIN_DELAY      1000
+#define TX_JIT_DELAY         30000
+#define TX_MAX_ADVANCE_DELAY ((JIT_NUM_BEACON_IN_QUEUE + 1) * 128 * 1000000U)
+#define BEACON_GUARD         3000000
+#define BEACON_RESERVED      2120000
+
+/*
+ * Reference queue: an unordered array, searched linearly, as the queue was
+ * implemented before
+ */
+typedef struct {
+	uint32_t count_us;
+	uint32_t pre_delay;
+	uint32_t post_delay;
+	enum jit_pkt_type_e type;
+} ref_node_t;
+
+typedef struct {
+	int num;
+	ref_node_t nodes[JIT_QUEUE_MAX];
+} ref_queue_t;
+
+static struct jit_queue_s queue;
+static ref_queue_t ref;
+
+static uint32_t rnd(uint32_t max) {
+	return (uint32_t)(((uint64_t)rand() * max) / ((uint64_t)RAND_MAX + 1));
+}
+
+static void to_timeval(uint32_t time_us, struct timeval *tv) {
+	tv->tv_sec = time_us / 1000000;
+	tv->tv_usec = time_us % 1000000;
+}
+
+static void ref_delays(struct lgw_pkt_tx_s *pkt, enum jit_pkt_type_e type, uint32_t *pre_delay, uint32_t *post_delay) {
+	if (type == JIT_PKT_TYPE_BEACON) {
+		*pre_delay = TX_START_DELAY + BEACON_GUARD + TX_JIT_DELAY;
+		*post_delay = BEACON_RESERVED;
+	} else {
+		*pre_delay = TX_START_DELAY + TX_JIT_DELAY;
+		*post_delay = lgw_time_on_air(pkt) * 1000UL;
+	}
+}
+
+// Mask of the types of the reference nodes colliding with a packet
+static uint32_t ref_collisions(ref_queue_t *q, uint32_t count_us, uint32_t pre_delay, uint32_t post_delay, enum jit_pkt_type_e type) {
+	uint32_t types = 0;
+	uint32_t target_pre_delay;
+	int i;
+
+	for(i = 0;i < q->num;i++) {
+		if (((type == JIT_PKT_TYPE_DOWNLINK_CLASS_A) || (type == JIT_PKT_TYPE_DOWNLINK_CLASS_C)) && (q->nodes[i].type == JIT_PKT_TYPE_BEACON)) {
+			target_pre_delay = TX_START_DELAY;
+		} else {
+			target_pre_delay = q->nodes[i].pre_delay;
+		}
+
+		if (jit_collision_test(count_us, pre_delay, post_delay, q->nodes[i].count_us, target_pre_delay, q->nodes[i].post_delay)) {
+			types |= (1 << q->nodes[i].type);
+		}
+	}
+
+	return types;
+}
+
+// Index of the reference node to send first, -1 if none
+static int ref_first(ref_queue_t *q, uint32_t now) {
+	int first = -1;
+	int i;
+
+	for(i = 0;i < q->num;i++) {
+		if ((q->nodes[i].count_us - now) >= TX_MAX_ADVANCE_DELAY) {
+			// Outdated, dropped
+			q->nodes[i--] = q->nodes[--q->num];
+			continue;
+		}
+
+		if ((first < 0) || ((q->nodes[i].count_us - now) < (q->nodes[first].count_us - now))) {
+			first = i;
+		}
+	}
+
+	return first;
+}
+
+static void random_packet(struct lgw_pkt_tx_s *pkt, enum jit_pkt_type_e *type, uint32_t now) {
+	memset(pkt, 0, sizeof(*pkt));
+
+	pkt->size = 1 + rnd(64);
+	switch (rnd(8)) {
+		case 0:
+			*type = JIT_PKT_TYPE_BEACON;
+			pkt->count_us = now + rnd(3 * 128000000U);
+			break;
+		case 1:
+			*type = JIT_PKT_TYPE_DOWNLINK_CLASS_B;
+			pkt->count_us = now + rnd(130000000U);
+			break;
+		case 2:
+			// Sometimes too late, or too early
+			*type = JIT_PKT_TYPE_DOWNLINK_CLASS_A;
+			pkt->count_us = now + (rnd(2)?rnd(40000):(TX_MAX_ADVANCE_DELAY + rnd(1000000)));
+			break;
+		default:
+			*type = JIT_PKT_TYPE_DOWNLINK_CLASS_A;
+			pkt->count_us = now + 100000 + rnd(20000000U);
+			break;
+	}
+}
+
+TEST_CASE("jit queue, random traffic", "[lora]") {
+	struct lgw_pkt_tx_s pkt, out;
+	enum jit_pkt_type_e type, out_type;
+	enum jit_error_e expected, result;
+	uint32_t pre_delay, post_delay, collisions;
+	struct timeval tv;
+	int i, first, idx, j;
+
+	// Start near the roll-over of the concentrator counter
+	uint32_t now = 0xffffffffU - 30000000U;
+
+	srand(1234);
+
+	jit_queue_init(&queue);
+	memset(&ref, 0, sizeof(ref));
+
+	for(i = 0;i < 200000;i++) {
+		to_timeval(now, &tv);
+
+		if (rnd(3) != 0) {
+			random_packet(&pkt, &type, now);
+			ref_delays(&pkt, type, &pre_delay, &post_delay);
+
+			if (ref.num == JIT_QUEUE_MAX) {
+				expected = JIT_ERROR_FULL;
+			} else if ((pkt.count_us - now) <= (TX_START_DELAY + TX_MARGIN_DELAY + TX_JIT_DELAY)) {
+				expected = JIT_ERROR_TOO_LATE;
+			} else if ((type != JIT_PKT_TYPE_BEACON) && ((pkt.count_us - now) > TX_MAX_ADVANCE_DELAY)) {
+				expected = JIT_ERROR_TOO_EARLY;
+			} else {
+				expected = JIT_ERROR_OK;
+			}
+
+			collisions = 0;
+			if (expected == JIT_ERROR_OK) {
+				collisions = ref_collisions(&ref, pkt.count_us, pre_delay, post_delay, type);
+			}
+
+			result = jit_enqueue(&queue, &tv, &pkt, type);
+
+			if (collisions) {
+				// The reported collision is one of the colliding packets
+				TEST_ASSERT((result == JIT_ERROR_COLLISION_PACKET) || (result == JIT_ERROR_COLLISION_BEACON));
+				if (result == JIT_ERROR_COLLISION_BEACON) {
+					TEST_ASSERT(collisions & (1 << JIT_PKT_TYPE_BEACON));
+				} else {
+					TEST_ASSERT(collisions & ~(1 << JIT_PKT_TYPE_BEACON));
+				}
+			} else {
+				TEST_ASSERT_EQUAL(expected, result);
+			}
+
+			if (result == JIT_ERROR_OK) {
+				ref.nodes[ref.num].count_us = pkt.count_us;
+				ref.nodes[ref.num].pre_delay = pre_delay;
+				ref.nodes[ref.num].post_delay = post_delay;
+				ref.nodes[ref.num].type = type;
+				ref.num++;
+			}
+		} else {
+			// Advance time, and send the packets that are due
+			now += rnd(3000000);
+			to_timeval(now, &tv);
+
+			for(;;) {
+				first = ref_first(&ref, now);
+
+				result = jit_peek(&queue, &tv, &idx);
+				if (ref.num == 0) {
+					TEST_ASSERT((result == JIT_ERROR_EMPTY) || (idx == -1));
+					break;
+				}
+
+				TEST_ASSERT_EQUAL(JIT_ERROR_OK, result);
+				TEST_ASSERT_EQUAL(ref.num, queue.num_pkt);
+
+				if ((ref.nodes[first].count_us - now) >= TX_JIT_DELAY) {
+					TEST_ASSERT_EQUAL(-1, idx);
+					break;
+				}
+
+				TEST_ASSERT(idx >= 0);
+				TEST_ASSERT_EQUAL(JIT_ERROR_OK, jit_dequeue(&queue, idx, &out, &out_type));
+				TEST_ASSERT_EQUAL(ref.nodes[first].count_us, out.count_us);
+				TEST_ASSERT_EQUAL(ref.nodes[first].type, out_type);
+
+				ref.nodes[first] = ref.nodes[--ref.num];
+			}
+		}
+
+		// Beacon count is kept
+		for(j = 0, idx = 0;j < ref.num;j++) {
+			idx += (ref.nodes[j].type == JIT_PKT_TYPE_BEACON);
+		}
+		TEST_ASSERT_EQUAL(idx, queue.num_beacon);
+	}
+
+	// A node that is not in use can't be dequeued
+	jit_queue_init(&queue);
+	TEST_ASSERT_EQUAL(JIT_ERROR_EMPTY, jit_dequeue(&queue, 0, &out, &out_type));
+}
+
+TEST_CASE("jit queue, class C downlinks", "[lora]") {
+	struct lgw_pkt_tx_s pkt;
+	struct timeval tv;
+	uint32_t now = 0xffffffffU - 1000000U;
+	uint32_t pre_delay, post_delay, last = 0;
+	int i, j;
+
+	jit_queue_init(&queue);
+	memset(&ref, 0, sizeof(ref));
+	to_timeval(now, &tv);
+
+	// Immediate downlinks get a free slot, without colliding with the
+	// enqueued packets
+	for(i = 0;i < JIT_QUEUE_MAX;i++) {
+		memset(&pkt, 0, sizeof(pkt));
+		pkt.size = 1 + rnd(64);
+
+		TEST_ASSERT_EQUAL(JIT_ERROR_OK, jit_enqueue(&queue, &tv, &pkt, JIT_PKT_TYPE_DOWNLINK_CLASS_C));
+		TEST_ASSERT_EQUAL(TIMESTAMPED, pkt.tx_mode);
+
+		ref_delays(&pkt, JIT_PKT_TYPE_DOWNLINK_CLASS_C, &pre_delay, &post_delay);
+		TEST_ASSERT_EQUAL(0, ref_collisions(&ref, pkt.count_us, pre_delay, post_delay, JIT_PKT_TYPE_DOWNLINK_CLASS_C));
+
+		if (i > 0) {
+			TEST_ASSERT((int32_t)(pkt.count_us - last) > 0);
+		}
+		last = pkt.count_us;
+
+		ref.nodes[ref.num].count_us = pkt.count_us;
+		ref.nodes[ref.num].pre_delay = pre_delay;
+		ref.nodes[ref.num].post_delay = post_delay;
+		ref.nodes[ref.num].type = JIT_PKT_TYPE_DOWNLINK_CLASS_C;
+		ref.num++;
+	}
+
+	TEST_ASSERT_EQUAL(JIT_ERROR_FULL, jit_enqueue(&queue, &tv, &pkt, JIT_PKT_TYPE_DOWNLINK_CLASS_C));
+
+	// Queue is in timestamp order
+	for(j = 1;j < queue.num_pkt;j++) {
+		TEST_ASSERT((int32_t)(queue.nodes[queue.order[j]].pkt.count_us - queue.nodes[queue.order[j - 1]].pkt.count_us) >= 0);
+	}
+}
+
+static uint64_t now_us() {
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+
+	return ((uint64_t)tv.tv_sec * 1000000) + tv.tv_usec;
+}
+
+TEST_CASE("jit queue, collision search performance", "[lora]") {
+	struct lgw_pkt_tx_s pkt;
+	struct timeval tv;
+	uint32_t pre_delay, post_delay;
+	uint64_t begin, end;
+	double queue_rate, ref_rate;
+	volatile uint32_t found = 0;
+	int i, n;
+
+	uint32_t now = 1000000;
+
+	// Fill the queue with class B downlinks, 1 second apart, keeping a free
+	// node
+	jit_queue_init(&queue);
+	memset(&ref, 0, sizeof(ref));
+	to_timeval(now, &tv);
+
+	for(i = 0;i < JIT_QUEUE_MAX - 1;i++) {
+		memset(&pkt, 0, sizeof(pkt));
+		pkt.size = 10;
+		pkt.count_us = now + 1000000 * (i + 1);
+		TEST_ASSERT_EQUAL(JIT_ERROR_OK, jit_enqueue(&queue, &tv, &pkt, JIT_PKT_TYPE_DOWNLINK_CLASS_B));
+
+		ref_delays(&pkt, JIT_PKT_TYPE_DOWNLINK_CLASS_B, &pre_delay, &post_delay);
+		ref.nodes[ref.num].count_us = pkt.count_us;
+		ref.nodes[ref.num].pre_delay = pre_delay;
+		ref.nodes[ref.num].post_delay = post_delay;
+		ref.nodes[ref.num].type = JIT_PKT_TYPE_DOWNLINK_CLASS_B;
+		ref.num++;
+	}
+
+	// Each attempt collides, so it isn't enqueued
+	n = 20000;
+
+	begin = now_us();
+	for(i = 0;i < n;i++) {
+		pkt.count_us = now + 1000000 * (1 + (i % (JIT_QUEUE_MAX - 1))) + 500;
+		found += (jit_enqueue(&queue, &tv, &pkt, JIT_PKT_TYPE_DOWNLINK_CLASS_B) == JIT_ERROR_COLLISION_PACKET);
+	}
+	end = now_us();
+	queue_rate = (n * 1000000.0) / (end - begin + 1);
+
+	begin = now_us();
+	for(i = 0;i < n;i++) {
+		pkt.count_us = now + 1000000 * (1 + (i % (JIT_QUEUE_MAX - 1))) + 500;
+		found += (ref_collisions(&ref, pkt.count_us, pre_delay, post_delay, JIT_PKT_TYPE_DOWNLINK_CLASS_B) != 0);
+	}
+	end = now_us();
+	ref_rate = (n * 1000000.0) / (end - begin + 1);
+
+	TEST_ASSERT_EQUAL(2 * n, found);
+
+	printf("jit queue, %d packets: %.0f enqueue checks per second, array scan %.0f collision checks per second\r\n", JIT_QUEUE_MAX - 1, queue_rate, ref_rate);
+}
+
+#endif
@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, LMIC AES test cases
+ *
+ */
+
+#include "sdkconfig.h"
+
+#if CONFIG_LUA_RTOS_LORA_HW_TYPE_SX1276 || CONFIG_LUA_RTOS_LORA_HW_TYPE_SX1272
+
+#include "unity.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "oslmic.h"
+
+#define BENCH_PACKETS 10000
+
+// RFC 4493 key and messages
+static const uint8_t cmac_key[16] = {
+    0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+};
+
+static const uint8_t cmac_msg[64] = {
+    0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+    0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+    0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11, 0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+    0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17, 0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10
+};
+
+// LoRaWAN uplink 40F17DBE4900020001954378762B11FF0D
+static const uint8_t lw_nwkskey[16] = {
+    0x44, 0x02, 0x42, 0x41, 0xed, 0x4c, 0xe9, 0xa6, 0x8c, 0x6a, 0x8b, 0xc0, 0x55, 0x23, 0x3f, 0xd3
+};
+
+static const uint8_t lw_appskey[16] = {
+    0xec, 0x92, 0x58, 0x02, 0xae, 0x43, 0x0c, 0xa7, 0x7f, 0xd3, 0xdd, 0x73, 0xcb, 0x2c, 0xc5, 0x88
+};
+
+static const uint8_t lw_pdu[17] = {
+    0x40, 0xf1, 0x7d, 0xbe, 0x49, 0x00, 0x02, 0x00, 0x01, 0x95, 0x43, 0x78, 0x76, 0x2b, 0x11, 0xff,
+    0x0d
+};
+
+#define LW_DEVADDR 0x49be7df1
+#define LW_FCNT    2
+
+static void lw_aux(uint8_t b0, int len, uint32_t devaddr, uint32_t seqno) {
+    memset(AESaux, 0, 16);
+    AESaux[0] = b0;
+    AESaux[5] = 0; // uplink
+    AESaux[6] = devaddr; AESaux[7] = devaddr >> 8; AESaux[8] = devaddr >> 16; AESaux[9] = devaddr >> 24;
+    AESaux[10] = seqno; AESaux[11] = seqno >> 8; AESaux[12] = seqno >> 16; AESaux[13] = seqno >> 24;
+    AESaux[15] = len;
+}
+
+static uint32_t cmac(const uint8_t *key, uint8_t *msg, int len) {
+    memcpy(AESkey, key, 16);
+    return os_aes(AES_MIC | AES_MICNOAUX, msg, len);
+}
+
+static void test_vectors(const struct os_aes_backend *backend) {
+    const struct os_aes_backend *prev = os_aes_backend;
+    uint8_t buf[64];
+
+    os_aes_backend = backend;
+
+    // FIPS-197 C.1
+    static const uint8_t fips_ct[16] = {
+        0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30, 0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a
+    };
+    int i;
+
+    for (i = 0; i < 16; i++) {
+        AESkey[i] = i;
+        buf[i] = (i << 4) | i;
+    }
+    os_aes(AES_ENC, buf, 16);
+    TEST_ASSERT_EQUAL_MEMORY(fips_ct, buf, 16);
+
+    // RFC 4493 examples 1 to 4
+    memcpy(buf, cmac_msg, sizeof(cmac_msg));
+    TEST_ASSERT_EQUAL_HEX32(0xbb1d6929, cmac(cmac_key, buf, 0));
+    TEST_ASSERT_EQUAL_HEX32(0x070a16b4, cmac(cmac_key, buf, 16));
+    TEST_ASSERT_EQUAL_HEX32(0xdfa66747, cmac(cmac_key, buf, 40));
+    TEST_ASSERT_EQUAL_HEX32(0x51f0bebf, cmac(cmac_key, buf, 64));
+    TEST_ASSERT_EQUAL_MEMORY(cmac_msg, buf, sizeof(cmac_msg));
+
+    // LoRaWAN MIC, over the B0 block and the PDU
+    memcpy(buf, lw_pdu, sizeof(lw_pdu));
+    lw_aux(0x49, 13, LW_DEVADDR, LW_FCNT);
+    memcpy(AESkey, lw_nwkskey, 16);
+    TEST_ASSERT_EQUAL_HEX32(0x2b11ff0d, os_aes(AES_MIC, buf, 13));
+
+    // LoRaWAN FRMPayload encryption
+    lw_aux(0x01, 1, LW_DEVADDR, LW_FCNT);
+    memcpy(AESkey, lw_appskey, 16);
+    os_aes(AES_CTR, buf + 9, 4);
+    TEST_ASSERT_EQUAL_MEMORY("test", buf + 9, 4);
+
+    os_aes_backend = prev;
+}
+
+TEST_CASE("lmic aes software backend vectors", "[lora]") {
+    test_vectors(&os_aes_sw);
+}
+
+#if CONFIG_LUA_RTOS_LORA_HW_AES
+TEST_CASE("lmic aes hardware backend vectors", "[lora]") {
+    test_vectors(&os_aes_hw);
+}
+#endif
+
+TEST_CASE("lmic aes ctr is an involution across runs", "[lora]") {
+    uint8_t key[16], aux[16], plain[200], buf[200];
+    int i, len;
+
+    srand(63);
+    for (i = 0; i < 16; i++) {
+        key[i] = rand();
+        aux[i] = rand();
+    }
+    aux[12] = aux[13] = aux[14] = aux[15] = 0xff; // counter wraps after one block
+
+    for (len = 1; len <= sizeof(buf); len += 7) {
+        for (i = 0; i < len; i++) {
+            plain[i] = buf[i] = rand();
+        }
+
+        memcpy(AESkey, key, 16);
+        memcpy(AESaux, aux, 16);
+        os_aes(AES_CTR, buf, len);
+        TEST_ASSERT(memcmp(plain, buf, len) != 0);
+
+        memcpy(AESkey, key, 16);
+        memcpy(AESaux, aux, 16);
+        os_aes(AES_CTR, buf, len);
+        TEST_ASSERT_EQUAL_MEMORY(plain, buf, len);
+    }
+}
+
+TEST_CASE("lmic aes mic benchmark", "[lora]") {
+    struct timeval start, end;
+    uint8_t buf[sizeof(lw_pdu)];
+    uint32_t mic = 0;
+    int i;
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < BENCH_PACKETS; i++) {
+        memcpy(buf, lw_pdu, sizeof(lw_pdu));
+        lw_aux(0x49, 13, LW_DEVADDR, LW_FCNT);
+        memcpy(AESkey, lw_nwkskey, 16);
+        mic = os_aes(AES_MIC, buf, 13);
+    }
+    gettimeofday(&end, NULL);
+
+    TEST_ASSERT_EQUAL_HEX32(0x2b11ff0d, mic);
+
+    printf("%d MICs in %ld usecs\n", BENCH_PACKETS,
+           (long)((end.tv_sec - start.tv_sec) * 1000000 + (end.tv_usec - start.tv_usec)));
+}
+
+#endif
@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, LMIC uplink queue test cases
+ *
+ */
+
+#include "sdkconfig.h"
+
+#if CONFIG_LUA_RTOS_LORA_HW_TYPE_SX1276 || CONFIG_LUA_RTOS_LORA_HW_TYPE_SX1272
+
+#include "unity.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "oslmic.h"
+#include "lmic_txq.h"
+
+static lmic_txq_entry_t uplink(uint8_t port, uint8_t prio) {
+	lmic_txq_entry_t e;
+
+	memset(&e, 0, sizeof(e));
+	e.port = port;
+	e.prio = prio;
+
+	return e;
+}
+
+static int ran[8];
+static int ran_count;
+
+static void job_a(osjob_t *job) { ran[ran_count++] = 'a'; }
+static void job_b(osjob_t *job) { ran[ran_count++] = 'b'; }
+static void job_c(osjob_t *job) { ran[ran_count++] = 'c'; }
+
+TEST_CASE("lmic txq dispatch order", "[lora]") {
+	lmic_txq_t q;
+	lmic_txq_entry_t e, dropped;
+	uint8_t expected[] = {4, 2, 5, 1, 3};
+	int i;
+
+	lmic_txq_init(&q);
+
+	// Priorities 1, 2, 1, 3, 2
+	e = uplink(1, 1); TEST_ASSERT_EQUAL(0, lmic_txq_put(&q, &e, &dropped));
+	e = uplink(2, 2); TEST_ASSERT_EQUAL(0, lmic_txq_put(&q, &e, &dropped));
+	e = uplink(3, 1); TEST_ASSERT_EQUAL(0, lmic_txq_put(&q, &e, &dropped));
+	e = uplink(4, 3); TEST_ASSERT_EQUAL(0, lmic_txq_put(&q, &e, &dropped));
+	e = uplink(5, 2); TEST_ASSERT_EQUAL(0, lmic_txq_put(&q, &e, &dropped));
+
+	TEST_ASSERT_EQUAL(5, lmic_txq_count(&q));
+
+	// By priority, and in arrival order for the same priority. Only one
+	// uplink in progress at a time.
+	for (i = 0; i < sizeof(expected); i++) {
+		TEST_ASSERT_EQUAL(1, lmic_txq_get(&q, 0, &e));
+		TEST_ASSERT_EQUAL(expected[i], e.port);
+		TEST_ASSERT_EQUAL(0, lmic_txq_get(&q, 0, &e));
+		TEST_ASSERT_EQUAL(1, lmic_txq_complete(&q, 0, &e));
+		TEST_ASSERT_EQUAL(expected[i], e.port);
+	}
+
+	TEST_ASSERT_EQUAL(0, lmic_txq_get(&q, 0, &e));
+	TEST_ASSERT_EQUAL(0, lmic_txq_complete(&q, 0, &e));
+}
+
+TEST_CASE("lmic txq full", "[lora]") {
+	lmic_txq_t q;
+	lmic_txq_entry_t e, dropped;
+	int i;
+
+	lmic_txq_init(&q);
+
+	for (i = 0; i < LMIC_TXQ_SIZE; i++) {
+		e = uplink(i + 1, (i == LMIC_TXQ_SIZE - 1) ? 1 : 2);
+		TEST_ASSERT_EQUAL(0, lmic_txq_put(&q, &e, &dropped));
+	}
+
+	// Same priority than the last one, rejected
+	e = uplink(100, 1);
+	TEST_ASSERT_EQUAL(-1, lmic_txq_put(&q, &e, &dropped));
+
+	// Higher priority, the last one is dropped
+	e = uplink(101, 3);
+	TEST_ASSERT_EQUAL(1, lmic_txq_put(&q, &e, &dropped));
+	TEST_ASSERT_EQUAL(LMIC_TXQ_SIZE, dropped.port);
+	TEST_ASSERT_EQUAL(LMIC_TXQ_SIZE, lmic_txq_count(&q));
+
+	TEST_ASSERT_EQUAL(1, lmic_txq_get(&q, 0, &e));
+	TEST_ASSERT_EQUAL(101, e.port);
+}
+
+TEST_CASE("lmic txq duty cycle gate", "[lora]") {
+	lmic_txq_t q;
+	lmic_txq_entry_t e, dropped;
+	uint64_t now = 1000;
+
+	lmic_txq_init(&q);
+
+	e = uplink(1, 1); lmic_txq_put(&q, &e, &dropped);
+	e = uplink(2, 1); lmic_txq_put(&q, &e, &dropped);
+
+	TEST_ASSERT_EQUAL(1, lmic_txq_get(&q, now, &e));
+
+	// Previous uplink completed, next one not before 5000
+	now += 100;
+	TEST_ASSERT_EQUAL(1, lmic_txq_complete(&q, 5000, &e));
+
+	// A higher priority uplink queued while the gate is closed is the first
+	// one when it opens
+	e = uplink(3, 2); lmic_txq_put(&q, &e, &dropped);
+
+	TEST_ASSERT_EQUAL(0, lmic_txq_get(&q, 4999, &e));
+	TEST_ASSERT_EQUAL(1, lmic_txq_get(&q, 5000, &e));
+	TEST_ASSERT_EQUAL(3, e.port);
+}
+
+TEST_CASE("lmic txq reset", "[lora]") {
+	lmic_txq_t q;
+	lmic_txq_entry_t e, dropped;
+
+	lmic_txq_init(&q);
+
+	e = uplink(1, 1); lmic_txq_put(&q, &e, &dropped);
+	e = uplink(2, 1); lmic_txq_put(&q, &e, &dropped);
+
+	TEST_ASSERT_EQUAL(1, lmic_txq_get(&q, 1000, &e));
+	TEST_ASSERT_EQUAL(0, lmic_txq_get(&q, 1000, &e));
+
+	// The uplink in progress is returned, and the next one can be dispatched
+	TEST_ASSERT_EQUAL(1, lmic_txq_reset(&q, &e));
+	TEST_ASSERT_EQUAL(1, e.port);
+	TEST_ASSERT_EQUAL(0, lmic_txq_complete(&q, 0, &e));
+	TEST_ASSERT_EQUAL(1, lmic_txq_get(&q, 1000, &e));
+	TEST_ASSERT_EQUAL(2, e.port);
+
+	// The duty cycle gate is cleared
+	TEST_ASSERT_EQUAL(1, lmic_txq_complete(&q, 5000, &e));
+	e = uplink(3, 1); lmic_txq_put(&q, &e, &dropped);
+	TEST_ASSERT_EQUAL(0, lmic_txq_reset(&q, &e));
+	TEST_ASSERT_EQUAL(1, lmic_txq_get(&q, 1000, &e));
+	TEST_ASSERT_EQUAL(3, e.port);
+}
+
+TEST_CASE("lmic scheduler", "[lora]") {
+	struct os_sched s;
+	osjob_t a, b, c;
+	ostime_t wakeup;
+
+	memset(&s, 0, sizeof(s));
+	ran_count = 0;
+
+	TEST_ASSERT_EQUAL(0, os_schedWakeup(&s, &wakeup));
+
+	// Timed jobs are kept by deadline, whatever the order they are set
+	os_schedTimed(&s, &a, 300, job_a);
+	os_schedTimed(&s, &b, 100, job_b);
+	os_schedTimed(&s, &c, 200, job_c);
+
+	TEST_ASSERT_EQUAL(1, os_schedWakeup(&s, &wakeup));
+	TEST_ASSERT_EQUAL(100, (int)wakeup);
+	TEST_ASSERT_NULL(os_schedNext(&s, 99));
+
+	// Rescheduling a job moves it
+	os_schedTimed(&s, &b, 250, job_b);
+	os_schedWakeup(&s, &wakeup);
+	TEST_ASSERT_EQUAL(200, (int)wakeup);
+
+	// Runnable jobs go first
+	os_schedRun(&s, &a, job_a);
+
+	osjob_t *j;
+	while ((j = os_schedNext(&s, 1000))) {
+		j->func(j);
+	}
+
+	TEST_ASSERT_EQUAL(3, ran_count);
+	TEST_ASSERT_EQUAL('a', ran[0]);
+	TEST_ASSERT_EQUAL('c', ran[1]);
+	TEST_ASSERT_EQUAL('b', ran[2]);
+	TEST_ASSERT_EQUAL(0, os_schedWakeup(&s, &wakeup));
+}
+
+#endif
@@ -0,0 +1,295 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, SX127x SPI burst test cases
+ *
+ */
+
+#include "sdkconfig.h"
+
+#if CONFIG_LUA_RTOS_LORA_HW_TYPE_SX1276 || CONFIG_LUA_RTOS_LORA_HW_TYPE_SX1272
+
+#include "unity.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_timer.h"
+
+#include <drivers/spi.h>
+
+#include "sx127x_spi.h"
+
+#define REG_FIFO          0x00
+#define REG_FR_MSB        0x06
+#define REG_FIFO_ADDR_PTR 0x0D
+#define REG_VERSION       0x42
+
+// Bus used to measure the transfer time, without a radio the transfers
+// still take the same time on the bus
+#define BENCH_SPI_HZ      10000000
+#define BENCH_RUNS        20
+
+/*
+ * Mock SX127x register model
+ */
+typedef struct {
+	uint8_t reg[128];
+	uint8_t fifo[256];
+
+	// Current NSS frame
+	int selected;
+	int first;
+	uint8_t addr;
+	uint8_t write;
+
+	// Bus statistics
+	uint32_t transactions;
+	uint32_t bytes;
+} mock_radio_t;
+
+static mock_radio_t radio;
+
+static void mock_reset(void) {
+	memset(&radio, 0, sizeof(radio));
+	radio.reg[REG_VERSION] = 0x12;
+}
+
+static void mock_select(void) {
+	radio.selected = 1;
+	radio.first = 1;
+}
+
+static void mock_deselect(void) {
+	radio.selected = 0;
+}
+
+// Shift a byte, the address byte first, and then data bytes, with the
+// address auto-increment, or the FIFO pointer auto-increment
+static uint8_t mock_shift(uint8_t out) {
+	uint8_t in = 0;
+	uint8_t *cell;
+
+	TEST_ASSERT(radio.selected);
+	radio.bytes++;
+
+	if (radio.first) {
+		radio.first = 0;
+		radio.addr = out & 0x7f;
+		radio.write = out & 0x80;
+		return 0;
+	}
+
+	if (radio.addr == REG_FIFO) {
+		cell = &radio.fifo[radio.reg[REG_FIFO_ADDR_PTR]++];
+	} else {
+		cell = &radio.reg[radio.addr];
+		radio.addr = (radio.addr + 1) & 0x7f;
+	}
+
+	if (radio.write) {
+		*cell = out;
+	} else {
+		in = *cell;
+	}
+
+	return in;
+}
+
+// Burst path: a full NSS frame in one transaction
+static void mock_burst_select(void *arg) {
+	TEST_ASSERT(!radio.selected);
+
+	radio.transactions++;
+	mock_select();
+}
+
+static void mock_xfer(void *arg, uint32_t len, uint8_t *tx, uint8_t *rx) {
+	uint32_t i;
+	uint8_t in;
+
+	for (i = 0; i < len; i++) {
+		in = mock_shift(tx ? tx[i] : 0xff);
+		if (rx) {
+			rx[i] = in;
+		}
+	}
+}
+
+static void mock_burst_deselect(void *arg) {
+	mock_deselect();
+}
+
+// Byte path, as done before the burst transfers: one transaction per byte
+static void byte_read(uint8_t addr, uint8_t *data, uint8_t len) {
+	mock_select();
+
+	radio.transactions++;
+	mock_shift(addr & 0x7f);
+
+	while (len--) {
+		radio.transactions++;
+		*data++ = mock_shift(0x00);
+	}
+
+	mock_deselect();
+}
+
+static sx127x_spi_t spi = {
+	.select = mock_burst_select,
+	.xfer = mock_xfer,
+	.deselect = mock_burst_deselect,
+};
+
+static void bench_select(void *arg) {
+	spi_ll_select((int)arg);
+}
+
+static void bench_xfer(void *arg, uint32_t len, uint8_t *tx, uint8_t *rx) {
+	spi_ll_bulk_transfer((int)arg, len, tx, rx);
+}
+
+static void bench_deselect(void *arg) {
+	spi_ll_deselect((int)arg);
+}
+
+static sx127x_spi_t bench_spi = {
+	.select = bench_select,
+	.xfer = bench_xfer,
+	.deselect = bench_deselect,
+};
+
+TEST_CASE("sx127x burst register access", "[lora]") {
+	uint8_t frf[3] = {0xd9, 0x06, 0x8b};
+	uint8_t data[3];
+
+	mock_reset();
+
+	TEST_ASSERT_EQUAL(0x12, sx127x_spi_read_reg(&spi, REG_VERSION));
+	TEST_ASSERT_EQUAL(1, radio.transactions);
+	TEST_ASSERT_EQUAL(2, radio.bytes);
+
+	// A register range in one transaction
+	sx127x_spi_write(&spi, REG_FR_MSB, frf, 3);
+	TEST_ASSERT_EQUAL(2, radio.transactions);
+	TEST_ASSERT_EQUAL_MEMORY(frf, &radio.reg[REG_FR_MSB], 3);
+
+	sx127x_spi_read(&spi, REG_FR_MSB, data, 3);
+	TEST_ASSERT_EQUAL(3, radio.transactions);
+	TEST_ASSERT_EQUAL_MEMORY(frf, data, 3);
+
+	sx127x_spi_write_reg(&spi, REG_FIFO_ADDR_PTR, 0x80);
+	TEST_ASSERT_EQUAL(0x80, radio.reg[REG_FIFO_ADDR_PTR]);
+}
+
+TEST_CASE("sx127x burst fifo access", "[lora]") {
+	uint8_t out[SX127X_SPI_BURST_MAX];
+	uint8_t in[SX127X_SPI_BURST_MAX];
+	uint8_t byte[SX127X_SPI_BURST_MAX];
+	int i, len;
+
+	mock_reset();
+	srand(64);
+
+	for (len = 1; len <= SX127X_SPI_BURST_MAX; len += 37) {
+		for (i = 0; i < len; i++) {
+			out[i] = rand();
+		}
+
+		sx127x_spi_write_reg(&spi, REG_FIFO_ADDR_PTR, 0x00);
+		sx127x_spi_write(&spi, REG_FIFO, out, len);
+		TEST_ASSERT_EQUAL(len, radio.reg[REG_FIFO_ADDR_PTR]);
+		TEST_ASSERT_EQUAL_MEMORY(out, radio.fifo, len);
+
+		// Burst and byte paths read the same
+		sx127x_spi_write_reg(&spi, REG_FIFO_ADDR_PTR, 0x00);
+		sx127x_spi_read(&spi, REG_FIFO, in, len);
+
+		sx127x_spi_write_reg(&spi, REG_FIFO_ADDR_PTR, 0x00);
+		byte_read(REG_FIFO, byte, len);
+
+		TEST_ASSERT_EQUAL_MEMORY(out, in, len);
+		TEST_ASSERT_EQUAL_MEMORY(out, byte, len);
+	}
+}
+
+TEST_CASE("sx127x burst fifo read timing", "[lora]") {
+	driver_error_t *error;
+	uint8_t data[SX127X_SPI_BURST_MAX];
+	int64_t begin, byte_us, burst_us;
+	int device;
+	int run, i;
+
+	error = spi_setup(CONFIG_LUA_RTOS_LORA_SPI, 1, CONFIG_LUA_RTOS_LORA_CS, 0, BENCH_SPI_HZ, SPI_FLAG_WRITE | SPI_FLAG_READ, &device);
+	TEST_ASSERT_NULL(error);
+
+	bench_spi.arg = (void *)device;
+
+	// Byte path, as done before the burst transfers: one transaction per byte
+	begin = esp_timer_get_time();
+	for (run = 0; run < BENCH_RUNS; run++) {
+		spi_ll_select(device);
+		spi_ll_transfer(device, REG_FIFO, NULL);
+		for (i = 0; i < sizeof(data); i++) {
+			spi_ll_transfer(device, 0x00, &data[i]);
+		}
+		spi_ll_deselect(device);
+	}
+	byte_us = (esp_timer_get_time() - begin) / BENCH_RUNS;
+
+	// Burst path
+	begin = esp_timer_get_time();
+	for (run = 0; run < BENCH_RUNS; run++) {
+		sx127x_spi_read(&bench_spi, REG_FIFO, data, sizeof(data));
+	}
+	burst_us = (esp_timer_get_time() - begin) / BENCH_RUNS;
+
+	spi_ll_unsetup(device);
+
+	printf("255 byte FIFO read at %d KHz: %d usecs with a transaction per byte, %d usecs in burst\n",
+		   BENCH_SPI_HZ / 1000, (int)byte_us, (int)burst_us);
+
+	TEST_ASSERT(burst_us < byte_us);
+}
+
+#endif
@@ -0,0 +1,282 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, LoRa gateway uplink JSON serializer test cases
+ *
+ */
+
+#include "sdkconfig.h"
+
+#if CONFIG_LUA_RTOS_LORA_HW_TYPE_SX1301
+
+#include "unity.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+
+#include "base64.h"
+#include "uplink_json.h"
+
+/*
+ * Reference serializer, with the printf formats used by the packet forwarder
+ */
+static int ref_rxpk(char *out, int max_len, const struct lgw_pkt_rx_s *p, const struct timespec *utc) {
+	struct tm *x;
+	int n = 0;
+
+	n += snprintf(out + n, max_len - n, "{\"tmst\":%u", p->count_us);
+	if (utc) {
+		x = gmtime(&(utc->tv_sec));
+		n += snprintf(out + n, max_len - n, ",\"time\":\"%04i-%02i-%02iT%02i:%02i:%02i.%06liZ\"", (x->tm_year)+1900, (x->tm_mon)+1, x->tm_mday, x->tm_hour, x->tm_min, x->tm_sec, (utc->tv_nsec)/1000);
+	}
+	n += snprintf(out + n, max_len - n, ",\"chan\":%1u,\"rfch\":%1u,\"freq\":%.6lf", p->if_chain, p->rf_chain, ((double)p->freq_hz / 1e6));
+	switch (p->status) {
+		case STAT_CRC_OK:  n += snprintf(out + n, max_len - n, ",\"stat\":1");  break;
+		case STAT_CRC_BAD: n += snprintf(out + n, max_len - n, ",\"stat\":-1"); break;
+		case STAT_NO_CRC:  n += snprintf(out + n, max_len - n, ",\"stat\":0");  break;
+	}
+	if (p->modulation == MOD_LORA) {
+		n += snprintf(out + n, max_len - n, ",\"modu\":\"LORA\"");
+		switch (p->datarate) {
+			case DR_LORA_SF7:  n += snprintf(out + n, max_len - n, ",\"datr\":\"SF7");  break;
+			case DR_LORA_SF8:  n += snprintf(out + n, max_len - n, ",\"datr\":\"SF8");  break;
+			case DR_LORA_SF9:  n += snprintf(out + n, max_len - n, ",\"datr\":\"SF9");  break;
+			case DR_LORA_SF10: n += snprintf(out + n, max_len - n, ",\"datr\":\"SF10"); break;
+			case DR_LORA_SF11: n += snprintf(out + n, max_len - n, ",\"datr\":\"SF11"); break;
+			case DR_LORA_SF12: n += snprintf(out + n, max_len - n, ",\"datr\":\"SF12"); break;
+		}
+		switch (p->bandwidth) {
+			case BW_125KHZ: n += snprintf(out + n, max_len - n, "BW125\""); break;
+			case BW_250KHZ: n += snprintf(out + n, max_len - n, "BW250\""); break;
+			case BW_500KHZ: n += snprintf(out + n, max_len - n, "BW500\""); break;
+		}
+		switch (p->coderate) {
+			case CR_LORA_4_5: n += snprintf(out + n, max_len - n, ",\"codr\":\"4/5\""); break;
+			case CR_LORA_4_6: n += snprintf(out + n, max_len - n, ",\"codr\":\"4/6\""); break;
+			case CR_LORA_4_7: n += snprintf(out + n, max_len - n, ",\"codr\":\"4/7\""); break;
+			case CR_LORA_4_8: n += snprintf(out + n, max_len - n, ",\"codr\":\"4/8\""); break;
+			case 0:           n += snprintf(out + n, max_len - n, ",\"codr\":\"OFF\""); break;
+		}
+		n += snprintf(out + n, max_len - n, ",\"lsnr\":%.1f", p->snr);
+	} else {
+		n += snprintf(out + n, max_len - n, ",\"modu\":\"FSK\"");
+		n += snprintf(out + n, max_len - n, ",\"datr\":%u", p->datarate);
+	}
+	n += snprintf(out + n, max_len - n, ",\"rssi\":%.0f,\"size\":%u", p->rssi, p->size);
+	n += snprintf(out + n, max_len - n, ",\"data\":\"");
+	n += bin_to_b64(p->payload, p->size, out + n, 341);
+	n += snprintf(out + n, max_len - n, "\"}");
+
+	return n;
+}
+
+static uint32_t rnd(uint32_t max) {
+	return (uint32_t)(((uint64_t)rand() * max) / ((uint64_t)RAND_MAX + 1));
+}
+
+static void random_packet(struct lgw_pkt_rx_s *p) {
+	static const uint32_t sf[] = {DR_LORA_SF7, DR_LORA_SF8, DR_LORA_SF9, DR_LORA_SF10, DR_LORA_SF11, DR_LORA_SF12};
+	static const uint8_t bw[] = {BW_125KHZ, BW_250KHZ, BW_500KHZ};
+	static const uint8_t cr[] = {CR_LORA_4_5, CR_LORA_4_6, CR_LORA_4_7, CR_LORA_4_8, 0};
+	static const uint8_t status[] = {STAT_CRC_OK, STAT_CRC_BAD, STAT_NO_CRC};
+	int i;
+
+	memset(p, 0, sizeof(*p));
+
+	p->count_us = (uint32_t)rand() ^ ((uint32_t)rand() << 16);
+	p->freq_hz = 863000000 + rnd(65000000);
+	p->if_chain = rnd(10);
+	p->rf_chain = rnd(2);
+	p->status = status[rnd(3)];
+	p->modulation = rnd(8) ? MOD_LORA : MOD_FSK;
+	if (p->modulation == MOD_LORA) {
+		p->datarate = sf[rnd(6)];
+		p->bandwidth = bw[rnd(3)];
+		p->coderate = cr[rnd(5)];
+	} else {
+		p->datarate = 1200 + rnd(300000);
+	}
+
+	// Hardware values, and arbitrary ones
+	if (rnd(2)) {
+		p->rssi = -(float)rnd(140);
+		p->snr = ((float)rnd(160) - 80.0) / 4.0;
+	} else {
+		p->rssi = -((float)rand() / (float)RAND_MAX) * 140.0;
+		p->snr = (((float)rand() / (float)RAND_MAX) - 0.5) * 50.0;
+	}
+
+	p->size = rnd(256);
+	for (i = 0; i < p->size; i++) {
+		p->payload[i] = rand();
+	}
+}
+
+TEST_CASE("uplink json fixed-point numbers", "[lora]") {
+	static const double values[] = {
+		0.0, -0.0, 0.05, 0.15, 0.25, 0.35, -0.25, -0.75, 0.5, 1.5, 2.5, -2.5, -0.04,
+		99.95, 100.0, 12.345675, -137.5, 1e-30, 123456789.5, 4294967296.5, 1e12,
+	};
+	char out[64], ref[64];
+	double value;
+	int i, d;
+
+	for (i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+		for (d = 0; d <= 6; d++) {
+			snprintf(ref, sizeof(ref), "%.*f", d, values[i]);
+			TEST_ASSERT_EQUAL(strlen(ref), uplink_json_fixed(out, values[i], d));
+			TEST_ASSERT_EQUAL_STRING(ref, out);
+		}
+	}
+
+	srand(42);
+	for (i = 0; i < 200000; i++) {
+		value = ((double)rand() / (double)RAND_MAX - 0.5) * 400.0;
+		if (i & 1) {
+			value = (float)value;
+		}
+		d = rnd(7);
+
+		snprintf(ref, sizeof(ref), "%.*f", d, value);
+		uplink_json_fixed(out, value, d);
+		TEST_ASSERT_EQUAL_STRING(ref, out);
+	}
+}
+
+TEST_CASE("uplink json rxpk and stat", "[lora]") {
+	static struct lgw_pkt_rx_s pkt;
+	char out[UPLINK_JSON_RXPK_SIZE], ref[UPLINK_JSON_RXPK_SIZE];
+	struct timespec utc;
+	struct coord_s coord;
+	struct uplink_json_stat_s stat;
+	int i;
+
+	srand(1234);
+
+	for (i = 0; i < 20000; i++) {
+		random_packet(&pkt);
+
+		utc.tv_sec = (time_t)rnd(0x7fffffff);
+		utc.tv_nsec = rnd(1000000000);
+
+		ref_rxpk(ref, sizeof(ref), &pkt, (i & 1) ? &utc : NULL);
+		TEST_ASSERT_EQUAL(strlen(ref), uplink_json_rxpk(out, sizeof(out), &pkt, (i & 1) ? &utc : NULL));
+		TEST_ASSERT_EQUAL_STRING(ref, out);
+	}
+
+	// Unknown fields
+	random_packet(&pkt);
+	pkt.modulation = MOD_LORA;
+	pkt.coderate = 0x55;
+	TEST_ASSERT_EQUAL(-1, uplink_json_rxpk(out, sizeof(out), &pkt, NULL));
+
+	// Buffer too small
+	random_packet(&pkt);
+	TEST_ASSERT_EQUAL(-1, uplink_json_rxpk(out, 100, &pkt, NULL));
+
+	// Status report
+	coord.lat = 41.38879;
+	coord.lon = -2.15899;
+	coord.alt = -12;
+
+	stat.time = "2018-03-01 10:15:30 GMT";
+	stat.coord = NULL;
+	stat.rxnb = 120;
+	stat.rxok = 100;
+	stat.rxfw = 99;
+	stat.ackr = 100.0 * (float)97 / (float)99;
+	stat.dwnb = 4;
+	stat.txnb = 3;
+
+	snprintf(ref, sizeof(ref), "\"stat\":{\"time\":\"%s\",\"rxnb\":%u,\"rxok\":%u,\"rxfw\":%u,\"ackr\":%.1f,\"dwnb\":%u,\"txnb\":%u}", stat.time, stat.rxnb, stat.rxok, stat.rxfw, stat.ackr, stat.dwnb, stat.txnb);
+	TEST_ASSERT_EQUAL(strlen(ref), uplink_json_stat(out, 200, &stat));
+	TEST_ASSERT_EQUAL_STRING(ref, out);
+
+	stat.coord = &coord;
+	snprintf(ref, sizeof(ref), "\"stat\":{\"time\":\"%s\",\"lati\":%.5f,\"long\":%.5f,\"alti\":%i,\"rxnb\":%u,\"rxok\":%u,\"rxfw\":%u,\"ackr\":%.1f,\"dwnb\":%u,\"txnb\":%u}", stat.time, coord.lat, coord.lon, coord.alt, stat.rxnb, stat.rxok, stat.rxfw, stat.ackr, stat.dwnb, stat.txnb);
+	TEST_ASSERT_EQUAL(strlen(ref), uplink_json_stat(out, 200, &stat));
+	TEST_ASSERT_EQUAL_STRING(ref, out);
+}
+
+static uint64_t now_us() {
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+
+	return ((uint64_t)tv.tv_sec * 1000000) + tv.tv_usec;
+}
+
+TEST_CASE("uplink json performance", "[lora]") {
+	static struct lgw_pkt_rx_s pkt[8];
+	char out[UPLINK_JSON_RXPK_SIZE];
+	struct timespec utc = {1520000000, 123456000};
+	uint64_t begin, end;
+	double rate, ref_rate;
+	int i, n = 20000;
+
+	srand(99);
+	for (i = 0; i < 8; i++) {
+		random_packet(&pkt[i]);
+		pkt[i].size = 20;
+	}
+
+	begin = now_us();
+	for (i = 0; i < n; i++) {
+		ref_rxpk(out, sizeof(out), &pkt[i & 7], &utc);
+	}
+	end = now_us();
+	ref_rate = (n * 1000000.0) / (end - begin + 1);
+
+	begin = now_us();
+	for (i = 0; i < n; i++) {
+		uplink_json_rxpk(out, sizeof(out), &pkt[i & 7], &utc);
+	}
+	end = now_us();
+	rate = (n * 1000000.0) / (end - begin + 1);
+
+	printf("rxpk serialization, packets per second, printf %.0f, serializer %.0f\r\n", ref_rate, rate);
+}
+
+#endif
@@ -611,13 +611,7 @@ static void linenoiseHistoryGet(struct linenoiseState *l, int up) {
 void linenoiseHistoryClear() {
     if (status_get(STATUS_LUA_HISTORY)) return;
 
-    char fname[PATH_MAX + 1];
-
-    if (!mount_history_file(fname, sizeof(fname))) {
-        return;
-    }
-
-    remove(fname);
+    history_clear();
 }
 
 /* The high level function that is the main API of the linenoise library.
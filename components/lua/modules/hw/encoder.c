@@ -77,6 +77,22 @@ static void callback_func(int callback, int8_t dir, uint32_t counter, uint8_t bu
 	}
 }
 
+static void rate_callback_func(int callback, int64_t counter, int32_t delta, int32_t velocity) {
+	lua_callback_t *cb = (lua_callback_t *)callback;
+
+	if (cb != NULL) {
+		lua_State *state = luaS_callback_state(cb);
+
+		if (state != NULL) {
+			// Lua integers are 32 bits, so the count wraps
+	        lua_pushinteger(state, (int32_t)counter);
+	        lua_pushinteger(state, delta);
+	        lua_pushinteger(state, velocity);
+	        luaS_callback_call(cb, 3);
+		}
+	}
+}
+
 static int lencoder_attach( lua_State* L ) {
 	lua_callback_t *callback;
 	driver_error_t *error;
@@ -126,6 +142,56 @@ static int lencoder_attach( lua_State* L ) {
     return 1;
 }
 
+static int lencoder_attach_pcnt( lua_State* L ) {
+	lua_callback_t *callback;
+	driver_error_t *error;
+
+	int a = luaL_checkinteger(L, 1);
+	int b = luaL_checkinteger(L, 2);
+	int filter = luaL_optinteger(L, 3, 0);
+	int interval = luaL_optinteger(L, 4, 100);
+
+	if (lua_isfunction(L, 5)) {
+		luaL_checktype(L, 5, LUA_TFUNCTION);
+
+		callback = luaS_callback_create(L, 5);
+	} else {
+		callback = NULL;
+	}
+
+	encoder_userdata *userdata = (encoder_userdata *)lua_newuserdata(L, sizeof(encoder_userdata));
+    if (!userdata) {
+       	return luaL_exception(L, ENCODER_ERR_NOT_ENOUGH_MEMORY);
+    }
+
+    // Setup the encoder
+    encoder_h_t *encoder;
+    if ((error = encoder_setup_pcnt(a, b, filter, &encoder))) {
+    	if (callback != NULL) {
+    		luaS_callback_destroy(callback);
+    	}
+
+    	return luaL_driver_error(L, error);
+    }
+
+    if (callback != NULL) {
+        // Register callback, the id of the callback is the callback reference
+        if ((error = encoder_register_rate_callback(encoder, rate_callback_func, (int)callback, interval))) {
+        	encoder_unsetup(encoder);
+        	luaS_callback_destroy(callback);
+        	return luaL_driver_error(L, error);
+        }
+    }
+
+    userdata->callback = callback;
+    userdata->encoder = encoder;
+
+    luaL_getmetatable(L, "encoder.enc");
+    lua_setmetatable(L, -2);
+
+    return 1;
+}
+
 static int lencoder_read (lua_State *L) {
 	encoder_userdata *userdata = (encoder_userdata *)luaL_checkudata(L, 1, "encoder.enc");
 	driver_error_t *error;
@@ -191,6 +257,7 @@ static const LUA_REG_TYPE encoder_inst_map[] = {
 
 static const LUA_REG_TYPE encoder_map[] = {
 	{ LSTRKEY( "attach" ),			LFUNCVAL( lencoder_attach ) },
+	{ LSTRKEY( "attachpcnt" ),		LFUNCVAL( lencoder_attach_pcnt ) },
     { LNILKEY, LNILVAL }
 };
 
@@ -216,5 +283,13 @@ enc = encoder.attach(pio.GPIO26, pio.GPIO14, pio.GPIO21, new_pos)
 enc:read()
 enc:write(10)
 
+-- High speed encoder, decoded by a pulse counter, with a 1 us glitch filter,
+-- and notifications each 100 ms while it's moving
+function speed(count, delta, velocity)
+   print(count, delta, velocity)
+end
+
+enc = encoder.attachpcnt(pio.GPIO26, pio.GPIO14, 80, 100, speed)
+
  */
 #endif
@@ -24,6 +24,7 @@
 
 #include <drivers/cpu.h>
 #include <drivers/gpio.h>
+#include <drivers/gpio_debouncing.h>
 
 #include "esp_intr.h"
 
@@ -418,6 +419,77 @@ static int pio_pin_interrupt(lua_State *L) {
     return 0;
 }
 
+static int pio_pin_debounce(lua_State *L) {
+    driver_error_t *error;
+
+    uint32_t pin = luaL_checkinteger(L, 1);
+    uint32_t threshold = luaL_optinteger(L, 2, 1000);
+
+    if (pin > CPU_LAST_GPIO) {
+        return luaL_exception(L, GPIO_ERR_INVALID_PIN);
+    }
+
+    if (threshold > 65535) {
+        return luaL_error(L, "invalid threshold");
+    }
+
+    // Events are stored in the debouncing ring buffer, and got with
+    // pio.pin.events
+    if ((error = gpio_debouncing_register(pin, threshold, NULL, NULL))) {
+        return luaL_driver_error(L, error);
+    }
+
+    return 0;
+}
+
+static int pio_pin_nodebounce(lua_State *L) {
+    driver_error_t *error;
+
+    uint32_t pin = luaL_checkinteger(L, 1);
+
+    if (pin > CPU_LAST_GPIO) {
+        return luaL_exception(L, GPIO_ERR_INVALID_PIN);
+    }
+
+    if ((error = gpio_debouncing_unregister(pin))) {
+        return luaL_driver_error(L, error);
+    }
+
+    return 0;
+}
+
+static int pio_pin_events(lua_State *L) {
+    gpio_debouncing_event_t events[16];
+    uint32_t dropped;
+    int i, n, total = 0;
+
+    lua_createtable(L, 0, 0);
+
+    // Drain the ring buffer in batches
+    do {
+        n = gpio_debouncing_get_events(events, sizeof(events) / sizeof(events[0]), &dropped);
+
+        for(i = 0;i < n;i++) {
+            lua_createtable(L, 0, 3);
+
+            lua_pushinteger(L, events[i].pin);
+            lua_setfield(L, -2, "pin");
+
+            lua_pushinteger(L, events[i].level);
+            lua_setfield(L, -2, "level");
+
+            lua_pushinteger(L, events[i].time);
+            lua_setfield(L, -2, "time");
+
+            lua_rawseti(L, -2, ++total);
+        }
+    } while (n == sizeof(events) / sizeof(events[0]));
+
+    lua_pushinteger(L, dropped);
+
+    return 2;
+}
+
 static int pio_port_setdir(lua_State *L) {
     return pio_gen_setdir(L, PIO_PORT_OP);
 }
@@ -491,6 +563,9 @@ static const LUA_REG_TYPE pio_pin_map[] = {
     { LSTRKEY( "getval"    ),            LFUNCVAL( pio_pin_getval     ) },
     { LSTRKEY( "num"         ),          LFUNCVAL( pio_pin_pinnum     ) },
     { LSTRKEY( "interrupt" ),            LFUNCVAL( pio_pin_interrupt  ) },
+    { LSTRKEY( "debounce"  ),            LFUNCVAL( pio_pin_debounce   ) },
+    { LSTRKEY( "nodebounce" ),           LFUNCVAL( pio_pin_nodebounce ) },
+    { LSTRKEY( "events"    ),            LFUNCVAL( pio_pin_events     ) },
     { LSTRKEY( "IntrPosEdge"   ),        LINTVAL ( GPIO_INTR_POSEDGE        ) },
     { LSTRKEY( "IntrNegEdge"   ),        LINTVAL ( GPIO_INTR_NEGEDGE        ) },
     { LSTRKEY( "IntrAnyEdge"   ),        LINTVAL ( GPIO_INTR_ANYEDGE        ) },
@@ -0,0 +1,342 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, Lua RMT module
+ *
+ */
+
+#include "sdkconfig.h"
+
+#if CONFIG_LUA_RTOS_LUA_USE_RMT
+
+#include "freertos/FreeRTOS.h"
+
+#include "lua.h"
+#include "lauxlib.h"
+#include "modules.h"
+#include "error.h"
+#include "sys.h"
+
+#include <drivers/rmt.h>
+#include <drivers/rmt_stream.h>
+
+// Default ring buffer size, in items
+#define RMT_STREAM_DEFAULT_ITEMS 1024
+
+typedef struct {
+	int deviceid;
+	lua_callback_t *callback;
+} rmt_userdata;
+
+static void callback_func(int deviceid, void *arg) {
+	lua_callback_t *cb = (lua_callback_t *)arg;
+
+	if (cb != NULL) {
+		lua_State *state = luaS_callback_state(cb);
+
+		if (state != NULL) {
+			luaS_callback_call(cb, 0);
+		}
+	}
+}
+
+// Push a frame as a table of pulses
+static void push_frame(lua_State *L, rmt_item_t *items, size_t count) {
+	int32_t pulses[RMT_STREAM_MAX_ITEMS * 2];
+	uint32_t n, i;
+
+	n = rmt_stream_pulses((uint32_t *)items, count, pulses, RMT_STREAM_MAX_ITEMS * 2);
+
+	lua_createtable(L, n, 0);
+	for (i = 0; i < n; i++) {
+		lua_pushinteger(L, pulses[i]);
+		lua_rawseti(L, -2, i + 1);
+	}
+}
+
+// Read a frame, returns 0 on timeout
+static int read_frame(lua_State *L, rmt_userdata *userdata, uint32_t timeout) {
+	rmt_item_t items[RMT_STREAM_MAX_ITEMS];
+	size_t count = RMT_STREAM_MAX_ITEMS;
+	driver_error_t *error;
+
+	if ((error = rmt_rx_stream_read(userdata->deviceid, items, &count, timeout))) {
+		if (error->exception == RMT_ERR_TIMEOUT) {
+			free(error);
+			return 0;
+		}
+
+		return luaL_driver_error(L, error);
+	}
+
+	push_frame(L, items, count);
+
+	return 1;
+}
+
+static uint16_t get_field(lua_State *L, int table, const char *name, int index) {
+	uint16_t value = 0;
+
+	lua_getfield(L, table, name);
+	if (lua_istable(L, -1)) {
+		lua_rawgeti(L, -1, index);
+		value = luaL_checkinteger(L, -1);
+		lua_pop(L, 1);
+	} else if (!lua_isnil(L, -1)) {
+		value = luaL_checkinteger(L, -1);
+	}
+	lua_pop(L, 1);
+
+	return value;
+}
+
+static int lrmt_attach(lua_State* L) {
+	lua_callback_t *callback = NULL;
+	driver_error_t *error;
+	int deviceid;
+
+	int pin = luaL_checkinteger(L, 1);
+	int filter = luaL_optinteger(L, 2, 100);
+	int idle = luaL_optinteger(L, 3, 10000);
+	int items = luaL_optinteger(L, 4, RMT_STREAM_DEFAULT_ITEMS);
+
+	if (lua_isfunction(L, 5)) {
+		callback = luaS_callback_create(L, 5);
+	}
+
+	rmt_userdata *userdata = (rmt_userdata *)lua_newuserdata(L, sizeof(rmt_userdata));
+	if (!userdata) {
+		return luaL_exception(L, RMT_ERR_NOT_ENOUGH_MEMORY);
+	}
+
+	userdata->deviceid = -1;
+	userdata->callback = callback;
+
+	// Filter is expressed in APB clock ticks
+	if ((error = rmt_setup_rx(pin, RMTPulseRangeUSEC, filter, idle, &deviceid))) {
+		return luaL_driver_error(L, error);
+	}
+
+	if ((error = rmt_rx_stream_start(deviceid, items, callback?callback_func:NULL, callback))) {
+		rmt_unsetup_rx(deviceid);
+		return luaL_driver_error(L, error);
+	}
+
+	userdata->deviceid = deviceid;
+
+	luaL_getmetatable(L, "rmt.stream");
+	lua_setmetatable(L, -2);
+
+	return 1;
+}
+
+static int lrmt_read(lua_State *L) {
+	rmt_userdata *userdata = (rmt_userdata *)luaL_checkudata(L, 1, "rmt.stream");
+	uint32_t timeout = luaL_optinteger(L, 2, portMAX_DELAY);
+
+	if (!read_frame(L, userdata, timeout)) {
+		lua_pushnil(L);
+	}
+
+	return 1;
+}
+
+static int lrmt_frames_iter(lua_State *L) {
+	rmt_userdata *userdata = (rmt_userdata *)luaL_checkudata(L, lua_upvalueindex(1), "rmt.stream");
+	uint32_t timeout = lua_tointeger(L, lua_upvalueindex(2));
+
+	if (!read_frame(L, userdata, timeout)) {
+		lua_pushnil(L);
+	}
+
+	return 1;
+}
+
+static int lrmt_frames(lua_State *L) {
+	luaL_checkudata(L, 1, "rmt.stream");
+	luaL_optinteger(L, 2, 0);
+
+	lua_settop(L, 2);
+	if (lua_isnil(L, 2)) {
+		lua_pushinteger(L, portMAX_DELAY);
+		lua_replace(L, 2);
+	}
+
+	lua_pushcclosure(L, lrmt_frames_iter, 2);
+
+	return 1;
+}
+
+static int lrmt_dropped(lua_State *L) {
+	rmt_userdata *userdata = (rmt_userdata *)luaL_checkudata(L, 1, "rmt.stream");
+
+	lua_pushinteger(L, rmt_rx_stream_dropped(userdata->deviceid));
+
+	return 1;
+}
+
+static int lrmt_decode(lua_State *L) {
+	rmt_stream_proto_t proto;
+	int32_t pulses[RMT_STREAM_MAX_ITEMS * 2];
+	uint8_t data[RMT_STREAM_MAX_ITEMS / 8];
+	uint32_t count, i, value;
+	int max_bits, bits;
+
+	luaL_checktype(L, 1, LUA_TTABLE);
+	luaL_checktype(L, 2, LUA_TTABLE);
+
+	count = lua_rawlen(L, 1);
+	if (count > RMT_STREAM_MAX_ITEMS * 2) {
+		count = RMT_STREAM_MAX_ITEMS * 2;
+	}
+
+	for (i = 0; i < count; i++) {
+		lua_rawgeti(L, 1, i + 1);
+		pulses[i] = luaL_checkinteger(L, -1);
+		lua_pop(L, 1);
+	}
+
+	proto.header[0] = get_field(L, 2, "header", 1);
+	proto.header[1] = get_field(L, 2, "header", 2);
+	proto.zero[0] = get_field(L, 2, "zero", 1);
+	proto.zero[1] = get_field(L, 2, "zero", 2);
+	proto.one[0] = get_field(L, 2, "one", 1);
+	proto.one[1] = get_field(L, 2, "one", 2);
+
+	lua_getfield(L, 2, "tolerance");
+	proto.tolerance = luaL_optinteger(L, -1, 25);
+	lua_pop(L, 1);
+
+	lua_getfield(L, 2, "inverted");
+	proto.inverted = lua_toboolean(L, -1);
+	lua_pop(L, 1);
+
+	lua_getfield(L, 2, "bits");
+	max_bits = luaL_optinteger(L, -1, 32);
+	lua_pop(L, 1);
+
+	if ((max_bits < 1) || (max_bits > 32)) {
+		return luaL_error(L, "invalid number of bits");
+	}
+
+	bits = rmt_stream_decode(pulses, count, &proto, data, max_bits);
+	if (bits <= 0) {
+		lua_pushnil(L);
+		return 1;
+	}
+
+	value = 0;
+	for (i = 0; i < bits; i++) {
+		value = (value << 1) | ((data[i >> 3] >> (7 - (i & 7))) & 1);
+	}
+
+	lua_pushinteger(L, value);
+	lua_pushinteger(L, bits);
+
+	return 2;
+}
+
+static int lrmt_detach(lua_State *L) {
+	rmt_userdata *userdata = (rmt_userdata *)luaL_checkudata(L, 1, "rmt.stream");
+
+	if (userdata->deviceid >= 0) {
+		rmt_unsetup_rx(userdata->deviceid);
+		userdata->deviceid = -1;
+	}
+
+	if (userdata->callback != NULL) {
+		luaS_callback_destroy(userdata->callback);
+		userdata->callback = NULL;
+	}
+
+	return 0;
+}
+
+// Destructor
+static int lrmt_gc(lua_State *L) {
+	lrmt_detach(L);
+
+	return 0;
+}
+
+static const LUA_REG_TYPE rmt_inst_map[] = {
+	{ LSTRKEY( "read" ),			LFUNCVAL( lrmt_read    ) },
+	{ LSTRKEY( "frames" ),			LFUNCVAL( lrmt_frames  ) },
+	{ LSTRKEY( "dropped" ),			LFUNCVAL( lrmt_dropped ) },
+	{ LSTRKEY( "detach" ),			LFUNCVAL( lrmt_detach  ) },
+	{ LSTRKEY( "__metatable" ),		LROVAL  ( rmt_inst_map ) },
+	{ LSTRKEY( "__index"     ),		LROVAL  ( rmt_inst_map ) },
+	{ LSTRKEY( "__gc" ),			LFUNCVAL( lrmt_gc      ) },
+	{ LNILKEY, LNILVAL }
+};
+
+static const LUA_REG_TYPE rmt_map[] = {
+	{ LSTRKEY( "attach" ),			LFUNCVAL( lrmt_attach ) },
+	{ LSTRKEY( "decode" ),			LFUNCVAL( lrmt_decode ) },
+	DRIVER_REGISTER_LUA_ERRORS(rmt)
+	{ LNILKEY, LNILVAL }
+};
+
+LUALIB_API int luaopen_rmt( lua_State *L ) {
+	luaL_newmetarotable(L,"rmt.stream", (void *)rmt_inst_map);
+	return 0;
+}
+
+MODULE_REGISTER_ROM(RMT, rmt, rmt_map, luaopen_rmt, 1);
+
+/*
+
+-- NEC IR remote, with an IR receiver (active low) in GPIO14
+ir = rmt.attach(pio.GPIO14, 100, 12000)
+
+for pulses in ir:frames() do
+   local code, bits = rmt.decode(pulses, {
+      header = {9000, 4500}, zero = {560, 560}, one = {560, 1690},
+      inverted = true, bits = 32
+   })
+
+   if code then
+      print(string.format("%08x", code))
+   end
+end
+
+ */
+#endif
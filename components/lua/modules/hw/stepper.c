@@ -36,6 +36,8 @@
 
 #include <sys/syslog.h>
 
+#include <string.h>
+
 typedef struct {
     uint8_t unit;
     float stpu;     // Steps per unit
@@ -190,6 +192,79 @@ static int lstepper_start( lua_State* L ){
     return 0;
 }
 
+static int lstepper_line( lua_State* L ) {
+    driver_error_t *error;
+    stepper_userdata *lstepper = NULL;
+    float units[NSTEP];
+    float speed = 0;
+    float accel = 0;
+    int mask = 0;
+    int i, n;
+
+    luaL_checktype(L, 1, LUA_TTABLE);
+    luaL_checktype(L, 2, LUA_TTABLE);
+
+    n = lua_rawlen(L, 1);
+    luaL_argcheck(L, n == lua_rawlen(L, 2), 2, "one displacement for each stepper expected");
+
+    memset(units, 0, sizeof(units));
+
+    for (i = 1; i <= n; i++) {
+        lua_rawgeti(L, 1, i);
+        lstepper = (stepper_userdata *)luaL_checkudata(L, -1, "stepper.inst");
+        luaL_argcheck(L, lstepper, 1, "stepper expected");
+        lua_pop(L, 1);
+
+        lua_rawgeti(L, 2, i);
+        units[lstepper->unit] = luaL_checknumber(L, -1);
+        lua_pop(L, 1);
+
+        mask |= (1 << (lstepper->unit));
+
+        // By default, use the lowest max speed and max acceleration of the involved steppers
+        if ((speed == 0) || (lstepper->max_spd < speed)) {
+            speed = lstepper->max_spd;
+        }
+
+        if ((accel == 0) || (lstepper->max_acc < accel)) {
+            accel = lstepper->max_acc;
+        }
+    }
+
+    // Speed in units / min, limited to the max speed of the involved steppers
+    if (!lua_isnoneornil(L, 3)) {
+        float max_spd = speed;
+
+        speed = luaL_checknumber(L, 3);
+        speed = speed / 60.0;
+
+        if (speed > max_spd) {
+            speed = max_spd;
+        }
+    }
+
+    // Acceleration in units/secs^2
+    if (!lua_isnoneornil(L, 4)) {
+        accel = luaL_checknumber(L, 4);
+    }
+
+    if ((error = stepper_line(mask, units, speed, accel))) {
+        return luaL_driver_error(L, error);
+    }
+
+    return 0;
+}
+
+static int lstepper_run( lua_State* L ) {
+    driver_error_t *error;
+
+    if ((error = stepper_run())) {
+        return luaL_driver_error(L, error);
+    }
+
+    return 0;
+}
+
 static int lstepper_stop( lua_State* L ) {
     stepper_stop(0xffffffff);
 
@@ -199,6 +274,8 @@ static int lstepper_stop( lua_State* L ) {
 static const LUA_REG_TYPE lstepper_map[] = {
     { LSTRKEY( "attach" ),        LFUNCVAL( lstepper_attach    ) },
     { LSTRKEY( "start"  ),        LFUNCVAL( lstepper_start     ) },
+    { LSTRKEY( "line"   ),        LFUNCVAL( lstepper_line      ) },
+    { LSTRKEY( "run"    ),        LFUNCVAL( lstepper_run       ) },
     { LSTRKEY( "stop"   ),        LFUNCVAL( lstepper_stop      ) },
     DRIVER_REGISTER_LUA_ERRORS(stepper)
     { LNILKEY, LNILVAL }
@@ -26,12 +26,29 @@
  * with locale support will break when the decimal separator is a comma.
  *
  * fpconv_* will around these issues with a translation buffer if required.
+ *
+ * The common cases don't go through the C library at all:
+ *
+ * - fpconv_g_fmt() generates the digits with Grisu3 (Florian Loitsch,
+ *   "Printing Floating-Point Numbers Quickly and Accurately with Integers",
+ *   PLDI 2010), and rounds them to the requested precision. The output is
+ *   the same as sprintf("%.<precision>g"). Grisu3 detects the ~0.5% of
+ *   doubles it can't handle, and these are passed to sprintf().
+ *
+ * - fpconv_strtod() parses the decimal digits into a 64 bit integer, and
+ *   converts it with Clinger's fast path when it is exact, or with the
+ *   Eisel-Lemire algorithm (Daniel Lemire, "Number Parsing at a Gigabyte
+ *   per Second", 2021) otherwise. Numbers with more than 19 significant
+ *   digits, a decimal exponent out of the table range, or not in the JSON
+ *   syntax are passed to strtod().
  */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <assert.h>
 #include <string.h>
+#include <math.h>
 
 #include "fpconv.h"
 
@@ -103,7 +120,7 @@ static int strtod_buffer_size(const char *s)
 
 /* Similar to strtod(), but must be passed the current locale's decimal point
  * character. Guaranteed to be called at the start of any valid number in a string */
-double fpconv_strtod(const char *nptr, char **endptr)
+static double fpconv_strtod_slow(const char *nptr, char **endptr)
 {
     char localbuf[FPCONV_G_FMT_BUFSIZE];
     char *buf, *endbuf, *dp;
@@ -154,7 +171,7 @@ static void set_number_format(char *fmt, int precision)
 {
     int d1, d2, i;
 
-    assert(1 <= precision && precision <= 14);
+    assert(1 <= precision && precision <= 17);
 
     /* Create printf format (%.14g) from precision */
     d1 = precision / 10;
@@ -171,7 +188,7 @@ static void set_number_format(char *fmt, int precision)
 }
 
 /* Assumes there is always at least 32 characters available in the target buffer */
-int fpconv_g_fmt(char *str, double num, int precision)
+static int fpconv_g_fmt_slow(char *str, double num, int precision)
 {
     char buf[FPCONV_G_FMT_BUFSIZE];
     char fmt[6];
@@ -196,6 +213,882 @@ int fpconv_g_fmt(char *str, double num, int precision)
     return len;
 }
 
+/* Shortest round trip representation through sprintf(), for the doubles
+ * rejected by Grisu3. Up to 15 digits "%.15g" is the shortest one if it
+ * round trips. */
+static int fpconv_shortest_slow(char *str, double num)
+{
+    char *end;
+    int precision;
+    int len = 0;
+
+    for (precision = 15; precision <= 17; precision++) {
+        len = fpconv_g_fmt_slow(str, num, precision);
+        if (fpconv_strtod(str, &end) == num)
+            break;
+    }
+
+    return len;
+}
+
+/* ---------------------------------------------------------------------
+ * Grisu3
+ * --------------------------------------------------------------------- */
+
+/* Floating point number f * 2^e, with a 64 bit significand */
+typedef struct {
+    uint64_t f;
+    int e;
+} diy_fp_t;
+
+/* Cached powers of ten, 10^k ~= f * 2^e, for k = -348 + 8 * i */
+static const struct {
+    uint64_t f;
+    int16_t e;
+    int16_t k;
+} cached_powers[] = {
+    { 0xfa8fd5a0081c0288ULL, -1220, -348 },
+    { 0xbaaee17fa23ebf76ULL, -1193, -340 },
+    { 0x8b16fb203055ac76ULL, -1166, -332 },
+    { 0xcf42894a5dce35eaULL, -1140, -324 },
+    { 0x9a6bb0aa55653b2dULL, -1113, -316 },
+    { 0xe61acf033d1a45dfULL, -1087, -308 },
+    { 0xab70fe17c79ac6caULL, -1060, -300 },
+    { 0xff77b1fcbebcdc4fULL, -1034, -292 },
+    { 0xbe5691ef416bd60cULL, -1007, -284 },
+    { 0x8dd01fad907ffc3cULL,  -980, -276 },
+    { 0xd3515c2831559a83ULL,  -954, -268 },
+    { 0x9d71ac8fada6c9b5ULL,  -927, -260 },
+    { 0xea9c227723ee8bcbULL,  -901, -252 },
+    { 0xaecc49914078536dULL,  -874, -244 },
+    { 0x823c12795db6ce57ULL,  -847, -236 },
+    { 0xc21094364dfb5637ULL,  -821, -228 },
+    { 0x9096ea6f3848984fULL,  -794, -220 },
+    { 0xd77485cb25823ac7ULL,  -768, -212 },
+    { 0xa086cfcd97bf97f4ULL,  -741, -204 },
+    { 0xef340a98172aace5ULL,  -715, -196 },
+    { 0xb23867fb2a35b28eULL,  -688, -188 },
+    { 0x84c8d4dfd2c63f3bULL,  -661, -180 },
+    { 0xc5dd44271ad3cdbaULL,  -635, -172 },
+    { 0x936b9fcebb25c996ULL,  -608, -164 },
+    { 0xdbac6c247d62a584ULL,  -582, -156 },
+    { 0xa3ab66580d5fdaf6ULL,  -555, -148 },
+    { 0xf3e2f893dec3f126ULL,  -529, -140 },
+    { 0xb5b5ada8aaff80b8ULL,  -502, -132 },
+    { 0x87625f056c7c4a8bULL,  -475, -124 },
+    { 0xc9bcff6034c13053ULL,  -449, -116 },
+    { 0x964e858c91ba2655ULL,  -422, -108 },
+    { 0xdff9772470297ebdULL,  -396, -100 },
+    { 0xa6dfbd9fb8e5b88fULL,  -369,  -92 },
+    { 0xf8a95fcf88747d94ULL,  -343,  -84 },
+    { 0xb94470938fa89bcfULL,  -316,  -76 },
+    { 0x8a08f0f8bf0f156bULL,  -289,  -68 },
+    { 0xcdb02555653131b6ULL,  -263,  -60 },
+    { 0x993fe2c6d07b7facULL,  -236,  -52 },
+    { 0xe45c10c42a2b3b06ULL,  -210,  -44 },
+    { 0xaa242499697392d3ULL,  -183,  -36 },
+    { 0xfd87b5f28300ca0eULL,  -157,  -28 },
+    { 0xbce5086492111aebULL,  -130,  -20 },
+    { 0x8cbccc096f5088ccULL,  -103,  -12 },
+    { 0xd1b71758e219652cULL,   -77,   -4 },
+    { 0x9c40000000000000ULL,   -50,    4 },
+    { 0xe8d4a51000000000ULL,   -24,   12 },
+    { 0xad78ebc5ac620000ULL,     3,   20 },
+    { 0x813f3978f8940984ULL,    30,   28 },
+    { 0xc097ce7bc90715b3ULL,    56,   36 },
+    { 0x8f7e32ce7bea5c70ULL,    83,   44 },
+    { 0xd5d238a4abe98068ULL,   109,   52 },
+    { 0x9f4f2726179a2245ULL,   136,   60 },
+    { 0xed63a231d4c4fb27ULL,   162,   68 },
+    { 0xb0de65388cc8ada8ULL,   189,   76 },
+    { 0x83c7088e1aab65dbULL,   216,   84 },
+    { 0xc45d1df942711d9aULL,   242,   92 },
+    { 0x924d692ca61be758ULL,   269,  100 },
+    { 0xda01ee641a708deaULL,   295,  108 },
+    { 0xa26da3999aef774aULL,   322,  116 },
+    { 0xf209787bb47d6b85ULL,   348,  124 },
+    { 0xb454e4a179dd1877ULL,   375,  132 },
+    { 0x865b86925b9bc5c2ULL,   402,  140 },
+    { 0xc83553c5c8965d3dULL,   428,  148 },
+    { 0x952ab45cfa97a0b3ULL,   455,  156 },
+    { 0xde469fbd99a05fe3ULL,   481,  164 },
+    { 0xa59bc234db398c25ULL,   508,  172 },
+    { 0xf6c69a72a3989f5cULL,   534,  180 },
+    { 0xb7dcbf5354e9beceULL,   561,  188 },
+    { 0x88fcf317f22241e2ULL,   588,  196 },
+    { 0xcc20ce9bd35c78a5ULL,   614,  204 },
+    { 0x98165af37b2153dfULL,   641,  212 },
+    { 0xe2a0b5dc971f303aULL,   667,  220 },
+    { 0xa8d9d1535ce3b396ULL,   694,  228 },
+    { 0xfb9b7cd9a4a7443cULL,   720,  236 },
+    { 0xbb764c4ca7a44410ULL,   747,  244 },
+    { 0x8bab8eefb6409c1aULL,   774,  252 },
+    { 0xd01fef10a657842cULL,   800,  260 },
+    { 0x9b10a4e5e9913129ULL,   827,  268 },
+    { 0xe7109bfba19c0c9dULL,   853,  276 },
+    { 0xac2820d9623bf429ULL,   880,  284 },
+    { 0x80444b5e7aa7cf85ULL,   907,  292 },
+    { 0xbf21e44003acdd2dULL,   933,  300 },
+    { 0x8e679c2f5e44ff8fULL,   960,  308 },
+    { 0xd433179d9c8cb841ULL,   986,  316 },
+    { 0x9e19db92b4e31ba9ULL,  1013,  324 },
+    { 0xeb96bf6ebadf77d9ULL,  1039,  332 },
+    { 0xaf87023b9bf0ee6bULL,  1066,  340 }
+};
+
+#define CACHED_POWERS_OFFSET     348
+#define CACHED_POWERS_DISTANCE   8
+#define MINIMAL_TARGET_EXPONENT  -60
+#define MAXIMAL_TARGET_EXPONENT  -32
+
+#define DP_SIGNIFICAND_MASK      0x000FFFFFFFFFFFFFULL
+#define DP_HIDDEN_BIT            0x0010000000000000ULL
+#define DP_EXPONENT_BIAS         (0x3FF + 52)
+#define DP_DENORMAL_EXPONENT     (-DP_EXPONENT_BIAS + 1)
+
+static const uint32_t small_powers_of_ten[] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+static inline uint64_t double_to_bits(double d)
+{
+    uint64_t bits;
+
+    memcpy(&bits, &d, sizeof(bits));
+
+    return bits;
+}
+
+static inline diy_fp_t diy_fp_normalize(diy_fp_t x)
+{
+    while (!(x.f & 0xFFC0000000000000ULL)) {
+        x.f <<= 10;
+        x.e -= 10;
+    }
+    while (!(x.f & 0x8000000000000000ULL)) {
+        x.f <<= 1;
+        x.e--;
+    }
+
+    return x;
+}
+
+/* Product rounded to the 64 most significant bits */
+static inline diy_fp_t diy_fp_times(diy_fp_t x, diy_fp_t y)
+{
+    const uint64_t m32 = 0xFFFFFFFFULL;
+    uint64_t a = x.f >> 32, b = x.f & m32;
+    uint64_t c = y.f >> 32, d = y.f & m32;
+    uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+    uint64_t tmp = (bd >> 32) + (ad & m32) + (bc & m32);
+    diy_fp_t r;
+
+    tmp += 1U << 31;
+    r.f = ac + (ad >> 32) + (bc >> 32) + (tmp >> 32);
+    r.e = x.e + y.e + 64;
+
+    return r;
+}
+
+/* Double as a normalized number, and its normalized boundaries */
+static void double_boundaries(double d, diy_fp_t *w, diy_fp_t *minus, diy_fp_t *plus)
+{
+    uint64_t bits = double_to_bits(d);
+    int biased_e = (int)((bits >> 52) & 0x7FF);
+    diy_fp_t v;
+
+    if (biased_e) {
+        v.f = (bits & DP_SIGNIFICAND_MASK) | DP_HIDDEN_BIT;
+        v.e = biased_e - DP_EXPONENT_BIAS;
+    } else {
+        v.f = bits & DP_SIGNIFICAND_MASK;
+        v.e = DP_DENORMAL_EXPONENT;
+    }
+
+    plus->f = (v.f << 1) + 1;
+    plus->e = v.e - 1;
+    *plus = diy_fp_normalize(*plus);
+
+    /* The lower boundary is closer if the significand is a power of two */
+    if (((bits & DP_SIGNIFICAND_MASK) == 0) && (biased_e > 1)) {
+        minus->f = (v.f << 2) - 1;
+        minus->e = v.e - 2;
+    } else {
+        minus->f = (v.f << 1) - 1;
+        minus->e = v.e - 1;
+    }
+    minus->f <<= minus->e - plus->e;
+    minus->e = plus->e;
+
+    *w = diy_fp_normalize(v);
+}
+
+static int round_weed(char *buffer, int length, uint64_t distance_too_high_w,
+                      uint64_t unsafe_interval, uint64_t rest,
+                      uint64_t ten_kappa, uint64_t unit)
+{
+    uint64_t small_distance = distance_too_high_w - unit;
+    uint64_t big_distance = distance_too_high_w + unit;
+
+    /* Move the last digit towards w, while it stays in the safe interval */
+    while (rest < small_distance &&
+           unsafe_interval - rest >= ten_kappa &&
+           (rest + ten_kappa < small_distance ||
+            small_distance - rest >= rest + ten_kappa - small_distance)) {
+        buffer[length - 1]--;
+        rest += ten_kappa;
+    }
+
+    /* Reject if another candidate could be closer to w */
+    if (rest < big_distance &&
+        unsafe_interval - rest >= ten_kappa &&
+        (rest + ten_kappa < big_distance ||
+         big_distance - rest > rest + ten_kappa - big_distance)) {
+        return 0;
+    }
+
+    return (2 * unit <= rest) && (rest <= unsafe_interval - 4 * unit);
+}
+
+static int digit_gen(diy_fp_t low, diy_fp_t w, diy_fp_t high,
+                     char *buffer, int *length, int *kappa)
+{
+    uint64_t unit = 1;
+    uint64_t too_low = low.f - unit;
+    uint64_t too_high = high.f + unit;
+    uint64_t unsafe_interval = too_high - too_low;
+    int one_e = -w.e;
+    uint64_t one_f = 1ULL << one_e;
+    uint32_t integrals = (uint32_t)(too_high >> one_e);
+    uint64_t fractionals = too_high & (one_f - 1);
+    uint32_t divisor;
+    uint64_t rest;
+    int digit;
+
+    /* Biggest power of ten not greater than integrals */
+    *kappa = 0;
+    while ((*kappa < 10) && (integrals >= small_powers_of_ten[*kappa]))
+        (*kappa)++;
+    divisor = *kappa ? small_powers_of_ten[*kappa - 1] : 0;
+
+    *length = 0;
+    while (*kappa > 0) {
+        digit = integrals / divisor;
+        buffer[(*length)++] = '0' + digit;
+        integrals %= divisor;
+        (*kappa)--;
+
+        rest = ((uint64_t)integrals << one_e) + fractionals;
+        if (rest < unsafe_interval) {
+            return round_weed(buffer, *length, too_high - w.f, unsafe_interval,
+                              rest, (uint64_t)divisor << one_e, unit);
+        }
+        divisor /= 10;
+    }
+
+    for (;;) {
+        fractionals *= 10;
+        unit *= 10;
+        unsafe_interval *= 10;
+        digit = (int)(fractionals >> one_e);
+        buffer[(*length)++] = '0' + digit;
+        fractionals &= one_f - 1;
+        (*kappa)--;
+
+        if (fractionals < unsafe_interval) {
+            return round_weed(buffer, *length, (too_high - w.f) * unit,
+                              unsafe_interval, fractionals, one_f, unit);
+        }
+    }
+}
+
+/* Shortest digits that round trip to d (positive, finite, not 0), and the
+ * closest to d among them. d = digits * 10^exponent. Returns 0 if Grisu3
+ * can't guarantee the result. */
+static int grisu3(double d, char *digits, int *length, int *exponent)
+{
+    diy_fp_t w, minus, plus, ten_mk;
+    int min_e, k, index, kappa;
+
+    double_boundaries(d, &w, &minus, &plus);
+
+    /* Cached power that brings the exponent of w to the target range */
+    min_e = MINIMAL_TARGET_EXPONENT - (w.e + 64);
+    k = (int)ceil((min_e + 64 - 1) * 0.30102999566398114);
+    index = (CACHED_POWERS_OFFSET + k - 1) / CACHED_POWERS_DISTANCE + 1;
+
+    ten_mk.f = cached_powers[index].f;
+    ten_mk.e = cached_powers[index].e;
+
+    if (!digit_gen(diy_fp_times(minus, ten_mk), diy_fp_times(w, ten_mk),
+                   diy_fp_times(plus, ten_mk), digits, length, &kappa)) {
+        return 0;
+    }
+
+    *exponent = kappa - cached_powers[index].k;
+
+    return 1;
+}
+
+/* Write an unsigned integer, returns the number of digits */
+static int u64_fmt(char *str, uint64_t value)
+{
+    char buf[20];
+    int len = 0;
+    int i;
+
+    do {
+        buf[len++] = '0' + (value % 10);
+        value /= 10;
+    } while (value);
+
+    for (i = 0; i < len; i++)
+        str[i] = buf[len - 1 - i];
+
+    return len;
+}
+
+/* Format digits (without trailing zeros) with the decimal point after
+ * decpt digits, as sprintf("%.<precision>g") does */
+static int fmt_digits(char *str, int neg, const char *digits, int length,
+                      int decpt, int precision)
+{
+    char *p = str;
+    int exp10 = decpt - 1;
+    int i;
+
+    if (neg)
+        *p++ = '-';
+
+    if (exp10 < -4 || exp10 >= precision) {
+        /* d[.ddd]e[+-]xx */
+        *p++ = digits[0];
+        if (length > 1) {
+            *p++ = '.';
+            memcpy(p, digits + 1, length - 1);
+            p += length - 1;
+        }
+        *p++ = 'e';
+        if (exp10 < 0) {
+            *p++ = '-';
+            exp10 = -exp10;
+        } else {
+            *p++ = '+';
+        }
+        if (exp10 < 10)
+            *p++ = '0';
+        p += u64_fmt(p, exp10);
+    } else if (decpt <= 0) {
+        /* 0.000ddd */
+        *p++ = '0';
+        *p++ = '.';
+        for (i = decpt; i < 0; i++)
+            *p++ = '0';
+        memcpy(p, digits, length);
+        p += length;
+    } else if (decpt >= length) {
+        /* ddd000 */
+        memcpy(p, digits, length);
+        p += length;
+        for (i = length; i < decpt; i++)
+            *p++ = '0';
+    } else {
+        /* ddd.ddd */
+        memcpy(p, digits, decpt);
+        p += decpt;
+        *p++ = '.';
+        memcpy(p, digits + decpt, length - decpt);
+        p += length - decpt;
+    }
+
+    *p = 0;
+
+    return p - str;
+}
+
+/* Assumes there is always at least 32 characters available in the target buffer */
+int fpconv_g_fmt(char *str, double num, int precision)
+{
+    char digits[24];
+    uint64_t integer;
+    int length, exponent, decpt, neg;
+    int i;
+
+    assert(0 <= precision && precision <= 14);
+
+    neg = signbit(num) ? 1 : 0;
+    if (neg)
+        num = -num;
+
+    if (isnan(num) || isinf(num))
+        return precision ? fpconv_g_fmt_slow(str, neg ? -num : num, precision)
+                         : fpconv_shortest_slow(str, neg ? -num : num);
+
+    if (num == 0) {
+        digits[0] = '0';
+        return fmt_digits(str, neg, digits, 1, 1, 17);
+    }
+
+    /* Integers below 2^53 are exact, and are written as is if they
+     * have no more digits than the precision */
+    if (num < 9007199254740992.0 && num == (double)(integer = (uint64_t)num)) {
+        length = u64_fmt(digits, integer);
+        if (!precision || length <= precision) {
+            decpt = length;
+            while (digits[length - 1] == '0')
+                length--;
+            return fmt_digits(str, neg, digits, length, decpt, precision ? precision : 17);
+        }
+    }
+
+    if (!grisu3(num, digits, &length, &exponent))
+        return precision ? fpconv_g_fmt_slow(str, neg ? -num : num, precision)
+                         : fpconv_shortest_slow(str, neg ? -num : num);
+
+    while (digits[length - 1] == '0') {
+        length--;
+        exponent++;
+    }
+    decpt = length + exponent;
+
+    if (!precision)
+        return fmt_digits(str, neg, digits, length, decpt, 17);
+
+    /* Up to 15 digits, the shortest digits of a normal double rounded to
+     * the precision are the exact value rounded to the precision, except
+     * if they end just in the middle. Then the side of the exact value is
+     * not known. */
+    if (num < 2.2250738585072014e-308)
+        return fpconv_g_fmt_slow(str, neg ? -num : num, precision);
+
+    if (length > precision) {
+        if (digits[precision] == '5' && length == precision + 1)
+            return fpconv_g_fmt_slow(str, neg ? -num : num, precision);
+
+        length = precision;
+        if (digits[precision] >= '5') {
+            for (i = length - 1; i >= 0 && digits[i] == '9'; i--)
+                length--;
+            if (i < 0) {
+                digits[0] = '1';
+                length = 1;
+                decpt++;
+            } else {
+                digits[i]++;
+            }
+        }
+
+        while (digits[length - 1] == '0')
+            length--;
+    }
+
+    return fmt_digits(str, neg, digits, length, decpt, precision);
+}
+
+/* Assumes there is always at least 21 characters available in the target buffer */
+int fpconv_i_fmt(char *str, long long num)
+{
+    int len = 0;
+
+    if (num < 0) {
+        str[len++] = '-';
+        len += u64_fmt(str + len, 0ULL - (uint64_t)num);
+    } else {
+        len += u64_fmt(str + len, (uint64_t)num);
+    }
+
+    str[len] = 0;
+
+    return len;
+}
+
+/* ---------------------------------------------------------------------
+ * Eisel-Lemire
+ * --------------------------------------------------------------------- */
+
+/* 128 bit approximations of 5^q, normalized so that the most significant
+ * bit is set, for POW5_MIN <= q <= POW5_MAX. Decimal exponents out of
+ * this range are rare in JSON, and are left to strtod(). */
+#define POW5_MIN -64
+#define POW5_MAX 64
+
+static const struct {
+    uint64_t hi;
+    uint64_t lo;
+} pow5_128[] = {
+    { 0xa87fea27a539e9a5ULL, 0x3f2398d747b36224ULL }, /* -64 */
+    { 0xd29fe4b18e88640eULL, 0x8eec7f0d19a03aadULL }, /* -63 */
+    { 0x83a3eeeef9153e89ULL, 0x1953cf68300424acULL }, /* -62 */
+    { 0xa48ceaaab75a8e2bULL, 0x5fa8c3423c052dd7ULL }, /* -61 */
+    { 0xcdb02555653131b6ULL, 0x3792f412cb06794dULL }, /* -60 */
+    { 0x808e17555f3ebf11ULL, 0xe2bbd88bbee40bd0ULL }, /* -59 */
+    { 0xa0b19d2ab70e6ed6ULL, 0x5b6aceaeae9d0ec4ULL }, /* -58 */
+    { 0xc8de047564d20a8bULL, 0xf245825a5a445275ULL }, /* -57 */
+    { 0xfb158592be068d2eULL, 0xeed6e2f0f0d56712ULL }, /* -56 */
+    { 0x9ced737bb6c4183dULL, 0x55464dd69685606bULL }, /* -55 */
+    { 0xc428d05aa4751e4cULL, 0xaa97e14c3c26b886ULL }, /* -54 */
+    { 0xf53304714d9265dfULL, 0xd53dd99f4b3066a8ULL }, /* -53 */
+    { 0x993fe2c6d07b7fabULL, 0xe546a8038efe4029ULL }, /* -52 */
+    { 0xbf8fdb78849a5f96ULL, 0xde98520472bdd033ULL }, /* -51 */
+    { 0xef73d256a5c0f77cULL, 0x963e66858f6d4440ULL }, /* -50 */
+    { 0x95a8637627989aadULL, 0xdde7001379a44aa8ULL }, /* -49 */
+    { 0xbb127c53b17ec159ULL, 0x5560c018580d5d52ULL }, /* -48 */
+    { 0xe9d71b689dde71afULL, 0xaab8f01e6e10b4a6ULL }, /* -47 */
+    { 0x9226712162ab070dULL, 0xcab3961304ca70e8ULL }, /* -46 */
+    { 0xb6b00d69bb55c8d1ULL, 0x3d607b97c5fd0d22ULL }, /* -45 */
+    { 0xe45c10c42a2b3b05ULL, 0x8cb89a7db77c506aULL }, /* -44 */
+    { 0x8eb98a7a9a5b04e3ULL, 0x77f3608e92adb242ULL }, /* -43 */
+    { 0xb267ed1940f1c61cULL, 0x55f038b237591ed3ULL }, /* -42 */
+    { 0xdf01e85f912e37a3ULL, 0x6b6c46dec52f6688ULL }, /* -41 */
+    { 0x8b61313bbabce2c6ULL, 0x2323ac4b3b3da015ULL }, /* -40 */
+    { 0xae397d8aa96c1b77ULL, 0xabec975e0a0d081aULL }, /* -39 */
+    { 0xd9c7dced53c72255ULL, 0x96e7bd358c904a21ULL }, /* -38 */
+    { 0x881cea14545c7575ULL, 0x7e50d64177da2e54ULL }, /* -37 */
+    { 0xaa242499697392d2ULL, 0xdde50bd1d5d0b9e9ULL }, /* -36 */
+    { 0xd4ad2dbfc3d07787ULL, 0x955e4ec64b44e864ULL }, /* -35 */
+    { 0x84ec3c97da624ab4ULL, 0xbd5af13bef0b113eULL }, /* -34 */
+    { 0xa6274bbdd0fadd61ULL, 0xecb1ad8aeacdd58eULL }, /* -33 */
+    { 0xcfb11ead453994baULL, 0x67de18eda5814af2ULL }, /* -32 */
+    { 0x81ceb32c4b43fcf4ULL, 0x80eacf948770ced7ULL }, /* -31 */
+    { 0xa2425ff75e14fc31ULL, 0xa1258379a94d028dULL }, /* -30 */
+    { 0xcad2f7f5359a3b3eULL, 0x096ee45813a04330ULL }, /* -29 */
+    { 0xfd87b5f28300ca0dULL, 0x8bca9d6e188853fcULL }, /* -28 */
+    { 0x9e74d1b791e07e48ULL, 0x775ea264cf55347eULL }, /* -27 */
+    { 0xc612062576589ddaULL, 0x95364afe032a819eULL }, /* -26 */
+    { 0xf79687aed3eec551ULL, 0x3a83ddbd83f52205ULL }, /* -25 */
+    { 0x9abe14cd44753b52ULL, 0xc4926a9672793543ULL }, /* -24 */
+    { 0xc16d9a0095928a27ULL, 0x75b7053c0f178294ULL }, /* -23 */
+    { 0xf1c90080baf72cb1ULL, 0x5324c68b12dd6339ULL }, /* -22 */
+    { 0x971da05074da7beeULL, 0xd3f6fc16ebca5e04ULL }, /* -21 */
+    { 0xbce5086492111aeaULL, 0x88f4bb1ca6bcf585ULL }, /* -20 */
+    { 0xec1e4a7db69561a5ULL, 0x2b31e9e3d06c32e6ULL }, /* -19 */
+    { 0x9392ee8e921d5d07ULL, 0x3aff322e62439fd0ULL }, /* -18 */
+    { 0xb877aa3236a4b449ULL, 0x09befeb9fad487c3ULL }, /* -17 */
+    { 0xe69594bec44de15bULL, 0x4c2ebe687989a9b4ULL }, /* -16 */
+    { 0x901d7cf73ab0acd9ULL, 0x0f9d37014bf60a11ULL }, /* -15 */
+    { 0xb424dc35095cd80fULL, 0x538484c19ef38c95ULL }, /* -14 */
+    { 0xe12e13424bb40e13ULL, 0x2865a5f206b06fbaULL }, /* -13 */
+    { 0x8cbccc096f5088cbULL, 0xf93f87b7442e45d4ULL }, /* -12 */
+    { 0xafebff0bcb24aafeULL, 0xf78f69a51539d749ULL }, /* -11 */
+    { 0xdbe6fecebdedd5beULL, 0xb573440e5a884d1cULL }, /* -10 */
+    { 0x89705f4136b4a597ULL, 0x31680a88f8953031ULL }, /* -9 */
+    { 0xabcc77118461cefcULL, 0xfdc20d2b36ba7c3eULL }, /* -8 */
+    { 0xd6bf94d5e57a42bcULL, 0x3d32907604691b4dULL }, /* -7 */
+    { 0x8637bd05af6c69b5ULL, 0xa63f9a49c2c1b110ULL }, /* -6 */
+    { 0xa7c5ac471b478423ULL, 0x0fcf80dc33721d54ULL }, /* -5 */
+    { 0xd1b71758e219652bULL, 0xd3c36113404ea4a9ULL }, /* -4 */
+    { 0x83126e978d4fdf3bULL, 0x645a1cac083126eaULL }, /* -3 */
+    { 0xa3d70a3d70a3d70aULL, 0x3d70a3d70a3d70a4ULL }, /* -2 */
+    { 0xccccccccccccccccULL, 0xcccccccccccccccdULL }, /* -1 */
+    { 0x8000000000000000ULL, 0x0000000000000000ULL }, /* 0 */
+    { 0xa000000000000000ULL, 0x0000000000000000ULL }, /* 1 */
+    { 0xc800000000000000ULL, 0x0000000000000000ULL }, /* 2 */
+    { 0xfa00000000000000ULL, 0x0000000000000000ULL }, /* 3 */
+    { 0x9c40000000000000ULL, 0x0000000000000000ULL }, /* 4 */
+    { 0xc350000000000000ULL, 0x0000000000000000ULL }, /* 5 */
+    { 0xf424000000000000ULL, 0x0000000000000000ULL }, /* 6 */
+    { 0x9896800000000000ULL, 0x0000000000000000ULL }, /* 7 */
+    { 0xbebc200000000000ULL, 0x0000000000000000ULL }, /* 8 */
+    { 0xee6b280000000000ULL, 0x0000000000000000ULL }, /* 9 */
+    { 0x9502f90000000000ULL, 0x0000000000000000ULL }, /* 10 */
+    { 0xba43b74000000000ULL, 0x0000000000000000ULL }, /* 11 */
+    { 0xe8d4a51000000000ULL, 0x0000000000000000ULL }, /* 12 */
+    { 0x9184e72a00000000ULL, 0x0000000000000000ULL }, /* 13 */
+    { 0xb5e620f480000000ULL, 0x0000000000000000ULL }, /* 14 */
+    { 0xe35fa931a0000000ULL, 0x0000000000000000ULL }, /* 15 */
+    { 0x8e1bc9bf04000000ULL, 0x0000000000000000ULL }, /* 16 */
+    { 0xb1a2bc2ec5000000ULL, 0x0000000000000000ULL }, /* 17 */
+    { 0xde0b6b3a76400000ULL, 0x0000000000000000ULL }, /* 18 */
+    { 0x8ac7230489e80000ULL, 0x0000000000000000ULL }, /* 19 */
+    { 0xad78ebc5ac620000ULL, 0x0000000000000000ULL }, /* 20 */
+    { 0xd8d726b7177a8000ULL, 0x0000000000000000ULL }, /* 21 */
+    { 0x878678326eac9000ULL, 0x0000000000000000ULL }, /* 22 */
+    { 0xa968163f0a57b400ULL, 0x0000000000000000ULL }, /* 23 */
+    { 0xd3c21bcecceda100ULL, 0x0000000000000000ULL }, /* 24 */
+    { 0x84595161401484a0ULL, 0x0000000000000000ULL }, /* 25 */
+    { 0xa56fa5b99019a5c8ULL, 0x0000000000000000ULL }, /* 26 */
+    { 0xcecb8f27f4200f3aULL, 0x0000000000000000ULL }, /* 27 */
+    { 0x813f3978f8940984ULL, 0x4000000000000000ULL }, /* 28 */
+    { 0xa18f07d736b90be5ULL, 0x5000000000000000ULL }, /* 29 */
+    { 0xc9f2c9cd04674edeULL, 0xa400000000000000ULL }, /* 30 */
+    { 0xfc6f7c4045812296ULL, 0x4d00000000000000ULL }, /* 31 */
+    { 0x9dc5ada82b70b59dULL, 0xf020000000000000ULL }, /* 32 */
+    { 0xc5371912364ce305ULL, 0x6c28000000000000ULL }, /* 33 */
+    { 0xf684df56c3e01bc6ULL, 0xc732000000000000ULL }, /* 34 */
+    { 0x9a130b963a6c115cULL, 0x3c7f400000000000ULL }, /* 35 */
+    { 0xc097ce7bc90715b3ULL, 0x4b9f100000000000ULL }, /* 36 */
+    { 0xf0bdc21abb48db20ULL, 0x1e86d40000000000ULL }, /* 37 */
+    { 0x96769950b50d88f4ULL, 0x1314448000000000ULL }, /* 38 */
+    { 0xbc143fa4e250eb31ULL, 0x17d955a000000000ULL }, /* 39 */
+    { 0xeb194f8e1ae525fdULL, 0x5dcfab0800000000ULL }, /* 40 */
+    { 0x92efd1b8d0cf37beULL, 0x5aa1cae500000000ULL }, /* 41 */
+    { 0xb7abc627050305adULL, 0xf14a3d9e40000000ULL }, /* 42 */
+    { 0xe596b7b0c643c719ULL, 0x6d9ccd05d0000000ULL }, /* 43 */
+    { 0x8f7e32ce7bea5c6fULL, 0xe4820023a2000000ULL }, /* 44 */
+    { 0xb35dbf821ae4f38bULL, 0xdda2802c8a800000ULL }, /* 45 */
+    { 0xe0352f62a19e306eULL, 0xd50b2037ad200000ULL }, /* 46 */
+    { 0x8c213d9da502de45ULL, 0x4526f422cc340000ULL }, /* 47 */
+    { 0xaf298d050e4395d6ULL, 0x9670b12b7f410000ULL }, /* 48 */
+    { 0xdaf3f04651d47b4cULL, 0x3c0cdd765f114000ULL }, /* 49 */
+    { 0x88d8762bf324cd0fULL, 0xa5880a69fb6ac800ULL }, /* 50 */
+    { 0xab0e93b6efee0053ULL, 0x8eea0d047a457a00ULL }, /* 51 */
+    { 0xd5d238a4abe98068ULL, 0x72a4904598d6d880ULL }, /* 52 */
+    { 0x85a36366eb71f041ULL, 0x47a6da2b7f864750ULL }, /* 53 */
+    { 0xa70c3c40a64e6c51ULL, 0x999090b65f67d924ULL }, /* 54 */
+    { 0xd0cf4b50cfe20765ULL, 0xfff4b4e3f741cf6dULL }, /* 55 */
+    { 0x82818f1281ed449fULL, 0xbff8f10e7a8921a4ULL }, /* 56 */
+    { 0xa321f2d7226895c7ULL, 0xaff72d52192b6a0dULL }, /* 57 */
+    { 0xcbea6f8ceb02bb39ULL, 0x9bf4f8a69f764490ULL }, /* 58 */
+    { 0xfee50b7025c36a08ULL, 0x02f236d04753d5b4ULL }, /* 59 */
+    { 0x9f4f2726179a2245ULL, 0x01d762422c946590ULL }, /* 60 */
+    { 0xc722f0ef9d80aad6ULL, 0x424d3ad2b7b97ef5ULL }, /* 61 */
+    { 0xf8ebad2b84e0d58bULL, 0xd2e0898765a7deb2ULL }, /* 62 */
+    { 0x9b934c3b330c8577ULL, 0x63cc55f49f88eb2fULL }, /* 63 */
+    { 0xc2781f49ffcfa6d5ULL, 0x3cbf6b71c76b25fbULL }, /* 64 */
+};
+
+/* Exact powers of ten for Clinger's fast path */
+static const double exact_powers_of_ten[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/* 64 x 64 -> 128 bit multiplication */
+static inline void full_mul(uint64_t a, uint64_t b, uint64_t *hi, uint64_t *lo)
+{
+    uint64_t a_lo = (uint32_t)a, a_hi = a >> 32;
+    uint64_t b_lo = (uint32_t)b, b_hi = b >> 32;
+    uint64_t p0 = a_lo * b_lo;
+    uint64_t p1 = a_lo * b_hi;
+    uint64_t p2 = a_hi * b_lo;
+    uint64_t p3 = a_hi * b_hi;
+    uint64_t mid = (p0 >> 32) + (uint32_t)p1 + (uint32_t)p2;
+
+    *lo = (mid << 32) | (uint32_t)p0;
+    *hi = p3 + (p1 >> 32) + (p2 >> 32) + (mid >> 32);
+}
+
+static inline int leading_zeros(uint64_t x)
+{
+    int n = 0;
+
+    while (!(x & 0xFFFFFFFF00000000ULL)) {
+        x <<= 32;
+        n += 32;
+    }
+    while (!(x & 0x8000000000000000ULL)) {
+        x <<= 1;
+        n++;
+    }
+
+    return n;
+}
+
+/* w * 10^q correctly rounded (w != 0), returns 0 if it can't be done
+ * here */
+static int eisel_lemire(uint64_t w, int q, double *value)
+{
+    uint64_t hi, lo, hi2, lo2, mantissa, bits;
+    int lz, upperbit, shift, power2;
+
+    if (q < POW5_MIN || q > POW5_MAX)
+        return 0;
+
+    lz = leading_zeros(w);
+    w <<= lz;
+
+    /* Product with 55 significant bits at least, the 64 most significant
+     * bits of 5^q are enough unless the bits below them are all ones */
+    full_mul(w, pow5_128[q - POW5_MIN].hi, &hi, &lo);
+    if ((hi & 0x1FF) == 0x1FF) {
+        full_mul(w, pow5_128[q - POW5_MIN].lo, &hi2, &lo2);
+        lo += hi2;
+        if (hi2 > lo)
+            hi++;
+    }
+
+    if (lo == 0xFFFFFFFFFFFFFFFFULL && (q < -27 || q > 55))
+        return 0;
+
+    upperbit = (int)(hi >> 63);
+    shift = upperbit + 64 - 52 - 3;
+    mantissa = hi >> shift;
+    power2 = (((152170 + 65536) * q) >> 16) + 63 + upperbit - lz + 1023;
+
+    /* Subnormals are left to strtod() */
+    if (power2 <= 0)
+        return 0;
+
+    /* Exactly in the middle of two doubles, round to even */
+    if (lo <= 1 && q >= -4 && q <= 23 && (mantissa & 3) == 1 &&
+        (mantissa << shift) == hi) {
+        mantissa &= ~1ULL;
+    }
+
+    mantissa += mantissa & 1;
+    mantissa >>= 1;
+    if (mantissa >= (2ULL << 52)) {
+        mantissa = 1ULL << 52;
+        power2++;
+    }
+    mantissa &= ~(1ULL << 52);
+
+    if (power2 >= 0x7FF)
+        return 0;
+
+    bits = mantissa | ((uint64_t)power2 << 52);
+    memcpy(value, &bits, sizeof(bits));
+
+    return 1;
+}
+
+/* Parse a decimal number in the JSON syntax (with an optional fraction
+ * and exponent). Returns 0 if it must be parsed by strtod(). */
+static int parse_decimal(const char *nptr, const char **endptr, int *neg,
+                         uint64_t *w, int *q)
+{
+    const char *p = nptr;
+    const char *start;
+    int digits = 0;
+    int exp10 = 0;
+    int eneg;
+    int e;
+
+    *neg = 0;
+    if (*p == '-') {
+        *neg = 1;
+        p++;
+    }
+
+    /* Hexadecimal, or not a number, such as inf or nan */
+    if (*p == '0' && (p[1] | 0x20) == 'x')
+        return 0;
+    if (!(('0' <= *p && *p <= '9') || (*p == '.' && '0' <= p[1] && p[1] <= '9')))
+        return 0;
+
+    /* Significant digits */
+    *w = 0;
+    while (*p == '0')
+        p++;
+    start = p;
+    while ('0' <= *p && *p <= '9') {
+        *w = *w * 10 + (*p - '0');
+        p++;
+    }
+    digits = p - start;
+
+    if (*p == '.') {
+        p++;
+        start = p;
+        if (!*w) {
+            while (*p == '0')
+                p++;
+        }
+        exp10 = -(int)(p - start);
+        start = p;
+        while ('0' <= *p && *p <= '9') {
+            *w = *w * 10 + (*p - '0');
+            p++;
+        }
+        digits += p - start;
+        exp10 -= p - start;
+    }
+
+    /* More digits than a 64 bit integer holds */
+    if (digits > 19)
+        return 0;
+
+    /* Exponent, if followed by digits */
+    if ((*p | 0x20) == 'e') {
+        const char *pe = p + 1;
+
+        eneg = 0;
+        if (*pe == '-' || *pe == '+')
+            eneg = (*pe++ == '-');
+
+        if ('0' <= *pe && *pe <= '9') {
+            e = 0;
+            while ('0' <= *pe && *pe <= '9') {
+                if (e < 10000)
+                    e = e * 10 + (*pe - '0');
+                pe++;
+            }
+            exp10 += eneg ? -e : e;
+            p = pe;
+        }
+    }
+
+    *q = exp10;
+    *endptr = p;
+
+    return 1;
+}
+
+double fpconv_strtod(const char *nptr, char **endptr)
+{
+    const char *end;
+    uint64_t w;
+    double value;
+    int neg, q;
+
+    if (!parse_decimal(nptr, &end, &neg, &w, &q))
+        return fpconv_strtod_slow(nptr, endptr);
+
+    if (!w) {
+        value = 0;
+    } else if (w <= (1ULL << 53) && q >= -22 && q <= 22) {
+        /* Clinger's fast path, both operands are exact so the result is
+         * correctly rounded */
+        value = (double)w;
+        if (q < 0)
+            value /= exact_powers_of_ten[-q];
+        else
+            value *= exact_powers_of_ten[q];
+    } else if (!eisel_lemire(w, q, &value)) {
+        return fpconv_strtod_slow(nptr, endptr);
+    }
+
+    *endptr = (char *)end;
+
+    return neg ? -value : value;
+}
+
+/* Parse a decimal integer in [min, max], without fraction nor exponent.
+ * Returns 0 if it is not one, and nothing is parsed. */
+int fpconv_strtoi(const char *nptr, char **endptr, long long min,
+                  long long max, long long *value)
+{
+    const char *p = nptr;
+    uint64_t limit, v = 0;
+    int neg = 0;
+
+    if (*p == '-') {
+        neg = 1;
+        p++;
+    }
+
+    if (*p < '0' || *p > '9')
+        return 0;
+
+    limit = neg ? 0ULL - (uint64_t)min : (uint64_t)max;
+
+    while ('0' <= *p && *p <= '9') {
+        if (v > (limit - (*p - '0')) / 10)
+            return 0;
+        v = v * 10 + (*p - '0');
+        p++;
+    }
+
+    /* A fraction or an exponent makes it a float, and so does -0 */
+    if (*p == '.' || (*p | 0x20) == 'e' || (neg && !v))
+        return 0;
+
+    *value = neg ? (long long)(0ULL - v) : (long long)v;
+    *endptr = (char *)p;
+
+    return 1;
+}
+
 void fpconv_init()
 {
     fpconv_update_locale();
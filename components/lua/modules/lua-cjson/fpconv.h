@@ -3,7 +3,10 @@
 /* Buffer required to store the largest string representation of a double.
  *
  * Longest double printed with %.14g is 21 characters long:
- * -1.7976931348623e+308 */
+ * -1.7976931348623e+308
+ *
+ * Longest shortest round trip representation (precision 0) is 24
+ * characters long: -2.2250738585072014e-308 */
 # define FPCONV_G_FMT_BUFSIZE   32
 
 #ifdef USE_INTERNAL_FPCONV
@@ -15,8 +18,12 @@ static inline void fpconv_init()
 extern void fpconv_init();
 #endif
 
+/* Same output as sprintf("%.<precision>g"), or the shortest representation
+ * that round trips if precision is 0 */
 extern int fpconv_g_fmt(char*, double, int);
+extern int fpconv_i_fmt(char*, long long);
 extern double fpconv_strtod(const char*, char**);
+extern int fpconv_strtoi(const char*, char**, long long, long long, long long*);
 
 /* vi:ai et sw=4 ts=4:
  */
@@ -0,0 +1,752 @@
+/* json_stream - Incremental JSON parser
+ *
+ * The parser is a state machine driven one character at a time, except
+ * for the runs of plain characters inside strings, that are copied at
+ * once. The grammar state is kept in a stack of frames, one for each
+ * open container, with frame 0 for the document itself.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "json_stream.h"
+#include "fpconv.h"
+
+/* What is expected next in a frame */
+enum {
+    ST_VALUE,
+    ST_VALUE_OR_END,
+    ST_KEY,
+    ST_KEY_OR_END,
+    ST_COLON,
+    ST_COMMA_OR_END,
+    ST_DONE
+};
+
+/* Token in progress */
+enum {
+    LEX_NONE,
+    LEX_STRING,
+    LEX_ESCAPE,
+    LEX_UNICODE,
+    LEX_SURROGATE,
+    LEX_SURROGATE_U,
+    LEX_NUMBER,
+    LEX_LITERAL
+};
+
+#define JSON_STREAM_TOKEN_SIZE  64
+#define JSON_STREAM_PATH_SIZE   64
+#define JSON_STREAM_FRAMES      8
+
+static void push_frame_init(json_stream_frame_t *f, char type, char state,
+                            char match, int key)
+{
+    f->type = type;
+    f->state = state;
+    f->match = match;
+    f->index = 0;
+    f->key = key;
+    f->key_len = -1;
+}
+
+void json_stream_init(json_stream_t *s, int max_depth, long long int_min,
+                      long long int_max, json_stream_handler_t handler,
+                      void *arg)
+{
+    memset(s, 0, sizeof(json_stream_t));
+
+    s->handler = handler;
+    s->arg = arg;
+    s->max_depth = max_depth;
+    s->int_min = int_min;
+    s->int_max = int_max;
+
+    s->frames = JSON_STREAM_FRAMES;
+    s->frame = (json_stream_frame_t *)malloc(s->frames * sizeof(json_stream_frame_t));
+    if (!s->frame)
+        abort();
+
+    push_frame_init(&s->frame[0], 0, ST_VALUE, 1, 0);
+
+    s->capture = -1;
+    s->skip = -1;
+    s->lex = LEX_NONE;
+
+    strbuf_init(&s->token, JSON_STREAM_TOKEN_SIZE);
+    strbuf_init(&s->path, JSON_STREAM_PATH_SIZE);
+}
+
+int json_stream_select(json_stream_t *s, const char *selector)
+{
+    int len = strlen(selector);
+    int i, n;
+
+    if (s->selector || s->offset)
+        return -1;
+
+    s->selector = (char *)malloc(len + 1);
+    s->component = (char **)malloc((len + 1) * sizeof(char *));
+    if (!s->selector || !s->component)
+        abort();
+
+    memcpy(s->selector, selector, len + 1);
+
+    /* Split in components, an empty selector is the document */
+    n = 0;
+    if (len) {
+        s->component[n++] = s->selector;
+        for (i = 0; i < len; i++) {
+            if (s->selector[i] == '.') {
+                s->selector[i] = 0;
+                s->component[n++] = &s->selector[i + 1];
+            }
+        }
+    }
+
+    for (i = 0; i < n; i++) {
+        if (!*s->component[i])
+            break;
+    }
+
+    if (i < n || n > s->max_depth) {
+        free(s->selector);
+        free(s->component);
+        s->selector = NULL;
+        s->component = NULL;
+        return -1;
+    }
+
+    s->components = n;
+
+    return 0;
+}
+
+/* ===== SELECTOR ===== */
+
+/* Does the position of the next value in a container match a component? */
+static int component_match(json_stream_t *s, json_stream_frame_t *f,
+                           const char *component)
+{
+    const char *c;
+    int index;
+
+    if (component[0] == '*' && !component[1])
+        return 1;
+
+    if (f->type == '[') {
+        index = 0;
+        for (c = component; *c; c++) {
+            if (*c < '0' || *c > '9' || index > 100000000)
+                return 0;
+            index = index * 10 + (*c - '0');
+        }
+
+        return index == f->index;
+    }
+
+    return (f->key_len == (int)strlen(component)) &&
+           !memcmp(s->path.buf + f->key, component, f->key_len);
+}
+
+/* A value begins. Returns 1 if its events are emitted. */
+static int value_begin(json_stream_t *s, int container, int *root, char *match)
+{
+    json_stream_frame_t *f = &s->frame[s->depth];
+    int d = s->depth;
+
+    if (f->type == '[')
+        f->index++;
+
+    *root = 0;
+    *match = 0;
+
+    if (!s->component || s->capture >= 0)
+        return 1;
+
+    if (s->skip >= 0)
+        return 0;
+
+    if (f->match && (d == 0 || component_match(s, f, s->component[d - 1]))) {
+        if (d == s->components) {
+            *root = 1;
+            if (container)
+                s->capture = d;
+            return 1;
+        }
+
+        *match = 1;
+        return 0;
+    }
+
+    if (container)
+        s->skip = d;
+
+    return 0;
+}
+
+/* Is the current member key needed by the selector? */
+static inline int key_needed(json_stream_t *s)
+{
+    return s->component && s->capture < 0 && s->skip < 0 &&
+           s->frame[s->depth].match && s->depth <= s->components;
+}
+
+/* Are the events emitted? */
+static inline int emitting(json_stream_t *s)
+{
+    return !s->component || s->capture >= 0;
+}
+
+/* Position of the value in its parent, and the key for a selected one */
+static void value_position(json_stream_t *s, json_stream_value_t *v, int root)
+{
+    json_stream_frame_t *f = &s->frame[s->depth];
+
+    v->depth = s->depth;
+    v->index = (f->type == '[') ? f->index : 0;
+    v->root = root;
+    v->key = NULL;
+    v->key_len = 0;
+
+    if (root && f->type == '{' && f->key_len >= 0) {
+        v->key = s->path.buf + f->key;
+        v->key_len = f->key_len;
+    }
+}
+
+/* A value has been completed in the current frame */
+static void value_end(json_stream_t *s)
+{
+    json_stream_frame_t *f = &s->frame[s->depth];
+
+    if (s->depth == 0) {
+        f->state = ST_DONE;
+        s->done = 1;
+    } else {
+        f->state = ST_COMMA_OR_END;
+    }
+}
+
+static int set_error(json_stream_t *s, const char *error)
+{
+    s->error = error;
+
+    return -1;
+}
+
+/* ===== CONTAINERS ===== */
+
+static int container_begin(json_stream_t *s, char type)
+{
+    json_stream_value_t v;
+    json_stream_frame_t *f;
+    int emit, root;
+    char match;
+
+    if (s->depth >= s->max_depth)
+        return set_error(s, "found too many nested data structures");
+
+    emit = value_begin(s, 1, &root, &match);
+
+    if (emit) {
+        value_position(s, &v, root);
+        s->handler(s->arg, type == '{' ? JSON_EV_OBJ_BEGIN : JSON_EV_ARR_BEGIN, &v);
+    }
+
+    if (s->depth + 1 >= s->frames) {
+        f = (json_stream_frame_t *)realloc(s->frame, 2 * s->frames * sizeof(json_stream_frame_t));
+        if (!f)
+            abort();
+        s->frame = f;
+        s->frames *= 2;
+    }
+
+    s->depth++;
+    push_frame_init(&s->frame[s->depth], type,
+                    type == '{' ? ST_KEY_OR_END : ST_VALUE_OR_END,
+                    match, s->path.length);
+
+    return 0;
+}
+
+static void container_end(json_stream_t *s)
+{
+    json_stream_value_t v;
+    char type = s->frame[s->depth].type;
+
+    s->depth--;
+
+    if (emitting(s)) {
+        value_position(s, &v, s->capture == s->depth);
+        s->handler(s->arg, type == '{' ? JSON_EV_OBJ_END : JSON_EV_ARR_END, &v);
+    }
+
+    if (s->capture == s->depth)
+        s->capture = -1;
+    if (s->skip == s->depth)
+        s->skip = -1;
+
+    /* Drop the keys kept by the closed container */
+    s->path.length = s->frame[s->depth + 1].key;
+
+    value_end(s);
+}
+
+/* ===== SCALARS ===== */
+
+/* Begin a scalar token */
+static void token_begin(json_stream_t *s, int lex, int key)
+{
+    int root;
+    char match;
+
+    s->lex = lex;
+    s->lex_key = key;
+    strbuf_reset(&s->token);
+
+    if (key) {
+        s->lex_emit = emitting(s) || key_needed(s);
+    } else {
+        s->lex_emit = value_begin(s, 0, &root, &match);
+        s->lex_root = root;
+    }
+}
+
+static void string_end(json_stream_t *s)
+{
+    json_stream_frame_t *f = &s->frame[s->depth];
+    json_stream_value_t v;
+
+    s->lex = LEX_NONE;
+
+    if (s->lex_key) {
+        if (key_needed(s)) {
+            /* Keep the key, replacing the previous one */
+            s->path.length = f->key;
+            strbuf_append_mem(&s->path, s->token.buf, s->token.length);
+            f->key_len = s->token.length;
+        }
+
+        if (emitting(s)) {
+            value_position(s, &v, 0);
+            v.string = s->token.buf;
+            v.string_len = s->token.length;
+            s->handler(s->arg, JSON_EV_KEY, &v);
+        }
+
+        f->state = ST_COLON;
+        return;
+    }
+
+    if (s->lex_emit) {
+        value_position(s, &v, s->lex_root);
+        v.string = s->token.buf;
+        v.string_len = s->token.length;
+        s->handler(s->arg, JSON_EV_STRING, &v);
+    }
+
+    value_end(s);
+}
+
+/* Check -?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)? */
+static int valid_number(const char *p, int *integer)
+{
+    *integer = 1;
+
+    if (*p == '-')
+        p++;
+
+    if (*p == '0') {
+        p++;
+    } else if ('1' <= *p && *p <= '9') {
+        while ('0' <= *p && *p <= '9')
+            p++;
+    } else {
+        return 0;
+    }
+
+    if (*p == '.') {
+        *integer = 0;
+        p++;
+        if (*p < '0' || *p > '9')
+            return 0;
+        while ('0' <= *p && *p <= '9')
+            p++;
+    }
+
+    if (*p == 'e' || *p == 'E') {
+        *integer = 0;
+        p++;
+        if (*p == '-' || *p == '+')
+            p++;
+        if (*p < '0' || *p > '9')
+            return 0;
+        while ('0' <= *p && *p <= '9')
+            p++;
+    }
+
+    return *p == 0;
+}
+
+static int number_end(json_stream_t *s)
+{
+    json_stream_value_t v;
+    char *end;
+    int integer;
+
+    s->lex = LEX_NONE;
+
+    strbuf_ensure_null(&s->token);
+    if (!valid_number(s->token.buf, &integer))
+        return set_error(s, "invalid number");
+
+    if (s->lex_emit) {
+        value_position(s, &v, s->lex_root);
+        if (integer && fpconv_strtoi(s->token.buf, &end, s->int_min, s->int_max, &v.integer)) {
+            s->handler(s->arg, JSON_EV_INTEGER, &v);
+        } else {
+            v.number = fpconv_strtod(s->token.buf, &end);
+            s->handler(s->arg, JSON_EV_NUMBER, &v);
+        }
+    }
+
+    value_end(s);
+
+    return 0;
+}
+
+static void literal_end(json_stream_t *s)
+{
+    json_stream_value_t v;
+
+    s->lex = LEX_NONE;
+
+    if (s->lex_emit) {
+        value_position(s, &v, s->lex_root);
+        if (s->literal[0] == 'n') {
+            s->handler(s->arg, JSON_EV_NULL, &v);
+        } else {
+            v.boolean = (s->literal[0] == 't');
+            s->handler(s->arg, JSON_EV_BOOLEAN, &v);
+        }
+    }
+
+    value_end(s);
+}
+
+/* Append a code point as UTF-8 */
+static void append_utf8(strbuf_t *b, unsigned int cp)
+{
+    strbuf_ensure_empty_length(b, 4);
+
+    if (cp < 0x80) {
+        strbuf_append_char_unsafe(b, cp);
+    } else if (cp < 0x800) {
+        strbuf_append_char_unsafe(b, 0xC0 | (cp >> 6));
+        strbuf_append_char_unsafe(b, 0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        strbuf_append_char_unsafe(b, 0xE0 | (cp >> 12));
+        strbuf_append_char_unsafe(b, 0x80 | ((cp >> 6) & 0x3F));
+        strbuf_append_char_unsafe(b, 0x80 | (cp & 0x3F));
+    } else {
+        strbuf_append_char_unsafe(b, 0xF0 | (cp >> 18));
+        strbuf_append_char_unsafe(b, 0x80 | ((cp >> 12) & 0x3F));
+        strbuf_append_char_unsafe(b, 0x80 | ((cp >> 6) & 0x3F));
+        strbuf_append_char_unsafe(b, 0x80 | (cp & 0x3F));
+    }
+}
+
+static inline int hex_value(char c)
+{
+    if ('0' <= c && c <= '9')
+        return c - '0';
+    c |= 0x20;
+    if ('a' <= c && c <= 'f')
+        return c - 'a' + 10;
+
+    return -1;
+}
+
+static inline int is_number_char(char c)
+{
+    return ('0' <= c && c <= '9') || c == '-' || c == '+' || c == '.' ||
+           c == 'e' || c == 'E';
+}
+
+/* ===== PARSER ===== */
+
+/* Start of a token, outside of any token */
+static int token_start(json_stream_t *s, char c)
+{
+    json_stream_frame_t *f = &s->frame[s->depth];
+
+    switch (f->state) {
+    case ST_VALUE_OR_END:
+        if (c == ']') {
+            container_end(s);
+            return 0;
+        }
+        /* Fall through */
+    case ST_VALUE:
+        switch (c) {
+        case '{':
+        case '[':
+            return container_begin(s, c);
+        case '"':
+            token_begin(s, LEX_STRING, 0);
+            return 0;
+        case 't':
+            token_begin(s, LEX_LITERAL, 0);
+            s->literal = "true";
+            s->literal_pos = 1;
+            return 0;
+        case 'f':
+            token_begin(s, LEX_LITERAL, 0);
+            s->literal = "false";
+            s->literal_pos = 1;
+            return 0;
+        case 'n':
+            token_begin(s, LEX_LITERAL, 0);
+            s->literal = "null";
+            s->literal_pos = 1;
+            return 0;
+        default:
+            if (c == '-' || ('0' <= c && c <= '9')) {
+                token_begin(s, LEX_NUMBER, 0);
+                strbuf_append_char(&s->token, c);
+                return 0;
+            }
+        }
+        return set_error(s, "expected value");
+
+    case ST_KEY_OR_END:
+        if (c == '}') {
+            container_end(s);
+            return 0;
+        }
+        /* Fall through */
+    case ST_KEY:
+        if (c == '"') {
+            token_begin(s, LEX_STRING, 1);
+            return 0;
+        }
+        return set_error(s, "expected object key string");
+
+    case ST_COLON:
+        if (c == ':') {
+            f->state = ST_VALUE;
+            return 0;
+        }
+        return set_error(s, "expected colon");
+
+    case ST_COMMA_OR_END:
+        if (c == ',') {
+            f->state = (f->type == '{') ? ST_KEY : ST_VALUE;
+            return 0;
+        }
+        if ((c == '}' && f->type == '{') || (c == ']' && f->type == '[')) {
+            container_end(s);
+            return 0;
+        }
+        return set_error(s, f->type == '{' ? "expected comma or object end" :
+                                             "expected comma or array end");
+    }
+
+    return set_error(s, "expected the end");
+}
+
+int json_stream_feed(json_stream_t *s, const char *data, int len)
+{
+    const char *p = data;
+    const char *end = data + len;
+    const char *run;
+    unsigned int cp;
+    int digit;
+    char c;
+
+    if (s->error)
+        return -1;
+
+    while (p < end) {
+        switch (s->lex) {
+        case LEX_NONE:
+            c = *p;
+            if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+                p++;
+                break;
+            }
+            if (token_start(s, c) < 0)
+                goto error;
+            p++;
+            break;
+
+        case LEX_STRING:
+            /* Plain characters, at once */
+            run = p;
+            while (p < end && *p != '"' && *p != '\\')
+                p++;
+            if (s->lex_emit && p > run)
+                strbuf_append_mem(&s->token, run, p - run);
+            if (p == end)
+                break;
+            if (*p++ == '"')
+                string_end(s);
+            else
+                s->lex = LEX_ESCAPE;
+            break;
+
+        case LEX_ESCAPE:
+            c = *p;
+            switch (c) {
+            case '"':  case '\\': case '/': break;
+            case 'b':  c = '\b'; break;
+            case 'f':  c = '\f'; break;
+            case 'n':  c = '\n'; break;
+            case 'r':  c = '\r'; break;
+            case 't':  c = '\t'; break;
+            case 'u':
+                s->lex = LEX_UNICODE;
+                s->unicode = 0;
+                s->unicode_digits = 0;
+                p++;
+                continue;
+            default:
+                set_error(s, "invalid escape code");
+                goto error;
+            }
+            if (s->lex_emit)
+                strbuf_append_char(&s->token, c);
+            s->lex = LEX_STRING;
+            p++;
+            break;
+
+        case LEX_UNICODE:
+            digit = hex_value(*p);
+            if (digit < 0) {
+                set_error(s, "invalid unicode escape code");
+                goto error;
+            }
+            s->unicode = (s->unicode << 4) | digit;
+            p++;
+            if (++s->unicode_digits < 4)
+                break;
+
+            cp = s->unicode;
+            s->lex = LEX_STRING;
+            if (s->surrogate) {
+                /* Low surrogate of a pair */
+                if (cp < 0xDC00 || cp > 0xDFFF) {
+                    set_error(s, "invalid unicode escape code");
+                    goto error;
+                }
+                cp = 0x10000 + ((s->surrogate - 0xD800) << 10) + (cp - 0xDC00);
+                s->surrogate = 0;
+            } else if (cp >= 0xD800 && cp <= 0xDBFF) {
+                /* High surrogate, the low one must follow */
+                s->surrogate = cp;
+                s->lex = LEX_SURROGATE;
+                break;
+            } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                set_error(s, "invalid unicode escape code");
+                goto error;
+            }
+            if (s->lex_emit)
+                append_utf8(&s->token, cp);
+            break;
+
+        case LEX_SURROGATE:
+        case LEX_SURROGATE_U:
+            if (*p != (s->lex == LEX_SURROGATE ? '\\' : 'u')) {
+                set_error(s, "invalid unicode escape code");
+                goto error;
+            }
+            p++;
+            if (s->lex == LEX_SURROGATE) {
+                s->lex = LEX_SURROGATE_U;
+            } else {
+                s->lex = LEX_UNICODE;
+                s->unicode = 0;
+                s->unicode_digits = 0;
+            }
+            break;
+
+        case LEX_NUMBER:
+            run = p;
+            while (p < end && is_number_char(*p))
+                p++;
+            strbuf_append_mem(&s->token, run, p - run);
+            if (p < end && number_end(s) < 0)
+                goto error;
+            break;
+
+        case LEX_LITERAL:
+            if (*p != s->literal[s->literal_pos]) {
+                set_error(s, "invalid token");
+                goto error;
+            }
+            p++;
+            if (!s->literal[++s->literal_pos])
+                literal_end(s);
+            break;
+        }
+    }
+
+    s->offset += len;
+
+    return 0;
+
+error:
+    s->offset += p - data;
+
+    return -1;
+}
+
+int json_stream_finish(json_stream_t *s)
+{
+    if (s->error)
+        return -1;
+
+    if (s->lex == LEX_NUMBER && number_end(s) < 0)
+        return -1;
+
+    if (s->lex != LEX_NONE || !s->done)
+        return set_error(s, "unexpected end of document");
+
+    return 0;
+}
+
+const char *json_stream_error(json_stream_t *s, long *offset)
+{
+    if (offset)
+        *offset = s->offset;
+
+    return s->error;
+}
+
+int json_stream_memory(json_stream_t *s)
+{
+    int size;
+
+    size = s->frames * sizeof(json_stream_frame_t) + s->token.size + s->path.size;
+    if (s->selector)
+        size += (strlen(s->selector) + 1) * (1 + sizeof(char *));
+
+    return size;
+}
+
+void json_stream_free(json_stream_t *s)
+{
+    free(s->frame);
+    free(s->selector);
+    free(s->component);
+    s->frame = NULL;
+    s->selector = NULL;
+    s->component = NULL;
+
+    strbuf_free(&s->token);
+    strbuf_free(&s->path);
+}
+
+/* vi:ai et sw=4 ts=4:
+ */
@@ -0,0 +1,134 @@
+/* json_stream - Incremental JSON parser
+ *
+ * The document is fed in chunks of any size, and the parser calls a
+ * handler for each value as soon as it is complete (SAX style). Nothing
+ * but the current token and the path to the current value is kept in
+ * memory, so the document doesn't need to be held at once.
+ *
+ * A selector restricts the events to the subtrees at a path. It is a list
+ * of components separated by '.', each one an object key, an array
+ * position (from 1), or '*' for any key or position:
+ *
+ *   "data.items.*.temp"   temp of every element of data.items
+ *   ""                    the whole document
+ *
+ * Subtrees out of the selector are parsed but not decoded: their strings
+ * are not copied, and no event is emitted for them.
+ */
+
+#ifndef JSON_STREAM_H
+#define JSON_STREAM_H
+
+#include "strbuf.h"
+
+typedef enum {
+    JSON_EV_NULL,
+    JSON_EV_BOOLEAN,
+    JSON_EV_INTEGER,
+    JSON_EV_NUMBER,
+    JSON_EV_STRING,
+    JSON_EV_KEY,
+    JSON_EV_OBJ_BEGIN,
+    JSON_EV_OBJ_END,
+    JSON_EV_ARR_BEGIN,
+    JSON_EV_ARR_END
+} json_stream_event_t;
+
+typedef struct {
+    const char *string;     /* JSON_EV_STRING, JSON_EV_KEY */
+    int string_len;
+    double number;          /* JSON_EV_NUMBER */
+    long long integer;      /* JSON_EV_INTEGER */
+    int boolean;            /* JSON_EV_BOOLEAN */
+
+    int depth;              /* Depth of the value, 0 for the document */
+    int index;              /* Position in the parent array (from 1), or 0 */
+    int root;               /* The value is a subtree selected by the selector */
+    const char *key;        /* Member key of a selected subtree, or NULL */
+    int key_len;
+} json_stream_value_t;
+
+typedef void (*json_stream_handler_t)(void *arg, json_stream_event_t event,
+                                      const json_stream_value_t *value);
+
+typedef struct {
+    char type;              /* '{' or '[' */
+    char state;             /* What is expected next */
+    char match;             /* The path to this container matches the selector */
+    int index;              /* Number of elements, for arrays */
+    int key;                /* Offset of the current member key in the path buffer */
+    int key_len;            /* Length of the current member key, -1 if not kept */
+} json_stream_frame_t;
+
+typedef struct {
+    json_stream_handler_t handler;
+    void *arg;
+
+    /* Limits */
+    int max_depth;
+    long long int_min;
+    long long int_max;
+
+    /* Selector components, NULL if all the events are emitted */
+    char *selector;
+    char **component;
+    int components;
+
+    /* Containers from the document to the current value */
+    json_stream_frame_t *frame;
+    int frames;
+    int depth;
+    int done;               /* The document value is complete */
+
+    /* Depth of the selected subtree being emitted, or of the subtree
+     * being skipped, -1 if none */
+    int capture;
+    int skip;
+
+    /* Token in progress */
+    int lex;
+    int lex_emit;           /* The token is decoded */
+    int lex_key;            /* The string is a member key */
+    int lex_root;           /* The value is a selected subtree */
+    const char *literal;    /* Expected text for true / false / null */
+    int literal_pos;
+    unsigned int unicode;   /* \uXXXX in progress */
+    unsigned int surrogate;
+    int unicode_digits;
+    strbuf_t token;
+    strbuf_t path;          /* Member keys kept for the selector */
+
+    /* Errors */
+    const char *error;
+    long offset;            /* Bytes fed so far */
+} json_stream_t;
+
+/* Initialise a parser. The integers in [int_min, int_max] without fraction
+ * nor exponent are emitted as JSON_EV_INTEGER, the rest as
+ * JSON_EV_NUMBER. */
+extern void json_stream_init(json_stream_t *s, int max_depth, long long int_min,
+                             long long int_max, json_stream_handler_t handler,
+                             void *arg);
+
+/* Set the selector, before the first chunk is fed. Returns -1 if the
+ * selector is not valid. */
+extern int json_stream_select(json_stream_t *s, const char *selector);
+
+/* Parse a chunk. Returns -1 on a syntax error, see json_stream_error(). */
+extern int json_stream_feed(json_stream_t *s, const char *data, int len);
+
+/* End of the document. Returns -1 if the document is not complete. */
+extern int json_stream_finish(json_stream_t *s);
+
+/* Error message, and offset of the character in the document */
+extern const char *json_stream_error(json_stream_t *s, long *offset);
+
+/* Bytes allocated by the parser */
+extern int json_stream_memory(json_stream_t *s);
+
+extern void json_stream_free(json_stream_t *s);
+
+#endif
+
+/* vi:ai et sw=4 ts=4:
+ */
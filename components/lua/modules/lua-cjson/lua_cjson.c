@@ -47,6 +47,7 @@
 
 #include "strbuf.h"
 #include "fpconv.h"
+#include "json_stream.h"
 
 #define CONFIG_LUA_RTOS_LUA_USE_CJSON_SAFE CONFIG_LUA_RTOS_LUA_USE_CJSON
 
@@ -155,7 +156,7 @@ typedef struct {
     union {
         const char *string;
         double number;
-        int integer;
+        lua_Integer integer;
         int boolean;
     } value;
     int string_len;
@@ -307,12 +308,13 @@ static int json_cfg_decode_max_depth(lua_State *l)
     return json_integer_option(l, 1, &cfg->decode_max_depth, 1, INT_MAX);
 }
 
-/* Configures number precision when converting doubles to text */
+/* Configures number precision when converting doubles to text. 0 is the
+ * shortest representation that decodes to the same double. */
 static int json_cfg_encode_number_precision(lua_State *l)
 {
     json_config_t *cfg = json_arg_init(l, 1);
 
-    return json_integer_option(l, 1, &cfg->encode_number_precision, 1, 14);
+    return json_integer_option(l, 1, &cfg->encode_number_precision, 0, 14);
 }
 
 /* Configures JSON encoding buffer persistence */
@@ -602,19 +604,11 @@ static void json_append_number(lua_State *l, json_config_t *cfg,
                                strbuf_t *json, int lindex)
 {
     if (lua_isinteger(l, lindex)) {
-        char buf[FPCONV_G_FMT_BUFSIZE];
-        int num = lua_tointeger(l, lindex);
+        lua_Integer num = lua_tointeger(l, lindex);
         int len;
-        char *c, *cc;
-
-        sprintf(buf,"%d",num);
-        len = strlen(buf);
-        c = strbuf_empty_ptr(json);
-        cc = buf;
-        while (*cc) {
-            *c++ = *cc;
-            cc++;
-        }
+
+        strbuf_ensure_empty_length(json, FPCONV_G_FMT_BUFSIZE);
+        len = fpconv_i_fmt(strbuf_empty_ptr(json), num);
         strbuf_extend_length(json, len);
     } else {
         double num = lua_tonumber(l, lindex);
@@ -1034,36 +1028,24 @@ static int json_is_invalid_number(json_parse_t *json)
 static void json_next_number_token(json_parse_t *json, json_token_t *token)
 {
     char *endptr;
+    long long integer;
 
-    char buff[FPCONV_G_FMT_BUFSIZE];
-    char *cc,*cb;
-    int is_int = 1;
-    cc = (char *)json->ptr;
-    cb = buff;
-    while (*cc && (*cc != ' ') && (*cc != ',') && (*cc != '}')) {
-        if ((*cc >= '0') && (*cc <= '9')) {
-            *cb++ = *cc;
-        } else {
-            is_int = 0;
-            break;
-        }
-        cc++;
-    }
-    *cb = 0x00;
-
-    if (is_int) {
+    /* Numbers without fraction nor exponent that fit in a Lua integer are
+     * decoded as integers, except -0 that is decoded as the float -0.0 */
+    if (fpconv_strtoi(json->ptr, &endptr, LUA_MININTEGER, LUA_MAXINTEGER, &integer)) {
         token->type = T_INTEGER;
-        token->value.integer = atoi(buff);
-        json->ptr = cc;
-    } else {
-        token->type = T_NUMBER;
-        token->value.number = fpconv_strtod(json->ptr, &endptr);
-        if (json->ptr == endptr)
-            json_set_token_error(token, json, "invalid number");
-        else
-            json->ptr = endptr;     /* Skip the processed number */
+        token->value.integer = (lua_Integer)integer;
+        json->ptr = endptr;
+        return;
     }
 
+    token->type = T_NUMBER;
+    token->value.number = fpconv_strtod(json->ptr, &endptr);
+    if (json->ptr == endptr)
+        json_set_token_error(token, json, "invalid number");
+    else
+        json->ptr = endptr;     /* Skip the processed number */
+
     return;
 }
 
@@ -1353,6 +1335,290 @@ static int json_decode(lua_State *l)
     return 1;
 }
 
+/* ===== STREAMING DECODER ===== */
+
+#define JSON_DECODER_MT         "cjson.decoder"
+#define JSON_STREAM_CHUNK_SIZE  512
+
+typedef struct {
+    json_stream_t stream;
+    lua_State *l;
+    int handler;            /* Stack index of the handler while feeding */
+    int selector;           /* Selected subtrees are decoded, instead of events */
+    int pending;            /* Keys and tables of the subtree being decoded */
+    int busy;               /* Feeding, or a previous feed raised an error */
+} json_decoder_t;
+
+static const char *const json_event_name[] = {
+    "value",        /* JSON_EV_NULL */
+    "value",        /* JSON_EV_BOOLEAN */
+    "value",        /* JSON_EV_INTEGER */
+    "value",        /* JSON_EV_NUMBER */
+    "value",        /* JSON_EV_STRING */
+    "key",          /* JSON_EV_KEY */
+    "object",       /* JSON_EV_OBJ_BEGIN */
+    "end_object",   /* JSON_EV_OBJ_END */
+    "array",        /* JSON_EV_ARR_BEGIN */
+    "end_array"     /* JSON_EV_ARR_END */
+};
+
+/* Push the Lua value of a scalar, or nil */
+static void json_push_event_value(lua_State *l, json_stream_event_t event,
+                                  const json_stream_value_t *value)
+{
+    switch (event) {
+    case JSON_EV_NULL:
+        lua_pushlightuserdata(l, NULL);
+        break;
+    case JSON_EV_BOOLEAN:
+        lua_pushboolean(l, value->boolean);
+        break;
+    case JSON_EV_INTEGER:
+        lua_pushinteger(l, (lua_Integer)value->integer);
+        break;
+    case JSON_EV_NUMBER:
+        lua_pushnumber(l, value->number);
+        break;
+    case JSON_EV_STRING:
+    case JSON_EV_KEY:
+        lua_pushlstring(l, value->string, value->string_len);
+        break;
+    default:
+        lua_pushnil(l);
+    }
+}
+
+/* Without selector every event is passed to handler(event, value). With a
+ * selector, the selected subtrees are built on the stack and passed to
+ * handler(value, key) once complete. */
+static void json_decoder_event(void *arg, json_stream_event_t event,
+                               const json_stream_value_t *value)
+{
+    json_decoder_t *d = (json_decoder_t *)arg;
+    lua_State *l = d->l;
+
+    luaL_checkstack(l, 4, "too many nested data structures");
+
+    if (!d->selector) {
+        lua_pushvalue(l, d->handler);
+        lua_pushstring(l, json_event_name[event]);
+        json_push_event_value(l, event, value);
+        lua_call(l, 2, 0);
+        return;
+    }
+
+    switch (event) {
+    case JSON_EV_KEY:
+        /* Stays on the stack until the member value is complete */
+        lua_pushlstring(l, value->string, value->string_len);
+        return;
+    case JSON_EV_OBJ_BEGIN:
+    case JSON_EV_ARR_BEGIN:
+        lua_newtable(l);
+        return;
+    case JSON_EV_OBJ_END:
+    case JSON_EV_ARR_END:
+        /* The table is on the top */
+        break;
+    default:
+        json_push_event_value(l, event, value);
+    }
+
+    if (value->root) {
+        lua_pushvalue(l, d->handler);
+        lua_insert(l, -2);
+        if (value->key)
+            lua_pushlstring(l, value->key, value->key_len);
+        else if (value->index)
+            lua_pushinteger(l, value->index);
+        else
+            lua_pushnil(l);
+        lua_call(l, 2, 0);
+    } else if (value->index) {
+        lua_rawseti(l, -2, value->index);
+    } else {
+        lua_rawset(l, -3);
+    }
+}
+
+/* Push a new decoder, for the handler and selector at these indexes. The
+ * user value of the decoder is a table with the handler at 1, followed by
+ * the incomplete subtree between chunks. */
+static json_decoder_t *json_decoder_create(lua_State *l, int handler, int selector)
+{
+    json_config_t *cfg = json_fetch_config(l);
+    const char *path = luaL_optstring(l, selector, NULL);
+    json_decoder_t *d;
+
+    luaL_checktype(l, handler, LUA_TFUNCTION);
+
+    d = (json_decoder_t *)lua_newuserdata(l, sizeof(json_decoder_t));
+    json_stream_init(&d->stream, cfg->decode_max_depth, LUA_MININTEGER,
+                     LUA_MAXINTEGER, json_decoder_event, d);
+    d->selector = 0;
+    d->pending = 0;
+    d->busy = 0;
+
+    luaL_getmetatable(l, JSON_DECODER_MT);
+    lua_setmetatable(l, -2);
+
+    if (path) {
+        if (json_stream_select(&d->stream, path) < 0)
+            luaL_argerror(l, selector, "invalid selector");
+        d->selector = 1;
+    }
+
+    lua_createtable(l, 1, 0);
+    lua_pushvalue(l, handler);
+    lua_rawseti(l, -2, 1);
+    lua_setuservalue(l, -2);
+
+    return d;
+}
+
+/* Feed a chunk to the decoder at index, or finish the document if chunk is
+ * NULL */
+static void json_decoder_run(lua_State *l, json_decoder_t *d, int index,
+                             const char *chunk, size_t len)
+{
+    int top = lua_gettop(l);
+    int values;
+    int ret;
+    int i;
+
+    if (d->busy)
+        luaL_error(l, "decoder can't be used after an error");
+
+    lua_getuservalue(l, index);
+    values = lua_gettop(l);
+
+    /* Restore the incomplete subtree over the handler */
+    luaL_checkstack(l, d->pending + 1, "too many nested data structures");
+    lua_rawgeti(l, values, 1);
+    d->handler = lua_gettop(l);
+    for (i = 2; i <= d->pending + 1; i++) {
+        lua_rawgeti(l, values, i);
+        lua_pushnil(l);
+        lua_rawseti(l, values, i);
+    }
+
+    d->l = l;
+    d->busy = 1;
+
+    if (chunk)
+        ret = json_stream_feed(&d->stream, chunk, len);
+    else
+        ret = json_stream_finish(&d->stream);
+
+    if (ret < 0) {
+        const char *error;
+        long offset;
+
+        error = json_stream_error(&d->stream, &offset);
+        luaL_error(l, "Invalid JSON: %s at character %d", error, (int)offset + 1);
+    }
+
+    d->busy = 0;
+
+    /* Save the incomplete subtree */
+    d->pending = lua_gettop(l) - d->handler;
+    for (i = d->pending + 1; i > 1; i--)
+        lua_rawseti(l, values, i);
+
+    lua_settop(l, top);
+}
+
+/* json.decoder(handler [, selector]) */
+static int json_decoder_new(lua_State *l)
+{
+    json_decoder_create(l, 1, 2);
+
+    return 1;
+}
+
+/* decoder:feed(chunk) */
+static int json_decoder_feed(lua_State *l)
+{
+    json_decoder_t *d = (json_decoder_t *)luaL_checkudata(l, 1, JSON_DECODER_MT);
+    size_t len;
+    const char *chunk = luaL_checklstring(l, 2, &len);
+
+    json_decoder_run(l, d, 1, chunk, len);
+
+    return 0;
+}
+
+/* decoder:finish() */
+static int json_decoder_finish(lua_State *l)
+{
+    json_decoder_t *d = (json_decoder_t *)luaL_checkudata(l, 1, JSON_DECODER_MT);
+
+    json_decoder_run(l, d, 1, NULL, 0);
+
+    return 0;
+}
+
+static int json_decoder_gc(lua_State *l)
+{
+    json_decoder_t *d = (json_decoder_t *)luaL_checkudata(l, 1, JSON_DECODER_MT);
+
+    json_stream_free(&d->stream);
+
+    return 0;
+}
+
+/* json.decode_stream(source, handler [, selector])
+ *
+ * source is a file, or a function that returns the next chunk, or nil at
+ * the end. */
+static int json_decode_stream(lua_State *l)
+{
+    json_decoder_t *d;
+    const char *chunk;
+    size_t len;
+    int is_function;
+    int index;
+
+    is_function = lua_isfunction(l, 1);
+    if (!is_function && lua_isnoneornil(l, 1))
+        luaL_argerror(l, 1, "expected a file or a function");
+
+    lua_settop(l, 3);
+    d = json_decoder_create(l, 2, 3);
+    index = lua_gettop(l);
+
+    for (;;) {
+        if (is_function) {
+            lua_pushvalue(l, 1);
+            lua_call(l, 0, 1);
+        } else {
+            lua_getfield(l, 1, "read");
+            lua_pushvalue(l, 1);
+            lua_pushinteger(l, JSON_STREAM_CHUNK_SIZE);
+            lua_call(l, 2, 1);
+        }
+
+        chunk = lua_tolstring(l, -1, &len);
+        if (!chunk || !len)
+            break;
+
+        json_decoder_run(l, d, index, chunk, len);
+        lua_pop(l, 1);
+    }
+
+    lua_pop(l, 1);
+    json_decoder_run(l, d, index, NULL, 0);
+
+    return 0;
+}
+
+static const luaL_Reg json_decoder_methods[] = {
+    { "feed", json_decoder_feed },
+    { "finish", json_decoder_finish },
+    { "__gc", json_decoder_gc },
+    { NULL, NULL }
+};
+
 /* ===== INITIALISATION ===== */
 
 #if !defined(LUA_VERSION_NUM) || LUA_VERSION_NUM < 502
@@ -1406,6 +1672,8 @@ static int json_protect_conversion(lua_State *l)
 static const luaL_Reg reg[] = {
     { "encode", json_encode },
     { "decode", json_decode },
+    { "decoder", json_decoder_new },
+    { "decode_stream", json_decode_stream },
     { "encode_sparse_array", json_cfg_encode_sparse_array },
     { "encode_max_depth", json_cfg_encode_max_depth },
     { "decode_max_depth", json_cfg_decode_max_depth },
@@ -1423,6 +1691,14 @@ static int lua_cjson_new(lua_State *l)
     /* Initialise number conversions */
     fpconv_init();
 
+    /* Stream decoder methods */
+    if (luaL_newmetatable(l, JSON_DECODER_MT)) {
+        lua_pushvalue(l, -1);
+        lua_setfield(l, -2, "__index");
+        luaL_setfuncs(l, json_decoder_methods, 0);
+    }
+    lua_pop(l, 1);
+
     /* cjson module table */
     lua_newtable(l);
 
@@ -22,6 +22,9 @@
  * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  */
 
+#ifndef STRBUF_H
+#define STRBUF_H
+
 #include <stdlib.h>
 #include <stdarg.h>
 
@@ -150,5 +153,7 @@ static inline char *strbuf_string(strbuf_t *s, int *len)
     return s->buf;
 }
 
+#endif
+
 /* vi:ai et sw=4 ts=4:
  */
@@ -0,0 +1,320 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, Lua CJSON number conversion test cases
+ *
+ */
+
+#include "unity.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <sys/time.h>
+
+#include "fpconv.h"
+
+#define RANDOM_NUMBERS 20000
+#define BENCH_NUMBERS  10000
+
+static uint64_t seed;
+
+static uint64_t xorshift(void) {
+	seed ^= seed << 13;
+	seed ^= seed >> 7;
+	seed ^= seed << 17;
+
+	return seed;
+}
+
+// Any finite double, from its bit pattern
+static double random_double(void) {
+	uint64_t bits;
+	double d;
+
+	do {
+		bits = xorshift();
+		memcpy(&d, &bits, sizeof(d));
+	} while (isnan(d) || isinf(d));
+
+	return d;
+}
+
+// Values as sent by sensors: a few digits, with a fraction
+static double random_reading(void) {
+	uint64_t r = xorshift();
+
+	return (double)((int64_t)(r % 2000000) - 1000000) / (double)(1 + ((r >> 32) % 1000));
+}
+
+static int same_double(double a, double b) {
+	return memcmp(&a, &b, sizeof(double)) == 0;
+}
+
+static void check_fmt(double d, int precision) {
+	char expected[FPCONV_G_FMT_BUFSIZE];
+	char buf[FPCONV_G_FMT_BUFSIZE];
+	int len;
+
+	snprintf(expected, sizeof(expected), "%.*g", precision, d);
+	len = fpconv_g_fmt(buf, d, precision);
+
+	if (strcmp(expected, buf) != 0) {
+		printf("%.17g, precision %d: expected %s, got %s\n", d, precision, expected, buf);
+	}
+
+	TEST_ASSERT_EQUAL_STRING(expected, buf);
+	TEST_ASSERT_EQUAL(strlen(expected), len);
+}
+
+static void check_shortest(double d) {
+	char buf[FPCONV_G_FMT_BUFSIZE];
+	char shorter[40];
+	char *first = NULL, *last = NULL, *dot;
+	char *end;
+	int digits = 0;
+	char *c;
+
+	fpconv_g_fmt(buf, d, 0);
+
+	// Round trips
+	TEST_ASSERT_TRUE(same_double(d, strtod(buf, &end)));
+	TEST_ASSERT_EQUAL(0, *end);
+
+	// And there's no shorter representation that round trips
+	for (c = buf; *c && (*c | 0x20) != 'e'; c++) {
+		if ('1' <= *c && *c <= '9') {
+			if (!first) first = c;
+			last = c;
+		}
+	}
+
+	if (first) {
+		digits = (int)(last - first) + 1;
+		dot = strchr(buf, '.');
+		if (dot && (first < dot) && (dot < last)) digits--;
+	}
+
+	if (digits > 1) {
+		TEST_ASSERT_TRUE(snprintf(shorter, sizeof(shorter), "%.*g", digits - 1, d) < sizeof(shorter));
+		TEST_ASSERT_FALSE(same_double(d, strtod(shorter, NULL)));
+	}
+}
+
+static void check_strtod(const char *str) {
+	char *expected_end, *end;
+	double expected, value;
+
+	expected = strtod(str, &expected_end);
+	value = fpconv_strtod(str, &end);
+
+	if (!same_double(expected, value) || (expected_end != end)) {
+		printf("%s: expected %.17g (%d), got %.17g (%d)\n", str, expected,
+			   (int)(expected_end - str), value, (int)(end - str));
+	}
+
+	TEST_ASSERT_TRUE(same_double(expected, value));
+	TEST_ASSERT_TRUE(expected_end == end);
+}
+
+TEST_CASE("fpconv format as printf", "[lua_cjson]") {
+	static const double values[] = {
+		0.0, -0.0, 1.0, -1.0, 0.1, 0.5, 23.5, 100, 1e14, 99999999999999.0, 123456789012345.0,
+		1e15, 1e21, 1e-4, 1e-5, 0.000123456, 1.0 / 3.0, 2.0 / 3.0, 0.125, 0.375, 2.5, 1e23,
+		9007199254740993.0, 5e-324, 2.2250738585072014e-308, 1.7976931348623157e308,
+	};
+	int precision;
+	int i;
+
+	for (i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+		for (precision = 1; precision <= 14; precision++) {
+			check_fmt(values[i], precision);
+		}
+	}
+
+	seed = 0x9E3779B97F4A7C15ULL;
+	for (i = 0; i < RANDOM_NUMBERS; i++) {
+		check_fmt(random_double(), 14);
+		check_fmt(random_reading(), 14);
+		check_fmt(random_reading(), 1 + (i % 14));
+	}
+}
+
+TEST_CASE("fpconv shortest round trip", "[lua_cjson]") {
+	char buf[FPCONV_G_FMT_BUFSIZE];
+	int i;
+
+	fpconv_g_fmt(buf, 0.1, 0);
+	TEST_ASSERT_EQUAL_STRING("0.1", buf);
+	fpconv_g_fmt(buf, 0.1 + 0.2, 0);
+	TEST_ASSERT_EQUAL_STRING("0.30000000000000004", buf);
+	fpconv_g_fmt(buf, 1e21, 0);
+	TEST_ASSERT_EQUAL_STRING("1e+21", buf);
+	fpconv_g_fmt(buf, -2.2250738585072014e-308, 0);
+	TEST_ASSERT_EQUAL_STRING("-2.2250738585072014e-308", buf);
+	fpconv_g_fmt(buf, 5e-324, 0);
+	TEST_ASSERT_EQUAL_STRING("5e-324", buf);
+
+	seed = 0x2545F4914F6CDD1DULL;
+	for (i = 0; i < RANDOM_NUMBERS; i++) {
+		check_shortest(random_double());
+		check_shortest(random_reading());
+	}
+}
+
+TEST_CASE("fpconv parse as strtod", "[lua_cjson]") {
+	static const char *values[] = {
+		"0", "-0", "0.0", "1", "-1", "0.1", "23.5", "1e23", "1E+23", "1e-23", "9007199254740993",
+		"9007199254740992.5", "0.30000000000000004", "2.2250738585072014e-308", "4.9e-324",
+		"1.7976931348623157e308", "1.8e308", "1e-400", "123456789012345678901234567890",
+		"0.000000000000000000000000000001", "1e", "1e+", "1.", ".5", "-.5", "5.e3", "0x10",
+		"-", "-x", "inf", "-Infinity", "nan", "12,", "12]", "7.5}", "1e99999", "1e-99999",
+		"8.98846567431158e307", "4.35679e-10", "1448997445238699", "9999999999999999999",
+		"18446744073709551616", "0.1000000000000000055511151231257827",
+	};
+	char buf[40];
+	double d;
+	int i;
+
+	for (i = 0; i < sizeof(values) / sizeof(values[0]); i++) {
+		check_strtod(values[i]);
+	}
+
+	seed = 0xD1B54A32D192ED03ULL;
+	for (i = 0; i < RANDOM_NUMBERS; i++) {
+		d = random_double();
+		snprintf(buf, sizeof(buf), "%.17g", d);
+		check_strtod(buf);
+		snprintf(buf, sizeof(buf), "%.14g", d);
+		check_strtod(buf);
+
+		d = random_reading();
+		snprintf(buf, sizeof(buf), "%.*g", 1 + (i % 17), d);
+		check_strtod(buf);
+
+		// Random digits and exponents, around the table limits
+		snprintf(buf, sizeof(buf), "%llu.%llue%d", (unsigned long long)(xorshift() % 100000000000ULL),
+				 (unsigned long long)(xorshift() % 100000000ULL), (int)(xorshift() % 160) - 80);
+		check_strtod(buf);
+	}
+}
+
+TEST_CASE("fpconv integers", "[lua_cjson]") {
+	char buf[FPCONV_G_FMT_BUFSIZE];
+	char *end;
+	long long value;
+
+	TEST_ASSERT_EQUAL(1, fpconv_i_fmt(buf, 0));
+	TEST_ASSERT_EQUAL_STRING("0", buf);
+	TEST_ASSERT_EQUAL(20, fpconv_i_fmt(buf, LLONG_MIN));
+	TEST_ASSERT_EQUAL_STRING("-9223372036854775808", buf);
+	fpconv_i_fmt(buf, INT_MAX);
+	TEST_ASSERT_EQUAL_STRING("2147483647", buf);
+
+	TEST_ASSERT_EQUAL(1, fpconv_strtoi("-2147483648,", &end, INT_MIN, INT_MAX, &value));
+	TEST_ASSERT_EQUAL(INT_MIN, value);
+	TEST_ASSERT_EQUAL(',', *end);
+	TEST_ASSERT_EQUAL(1, fpconv_strtoi("42]", &end, INT_MIN, INT_MAX, &value));
+	TEST_ASSERT_EQUAL(42, value);
+	TEST_ASSERT_EQUAL(1, fpconv_strtoi("9223372036854775807", &end, LLONG_MIN, LLONG_MAX, &value));
+	TEST_ASSERT_EQUAL(LLONG_MAX, value);
+
+	// Out of range, or not an integer
+	TEST_ASSERT_EQUAL(0, fpconv_strtoi("2147483648", &end, INT_MIN, INT_MAX, &value));
+	TEST_ASSERT_EQUAL(0, fpconv_strtoi("-2147483649", &end, INT_MIN, INT_MAX, &value));
+	TEST_ASSERT_EQUAL(0, fpconv_strtoi("9223372036854775808", &end, LLONG_MIN, LLONG_MAX, &value));
+	TEST_ASSERT_EQUAL(0, fpconv_strtoi("1.5", &end, INT_MIN, INT_MAX, &value));
+	TEST_ASSERT_EQUAL(0, fpconv_strtoi("1e3", &end, INT_MIN, INT_MAX, &value));
+	TEST_ASSERT_EQUAL(0, fpconv_strtoi("-", &end, INT_MIN, INT_MAX, &value));
+
+	// -0 is not an integer, it's parsed as the float -0.0, as strtod does
+	TEST_ASSERT_EQUAL(0, fpconv_strtoi("-0", &end, INT_MIN, INT_MAX, &value));
+	TEST_ASSERT_EQUAL(0, fpconv_strtoi("-0,", &end, INT_MIN, INT_MAX, &value));
+	TEST_ASSERT_TRUE(signbit(fpconv_strtod("-0", &end)));
+	TEST_ASSERT_EQUAL(0, *end);
+	TEST_ASSERT_EQUAL(1, fpconv_strtoi("0", &end, INT_MIN, INT_MAX, &value));
+	TEST_ASSERT_EQUAL(0, value);
+}
+
+TEST_CASE("fpconv benchmark", "[lua_cjson]") {
+	static double values[BENCH_NUMBERS];
+	static char strings[BENCH_NUMBERS][FPCONV_G_FMT_BUFSIZE];
+	struct timeval start, end;
+	char buf[FPCONV_G_FMT_BUFSIZE];
+	char *endptr;
+	double sum[2] = {0, 0};
+	long usecs[4];
+	int i;
+
+	seed = 0x94D049BB133111EBULL;
+	for (i = 0; i < BENCH_NUMBERS; i++) {
+		values[i] = random_reading();
+		snprintf(strings[i], sizeof(strings[i]), "%.14g", values[i]);
+	}
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < BENCH_NUMBERS; i++) snprintf(buf, sizeof(buf), "%.14g", values[i]);
+	gettimeofday(&end, NULL);
+	usecs[0] = (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_usec - start.tv_usec);
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < BENCH_NUMBERS; i++) fpconv_g_fmt(buf, values[i], 14);
+	gettimeofday(&end, NULL);
+	usecs[1] = (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_usec - start.tv_usec);
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < BENCH_NUMBERS; i++) sum[0] += strtod(strings[i], &endptr);
+	gettimeofday(&end, NULL);
+	usecs[2] = (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_usec - start.tv_usec);
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < BENCH_NUMBERS; i++) sum[1] += fpconv_strtod(strings[i], &endptr);
+	gettimeofday(&end, NULL);
+	usecs[3] = (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_usec - start.tv_usec);
+
+	TEST_ASSERT_TRUE(sum[0] == sum[1]);
+
+	printf("%d numbers formatted in %ld usecs (snprintf %ld usecs)\n", BENCH_NUMBERS, usecs[1], usecs[0]);
+	printf("%d numbers parsed in %ld usecs (strtod %ld usecs)\n", BENCH_NUMBERS, usecs[3], usecs[2]);
+}
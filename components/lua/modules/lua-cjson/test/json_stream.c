@@ -0,0 +1,365 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, Lua CJSON stream decoder test cases
+ *
+ */
+
+#include "unity.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/time.h>
+
+#include <lua.h>
+#include <lauxlib.h>
+#include <lualib.h>
+
+#include "json_stream.h"
+
+extern int luaopen_cjson(lua_State *l);
+
+#define BENCH_ITEMS 2000
+
+// Events, as text
+static char events[4096];
+
+static void record(void *arg, json_stream_event_t event, const json_stream_value_t *v) {
+	char *e = events + strlen(events);
+	int size = sizeof(events) - (e - events);
+
+	if (v->root) {
+		if (v->key) {
+			e += snprintf(e, size, "@%.*s ", v->key_len, v->key);
+		} else {
+			e += snprintf(e, size, "@%d ", v->index);
+		}
+		size = sizeof(events) - (e - events);
+	}
+
+	switch (event) {
+		case JSON_EV_NULL:      snprintf(e, size, "null "); break;
+		case JSON_EV_BOOLEAN:   snprintf(e, size, "%s ", v->boolean ? "true" : "false"); break;
+		case JSON_EV_INTEGER:   snprintf(e, size, "i%lld ", v->integer); break;
+		case JSON_EV_NUMBER:    snprintf(e, size, "n%g ", v->number); break;
+		case JSON_EV_STRING:    snprintf(e, size, "s%.*s ", v->string_len, v->string); break;
+		case JSON_EV_KEY:       snprintf(e, size, "k%.*s ", v->string_len, v->string); break;
+		case JSON_EV_OBJ_BEGIN: snprintf(e, size, "{ "); break;
+		case JSON_EV_OBJ_END:   snprintf(e, size, "} "); break;
+		case JSON_EV_ARR_BEGIN: snprintf(e, size, "[ "); break;
+		case JSON_EV_ARR_END:   snprintf(e, size, "] "); break;
+	}
+}
+
+// Parse a document in chunks of a size, returns the error or NULL
+static const char *parse(const char *doc, const char *selector, int chunk) {
+	json_stream_t s;
+	const char *error = NULL;
+	int len = strlen(doc);
+	int i, n;
+
+	events[0] = 0;
+
+	json_stream_init(&s, 100, INT_MIN, INT_MAX, record, NULL);
+	if (selector) {
+		TEST_ASSERT_EQUAL(0, json_stream_select(&s, selector));
+	}
+
+	for (i = 0; i < len; i += chunk) {
+		n = (len - i < chunk) ? len - i : chunk;
+		if (json_stream_feed(&s, doc + i, n) < 0) break;
+	}
+
+	if (json_stream_finish(&s) < 0) {
+		error = json_stream_error(&s, NULL);
+	}
+
+	json_stream_free(&s);
+
+	return error;
+}
+
+static const char *doc =
+	"{\"name\": \"n\\u00e9\\ud83d\\ude00\\\"\", \"ok\": true, \"none\": null,\n"
+	" \"data\": {\"items\": [{\"temp\": 21.5, \"id\": 1}, {\"id\": 2, \"temp\": -3},\n"
+	"                      {\"temp\": [1, 2e3]}], \"count\": 3},\n"
+	" \"big\": 12345678901234567890, \"empty\": [], \"obj\": {}}";
+
+TEST_CASE("json stream events", "[lua_cjson]") {
+	static const char *expected =
+		"{ kname sné\xf0\x9f\x98\x80\" kok true knone null kdata { kitems [ { ktemp n21.5 kid i1 } "
+		"{ kid i2 ktemp i-3 } { ktemp [ i1 n2000 ] } ] kcount i3 } kbig n1.23457e+19 "
+		"kempty [ ] kobj { } } ";
+	int chunk;
+
+	// Whatever the chunk size, the events are the same
+	for (chunk = 1; chunk <= strlen(doc); chunk++) {
+		TEST_ASSERT_NULL(parse(doc, NULL, chunk));
+		if (strcmp(expected, events)) printf("chunk %d: %s\n", chunk, events);
+		TEST_ASSERT_EQUAL_STRING(expected, events);
+	}
+
+	TEST_ASSERT_NULL(parse("  -0.5e-2 ", NULL, 3));
+	TEST_ASSERT_EQUAL_STRING("n-0.005 ", events);
+	TEST_ASSERT_NULL(parse("42", NULL, 1));
+	TEST_ASSERT_EQUAL_STRING("i42 ", events);
+
+	// -0 is a float, like in json.decode
+	TEST_ASSERT_NULL(parse("[-0, 0, -0.0]", NULL, 1));
+	TEST_ASSERT_EQUAL_STRING("[ n-0 i0 n-0 ] ", events);
+}
+
+TEST_CASE("json stream selector", "[lua_cjson]") {
+	int chunk;
+
+	for (chunk = 1; chunk <= strlen(doc); chunk += 7) {
+		TEST_ASSERT_NULL(parse(doc, "data.items.*.temp", chunk));
+		TEST_ASSERT_EQUAL_STRING("@temp n21.5 @temp i-3 @temp [ i1 n2000 @temp ] ", events);
+	}
+
+	TEST_ASSERT_NULL(parse(doc, "data.items.2", 5));
+	TEST_ASSERT_EQUAL_STRING("@2 { kid i2 ktemp i-3 @2 } ", events);
+
+	TEST_ASSERT_NULL(parse(doc, "data.count", 5));
+	TEST_ASSERT_EQUAL_STRING("@count i3 ", events);
+
+	TEST_ASSERT_NULL(parse(doc, "*.items.3.temp.2", 5));
+	TEST_ASSERT_EQUAL_STRING("@2 n2000 ", events);
+
+	TEST_ASSERT_NULL(parse(doc, "missing", 5));
+	TEST_ASSERT_EQUAL_STRING("", events);
+
+	TEST_ASSERT_NULL(parse("[1, 2]", "", 5));
+	TEST_ASSERT_EQUAL_STRING("@0 [ i1 i2 @0 ] ", events);
+}
+
+TEST_CASE("json stream errors", "[lua_cjson]") {
+	json_stream_t s;
+	long offset;
+
+	TEST_ASSERT_NOT_NULL(parse("{\"a\" 1}", NULL, 2));
+	TEST_ASSERT_NOT_NULL(parse("[1, 2", NULL, 2));
+	TEST_ASSERT_NOT_NULL(parse("[1 2]", NULL, 2));
+	TEST_ASSERT_NOT_NULL(parse("[01]", NULL, 2));
+	TEST_ASSERT_NOT_NULL(parse("[1.]", NULL, 2));
+	TEST_ASSERT_NOT_NULL(parse("[tru]", NULL, 2));
+	TEST_ASSERT_NOT_NULL(parse("\"\\x\"", NULL, 2));
+	TEST_ASSERT_NOT_NULL(parse("\"\\ud83d\"", NULL, 2));
+	TEST_ASSERT_NOT_NULL(parse("{1: 2}", NULL, 2));
+	TEST_ASSERT_NOT_NULL(parse("1 2", NULL, 2));
+	TEST_ASSERT_NOT_NULL(parse("", NULL, 2));
+
+	// Offset of the error
+	json_stream_init(&s, 2, INT_MIN, INT_MAX, record, NULL);
+	TEST_ASSERT_EQUAL(0, json_stream_feed(&s, "[[", 2));
+	TEST_ASSERT_EQUAL(-1, json_stream_feed(&s, " [", 2));
+	TEST_ASSERT_EQUAL_STRING("found too many nested data structures", json_stream_error(&s, &offset));
+	TEST_ASSERT_EQUAL(3, offset);
+	json_stream_free(&s);
+
+	// Invalid selectors
+	json_stream_init(&s, 2, INT_MIN, INT_MAX, record, NULL);
+	TEST_ASSERT_EQUAL(-1, json_stream_select(&s, "a..b"));
+	TEST_ASSERT_EQUAL(-1, json_stream_select(&s, "a.b.c"));
+	json_stream_free(&s);
+}
+
+// An array of records, as returned by a REST API
+static char *bench_doc(int *len) {
+	char *big, *p;
+	int i;
+
+	big = (char *)malloc(BENCH_ITEMS * 128 + 64);
+	TEST_ASSERT_NOT_NULL(big);
+
+	p = big;
+	p += sprintf(p, "{\"result\": [");
+	for (i = 0; i < BENCH_ITEMS; i++) {
+		p += sprintf(p, "%s{\"id\": %d, \"name\": \"sensor %d\", \"temp\": %d.%d, \"tags\": [\"a\", \"b\"]}",
+					 i ? ", " : "", i, i, i % 40, i % 10);
+	}
+	p += sprintf(p, "]}");
+	*len = p - big;
+
+	return big;
+}
+
+static int matched;
+
+static void count(void *arg, json_stream_event_t event, const json_stream_value_t *v) {
+	if (v->root) matched++;
+}
+
+TEST_CASE("json stream memory and throughput", "[lua_cjson]") {
+	struct timeval start, end;
+	json_stream_t s;
+	char *big;
+	int len, i, memory;
+	long usecs;
+
+	big = bench_doc(&len);
+
+	json_stream_init(&s, 1000, INT_MIN, INT_MAX, count, NULL);
+	TEST_ASSERT_EQUAL(0, json_stream_select(&s, "result.*.temp"));
+
+	matched = 0;
+	gettimeofday(&start, NULL);
+	for (i = 0; i < len; i += 256) {
+		TEST_ASSERT_EQUAL(0, json_stream_feed(&s, big + i, (len - i < 256) ? len - i : 256));
+	}
+	TEST_ASSERT_EQUAL(0, json_stream_finish(&s));
+	gettimeofday(&end, NULL);
+
+	usecs = (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_usec - start.tv_usec);
+	memory = json_stream_memory(&s);
+
+	TEST_ASSERT_EQUAL(BENCH_ITEMS, matched);
+
+	// The parser memory doesn't depend on the document size
+	TEST_ASSERT_LESS_THAN(1024, memory);
+
+	printf("%d bytes parsed in %ld usecs, %d bytes used by the parser, 256 bytes chunks\n", len, usecs, memory);
+
+	json_stream_free(&s);
+	free(big);
+}
+
+// Lua heap, to measure the memory used by each decoder
+static size_t heap_used;
+static size_t heap_peak;
+
+static void *bench_alloc(void *ud, void *ptr, size_t osize, size_t nsize) {
+	void *nptr;
+
+	if (!ptr) {
+		osize = 0;
+	}
+
+	if (nsize == 0) {
+		free(ptr);
+		heap_used -= osize;
+		return NULL;
+	}
+
+	nptr = realloc(ptr, nsize);
+	if (nptr) {
+		heap_used += nsize - osize;
+		if (heap_used > heap_peak) {
+			heap_peak = heap_used;
+		}
+	}
+
+	return nptr;
+}
+
+// Run a chunk, returns its time, and the Lua heap peak above the heap before
+// running it
+static long bench_run(lua_State *L, const char *chunk, size_t *peak) {
+	struct timeval start, end;
+	size_t base;
+
+	lua_gc(L, LUA_GCCOLLECT, 0);
+	base = heap_used;
+	heap_peak = heap_used;
+
+	gettimeofday(&start, NULL);
+	TEST_ASSERT_EQUAL(0, luaL_dostring(L, chunk));
+	gettimeofday(&end, NULL);
+
+	*peak = heap_peak - base;
+
+	lua_getglobal(L, "matched");
+	TEST_ASSERT_EQUAL(BENCH_ITEMS, lua_tointeger(L, -1));
+	lua_pop(L, 1);
+
+	return (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_usec - start.tv_usec);
+}
+
+TEST_CASE("json stream against json.decode", "[lua_cjson]") {
+	lua_State *L;
+	char *big;
+	int len;
+	size_t decode_peak, stream_peak;
+	long decode_usecs, stream_usecs;
+
+	big = bench_doc(&len);
+
+	heap_used = 0;
+	L = lua_newstate(bench_alloc, NULL);
+	TEST_ASSERT_NOT_NULL(L);
+
+	luaL_requiref(L, "_G", luaopen_base, 1);
+	luaL_requiref(L, "string", luaopen_string, 1);
+	luaL_requiref(L, "json", luaopen_cjson, 1);
+	lua_settop(L, 0);
+
+	lua_pushlstring(L, big, len);
+	lua_setglobal(L, "doc");
+	free(big);
+
+	// Whole document, and then pick the fields
+	decode_usecs = bench_run(L,
+		"local n = 0 "
+		"local t = json.decode(doc) "
+		"for _, r in ipairs(t.result) do if r.temp then n = n + 1 end end "
+		"matched = n",
+		&decode_peak);
+
+	// Selected fields only, fed in 256 bytes chunks
+	stream_usecs = bench_run(L,
+		"local n = 0 "
+		"local d = json.decoder(function(v) n = n + 1 end, 'result.*.temp') "
+		"for i = 1, #doc, 256 do d:feed(doc:sub(i, i + 255)) end "
+		"d:finish() "
+		"matched = n",
+		&stream_peak);
+
+	lua_close(L);
+
+	printf("%d bytes document, Lua heap peak / time:\n", len);
+	printf("  json.decode:            %u bytes, %ld usecs\n", (unsigned)decode_peak, decode_usecs);
+	printf("  json.decoder, selected: %u bytes, %ld usecs\n", (unsigned)stream_peak, stream_usecs);
+
+	TEST_ASSERT_LESS_THAN(decode_peak, stream_peak);
+}
@@ -83,6 +83,16 @@ static void on_received(int port, char *payload) {
     free(payload);
 }
 
+static void on_tx_done(void *arg, int status) {
+    lua_callback_t *tx_callback = (lua_callback_t *)arg;
+
+    // Push argument for the callback's function
+    lua_pushinteger(luaS_callback_state(tx_callback), status);
+
+    luaS_callback_call(tx_callback, 1);
+    luaS_callback_destroy(tx_callback);
+}
+
 // Pads a hex number string representation at a specified length
 static char *hex_str_pad(lua_State* L, const char  *str, int len) {
     if (!lcheck_hex_str(str)) {
@@ -443,6 +453,30 @@ static int llora_tx(lua_State* L) {
         luaL_error(L, "%d:invalid data", LORA_ERR_INVALID_ARGUMENT);
     }
 
+    if (lua_isfunction(L, 4)) {
+        // Queue the transmission, and return without waiting for it
+        int prio = luaL_optinteger(L, 5, LORA_TX_PRIO_DEFAULT);
+
+        if ((prio < 0) || (prio > 255)) {
+            return luaL_error(L, "%d:invalid priority", LORA_ERR_INVALID_ARGUMENT);
+        }
+
+        lua_settop(L, 4);
+
+        lua_callback_t *tx_callback = luaS_callback_create(L, 4);
+        if (tx_callback == NULL) {
+            return luaL_exception_extended(L, LORA_ERR_NO_MEM, NULL);
+        }
+
+        driver_error_t *error = lora_tx_async(cnf, port, data, prio, on_tx_done, tx_callback);
+        if (error) {
+            luaS_callback_destroy(tx_callback);
+            return luaL_driver_error(L, error);
+        }
+
+        return 0;
+    }
+
     driver_error_t *error = lora_tx(cnf, port, data);
     if (error) {
         return luaL_driver_error(L, error);
@@ -495,6 +529,11 @@ static const LUA_REG_TYPE lora_map[] = {
     { LSTRKEY( "NODE"     ), 	 LINTVAL( 0 ) },
     { LSTRKEY( "GATEWAY"  ), 	 LINTVAL( 1 ) },
 
+    { LSTRKEY( "TX_DONE"      ), LINTVAL( LORA_TX_DONE ) },
+    { LSTRKEY( "TX_NOT_ACKED" ), LINTVAL( LORA_TX_NOT_ACKED ) },
+    { LSTRKEY( "TX_DROPPED"   ), LINTVAL( LORA_TX_DROPPED ) },
+    { LSTRKEY( "TX_FAILED"    ), LINTVAL( LORA_TX_FAILED ) },
+
 	DRIVER_REGISTER_LUA_ERRORS(lora)
 #endif
 
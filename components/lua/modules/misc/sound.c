@@ -154,6 +154,51 @@ static int lsound_music_silence(lua_State* L) {
     return 0;
 }
 
+static int lsound_music_wait(lua_State* L) {
+    sound_userdata *sound = (sound_userdata *)luaL_checkudata(L, 1, "sound.device");
+    luaL_argcheck(L, sound, 1, "sound expected");
+
+    driver_error_t *error;
+
+	if ((error = sound_music_wait(&sound->h))) {
+    	return luaL_driver_error(L, error);
+	}
+
+    return 0;
+}
+
+static int lsound_play_file(lua_State* L) {
+    sound_userdata *sound = (sound_userdata *)luaL_checkudata(L, 1, "sound.device");
+    luaL_argcheck(L, sound, 1, "sound expected");
+
+    const char *path = luaL_checkstring(L, 2);
+
+    driver_error_t *error;
+    wav_info_t raw;
+
+    // If the sample rate is present the file is raw PCM, otherwise is a
+    // WAV file
+    if (lua_gettop(L) >= 3) {
+    	int rate = luaL_checkinteger(L, 3);
+    	int bits = luaL_optinteger(L, 4, 16);
+    	int channels = luaL_optinteger(L, 5, 1);
+
+    	if (wav_raw(&raw, rate, channels, bits)) {
+    		return luaL_error(L, "invalid raw format");
+    	}
+
+    	error = tone_play_file(&sound->h, path, &raw);
+    } else {
+    	error = tone_play_file(&sound->h, path, NULL);
+    }
+
+	if (error) {
+    	return luaL_driver_error(L, error);
+	}
+
+    return 0;
+}
+
 static int lsound_time_signature(lua_State* L) {
     sound_userdata *sound = (sound_userdata *)luaL_checkudata(L, 1, "sound.device");
     luaL_argcheck(L, sound, 1, "sound expected");
@@ -203,6 +248,8 @@ static const LUA_REG_TYPE lsound_device_map[] = {
   	{ LSTRKEY( "playnote"      ),	  LFUNCVAL( lsound_music_note      ) },
   	{ LSTRKEY( "playtone"      ),	  LFUNCVAL( lsound_music_tone      ) },
   	{ LSTRKEY( "playsilence"   ),	  LFUNCVAL( lsound_music_silence   ) },
+  	{ LSTRKEY( "wait"          ),	  LFUNCVAL( lsound_music_wait      ) },
+  	{ LSTRKEY( "playfile"      ),	  LFUNCVAL( lsound_play_file       ) },
     { LSTRKEY( "__metatable"   ),	  LROVAL  ( lsound_device_map      ) },
 	{ LSTRKEY( "__index"       ),     LROVAL  ( lsound_device_map      ) },
     { LSTRKEY( "__gc"          ),     LFUNCVAL( lsound_trans_gc        ) },
@@ -191,6 +191,13 @@ static int lnet_lookup(lua_State* L) {
     return 1;
 }
 
+static int lnet_flushdns(lua_State* L) {
+    // Flush a name, or all the names
+    net_dns_flush(luaL_optstring(L, 1, NULL));
+
+    return 0;
+}
+
 static int lnet_packip(lua_State *L) {
     net_ip ip;
     unsigned i;
@@ -427,6 +434,7 @@ static const LUA_REG_TYPE net_map[] = {
     { LSTRKEY( "stat" ),      LFUNCVAL ( lnet_stat ) },
     { LSTRKEY( "connected" ), LFUNCVAL ( lnet_connected ) },
     { LSTRKEY( "lookup" ),    LFUNCVAL ( lnet_lookup ) },
+    { LSTRKEY( "flushdns" ),  LFUNCVAL ( lnet_flushdns ) },
     { LSTRKEY( "packip" ),    LFUNCVAL ( lnet_packip ) },
     { LSTRKEY( "unpackip" ),  LFUNCVAL ( lnet_unpackip ) },
     { LSTRKEY( "ping" ),      LFUNCVAL ( lnet_ping ) },
@@ -39,7 +39,10 @@
  * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
  * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  *
- * Lua RTOS, Lua pack / unpack hex string module
+ * Lua RTOS, Lua pack / unpack module
+ *
+ * pack.pack / pack.unpack use the former hex string format, pack.encode /
+ * pack.decode the compact binary format of sys/misc/value_pack.h
  *
  */
 
@@ -54,6 +57,8 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <sys/misc/value_pack.h>
+
 #if CONFIG_LUA_RTOS_LUA_USE_PACK
 #define PACK_NUMBER   0b0000
 #define PACK_INTEGER  0b0001
@@ -72,6 +77,9 @@
 #define PACK_UNPACK_TYPE(v, n) \
 ((v & PACK_PACK_TYPE(0b1111, n)) >> ((8 - PACK_BITS_PER_TYPE) - ((n-1) % PACK_TYPES_PER_BYTE)*PACK_BITS_PER_TYPE))
 
+// Max. nesting of tables in pack.encode / pack.decode, also stops cyclic tables
+#define PACK_MAX_DEPTH VPACK_MAX_DEPTH
+
 // Convert an hex string buffer (hbuff argument) into a byte buffer (vbuff 
 // argument) of len argument size
 static void hex_string_to_val(char *hbuff, char *vbuff, int len) {
@@ -434,11 +442,374 @@ static int l_unpack(lua_State *L) {
 
 }
 
+static void encode_value(lua_State *L, int idx, vpack_writer_t *w, int depth);
+
+// Tables with the keys 1 .. n are encoded as arrays, the rest as maps
+static void encode_table(lua_State *L, int idx, vpack_writer_t *w, int depth) {
+    size_t count = 0;
+    int array = 1;
+    lua_Integer key;
+    size_t len;
+    size_t i;
+
+    if (depth >= PACK_MAX_DEPTH) {
+        luaL_error(L, "table too deep, or cyclic");
+    }
+
+    luaL_checkstack(L, 3, "table too deep");
+
+    len = lua_rawlen(L, idx);
+
+    // It's an array only if all keys are in 1..len, as other keys
+    // would be lost
+    lua_pushnil(L);
+    while (lua_next(L, idx)) {
+        count++;
+
+        if (array) {
+            if (lua_isinteger(L, -2)) {
+                key = lua_tointeger(L, -2);
+                array = (key >= 1) && ((lua_Unsigned)key <= len);
+            } else {
+                array = 0;
+            }
+        }
+
+        lua_pop(L, 1);
+    }
+
+    if (array && (count == len)) {
+        vpack_put_array(w, len);
+
+        for(i = 1; i <= len; i++) {
+            lua_rawgeti(L, idx, i);
+            encode_value(L, lua_gettop(L), w, depth + 1);
+            lua_pop(L, 1);
+        }
+    } else {
+        vpack_put_map(w, count);
+
+        lua_pushnil(L);
+        while (lua_next(L, idx)) {
+            encode_value(L, lua_gettop(L) - 1, w, depth + 1);
+            encode_value(L, lua_gettop(L), w, depth + 1);
+            lua_pop(L, 1);
+        }
+    }
+}
+
+static void encode_value(lua_State *L, int idx, vpack_writer_t *w, int depth) {
+    const char *str;
+    size_t len;
+
+    switch(lua_type(L, idx)) {
+        case LUA_TNIL:
+            vpack_put_nil(w);
+            break;
+
+        case LUA_TBOOLEAN:
+            vpack_put_boolean(w, lua_toboolean(L, idx));
+            break;
+
+        case LUA_TNUMBER:
+            if (lua_isinteger(L, idx)) {
+                vpack_put_integer(w, lua_tointeger(L, idx));
+            } else {
+                vpack_put_number(w, lua_tonumber(L, idx));
+            }
+            break;
+
+        case LUA_TSTRING:
+            str = lua_tolstring(L, idx, &len);
+            vpack_put_string(w, str, len);
+            break;
+
+        case LUA_TTABLE:
+            encode_table(L, idx, w, depth);
+            break;
+
+        default:
+            luaL_error(L, "unsupported type %s", luaL_typename(L, idx));
+    }
+}
+
+// Encode a value without tag, with a schema type
+static void encode_schema_value(lua_State *L, char type, int idx, vpack_writer_t *w) {
+    lua_Integer integer;
+    const char *str;
+    size_t len;
+
+    switch(type) {
+        case 'b':
+            vpack_put_byte(w, lua_toboolean(L, idx));
+            break;
+
+        case 'i':
+            vpack_put_zigzag(w, luaL_checkinteger(L, idx));
+            break;
+
+        case 'u':
+            integer = luaL_checkinteger(L, idx);
+            luaL_argcheck(L, integer >= 0, idx, "negative value");
+            vpack_put_varint(w, integer);
+            break;
+
+        case 'f':
+            vpack_put_float(w, (float)luaL_checknumber(L, idx));
+            break;
+
+        case 'd':
+            vpack_put_double(w, (double)luaL_checknumber(L, idx));
+            break;
+
+        case 's':
+            str = luaL_checklstring(L, idx, &len);
+            vpack_put_varint(w, len);
+            vpack_put_bytes(w, str, len);
+            break;
+
+        case '*':
+            encode_value(L, idx, w, 0);
+            break;
+
+        default:
+            luaL_error(L, "invalid schema type '%c'", type);
+    }
+}
+
+static void encode_values(lua_State *L, const char *schema, int first, int last, vpack_writer_t *w) {
+    int i;
+
+    for(i = first; i <= last; i++) {
+        if (schema) {
+            encode_schema_value(L, schema[i - first], i, w);
+        } else {
+            encode_value(L, i, w, 0);
+        }
+    }
+}
+
+// Encode the arguments from first, and push the encoded string. The encoding
+// is measured first, and then written directly into a Lua buffer of the
+// right size.
+static int encode_arguments(lua_State *L, const char *schema, int first) {
+    int last = lua_gettop(L);
+    vpack_writer_t w;
+    luaL_Buffer b;
+    size_t size;
+    char *buf;
+
+    if (schema && (strlen(schema) != last - first + 1)) {
+        return luaL_error(L, "schema has %d values, got %d", (int)strlen(schema), last - first + 1);
+    }
+
+    vpack_writer_init(&w, NULL, 0);
+    encode_values(L, schema, first, last, &w);
+    size = w.len;
+
+    buf = luaL_buffinitsize(L, &b, size);
+    vpack_writer_init(&w, (uint8_t *)buf, size);
+    encode_values(L, schema, first, last, &w);
+    luaL_pushresultsize(&b, size);
+
+    return 1;
+}
+
+static void push_integer(lua_State *L, int64_t value) {
+    if ((value >= LUA_MININTEGER) && (value <= LUA_MAXINTEGER)) {
+        lua_pushinteger(L, (lua_Integer)value);
+    } else {
+        lua_pushnumber(L, (lua_Number)value);
+    }
+}
+
+static void decode_value(lua_State *L, vpack_reader_t *r) {
+    vpack_value_t v;
+    size_t i;
+
+    if (vpack_get(r, &v) < 0) {
+        luaL_error(L, "invalid or truncated data");
+    }
+
+    luaL_checkstack(L, 3, "too many values");
+
+    switch(v.type) {
+        case VPACK_NIL:
+            lua_pushnil(L);
+            break;
+
+        case VPACK_BOOLEAN:
+            lua_pushboolean(L, v.boolean);
+            break;
+
+        case VPACK_INTEGER:
+            push_integer(L, v.integer);
+            break;
+
+        case VPACK_DOUBLE:
+            lua_pushnumber(L, (lua_Number)v.number);
+            break;
+
+        case VPACK_STRING:
+            lua_pushlstring(L, (const char *)v.string, v.len);
+            break;
+
+        case VPACK_ARRAY:
+        case VPACK_MAP:
+            if (v.type == VPACK_ARRAY) {
+                lua_createtable(L, v.len, 0);
+
+                for(i = 1; i <= v.len; i++) {
+                    decode_value(L, r);
+                    lua_rawseti(L, -2, i);
+                }
+            } else {
+                lua_createtable(L, 0, v.len);
+
+                for(i = 0; i < v.len; i++) {
+                    decode_value(L, r);
+                    decode_value(L, r);
+                    if (lua_isnil(L, -2)) {
+                        luaL_error(L, "invalid or truncated data");
+                    }
+                    lua_rawset(L, -3);
+                }
+            }
+            break;
+
+        default:
+            luaL_error(L, "invalid or truncated data");
+    }
+}
+
+// Decode a value, and the values of an array or map. The value is checked
+// first, with the same depth limit as the encoder, so no table is built for
+// data that can't be decoded.
+static void decode_root(lua_State *L, vpack_reader_t *r) {
+    vpack_reader_t check = *r;
+
+    if (vpack_skip(&check, 0) < 0) {
+        luaL_error(L, "invalid or truncated data, or table too deep");
+    }
+
+    decode_value(L, r);
+}
+
+static void decode_schema_value(lua_State *L, char type, vpack_reader_t *r) {
+    const uint8_t *str;
+    uint64_t varint;
+    int64_t integer;
+    double number;
+    float fnumber;
+    uint8_t byte;
+    int ret = -1;
+
+    luaL_checkstack(L, 1, "too many values");
+
+    switch(type) {
+        case 'b':
+            if ((ret = vpack_get_byte(r, &byte)) == 0) lua_pushboolean(L, byte);
+            break;
+
+        case 'i':
+            if ((ret = vpack_get_zigzag(r, &integer)) == 0) push_integer(L, integer);
+            break;
+
+        case 'u':
+            if ((ret = vpack_get_varint(r, &varint)) == 0) {
+                if (varint <= LUA_MAXINTEGER) {
+                    lua_pushinteger(L, (lua_Integer)varint);
+                } else {
+                    lua_pushnumber(L, (lua_Number)varint);
+                }
+            }
+            break;
+
+        case 'f':
+            if ((ret = vpack_get_float(r, &fnumber)) == 0) lua_pushnumber(L, fnumber);
+            break;
+
+        case 'd':
+            if ((ret = vpack_get_double(r, &number)) == 0) lua_pushnumber(L, (lua_Number)number);
+            break;
+
+        case 's':
+            if (((ret = vpack_get_varint(r, &varint)) == 0) && ((ret = vpack_get_bytes(r, varint, &str)) == 0)) {
+                lua_pushlstring(L, (const char *)str, varint);
+            }
+            break;
+
+        case '*':
+            decode_root(L, r);
+            ret = 0;
+            break;
+
+        default:
+            luaL_error(L, "invalid schema type '%c'", type);
+    }
+
+    if (ret < 0) {
+        luaL_error(L, "invalid or truncated data");
+    }
+}
+
+// pack.encode(...): encode the arguments, with their types
+static int l_encode(lua_State *L) {
+    return encode_arguments(L, NULL, 1);
+}
+
+// pack.decode(data): decode all the values of data
+static int l_decode(lua_State *L) {
+    vpack_reader_t r;
+    size_t len;
+    const char *data = luaL_checklstring(L, 1, &len);
+    int top = lua_gettop(L);
+
+    vpack_reader_init(&r, data, len);
+    while (r.p < r.end) {
+        decode_root(L, &r);
+    }
+
+    return lua_gettop(L) - top;
+}
+
+// pack.encode_schema(schema, ...): encode the arguments without types. Each
+// character of the schema is the type of an argument: b (boolean),
+// i (integer), u (unsigned integer), f (float), d (double), s (string) or
+// * (any value, with its type).
+static int l_encode_schema(lua_State *L) {
+    return encode_arguments(L, luaL_checkstring(L, 1), 2);
+}
+
+// pack.decode_schema(schema, data)
+static int l_decode_schema(lua_State *L) {
+    const char *schema = luaL_checkstring(L, 1);
+    vpack_reader_t r;
+    size_t len;
+    const char *data = luaL_checklstring(L, 2, &len);
+    int top = lua_gettop(L);
+
+    vpack_reader_init(&r, data, len);
+    while (*schema) {
+        decode_schema_value(L, *schema++, &r);
+    }
+
+    if (r.p != r.end) {
+        return luaL_error(L, "unexpected data after the values");
+    }
+
+    return lua_gettop(L) - top;
+}
+
 static const LUA_REG_TYPE pack_map[] = 
 {
   { LSTRKEY( "pack"   ),    LFUNCVAL( l_pack   ) },
 //  { LSTRKEY( "b64"    ),    LFUNCVAL( l_b64    ) },
   { LSTRKEY( "unpack" ),    LFUNCVAL( l_unpack ) },
+  { LSTRKEY( "encode" ),    LFUNCVAL( l_encode ) },
+  { LSTRKEY( "decode" ),    LFUNCVAL( l_decode ) },
+  { LSTRKEY( "encode_schema" ), LFUNCVAL( l_encode_schema ) },
+  { LSTRKEY( "decode_schema" ), LFUNCVAL( l_decode_schema ) },
   { LNILKEY, LNILVAL }
 };
 
@@ -50,6 +50,8 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/adds.h"
 #include "freertos/timers.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
 
 #include "esp_attr.h"
 
@@ -60,9 +62,12 @@
 #include "tmr.h"
 
 #include <string.h>
+#include <stdlib.h>
 #include <unistd.h>
 
 #include <sys/delay.h>
+#include <sys/mutex.h>
+#include <sys/timer_wheel.h>
 
 #include <drivers/timer.h>
 #include <drivers/cpu.h>
@@ -72,6 +77,22 @@ typedef lua_callback_t *tmr_callback_t;
 static tmr_callback_t callbacks[CPU_LAST_TIMER + 1];
 static uint8_t stdio;
 
+// Software timers are kept in a timing wheel, driven by a single FreeRTOS
+// timer that is programmed for the next tick with work. The expired timers
+// are queued to the tmr task, that runs the Lua callbacks, so a slow
+// callback doesn't delay the other timers, nor the FreeRTOS timer task.
+//
+// The FreeRTOS timer is only programmed from the tmr task, that can wait
+// for room in the timer command queue. The others ask the tmr task to do
+// it, with a NULL entry in its queue.
+static timer_wheel_t wheel;
+static struct mtx wheel_mtx;
+static TimerHandle_t wheel_timer = NULL;
+static QueueHandle_t wheel_queue = NULL;
+static uint8_t wheel_rearm = 0;
+
+static void tmr_sw_program();
+
 static void callback_hw_func(void *arg) {
     int unit = (int)arg;
 
@@ -94,28 +115,142 @@ static void callback_hw_func(void *arg) {
     }
 }
 
-static void callback_sw_func(TimerHandle_t xTimer) {
-    tmr_userdata *tmr = (tmr_userdata *)pvTimerGetTimerID(xTimer);
+static void tmr_sw_task(void *arg) {
+    tmr_sw_t *sw;
+    uint8_t detached;
 
     // Set standards streams
-    if (!stdio) {
-        __getreent()->_stdin  = _GLOBAL_REENT->_stdin;
-        __getreent()->_stdout = _GLOBAL_REENT->_stdout;
-        __getreent()->_stderr = _GLOBAL_REENT->_stderr;
+    __getreent()->_stdin  = _GLOBAL_REENT->_stdin;
+    __getreent()->_stdout = _GLOBAL_REENT->_stdout;
+    __getreent()->_stderr = _GLOBAL_REENT->_stderr;
 
-        // Work-around newlib is not compiled with HAVE_BLKSIZE flag
-        setvbuf(_GLOBAL_REENT->_stdin , NULL, _IONBF, 0);
-        setvbuf(_GLOBAL_REENT->_stdout, NULL, _IONBF, 0);
-        setvbuf(_GLOBAL_REENT->_stderr, NULL, _IONBF, 0);
+    for(;;) {
+        xQueueReceive(wheel_queue, &sw, portMAX_DELAY);
 
-        stdio = 1;
+        if (!sw) {
+            tmr_sw_program();
+            continue;
+        }
+
+        mtx_lock(&wheel_mtx);
+        detached = sw->detached;
+        mtx_unlock(&wheel_mtx);
+
+        if (!detached) {
+            luaS_callback_call(sw->callback, 0);
+        }
+
+        // The timer can be expired again, or freed if it was detached
+        // while it was in the queue
+        mtx_lock(&wheel_mtx);
+        timer_wheel_done(&sw->entry);
+        detached = sw->detached;
+        mtx_unlock(&wheel_mtx);
+
+        if (detached) {
+            luaS_callback_destroy(sw->callback);
+            free(sw);
+        }
+
+        tmr_sw_program();
     }
+}
 
-    if (tmr->callback) {
-        luaS_callback_call(tmr->callback, 0);
+// Queue an expired timer to the tmr task, called with wheel_mtx held
+static int tmr_sw_expire(void *arg, timer_wheel_entry_t *entry) {
+    tmr_sw_t *sw = (tmr_sw_t *)entry->arg;
+
+    return (xQueueSend(wheel_queue, &sw, 0) == pdTRUE)?0:-1;
+}
+
+// Process the elapsed ticks, and ask the tmr task to program the FreeRTOS
+// timer for the next tick with work, called with wheel_mtx held. If the
+// queue is full the request is not lost, the tmr task checks it after
+// each entry.
+static void tmr_sw_schedule() {
+    tmr_sw_t *sw = NULL;
+
+    timer_wheel_advance(&wheel, xTaskGetTickCount(), tmr_sw_expire, NULL);
+
+    if (!wheel_rearm) {
+        wheel_rearm = 1;
+        xQueueSend(wheel_queue, &sw, 0);
     }
 }
 
+// Program the FreeRTOS timer for the next tick with work, if it was
+// requested, called from the tmr task
+static void tmr_sw_program() {
+    uint32_t next;
+
+    mtx_lock(&wheel_mtx);
+    if (!wheel_rearm) {
+        mtx_unlock(&wheel_mtx);
+        return;
+    }
+
+    wheel_rearm = 0;
+
+    timer_wheel_advance(&wheel, xTaskGetTickCount(), tmr_sw_expire, NULL);
+    next = timer_wheel_next(&wheel);
+    mtx_unlock(&wheel_mtx);
+
+    // Without wheel_mtx, as the FreeRTOS timer task takes it in
+    // callback_sw_func. The commands are sent in order from this task,
+    // so the last one has the last expiration.
+    if (next == TIMER_WHEEL_IDLE) {
+        xTimerStop(wheel_timer, portMAX_DELAY);
+    } else {
+        xTimerChangePeriod(wheel_timer, next, portMAX_DELAY);
+    }
+}
+
+static void callback_sw_func(TimerHandle_t xTimer) {
+    mtx_lock(&wheel_mtx);
+    tmr_sw_schedule();
+    mtx_unlock(&wheel_mtx);
+}
+
+static int tmr_sw_init() {
+    TaskHandle_t task;
+
+    mtx_lock(&wheel_mtx);
+
+    if (wheel_queue) {
+        mtx_unlock(&wheel_mtx);
+        return 0;
+    }
+
+    timer_wheel_init(&wheel, xTaskGetTickCount());
+
+    wheel_timer = xTimerCreate("tmr", 1, pdFALSE, NULL, callback_sw_func);
+    if (!wheel_timer) {
+        mtx_unlock(&wheel_mtx);
+        return -1;
+    }
+
+    wheel_queue = xQueueCreate(TMR_SW_QUEUE_LEN, sizeof(tmr_sw_t *));
+    if (!wheel_queue) {
+        xTimerDelete(wheel_timer, portMAX_DELAY);
+        wheel_timer = NULL;
+        mtx_unlock(&wheel_mtx);
+        return -1;
+    }
+
+    if (xTaskCreatePinnedToCore(tmr_sw_task, "tmr", CONFIG_LUA_RTOS_LUA_THREAD_STACK_SIZE, NULL, CONFIG_LUA_RTOS_LUA_THREAD_PRIORITY, &task, xPortGetCoreID()) != pdPASS) {
+        xTimerDelete(wheel_timer, portMAX_DELAY);
+        wheel_timer = NULL;
+        vQueueDelete(wheel_queue);
+        wheel_queue = NULL;
+        mtx_unlock(&wheel_mtx);
+        return -1;
+    }
+
+    mtx_unlock(&wheel_mtx);
+
+    return 0;
+}
+
 static int ltmr_delay( lua_State* L ) {
     unsigned int period = luaL_checkinteger( L, 1 );
     
@@ -212,29 +347,47 @@ static int ltmr_hw_attach( lua_State* L ) {
 }
 
 static int ltmr_sw_attach( lua_State* L ) {
-    tmr_userdata *tmr = (tmr_userdata *)lua_newuserdata(L, sizeof(tmr_userdata));
-    if (!tmr) {
-        return luaL_exception(L, TIMER_ERR_NOT_ENOUGH_MEMORY);
-    }
-
     int32_t millis = (int)luaL_checknumber(L, 1);
     if (millis < 1) {
         return luaL_exception(L, TIMER_ERR_INVALID_PERIOD);
     }
 
-    tmr->type = TmrSW;
+    luaL_checktype(L, 2, LUA_TFUNCTION);
 
-    // Create the lua callback
-    tmr->callback = luaS_callback_create(L, 2);
-    if (tmr->callback == NULL) {
+    if (tmr_sw_init() < 0) {
+        return luaL_exception(L, TIMER_ERR_NOT_ENOUGH_MEMORY);
+    }
+
+    tmr_sw_t *sw = calloc(1, sizeof(tmr_sw_t));
+    if (!sw) {
+        return luaL_exception(L, TIMER_ERR_NOT_ENOUGH_MEMORY);
+    }
+
+    tmr_userdata *tmr = (tmr_userdata *)lua_newuserdata(L, sizeof(tmr_userdata));
+    if (!tmr) {
+        free(sw);
         return luaL_exception(L, TIMER_ERR_NOT_ENOUGH_MEMORY);
     }
 
-    tmr->h = xTimerCreate("tmr", millis / portTICK_PERIOD_MS, pdTRUE, (void *)tmr, callback_sw_func);
-    if (!tmr->h) {
+    memset(tmr, 0, sizeof(tmr_userdata));
+
+    // Create the lua callback
+    sw->callback = luaS_callback_create(L, 2);
+    if (sw->callback == NULL) {
+        free(sw);
         return luaL_exception(L, TIMER_ERR_NOT_ENOUGH_MEMORY);
     }
 
+    timer_wheel_entry_init(&sw->entry, sw);
+
+    sw->period = millis / portTICK_PERIOD_MS;
+    if (sw->period < 1) {
+        sw->period = 1;
+    }
+
+    tmr->type = TmrSW;
+    tmr->sw = sw;
+
     luaL_getmetatable(L, "tmr.timer");
     lua_setmetatable(L, -2);
 
@@ -261,7 +414,11 @@ static int ltmr_start( lua_State* L ) {
             return luaL_driver_error(L, error);
         }
     } else if (tmr->type == TmrSW) {
-        xTimerStart(tmr->h, 0);
+        mtx_lock(&wheel_mtx);
+        timer_wheel_advance(&wheel, xTaskGetTickCount(), tmr_sw_expire, NULL);
+        timer_wheel_start(&wheel, &tmr->sw->entry, tmr->sw->period, tmr->sw->period, tmr->sw->window);
+        tmr_sw_schedule();
+        mtx_unlock(&wheel_mtx);
     }
 
     return 0;
@@ -279,12 +436,60 @@ static int ltmr_stop( lua_State* L ) {
             return luaL_driver_error(L, error);
         }
     } else if (tmr->type == TmrSW) {
-        xTimerStop(tmr->h, 0);
+        mtx_lock(&wheel_mtx);
+        timer_wheel_stop(&wheel, &tmr->sw->entry);
+        mtx_unlock(&wheel_mtx);
     }
 
     return 0;
 }
 
+// Set the coalescing window of a software timer, in milliseconds. The
+// expirations can be delayed up to the window, to run them together with
+// the expirations of other timers.
+static int ltmr_window( lua_State* L ) {
+    tmr_userdata *tmr = NULL;
+
+    tmr = (tmr_userdata *)luaL_checkudata(L, 1, "tmr.timer");
+    luaL_argcheck(L, tmr && (tmr->type == TmrSW), 1, "software tmr expected");
+
+    int32_t millis = (int)luaL_checknumber(L, 2);
+    if (millis < 0) {
+        return luaL_exception(L, TIMER_ERR_INVALID_PERIOD);
+    }
+
+    mtx_lock(&wheel_mtx);
+    tmr->sw->window = millis / portTICK_PERIOD_MS;
+    if (tmr->sw->entry.active) {
+        timer_wheel_advance(&wheel, xTaskGetTickCount(), tmr_sw_expire, NULL);
+        timer_wheel_start(&wheel, &tmr->sw->entry, tmr->sw->period, tmr->sw->period, tmr->sw->window);
+        tmr_sw_schedule();
+    }
+    mtx_unlock(&wheel_mtx);
+
+    return 0;
+}
+
+// Get the expirations of a software timer whose callback ran, and the ones
+// that were lost because the callback was still running
+static int ltmr_overruns( lua_State* L ) {
+    tmr_userdata *tmr = NULL;
+    uint32_t expirations, overruns;
+
+    tmr = (tmr_userdata *)luaL_checkudata(L, 1, "tmr.timer");
+    luaL_argcheck(L, tmr && (tmr->type == TmrSW), 1, "software tmr expected");
+
+    mtx_lock(&wheel_mtx);
+    overruns = tmr->sw->entry.overruns;
+    expirations = tmr->sw->entry.expirations;
+    mtx_unlock(&wheel_mtx);
+
+    lua_pushinteger(L, overruns);
+    lua_pushinteger(L, expirations);
+
+    return 2;
+}
+
 static int ltmr_detach (lua_State *L) {
     tmr_userdata *tmr = NULL;
     tmr = (tmr_userdata *)luaL_checkudata(L, 1, "tmr.timer");
@@ -293,8 +498,21 @@ static int ltmr_detach (lua_State *L) {
         tmr_ll_unsetup(tmr->unit);
         callbacks[tmr->unit] = NULL;
     } else if (tmr->type == TmrSW) {
-        xTimerStop(tmr->h, portMAX_DELAY);
-        xTimerDelete(tmr->h, portMAX_DELAY);
+        tmr_sw_t *sw = tmr->sw;
+        uint8_t pending;
+
+        mtx_lock(&wheel_mtx);
+        timer_wheel_stop(&wheel, &sw->entry);
+
+        // If the timer is in the tmr task, the task frees it
+        pending = sw->entry.pending;
+        sw->detached = 1;
+        mtx_unlock(&wheel_mtx);
+
+        if (!pending) {
+            luaS_callback_destroy(sw->callback);
+            free(sw);
+        }
     }
 
     // Destroy callback
@@ -318,6 +536,8 @@ static const LUA_REG_TYPE tmr_timer_map[] = {
     { LSTRKEY( "start"       ),     LFUNCVAL( ltmr_start    ) },
     { LSTRKEY( "stop"        ),     LFUNCVAL( ltmr_stop     ) },
     { LSTRKEY( "detach"      ),     LFUNCVAL( ltmr_detach   ) },
+    { LSTRKEY( "window"      ),     LFUNCVAL( ltmr_window   ) },
+    { LSTRKEY( "overruns"    ),     LFUNCVAL( ltmr_overruns ) },
     { LSTRKEY( "__metatable" ),     LROVAL  ( tmr_timer_map ) },
     { LSTRKEY( "__index"     ),     LROVAL  ( tmr_timer_map ) },
     { LSTRKEY( "__gc"        ),     LFUNCVAL( ltmr_gc       ) },
@@ -342,6 +562,10 @@ static const LUA_REG_TYPE tmr_map[] = {
 LUALIB_API int luaopen_tmr( lua_State *L ) {
     memset(callbacks, 0, sizeof(callbacks));
 
+    if (!mtx_inited(&wheel_mtx)) {
+        mtx_init(&wheel_mtx, "tmr", NULL, 0);
+    }
+
     luaL_newmetarotable(L,"tmr.timer", (void *)tmr_timer_map);
     return 0;
 }
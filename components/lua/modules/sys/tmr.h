@@ -50,16 +50,33 @@
 
 #include <drivers/cpu.h>
 
+#include <sys/timer_wheel.h>
+
+// Expired software timers waiting for the tmr task. A timer is never twice
+// in the queue, expirations lost because the queue is full are counted as
+// overruns.
+#define TMR_SW_QUEUE_LEN 16
+
 typedef enum {
 	TmrHW = 1,
 	TmrSW = 2
 } tmr_type_t;
 
+// Software timer. It is not in the userdata because it can outlive it,
+// while the callback is running in the tmr task.
+typedef struct {
+	timer_wheel_entry_t entry;
+	lua_callback_t *callback;
+	uint32_t period;   // In ticks
+	uint32_t window;   // Coalescing window, in ticks
+	uint8_t detached;
+} tmr_sw_t;
+
 typedef struct {
 	tmr_type_t type;
 	int8_t std;
 	int8_t unit;
-	TimerHandle_t h;
+	tmr_sw_t *sw;
 	lua_callback_t *callback;
 } tmr_userdata;
 
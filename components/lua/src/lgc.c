@@ -1164,7 +1164,7 @@ void luaC_step (lua_State *L) {
 void luaC_fullgc (lua_State *L, int isemergency) {
 #if LUA_USE_ROTABLE
   if (mtx_initialized == 0) {
-    mtx_init(&mtx_gc, NULL, NULL, 0);
+    mtx_init(&mtx_gc, "gc", NULL, 0);
     mtx_initialized = 1;
   }
 
@@ -712,6 +712,8 @@ static const LUA_REG_TYPE iolib[] = {
   { LSTRKEY( "write"      ),			LFUNCVAL( io_write   ) },
   { LSTRKEY( "receive"    ),			LFUNCVAL( f_receive  ) },
   { LSTRKEY( "send"       ),			LFUNCVAL( f_send     ) },
+  { LSTRKEY( "xreceive"   ),			LFUNCVAL( f_xreceive ) },
+  { LSTRKEY( "xsend"      ),			LFUNCVAL( f_xsend    ) },
   { LSTRKEY( "attributes" ), 		    LFUNCVAL( f_attributes) },
   { LNILKEY, LNILVAL }
 };
@@ -501,6 +501,9 @@ static const LUA_REG_TYPE syslib[] =
   { LSTRKEY( "uptime"),       LFUNCVAL( os_uptime ) },
 #if CONFIG_LUA_RTOS_USE_HARDWARE_LOCKS
   { LSTRKEY( "locks" ),       LFUNCVAL( os_locks ) },
+#endif
+#if CONFIG_LUA_RTOS_MUTEX_STATS
+  { LSTRKEY( "mutexes" ),     LFUNCVAL( os_mutexes ) },
 #endif
   { LSTRKEY( "exists" ),      LFUNCVAL( os_exists ) },
   { LSTRKEY( "stdout" ),      LFUNCVAL( os_stdout ) },
@@ -25,9 +25,14 @@
 
 #include "esp_attr.h"
 
+#include <stddef.h>
+
 void motion_prepare(motion_constraints_t *pconstraints, motion_t *pmotion) {
-    if (pconstraints->accleration_profile == MotionSCurve) {
-        pmotion->accleration_profile = MotionSCurve;
+    pmotion->ticks_per_second = pconstraints->ticks_per_second;
+    pmotion->_next_ticks = NULL;
+
+    if ((pconstraints->accleration_profile == MotionSCurve) || (pconstraints->accleration_profile == MotionSCurveFixed)) {
+        pmotion->accleration_profile = pconstraints->accleration_profile;
 
         pmotion->s_curve.v0 = pconstraints->s_curve.v0;
         pmotion->s_curve.v = pconstraints->s_curve.v;
@@ -39,6 +44,12 @@ void motion_prepare(motion_constraints_t *pconstraints, motion_t *pmotion) {
 
         pmotion->_prepare = s_curve_prepare;
         pmotion->_next = s_curve_next;
+
+        if (pconstraints->accleration_profile == MotionSCurveFixed) {
+            pmotion->_prepare = s_curve_fixed_prepare;
+            pmotion->_next = s_curve_fixed_next;
+            pmotion->_next_ticks = s_curve_fixed_next_ticks;
+        }
     }
 
     pmotion->_prepare(pmotion);
@@ -47,3 +58,11 @@ void motion_prepare(motion_constraints_t *pconstraints, motion_t *pmotion) {
 float IRAM_ATTR motion_next(motion_t *pmotion) {
     return pmotion->_next(pmotion);
 }
+
+uint32_t IRAM_ATTR motion_next_ticks(motion_t *pmotion) {
+    if (pmotion->_next_ticks) {
+        return pmotion->_next_ticks(pmotion);
+    }
+
+    return (uint32_t)(pmotion->_next(pmotion) * pmotion->ticks_per_second);
+}
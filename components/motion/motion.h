@@ -29,19 +29,25 @@
 
 #include "motion_math.h"
 #include "s_curve_motion_types.h"
+#include "s_curve_fixed_motion_types.h"
+
+#include <stdint.h>
 
 struct motion;
 
 typedef void (*motion_prepare_func_t)(struct motion *);
 typedef float (*motion_next_func_t)(struct motion *);
+typedef uint32_t (*motion_next_ticks_func_t)(struct motion *);
 
 typedef enum {
     MotionSCurve,
+    MotionSCurveFixed,
     MotionMax,
 } motion_profile_t;
 
 typedef struct {
     motion_profile_t accleration_profile;
+    uint32_t ticks_per_second; // Time base used by motion_next_ticks
 
     union {
         s_curve_motion_constraints s_curve;
@@ -51,17 +57,23 @@ typedef struct {
 typedef struct motion {
     motion_profile_t accleration_profile;
 
+    uint32_t ticks_per_second;
+
     motion_prepare_func_t _prepare;
     motion_next_func_t _next;
+    motion_next_ticks_func_t _next_ticks;
 
     union {
         s_curve_motion_t s_curve;
+        s_curve_fixed_motion_t s_curve_fixed;
     };
 } motion_t;
 
 void motion_prepare(motion_constraints_t *pconstraints, motion_t *pmotion);
 float motion_next(motion_t *pmotion);
+uint32_t motion_next_ticks(motion_t *pmotion);
 
 #include "s_curve_motion.h"
+#include "s_curve_fixed_motion.h"
 
 #endif
@@ -0,0 +1,548 @@
+/*
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ * Copyright (C) 2015 - 2020, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2020, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Multi-axis coordinated motion planner.
+ *
+ * Look-ahead
+ * ----------
+ *
+ * Each time a segment is queued, the max speed at the junction with the
+ * previous segment is computed using the junction deviation method, and then
+ * the queue is re-planned in 2 passes:
+ *
+ *   - Backward pass, from the newest segment: the entry speed of each segment
+ *     is limited to the speed from which the segment can decelerate to the entry
+ *     speed of the next segment. The last segment exits at zero speed.
+ *
+ *   - Forward pass, from the oldest segment: the entry speed of each segment is
+ *     limited to the speed that can be reached accelerating from the entry
+ *     speed of the previous segment.
+ *
+ * Segments that are executing, and the segment that follows them, are locked,
+ * and it's entry speed is never changed again.
+ *
+ * Step generation
+ * ---------------
+ *
+ * Each segment is executed on it's dominant axis (the axis with more steps),
+ * and the other axes follow the dominant axis using Bresenham's algorithm, so
+ * all axes start and end the segment at the same time. The speed of the
+ * dominant axis at step k is the minimum of the acceleration curve, the cruise
+ * speed, and the deceleration curve:
+ *
+ *   v(k) = min(sqrt(ve^2 + 2 * a * k), vc, sqrt(vx^2 + 2 * a * (N - k)))
+ *
+ * and, as acceleration is constant between 2 steps, the interval between steps
+ * k - 1 and k is exactly 2 / (v(k - 1) + v(k)).
+ *
+ * Step streams
+ * ------------
+ *
+ * All axes share the same time line, and each time an axis does a step, the
+ * time elapsed since it's previous step is written to it's stream as RMT
+ * items. Axes that don't step for a long time are flushed periodically, so
+ * their streams never starve.
+ */
+
+#include "planner.h"
+
+#include "esp_attr.h"
+
+#include <math.h>
+#include <string.h>
+
+#define SEGMENT(planner, i) (&(planner)->queue[((planner)->tail + (i)) % PLANNER_QUEUE_SIZE])
+
+static void _recalculate(planner_t *planner) {
+    planner_segment_t *segment, *next;
+    float next_entry = 0;
+    float speed;
+    int i;
+
+    // Backward pass
+    for(i = planner->count - 1; i >= 0; i--) {
+        segment = SEGMENT(planner, i);
+        if (segment->locked) {
+            break;
+        }
+
+        speed = sqrtf(next_entry * next_entry + 2.0 * segment->acceleration * segment->length);
+        segment->entry_speed = (speed < segment->max_entry_speed)?speed:segment->max_entry_speed;
+
+        next_entry = segment->entry_speed;
+    }
+
+    // Forward pass
+    for(i = 0; i < planner->count - 1; i++) {
+        segment = SEGMENT(planner, i);
+        next = SEGMENT(planner, i + 1);
+
+        if (next->locked) {
+            continue;
+        }
+
+        speed = sqrtf(segment->entry_speed * segment->entry_speed + 2.0 * segment->acceleration * segment->length);
+        if (next->entry_speed > speed) {
+            next->entry_speed = speed;
+        }
+    }
+}
+
+static float _junction_speed(planner_t *planner, planner_segment_t *prev, planner_segment_t *segment) {
+    float cos_theta = 0;
+    float sin_theta_d2;
+    float speed;
+    float acc;
+    int i;
+
+    for(i = 0; i < PLANNER_MAX_AXES; i++) {
+        cos_theta -= prev->unit_vec[i] * segment->unit_vec[i];
+    }
+
+    speed = (prev->nominal_speed < segment->nominal_speed)?prev->nominal_speed:segment->nominal_speed;
+
+    if (cos_theta > 0.999999) {
+        // Reversal
+        return 0;
+    } else if (cos_theta < -0.999999) {
+        // Straight line
+        return speed;
+    }
+
+    acc = (prev->acceleration < segment->acceleration)?prev->acceleration:segment->acceleration;
+
+    sin_theta_d2 = sqrtf(0.5 * (1.0 - cos_theta));
+    sin_theta_d2 = sqrtf((acc * planner->junction_deviation * sin_theta_d2) / (1.0 - sin_theta_d2));
+
+    return (sin_theta_d2 < speed)?sin_theta_d2:speed;
+}
+
+static void IRAM_ATTR _segment_begin(planner_t *planner, planner_segment_t *segment) {
+    planner_segment_t *next = NULL;
+    float scale = segment->event_count / segment->length;
+    float n = segment->event_count;
+    float na, nd;
+    int i;
+
+    // Lock the entry speed of the next segment, that is the exit speed of this segment
+    segment->locked = 1;
+
+    if (planner->count > 1) {
+        next = SEGMENT(planner, 1);
+        next->locked = 1;
+    } else {
+        planner->exit_locked = 1;
+    }
+
+    // Convert speeds to steps of the dominant axis
+    planner->acc = segment->acceleration * scale;
+    planner->v_entry = segment->entry_speed * scale;
+    planner->v_exit = ((next != NULL) && !next->stop)?next->entry_speed * scale:0;
+    planner->v_cruise = segment->nominal_speed * scale;
+
+    // Steps for accelerate to cruise speed, and for decelerate from cruise speed
+    na = (planner->v_cruise * planner->v_cruise - planner->v_entry * planner->v_entry) / (2.0 * planner->acc);
+    nd = (planner->v_cruise * planner->v_cruise - planner->v_exit * planner->v_exit) / (2.0 * planner->acc);
+
+    if (na < 0) na = 0;
+    if (nd < 0) nd = 0;
+
+    if (na + nd > n) {
+        // Cruise speed can't be reached
+        na = (2.0 * planner->acc * n + planner->v_exit * planner->v_exit - planner->v_entry * planner->v_entry) / (4.0 * planner->acc);
+
+        if (na < 0) na = 0;
+        if (na > n) na = n;
+
+        nd = n - na;
+
+        planner->v_cruise = sqrtf(planner->v_entry * planner->v_entry + 2.0 * planner->acc * na);
+    }
+
+    // Add 1 step of margin, the speed is always the minimum of the curves
+    planner->accelerate_until = (uint32_t)na + 1;
+    planner->decelerate_after = (nd + 1 >= n)?0:segment->event_count - ((uint32_t)nd + 1);
+
+    planner->v_prev = planner->v_entry;
+    planner->step = 0;
+
+    // Bresenham counters start at 0, so the last step of all axes is done at
+    // the last step of the dominant axis
+    for(i = 0; i < PLANNER_MAX_AXES; i++) {
+        planner->counter[i] = 0;
+    }
+
+    planner->current = segment;
+}
+
+static int IRAM_ATTR _flush(planner_t *planner, uint8_t axis, planner_emit_func_t emit, void *arg) {
+    planner_stream_t *stream = &planner->stream[axis];
+    uint32_t consumed, item;
+    uint32_t d0, d1;
+
+    while (stream->pending > 0) {
+        if (stream->pending_pulse) {
+            // Step pulse, and then low level until the next step
+            d0 = planner->pulse_ticks;
+            d1 = (stream->pending > d0 + 1)?stream->pending - d0:1;
+
+            if (d1 > PLANNER_ITEM_MAX_TICKS) {
+                d1 = PLANNER_ITEM_MAX_TICKS;
+            }
+        } else {
+            // Low level, using both halves of the item
+            consumed = stream->pending;
+            if (consumed > (PLANNER_ITEM_MAX_TICKS << 1)) {
+                consumed = PLANNER_ITEM_MAX_TICKS << 1;
+            }
+
+            d0 = (consumed > 1)?(consumed >> 1):1;
+            d1 = (consumed > 1)?consumed - d0:1;
+        }
+
+        item = PLANNER_ITEM(stream->pending_pulse, d0, 0, d1);
+        consumed = d0 + d1;
+
+        if (!emit(arg, axis, item)) {
+            return 0;
+        }
+
+        stream->pending = (consumed >= stream->pending)?0:stream->pending - consumed;
+        stream->pending_pulse = 0;
+    }
+
+    if (stream->pending_end) {
+        // End of transmission
+        if (!emit(arg, axis, 0)) {
+            return 0;
+        }
+
+        stream->pending_end = 0;
+    }
+
+    return 1;
+}
+
+void planner_init(planner_t *planner, uint8_t axes_mask, float ticks_per_second, float junction_deviation, uint32_t pulse_ticks) {
+    memset(planner, 0, sizeof(planner_t));
+
+    planner->axes_mask = axes_mask;
+    planner->ticks_per_second = ticks_per_second;
+    planner->junction_deviation = junction_deviation;
+    planner->pulse_ticks = pulse_ticks;
+}
+
+void planner_clear(planner_t *planner) {
+    planner_init(planner, planner->axes_mask, planner->ticks_per_second, planner->junction_deviation, planner->pulse_ticks);
+}
+
+int planner_queued(planner_t *planner) {
+    return planner->count;
+}
+
+int planner_add_line(planner_t *planner, uint8_t mask, const float *units, const float *steps_per_unit, float speed, float acceleration) {
+    planner_segment_t *segment, *prev;
+    float length = 0;
+    float steps;
+    uint32_t abs_steps;
+    int i;
+
+    if (planner->count == PLANNER_QUEUE_SIZE) {
+        return PLANNER_ERR_QUEUE_FULL;
+    }
+
+    if ((speed <= 0) || (acceleration <= 0)) {
+        return PLANNER_ERR_INVALID;
+    }
+
+    segment = SEGMENT(planner, planner->count);
+    memset(segment, 0, sizeof(planner_segment_t));
+
+    mask &= planner->axes_mask;
+
+    // Compute steps for each axis, keeping the fraction of step that can't be done
+    for(i = 0; i < PLANNER_MAX_AXES; i++) {
+        if (!(mask & (1 << i))) {
+            continue;
+        }
+
+        steps = units[i] * steps_per_unit[i] + planner->residual[i];
+
+        segment->steps[i] = (int32_t)floorf(steps + 0.5);
+        planner->residual[i] = steps - segment->steps[i];
+
+        abs_steps = (segment->steps[i] < 0)?-segment->steps[i]:segment->steps[i];
+        if (abs_steps > segment->event_count) {
+            segment->event_count = abs_steps;
+        }
+
+        if (segment->steps[i] != 0) {
+            segment->move_mask |= (1 << i);
+
+            if (segment->steps[i] > 0) {
+                segment->dir_mask |= (1 << i);
+            }
+        }
+
+        length += units[i] * units[i];
+    }
+
+    if (segment->event_count == 0) {
+        // Nothing to do
+        return 0;
+    }
+
+    segment->length = sqrtf(length);
+
+    for(i = 0; i < PLANNER_MAX_AXES; i++) {
+        if (mask & (1 << i)) {
+            segment->unit_vec[i] = units[i] / segment->length;
+        }
+    }
+
+    segment->nominal_speed = speed;
+    segment->acceleration = acceleration;
+
+    // Compute the max entry speed
+    if (planner->count == 0) {
+        // Queue is empty, start a new run
+        segment->max_entry_speed = 0;
+        segment->stop = 1;
+    } else if (planner->exit_locked) {
+        // Previous segment is executing, and exits at zero speed
+        segment->max_entry_speed = 0;
+        segment->locked = 1;
+    } else {
+        prev = SEGMENT(planner, planner->count - 1);
+
+        if ((prev->move_mask & segment->move_mask) & (prev->dir_mask ^ segment->dir_mask)) {
+            // Direction change, segments can't be joined
+            segment->max_entry_speed = 0;
+            segment->stop = 1;
+        } else {
+            segment->max_entry_speed = _junction_speed(planner, prev, segment);
+        }
+    }
+
+    if (planner->running && !segment->stop) {
+        // Segment joins to the current run, and direction pins are already set
+        for(i = 0; i < planner->count; i++) {
+            if (SEGMENT(planner, i)->stop && (SEGMENT(planner, i) != planner->current)) {
+                break;
+            }
+        }
+
+        // Only the axes that move in the run are started, so a segment that
+        // moves other axes can't join it
+        if ((i == planner->count) && ((segment->move_mask & (segment->dir_mask ^ planner->run_dir_mask)) || (segment->move_mask & ~planner->run_mask))) {
+            segment->max_entry_speed = 0;
+            segment->stop = 1;
+        }
+    }
+
+    segment->entry_speed = segment->max_entry_speed;
+
+    planner->exit_locked = 0;
+    planner->count++;
+
+    _recalculate(planner);
+
+    return 0;
+}
+
+int planner_begin_run(planner_t *planner, uint8_t *dir_mask) {
+    planner_segment_t *segment;
+    uint8_t move_mask = 0;
+    int i;
+
+    if (planner->count == 0) {
+        return 0;
+    }
+
+    // Compute the direction of each axis in the run. Axes that don't move in
+    // the run keep the direction of the previous run.
+    for(i = 0; i < planner->count; i++) {
+        segment = SEGMENT(planner, i);
+
+        if ((i > 0) && segment->stop) {
+            break;
+        }
+
+        planner->run_dir_mask &= ~(segment->move_mask & ~move_mask);
+        planner->run_dir_mask |= (segment->dir_mask & ~move_mask);
+        move_mask |= segment->move_mask;
+    }
+
+    SEGMENT(planner, 0)->stop = 1;
+
+    planner->run_mask = move_mask;
+    planner->current = NULL;
+    planner->running = 1;
+    planner->run_end = 0;
+    planner->time = 0;
+    planner->frac = 0;
+
+    memset(planner->stream, 0, sizeof(planner->stream));
+
+    *dir_mask = planner->run_dir_mask;
+
+    return 1;
+}
+
+int IRAM_ATTR planner_next_event(planner_t *planner, planner_event_t *event) {
+    planner_segment_t *segment;
+    float v, dt, ticks;
+    uint32_t steps;
+    int i;
+
+    if (planner->current == NULL) {
+        if (planner->count == 0) {
+            return 0;
+        }
+
+        segment = SEGMENT(planner, 0);
+
+        if (segment->stop && (planner->time > 0)) {
+            // Segment starts a new run
+            return 0;
+        }
+
+        _segment_begin(planner, segment);
+    }
+
+    segment = planner->current;
+
+    planner->step++;
+
+    // Speed at current step
+    v = planner->v_cruise;
+
+    if (planner->step <= planner->accelerate_until) {
+        dt = sqrtf(planner->v_entry * planner->v_entry + 2.0 * planner->acc * planner->step);
+        if (dt < v) v = dt;
+    }
+
+    if (planner->step >= planner->decelerate_after) {
+        dt = sqrtf(planner->v_exit * planner->v_exit + 2.0 * planner->acc * (segment->event_count - planner->step));
+        if (dt < v) v = dt;
+    }
+
+    // Interval between previous and current step
+    dt = planner->v_prev + v;
+    if (dt < sqrtf(planner->acc)) {
+        // Only for 1 step segments starting and ending at zero speed
+        dt = sqrtf(planner->acc);
+    }
+
+    dt = 2.0 / dt;
+
+    planner->v_prev = v;
+
+    // Convert to ticks, keeping the fraction of tick
+    ticks = dt * planner->ticks_per_second + planner->frac;
+
+    event->ticks = (ticks < 1.0)?1:(uint32_t)ticks;
+    planner->frac = ticks - event->ticks;
+
+    // Axes that do a step
+    event->step_mask = 0;
+
+    for(i = 0; i < PLANNER_MAX_AXES; i++) {
+        if (segment->move_mask & (1 << i)) {
+            steps = (segment->steps[i] < 0)?-segment->steps[i]:segment->steps[i];
+
+            planner->counter[i] += steps;
+            if (planner->counter[i] >= segment->event_count) {
+                planner->counter[i] -= segment->event_count;
+                event->step_mask |= (1 << i);
+            }
+        }
+    }
+
+    if (planner->step == segment->event_count) {
+        // Segment done
+        planner->tail = (planner->tail + 1) % PLANNER_QUEUE_SIZE;
+        planner->count--;
+        planner->current = NULL;
+
+        if (planner->count == 0) {
+            planner->exit_locked = 0;
+        }
+    }
+
+    return 1;
+}
+
+int IRAM_ATTR planner_fill(planner_t *planner, planner_emit_func_t emit, void *arg) {
+    planner_stream_t *stream;
+    planner_event_t event;
+    uint8_t axis;
+
+    if (!planner->running) {
+        return 0;
+    }
+
+    for(;;) {
+        // Write pending items
+        for(axis = 0; axis < PLANNER_MAX_AXES; axis++) {
+            if ((planner->run_mask & (1 << axis)) && !_flush(planner, axis, emit, arg)) {
+                // No space
+                return 1;
+            }
+        }
+
+        if (planner->run_end) {
+            planner->running = 0;
+            return 0;
+        }
+
+        if (!planner_next_event(planner, &event)) {
+            // End of run, write the last step pulse, and the end of transmission
+            for(axis = 0; axis < PLANNER_MAX_AXES; axis++) {
+                stream = &planner->stream[axis];
+
+                stream->pending = stream->pulse?planner->pulse_ticks + 1:0;
+                stream->pending_pulse = stream->pulse;
+                stream->pending_end = 1;
+                stream->pulse = 0;
+            }
+
+            planner->run_end = 1;
+            continue;
+        }
+
+        planner->time += event.ticks;
+
+        for(axis = 0; axis < PLANNER_MAX_AXES; axis++) {
+            stream = &planner->stream[axis];
+
+            if ((event.step_mask & (1 << axis)) || (planner->time - stream->last >= PLANNER_FLUSH_TICKS)) {
+                stream->pending = planner->time - stream->last;
+                stream->pending_pulse = stream->pulse;
+                stream->pulse = ((event.step_mask & (1 << axis)) != 0);
+                stream->last = planner->time;
+            }
+        }
+    }
+}
@@ -0,0 +1,146 @@
+/*
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ * Copyright (C) 2015 - 2020, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2020, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Multi-axis coordinated motion planner.
+ *
+ * Line segments are queued, and a look-ahead pass computes the junction speed
+ * between consecutive segments, so axes don't stop at each segment boundary.
+ * Then, segments are converted into time-synchronized step streams, one for
+ * each axis, encoded as RMT items.
+ *
+ * Segments in which the direction of some axis changes can't be joined, because
+ * direction is set with a GPIO and not with the step stream. In this case the
+ * path is splitted into runs. Each run has a fixed direction for each axis, and
+ * starts and ends at zero speed.
+ *
+ * This module doesn't depend on the RTOS, or on the hardware.
+ */
+
+#ifndef _MOTION_PLANNER_H_
+#define _MOTION_PLANNER_H_
+
+#include <stdint.h>
+
+// Max number of axes
+#define PLANNER_MAX_AXES 8
+
+// Number of segments in the queue
+#define PLANNER_QUEUE_SIZE 16
+
+// Max duration for one level of an RMT item, in ticks
+#define PLANNER_ITEM_MAX_TICKS 32767
+
+// An axis that doesn't step for this time (in ticks) is flushed to it's stream,
+// to don't starve the RMT while other axes are stepping
+#define PLANNER_FLUSH_TICKS PLANNER_ITEM_MAX_TICKS
+
+// Build a RMT item
+#define PLANNER_ITEM(level0, duration0, level1, duration1) \
+    (((uint32_t)(level1) << 31) | ((uint32_t)(duration1) << 16) | ((uint32_t)(level0) << 15) | (uint32_t)(duration0))
+
+// Errors
+#define PLANNER_ERR_QUEUE_FULL  -1
+#define PLANNER_ERR_INVALID     -2
+
+/*
+ * Function called for write an item into the stream of an axis. Must return 1
+ * if the item was written, or 0 if there is no space in the stream.
+ */
+typedef int (*planner_emit_func_t)(void *arg, uint8_t axis, uint32_t item);
+
+typedef struct {
+    int32_t steps[PLANNER_MAX_AXES]; // Steps for each axis (signed)
+    uint32_t event_count;            // Steps of the dominant axis
+    uint8_t dir_mask;                // Axes that move in positive direction
+    uint8_t move_mask;               // Axes that move
+    uint8_t stop;                    // Segment must start from zero speed
+    uint8_t locked;                  // Entry speed can't be changed by the planner
+
+    float length;                    // Length, in units
+    float unit_vec[PLANNER_MAX_AXES];// Unit vector
+    float nominal_speed;             // Nominal speed, in units / sec
+    float acceleration;              // Acceleration, in units / sec^2
+    float max_entry_speed;           // Max entry speed (junction limit), in units / sec
+    float entry_speed;               // Planned entry speed, in units / sec
+} planner_segment_t;
+
+typedef struct {
+    uint64_t last;      // Time of the first tick not written to the stream yet
+    uint32_t pending;   // Pending ticks to write to the stream
+    uint8_t pulse;      // Next item starts with a step pulse
+    uint8_t pending_pulse;
+    uint8_t pending_end;
+} planner_stream_t;
+
+typedef struct {
+    uint8_t axes_mask;         // Axes handled by the planner
+    float ticks_per_second;    // Stream time base
+    float junction_deviation;  // Junction deviation, in units
+    uint32_t pulse_ticks;      // Step pulse duration, in ticks
+
+    // Segment queue
+    planner_segment_t queue[PLANNER_QUEUE_SIZE];
+    uint8_t tail;              // Oldest segment
+    uint8_t count;             // Number of queued segments
+    uint8_t exit_locked;       // Last queued segment is executing, and
+                               // exits at zero speed
+    float residual[PLANNER_MAX_AXES]; // Fraction of step not queued yet
+
+    // Step generator
+    planner_segment_t *current;
+    uint32_t step;             // Current step of the dominant axis
+    uint32_t accelerate_until; // Last step of the acceleration
+    uint32_t decelerate_after; // First step of the deceleration
+    float v_entry;             // Entry speed, in steps / sec
+    float v_exit;              // Exit speed, in steps / sec
+    float v_cruise;            // Cruise speed, in steps / sec
+    float v_prev;              // Speed at the previous step, in steps / sec
+    float acc;                 // Acceleration, in steps / sec^2
+    float frac;                // Fraction of tick not emitted yet
+    uint32_t counter[PLANNER_MAX_AXES]; // Bresenham counters
+
+    // Current run
+    uint8_t running;
+    uint8_t run_end;
+    uint8_t run_dir_mask;
+    uint8_t run_mask;          // Axes that move in the current run
+    uint64_t time;             // Current run time, in ticks
+    planner_stream_t stream[PLANNER_MAX_AXES];
+} planner_t;
+
+typedef struct {
+    uint32_t ticks;    // Ticks since the previous event
+    uint8_t step_mask; // Axes that do a step
+} planner_event_t;
+
+void planner_init(planner_t *planner, uint8_t axes_mask, float ticks_per_second, float junction_deviation, uint32_t pulse_ticks);
+int planner_add_line(planner_t *planner, uint8_t mask, const float *units, const float *steps_per_unit, float speed, float acceleration);
+int planner_queued(planner_t *planner);
+void planner_clear(planner_t *planner);
+
+int planner_begin_run(planner_t *planner, uint8_t *dir_mask);
+int planner_next_event(planner_t *planner, planner_event_t *event);
+int planner_fill(planner_t *planner, planner_emit_func_t emit, void *arg);
+
+#endif
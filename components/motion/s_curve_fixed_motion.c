@@ -0,0 +1,277 @@
+/*
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ * Copyright (C) 2015 - 2020, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2020, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * S-curve motion profile, fixed-point implementation.
+ *
+ * The phase bounds are computed once, when the motion is prepared, using the
+ * floating point s-curve profile. Then, for each phase, the entry velocity,
+ * acceleration and jerk are converted to fixed-point (steps and ticks), and
+ * step intervals are generated with an incremental recurrence that only uses
+ * integer arithmetic:
+ *
+ *   - In phase 4 (constant velocity) the interval is 1 / v, that is computed
+ *     only once.
+ *
+ *   - In the other phases the interval dt is the root of
+ *
+ *       v * dt + (a / 2) * dt^2 + (j / 6) * dt^3 - 1 = 0
+ *
+ *     where v and a are the velocity and acceleration at the current step. The
+ *     root is refined with a Newton iteration, starting from the previous
+ *     interval, that is always a very close approximation. The derivative is
+ *     taken as 1 / dt (the velocity that does one step in dt), so the update
+ *     is dt = dt - error * dt, and no division is needed. Then v and a are
+ *     advanced to the next step.
+ *
+ * Intervals are kept in 32 bits. Motions with intervals that don't fit (very
+ * slow starts) use the floating point profile.
+ *
+ * Intervals are emitted directly in ticks of the motion time base, and the
+ * fraction of tick not emitted is accumulated for the next step, so no time
+ * is lost due to rounding.
+ */
+
+#include "motion.h"
+
+#include "esp_attr.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define V_SHIFT S_CURVE_FIXED_V_SHIFT
+#define A_SHIFT S_CURVE_FIXED_A_SHIFT
+#define J_SHIFT S_CURVE_FIXED_J_SHIFT
+#define T_SHIFT S_CURVE_FIXED_T_SHIFT
+
+// One step, in Q40
+#define ONE_STEP (1LL << V_SHIFT)
+
+// Number of Newton iterations for each step
+#define NEWTON_ITERATIONS 1
+
+// Limit for the Newton error term, so the correction is never greater than
+// the interval
+#define NEWTON_ERROR_LIMIT (ONE_STEP >> 1)
+
+// Longest interval, in Q8 ticks. One tick less than S_CURVE_FIXED_MAX_TICKS,
+// so the interval plus the accumulated fraction of tick still fit in 32 bits.
+#define MAX_DT ((uint32_t)((((uint64_t)S_CURVE_FIXED_MAX_TICKS) - 1) << T_SHIFT))
+
+// Longest first step of a phase, in seconds, for the fixed-point profile. Half
+// of MAX_DT, because the interval of the last steps of a deceleration can be
+// longer than the first step of the phase.
+#define MAX_FIRST_STEP(ticks_per_second) ((S_CURVE_FIXED_MAX_TICKS >> 1) / (ticks_per_second))
+
+/*
+ * Compute (x * dt) >> (shift + T_SHIFT), rounded to nearest, where dt is an
+ * interval expressed in Q8 ticks. The product is computed in 96 bits, splitting
+ * x in 32-bit halves, so only the result must fit in 64 bits. Rounding is
+ * important, because velocity is advanced incrementally, and truncation errors
+ * would accumulate along the phase.
+ */
+static inline int64_t IRAM_ATTR _mul_dt(int64_t x, uint32_t dt, int shift) {
+    uint64_t m = (x < 0)?-x:x;
+    uint64_t hi = (m >> 32) * dt;
+    uint64_t lo = (m & 0xffffffff) * dt;
+    int s = shift + T_SHIFT;
+    uint64_t r;
+
+    if (s >= 32) {
+        r = (hi + (lo >> 32) + (1ULL << (s - 33))) >> (s - 32);
+    } else {
+        r = (hi << (32 - s)) + ((lo + (1ULL << (s - 1))) >> s);
+    }
+
+    return (x < 0)?-(int64_t)r:(int64_t)r;
+}
+
+static uint32_t _to_dt(double seconds, double ticks_per_second) {
+    double dt = ldexp(seconds * ticks_per_second, T_SHIFT);
+
+    if (dt < 1.0) {
+        return 1;
+    } else if (dt > MAX_DT) {
+        return MAX_DT;
+    }
+
+    return (uint32_t)dt;
+}
+
+/*
+ * Compute the time required to do the first step of a phase, in seconds,
+ * using the floating point solver.
+ */
+static float _first_step_time(float v, float a, float j, float units_per_step) {
+    float guess;
+
+    if (v > 0.0) {
+        guess = units_per_step / v;
+    } else if (a > 0.0) {
+        guess = sqrt((2.0 * units_per_step) / a);
+    } else if (j > 0.0) {
+        guess = cbrt((6.0 * units_per_step) / j);
+    } else {
+        return 0.0;
+    }
+
+    if ((a == 0.0) && (j == 0.0)) {
+        return guess;
+    }
+
+    return solve_third_order_newton(j / 6.0, 0.5 * a, v, -units_per_step, guess, 0.0000001);
+}
+
+void s_curve_fixed_prepare(motion_t *pmotion) {
+    s_curve_fixed_motion_t *pfixed = &pmotion->s_curve_fixed;
+    s_curve_motion_t *pcurve = &pmotion->s_curve;
+    double tps = pmotion->ticks_per_second;
+    double spu = pcurve->steps_per_unit;
+    float v[8], a[8], j[8], t[8];
+    int phase;
+
+    // Compute phase bounds using the floating point profile
+    s_curve_prepare(pmotion);
+
+    // Phase entry values, in units, as in s_curve_next
+    v[1] = pcurve->v0;          a[1] = 0;               j[1] = pcurve->j;
+    v[2] = pcurve->bound.v[1];  a[2] = pcurve->a;       j[2] = 0;
+    v[3] = pcurve->bound.v[2];  a[3] = pcurve->a;       j[3] = -1.0 * pcurve->j;
+    v[4] = pcurve->bound.v[3];  a[4] = 0;               j[4] = 0;
+    v[5] = pcurve->bound.v[4];  a[5] = 0;               j[5] = -1.0 * pcurve->j;
+    v[6] = pcurve->bound.v[5];  a[6] = -1.0 * pcurve->a; j[6] = 0;
+    v[7] = pcurve->bound.v[6];  a[7] = -1.0 * pcurve->a; j[7] = pcurve->j;
+
+    // Intervals too long for the fixed-point representation, use the floating
+    // point profile, that is already prepared
+    for(phase = 1; phase <= 7; phase++) {
+        t[phase] = _first_step_time(v[phase], a[phase], j[phase], pcurve->units_per_step);
+
+        if (t[phase] > MAX_FIRST_STEP(tps)) {
+            pmotion->_next = s_curve_next;
+            pmotion->_next_ticks = NULL;
+
+            return;
+        }
+    }
+
+    // Convert to fixed-point
+    for(phase = 1; phase <= 7; phase++) {
+        pfixed->phase_entry.v[phase] = (int64_t)ldexp((v[phase] * spu) / tps, V_SHIFT);
+        pfixed->phase_entry.a[phase] = (int64_t)ldexp((a[phase] * spu) / (tps * tps), A_SHIFT);
+        pfixed->phase_entry.j[phase] = (int64_t)ldexp((j[phase] * spu) / (tps * tps * tps), J_SHIFT);
+        pfixed->phase_entry.dt[phase] = _to_dt(t[phase], tps);
+        pfixed->phase_entry.steps[phase] = pcurve->bound.steps[phase];
+    }
+
+    pfixed->steps = pcurve->steps;
+    pfixed->step = 0;
+    pfixed->phase = 0;
+    pfixed->frac_ = 0;
+}
+
+uint32_t IRAM_ATTR s_curve_fixed_next_ticks(motion_t *pmotion) {
+    s_curve_fixed_motion_t *pfixed = &pmotion->s_curve_fixed;
+    int64_t adt, jdt, jdt2;
+    uint32_t dt;
+    int8_t phase;
+    int i;
+
+    // Increment steps done
+    pfixed->step++;
+
+    // Check in which profile phase we are. Phases are only advanced, so
+    // start from the current one.
+    phase = (pfixed->phase > 0)?pfixed->phase:1;
+    while ((phase < 7) && (pfixed->step > pfixed->phase_entry.steps[phase])) {
+        phase++;
+    }
+
+    if (phase != pfixed->phase) {
+        // Entering in a new phase, load the phase entry values
+        pfixed->v_ = pfixed->phase_entry.v[phase];
+        pfixed->a_ = pfixed->phase_entry.a[phase];
+        pfixed->j_ = pfixed->phase_entry.j[phase];
+        pfixed->dt_ = pfixed->phase_entry.dt[phase];
+        pfixed->phase = phase;
+    }
+
+    dt = pfixed->dt_;
+
+    if ((pfixed->a_ != 0) || (pfixed->j_ != 0)) {
+        // Refine the previous interval
+        for(i = 0; i < NEWTON_ITERATIONS; i++) {
+            jdt  = _mul_dt(pfixed->j_, dt, J_SHIFT - A_SHIFT);
+            adt  = _mul_dt(pfixed->a_, dt, A_SHIFT - V_SHIFT);
+            jdt2 = _mul_dt(jdt, dt, A_SHIFT - V_SHIFT);
+
+            // Velocity at the end of the interval, which is the derivative of the displacement
+            int64_t v_end = pfixed->v_ + adt + jdt2 / 2;
+
+            if (v_end <= 0) {
+                break;
+            }
+
+            // Displacement error
+            int64_t error = _mul_dt(pfixed->v_ + adt / 2 + jdt2 / 6, dt, 0) - ONE_STEP;
+
+            if (error > NEWTON_ERROR_LIMIT) {
+                error = NEWTON_ERROR_LIMIT;
+            } else if (error < -NEWTON_ERROR_LIMIT) {
+                error = -NEWTON_ERROR_LIMIT;
+            }
+
+            int64_t next_dt = (int64_t)dt - _mul_dt(error, dt, V_SHIFT - T_SHIFT);
+
+            if (next_dt < 1) {
+                next_dt = 1;
+            } else if (next_dt > MAX_DT) {
+                next_dt = MAX_DT;
+            }
+
+            dt = (uint32_t)next_dt;
+        }
+
+        // Advance velocity and acceleration to the next step
+        jdt  = _mul_dt(pfixed->j_, dt, J_SHIFT - A_SHIFT);
+        adt  = _mul_dt(pfixed->a_, dt, A_SHIFT - V_SHIFT);
+        jdt2 = _mul_dt(jdt, dt, A_SHIFT - V_SHIFT);
+
+        pfixed->v_ += adt + jdt2 / 2;
+        pfixed->a_ += jdt;
+    }
+
+    pfixed->dt_ = dt;
+
+    // Emit the integer part of the interval, and keep the fraction for the next step
+    pfixed->frac_ += dt;
+    dt = pfixed->frac_ >> T_SHIFT;
+    pfixed->frac_ &= ((1 << T_SHIFT) - 1);
+
+    return dt;
+}
+
+float IRAM_ATTR s_curve_fixed_next(motion_t *pmotion) {
+    return (float)s_curve_fixed_next_ticks(pmotion) / (float)pmotion->ticks_per_second;
+}
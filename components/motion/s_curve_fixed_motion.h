@@ -0,0 +1,33 @@
+/*
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ * Copyright (C) 2015 - 2020, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2020, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MOTION_S_CURVE_FIXED_MOTION_H_
+#define _MOTION_S_CURVE_FIXED_MOTION_H_
+
+#include "motion.h"
+
+void s_curve_fixed_prepare(motion_t *pmotion);
+float s_curve_fixed_next(motion_t *pmotion);
+uint32_t s_curve_fixed_next_ticks(motion_t *pmotion);
+
+#endif
@@ -0,0 +1,75 @@
+/*
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ * Copyright (C) 2015 - 2020, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2020, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MOTION_S_CURVE_FIXED_MOTION_TYPES_H_
+#define _MOTION_S_CURVE_FIXED_MOTION_TYPES_H_
+
+#include "s_curve_motion_types.h"
+
+#include <stdint.h>
+
+/*
+ * Fixed-point representation used by the fixed s-curve profile. Distances
+ * are expressed in steps, and time in ticks of the motion time base.
+ *
+ *   velocity:     steps / tick,   Q40
+ *   acceleration: steps / tick^2, Q72
+ *   jerk:         steps / tick^3, Q104
+ *   time:         ticks,          Q8
+ */
+#define S_CURVE_FIXED_V_SHIFT  40
+#define S_CURVE_FIXED_A_SHIFT  72
+#define S_CURVE_FIXED_J_SHIFT 104
+#define S_CURVE_FIXED_T_SHIFT   8
+
+// Intervals must be lower than this value (in ticks) to avoid overflows. Motions
+// with longer intervals use the floating point profile.
+#define S_CURVE_FIXED_MAX_TICKS (1 << 24)
+
+typedef struct {
+    // Floating point profile, used only for compute the phase bounds when
+    // the motion is prepared. Must be the first member, because the floating
+    // point profile is accessed through motion_t.s_curve.
+    s_curve_motion_t curve;
+
+    // Phase entry values, precomputed when the motion is prepared
+    struct {
+        int64_t v[8];     // Phase entry velocity
+        int64_t a[8];     // Phase entry acceleration
+        int64_t j[8];     // Phase jerk
+        uint32_t dt[8];   // First step interval in phase
+        int32_t steps[8]; // Phase steps (cumulative)
+    } phase_entry;
+
+    uint32_t steps;  // Number of steps
+    int32_t step;    // Current step
+    int8_t phase;    // Current phase
+
+    int64_t v_;      // Current velocity
+    int64_t a_;      // Current acceleration
+    int64_t j_;      // Phase jerk
+    uint32_t dt_;    // Last step interval
+    uint32_t frac_;  // Accumulated fraction of tick, not emitted yet
+} s_curve_fixed_motion_t;
+
+#endif
@@ -0,0 +1,277 @@
+/*
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ * Copyright (C) 2015 - 2020, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2020, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Lua RTOS, multi-axis motion planner test cases
+ */
+
+#include "unity.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <motion/planner.h>
+
+#define TICKS_PER_SECOND 40000000
+#define PULSE_TICKS      40
+#define MAX_STEPS        20000
+
+/*
+ * Step trace, decoded from the RMT items written by the planner
+ */
+typedef struct {
+    uint64_t time;                        // Current time of each axis
+    uint32_t steps;                       // Steps of each axis
+    uint64_t step_time[MAX_STEPS];        // Time of each step
+    int end;                              // End of transmission found
+} trace_t;
+
+static trace_t trace[PLANNER_MAX_AXES];
+
+static int emit(void *arg, uint8_t axis, uint32_t item) {
+    trace_t *ptrace = &trace[axis];
+
+    if (item == 0) {
+        ptrace->end = 1;
+        return 1;
+    }
+
+    TEST_ASSERT(!ptrace->end);
+
+    if (item & (1 << 15)) {
+        // Step pulse
+        TEST_ASSERT(ptrace->steps < MAX_STEPS);
+        ptrace->step_time[ptrace->steps++] = ptrace->time;
+    }
+
+    ptrace->time += (item & 0x7fff) + ((item >> 16) & 0x7fff);
+
+    return 1;
+}
+
+static void run(planner_t *planner, uint8_t *dir_mask) {
+    memset(trace, 0, sizeof(trace));
+
+    TEST_ASSERT(planner_begin_run(planner, dir_mask));
+    while (planner_fill(planner, emit, NULL));
+}
+
+TEST_CASE("planner single axis trapezoid", "[motion]") {
+    planner_t planner;
+    uint8_t dir_mask;
+    float units[PLANNER_MAX_AXES] = {10.0};
+    float spu[PLANNER_MAX_AXES] = {200.0};
+    double a = 10.0 * 200.0, v = 5.0 * 200.0;
+    double t, expected;
+    uint32_t k;
+
+    planner_init(&planner, 0x01, TICKS_PER_SECOND, 0.05, PULSE_TICKS);
+    TEST_ASSERT(planner_add_line(&planner, 0x01, units, spu, 5.0, 10.0) == 0);
+
+    run(&planner, &dir_mask);
+
+    TEST_ASSERT(dir_mask == 0x01);
+    TEST_ASSERT(trace[0].steps == 2000);
+    TEST_ASSERT(trace[0].end);
+
+    // Compare with the analytic trapezoid (step k at the end of the interval k + 1)
+    for(k = 1; k < trace[0].steps; k++) {
+        double pos = k;
+
+        if (pos <= (v * v) / (2.0 * a)) {
+            t = sqrt((2.0 * pos) / a);
+        } else if (pos <= 2000.0 - (v * v) / (2.0 * a)) {
+            t = v / a + (pos - (v * v) / (2.0 * a)) / v;
+        } else {
+            t = 2.0 * (v / a) + (2000.0 - 2.0 * (v * v) / (2.0 * a)) / v - sqrt((2.0 * (2000.0 - pos)) / a);
+        }
+
+        expected = t * TICKS_PER_SECOND;
+        TEST_ASSERT(fabs((double)trace[0].step_time[k - 1] - expected) < 2.0);
+    }
+}
+
+TEST_CASE("planner axes synchronization", "[motion]") {
+    planner_t planner;
+    uint8_t dir_mask;
+    float units[PLANNER_MAX_AXES] = {10.0, -5.0, 0.0, 2.5};
+    float spu[PLANNER_MAX_AXES] = {200.0, 200.0, 200.0, 400.0};
+    uint32_t k;
+
+    planner_init(&planner, 0x0f, TICKS_PER_SECOND, 0.05, PULSE_TICKS);
+    TEST_ASSERT(planner_add_line(&planner, 0x0f, units, spu, 20.0, 50.0) == 0);
+
+    run(&planner, &dir_mask);
+
+    TEST_ASSERT(dir_mask == 0x09);
+    TEST_ASSERT(trace[0].steps == 2000);
+    TEST_ASSERT(trace[1].steps == 1000);
+    TEST_ASSERT(trace[2].steps == 0);
+    TEST_ASSERT(trace[3].steps == 1000);
+
+    // Steps of the slave axes are at the same time that a step of the dominant axis
+    for(k = 0; k < 1000; k++) {
+        TEST_ASSERT(trace[1].step_time[k] == trace[0].step_time[2 * k + 1]);
+        TEST_ASSERT(trace[3].step_time[k] == trace[0].step_time[2 * k + 1]);
+    }
+
+    // All axes end at the same time
+    TEST_ASSERT(trace[1].step_time[999] == trace[0].step_time[1999]);
+}
+
+TEST_CASE("planner look-ahead", "[motion]") {
+    planner_t planner;
+    uint8_t dir_mask;
+    float line1[PLANNER_MAX_AXES] = {10.0, 0.0};
+    float line2[PLANNER_MAX_AXES] = {10.0, 1.0};
+    float line3[PLANNER_MAX_AXES] = {-5.0, 0.0};
+    float spu[PLANNER_MAX_AXES] = {200.0, 200.0};
+    uint64_t interval, cruise;
+
+    planner_init(&planner, 0x03, TICKS_PER_SECOND, 0.05, PULSE_TICKS);
+    TEST_ASSERT(planner_add_line(&planner, 0x03, line1, spu, 10.0, 50.0) == 0);
+    TEST_ASSERT(planner_add_line(&planner, 0x03, line2, spu, 10.0, 50.0) == 0);
+    TEST_ASSERT(planner_add_line(&planner, 0x03, line3, spu, 10.0, 50.0) == 0);
+    TEST_ASSERT(planner_queued(&planner) == 3);
+
+    // Almost collinear junction, speed must be near the nominal speed
+    TEST_ASSERT(planner.queue[1].entry_speed > 5.0);
+
+    // Reversal, must stop
+    TEST_ASSERT(planner.queue[2].entry_speed == 0.0);
+    TEST_ASSERT(planner.queue[2].stop);
+
+    // First run, line 1 and line 2
+    run(&planner, &dir_mask);
+    TEST_ASSERT(dir_mask == 0x03);
+    TEST_ASSERT(trace[0].steps == 4000);
+    TEST_ASSERT(trace[1].steps == 200);
+
+    // No stall at the junction
+    cruise = trace[0].step_time[1000] - trace[0].step_time[999];
+    interval = trace[0].step_time[2000] - trace[0].step_time[1999];
+    TEST_ASSERT(interval < 2 * cruise);
+
+    // Second run, line 3
+    TEST_ASSERT(planner_queued(&planner) == 1);
+    run(&planner, &dir_mask);
+    TEST_ASSERT(dir_mask == 0x02);
+    TEST_ASSERT(trace[0].steps == 1000);
+    TEST_ASSERT(planner_queued(&planner) == 0);
+    TEST_ASSERT(!planner_begin_run(&planner, &dir_mask));
+}
+
+static uint32_t emit_budget;
+
+static int emit_limited(void *arg, uint8_t axis, uint32_t item) {
+    if (emit_budget == 0) {
+        return 0;
+    }
+
+    emit_budget--;
+
+    return emit(arg, axis, item);
+}
+
+TEST_CASE("planner segments queued while running", "[motion]") {
+    planner_t planner;
+    uint8_t dir_mask;
+    float line1[PLANNER_MAX_AXES] = {10.0, 0.0, 0.0};
+    float line2[PLANNER_MAX_AXES] = {10.0, 0.0, 0.0};
+    float line3[PLANNER_MAX_AXES] = {10.0, 5.0, 0.0};
+    float spu[PLANNER_MAX_AXES] = {200.0, 200.0, 200.0};
+
+    planner_init(&planner, 0x07, TICKS_PER_SECOND, 0.05, PULSE_TICKS);
+    TEST_ASSERT(planner_add_line(&planner, 0x07, line1, spu, 10.0, 50.0) == 0);
+
+    memset(trace, 0, sizeof(trace));
+    TEST_ASSERT(planner_begin_run(&planner, &dir_mask));
+    TEST_ASSERT(planner.run_mask == 0x01);
+
+    // Stream is full in the middle of line 1
+    emit_budget = 100;
+    TEST_ASSERT(planner_fill(&planner, emit_limited, NULL));
+
+    // Line 2 joins the run, line 3 moves an axis that is not started
+    TEST_ASSERT(planner_add_line(&planner, 0x07, line2, spu, 10.0, 50.0) == 0);
+    TEST_ASSERT(planner_add_line(&planner, 0x07, line3, spu, 10.0, 50.0) == 0);
+    TEST_ASSERT(!planner.queue[1].stop);
+    TEST_ASSERT(planner.queue[2].stop);
+
+    while (planner_fill(&planner, emit, NULL));
+
+    // Only the axes in the run are written
+    TEST_ASSERT(trace[0].steps == 4000);
+    TEST_ASSERT(trace[0].end);
+    TEST_ASSERT(trace[1].time == 0);
+    TEST_ASSERT(!trace[1].end);
+    TEST_ASSERT(trace[2].time == 0);
+    TEST_ASSERT(!trace[2].end);
+
+    TEST_ASSERT(planner_queued(&planner) == 1);
+    run(&planner, &dir_mask);
+    TEST_ASSERT(planner.run_mask == 0x03);
+    TEST_ASSERT(trace[0].steps == 2000);
+    TEST_ASSERT(trace[1].steps == 1000);
+    TEST_ASSERT(!trace[2].end);
+}
+
+static int emit_null(void *arg, uint8_t axis, uint32_t item) {
+    (*(uint32_t *)arg)++;
+    return 1;
+}
+
+TEST_CASE("planner performance", "[motion]") {
+    planner_t planner;
+    uint8_t dir_mask;
+    float units[PLANNER_MAX_AXES] = {10.0, 7.0, 3.0};
+    float spu[PLANNER_MAX_AXES] = {3200.0, 3200.0, 3200.0};
+    struct timeval begin, end;
+    uint32_t items = 0;
+    uint32_t steps = 0;
+    double elapsed;
+
+    planner_init(&planner, 0x07, TICKS_PER_SECOND, 0.05, PULSE_TICKS);
+
+    gettimeofday(&begin, NULL);
+
+    do {
+        while (planner_queued(&planner) < PLANNER_QUEUE_SIZE) {
+            units[1] = -units[1];
+            planner_add_line(&planner, 0x07, units, spu, 50.0, 500.0);
+            steps += 32000;
+        }
+
+        while (planner_begin_run(&planner, &dir_mask)) {
+            while (planner_fill(&planner, emit_null, &items));
+        }
+
+        gettimeofday(&end, NULL);
+        elapsed = (end.tv_sec - begin.tv_sec) + (end.tv_usec - begin.tv_usec) / 1000000.0;
+    } while (elapsed < 0.5);
+
+    printf("planner: %.0f dominant axis steps per second, %.0f items per second\r\n", steps / elapsed, items / elapsed);
+}
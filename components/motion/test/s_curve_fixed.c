@@ -0,0 +1,180 @@
+/*
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ * Copyright (C) 2015 - 2020, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2020, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Lua RTOS, s-curve fixed-point motion profile test cases
+ *
+ * Step intervals generated by the fixed-point profile are compared against
+ * the intervals generated by the floating point profile, and the maximum
+ * sustainable steps per second of both profiles are reported.
+ */
+
+#include "unity.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+#include <motion/motion.h>
+
+// RMT time base used by the stepper driver (25 nsecs per tick)
+#define TICKS_PER_SECOND 40000000
+
+typedef struct {
+    float v0, v, a, j, s, steps_per_unit;
+} profile_t;
+
+static const profile_t profiles[] = {
+    // Stepper module defaults, with a long travel phase
+    {1.0, 16.6, 2.0, 20.0, 200.0, 200.0},
+
+    // Partial s-curve, no travel phase
+    {1.0, 50.0, 20.0, 200.0, 10.0, 200.0},
+
+    // High speed, micro stepping
+    {5.0, 100.0, 400.0, 8000.0, 300.0, 3200.0},
+};
+
+static void prepare(const profile_t *profile, motion_profile_t type, motion_t *motion) {
+    motion_constraints_t constraints;
+
+    constraints.accleration_profile = type;
+    constraints.ticks_per_second = TICKS_PER_SECOND;
+    constraints.s_curve.v0 = profile->v0;
+    constraints.s_curve.v = profile->v;
+    constraints.s_curve.a = profile->a;
+    constraints.s_curve.j = profile->j;
+    constraints.s_curve.s = profile->s;
+    constraints.s_curve.steps_per_unit = profile->steps_per_unit;
+    constraints.s_curve.units_per_step = 1.0 / profile->steps_per_unit;
+
+    motion_prepare(&constraints, motion);
+}
+
+static uint64_t now() {
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+
+    return ((uint64_t)tv.tv_sec * 1000000) + tv.tv_usec;
+}
+
+static double steps_per_second(const profile_t *profile, motion_profile_t type) {
+    motion_t motion;
+    uint32_t steps, step;
+    uint32_t total = 0;
+    uint64_t begin, end;
+    volatile uint32_t ticks = 0;
+
+    begin = now();
+
+    do {
+        prepare(profile, type, &motion);
+        steps = motion.s_curve.steps;
+
+        for(step = 0; step < steps; step++) {
+            ticks += motion_next_ticks(&motion);
+        }
+
+        total += steps;
+        end = now();
+    } while (end - begin < 200000);
+
+    return (total * 1000000.0) / (end - begin);
+}
+
+TEST_CASE("s-curve fixed profile timings", "[motion]") {
+    motion_t float_motion, fixed_motion;
+    double float_time, float_ticks;
+    uint64_t fixed_time;
+    uint32_t fixed_ticks;
+    uint32_t steps, step;
+    double error, max_error;
+    int i;
+
+    for(i = 0; i < sizeof(profiles) / sizeof(profile_t); i++) {
+        prepare(&profiles[i], MotionSCurve, &float_motion);
+        prepare(&profiles[i], MotionSCurveFixed, &fixed_motion);
+
+        steps = float_motion.s_curve.steps;
+        TEST_ASSERT_EQUAL(steps, fixed_motion.s_curve_fixed.steps);
+
+        float_time = 0;
+        fixed_time = 0;
+        max_error = 0;
+
+        for(step = 0; step < steps; step++) {
+            // Floating point intervals are not truncated to ticks, to avoid accumulating
+            // the truncation error
+            float_ticks = (double)motion_next(&float_motion) * TICKS_PER_SECOND;
+            fixed_ticks = motion_next_ticks(&fixed_motion);
+
+            float_time += float_ticks;
+            fixed_time += fixed_ticks;
+
+            TEST_ASSERT(fixed_ticks > 0);
+
+            // Relative error of the interval
+            error = fabs((double)fixed_ticks - float_ticks) / float_ticks;
+            if (error > max_error) {
+                max_error = error;
+            }
+        }
+
+        // Each interval must be within a 2% of the floating point interval, and the
+        // total movement time within a 0.1%
+        TEST_ASSERT(max_error < 0.02);
+        TEST_ASSERT(fabs((double)fixed_time - float_time) / float_time < 0.001);
+
+        printf("profile %d: %u steps, float %.6f s, fixed %.6f s, max step error %.4f%%\r\n",
+                i, steps, float_time / TICKS_PER_SECOND, (double)fixed_time / TICKS_PER_SECOND, max_error * 100.0);
+        printf("profile %d: max steps per second, float %.0f, fixed %.0f\r\n",
+                i, steps_per_second(&profiles[i], MotionSCurve), steps_per_second(&profiles[i], MotionSCurveFixed));
+    }
+}
+
+TEST_CASE("s-curve fixed profile long intervals", "[motion]") {
+    // Very slow start, the first intervals are longer than S_CURVE_FIXED_MAX_TICKS,
+    // so the floating point profile is used, and intervals are not clamped
+    const profile_t slow = {0.001, 1.0, 0.1, 0.1, 2.0, 200.0};
+    motion_t float_motion, fixed_motion;
+    uint32_t steps, step;
+    uint32_t ticks;
+
+    prepare(&slow, MotionSCurve, &float_motion);
+    prepare(&slow, MotionSCurveFixed, &fixed_motion);
+
+    steps = float_motion.s_curve.steps;
+    TEST_ASSERT_EQUAL(steps, fixed_motion.s_curve.steps);
+
+    ticks = motion_next_ticks(&fixed_motion);
+    TEST_ASSERT(ticks > S_CURVE_FIXED_MAX_TICKS);
+    TEST_ASSERT_EQUAL(motion_next_ticks(&float_motion), ticks);
+
+    for(step = 1; step < steps; step++) {
+        ticks = motion_next_ticks(&fixed_motion);
+        TEST_ASSERT(ticks > 0);
+        TEST_ASSERT_EQUAL(motion_next_ticks(&float_motion), ticks);
+    }
+}
@@ -38,6 +38,11 @@
 #endif
 #if __XTENSA__
 ssize_t writev(int fd, const struct iovec *iov, int iovcnt);
+
+#include "sdkconfig.h"
+#if CONFIG_LUA_RTOS_LUA_USE_NET
+#include <drivers/net.h>
+#endif
 #endif
 
 #include <stdlib.h>
@@ -680,6 +685,10 @@ int Socket_new(char* addr, int port, int* sock)
 #endif
 	struct addrinfo *result = NULL;
 	struct addrinfo hints = {0, AF_UNSPEC, SOCK_STREAM, IPPROTO_TCP, 0, NULL, NULL, NULL};
+#if __XTENSA__ && CONFIG_LUA_RTOS_LUA_USE_NET
+	driver_error_t *error;
+	int ipv6 = (addr[0] == '[');
+#endif
 
 	FUNC_ENTRY;
 	*sock = -1;
@@ -688,6 +697,21 @@ int Socket_new(char* addr, int port, int* sock)
 	if (addr[0] == '[')
 	  ++addr;
 
+#if __XTENSA__ && CONFIG_LUA_RTOS_LUA_USE_NET
+	/* IPv4 names are resolved through the DNS cache of the network driver, so
+	 * reconnections don't need a DNS query */
+	if (!ipv6)
+	{
+		if ((error = net_lookup(addr, port, &address)) == NULL)
+			rc = 0;
+		else
+		{
+			free(error);
+			rc = -1;
+		}
+	}
+	else
+#endif
 	if ((rc = getaddrinfo(addr, NULL, &hints, &result)) == 0)
 	{
 		struct addrinfo* res = result;
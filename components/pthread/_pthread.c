@@ -95,7 +95,7 @@ void _pthread_unlock() {
 void _pthread_init() {
     if (!inited) {
         // Create mutexes
-        mtx_init(&thread_mtx, NULL, NULL, 0);
+        mtx_init(&thread_mtx, "pthread", NULL, 0);
 
         // Init lists
         lstinit(&active_threads, 1, LIST_NOT_INDEXED);
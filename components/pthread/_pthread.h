@@ -61,6 +61,7 @@
 
 #include <sys/mutex.h>
 #include <sys/list.h>
+#include <sys/waitq.h>
 #include <sys/time.h>
 
 #include <signal.h>
@@ -116,8 +117,7 @@ struct pthread_mutex {
 
 struct pthread_cond {
     struct mtx mutex;
-    EventGroupHandle_t ev;
-    int referenced;
+    waitq_t queue;
 };
 
 struct pthread_key_specific {
@@ -199,7 +199,8 @@ int  pthread_cond_init(pthread_cond_t *cond, const pthread_condattr_t *attr);
 int  pthread_cond_destroy(pthread_cond_t *cond);
 int  pthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex);
 int  pthread_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex, const struct timespec *abstime);
-int pthread_cond_signal(pthread_cond_t *cond);
+int  pthread_cond_signal(pthread_cond_t *cond);
+int  pthread_cond_broadcast(pthread_cond_t *cond);
 
 int  pthread_once(pthread_once_t *once_control, void (*init_routine)(void));
 int  pthread_setcancelstate(int state, int *oldstate);
@@ -44,15 +44,54 @@
  */
 
 #include "_pthread.h"
+#include "esp_timer.h"
 
 #include <sys/mutex.h>
 #include <sys/time.h>
+#include <sys/waitq.h>
 
-#if configUSE_16_BIT_TICKS
-#define BITS_PER_EVENT_GROUP 8
-#else
-#define BITS_PER_EVENT_GROUP 24
-#endif
+/*
+ * Waiters are queued in the waitq of the condition variable, protected by
+ * the cond mutex, and each waiter is woken up with its own binary semaphore.
+ * The task notification is not used, as pthread_join and others wait on it,
+ * and a wake up left by a timed out wait would be taken by them.
+ */
+
+static void cond_lock(void *lock) {
+	mtx_lock((struct mtx *)lock);
+}
+
+static void cond_unlock(void *lock) {
+	mtx_unlock((struct mtx *)lock);
+}
+
+static void cond_wake(void *thread) {
+	xSemaphoreGive((SemaphoreHandle_t)thread);
+}
+
+static void cond_block(void *thread, uint64_t timeout) {
+	uint64_t ticks;
+
+	if (timeout == WAITQ_FOREVER) {
+		ticks = portMAX_DELAY;
+	} else {
+		// Round up, to not return before the deadline
+		ticks = (timeout + (portTICK_PERIOD_MS * 1000) - 1) / (portTICK_PERIOD_MS * 1000);
+		if (ticks >= portMAX_DELAY) {
+			ticks = portMAX_DELAY - 1;
+		}
+	}
+
+	xSemaphoreTake((SemaphoreHandle_t)thread, (TickType_t)ticks);
+}
+
+static uint64_t cond_now() {
+	return (uint64_t)esp_timer_get_time();
+}
+
+static const waitq_ops_t cond_ops = {
+	cond_lock, cond_unlock, NULL, cond_wake, cond_block, cond_now
+};
 
 int pthread_cond_init(pthread_cond_t *cond, const pthread_condattr_t *attr) {
 	// Avoid to reinitialize the object referenced by cond, a previously
@@ -74,13 +113,7 @@ int pthread_cond_init(pthread_cond_t *cond, const pthread_condattr_t *attr) {
 		return ENOMEM;
 	}
 
-	// Create the event group
-	scond->ev = xEventGroupCreate();
-	if (scond->ev == NULL) {
-		mtx_destroy(&scond->mutex);
-		free(scond);
-		return ENOMEM;
-	}
+	waitq_init(&scond->queue);
 
 	// Return the cond reference
 	*cond = (pthread_cond_t)scond;
@@ -97,14 +130,19 @@ int pthread_cond_destroy(pthread_cond_t *cond) {
 
 	mtx_lock(&scond->mutex);
 
-	if (scond->referenced > 0) {
+	if (scond->queue.waiters > 0) {
 		mtx_unlock(&scond->mutex);
 
 		return EBUSY;
 	}
 
+	mtx_unlock(&scond->mutex);
 	mtx_destroy(&scond->mutex);
 
+	free(scond);
+
+	*cond = PTHREAD_COND_INITIALIZER;
+
 	return 0;
 }
 
@@ -114,91 +152,84 @@ int pthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex) {
 
 int pthread_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex,
 		const struct timespec *abstime) {
+	waitq_waiter_t waiter;
+	uint64_t deadline;
+	int res;
 
 	if (*cond == PTHREAD_COND_INITIALIZER) {
-		return EINVAL;
-	}
-
-	struct pthread_cond *scond = (struct pthread_cond *)*cond;
-
-	// Find an unused bit in the event group to sync the condition
-	mtx_lock(&scond->mutex);
-
-	uint8_t bit;
-	for(bit=0;bit < BITS_PER_EVENT_GROUP;bit++) {
-		if (!((1 << bit) & scond->referenced)) {
-			scond->referenced |= (1 << bit);
-
-			break;
+		if ((res = pthread_cond_init(cond, NULL))) {
+			return res;
 		}
 	}
 
-	mtx_unlock(&scond->mutex);
-
-	if (bit >= BITS_PER_EVENT_GROUP) {
-		// All bits are used in the event group. This is a rare condition, because
-		// in Lua RTOS an event group has 24 bits, which means that 24 conditions
-		// (or 24 threads) can be handled for each condition variable.
-		//
-		// Although is not part of the pthread specification we indicate this
-		// condition returning the EINVAL error code.
-		return EINVAL;
-	}
-
-	// Get the timeout in ticks
-	TickType_t ticks;
+	struct pthread_cond *scond = (struct pthread_cond *)*cond;
 
+	// Get the deadline. abstime is in the realtime clock, and it is
+	// converted to the monotonic clock only once, so changes of the
+	// wall clock during the wait don't change its length.
 	if (!abstime) {
-		ticks = portMAX_DELAY;
+		deadline = WAITQ_FOREVER;
 	} else {
-		struct timeval now, future, diff;
+		struct timeval now;
+		int64_t remaining;
 
 		gettimeofday(&now, NULL);
 
-		future.tv_sec = abstime->tv_sec;
-		future.tv_usec = abstime->tv_nsec / 1000;
-
-		if (timercmp(&future, &now, <)) {
+		remaining = ((int64_t)abstime->tv_sec - now.tv_sec) * 1000000LL +
+					(abstime->tv_nsec / 1000) - now.tv_usec;
+		if (remaining <= 0) {
 			return ETIMEDOUT;
-		} else {
-			timersub(&future, &now, &diff);
-			ticks = ((diff.tv_sec * 1000) + (diff.tv_usec / 1000)) / portTICK_PERIOD_MS;
 		}
+
+		deadline = cond_now() + remaining;
 	}
 
+	// The wake up of this wait, it is deleted after the wait, so a late
+	// wake up is not seen by others
+	waiter.thread = (void *)xSemaphoreCreateBinary();
+	if (!waiter.thread) {
+		return ENOMEM;
+	}
+
+	// Queue before releasing the mutex, so a signal sent after the
+	// release is not lost
+	waitq_prepare(&cond_ops, &scond->mutex, &scond->queue, &waiter);
+
 	pthread_mutex_unlock(mutex);
-	EventBits_t uxBits = xEventGroupWaitBits(scond->ev, (1 << bit), pdTRUE, pdTRUE, ticks);
-	if (!(uxBits & (1 << bit))) {
-	    pthread_mutex_lock(mutex);
-	    scond->referenced &= ~(1 << bit);
-	    pthread_mutex_unlock(mutex);
+	res = waitq_wait(&cond_ops, &scond->mutex, &scond->queue, &waiter, deadline);
+	pthread_mutex_lock(mutex);
+
+	// The waiter is not in the queue anymore, nobody can give it
+	vSemaphoreDelete((SemaphoreHandle_t)waiter.thread);
 
+	if (res < 0) {
 		return ETIMEDOUT;
 	}
-	pthread_mutex_lock(mutex);
 
 	return 0;
 }
 
 int pthread_cond_signal(pthread_cond_t *cond) {
+	// A condition variable that is not initialized has no waiters
 	if (*cond == PTHREAD_COND_INITIALIZER) {
-		return EINVAL;
+		return 0;
 	}
 
 	struct pthread_cond *scond = (struct pthread_cond *)*cond;
 
-	mtx_lock(&scond->mutex);
+	waitq_wake_one(&cond_ops, &scond->mutex, &scond->queue);
 
-	uint8_t bit;
-	for(bit=0;bit < BITS_PER_EVENT_GROUP;bit++) {
-		if ((1 << bit) & scond->referenced) {
-			xEventGroupSetBits(scond->ev, (1 << bit));
+	return 0;
+}
 
-			scond->referenced &= ~(1 << bit);
-		}
+int pthread_cond_broadcast(pthread_cond_t *cond) {
+	if (*cond == PTHREAD_COND_INITIALIZER) {
+		return 0;
 	}
 
-	mtx_unlock(&scond->mutex);
+	struct pthread_cond *scond = (struct pthread_cond *)*cond;
+
+	waitq_wake_all(&cond_ops, &scond->mutex, &scond->queue);
 
 	return 0;
 }
@@ -61,6 +61,9 @@ static void remove_entry(ramfs_t *fs, ramfs_entry_t *entry, ramfs_entry_t *paren
 static int traverse(ramfs_t *fs, const char *path, ramfs_entry_t **entry, ramfs_entry_t **parent_entry, ramfs_entry_t **prev_entry, int creat, ramfs_entry_type_t type);
 static ramfs_off_t ramfs_file_seek_internal(ramfs_t *fs, ramfs_file_t *file, ramfs_off_t offset, ramfs_whence_t whence);
 static int ramfs_file_truncate_internal(ramfs_t *fs, ramfs_file_t *file, ramfs_off_t size);
+static ramfs_size_t release_header(ramfs_t *fs, ram_file_header_t *header);
+static int unshare_header(ramfs_t *fs, ramfs_file_t *file, int copy);
+static void sync_header(ramfs_t *fs, ramfs_file_t *file);
 
 static int add_reference(ramfs_t *fs, ramfs_entry_t *entry) {
     ramfs_entry_ref_t *cref;
@@ -247,6 +250,7 @@ static int add_entry(ramfs_t *fs, const char *name, ramfs_entry_t *parent, ramfs
         (*entry)->file.header->head = NULL;
         (*entry)->file.header->tail = NULL;
         (*entry)->file.header->size = 0;
+        (*entry)->file.header->refs = 1;
     }
 
     // Set the entry name and len
@@ -318,28 +322,123 @@ static void remove_entry(ramfs_t *fs, ramfs_entry_t *entry, ramfs_entry_t *paren
     ramfs_size_t size = sizeof(ramfs_entry_t) + ((entry->flags & RAMFS_ENTRY_NAME_LEN_MSK) >> RAMFS_ENTRY_NAME_LEN_POS) - 1;
 
     if (remove && ((entry->flags & RAMFS_ENTRY_TYPE_MSK) == RAMFS_FILE)) {
-        // Free file blocks
-        ramfs_block_t *block = entry->file.header->head;
-        ramfs_block_t *tmp;
+        // Free file blocks, if they are not shared
+        size += release_header(fs, entry->file.header);
+    }
 
-        size += sizeof(ram_file_header_t);
+    free(entry);
 
-        while (block) {
-            size += sizeof(ramfs_block_t) + fs->block_size - 1;
+    // Update the file system size
+    fs->current_size -= size;
+}
 
-            tmp = block;
-            block = block->next;
+// Release a file header. The header, and its blocks, are freed if no other
+// entry shares them. Returns the freed size.
+static ramfs_size_t release_header(ramfs_t *fs, ram_file_header_t *header) {
+    ramfs_block_t *block = header->head;
+    ramfs_block_t *tmp;
+    ramfs_size_t size;
+
+    if (--header->refs > 0) {
+        return 0;
+    }
+
+    size = sizeof(ram_file_header_t);
+
+    while (block) {
+        size += sizeof(ramfs_block_t) + fs->block_size - 1;
+
+        tmp = block;
+        block = block->next;
+
+        free(tmp);
+    }
+
+    free(header);
+
+    return size;
+}
+
+// Give the entry of a file its own header, if it is shared with other
+// entries, before modifying it. If copy is 0 the new header is empty.
+static int unshare_header(ramfs_t *fs, ramfs_file_t *file, int copy) {
+    ram_file_header_t *header = file->entry->file.header;
+    ram_file_header_t *new_header;
+    ramfs_block_t *block, *new_block, *tmp;
+    ramfs_block_t **link;
+
+    ramfs_size_t block_size = sizeof(ramfs_block_t) + fs->block_size - 1;
+    ramfs_size_t size = sizeof(ram_file_header_t);
+
+    if (header->refs <= 1) {
+        return RAMFS_ERR_OK;
+    }
+
+    // Check for space
+    if (copy) {
+        for(block = header->head;block;block = block->next) {
+            size += block_size;
+        }
+    }
+
+    if (fs->current_size + size > fs->size) {
+        return RAMFS_ERR_NOSPC;
+    }
+
+    new_header = (ram_file_header_t *)calloc(1, sizeof(ram_file_header_t));
+    if (!new_header) {
+        return RAMFS_ERR_NOMEM;
+    }
+
+    new_header->refs = 1;
+
+    if (copy) {
+        link = &new_header->head;
+
+        for(block = header->head;block;block = block->next) {
+            new_block = (ramfs_block_t *)malloc(block_size);
+            if (!new_block) {
+                while (new_header->head) {
+                    tmp = new_header->head;
+                    new_header->head = tmp->next;
+                    free(tmp);
+                }
 
-            free(tmp);
+                free(new_header);
+
+                return RAMFS_ERR_NOMEM;
+            }
+
+            memcpy(new_block, block, block_size);
+            new_block->next = NULL;
+
+            *link = new_block;
+            link = &new_block->next;
+
+            new_header->tail = new_block;
         }
 
-        free(entry->file.header);
+        new_header->size = header->size;
     }
 
-    free(entry);
+    header->refs--;
+    file->entry->file.header = new_header;
 
     // Update the file system size
-    fs->current_size -= size;
+    fs->current_size += size;
+
+    // Move the file position to the new blocks
+    ramfs_file_seek_internal(fs, file, file->offset, RAMFS_SEEK_SET);
+
+    return RAMFS_ERR_OK;
+}
+
+// Update the file position if the header of the entry changed since the
+// last operation (it was copied by other file that shared it)
+static void sync_header(ramfs_t *fs, ramfs_file_t *file) {
+    if (file->header != file->entry->file.header) {
+        ramfs_file_seek_internal(fs, file, file->offset, RAMFS_SEEK_SET);
+    }
 }
 
 static int traverse(ramfs_t *fs, const char *path, ramfs_entry_t **entry, ramfs_entry_t **parent_entry, ramfs_entry_t **prev_entry, int creat, ramfs_entry_type_t type) {
@@ -487,6 +586,8 @@ static ramfs_off_t ramfs_file_seek_internal(ramfs_t *fs, ramfs_file_t *file, ram
     int block_num = file->offset / fs->block_size;
     int block_off = file->offset % fs->block_size;
 
+    file->header = file->entry->file.header;
+
     if (file->entry->file.header->head) {
         ramfs_block_t *block = file->entry->file.header->head;
         int curr_block;
@@ -522,6 +623,13 @@ static int ramfs_file_truncate_internal(ramfs_t *fs, ramfs_file_t *file, ramfs_o
         return RAMFS_ERR_INVAL;
     }
 
+    // Only the blocks that are kept need a copy
+    if ((ret = unshare_header(fs, file, size > 0)) != RAMFS_ERR_OK) {
+        return ret;
+    }
+
+    sync_header(fs, file);
+
     int block_delta = ((size - 1) / fs->block_size) - ((file->entry->file.header->size - 1) / fs->block_size);
 
     if (block_delta < 0) {
@@ -870,6 +978,8 @@ ramfs_size_t ramfs_file_read(ramfs_t *fs, ramfs_file_t *file, void *buffer, ramf
 
     ramfs_lock(fs->lock);
 
+    sync_header(fs, file);
+
     ramfs_size_t reads = 0;
     while ((reads < size) && (file->offset < file->entry->file.header->size)) {
         if ((!file->block) || (file->ptr > file->block->data + fs->block_size - 1)) {
@@ -914,6 +1024,14 @@ ramfs_size_t ramfs_file_write(ramfs_t *fs, ramfs_file_t *file, const void *buffe
 
     ramfs_lock(fs->lock);
 
+    sync_header(fs, file);
+
+    ret = unshare_header(fs, file, 1);
+    if (ret != RAMFS_ERR_OK) {
+        ramfs_unlock(fs->lock);
+        return ret;
+    }
+
     ramfs_size_t writes = 0;
     while (writes < size) {
         if ((!file->block) || (!file->ptr) || (file->ptr > file->block->data + fs->block_size - 1)) {
@@ -1014,9 +1132,15 @@ int ramfs_rename(ramfs_t *fs, const char *oldpath, const char *newpath) {
     } else if ((old_entry->flags & RAMFS_ENTRY_TYPE_MSK) == RAMFS_DIR) {
         new_entry->dir.child = old_entry->dir.child;
     } else if ((old_entry->flags & RAMFS_ENTRY_TYPE_MSK) == RAMFS_FILE) {
-        new_entry->file.header->head = old_entry->file.header->head;
-        new_entry->file.header->tail = old_entry->file.header->tail;
-        new_entry->file.header->size = old_entry->file.header->size;
+        // Move the header of the old entry to the new entry
+        fs->current_size -= release_header(fs, new_entry->file.header);
+        new_entry->file.header = old_entry->file.header;
+
+        // If the old entry is open, it is removed on the last close, and
+        // then it releases the header
+        if (get_reference_uses(fs, old_entry) > 0) {
+            new_entry->file.header->refs++;
+        }
     }
 
     remove_entry(fs, old_entry, parent_old_entry, prev_old_entry, 0);
@@ -1086,3 +1210,45 @@ int ramfs_unlink(ramfs_t *fs, const char *pathname) {
 
     return RAMFS_ERR_OK;
 }
+
+int ramfs_copy(ramfs_t *fs, const char *src, const char *dst) {
+    ramfs_entry_t *src_entry;
+    ramfs_entry_t *dst_entry;
+    ramfs_error_t ret;
+
+    ramfs_lock(fs->lock);
+
+    ret = traverse(fs, src, &src_entry, NULL, NULL, 0, 0);
+    if (ret != RAMFS_ERR_OK) {
+        ramfs_unlock(fs->lock);
+        return ret;
+    }
+
+    if ((src_entry->flags & RAMFS_ENTRY_TYPE_MSK) != RAMFS_FILE) {
+        ramfs_unlock(fs->lock);
+        return RAMFS_ERR_ISDIR;
+    }
+
+    ret = traverse(fs, dst, &dst_entry, NULL, NULL, 1, RAMFS_FILE);
+    if ((ret != RAMFS_ERR_OK) && ((ret != RAMFS_ERR_NOENT) || !dst_entry)) {
+        ramfs_unlock(fs->lock);
+        return ret;
+    }
+
+    if ((dst_entry->flags & RAMFS_ENTRY_TYPE_MSK) != RAMFS_FILE) {
+        ramfs_unlock(fs->lock);
+        return RAMFS_ERR_ISDIR;
+    }
+
+    // Share the header of the source file with the destination file
+    if (dst_entry->file.header != src_entry->file.header) {
+        fs->current_size -= release_header(fs, dst_entry->file.header);
+
+        dst_entry->file.header = src_entry->file.header;
+        dst_entry->file.header->refs++;
+    }
+
+    ramfs_unlock(fs->lock);
+
+    return RAMFS_ERR_OK;
+}
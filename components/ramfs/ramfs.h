@@ -77,6 +77,11 @@
  *                               ---------  next  ---------
  *                               - block -  ----> - block -
  *                               ---------        ---------
+ *
+ * A copy of a file shares the file header (and its blocks) with the
+ * original file, so copying a file doesn't use more space. The first
+ * write or truncate on any of them gives it its own header, with a
+ * copy of the blocks (copy on write).
  */
 
 #ifndef _RAMFS_H_
@@ -193,6 +198,7 @@ typedef struct ram_file_header {
     ramfs_block_t *head; /*!< File head */
     ramfs_block_t *tail; /*!< File tail */
     ramfs_size_t  size;  /*!< File size */
+    uint32_t refs;       /*!< Entries that share the header (copies) */
 } ram_file_header_t;
 
 typedef struct ramfs_entry {
@@ -221,6 +227,7 @@ typedef struct {
     ramfs_off_t offset;   /*!< Current seek offset */
     ramfs_block_t *block; /*!< Current read/write block */
     uint8_t *ptr;         /*!< Current read/write pointer into current block */
+    ram_file_header_t *header; /*!< Header that block and ptr belong to */
 } ramfs_file_t;
 
 typedef struct {
@@ -270,5 +277,6 @@ int ramfs_unlink(ramfs_t *fs, const char *pathname);
 ramfs_off_t ramfs_telldir(ramfs_t *fs, ramfs_dir_t *dir);
 int ramfs_file_truncate(ramfs_t *fs, ramfs_file_t *file, ramfs_off_t size);
 int ramfs_file_stat(ramfs_t *fs, ramfs_file_t *file, ramfs_info_t *info);
+int ramfs_copy(ramfs_t *fs, const char *src, const char *dst);
 
 #endif /* _RAMFS_H_ */
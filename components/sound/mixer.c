@@ -0,0 +1,319 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, audio mixer
+ *
+ */
+
+#include "mixer.h"
+
+#include <string.h>
+
+#include <esp_attr.h>
+
+/*
+ * Helper functions
+ */
+static int alloc_voice(mixer_t *mixer) {
+	int i;
+
+	for(i = 0; i < MIXER_MAX_VOICES; i++) {
+		if (mixer->voices[i].type == MixerVoiceFree) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+static void end_voice(mixer_voice_t *voice) {
+	voice->type = MixerVoiceFree;
+
+	if (voice->done) {
+		voice->done(voice->done_arg);
+	}
+}
+
+// Get the next input sample of a PCM voice. Returns 1 if a sample was read,
+// 0 on underrun, and -1 at the end of the stream.
+static inline int pcm_fetch(mixer_voice_t *voice, int32_t *sample) {
+	if (voice->pos >= voice->len) {
+		int len = voice->read(voice->read_arg, voice->buff, MIXER_VOICE_BUFF_LEN);
+		if (len <= 0) {
+			return len;
+		}
+
+		voice->len = len;
+		voice->pos = 0;
+	}
+
+	*sample = voice->buff[voice->pos++];
+
+	return 1;
+}
+
+// Mix a tone voice into the accumulator. Returns 0 when the voice ends.
+static int IRAM_ATTR mix_tone(mixer_t *mixer, mixer_voice_t *voice, uint32_t samples) {
+	uint32_t done = 0;
+	uint32_t chunk;
+	uint32_t i;
+
+	while (done < samples) {
+		if (voice->remaining == 0) {
+			if (voice->tail) {
+				return 0;
+			}
+
+			voice->remaining = wavetable_samples_to_period_end(&voice->osc);
+			voice->tail = 1;
+
+			continue;
+		}
+
+		chunk = samples - done;
+		if (chunk > voice->remaining) {
+			chunk = voice->remaining;
+		}
+
+		wavetable_render(&voice->osc, mixer->scratch, chunk);
+
+		for(i = 0; i < chunk; i++) {
+			mixer->acc[done + i] += mixer->scratch[i];
+		}
+
+		voice->remaining -= chunk;
+		done += chunk;
+	}
+
+	return 1;
+}
+
+// Mix a PCM voice into the accumulator. Returns 0 when the voice ends.
+static int IRAM_ATTR mix_pcm(mixer_t *mixer, mixer_voice_t *voice, uint32_t samples) {
+	int32_t sample;
+	uint32_t i;
+	int rc;
+
+	for(i = 0; i < samples; i++) {
+		// Advance the input until the output position is between s0 and s1
+		while (voice->frac >= 0x10000) {
+			if (voice->eof) {
+				return 0;
+			}
+
+			rc = pcm_fetch(voice, &sample);
+			if (rc < 0) {
+				// Output the last sample before ending
+				voice->eof = 1;
+				sample = voice->s1;
+			} else if (rc == 0) {
+				break;
+			}
+
+			voice->s0 = voice->s1;
+			voice->s1 = sample;
+			voice->frac -= 0x10000;
+		}
+
+		if (voice->frac >= 0x10000) {
+			// Underrun, hold the last sample
+			mixer->underruns++;
+			sample = voice->s1;
+		} else {
+			// (s1 - s0) fits in 17 bits, and frac is used in Q15, so the
+			// product fits in 32 bits
+			sample = voice->s0 + (((voice->s1 - voice->s0) * (int32_t)(voice->frac >> 1)) >> 15);
+			voice->frac += voice->step;
+		}
+
+		mixer->acc[i] += (sample * voice->gain) >> 15;
+	}
+
+	return 1;
+}
+
+static void IRAM_ATTR mix(mixer_t *mixer, uint32_t samples) {
+	mixer_voice_t *voice;
+	int active;
+	int i;
+
+	memset(mixer->acc, 0, samples * sizeof(int32_t));
+
+	for(i = 0; i < MIXER_MAX_VOICES; i++) {
+		voice = &mixer->voices[i];
+
+		if (voice->type == MixerVoiceTone) {
+			active = mix_tone(mixer, voice, samples);
+		} else if (voice->type == MixerVoicePCM) {
+			active = mix_pcm(mixer, voice, samples);
+		} else {
+			continue;
+		}
+
+		if (!active) {
+			end_voice(voice);
+		}
+	}
+}
+
+static inline int16_t saturate(int32_t sample) {
+	if (sample > 32767) {
+		return 32767;
+	} else if (sample < -32768) {
+		return -32768;
+	}
+
+	return (int16_t)sample;
+}
+
+/*
+ * Operation functions
+ */
+void mixer_init(mixer_t *mixer, uint32_t sample_rate) {
+	memset(mixer, 0, sizeof(mixer_t));
+
+	mixer->sample_rate = sample_rate;
+}
+
+int mixer_add_tone(mixer_t *mixer, uint32_t freq, uint32_t duration, int32_t amp, mixer_done_t done, void *done_arg) {
+	int i = alloc_voice(mixer);
+	if (i < 0) {
+		return -1;
+	}
+
+	mixer_voice_t *voice = &mixer->voices[i];
+
+	wavetable_init(&voice->osc, freq, mixer->sample_rate, amp);
+
+	voice->remaining = (uint32_t)(((uint64_t)duration * mixer->sample_rate) / 1000);
+	voice->tail = 0;
+	voice->done = done;
+	voice->done_arg = done_arg;
+	voice->type = MixerVoiceTone;
+
+	return i;
+}
+
+int mixer_add_pcm(mixer_t *mixer, uint32_t sample_rate, mixer_read_t read, void *read_arg, int32_t gain, mixer_done_t done, void *done_arg) {
+	int i = alloc_voice(mixer);
+	if (i < 0) {
+		return -1;
+	}
+
+	mixer_voice_t *voice = &mixer->voices[i];
+
+	voice->read = read;
+	voice->read_arg = read_arg;
+	voice->gain = gain;
+	voice->step = (uint32_t)((((uint64_t)sample_rate << 16) + (mixer->sample_rate >> 1)) / mixer->sample_rate);
+
+	// Fetch the first two samples before the first output sample
+	voice->frac = 0x20000;
+	voice->s0 = 0;
+	voice->s1 = 0;
+	voice->pos = 0;
+	voice->len = 0;
+	voice->eof = 0;
+
+	voice->done = done;
+	voice->done_arg = done_arg;
+	voice->type = MixerVoicePCM;
+
+	return i;
+}
+
+void mixer_stop(mixer_t *mixer, int voice) {
+	if ((voice < 0) || (voice >= MIXER_MAX_VOICES)) {
+		return;
+	}
+
+	if (mixer->voices[voice].type != MixerVoiceFree) {
+		end_voice(&mixer->voices[voice]);
+	}
+}
+
+int mixer_active(mixer_t *mixer) {
+	int active = 0;
+	int i;
+
+	for(i = 0; i < MIXER_MAX_VOICES; i++) {
+		if (mixer->voices[i].type != MixerVoiceFree) {
+			active++;
+		}
+	}
+
+	return active;
+}
+
+void IRAM_ATTR mixer_render(mixer_t *mixer, int16_t *out, uint32_t samples) {
+	uint32_t chunk;
+	uint32_t i;
+
+	while (samples > 0) {
+		chunk = (samples > MIXER_BLOCK_LEN)?MIXER_BLOCK_LEN:samples;
+
+		mix(mixer, chunk);
+
+		for(i = 0; i < chunk; i++) {
+			*out++ = saturate(mixer->acc[i]);
+		}
+
+		samples -= chunk;
+	}
+}
+
+void IRAM_ATTR mixer_render_dac(mixer_t *mixer, uint8_t *out, uint32_t samples) {
+	uint32_t chunk;
+	uint32_t i;
+
+	while (samples > 0) {
+		chunk = (samples > MIXER_BLOCK_LEN)?MIXER_BLOCK_LEN:samples;
+
+		mix(mixer, chunk);
+
+		for(i = 0; i < chunk; i++) {
+			*out++ = 0;
+			*out++ = (uint8_t)(128 + (saturate(mixer->acc[i]) >> 8));
+		}
+
+		samples -= chunk;
+	}
+}
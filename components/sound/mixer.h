@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, audio mixer
+ *
+ */
+
+#ifndef _SOUND_MIXER_H_
+#define _SOUND_MIXER_H_
+
+#include <stdint.h>
+
+#include <sound/wavetable.h>
+
+/*
+ * N-voice audio mixer.
+ *
+ * Each voice is a tone, generated by a wavetable oscillator, or a PCM
+ * stream, that is pulled from a read function and resampled to the mixer
+ * sample rate with linear interpolation. Voices are mixed in a 32-bit
+ * accumulator, and the result is saturated to 16 bits, so that overlapping
+ * voices clip instead of wrapping around.
+ *
+ * The mixer is not thread safe, the caller must serialize the calls.
+ */
+
+#define MIXER_MAX_VOICES    4
+
+// Samples rendered in each pass of the mixer
+#define MIXER_BLOCK_LEN     128
+
+// Samples buffered for each PCM voice
+#define MIXER_VOICE_BUFF_LEN 128
+
+/**
+ * @brief Function used by a PCM voice to get samples.
+ *
+ * @return Number of samples copied to buf, 0 if there are no samples
+ *         available yet (underrun), or -1 at the end of the stream.
+ */
+typedef int (*mixer_read_t)(void *arg, int16_t *buf, uint32_t samples);
+
+/**
+ * @brief Function called, from mixer_render or mixer_stop, when a voice ends.
+ */
+typedef void (*mixer_done_t)(void *arg);
+
+typedef enum {
+	MixerVoiceFree = 0,
+	MixerVoiceTone,
+	MixerVoicePCM
+} mixer_voice_type_t;
+
+typedef struct {
+	mixer_voice_type_t type;
+	mixer_done_t done;
+	void *done_arg;
+
+	// Tone
+	wavetable_osc_t osc;
+	uint32_t remaining;    ///< Samples to render before completing the period
+	uint8_t tail;          ///< Completing the last period
+
+	// PCM
+	mixer_read_t read;
+	void *read_arg;
+	int32_t gain;          ///< Q15
+	uint32_t step;         ///< Input samples per output sample, in 16.16
+	uint32_t frac;         ///< Position between s0 and s1, in 16.16
+	int32_t s0, s1;        ///< Samples to interpolate
+	uint32_t pos, len;     ///< Position and length of buff
+	uint8_t eof;           ///< End of stream reached
+	int16_t buff[MIXER_VOICE_BUFF_LEN];
+} mixer_voice_t;
+
+typedef struct {
+	uint32_t sample_rate;
+	uint32_t underruns;    ///< PCM samples that weren't available in time
+	mixer_voice_t voices[MIXER_MAX_VOICES];
+	int32_t acc[MIXER_BLOCK_LEN];
+	int16_t scratch[MIXER_BLOCK_LEN];
+} mixer_t;
+
+void mixer_init(mixer_t *mixer, uint32_t sample_rate);
+
+/**
+ * @brief Add a tone voice. The tone is extended to end at a period boundary.
+ *
+ * @return Voice number, or -1 if there are no free voices.
+ */
+int mixer_add_tone(mixer_t *mixer, uint32_t freq, uint32_t duration, int32_t amp, mixer_done_t done, void *done_arg);
+
+/**
+ * @brief Add a PCM voice.
+ *
+ * @param sample_rate Sample rate of the stream.
+ * @param read Function used to get the samples of the stream.
+ * @param gain Gain, in Q15.
+ *
+ * @return Voice number, or -1 if there are no free voices.
+ */
+int mixer_add_pcm(mixer_t *mixer, uint32_t sample_rate, mixer_read_t read, void *read_arg, int32_t gain, mixer_done_t done, void *done_arg);
+
+/**
+ * @brief Stop a voice. The done function of the voice is called.
+ */
+void mixer_stop(mixer_t *mixer, int voice);
+
+/**
+ * @brief Get the number of active voices.
+ */
+int mixer_active(mixer_t *mixer);
+
+/**
+ * @brief Render samples, in Q15.
+ */
+void mixer_render(mixer_t *mixer, int16_t *out, uint32_t samples);
+
+/**
+ * @brief Render samples in the format expected by the I2S built-in DAC (see
+ *        wavetable_render_dac).
+ */
+void mixer_render_dac(mixer_t *mixer, uint8_t *out, uint32_t samples);
+
+#endif /* _SOUND_MIXER_H_ */
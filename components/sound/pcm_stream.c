@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, PCM file streaming
+ *
+ */
+
+#include "sound.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <esp_attr.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+#include <sound/pcm_stream.h>
+
+/*
+ * Helper functions
+ */
+static int file_read(void *arg, void *buf, uint32_t len) {
+	return (fread(buf, 1, len, (FILE *)arg) == len)?0:-1;
+}
+
+// Read the next block from the file, only whole frames are read
+static void fill(pcm_stream_t *stream, int idx) {
+	uint32_t len = PCM_STREAM_BLOCK_LEN - (PCM_STREAM_BLOCK_LEN % stream->info.block_align);
+	size_t bytes;
+
+	if (len > stream->remaining) {
+		len = stream->remaining;
+	}
+
+	bytes = fread(stream->block[idx], 1, len, stream->fp);
+	bytes -= bytes % stream->info.block_align;
+
+	stream->remaining -= bytes;
+	stream->len[idx] = bytes;
+}
+
+static void destroy(pcm_stream_t *stream) {
+	if (stream->fp) fclose(stream->fp);
+	if (stream->block[0]) free(stream->block[0]);
+	if (stream->block[1]) free(stream->block[1]);
+	if (stream->free) vQueueDelete(stream->free);
+	if (stream->full) vQueueDelete(stream->full);
+
+	free(stream);
+}
+
+static void pcm_stream_task(void *arg) {
+	pcm_stream_t *stream = (pcm_stream_t *)arg;
+	int idx;
+
+	for(;;) {
+		xQueueReceive(stream->free, &idx, portMAX_DELAY);
+		if (stream->stop) {
+			break;
+		}
+
+		fill(stream, idx);
+		xQueueSend(stream->full, &idx, portMAX_DELAY);
+	}
+
+	destroy(stream);
+	vTaskDelete(NULL);
+}
+
+/*
+ * Operation functions
+ */
+driver_error_t *pcm_stream_open(const char *path, const wav_info_t *raw, pcm_stream_t **stream) {
+	pcm_stream_t *s;
+	int idx;
+
+	s = calloc(1, sizeof(pcm_stream_t));
+	if (!s) {
+		return driver_error(SOUND_DRIVER, SOUND_ERR_NOT_ENOUGH_MEMORY, NULL);
+	}
+
+	s->cur = -1;
+
+	s->fp = fopen(path, "r");
+	if (!s->fp) {
+		destroy(s);
+		return driver_error(SOUND_DRIVER, SOUND_ERR_INVALID_FILE, "can't open");
+	}
+
+	if (raw) {
+		s->info = *raw;
+	} else {
+		int rc = wav_parse(file_read, s->fp, &s->info);
+		if (rc) {
+			destroy(s);
+			return driver_error(SOUND_DRIVER, SOUND_ERR_INVALID_FILE, (rc == WAV_ERR_NOT_SUPPORTED)?"format not supported":"not a wav file");
+		}
+	}
+
+	s->remaining = s->info.data_len;
+
+	s->block[0] = malloc(PCM_STREAM_BLOCK_LEN);
+	s->block[1] = malloc(PCM_STREAM_BLOCK_LEN);
+
+	// The free queue must fit both blocks plus the stop wake up
+	s->free = xQueueCreate(3, sizeof(int));
+	s->full = xQueueCreate(2, sizeof(int));
+
+	if (!s->block[0] || !s->block[1] || !s->free || !s->full) {
+		destroy(s);
+		return driver_error(SOUND_DRIVER, SOUND_ERR_NOT_ENOUGH_MEMORY, NULL);
+	}
+
+	// Read the first block now, so that the playback doesn't start with an
+	// underrun, and let the reader task fill the second one
+	idx = 0;
+	fill(s, idx);
+	xQueueSend(s->full, &idx, 0);
+
+	idx = 1;
+	xQueueSend(s->free, &idx, 0);
+
+	BaseType_t xReturn = xTaskCreatePinnedToCore(pcm_stream_task, "pcm", PCM_STREAM_TASK_STACK_SIZE, s, PCM_STREAM_TASK_PRIORITY, &s->task, xPortGetCoreID());
+	if (xReturn != pdPASS) {
+		destroy(s);
+		return driver_error(SOUND_DRIVER, SOUND_ERR_NOT_ENOUGH_MEMORY, NULL);
+	}
+
+	*stream = s;
+
+	return NULL;
+}
+
+int IRAM_ATTR pcm_stream_read(void *arg, int16_t *buf, uint32_t samples) {
+	pcm_stream_t *stream = (pcm_stream_t *)arg;
+	uint32_t frames;
+
+	if (stream->cur < 0) {
+		if (xQueueReceive(stream->full, &stream->cur, 0) != pdTRUE) {
+			// Reader is late
+			stream->cur = -1;
+			return 0;
+		}
+
+		stream->pos = 0;
+	}
+
+	if (stream->len[stream->cur] == 0) {
+		// End of stream, keep the block, so that following calls also
+		// return the end of stream
+		return -1;
+	}
+
+	frames = (stream->len[stream->cur] - stream->pos) / stream->info.block_align;
+	if (frames > samples) {
+		frames = samples;
+	}
+
+	wav_decode(&stream->info, stream->block[stream->cur] + stream->pos, frames, buf);
+	stream->pos += frames * stream->info.block_align;
+
+	if (stream->pos >= stream->len[stream->cur]) {
+		xQueueSend(stream->free, &stream->cur, 0);
+		stream->cur = -1;
+	}
+
+	return frames;
+}
+
+void pcm_stream_close(void *arg) {
+	pcm_stream_t *stream = (pcm_stream_t *)arg;
+	int idx = -1;
+
+	// Wake up the reader task, that releases the stream
+	stream->stop = 1;
+	xQueueSend(stream->free, &idx, 0);
+}
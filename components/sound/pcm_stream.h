@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, PCM file streaming
+ *
+ */
+
+#ifndef _SOUND_PCM_STREAM_H_
+#define _SOUND_PCM_STREAM_H_
+
+#include "sdkconfig.h"
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+#include <sound/wav.h>
+
+#include <sys/driver.h>
+
+/*
+ * A PCM stream reads a WAV / raw PCM file in large blocks from a background
+ * task, using two blocks: while one block is being consumed by the mixer,
+ * the other one is being read from the file.
+ *
+ * pcm_stream_read and pcm_stream_close are meant to be used as the read and
+ * done functions of a mixer PCM voice. Once closed, the stream is released by
+ * the reader task.
+ */
+
+// Bytes read from the file in each read
+#define PCM_STREAM_BLOCK_LEN        4096
+
+#define PCM_STREAM_TASK_STACK_SIZE  2048
+#define PCM_STREAM_TASK_PRIORITY    (CONFIG_LUA_RTOS_LUA_THREAD_PRIORITY + 1)
+
+typedef struct {
+	FILE *fp;
+	wav_info_t info;
+	uint32_t remaining;       ///< Data bytes not read yet from the file
+	uint8_t *block[2];
+	uint32_t len[2];          ///< Bytes in block, 0 means end of stream
+	QueueHandle_t free;       ///< Blocks that can be filled
+	QueueHandle_t full;       ///< Blocks that can be consumed
+	TaskHandle_t task;
+	int cur;                  ///< Block being consumed, or -1
+	uint32_t pos;             ///< Position in the block being consumed
+	volatile uint8_t stop;
+} pcm_stream_t;
+
+/**
+ * @brief Open a stream.
+ *
+ * @param path File path.
+ * @param raw If NULL the file is parsed as a WAV file, otherwise the file is
+ *            raw PCM data with this format.
+ * @param stream Opened stream.
+ *
+ * @return
+ *     - NULL success
+ *     - Pointer to driver_error_t if some error occurs.
+ *
+ *     SOUND_ERR_INVALID_FILE
+ *     SOUND_ERR_NOT_ENOUGH_MEMORY
+ */
+driver_error_t *pcm_stream_open(const char *path, const wav_info_t *raw, pcm_stream_t **stream);
+
+int pcm_stream_read(void *arg, int16_t *buf, uint32_t samples);
+void pcm_stream_close(void *arg);
+
+#endif /* _SOUND_PCM_STREAM_H_ */
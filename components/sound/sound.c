@@ -52,8 +52,6 @@
 
 #include <sys/driver.h>
 
-#include <sys/delay.h>
-
 DRIVER_REGISTER_BEGIN(SOUND,sound,0,NULL,NULL);
 	DRIVER_REGISTER_ERROR(SOUND, sound, NoToneGen, "tone generator not setup", SOUND_ERR_NO_TONE_GEN);
 	DRIVER_REGISTER_ERROR(SOUND, sound, InvalidToneGen, "invalid tone generator", SOUND_ERR_INVALID_TONE_GEN);
@@ -63,6 +61,9 @@ DRIVER_REGISTER_BEGIN(SOUND,sound,0,NULL,NULL);
 	DRIVER_REGISTER_ERROR(SOUND, sound, InvalidVolume, "invalid volume", SOUND_ERR_NO_INVALID_VOLUME);
 	DRIVER_REGISTER_ERROR(SOUND, sound, InvalidSampleRate, "invalid sample rate", SOUND_ERR_INVALID_SAMPLE_RATE);
 	DRIVER_REGISTER_ERROR(SOUND, sound, InvalidDacDevice, "invalid dac device", SOUND_ERR_INVALID_DAC_DEVICE);
+	DRIVER_REGISTER_ERROR(SOUND, sound, InvalidFile, "invalid file", SOUND_ERR_INVALID_FILE);
+	DRIVER_REGISTER_ERROR(SOUND, sound, NotSupported, "not supported by tone generator", SOUND_ERR_NOT_SUPPORTED);
+	DRIVER_REGISTER_ERROR(SOUND, sound, NoFreeVoices, "no free voices", SOUND_ERR_NO_FREE_VOICES);
 DRIVER_REGISTER_END(SOUND,sound,0,NULL,NULL);
 
 static int whole_duration;
@@ -176,10 +177,10 @@ driver_error_t *sound_music_tone(int frequency, int duration, tone_gen_device_h_
 	return NULL;
 }
 
-driver_error_t *sound_music_silence(char *duration, tone_gen_device_h_t *h) {
-	int _duration = music_note_duration(duration);
-
-	delay(_duration);
+driver_error_t *sound_music_wait(tone_gen_device_h_t *h) {
+	return tone_wait(h);
+}
 
-	return NULL;
+driver_error_t *sound_music_silence(char *duration, tone_gen_device_h_t *h) {
+	return tone_silence(h, music_note_duration(duration));
 }
@@ -54,6 +54,7 @@ void sound_music_time_signature(int upper, int lower, int bps);
 driver_error_t *sound_music_note(char *note, int octave, tone_gen_device_h_t *h);
 driver_error_t *sound_music_tone(int frequency, int duration, tone_gen_device_h_t *h);
 driver_error_t *sound_music_silence(char *duration, tone_gen_device_h_t *h);
+driver_error_t *sound_music_wait(tone_gen_device_h_t *h);
 
 
 //  Driver errors
@@ -65,6 +66,9 @@ driver_error_t *sound_music_silence(char *duration, tone_gen_device_h_t *h);
 #define SOUND_ERR_NO_INVALID_VOLUME        (DRIVER_EXCEPTION_BASE(SOUND_DRIVER_ID) |  6)
 #define SOUND_ERR_INVALID_SAMPLE_RATE      (DRIVER_EXCEPTION_BASE(SOUND_DRIVER_ID) |  7)
 #define SOUND_ERR_INVALID_DAC_DEVICE       (DRIVER_EXCEPTION_BASE(SOUND_DRIVER_ID) |  8)
+#define SOUND_ERR_INVALID_FILE             (DRIVER_EXCEPTION_BASE(SOUND_DRIVER_ID) |  9)
+#define SOUND_ERR_NOT_SUPPORTED            (DRIVER_EXCEPTION_BASE(SOUND_DRIVER_ID) |  10)
+#define SOUND_ERR_NO_FREE_VOICES           (DRIVER_EXCEPTION_BASE(SOUND_DRIVER_ID) |  11)
 
 extern const int sound_errors;
 extern const int sound_error_map;
@@ -0,0 +1,387 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, audio mixer and WAV parser test cases
+ *
+ * The WAV parser is tested against headers built in memory, and the mixer
+ * output is compared against reference buffers computed in the test. The
+ * mixer throughput with all the voices active is also reported.
+ *
+ */
+
+#include "unity.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <sound/mixer.h>
+#include <sound/wav.h>
+
+#define SAMPLE_RATE 38000
+
+typedef struct {
+	const uint8_t *data;
+	uint32_t len;
+	uint32_t pos;
+} mem_source_t;
+
+typedef struct {
+	const int16_t *data;
+	uint32_t len;
+	uint32_t pos;
+	uint32_t chunk;     ///< Maximum samples returned in each read
+	uint32_t starve;    ///< Number of reads that return an underrun
+} pcm_source_t;
+
+static uint64_t now() {
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+
+	return ((uint64_t)tv.tv_sec * 1000000) + tv.tv_usec;
+}
+
+static int mem_read(void *arg, void *buf, uint32_t len) {
+	mem_source_t *src = (mem_source_t *)arg;
+
+	if (src->pos + len > src->len) {
+		return -1;
+	}
+
+	memcpy(buf, src->data + src->pos, len);
+	src->pos += len;
+
+	return 0;
+}
+
+static int pcm_read(void *arg, int16_t *buf, uint32_t samples) {
+	pcm_source_t *src = (pcm_source_t *)arg;
+	uint32_t len;
+
+	if (src->starve > 0) {
+		src->starve--;
+		return 0;
+	}
+
+	if (src->pos >= src->len) {
+		return -1;
+	}
+
+	len = src->len - src->pos;
+	if (len > samples) len = samples;
+	if (src->chunk && (len > src->chunk)) len = src->chunk;
+
+	memcpy(buf, src->data + src->pos, len * sizeof(int16_t));
+	src->pos += len;
+
+	return len;
+}
+
+static void count_done(void *arg) {
+	(*(int *)arg)++;
+}
+
+static uint32_t put_chunk(uint8_t *buf, const char *id, uint32_t len) {
+	memcpy(buf, id, 4);
+	buf[4] = len; buf[5] = len >> 8; buf[6] = len >> 16; buf[7] = len >> 24;
+
+	return 8;
+}
+
+static uint32_t build_wav(uint8_t *buf, uint16_t format, uint16_t channels, uint32_t rate, uint16_t bits, uint32_t data_len) {
+	uint16_t align = channels * (bits / 8);
+	uint32_t byte_rate = rate * align;
+	uint32_t p = 0;
+
+	p += put_chunk(buf + p, "RIFF", 0);
+	memcpy(buf + p, "WAVE", 4); p += 4;
+
+	// Unknown chunk with odd length, must be skipped with its pad byte
+	p += put_chunk(buf + p, "LIST", 3);
+	memcpy(buf + p, "abc\0", 4); p += 4;
+
+	p += put_chunk(buf + p, "fmt ", 16);
+	buf[p++] = format; buf[p++] = format >> 8;
+	buf[p++] = channels; buf[p++] = 0;
+	memcpy(buf + p, &rate, 4); p += 4;
+	memcpy(buf + p, &byte_rate, 4); p += 4;
+	buf[p++] = align; buf[p++] = 0;
+	buf[p++] = bits; buf[p++] = 0;
+
+	p += put_chunk(buf + p, "data", data_len);
+
+	return p;
+}
+
+TEST_CASE("wav header parsing", "[sound]") {
+	uint8_t buf[128];
+	mem_source_t src;
+	wav_info_t info;
+
+	src.data = buf; src.pos = 0;
+	src.len = build_wav(buf, 1, 2, 22050, 16, 4000);
+
+	TEST_ASSERT_EQUAL(0, wav_parse(mem_read, &src, &info));
+	TEST_ASSERT_EQUAL(22050, info.sample_rate);
+	TEST_ASSERT_EQUAL(2, info.channels);
+	TEST_ASSERT_EQUAL(16, info.bits);
+	TEST_ASSERT_EQUAL(4, info.block_align);
+	TEST_ASSERT_EQUAL(4000, info.data_len);
+	TEST_ASSERT_EQUAL(src.len, src.pos);
+
+	// Compressed formats are not supported
+	src.pos = 0;
+	src.len = build_wav(buf, 2, 1, 8000, 16, 100);
+	TEST_ASSERT_EQUAL(WAV_ERR_NOT_SUPPORTED, wav_parse(mem_read, &src, &info));
+
+	// Not a WAV file
+	src.pos = 0;
+	src.len = build_wav(buf, 1, 1, 8000, 8, 100);
+	memcpy(buf + 8, "AVI ", 4);
+	TEST_ASSERT_EQUAL(WAV_ERR_FORMAT, wav_parse(mem_read, &src, &info));
+
+	// Truncated header
+	src.pos = 0;
+	src.len = 30;
+	memcpy(buf + 8, "WAVE", 4);
+	TEST_ASSERT(wav_parse(mem_read, &src, &info) < 0);
+}
+
+TEST_CASE("wav decoding", "[sound]") {
+	static const uint8_t u8_mono[] = {0, 128, 255};
+	static const uint8_t u8_stereo[] = {0, 255, 200, 200};
+	static const uint8_t s16_stereo[] = {0x00, 0x80, 0xff, 0x7f, 0x10, 0x00, 0x30, 0x00};
+	wav_info_t info;
+	int16_t out[4];
+
+	wav_raw(&info, 8000, 1, 8);
+	wav_decode(&info, u8_mono, 3, out);
+	TEST_ASSERT_EQUAL(-32768, out[0]);
+	TEST_ASSERT_EQUAL(0, out[1]);
+	TEST_ASSERT_EQUAL(32512, out[2]);
+
+	wav_raw(&info, 8000, 2, 8);
+	wav_decode(&info, u8_stereo, 2, out);
+	TEST_ASSERT_EQUAL(-128, out[0]);
+	TEST_ASSERT_EQUAL(72 * 256, out[1]);
+
+	wav_raw(&info, 8000, 2, 16);
+	wav_decode(&info, s16_stereo, 2, out);
+	TEST_ASSERT_EQUAL(-1, out[0]);
+	TEST_ASSERT_EQUAL(0x20, out[1]);
+
+	TEST_ASSERT_EQUAL(WAV_ERR_NOT_SUPPORTED, wav_raw(&info, 8000, 3, 16));
+	TEST_ASSERT_EQUAL(WAV_ERR_NOT_SUPPORTED, wav_raw(&info, 8000, 1, 24));
+}
+
+TEST_CASE("mixer saturates overlapping voices", "[sound]") {
+	static int16_t loud[1000];
+	static int16_t out[1000];
+	pcm_source_t src[2];
+	mixer_t *mixer = malloc(sizeof(mixer_t));
+	int done = 0;
+	int i;
+
+	TEST_ASSERT(mixer != NULL);
+
+	for(i = 0; i < 1000; i++) {
+		loud[i] = (i & 1)?30000:-30000;
+	}
+
+	mixer_init(mixer, SAMPLE_RATE);
+
+	// Same rate, so the output must be the input, added and saturated
+	for(i = 0; i < 2; i++) {
+		memset(&src[i], 0, sizeof(pcm_source_t));
+		src[i].data = loud; src[i].len = 1000; src[i].chunk = 37;
+
+		TEST_ASSERT(mixer_add_pcm(mixer, SAMPLE_RATE, pcm_read, &src[i], 32767, count_done, &done) >= 0);
+	}
+
+	mixer_render(mixer, out, 1000);
+
+	for(i = 0; i < 1000; i++) {
+		int32_t expected = 2 * ((loud[i] * 32767) >> 15);
+
+		if (expected > 32767) expected = 32767;
+		if (expected < -32768) expected = -32768;
+
+		TEST_ASSERT_EQUAL(expected, out[i]);
+	}
+
+	// Voices end on the next render, and output is silence
+	TEST_ASSERT_EQUAL(2, mixer_active(mixer));
+	mixer_render(mixer, out, 10);
+	TEST_ASSERT_EQUAL(0, mixer_active(mixer));
+	TEST_ASSERT_EQUAL(2, done);
+	TEST_ASSERT_EQUAL(0, out[0]);
+
+	free(mixer);
+}
+
+TEST_CASE("mixer resamples and mixes tones", "[sound]") {
+	static int16_t ramp[2000];
+	static int16_t out[4000];
+	pcm_source_t src;
+	mixer_t *mixer = malloc(sizeof(mixer_t));
+	int done = 0;
+	int voices;
+	int i;
+
+	TEST_ASSERT(mixer != NULL);
+
+	for(i = 0; i < 2000; i++) {
+		ramp[i] = i * 10;
+	}
+
+	// Half the mixer rate, so each output sample is the input interpolated
+	// at i / 2
+	mixer_init(mixer, SAMPLE_RATE);
+
+	memset(&src, 0, sizeof(src));
+	src.data = ramp; src.len = 2000; src.chunk = 100;
+	TEST_ASSERT(mixer_add_pcm(mixer, SAMPLE_RATE / 2, pcm_read, &src, 32767, count_done, &done) >= 0);
+
+	mixer_render(mixer, out, 3990);
+
+	for(i = 0; i < 3990; i++) {
+		int32_t expected = ((i * 5) * 32767) >> 15;
+
+		TEST_ASSERT(abs(out[i] - expected) <= 1);
+	}
+
+	mixer_render(mixer, out, 20);
+	TEST_ASSERT_EQUAL(1, done);
+
+	// Underruns hold the last sample, and doesn't lose input samples
+	memset(&src, 0, sizeof(src));
+	src.data = ramp; src.len = 2000; src.chunk = 100; src.starve = 0;
+	mixer_add_pcm(mixer, SAMPLE_RATE, pcm_read, &src, 32767, count_done, &done);
+	mixer_render(mixer, out, 150);
+	src.starve = 5;
+	mixer_render(mixer, out + 150, 1850 + 5);
+	TEST_ASSERT_EQUAL(5, mixer->underruns);
+	TEST_ASSERT_EQUAL((1999 * 10 * 32767) >> 15, out[1850 + 5 + 150 - 1]);
+
+	mixer_render(mixer, out, 10);
+	TEST_ASSERT_EQUAL(2, done);
+
+	// Tones mixed with a stream
+	mixer_add_tone(mixer, 440, 100, WAVETABLE_FULL_SCALE / 2, count_done, &done);
+	memset(&src, 0, sizeof(src));
+	src.data = ramp; src.len = 2000;
+	mixer_add_pcm(mixer, SAMPLE_RATE, pcm_read, &src, 32767, count_done, &done);
+
+	// No more than MIXER_MAX_VOICES
+	for(voices = 2; voices < MIXER_MAX_VOICES; voices++) {
+		TEST_ASSERT(mixer_add_tone(mixer, 1000, 10, 1000, NULL, NULL) >= 0);
+	}
+
+	TEST_ASSERT_EQUAL(-1, mixer_add_tone(mixer, 1000, 10, 1000, NULL, NULL));
+
+	for(i = 2; i < MIXER_MAX_VOICES; i++) {
+		mixer_stop(mixer, i);
+	}
+
+	mixer_render(mixer, out, 2000);
+
+	for(i = 0; i < 2000; i++) {
+		double tone = 16383.0 * sin(1.5 * M_PI + (2.0 * M_PI * 440 * i) / SAMPLE_RATE);
+		double expected = tone + ((ramp[i] * 32767) >> 15);
+
+		if (expected > 32767) {
+			expected = 32767;
+		}
+
+		TEST_ASSERT(fabs(out[i] - expected) < 8);
+	}
+
+	free(mixer);
+}
+
+TEST_CASE("mixer throughput", "[sound]") {
+	static int16_t data[SAMPLE_RATE];
+	static int16_t out[1024];
+	pcm_source_t src[MIXER_MAX_VOICES];
+	mixer_t *mixer = malloc(sizeof(mixer_t));
+	uint64_t begin, end;
+	uint32_t total = 0;
+	int i;
+
+	TEST_ASSERT(mixer != NULL);
+
+	for(i = 0; i < SAMPLE_RATE; i++) {
+		data[i] = (int16_t)(10000 * sin(i / 10.0));
+	}
+
+	mixer_init(mixer, SAMPLE_RATE);
+
+	begin = now();
+
+	do {
+		// Half the voices are tones, the other half resampled streams
+		for(i = 0; i < MIXER_MAX_VOICES; i++) {
+			if (mixer->voices[i].type != MixerVoiceFree) {
+				continue;
+			}
+
+			if (i & 1) {
+				memset(&src[i], 0, sizeof(pcm_source_t));
+				src[i].data = data; src[i].len = SAMPLE_RATE;
+				mixer_add_pcm(mixer, 22050, pcm_read, &src[i], 16000, NULL, NULL);
+			} else {
+				mixer_add_tone(mixer, 440 + i * 100, 1000, 8000, NULL, NULL);
+			}
+		}
+
+		mixer_render(mixer, out, 1024);
+		total += 1024;
+		end = now();
+	} while (end - begin < 200000);
+
+	printf("mixer, %d voices: %.0f samples per second\r\n", MIXER_MAX_VOICES, (total * 1000000.0) / (end - begin));
+
+	free(mixer);
+}
@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, wavetable oscillator test cases
+ *
+ * The frequency of the generated wave is measured from its zero crossings,
+ * and the samples per second of the wavetable oscillator are compared
+ * against the double precision sine recurrence used before by the DAC tone
+ * generator.
+ *
+ */
+
+#include "unity.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <sound/wavetable.h>
+
+#define SAMPLE_RATE 38000
+
+static uint64_t now() {
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+
+	return ((uint64_t)tv.tv_sec * 1000000) + tv.tv_usec;
+}
+
+// Measure the frequency using the first and the last rising zero crossing,
+// linearly interpolated between samples
+static double measure_freq(int16_t *buff, uint32_t samples) {
+	double first = -1, last = -1;
+	uint32_t crossings = 0;
+	uint32_t i;
+
+	for(i = 1; i < samples; i++) {
+		if ((buff[i - 1] < 0) && (buff[i] >= 0)) {
+			double t = (i - 1) + (double)(-buff[i - 1]) / (double)(buff[i] - buff[i - 1]);
+
+			if (first < 0) {
+				first = t;
+			}
+
+			last = t;
+			crossings++;
+		}
+	}
+
+	if (crossings < 2) {
+		return 0;
+	}
+
+	return ((crossings - 1) * (double)SAMPLE_RATE) / (last - first);
+}
+
+// Old DAC tone generator inner loop
+static void double_render_dac(uint8_t *out, uint32_t freq, uint32_t samples) {
+	double delta = 1.0 / (double)SAMPLE_RATE;
+	double _sin = sin(1.5 * M_PI);
+	double _cos = cos(1.5 * M_PI);
+	double tsin = sin(2.0 * M_PI * (double)freq * delta);
+	double tcos = cos(2.0 * M_PI * (double)freq * delta);
+	double _nsin, _ncos, y;
+
+	while (samples--) {
+		y = (1.0 * _sin + 1) * 255 / 2;
+
+		*out++ = 0;
+		*out++ = (uint8_t)y;
+
+		_nsin = _sin * tcos + tsin * _cos;
+		_ncos = _cos * tcos - _sin * tsin;
+
+		_sin = _nsin;
+		_cos = _ncos;
+	}
+}
+
+TEST_CASE("wavetable frequency accuracy", "[sound]") {
+	static const uint32_t freqs[] = {31, 262, 440, 1000, 4186, 9500};
+	int16_t *buff = malloc(SAMPLE_RATE * sizeof(int16_t));
+	wavetable_osc_t osc;
+	double freq, error;
+	uint32_t i, j;
+
+	TEST_ASSERT(buff != NULL);
+
+	for(i = 0; i < sizeof(freqs) / sizeof(uint32_t); i++) {
+		wavetable_init(&osc, freqs[i], SAMPLE_RATE, WAVETABLE_FULL_SCALE);
+		wavetable_render(&osc, buff, SAMPLE_RATE);
+
+		freq = measure_freq(buff, SAMPLE_RATE);
+		error = fabs(freq - freqs[i]) / freqs[i];
+
+		printf("%u Hz: measured %.4f Hz, error %.5f%%\r\n", freqs[i], freq, error * 100.0);
+		TEST_ASSERT(error < 0.0001);
+
+		// Amplitude must be within a few LSB of the ideal sine
+		wavetable_init(&osc, freqs[i], SAMPLE_RATE, WAVETABLE_FULL_SCALE);
+		wavetable_render(&osc, buff, SAMPLE_RATE);
+
+		for(j = 0; j < SAMPLE_RATE; j++) {
+			double ideal = 32767.0 * sin(1.5 * M_PI + (2.0 * M_PI * freqs[i] * j) / SAMPLE_RATE);
+
+			TEST_ASSERT(fabs(buff[j] - ideal) < 8);
+		}
+	}
+
+	free(buff);
+}
+
+TEST_CASE("wavetable ends at a period boundary", "[sound]") {
+	int16_t buff[2048];
+	wavetable_osc_t osc;
+	uint32_t tail;
+
+	wavetable_init(&osc, 440, SAMPLE_RATE, WAVETABLE_FULL_SCALE);
+	TEST_ASSERT_EQUAL(0, wavetable_samples_to_period_end(&osc));
+
+	wavetable_render(&osc, buff, 1000);
+	tail = wavetable_samples_to_period_end(&osc);
+	TEST_ASSERT(tail > 0);
+	TEST_ASSERT(tail <= SAMPLE_RATE / 440 + 1);
+
+	wavetable_render(&osc, buff, tail);
+
+	// Phase is just past the start phase, so output is at the minimum
+	TEST_ASSERT(osc.phase - WAVETABLE_START_PHASE < osc.step);
+	TEST_ASSERT(buff[tail - 1] < -32000);
+}
+
+TEST_CASE("wavetable samples per second", "[sound]") {
+	uint8_t *buff = malloc(SAMPLE_RATE * 2);
+	wavetable_osc_t osc;
+	uint64_t begin, end;
+	uint32_t total;
+
+	TEST_ASSERT(buff != NULL);
+
+	total = 0;
+	begin = now();
+	do {
+		double_render_dac(buff, 440, SAMPLE_RATE);
+		total += SAMPLE_RATE;
+		end = now();
+	} while (end - begin < 200000);
+
+	double double_rate = (total * 1000000.0) / (end - begin);
+
+	total = 0;
+	begin = now();
+	do {
+		wavetable_init(&osc, 440, SAMPLE_RATE, WAVETABLE_FULL_SCALE);
+		wavetable_render_dac(&osc, buff, SAMPLE_RATE);
+		total += SAMPLE_RATE;
+		end = now();
+	} while (end - begin < 200000);
+
+	double wavetable_rate = (total * 1000000.0) / (end - begin);
+
+	printf("samples per second, double %.0f, wavetable %.0f\r\n", double_rate, wavetable_rate);
+
+	// The oscillator must be able to feed the DAC in real time
+	TEST_ASSERT(wavetable_rate > SAMPLE_RATE);
+
+	free(buff);
+}
@@ -45,8 +45,96 @@
 
 #include "sound.h"
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include <sys/delay.h>
 #include <sys/driver.h>
 
+typedef enum {
+	ToneCmdPlay,
+	ToneCmdSilence,
+	ToneCmdSync,
+	ToneCmdStop
+} tone_cmd_type_t;
+
+typedef struct {
+	tone_cmd_type_t type;
+	uint32_t freq;
+	uint32_t duration;
+	SemaphoreHandle_t sync;
+} tone_cmd_t;
+
+/*
+ * Helper functions
+ */
+static void tone_task(void *arg) {
+	tone_gen_device_t *dev = (tone_gen_device_t *)arg;
+	tone_cmd_t cmd;
+
+	for(;;) {
+		if (xQueueReceive(dev->queue, &cmd, portMAX_DELAY) != pdTRUE) {
+			continue;
+		}
+
+		switch (cmd.type) {
+			case ToneCmdPlay:
+				// There is no caller to report an error to, and the only
+				// errors that can happen here are already checked when the
+				// command is queued
+				dev->_play((void **)(&dev->h), cmd.freq, cmd.duration);
+				break;
+
+			case ToneCmdSilence:
+				delay(cmd.duration);
+				break;
+
+			case ToneCmdSync:
+				xSemaphoreGive(cmd.sync);
+				break;
+
+			case ToneCmdStop:
+				xSemaphoreGive(cmd.sync);
+				vTaskDelete(NULL);
+				break;
+		}
+	}
+}
+
+static driver_error_t *tone_queue(tone_gen_device_h_t *h, tone_cmd_t *cmd) {
+	if (!*h) {
+		return driver_error(SOUND_DRIVER, SOUND_ERR_NO_TONE_GEN, NULL);
+	}
+
+	xQueueSend((*h)->queue, cmd, portMAX_DELAY);
+
+	return NULL;
+}
+
+static driver_error_t *tone_sync(tone_gen_device_h_t *h, tone_cmd_type_t type) {
+	tone_cmd_t cmd;
+
+	cmd.type = type;
+	cmd.sync = xSemaphoreCreateBinary();
+	if (!cmd.sync) {
+		return driver_error(SOUND_DRIVER, SOUND_ERR_NOT_ENOUGH_MEMORY, NULL);
+	}
+
+	driver_error_t *error = tone_queue(h, &cmd);
+	if (!error) {
+		xSemaphoreTake(cmd.sync, portMAX_DELAY);
+	}
+
+	vSemaphoreDelete(cmd.sync);
+
+	return error;
+}
+
+/*
+ * Operation functions
+ */
 driver_error_t *tone_setup(tone_gen_t gen, tone_gen_config_t *config, tone_gen_device_h_t *h) {
 	driver_error_t *error;
 
@@ -67,10 +155,14 @@ driver_error_t *tone_setup(tone_gen_t gen, tone_gen_config_t *config, tone_gen_d
 			(*h)->_unsetup = (tone_unsetup_t)tone_pwm_unsetup;
 			(*h)->_play = (tone_play_t)tone_pwm_play;
 			(*h)->_set_volume = NULL;
+			(*h)->_play_file = NULL;
 
 			error = tone_pwm_setup(&config->pwm, (tone_pwm_device_h_t *)(&(*h)->h));
 			if (error) {
-				tone_unsetup(h);
+				free(*h);
+				*h = NULL;
+
+				return error;
 			}
 
 			break;
@@ -79,10 +171,14 @@ driver_error_t *tone_setup(tone_gen_t gen, tone_gen_config_t *config, tone_gen_d
 			(*h)->_unsetup = (tone_unsetup_t)tone_dac_unsetup;
 			(*h)->_play = (tone_play_t)tone_dac_play;
 			(*h)->_set_volume = (set_volume_t)tone_dac_set_volume;
+			(*h)->_play_file = (tone_play_file_t)tone_dac_play_file;
 
 			error = tone_dac_setup(&config->dac, (tone_dac_device_h_t *)(&(*h)->h));
 			if (error) {
-				tone_unsetup(h);
+				free(*h);
+				*h = NULL;
+
+				return error;
 			}
 
 			break;
@@ -94,12 +190,38 @@ driver_error_t *tone_setup(tone_gen_t gen, tone_gen_config_t *config, tone_gen_d
 	// Set default volume
 	tone_set_volume(h, 1.0);
 
+	// Create the queue and the task that plays the tones
+	(*h)->queue = xQueueCreate(TONE_QUEUE_LEN, sizeof(tone_cmd_t));
+	if (!(*h)->queue) {
+		tone_unsetup(h);
+
+		return driver_error(SOUND_DRIVER, SOUND_ERR_NOT_ENOUGH_MEMORY, NULL);
+	}
+
+	BaseType_t xReturn = xTaskCreatePinnedToCore(tone_task, "tone", TONE_TASK_STACK_SIZE, *h, TONE_TASK_PRIORITY, &(*h)->task, xPortGetCoreID());
+	if (xReturn != pdPASS) {
+		(*h)->task = NULL;
+		tone_unsetup(h);
+
+		return driver_error(SOUND_DRIVER, SOUND_ERR_NOT_ENOUGH_MEMORY, NULL);
+	}
+
 	return NULL;
 }
 
 driver_error_t *tone_unsetup(tone_gen_device_h_t *h) {
 	if (!*h) return NULL;
 
+	if ((*h)->task) {
+		// Discard pending commands, and wait for the current one to finish
+		xQueueReset((*h)->queue);
+		tone_sync(h, ToneCmdStop);
+	}
+
+	if ((*h)->queue) {
+		vQueueDelete((*h)->queue);
+	}
+
 	(*h)->_unsetup((void **)(&((*h)->h)));
 	free(*h);
 	*h = NULL;
@@ -124,14 +246,37 @@ driver_error_t *tone_set_volume(tone_gen_device_h_t *h, float volume) {
 }
 
 driver_error_t *tone_play(tone_gen_device_h_t *h, uint32_t freq, uint32_t duration) {
+	tone_cmd_t cmd;
+
+	cmd.type = ToneCmdPlay;
+	cmd.freq = freq;
+	cmd.duration = duration;
+
+	return tone_queue(h, &cmd);
+}
+
+driver_error_t *tone_silence(tone_gen_device_h_t *h, uint32_t duration) {
+	tone_cmd_t cmd;
+
+	cmd.type = ToneCmdSilence;
+	cmd.duration = duration;
+
+	return tone_queue(h, &cmd);
+}
+
+driver_error_t *tone_wait(tone_gen_device_h_t *h) {
+	return tone_sync(h, ToneCmdSync);
+}
+
+driver_error_t *tone_play_file(tone_gen_device_h_t *h, const char *path, const wav_info_t *raw) {
 	if (!*h) {
 		return driver_error(SOUND_DRIVER, SOUND_ERR_NO_TONE_GEN, NULL);
 	}
 
-	driver_error_t *error = (*h)->_play((void **)(&(*h)->h), freq, duration);
-	if (error) {
-		return error;
+	if (!(*h)->_play_file) {
+		return driver_error(SOUND_DRIVER, SOUND_ERR_NOT_SUPPORTED, NULL);
 	}
 
-	return NULL;
+	// Files are not queued, they are mixed with the tones being played
+	return (*h)->_play_file((void **)(&(*h)->h), path, raw);
 }
@@ -46,17 +46,33 @@
 #ifndef _SOUND_TONE_H_
 #define _SOUND_TONE_H_
 
+#include "sdkconfig.h"
+
 #include <stdint.h>
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
 #include <sound/tone_pwm.h>
 #include <sound/tone_dac.h>
+#include <sound/wav.h>
 
 #include <sys/driver.h>
 
+// Tones are played by a background task, that drains a queue of commands,
+// so that the caller doesn't wait for the tone to end. This is the number of
+// commands that can be queued before the caller blocks.
+#define TONE_QUEUE_LEN       32
+
+#define TONE_TASK_STACK_SIZE 2048
+#define TONE_TASK_PRIORITY   (CONFIG_LUA_RTOS_LUA_THREAD_PRIORITY + 1)
+
 typedef driver_error_t *(*tone_setup_t)(void *, void **);
 typedef void (*tone_unsetup_t)(void **);
 typedef driver_error_t *(*tone_play_t)(void **, uint32_t, uint32_t);
 typedef driver_error_t *(*set_volume_t)(void **, float);
+typedef driver_error_t *(*tone_play_file_t)(void **, const char *, const wav_info_t *);
 
 typedef enum {
 	ToneGeneratorPWM = 1,
@@ -74,6 +90,9 @@ typedef struct {
 	tone_unsetup_t _unsetup;
 	tone_play_t    _play;
 	set_volume_t   _set_volume;
+	tone_play_file_t _play_file;
+	QueueHandle_t  queue;
+	TaskHandle_t   task;
 } tone_gen_device_t;
 
 typedef tone_gen_device_t *tone_gen_device_h_t;
@@ -82,5 +101,8 @@ driver_error_t *tone_setup(tone_gen_t, tone_gen_config_t *, tone_gen_device_h_t
 driver_error_t *tone_unsetup(tone_gen_device_h_t *);
 driver_error_t *tone_play(tone_gen_device_h_t *, uint32_t, uint32_t);
 driver_error_t *tone_set_volume(tone_gen_device_h_t *h, float volume);
+driver_error_t *tone_silence(tone_gen_device_h_t *, uint32_t);
+driver_error_t *tone_wait(tone_gen_device_h_t *);
+driver_error_t *tone_play_file(tone_gen_device_h_t *, const char *, const wav_info_t *);
 
 #endif /* _SOUND_TONE_H_ */
@@ -47,7 +47,9 @@
 
 #include "driver/i2s.h"
 
-#include <math.h>
+#include <sound/mixer.h>
+#include <sound/pcm_stream.h>
+#include <sound/wavetable.h>
 
 #define TONE_DAC_SAMPLE_RATE 38000
 
@@ -71,8 +73,36 @@ static uint8_t pin_to_dac_mode(int8_t pin) {
 	return I2S_DAC_CHANNEL_LEFT_EN;
 }
 
-static double map(double x, double in_min, double in_max, double out_min, double out_max) {
-  return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
+static void tone_dac_done(void *arg) {
+	xSemaphoreGive((SemaphoreHandle_t)arg);
+}
+
+/*
+ * Audio task. While there are voices in the mixer, renders a buffer and
+ * sends it to the DAC. i2s_write blocks while the DMA buffers are full, so
+ * the task runs at the DAC pace. When there are no voices, waits for a
+ * notification.
+ */
+static void tone_dac_task(void *arg) {
+	tone_dac_device_t *dev = (tone_dac_device_t *)arg;
+	size_t bytes_written;
+	int active;
+
+	for(;;) {
+		mtx_lock(&dev->mtx);
+		active = mixer_active(&dev->mixer);
+		if (active) {
+			mixer_render_dac(&dev->mixer, dev->buff, dev->buff_len >> 1);
+		}
+		mtx_unlock(&dev->mtx);
+
+		if (!active) {
+			ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+			continue;
+		}
+
+		i2s_write(0, dev->buff, dev->buff_len, &bytes_written, portMAX_DELAY);
+	}
 }
 
 /*
@@ -156,9 +186,28 @@ driver_error_t *tone_dac_setup(tone_dac_config_t *config, tone_dac_device_h_t *h
 
 	i2s_set_dac_mode(pin_to_dac_mode((*h)->pin));
 
-	(*h)->volume = 1.0;
+	(*h)->amp = WAVETABLE_FULL_SCALE;
 	(*h)->samples = i2s_config.sample_rate;
 
+	// Setup mixer, and start the audio task
+	mixer_init(&(*h)->mixer, (*h)->samples);
+	mtx_init(&(*h)->mtx, NULL, NULL, 0);
+
+	(*h)->tone_done = xSemaphoreCreateBinary();
+	if (!(*h)->tone_done) {
+		tone_dac_unsetup(h);
+
+		return driver_error(SOUND_DRIVER, SOUND_ERR_NOT_ENOUGH_MEMORY, NULL);
+	}
+
+	BaseType_t xReturn = xTaskCreatePinnedToCore(tone_dac_task, "dac", TONE_DAC_TASK_STACK_SIZE, *h, TONE_DAC_TASK_PRIORITY, &(*h)->task, xPortGetCoreID());
+	if (xReturn != pdPASS) {
+		(*h)->task = NULL;
+		tone_dac_unsetup(h);
+
+		return driver_error(SOUND_DRIVER, SOUND_ERR_NOT_ENOUGH_MEMORY, NULL);
+	}
+
     return NULL;
 }
 
@@ -169,6 +218,30 @@ void tone_dac_unsetup(tone_dac_device_h_t *h) {
 	driver_unlock(SOUND_DRIVER, 0, GPIO_DRIVER, (*h)->pin);
 	#endif
 
+	if (mtx_inited(&(*h)->mtx)) {
+		int i;
+
+		// Stop all voices, this wakes up the tone waiting to end, and
+		// releases the streams. The audio task doesn't hold the mutex
+		// when it is deleted.
+		mtx_lock(&(*h)->mtx);
+
+		for(i = 0; i < MIXER_MAX_VOICES; i++) {
+			mixer_stop(&(*h)->mixer, i);
+		}
+
+		if ((*h)->task) {
+			vTaskDelete((*h)->task);
+		}
+
+		mtx_unlock(&(*h)->mtx);
+		mtx_destroy(&(*h)->mtx);
+	}
+
+	if ((*h)->tone_done) {
+		vSemaphoreDelete((*h)->tone_done);
+	}
+
 	// Uninstall driver
 	i2s_driver_uninstall(0);
 
@@ -187,100 +260,55 @@ driver_error_t *tone_dac_play(tone_dac_device_h_t *h, uint32_t freq, uint32_t du
 	}
 
 	/*
-	 * The sine wave has the following equation:
-	 *
-	 * y(t) = sin(2 * PI * f * t + p) where:
-	 *
-	 * f: frequency
-	 * t: time
-	 * p: phase
+	 * The tone is added to the mixer as a new voice, and the audio task
+	 * generates the sine wave with a wavetable oscillator (see wavetable.h),
+	 * using only integer arithmetic. The tone starts at 3/2 PI, to give a 0 DAC
+	 * value, and the last period is completed, so that the tone also ends
+	 * with a 0 DAC value.
 	 *
-	 * To sample the wave at a certain rate, t must be incremented
-	 * in 1 / sample frequency increments, named delta.
-	 *
-	 * The idea is to sample the wave at the required sample frequency and,
-	 * generate a buffer with the DAC values needed to reproduce the wave
-	 * through the DAC controller.
-	 *
-	 * The wave can be sampled in an incremental way, so:
-	 *
-	 * sin(a + b) = sin(a) * cos(b) + sin(b) * cos(a)
-	 * cos(a + b) = cos(a) * cos(b) + sin(a) * sin(b)
+	 * This function is called from the tone task, and waits for the tone to
+	 * end, so that queued tones are played one after another.
 	 */
+	int voice;
 
-	// Convert duration from milliseconds to seconds
-	double _duration = (double)(duration / 1000.0);
-
-	double _period = 1.0 / (double)freq;
-	double _curr_period = 0.0;
-
-	double phase = 1.5 * M_PI;      // We start at 3/2 PI, to give a 0 DAC value
-	double delta = (1.0 / ((double)(*h)->samples)); // Compute delta
-	double y = 0.0;
-	double t = 0.0;
-
-	double _sin = sin(phase);
-	double _cos = cos(phase);
-
-	double _nsin;
-	double _ncos;
-
-	double tsin = sin(2.0 * M_PI * (double)freq * delta);
-	double tcos = cos(2.0 * M_PI * (double)freq * delta);
-
-	register int i = 0;
-
-	size_t bytes_written;
-
-	do {
-		y = map((*h)->volume * _sin, -1, 1, 0, 255);
-
-		(*h)->buff[i++] = 0;
-		(*h)->buff[i++] = (uint8_t)y;
-
-		if (i == (*h)->buff_len) {
-			i2s_write(0, (*h)->buff, i, &bytes_written, portMAX_DELAY);
-			i = 0;
-		}
-
-		_nsin = _sin * tcos + tsin * _cos;
-		_ncos = _cos * tcos - _sin * tsin;
+	mtx_lock(&(*h)->mtx);
+	voice = mixer_add_tone(&(*h)->mixer, freq, duration, (*h)->amp, tone_dac_done, (*h)->tone_done);
+	mtx_unlock(&(*h)->mtx);
 
-		_sin = _nsin;
-		_cos = _ncos;
+	if (voice < 0) {
+		return driver_error(SOUND_DRIVER, SOUND_ERR_NO_FREE_VOICES, NULL);
+	}
 
-		t += delta;
-		_curr_period += delta;
+	xTaskNotifyGive((*h)->task);
+	xSemaphoreTake((*h)->tone_done, portMAX_DELAY);
 
-		if (_curr_period >= _period) {
-			_curr_period = 0.0;
-		}
-	} while (t < _duration);
+	return NULL;
+}
 
-	while (_curr_period < _period) {
-		y = map((*h)->volume * _sin, -1, 1, 0, 255);
+driver_error_t *tone_dac_play_file(tone_dac_device_h_t *h, const char *path, const wav_info_t *raw) {
+	driver_error_t *error;
+	pcm_stream_t *stream;
+	int voice;
 
-		(*h)->buff[i++] = 0;
-		(*h)->buff[i++] = (uint8_t)y;
+	if (!*h) {
+		return driver_error(SOUND_DRIVER, SOUND_ERR_NO_TONE_GEN, NULL);
+	}
 
-		if (i == (*h)->buff_len) {
-			i2s_write(0, (*h)->buff, i, &bytes_written, portMAX_DELAY);
-			i = 0;
-		}
+	if ((error = pcm_stream_open(path, raw, &stream))) {
+		return error;
+	}
 
-		_nsin = _sin * tcos + tsin * _cos;
-		_ncos = _cos * tcos - _sin * tsin;
+	mtx_lock(&(*h)->mtx);
+	voice = mixer_add_pcm(&(*h)->mixer, stream->info.sample_rate, pcm_stream_read, stream, (*h)->amp, pcm_stream_close, stream);
+	mtx_unlock(&(*h)->mtx);
 
-		_sin = _nsin;
-		_cos = _ncos;
+	if (voice < 0) {
+		pcm_stream_close(stream);
 
-		t += delta;
-		_curr_period += delta;
+		return driver_error(SOUND_DRIVER, SOUND_ERR_NO_FREE_VOICES, NULL);
 	}
 
-	if (i > 0) {
-		i2s_write(0, (*h)->buff, i, &bytes_written, portMAX_DELAY);
-	}
+	xTaskNotifyGive((*h)->task);
 
 	return NULL;
 }
@@ -290,7 +318,7 @@ driver_error_t *tone_dac_set_volume(tone_dac_device_h_t *h, float volume) {
 		return driver_error(SOUND_DRIVER, SOUND_ERR_NO_TONE_GEN, NULL);
 	}
 
-	(*h)->volume = (1.0 + log10(volume));
+	(*h)->amp = wavetable_volume_to_amp(volume);
 
 	return NULL;
 }
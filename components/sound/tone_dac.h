@@ -46,16 +46,33 @@
 #ifndef _TONE_DAC_H_
 #define _TONE_DAC_H_
 
+#include "sdkconfig.h"
+
 #include <stdint.h>
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+
+#include <sound/mixer.h>
+#include <sound/wav.h>
+
 #include <sys/driver.h>
+#include <sys/mutex.h>
+
+#define TONE_DAC_TASK_STACK_SIZE 2048
+#define TONE_DAC_TASK_PRIORITY   (CONFIG_LUA_RTOS_LUA_THREAD_PRIORITY + 2)
 
 typedef struct {
 	int8_t pin;
-	double volume;
+	int32_t amp;       ///< Amplitude, in Q15
 	int samples;       ///< Samples per second
 	uint8_t *buff;     ///< Buffer for DAC values
 	uint32_t buff_len; ///< Buffer length
+	mixer_t mixer;     ///< Tones and streams being played
+	struct mtx mtx;    ///< Protects mixer
+	TaskHandle_t task; ///< Task that feeds the DAC from the mixer
+	SemaphoreHandle_t tone_done; ///< Given when a tone ends
 } tone_dac_device_t;
 
 typedef tone_dac_device_t *tone_dac_device_h_t;
@@ -68,5 +85,6 @@ driver_error_t *tone_dac_setup(tone_dac_config_t *config, tone_dac_device_h_t *h
 void tone_dac_unsetup(tone_dac_device_h_t *h);
 driver_error_t *tone_dac_play(tone_dac_device_h_t *h, uint32_t freq, uint32_t duration);
 driver_error_t *tone_dac_set_volume(tone_dac_device_h_t *h, float volume);
+driver_error_t *tone_dac_play_file(tone_dac_device_h_t *h, const char *path, const wav_info_t *raw);
 
 #endif /* _TONE_DAC_H_ */
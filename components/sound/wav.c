@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, WAV file parser
+ *
+ */
+
+#include "wav.h"
+
+#include <string.h>
+
+#include <esp_attr.h>
+
+#define WAV_FORMAT_PCM 1
+
+/*
+ * Helper functions
+ */
+static inline uint16_t le16(const uint8_t *buf) {
+	return (uint16_t)buf[0] | ((uint16_t)buf[1] << 8);
+}
+
+static inline uint32_t le32(const uint8_t *buf) {
+	return (uint32_t)le16(buf) | ((uint32_t)le16(buf + 2) << 16);
+}
+
+static int skip(wav_read_t read, void *arg, uint32_t len) {
+	uint8_t buf[32];
+	uint32_t chunk;
+
+	while (len > 0) {
+		chunk = (len > sizeof(buf))?sizeof(buf):len;
+
+		if (read(arg, buf, chunk) < 0) {
+			return WAV_ERR_READ;
+		}
+
+		len -= chunk;
+	}
+
+	return 0;
+}
+
+/*
+ * Operation functions
+ */
+int wav_raw(wav_info_t *info, uint32_t sample_rate, uint16_t channels, uint16_t bits) {
+	if ((sample_rate == 0) || ((channels != 1) && (channels != 2)) || ((bits != 8) && (bits != 16))) {
+		return WAV_ERR_NOT_SUPPORTED;
+	}
+
+	info->sample_rate = sample_rate;
+	info->channels = channels;
+	info->bits = bits;
+	info->block_align = channels * (bits >> 3);
+	info->data_len = 0xffffffff;
+
+	return 0;
+}
+
+int wav_parse(wav_read_t read, void *arg, wav_info_t *info) {
+	uint8_t buf[16];
+	uint32_t len;
+	int fmt = 0;
+	int rc;
+
+	// RIFF header
+	if (read(arg, buf, 12) < 0) {
+		return WAV_ERR_READ;
+	}
+
+	if ((memcmp(buf, "RIFF", 4) != 0) || (memcmp(buf + 8, "WAVE", 4) != 0)) {
+		return WAV_ERR_FORMAT;
+	}
+
+	// Chunks
+	for(;;) {
+		if (read(arg, buf, 8) < 0) {
+			return fmt?WAV_ERR_READ:WAV_ERR_FORMAT;
+		}
+
+		len = le32(buf + 4);
+
+		if (memcmp(buf, "fmt ", 4) == 0) {
+			if (len < 16) {
+				return WAV_ERR_FORMAT;
+			}
+
+			if (read(arg, buf, 16) < 0) {
+				return WAV_ERR_READ;
+			}
+
+			if (le16(buf) != WAV_FORMAT_PCM) {
+				return WAV_ERR_NOT_SUPPORTED;
+			}
+
+			if ((rc = wav_raw(info, le32(buf + 4), le16(buf + 2), le16(buf + 14)))) {
+				return rc;
+			}
+
+			if (le16(buf + 12) != info->block_align) {
+				return WAV_ERR_FORMAT;
+			}
+
+			fmt = 1;
+			len -= 16;
+		} else if (memcmp(buf, "data", 4) == 0) {
+			if (!fmt) {
+				return WAV_ERR_FORMAT;
+			}
+
+			info->data_len = len;
+
+			return 0;
+		}
+
+		// Skip the rest of the chunk, chunks are word aligned
+		if ((rc = skip(read, arg, len + (len & 1)))) {
+			return rc;
+		}
+	}
+}
+
+void IRAM_ATTR wav_decode(const wav_info_t *info, const uint8_t *in, uint32_t frames, int16_t *out) {
+	if (info->bits == 8) {
+		if (info->channels == 1) {
+			while (frames--) {
+				*out++ = (int16_t)(((int32_t)*in++ - 128) * 256);
+			}
+		} else {
+			while (frames--) {
+				*out++ = (int16_t)(((int32_t)in[0] + (int32_t)in[1] - 256) * 128);
+				in += 2;
+			}
+		}
+	} else {
+		if (info->channels == 1) {
+			while (frames--) {
+				*out++ = (int16_t)le16(in);
+				in += 2;
+			}
+		} else {
+			while (frames--) {
+				*out++ = (int16_t)(((int32_t)(int16_t)le16(in) + (int32_t)(int16_t)le16(in + 2)) >> 1);
+				in += 4;
+			}
+		}
+	}
+}
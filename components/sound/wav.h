@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, WAV file parser
+ *
+ */
+
+#ifndef _SOUND_WAV_H_
+#define _SOUND_WAV_H_
+
+#include <stdint.h>
+
+// Errors returned by wav_parse
+#define WAV_ERR_READ            -1 ///< Can't read from the source
+#define WAV_ERR_FORMAT          -2 ///< Not a RIFF / WAVE file
+#define WAV_ERR_NOT_SUPPORTED   -3 ///< Unsupported encoding
+
+/**
+ * @brief Function used by the parser to read from the source. Must read
+ *        exactly len bytes.
+ *
+ * @return 0 on success, -1 on error or end of source.
+ */
+typedef int (*wav_read_t)(void *arg, void *buf, uint32_t len);
+
+typedef struct {
+	uint32_t sample_rate;  ///< Frames per second
+	uint16_t channels;     ///< 1 or 2
+	uint16_t bits;         ///< 8 (unsigned) or 16 (signed, little endian)
+	uint16_t block_align;  ///< Bytes per frame
+	uint32_t data_len;     ///< Length of the data chunk, in bytes
+} wav_info_t;
+
+/**
+ * @brief Parse the header of a WAV file, until the beginning of the data
+ *        chunk. Chunks that aren't needed are skipped.
+ *
+ * @param read Function used to read from the source.
+ * @param arg Argument passed to read.
+ * @param info Parsed stream format.
+ *
+ * @return 0 on success, or a WAV_ERR_* error.
+ */
+int wav_parse(wav_read_t read, void *arg, wav_info_t *info);
+
+/**
+ * @brief Set the stream format for raw PCM data.
+ *
+ * @param info Stream format.
+ * @param sample_rate Frames per second.
+ * @param channels 1 or 2.
+ * @param bits 8 or 16.
+ *
+ * @return 0 on success, or WAV_ERR_NOT_SUPPORTED.
+ */
+int wav_raw(wav_info_t *info, uint32_t sample_rate, uint16_t channels, uint16_t bits);
+
+/**
+ * @brief Decode PCM frames to signed 16-bit mono samples. Stereo frames are
+ *        down mixed by averaging both channels.
+ *
+ * @param info Stream format.
+ * @param in Encoded frames.
+ * @param frames Number of frames to decode.
+ * @param out Decoded samples.
+ */
+void wav_decode(const wav_info_t *info, const uint8_t *in, uint32_t frames, int16_t *out);
+
+#endif /* _SOUND_WAV_H_ */
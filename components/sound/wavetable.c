@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, wavetable oscillator
+ *
+ */
+
+#include "wavetable.h"
+
+#include <math.h>
+
+#include <esp_attr.h>
+
+// sin(2 * PI * i / WAVETABLE_SIZE) in Q15, with a guard entry at the end to
+// interpolate the last interval without wrapping the index
+const int16_t wavetable_sine[WAVETABLE_SIZE + 1] = {
+	     0,    804,   1608,   2410,   3212,   4011,   4808,   5602,
+	  6393,   7179,   7962,   8739,   9512,  10278,  11039,  11793,
+	 12539,  13279,  14010,  14732,  15446,  16151,  16846,  17530,
+	 18204,  18868,  19519,  20159,  20787,  21403,  22005,  22594,
+	 23170,  23731,  24279,  24811,  25329,  25832,  26319,  26790,
+	 27245,  27683,  28105,  28510,  28898,  29268,  29621,  29956,
+	 30273,  30571,  30852,  31113,  31356,  31580,  31785,  31971,
+	 32137,  32285,  32412,  32521,  32609,  32678,  32728,  32757,
+	 32767,  32757,  32728,  32678,  32609,  32521,  32412,  32285,
+	 32137,  31971,  31785,  31580,  31356,  31113,  30852,  30571,
+	 30273,  29956,  29621,  29268,  28898,  28510,  28105,  27683,
+	 27245,  26790,  26319,  25832,  25329,  24811,  24279,  23731,
+	 23170,  22594,  22005,  21403,  20787,  20159,  19519,  18868,
+	 18204,  17530,  16846,  16151,  15446,  14732,  14010,  13279,
+	 12539,  11793,  11039,  10278,   9512,   8739,   7962,   7179,
+	  6393,   5602,   4808,   4011,   3212,   2410,   1608,    804,
+	     0,   -804,  -1608,  -2410,  -3212,  -4011,  -4808,  -5602,
+	 -6393,  -7179,  -7962,  -8739,  -9512, -10278, -11039, -11793,
+	-12539, -13279, -14010, -14732, -15446, -16151, -16846, -17530,
+	-18204, -18868, -19519, -20159, -20787, -21403, -22005, -22594,
+	-23170, -23731, -24279, -24811, -25329, -25832, -26319, -26790,
+	-27245, -27683, -28105, -28510, -28898, -29268, -29621, -29956,
+	-30273, -30571, -30852, -31113, -31356, -31580, -31785, -31971,
+	-32137, -32285, -32412, -32521, -32609, -32678, -32728, -32757,
+	-32767, -32757, -32728, -32678, -32609, -32521, -32412, -32285,
+	-32137, -31971, -31785, -31580, -31356, -31113, -30852, -30571,
+	-30273, -29956, -29621, -29268, -28898, -28510, -28105, -27683,
+	-27245, -26790, -26319, -25832, -25329, -24811, -24279, -23731,
+	-23170, -22594, -22005, -21403, -20787, -20159, -19519, -18868,
+	-18204, -17530, -16846, -16151, -15446, -14732, -14010, -13279,
+	-12539, -11793, -11039, -10278,  -9512,  -8739,  -7962,  -7179,
+	 -6393,  -5602,  -4808,  -4011,  -3212,  -2410,  -1608,   -804,
+	     0
+};
+
+/*
+ * Helper functions
+ */
+static inline int32_t wavetable_next(wavetable_osc_t *osc) {
+	uint32_t idx = osc->phase >> (32 - WAVETABLE_BITS);
+	int32_t frac = (osc->phase >> (32 - WAVETABLE_BITS - 15)) & 0x7fff;
+	int32_t a = wavetable_sine[idx];
+	int32_t b = wavetable_sine[idx + 1];
+
+	osc->phase += osc->step;
+
+	return (((a + (((b - a) * frac) >> 15))) * osc->amp) >> 15;
+}
+
+/*
+ * Operation functions
+ */
+void wavetable_init(wavetable_osc_t *osc, uint32_t freq, uint32_t sample_rate, int32_t amp) {
+	osc->phase = WAVETABLE_START_PHASE;
+	osc->step = (uint32_t)((((uint64_t)freq << 32) + (sample_rate >> 1)) / sample_rate);
+
+	if (amp < 0) {
+		amp = 0;
+	} else if (amp > WAVETABLE_FULL_SCALE) {
+		amp = WAVETABLE_FULL_SCALE;
+	}
+
+	osc->amp = amp;
+}
+
+uint32_t wavetable_samples_to_period_end(wavetable_osc_t *osc) {
+	if (osc->step == 0) {
+		return 0;
+	}
+
+	uint32_t elapsed = osc->phase - WAVETABLE_START_PHASE;
+
+	if (elapsed == 0) {
+		return 0;
+	}
+
+	uint64_t remaining = ((uint64_t)1 << 32) - elapsed;
+
+	return (uint32_t)((remaining + osc->step - 1) / osc->step);
+}
+
+void IRAM_ATTR wavetable_render(wavetable_osc_t *osc, int16_t *out, uint32_t samples) {
+	while (samples--) {
+		*out++ = (int16_t)wavetable_next(osc);
+	}
+}
+
+void IRAM_ATTR wavetable_render_dac(wavetable_osc_t *osc, uint8_t *out, uint32_t samples) {
+	while (samples--) {
+		// Q15 sample is in the [-32767, 32767] range, so the DAC value is in
+		// the [0, 255] range
+		*out++ = 0;
+		*out++ = (uint8_t)(128 + (wavetable_next(osc) >> 8));
+	}
+}
+
+int32_t wavetable_volume_to_amp(float volume) {
+	if (volume <= 0) {
+		return 0;
+	}
+
+	float amp = 1.0f + log10f(volume);
+
+	if (amp <= 0) {
+		return 0;
+	} else if (amp >= 1) {
+		return WAVETABLE_FULL_SCALE;
+	}
+
+	return (int32_t)(amp * WAVETABLE_FULL_SCALE + 0.5f);
+}
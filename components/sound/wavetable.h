@@ -0,0 +1,132 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, wavetable oscillator
+ *
+ */
+
+#ifndef _SOUND_WAVETABLE_H_
+#define _SOUND_WAVETABLE_H_
+
+#include <stdint.h>
+
+/*
+ * Direct digital synthesis oscillator.
+ *
+ * The phase is a 32-bit accumulator in which a full turn is 2^32, so the
+ * per-sample increment is freq * 2^32 / sample rate, and wrapping around is
+ * done by the integer overflow. The upper 8 bits of the phase index a 256
+ * entries Q15 sine table, and the next 15 bits are used to linearly
+ * interpolate between two consecutive entries.
+ *
+ * All the operations are done with integer arithmetic, so it's suitable for
+ * generating samples without a double precision FPU.
+ */
+
+#define WAVETABLE_BITS       8
+#define WAVETABLE_SIZE       (1 << WAVETABLE_BITS)
+
+// Phase of the first sample of a tone: 3/2 PI, that gives the minimum
+// output value, so that the DAC starts from 0 and doesn't click
+#define WAVETABLE_START_PHASE 0xc0000000
+
+// Full scale amplitude, in Q15
+#define WAVETABLE_FULL_SCALE  32767
+
+typedef struct {
+	uint32_t phase;  ///< Current phase (2^32 = 2 PI)
+	uint32_t step;   ///< Phase increment per sample
+	int32_t amp;     ///< Amplitude, in Q15
+} wavetable_osc_t;
+
+extern const int16_t wavetable_sine[WAVETABLE_SIZE + 1];
+
+/**
+ * @brief Initialize an oscillator.
+ *
+ * @param osc Oscillator.
+ * @param freq Frequency, in Hz.
+ * @param sample_rate Sample rate, in samples per second.
+ * @param amp Amplitude, in Q15 (0 .. WAVETABLE_FULL_SCALE).
+ */
+void wavetable_init(wavetable_osc_t *osc, uint32_t freq, uint32_t sample_rate, int32_t amp);
+
+/**
+ * @brief Get the number of samples needed to end the current period, so that
+ *        the output returns to the start phase.
+ *
+ * @param osc Oscillator.
+ *
+ * @return Number of samples.
+ */
+uint32_t wavetable_samples_to_period_end(wavetable_osc_t *osc);
+
+/**
+ * @brief Render samples in Q15.
+ *
+ * @param osc Oscillator.
+ * @param out Output buffer.
+ * @param samples Number of samples to render.
+ */
+void wavetable_render(wavetable_osc_t *osc, int16_t *out, uint32_t samples);
+
+/**
+ * @brief Render samples in the format expected by the I2S built-in DAC: 16-bit
+ *        frames, in which the low byte is 0 and the high byte is the 8-bit
+ *        unsigned DAC value.
+ *
+ * @param osc Oscillator.
+ * @param out Output buffer, of 2 * samples bytes.
+ * @param samples Number of samples to render.
+ */
+void wavetable_render_dac(wavetable_osc_t *osc, uint8_t *out, uint32_t samples);
+
+/**
+ * @brief Convert a volume in the [0, 1] range to a Q15 amplitude, using
+ *        the same logarithmic curve than the tone generators.
+ *
+ * @param volume Volume.
+ *
+ * @return Amplitude, in Q15.
+ */
+int32_t wavetable_volume_to_amp(float volume);
+
+#endif /* _SOUND_WAVETABLE_H_ */
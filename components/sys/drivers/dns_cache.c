@@ -0,0 +1,440 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, DNS cache
+ *
+ */
+
+#include "dns_cache.h"
+
+#include <string.h>
+#include <strings.h>
+
+// DNS record types and classes
+#define DNS_TYPE_A     1
+#define DNS_TYPE_CNAME 5
+#define DNS_CLASS_IN   1
+
+// DNS response codes
+#define DNS_RCODE_NAME_ERROR 3
+
+/*
+ * Helper functions
+ */
+
+static int expired(uint64_t now, uint64_t expires) {
+	return (expires <= now);
+}
+
+static dns_cache_entry_t *find(dns_cache_t *cache, const char *name) {
+	dns_cache_entry_t *entry;
+	int i;
+
+	for(i = 0; i < cache->entries; i++) {
+		entry = &cache->entry[i];
+		if ((entry->state != DNS_CACHE_FREE) && !strcasecmp(entry->name, name)) {
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+// Get an entry for a new name: a free one, an expired one, or the least
+// recently used one. Entries that are being resolved are never taken.
+static dns_cache_entry_t *allocate(dns_cache_t *cache, uint64_t now) {
+	dns_cache_entry_t *victim = NULL;
+	dns_cache_entry_t *entry;
+	int i;
+
+	for(i = 0; i < cache->entries; i++) {
+		entry = &cache->entry[i];
+
+		if (entry->state == DNS_CACHE_FREE) {
+			return entry;
+		}
+
+		if (entry->state == DNS_CACHE_PENDING) {
+			continue;
+		}
+
+		if (expired(now, entry->expires)) {
+			return entry;
+		}
+
+		if (!victim || (entry->used < victim->used)) {
+			victim = entry;
+		}
+	}
+
+	return victim;
+}
+
+static uint16_t get16(const uint8_t *p) {
+	return (p[0] << 8) | p[1];
+}
+
+static uint32_t get32(const uint8_t *p) {
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+// Skip a name in a message, returns the position after the name, or -1
+static int skip_name(const uint8_t *buffer, int len, int pos) {
+	uint8_t label;
+
+	while (pos < len) {
+		label = buffer[pos];
+
+		if (label == 0) {
+			return pos + 1;
+		}
+
+		if ((label & 0xc0) == 0xc0) {
+			// Compression pointer, the name ends here
+			return (pos + 2 <= len) ? pos + 2 : -1;
+		}
+
+		if (label & 0xc0) {
+			return -1;
+		}
+
+		pos += label + 1;
+	}
+
+	return -1;
+}
+
+// Check that the question name in a message is the name, returns the position
+// after the name, or -1
+static int match_name(const uint8_t *buffer, int len, int pos, const char *name) {
+	uint8_t label;
+
+	while (pos < len) {
+		label = buffer[pos++];
+
+		if (label == 0) {
+			return (!*name) ? pos : -1;
+		}
+
+		// Compression pointers are not expected in the question
+		if ((label & 0xc0) || (pos + label > len)) {
+			return -1;
+		}
+
+		if (strncasecmp((const char *)&buffer[pos], name, label)) {
+			return -1;
+		}
+
+		name += label;
+		pos += label;
+
+		// A trailing dot is allowed
+		if (*name == '.') {
+			name++;
+		} else if (*name) {
+			return -1;
+		}
+	}
+
+	return -1;
+}
+
+/*
+ * Operation functions
+ */
+
+void dns_cache_init(dns_cache_t *cache, dns_cache_entry_t *entry, int entries, uint32_t max_ttl,
+					uint32_t negative_ttl, const dns_cache_ops_t *ops, void *arg) {
+	memset(cache, 0, sizeof(dns_cache_t));
+	memset(entry, 0, sizeof(dns_cache_entry_t) * entries);
+
+	cache->ops = ops;
+	cache->arg = arg;
+	cache->entry = entry;
+	cache->entries = entries;
+	cache->max_ttl = max_ttl;
+	cache->negative_ttl = negative_ttl;
+}
+
+int dns_cache_lookup(dns_cache_t *cache, const char *name, uint32_t *addr) {
+	const dns_cache_ops_t *ops = cache->ops;
+	dns_cache_entry_t *entry;
+	uint32_t resolved = 0;
+	uint32_t ttl = 0;
+	uint64_t now;
+	int rc;
+
+	if ((cache->entries == 0) || (strlen(name) > DNS_CACHE_NAME_MAX)) {
+		return ops->resolve(cache->arg, name, addr, &ttl);
+	}
+
+	ops->lock(cache->arg);
+
+	for(;;) {
+		now = ops->now(cache->arg);
+
+		entry = find(cache, name);
+		if (!entry) {
+			break;
+		}
+
+		if (entry->state == DNS_CACHE_PENDING) {
+			// Wait for the query in progress, and check again
+			cache->shared++;
+			ops->wait(cache->arg);
+			continue;
+		}
+
+		if (!expired(now, entry->expires)) {
+			cache->hits++;
+			entry->used = now;
+			*addr = entry->addr;
+			rc = (entry->state == DNS_CACHE_VALID) ? DNS_CACHE_OK : DNS_CACHE_NOT_FOUND;
+
+			ops->unlock(cache->arg);
+
+			return rc;
+		}
+
+		// Expired, resolve it again in the same entry
+		break;
+	}
+
+	cache->misses++;
+
+	if (!entry) {
+		entry = allocate(cache, now);
+	}
+
+	// If all the entries are being resolved, the name is resolved without
+	// caching it
+	if (entry) {
+		strcpy(entry->name, name);
+		entry->state = DNS_CACHE_PENDING;
+	}
+
+	ops->unlock(cache->arg);
+
+	rc = ops->resolve(cache->arg, name, &resolved, &ttl);
+
+	ops->lock(cache->arg);
+
+	if (entry) {
+		now = ops->now(cache->arg);
+
+		if (rc == DNS_CACHE_OK) {
+			// At least 1 second, so the waiters get the result
+			if (ttl > cache->max_ttl) ttl = cache->max_ttl;
+			if (ttl < 1) ttl = 1;
+
+			entry->state = DNS_CACHE_VALID;
+			entry->addr = resolved;
+			entry->expires = now + (uint64_t)ttl * 1000;
+		} else if ((rc == DNS_CACHE_NOT_FOUND) && cache->negative_ttl) {
+			entry->state = DNS_CACHE_NEGATIVE;
+			entry->addr = 0;
+			entry->expires = now + (uint64_t)cache->negative_ttl * 1000;
+		} else {
+			// Temporary failures are not cached, the waiters will try again
+			entry->state = DNS_CACHE_FREE;
+		}
+
+		entry->used = now;
+
+		ops->notify(cache->arg);
+	}
+
+	ops->unlock(cache->arg);
+
+	if (rc == DNS_CACHE_OK) {
+		*addr = resolved;
+	}
+
+	return rc;
+}
+
+void dns_cache_flush(dns_cache_t *cache, const char *name) {
+	dns_cache_entry_t *entry;
+	int i;
+
+	cache->ops->lock(cache->arg);
+
+	for(i = 0; i < cache->entries; i++) {
+		entry = &cache->entry[i];
+
+		if ((entry->state == DNS_CACHE_VALID) || (entry->state == DNS_CACHE_NEGATIVE)) {
+			if (!name || !strcasecmp(entry->name, name)) {
+				entry->state = DNS_CACHE_FREE;
+			}
+		}
+	}
+
+	cache->ops->unlock(cache->arg);
+}
+
+int dns_cache_query(uint8_t *buffer, uint16_t id, const char *name) {
+	uint8_t *p = buffer + 12;
+	uint8_t *label;
+	int len;
+
+	if (!*name || (strlen(name) > 253)) {
+		return -1;
+	}
+
+	// Header: id, recursion desired, 1 question
+	memset(buffer, 0, 12);
+	buffer[0] = id >> 8;
+	buffer[1] = id;
+	buffer[2] = 0x01;
+	buffer[5] = 1;
+
+	// Question name, as labels
+	while (*name) {
+		label = p++;
+		len = 0;
+
+		while (*name && (*name != '.')) {
+			*p++ = *name++;
+			len++;
+		}
+
+		if ((len == 0) || (len > 63)) {
+			return -1;
+		}
+
+		*label = len;
+
+		if (*name == '.') {
+			name++;
+		}
+	}
+
+	*p++ = 0;
+
+	// Type A, class IN
+	*p++ = 0;
+	*p++ = DNS_TYPE_A;
+	*p++ = 0;
+	*p++ = DNS_CLASS_IN;
+
+	return p - buffer;
+}
+
+int dns_cache_answer(const uint8_t *buffer, int len, uint16_t id, const char *name, uint32_t *addr, uint32_t *ttl) {
+	uint32_t min_ttl = 0xffffffff;
+	uint32_t record_ttl;
+	uint16_t type, class, rdlength;
+	int answers;
+	int rcode;
+	int pos;
+
+	if ((len < 12) || (get16(buffer) != id) || !(buffer[2] & 0x80)) {
+		return DNS_CACHE_ERROR;
+	}
+
+	rcode = buffer[3] & 0x0f;
+	if ((rcode != 0) && (rcode != DNS_RCODE_NAME_ERROR)) {
+		return DNS_CACHE_ERROR;
+	}
+
+	// The question must be the one in the query, so a late answer to other
+	// query with the same id is never cached for this name
+	if (get16(&buffer[4]) != 1) {
+		return DNS_CACHE_ERROR;
+	}
+
+	pos = match_name(buffer, len, 12, name);
+	if ((pos < 0) || (pos + 4 > len)) {
+		return DNS_CACHE_ERROR;
+	}
+
+	if ((get16(&buffer[pos]) != DNS_TYPE_A) || (get16(&buffer[pos + 2]) != DNS_CLASS_IN)) {
+		return DNS_CACHE_ERROR;
+	}
+
+	pos += 4;
+
+	if (rcode == DNS_RCODE_NAME_ERROR) {
+		return DNS_CACHE_NOT_FOUND;
+	}
+
+	answers = get16(&buffer[6]);
+
+	while (answers--) {
+		pos = skip_name(buffer, len, pos);
+		if ((pos < 0) || (pos + 10 > len)) {
+			return DNS_CACHE_ERROR;
+		}
+
+		type = get16(&buffer[pos]);
+		class = get16(&buffer[pos + 2]);
+		record_ttl = get32(&buffer[pos + 4]);
+		rdlength = get16(&buffer[pos + 8]);
+		pos += 10;
+
+		if (pos + rdlength > len) {
+			return DNS_CACHE_ERROR;
+		}
+
+		// TTLs with the high bit set are taken as 0 (RFC 2181)
+		if (record_ttl & 0x80000000) {
+			record_ttl = 0;
+		}
+
+		if ((class == DNS_CLASS_IN) && ((type == DNS_TYPE_A) || (type == DNS_TYPE_CNAME))) {
+			if (record_ttl < min_ttl) {
+				min_ttl = record_ttl;
+			}
+
+			if ((type == DNS_TYPE_A) && (rdlength == 4)) {
+				memcpy(addr, &buffer[pos], 4);
+				*ttl = min_ttl;
+
+				return DNS_CACHE_OK;
+			}
+		}
+
+		pos += rdlength;
+	}
+
+	// The name exists, but has no IPv4 address
+	return DNS_CACHE_NOT_FOUND;
+}
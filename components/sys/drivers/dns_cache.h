@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, DNS cache
+ *
+ * Resolved names are kept for the TTL of their DNS record, and names that
+ * don't exist for a short time. When a name is being resolved, other
+ * lookups of the same name wait for the same query, instead of sending
+ * their own one.
+ *
+ * The cache doesn't depend on the network stack, nor on the OS: the
+ * resolver, the clock, and the locking primitives are passed as a set of
+ * operations. The DNS messages for a resolver that talks directly to the
+ * DNS server (the only way to know the TTL of the record) are also built
+ * and parsed here.
+ *
+ */
+
+#ifndef _DRIVERS_DNS_CACHE_H_
+#define _DRIVERS_DNS_CACHE_H_
+
+#include <stdint.h>
+
+// Longest name that can be cached, longer names are always resolved
+#define DNS_CACHE_NAME_MAX 63
+
+// Results
+#define DNS_CACHE_OK         0
+#define DNS_CACHE_NOT_FOUND -1   ///< The name doesn't exist, or has no IPv4 address
+#define DNS_CACHE_ERROR     -2   ///< Temporary failure, the result is not cached
+
+// Buffer size for a query
+#define DNS_CACHE_QUERY_SIZE (12 + 255 + 1 + 4)
+
+// Entry states
+#define DNS_CACHE_FREE     0
+#define DNS_CACHE_PENDING  1  ///< Being resolved
+#define DNS_CACHE_VALID    2
+#define DNS_CACHE_NEGATIVE 3  ///< Not found
+
+typedef struct {
+	/**
+	 * Resolve a name. Returns DNS_CACHE_OK, with the IPv4 address (network
+	 * order) and the TTL of the record in seconds, DNS_CACHE_NOT_FOUND or
+	 * DNS_CACHE_ERROR. Called without the lock held.
+	 */
+	int (*resolve)(void *arg, const char *name, uint32_t *addr, uint32_t *ttl);
+
+	uint64_t (*now)(void *arg);  ///< Current time, in milliseconds, from a clock that doesn't wrap
+	void (*lock)(void *arg);
+	void (*unlock)(void *arg);
+	void (*wait)(void *arg);     ///< Called with the lock held: release it, wait for a notify, and lock again
+	void (*notify)(void *arg);   ///< Wake up all the waiters
+} dns_cache_ops_t;
+
+typedef struct {
+	char name[DNS_CACHE_NAME_MAX + 1];
+	uint32_t addr;     ///< IPv4 address, network order
+	uint64_t expires;  ///< Expiration time, in milliseconds
+	uint64_t used;     ///< Last use, in milliseconds
+	uint8_t state;
+} dns_cache_entry_t;
+
+typedef struct {
+	const dns_cache_ops_t *ops;
+	void *arg;
+	dns_cache_entry_t *entry;
+	int entries;
+	uint32_t max_ttl;       ///< Longer TTLs are reduced to this, in seconds
+	uint32_t negative_ttl;  ///< TTL for names not found, in seconds
+
+	// Statistics
+	uint32_t hits;
+	uint32_t misses;
+	uint32_t shared;        ///< Lookups that waited for a query in progress
+} dns_cache_t;
+
+/**
+ * @brief Init a cache.
+ *
+ * @param cache Cache.
+ * @param entry Entries.
+ * @param entries Number of entries.
+ * @param max_ttl Max. time a name is cached, in seconds.
+ * @param negative_ttl Time a name not found is cached, in seconds.
+ * @param ops Operations.
+ * @param arg Argument passed to the operations.
+ */
+void dns_cache_init(dns_cache_t *cache, dns_cache_entry_t *entry, int entries, uint32_t max_ttl,
+					uint32_t negative_ttl, const dns_cache_ops_t *ops, void *arg);
+
+/**
+ * @brief Get the address of a name, from the cache, or resolving it. If
+ *        the name is being resolved by another lookup, wait for it's result.
+ *
+ * @param cache Cache.
+ * @param name Name.
+ * @param addr IPv4 address, in network order.
+ *
+ * @return DNS_CACHE_OK, DNS_CACHE_NOT_FOUND or DNS_CACHE_ERROR.
+ */
+int dns_cache_lookup(dns_cache_t *cache, const char *name, uint32_t *addr);
+
+/**
+ * @brief Remove a name, or all the names, from the cache. Names that are
+ *        being resolved are not removed.
+ *
+ * @param cache Cache.
+ * @param name Name, or NULL for all the names.
+ */
+void dns_cache_flush(dns_cache_t *cache, const char *name);
+
+/**
+ * @brief Build a DNS query for the IPv4 address of a name (recursion
+ *        desired).
+ *
+ * @param buffer Buffer, of DNS_CACHE_QUERY_SIZE bytes at least.
+ * @param id Query id.
+ * @param name Name.
+ *
+ * @return Length of the query, or -1 if the name is not valid.
+ */
+int dns_cache_query(uint8_t *buffer, uint16_t id, const char *name);
+
+/**
+ * @brief Parse the answer to a query. CNAME records are followed, and the
+ *        TTL is the lowest one of the records up to the address.
+ *
+ * @param buffer Answer.
+ * @param len Answer length.
+ * @param id Query id.
+ * @param name Name in the query.
+ * @param addr IPv4 address, in network order.
+ * @param ttl TTL, in seconds.
+ *
+ * @return DNS_CACHE_OK, DNS_CACHE_NOT_FOUND (name error, or no address), or
+ *         DNS_CACHE_ERROR (server failure, or the answer is not valid or
+ *         doesn't match the query).
+ */
+int dns_cache_answer(const uint8_t *buffer, int len, uint16_t id, const char *name, uint32_t *addr, uint32_t *ttl);
+
+#endif /* _DRIVERS_DNS_CACHE_H_ */
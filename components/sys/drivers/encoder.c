@@ -79,8 +79,12 @@
 #include "freertos/task.h"
 #include "freertos/queue.h"
 #include "esp_attr.h"
+#include "esp_intr_alloc.h"
 #include "encoder.h"
 
+#include "driver/pcnt.h"
+#include "soc/pcnt_struct.h"
+
 #include <string.h>
 
 #include <sys/status.h>
@@ -94,6 +98,8 @@ DRIVER_REGISTER_BEGIN(ENCODER, encoder, 0, NULL, NULL);
     // Driver message errors
     DRIVER_REGISTER_ERROR(ENCODER, encoder, NotEnoughtMemory, "not enough memory", ENCODER_ERR_NOT_ENOUGH_MEMORY);
     DRIVER_REGISTER_ERROR(ENCODER, encoder, InvalidPin, "invalid pin", ENCODER_ERR_INVALID_PIN);
+    DRIVER_REGISTER_ERROR(ENCODER, encoder, NoMorePCNT, "no more pulse counter units available", ENCODER_ERR_NO_MORE_PCNT);
+    DRIVER_REGISTER_ERROR(ENCODER, encoder, InvalidArgument, "invalid argument", ENCODER_ERR_INVALID_ARGUMENT);
 DRIVER_REGISTER_END(ENCODER, encoder, 0, NULL, NULL);
 
 /*
@@ -161,8 +167,17 @@ const uint8_t ttable[7][4] = {
 
 static xQueueHandle queue = NULL;
 static TaskHandle_t task = NULL;
+static SemaphoreHandle_t synced = NULL;
 static uint8_t attached = 0;
 
+// Encoders in PCNT mode, by PCNT unit. A unit is claimed (pcnt_claimed) while
+// the encoder is set up, and then published in pcnt_units for the ISR. PCNT
+// encoders are not counted in attached, that is only for the GPIO ISR encoders.
+static encoder_h_t *pcnt_units[PCNT_UNIT_MAX];
+static uint32_t pcnt_claimed = 0;
+static intr_handle_t pcnt_isr_handle = NULL;
+static portMUX_TYPE pcnt_spinlock = portMUX_INITIALIZER_UNLOCKED;
+
 /*
  * Helper functions
  */
@@ -173,6 +188,17 @@ static void encoder_task(void *arg) {
     for(;;) {
         xQueueReceive(queue, &data, portMAX_DELAY);
 
+        if (!data.h) {
+        	// The events queued before are done. The task ends by itself
+        	// when it's asked to, as it can't be deleted inside a callback.
+        	xSemaphoreGive(synced);
+        	if (data.dir) {
+        		vTaskDelete(NULL);
+        	}
+
+        	continue;
+        }
+
         if (data.h->callback) {
         	data.h->callback(data.h->callback_id, data.dir, data.counter, data.button);
         }
@@ -235,6 +261,138 @@ static void IRAM_ATTR encoder_isr(void* arg) {
 	}
 }
 
+// Process the limit events of a PCNT unit, must be called with the
+// pcnt_spinlock held
+static void IRAM_ATTR encoder_pcnt_event(int unit) {
+	uint32_t status = PCNT.status_unit[unit].val;
+	uint32_t events = 0;
+
+	if (status & PCNT_STATUS_H_LIM_M) {
+		events |= ENCODER_COUNT_H_LIM;
+	}
+
+	if (status & PCNT_STATUS_L_LIM_M) {
+		events |= ENCODER_COUNT_L_LIM;
+	}
+
+	encoder_count_event(&pcnt_units[unit]->count, events);
+}
+
+static void IRAM_ATTR encoder_pcnt_isr(void *arg) {
+	uint32_t intr = PCNT.int_st.val;
+	int unit;
+
+	for (unit = 0; unit < PCNT_UNIT_MAX; unit++) {
+		if (intr & BIT(unit)) {
+			portENTER_CRITICAL_ISR(&pcnt_spinlock);
+
+			// Check again with the lock, encoder_pcnt_value can have
+			// processed and cleared the event in the other CPU
+			if (PCNT.int_st.val & BIT(unit)) {
+				if (pcnt_units[unit]) {
+					encoder_pcnt_event(unit);
+				}
+				PCNT.int_clr.val = BIT(unit);
+			}
+
+			portEXIT_CRITICAL_ISR(&pcnt_spinlock);
+		}
+	}
+}
+
+// Get the 64 bits count of an encoder in PCNT mode
+static int64_t encoder_pcnt_value(encoder_h_t *h) {
+	int16_t counter;
+	int64_t value;
+
+	portENTER_CRITICAL(&pcnt_spinlock);
+
+	counter = (int16_t)PCNT.cnt_unit[h->unit].cnt_val;
+
+	if (PCNT.int_raw.val & BIT(h->unit)) {
+		// A limit was reached, but the ISR has not processed it yet, so
+		// process it here, and read the counter again
+		encoder_pcnt_event(h->unit);
+		PCNT.int_clr.val = BIT(h->unit);
+
+		counter = (int16_t)PCNT.cnt_unit[h->unit].cnt_val;
+	}
+
+	value = encoder_count_value(&h->count, counter);
+
+	portEXIT_CRITICAL(&pcnt_spinlock);
+
+	return value;
+}
+
+static void encoder_pcnt_write(encoder_h_t *h, int64_t value) {
+	portENTER_CRITICAL(&pcnt_spinlock);
+
+	// Reset the counter, and discard pending limit events
+	PCNT.ctrl.val |= BIT(h->unit * 2);
+	PCNT.ctrl.val &= ~BIT(h->unit * 2);
+	PCNT.int_clr.val = BIT(h->unit);
+
+	encoder_count_set(&h->count, value);
+
+	portEXIT_CRITICAL(&pcnt_spinlock);
+}
+
+// Release a PCNT unit, and the PCNT ISR if no unit is in use
+static void encoder_pcnt_release(int unit) {
+	uint32_t claimed;
+
+	portENTER_CRITICAL(&pcnt_spinlock);
+	pcnt_units[unit] = NULL;
+	pcnt_claimed &= ~BIT(unit);
+	claimed = pcnt_claimed;
+	portEXIT_CRITICAL(&pcnt_spinlock);
+
+	if (!claimed && pcnt_isr_handle) {
+		esp_intr_free(pcnt_isr_handle);
+		pcnt_isr_handle = NULL;
+	}
+}
+
+static void encoder_rate_task(void *arg) {
+	encoder_h_t *h = (encoder_h_t *)arg;
+	int32_t delta, velocity;
+	TickType_t ticks;
+	int64_t value;
+
+	ticks = h->rate.interval / portTICK_PERIOD_MS;
+	if (ticks == 0) {
+		ticks = 1;
+	}
+
+	for(;;) {
+		if (xSemaphoreTake(h->rate_stop, ticks) == pdTRUE) {
+			break;
+		}
+
+		value = encoder_pcnt_value(h);
+		if (encoder_rate_update(&h->rate, value, xTaskGetTickCount() * portTICK_PERIOD_MS, &delta, &velocity)) {
+			h->rate_callback(h->callback_id, value, delta, velocity);
+		}
+	}
+
+	// The task ends by itself, as it can't be deleted inside a callback
+	xSemaphoreGive(h->rate_stopped);
+	vTaskDelete(NULL);
+}
+
+// Stop the notifications task of a PCNT encoder, and wait for it
+static void encoder_rate_stop(encoder_h_t *h) {
+	if (!h->rate_task) {
+		return;
+	}
+
+	xSemaphoreGive(h->rate_stop);
+	xSemaphoreTake(h->rate_stopped, portMAX_DELAY);
+
+	h->rate_task = NULL;
+}
+
 /*
  * Operation functions
  */
@@ -288,6 +446,7 @@ driver_error_t *encoder_setup(int8_t a, int8_t b, int8_t sw, encoder_h_t **h) {
     encoder->B = b;
     encoder->SW = sw;
     encoder->state = R_START;
+    encoder->unit = -1;
 
     gpio_pin_input(a);
     gpio_pin_input(b);
@@ -308,6 +467,37 @@ driver_error_t *encoder_setup(int8_t a, int8_t b, int8_t sw, encoder_h_t **h) {
 }
 
 driver_error_t *encoder_unsetup(encoder_h_t *h) {
+	encoder_deferred_data_t data;
+	uint8_t last;
+
+	if (h->unit >= 0) {
+		if (h->rate_task && (xTaskGetCurrentTaskHandle() == h->rate_task)) {
+			return driver_error(ENCODER_DRIVER, ENCODER_ERR_INVALID_ARGUMENT, "not allowed inside the callback");
+		}
+
+		// Stop the PCNT unit, and it's notifications task
+		encoder_rate_stop(h);
+
+		if (h->rate_stop) {
+			vSemaphoreDelete(h->rate_stop);
+			vSemaphoreDelete(h->rate_stopped);
+		}
+
+		pcnt_intr_disable(h->unit);
+		pcnt_counter_pause(h->unit);
+
+		encoder_pcnt_release(h->unit);
+
+#if CONFIG_LUA_RTOS_USE_HARDWARE_LOCKS
+		driver_unlock(ENCODER_DRIVER, 0, GPIO_DRIVER, h->A);
+		driver_unlock(ENCODER_DRIVER, 0, GPIO_DRIVER, h->B);
+#endif
+
+		free(h);
+
+		return NULL;
+	}
+
 	portDISABLE_INTERRUPTS();
 
 	if (attached == 0) {
@@ -317,12 +507,10 @@ driver_error_t *encoder_unsetup(encoder_h_t *h) {
 
 	// Remove interrupts
 	gpio_isr_detach(h->A);
-#if CONFIG_LUA_RTOS_USE_HARDWARE_LOCKS
-    driver_unlock(ENCODER_DRIVER, 0, GPIO_DRIVER, h->A);
-#endif
+	gpio_isr_detach(h->B);
 
-    gpio_isr_detach(h->B);
 #if CONFIG_LUA_RTOS_USE_HARDWARE_LOCKS
+    driver_unlock(ENCODER_DRIVER, 0, GPIO_DRIVER, h->A);
     driver_unlock(ENCODER_DRIVER, 0, GPIO_DRIVER, h->B);
 #endif
 
@@ -333,28 +521,43 @@ driver_error_t *encoder_unsetup(encoder_h_t *h) {
 #endif
 	}
 
-	if (attached == 1) {
-		if (task) {
-			vTaskDelete(task);
+	last = (--attached == 0);
+
+	portENABLE_INTERRUPTS();
+
+	// Wait for the deferred callbacks queued before, and stop the task if
+	// it was the last encoder. Inside a callback the task is kept.
+	if (task && (xTaskGetCurrentTaskHandle() != task)) {
+		data.h = NULL;
+		data.dir = last;
+
+		xQueueSend(queue, &data, portMAX_DELAY);
+		xSemaphoreTake(synced, portMAX_DELAY);
+
+		if (last) {
 			task = NULL;
-		}
 
-		if (queue) {
 			vQueueDelete(queue);
 			queue = NULL;
+
+			vSemaphoreDelete(synced);
+			synced = NULL;
 		}
 	}
 
-	attached--;
-
 	free(h);
 
-	portENABLE_INTERRUPTS();
-
 	return NULL;
 }
 
 driver_error_t *encoder_read(encoder_h_t *h, int32_t *val, uint8_t *sw) {
+	if (h->unit >= 0) {
+		*val = (int32_t)encoder_pcnt_value(h);
+		*sw = 0;
+
+		return NULL;
+	}
+
 	portDISABLE_INTERRUPTS();
 	*val = h->counter;
 	*sw = h->sw_latch;
@@ -364,6 +567,12 @@ driver_error_t *encoder_read(encoder_h_t *h, int32_t *val, uint8_t *sw) {
 }
 
 driver_error_t *encoder_write(encoder_h_t *h, int32_t val) {
+	if (h->unit >= 0) {
+		encoder_pcnt_write(h, val);
+
+		return NULL;
+	}
+
 	portDISABLE_INTERRUPTS();
 	h->counter = val;
 	portENABLE_INTERRUPTS();
@@ -387,6 +596,14 @@ driver_error_t *encoder_register_callback(encoder_h_t *h, encoder_callback_t cal
 			}
 		}
 
+		if (!synced) {
+			synced = xSemaphoreCreateBinary();
+			if (!synced) {
+				portENABLE_INTERRUPTS();
+				return driver_error(ENCODER_DRIVER, ENCODER_ERR_NOT_ENOUGH_MEMORY, NULL);
+			}
+		}
+
 		if (!task) {
 			BaseType_t xReturn;
 
@@ -402,3 +619,192 @@ driver_error_t *encoder_register_callback(encoder_h_t *h, encoder_callback_t cal
 
 	return NULL;
 }
+
+driver_error_t *encoder_setup_pcnt(int8_t a, int8_t b, uint16_t filter, encoder_h_t **h) {
+#if CONFIG_LUA_RTOS_USE_HARDWARE_LOCKS
+	driver_unit_lock_error_t *lock_error = NULL;
+#endif
+	driver_error_t *error;
+	pcnt_config_t config;
+	int unit;
+
+	// Sanity checks
+	if (!GPIO_CHECK_INPUT(a)) {
+		return driver_error(ENCODER_DRIVER, ENCODER_ERR_INVALID_PIN, "A, must be an input PIN");
+	}
+
+	if (!GPIO_CHECK_INPUT(b)) {
+		return driver_error(ENCODER_DRIVER, ENCODER_ERR_INVALID_PIN, "B, must be an input PIN");
+	}
+
+	if (filter > 1023) {
+		return driver_error(ENCODER_DRIVER, ENCODER_ERR_INVALID_ARGUMENT, "filter, must be between 0 and 1023");
+	}
+
+	// Get a free PCNT unit, and claim it
+	portENTER_CRITICAL(&pcnt_spinlock);
+	for (unit = 0; unit < PCNT_UNIT_MAX; unit++) {
+		if (!(pcnt_claimed & BIT(unit))) {
+			pcnt_claimed |= BIT(unit);
+			break;
+		}
+	}
+	portEXIT_CRITICAL(&pcnt_spinlock);
+
+	if (unit == PCNT_UNIT_MAX) {
+		return driver_error(ENCODER_DRIVER, ENCODER_ERR_NO_MORE_PCNT, NULL);
+	}
+
+#if CONFIG_LUA_RTOS_USE_HARDWARE_LOCKS
+	// Lock resources
+    if ((lock_error = driver_lock(ENCODER_DRIVER, 0, GPIO_DRIVER, a, 0, "A"))) {
+    	// Revoked lock on pin
+    	encoder_pcnt_release(unit);
+    	return driver_lock_error(ENCODER_DRIVER, lock_error);
+    }
+
+    if ((lock_error = driver_lock(ENCODER_DRIVER, 0, GPIO_DRIVER, b, 0, "B"))) {
+    	// Revoked lock on pin
+    	driver_unlock(ENCODER_DRIVER, 0, GPIO_DRIVER, a);
+    	encoder_pcnt_release(unit);
+    	return driver_lock_error(ENCODER_DRIVER, lock_error);
+    }
+#endif
+
+    // Allocate space for the encoder
+    encoder_h_t *encoder = calloc(1, sizeof(encoder_h_t));
+    if (!encoder) {
+    	error = driver_error(ENCODER_DRIVER, ENCODER_ERR_NOT_ENOUGH_MEMORY, NULL);
+    	goto unwind;
+    }
+
+    encoder->A = a;
+    encoder->B = b;
+    encoder->SW = -1;
+    encoder->unit = unit;
+
+    encoder_count_init(&encoder->count, ENCODER_PCNT_H_LIM, ENCODER_PCNT_L_LIM);
+
+    // Quadrature decoding, counting both edges of A and B. Channel 0 counts
+    // edges on A, in the direction given by B, and channel 1 counts edges
+    // on B, in the direction given by A.
+    config.pulse_gpio_num = a;
+    config.ctrl_gpio_num = b;
+    config.channel = PCNT_CHANNEL_0;
+    config.unit = unit;
+    config.pos_mode = PCNT_COUNT_DEC;
+    config.neg_mode = PCNT_COUNT_INC;
+    config.lctrl_mode = PCNT_MODE_REVERSE;
+    config.hctrl_mode = PCNT_MODE_KEEP;
+    config.counter_h_lim = ENCODER_PCNT_H_LIM;
+    config.counter_l_lim = ENCODER_PCNT_L_LIM;
+
+    pcnt_unit_config(&config);
+
+    config.pulse_gpio_num = b;
+    config.ctrl_gpio_num = a;
+    config.channel = PCNT_CHANNEL_1;
+    config.pos_mode = PCNT_COUNT_INC;
+    config.neg_mode = PCNT_COUNT_DEC;
+
+    pcnt_unit_config(&config);
+
+    // Glitch filter
+    if (filter > 0) {
+        pcnt_set_filter_value(unit, filter);
+        pcnt_filter_enable(unit);
+    } else {
+        pcnt_filter_disable(unit);
+    }
+
+    // Counter resets when a limit is reached, and the limit is accumulated
+    // in the ISR
+    pcnt_event_enable(unit, PCNT_EVT_H_LIM);
+    pcnt_event_enable(unit, PCNT_EVT_L_LIM);
+
+    pcnt_counter_pause(unit);
+    pcnt_counter_clear(unit);
+
+    if (!pcnt_isr_handle) {
+        if (pcnt_isr_register(encoder_pcnt_isr, NULL, ESP_INTR_FLAG_IRAM, &pcnt_isr_handle) != ESP_OK) {
+            free(encoder);
+
+            error = driver_error(ENCODER_DRIVER, ENCODER_ERR_NOT_ENOUGH_MEMORY, NULL);
+            goto unwind;
+        }
+    }
+
+    portENTER_CRITICAL(&pcnt_spinlock);
+    pcnt_units[unit] = encoder;
+    portEXIT_CRITICAL(&pcnt_spinlock);
+
+    pcnt_intr_enable(unit);
+    pcnt_counter_resume(unit);
+
+    *h = encoder;
+
+    return NULL;
+
+unwind:
+#if CONFIG_LUA_RTOS_USE_HARDWARE_LOCKS
+    driver_unlock(ENCODER_DRIVER, 0, GPIO_DRIVER, a);
+    driver_unlock(ENCODER_DRIVER, 0, GPIO_DRIVER, b);
+#endif
+
+    encoder_pcnt_release(unit);
+
+    return error;
+}
+
+driver_error_t *encoder_register_rate_callback(encoder_h_t *h, encoder_rate_callback_t callback, int callback_id, uint32_t interval) {
+	BaseType_t xReturn;
+
+	if ((h->unit < 0) || (interval == 0)) {
+		return driver_error(ENCODER_DRIVER, ENCODER_ERR_INVALID_ARGUMENT, "only for PCNT encoders, with an interval > 0");
+	}
+
+	if (h->rate_task && (xTaskGetCurrentTaskHandle() == h->rate_task)) {
+		return driver_error(ENCODER_DRIVER, ENCODER_ERR_INVALID_ARGUMENT, "not allowed inside the callback");
+	}
+
+	encoder_rate_stop(h);
+
+	if (!h->rate_stop) {
+		h->rate_stop = xSemaphoreCreateBinary();
+		h->rate_stopped = xSemaphoreCreateBinary();
+
+		if (!h->rate_stop || !h->rate_stopped) {
+			if (h->rate_stop) vSemaphoreDelete(h->rate_stop);
+			if (h->rate_stopped) vSemaphoreDelete(h->rate_stopped);
+			h->rate_stop = NULL;
+			h->rate_stopped = NULL;
+
+			return driver_error(ENCODER_DRIVER, ENCODER_ERR_NOT_ENOUGH_MEMORY, NULL);
+		}
+	}
+
+	h->rate_callback = callback;
+	h->callback_id = callback_id;
+
+	encoder_rate_init(&h->rate, encoder_pcnt_value(h), xTaskGetTickCount() * portTICK_PERIOD_MS, interval);
+
+	xReturn = xTaskCreatePinnedToCore(encoder_rate_task, "encoder", CONFIG_LUA_RTOS_LUA_THREAD_STACK_SIZE, h, CONFIG_LUA_RTOS_LUA_THREAD_PRIORITY, &h->rate_task, xPortGetCoreID());
+	if (xReturn != pdPASS) {
+		h->rate_task = NULL;
+		return driver_error(ENCODER_DRIVER, ENCODER_ERR_NOT_ENOUGH_MEMORY, NULL);
+	}
+
+	return NULL;
+}
+
+driver_error_t *encoder_read64(encoder_h_t *h, int64_t *val) {
+	if (h->unit >= 0) {
+		*val = encoder_pcnt_value(h);
+	} else {
+		portDISABLE_INTERRUPTS();
+		*val = h->counter;
+		portENABLE_INTERRUPTS();
+	}
+
+	return NULL;
+}
@@ -48,10 +48,23 @@
 
 #include <stdint.h>
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
 #include <sys/driver.h>
+#include <sys/drivers/encoder_count.h>
+
+// Limits of the PCNT counter in PCNT mode. When a limit is reached the
+// counter resets, and the limit is accumulated in a 64 bits count.
+#define ENCODER_PCNT_H_LIM  32000
+#define ENCODER_PCNT_L_LIM -32000
 
 typedef void (*encoder_callback_t)(int, int8_t, uint32_t, uint8_t);
 
+// PCNT mode callback: id, count, delta and velocity (counts per second)
+typedef void (*encoder_rate_callback_t)(int, int64_t, int32_t, int32_t);
+
 typedef struct {
 	int8_t A;            		 ///< A pin
 	int8_t B;            		 ///< B pin
@@ -62,6 +75,13 @@ typedef struct {
 	encoder_callback_t callback; ///< Callback function
 	int callback_id;             ///< Callback id
 	uint8_t deferred;            ///< Deferred callback?
+	int8_t unit;                 ///< PCNT unit, -1 if PCNT is not used
+	encoder_count_t count;       ///< Extended PCNT count
+	encoder_rate_t rate;         ///< PCNT notifications rate limiter
+	encoder_rate_callback_t rate_callback; ///< PCNT notifications callback
+	TaskHandle_t rate_task;      ///< PCNT notifications task
+	SemaphoreHandle_t rate_stop;    ///< Given to stop the notifications task
+	SemaphoreHandle_t rate_stopped; ///< Given by the notifications task when it ends
 } encoder_h_t;
 
 typedef struct {
@@ -74,6 +94,8 @@ typedef struct {
 // Encoder errors
 #define ENCODER_ERR_NOT_ENOUGH_MEMORY           (DRIVER_EXCEPTION_BASE(ENCODER_DRIVER_ID) |  0)
 #define ENCODER_ERR_INVALID_PIN                 (DRIVER_EXCEPTION_BASE(ENCODER_DRIVER_ID) |  1)
+#define ENCODER_ERR_NO_MORE_PCNT                (DRIVER_EXCEPTION_BASE(ENCODER_DRIVER_ID) |  2)
+#define ENCODER_ERR_INVALID_ARGUMENT            (DRIVER_EXCEPTION_BASE(ENCODER_DRIVER_ID) |  3)
 
 extern const int encoder_errors;
 extern const int encoder_error_map;
@@ -84,4 +106,57 @@ driver_error_t *encoder_register_callback(encoder_h_t *h, encoder_callback_t cal
 driver_error_t *encoder_read(encoder_h_t *h, int32_t *val, uint8_t *sw);
 driver_error_t *encoder_write(encoder_h_t *h, int32_t val);
 
+/**
+ * @brief Setup an encoder decoded by a pulse counter (PCNT) unit, without
+ *        interrupts on each edge. The count is incremented / decremented on
+ *        each edge of A and B (4 counts per encoder cycle), and extended to
+ *        64 bits.
+ *
+ * @param a A pin.
+ * @param b B pin.
+ * @param filter Glitch filter, pulses shorter than filter APB clock cycles
+ *               (12.5 ns) are ignored. 0 disables the filter, max is 1023.
+ * @param h Encoder handle.
+ *
+ * @return
+ *     - NULL success
+ *     - Pointer to driver_error_t if some error occurs.
+ *
+ *          ENCODER_ERR_INVALID_PIN
+ *          ENCODER_ERR_INVALID_ARGUMENT
+ *          ENCODER_ERR_NO_MORE_PCNT
+ *          ENCODER_ERR_NOT_ENOUGH_MEMORY
+ */
+driver_error_t *encoder_setup_pcnt(int8_t a, int8_t b, uint16_t filter, encoder_h_t **h);
+
+/**
+ * @brief Register a callback for an encoder in PCNT mode, that is called at
+ *        most each interval milliseconds with the count, the delta since the
+ *        last call, and the velocity, when the count changes.
+ *
+ * @param h Encoder handle.
+ * @param callback Callback.
+ * @param id Callback id.
+ * @param interval Minimum time between calls, in milliseconds.
+ *
+ * @return
+ *     - NULL success
+ *     - Pointer to driver_error_t if some error occurs.
+ *
+ *          ENCODER_ERR_INVALID_ARGUMENT
+ *          ENCODER_ERR_NOT_ENOUGH_MEMORY
+ */
+driver_error_t *encoder_register_rate_callback(encoder_h_t *h, encoder_rate_callback_t callback, int id, uint32_t interval);
+
+/**
+ * @brief Read the 64 bits count of an encoder.
+ *
+ * @param h Encoder handle.
+ * @param val Count.
+ *
+ * @return
+ *     - NULL success
+ */
+driver_error_t *encoder_read64(encoder_h_t *h, int64_t *val);
+
 #endif	/* ENCODER_H */
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, encoder counter extension and rate limiting
+ *
+ */
+
+#include <sys/drivers/encoder_count.h>
+
+/*
+ * Operation functions
+ */
+void encoder_count_init(encoder_count_t *count, int16_t h_lim, int16_t l_lim) {
+	count->base = 0;
+	count->h_lim = h_lim;
+	count->l_lim = l_lim;
+}
+
+void encoder_count_set(encoder_count_t *count, int64_t value) {
+	count->base = value;
+}
+
+void encoder_rate_init(encoder_rate_t *rate, int64_t count, uint32_t now, uint32_t interval) {
+	rate->last = count;
+	rate->time = now;
+	rate->interval = interval;
+	rate->moving = 0;
+}
+
+int encoder_rate_update(encoder_rate_t *rate, int64_t count, uint32_t now, int32_t *delta, int32_t *velocity) {
+	uint32_t elapsed = now - rate->time;
+
+	if ((elapsed < rate->interval) || (elapsed == 0)) {
+		return 0;
+	}
+
+	*delta = (int32_t)(count - rate->last);
+	if ((*delta == 0) && !rate->moving) {
+		// Nothing changed, and 0 velocity was already notified
+		rate->time = now;
+		return 0;
+	}
+
+	*velocity = (int32_t)(((int64_t)*delta * 1000) / (int64_t)elapsed);
+
+	rate->last = count;
+	rate->time = now;
+	rate->moving = (*delta != 0);
+
+	return 1;
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, encoder counter extension and rate limiting
+ *
+ * The pulse counter (PCNT) counter is 16 bits wide. It's configured to reset
+ * when it reaches it's high or low limit, and the limit events are
+ * accumulated in a 64 bits base, so the encoder count is base + counter.
+ *
+ */
+
+#ifndef _DRIVERS_ENCODER_COUNT_H_
+#define _DRIVERS_ENCODER_COUNT_H_
+
+#include <stdint.h>
+
+// Limit events
+#define ENCODER_COUNT_H_LIM 0x01
+#define ENCODER_COUNT_L_LIM 0x02
+
+typedef struct {
+	int64_t base;       // Counts accumulated on limit events
+	int16_t h_lim;      // High limit
+	int16_t l_lim;      // Low limit
+} encoder_count_t;
+
+typedef struct {
+	int64_t last;       // Count at the last notification
+	uint32_t time;      // Time of the last notification, in milliseconds
+	uint32_t interval;  // Minimum time between notifications, in milliseconds
+	uint8_t moving;     // Last notification had a velocity != 0
+} encoder_rate_t;
+
+/**
+ * @brief Initialize a counter extension.
+ *
+ * @param count Counter extension.
+ * @param h_lim High limit of the hardware counter (> 0).
+ * @param l_lim Low limit of the hardware counter (< 0).
+ */
+void encoder_count_init(encoder_count_t *count, int16_t h_lim, int16_t l_lim);
+
+/**
+ * @brief Process the limit events of the hardware counter. Must be called
+ *        each time the hardware counter reaches a limit, and resets. It's
+ *        inline because it's called from the PCNT ISR.
+ *
+ * @param count Counter extension.
+ * @param status Limit events (ENCODER_COUNT_L_LIM / ENCODER_COUNT_H_LIM).
+ */
+static inline void encoder_count_event(encoder_count_t *count, uint32_t status) {
+	if (status & ENCODER_COUNT_H_LIM) {
+		count->base += count->h_lim;
+	}
+
+	if (status & ENCODER_COUNT_L_LIM) {
+		count->base += count->l_lim;
+	}
+}
+
+/**
+ * @brief Get the extended count.
+ *
+ * @param count Counter extension.
+ * @param counter Hardware counter value. If a limit event is pending, it
+ *                must be processed, and the hardware counter read again.
+ *
+ * @return Extended count.
+ */
+static inline int64_t encoder_count_value(const encoder_count_t *count, int16_t counter) {
+	return count->base + counter;
+}
+
+/**
+ * @brief Set the extended count. The hardware counter must be cleared.
+ *
+ * @param count Counter extension.
+ * @param value New count.
+ */
+void encoder_count_set(encoder_count_t *count, int64_t value);
+
+/**
+ * @brief Initialize a rate limiter for the count notifications.
+ *
+ * @param rate Rate limiter.
+ * @param count Current count.
+ * @param now Current time, in milliseconds.
+ * @param interval Minimum time between notifications, in milliseconds.
+ */
+void encoder_rate_init(encoder_rate_t *rate, int64_t count, uint32_t now, uint32_t interval);
+
+/**
+ * @brief Check if a notification must be sent. A notification is sent if the
+ *        interval has elapsed since the last one and the count has changed,
+ *        and once when the count stops changing (with a 0 velocity).
+ *
+ * @param rate Rate limiter.
+ * @param count Current count.
+ * @param now Current time, in milliseconds.
+ * @param delta Count change since the last notification.
+ * @param velocity Counts per second since the last notification.
+ *
+ * @return 1 if a notification must be sent, 0 if not.
+ */
+int encoder_rate_update(encoder_rate_t *rate, int64_t count, uint32_t now, int32_t *delta, int32_t *velocity);
+
+#endif /* _DRIVERS_ENCODER_COUNT_H_ */
@@ -46,6 +46,7 @@
 #include "esp_err.h"
 #include "esp_attr.h"
 #include "driver/timer.h"
+#include "esp_timer.h"
 
 #include <string.h>
 
@@ -58,9 +59,6 @@
 // Debouncing data
 static debouncing_t *debouncing = NULL;
 
-// Max threshold data
-static uint32_t max_threshold = 0;
-
 void IRAM_ATTR gpio_isr(void *args) {
     uint8_t pin = ((uint32_t)args);
 
@@ -84,6 +82,21 @@ void IRAM_ATTR gpio_isr(void *args) {
     }
 }
 
+// Call the callbacks of the GPIO that changed in a tick
+static void IRAM_ATTR debouncing_dispatch(uint64_t changed, uint64_t latch, uint8_t first) {
+    uint8_t bit, pin;
+
+    while (changed) {
+        bit = __builtin_ctzll(changed);
+        changed &= changed - 1;
+
+        pin = first + bit;
+        if (debouncing->callback[pin]) {
+            debouncing->callback[pin](debouncing->arg[pin], (latch >> bit) & 1);
+        }
+    }
+}
+
 void IRAM_ATTR debouncing_isr(void *args) {
 #if !EXTERNAL_GPIO
     if (debouncing->mask == 0) {
@@ -113,81 +126,28 @@ void IRAM_ATTR debouncing_isr(void *args) {
     }
 #endif
 
-    // Get all GPIO values
-    uint64_t current = (((uint64_t)GPIO.in1.data << 32) | GPIO.in) & debouncing->mask;
-
-#if EXTERNAL_GPIO
-    uint64_t current_ext = gpio_ext_pin_get_all(&current_ext) & debouncing->mask_ext;
-#endif
+    // Get the time of the tick
+    uint32_t now = (uint32_t)esp_timer_get_time();
 
-    // Test for changes
-    uint64_t mask = 1;
-    uint8_t i;
-
-    // Internal
-    for(i = CPU_FIRST_GPIO;i < 40;i++) {
-        if (mask & debouncing->mask) {
-            if ((debouncing->latch & mask) != (current & mask)) {
-                // GPIO has changed
-                if (!((debouncing->time[i] <= debouncing->threshold[i]))) {
-                    if (debouncing->callback[i]) {
-                        debouncing->callback[i](debouncing->arg[i], (current & mask) != 0);
-                    }
-
-                    // Set new value
-                    if (current & mask) {
-                        debouncing->latch |= mask;
-                    } else {
-                        debouncing->latch &= ~mask;
-                    }
-
-                    // Set GPIO time to 0
-                    debouncing->time[i] = 0;
-
-                    // Clear mask
-                    debouncing->mask &= ~mask;
-                } else {
-                    // Increment time for GPIO
-                    debouncing->time[i]++;
-                }
-            }
-        }
+    // Debounce all internal GPIO at once
+    uint64_t current = ((uint64_t)GPIO.in1.data << 32) | GPIO.in;
+    uint64_t changed = gpio_debouncing_bank_tick(&debouncing->bank, current, &debouncing->mask);
 
-        mask = mask << 1;
+    if (changed) {
+        gpio_debouncing_ring_put(&debouncing->ring, changed, debouncing->bank.latch, 0, now);
+        debouncing_dispatch(changed, debouncing->bank.latch, 0);
     }
 
     // External
     #if EXTERNAL_GPIO
-    mask = 1;
-    for(i= 40;i <= CPU_LAST_GPIO;i++) {
-        if (mask & debouncing->mask_ext) {
-            if ((debouncing->latch_ext & mask) != (current_ext & mask)) {
-                // GPIO has changed
-                if (!((debouncing->time[i] <= debouncing->threshold[i]))) {
-                    if (debouncing->callback[i]) {
-                        debouncing->callback[i](debouncing->arg[i], (current_ext & mask) != 0);
-                    }
-
-                    // Set new value
-                    if (current_ext & mask) {
-                        debouncing->latch_ext |= mask;
-                    } else {
-                        debouncing->latch_ext &= ~mask;
-                    }
-
-                    // Set GPIO time to 0
-                    debouncing->time[i] = 0;
-
-                    // Clear mask
-                    debouncing->mask_ext &= ~mask;
-                } else {
-                    // Increment time for GPIO
-                    debouncing->time[i]++;
-                }
-            }
-        }
+    if (debouncing->mask_ext) {
+        uint64_t current_ext = gpio_ext_pin_get_all(&current_ext);
 
-        mask = mask << 1;
+        changed = gpio_debouncing_bank_tick(&debouncing->bank_ext, current_ext, &debouncing->mask_ext);
+        if (changed) {
+            gpio_debouncing_ring_put(&debouncing->ring, changed, debouncing->bank_ext.latch, 40, now);
+            debouncing_dispatch(changed, debouncing->bank_ext.latch, 40);
+        }
     }
     #endif
 }
@@ -233,37 +193,39 @@ driver_error_t *gpio_debouncing_register(uint8_t pin, uint16_t threshold, gpio_d
 #endif
         }
 
-        // Get initial state
-        if (gpio_ll_pin_get(pin)) {
-            if (pin < 40) {
-                debouncing->latch |= (GPIO_BIT_MASK << pin);
-            }
-            #if EXTERNAL_GPIO
-            else {
-                debouncing->latch_ext |= (GPIO_BIT_MASK << (pin - 40));
-            }
-            #endif
-        } else {
-            if (pin < 40) {
-                debouncing->latch &= ~(GPIO_BIT_MASK << pin);
-            }
-            #if EXTERNAL_GPIO
-            else {
-                debouncing->latch_ext &= ~(GPIO_BIT_MASK << (pin - 40));
+        // Get initial state, and store threshold value in timer period units (round-up)
+        uint32_t ticks = (threshold + (GPIO_DEBOUNCING_PERIOD - 1)) / GPIO_DEBOUNCING_PERIOD;
+
+        // Read the pin before disabling the interrupts, because reading an
+        // external GPIO takes a mutex, or does a SPI transfer
+        uint8_t level = gpio_ll_pin_get(pin);
+
+        portDISABLE_INTERRUPTS();
+        if (pin < 40) {
+            if (level) {
+                debouncing->bank.latch |= (GPIO_BIT_MASK << pin);
+            } else {
+                debouncing->bank.latch &= ~(GPIO_BIT_MASK << pin);
             }
-            #endif
+
+            gpio_debouncing_bank_threshold(&debouncing->bank, pin, ticks);
         }
+        #if EXTERNAL_GPIO
+        else {
+            if (level) {
+                debouncing->bank_ext.latch |= (GPIO_BIT_MASK << (pin - 40));
+            } else {
+                debouncing->bank_ext.latch &= ~(GPIO_BIT_MASK << (pin - 40));
+            }
 
-        // Store threshold value in timer period units (round-up)
-        debouncing->threshold[pin] = (threshold + (GPIO_DEBOUNCING_PERIOD - 1)) / GPIO_DEBOUNCING_PERIOD;
+            gpio_debouncing_bank_threshold(&debouncing->bank_ext, pin - 40, ticks);
+        }
+        #endif
 
         // Store callback
         debouncing->callback[pin] = callback;
         debouncing->arg[pin] = args;
-
-        if (debouncing->threshold[pin] > max_threshold) {
-            max_threshold = debouncing->threshold[pin];
-        }
+        portENABLE_INTERRUPTS();
 
         gpio_isr_attach(pin, gpio_isr, GPIO_PIN_INTR_ANYEDGE, (void *)((uint32_t)pin));
     } else {
@@ -288,18 +250,50 @@ driver_error_t *gpio_debouncing_register(uint8_t pin, uint16_t threshold, gpio_d
 }
 
 driver_error_t *gpio_debouncing_unregister(uint8_t pin) {
+    driver_error_t *error;
+
     if (debouncing) {
+        // Stop edges on the GPIO before removing it from the debouncing masks
+        if ((error = gpio_isr_detach(pin))) {
+            return error;
+        }
+
         portDISABLE_INTERRUPTS();
         debouncing->arg[pin] = NULL;
         debouncing->callback[pin] = NULL;
-        debouncing->threshold[pin] = 0;
-        debouncing->time[pin] = 0;
+
+        if (pin < 40) {
+            debouncing->mask &= ~(GPIO_BIT_MASK << pin);
+            gpio_debouncing_bank_threshold(&debouncing->bank, pin, 0);
+        }
+        #if EXTERNAL_GPIO
+        else {
+            debouncing->mask_ext &= ~(GPIO_BIT_MASK << (pin - 40));
+            gpio_debouncing_bank_threshold(&debouncing->bank_ext, pin - 40, 0);
+        }
+        #endif
         portENABLE_INTERRUPTS();
     }
 
     return NULL;
 }
 
+int gpio_debouncing_get_events(gpio_debouncing_event_t *event, int max, uint32_t *dropped) {
+    if (!debouncing) {
+        if (dropped) {
+            *dropped = 0;
+        }
+
+        return 0;
+    }
+
+    if (dropped) {
+        *dropped = debouncing->ring.dropped;
+    }
+
+    return gpio_debouncing_ring_get(&debouncing->ring, event, max);
+}
+
 void gpio_debouncing_force_isr(void *args) {
     gpio_isr(args);
 }
@@ -49,20 +49,20 @@
 #include <sys/mutex.h>
 
 #include <drivers/cpu.h>
+#include <drivers/gpio_debouncing_core.h>
 
 typedef void (*gpio_debouncing_callback_t)(void *, uint8_t);
 
 typedef struct {
-	uint64_t mask;  	///< Mask. If bit i = 1 on mask, internal GPIO(i) is debounced
-	uint64_t latch; 	///< Internal latch values
+	uint64_t mask;  	///< Mask. If bit i = 1 on mask, internal GPIO(i) has an edge pending to debounce
+	gpio_debouncing_bank_t bank;     ///< Internal debouncing state
 
 #if EXTERNAL_GPIO
-	uint64_t mask_ext;  ///< Mask. If bit i = 1 on mask, external GPIO(i) is debounced
-	uint64_t latch_ext; ///< External latch values
+	uint64_t mask_ext;  ///< Mask. If bit i = 1 on mask, external GPIO(i) has an edge pending to debounce
+	gpio_debouncing_bank_t bank_ext; ///< External debouncing state
 #endif
 
-	uint16_t threshold[CPU_LAST_GPIO + 1]; ///< Threshold values, in timer period units
-	uint16_t time[CPU_LAST_GPIO + 1];      ///< Time counter for GPIO
+	gpio_debouncing_ring_t ring;     ///< Debounced events
 
 	gpio_debouncing_callback_t callback[CPU_LAST_GPIO + 1]; ///< Callback for GPIO
 	void *arg[CPU_LAST_GPIO + 1]; // Callback args
@@ -76,4 +76,18 @@ driver_error_t *gpio_debouncing_register(uint8_t pin, uint16_t threshold, gpio_d
 driver_error_t *gpio_debouncing_unregister(uint8_t pin);
 void gpio_debouncing_force_isr(void *args);
 
+/**
+ * @brief Get the debounced events of the registered GPIOs. Events are stored
+ *        in a ring buffer by the debouncing timer ISR, in addition to calling
+ *        the GPIO callback, if any.
+ *
+ * @param event Where to store the events.
+ * @param max Max number of events to get.
+ * @param dropped If not NULL, number of events lost since boot because the
+ *                ring buffer was full.
+ *
+ * @return Number of events got.
+ */
+int gpio_debouncing_get_events(gpio_debouncing_event_t *event, int max, uint32_t *dropped);
+
 #endif /* _GPIO_DEBOUNCING_H_ */
@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, gpio debouncing core
+ *
+ */
+
+#include "esp_attr.h"
+
+#include <sys/drivers/gpio_debouncing_core.h>
+
+/*
+ * Operation functions
+ */
+void gpio_debouncing_bank_threshold(gpio_debouncing_bank_t *bank, uint8_t bit, uint32_t threshold) {
+	uint64_t mask = (1ULL << bit);
+	int b;
+
+	if (threshold < 1) {
+		threshold = 1;
+	} else if (threshold > GPIO_DEBOUNCING_MAX_THRESHOLD) {
+		threshold = GPIO_DEBOUNCING_MAX_THRESHOLD;
+	}
+
+	for(b = 0;b < GPIO_DEBOUNCING_BITS;b++) {
+		if (threshold & (1 << b)) {
+			bank->threshold[b] |= mask;
+		} else {
+			bank->threshold[b] &= ~mask;
+		}
+
+		bank->count[b] &= ~mask;
+	}
+}
+
+uint64_t IRAM_ATTR gpio_debouncing_bank_tick(gpio_debouncing_bank_t *bank, uint64_t current, uint64_t *active) {
+	uint64_t diff = (current ^ bank->latch) & *active;
+	uint64_t carry = diff;
+	uint64_t equal = ~0ULL;
+	uint64_t changed;
+	int b;
+
+	// Increment the counters of the pins that differ from the latch, clear
+	// the others, and compare the counters with the thresholds
+	for(b = 0;b < GPIO_DEBOUNCING_BITS;b++) {
+		uint64_t plane = (bank->count[b] ^ carry) & diff;
+
+		carry &= ~plane;
+		bank->count[b] = plane;
+		equal &= ~(plane ^ bank->threshold[b]);
+	}
+
+	changed = equal & diff;
+
+	if (changed) {
+		bank->latch ^= changed;
+
+		for(b = 0;b < GPIO_DEBOUNCING_BITS;b++) {
+			bank->count[b] &= ~changed;
+		}
+	}
+
+	*active &= diff & ~changed;
+
+	return changed;
+}
+
+int IRAM_ATTR gpio_debouncing_ring_put(gpio_debouncing_ring_t *ring, uint64_t changed, uint64_t latch, uint8_t first, uint32_t now) {
+	uint32_t head = ring->head;
+	int stored = 0;
+	int bit;
+
+	while (changed) {
+		bit = __builtin_ctzll(changed);
+		changed &= changed - 1;
+
+		if ((head - ring->tail) >= GPIO_DEBOUNCING_EVENTS) {
+			ring->dropped++;
+			continue;
+		}
+
+		gpio_debouncing_event_t *event = &ring->event[head & (GPIO_DEBOUNCING_EVENTS - 1)];
+
+		event->time = now;
+		event->pin = first + bit;
+		event->level = (latch >> bit) & 1;
+
+		head++;
+		stored++;
+	}
+
+	// Publish the events after they are written
+	__sync_synchronize();
+	ring->head = head;
+
+	return stored;
+}
+
+int gpio_debouncing_ring_get(gpio_debouncing_ring_t *ring, gpio_debouncing_event_t *event, int max) {
+	uint32_t head = ring->head;
+	uint32_t tail = ring->tail;
+	int got = 0;
+
+	__sync_synchronize();
+
+	while ((tail != head) && (got < max)) {
+		event[got++] = ring->event[tail & (GPIO_DEBOUNCING_EVENTS - 1)];
+		tail++;
+	}
+
+	// Release the slots after they are read
+	__sync_synchronize();
+	ring->tail = tail;
+
+	return got;
+}
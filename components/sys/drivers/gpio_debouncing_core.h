@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, gpio debouncing core
+ *
+ * The debouncing state of 64 pins is kept in a bank, and all the pins of a
+ * bank are processed at once using 64 bits masks:
+ *
+ * - Each pin has a counter of GPIO_DEBOUNCING_BITS bits, stored as bit
+ *   planes (count[b] holds bit b of the counter of all the pins). The
+ *   counter of a pin is incremented on each tick while the pin is at a
+ *   level different from it's latch, and cleared when the pin returns to
+ *   the latch level.
+ *
+ * - When the counter of a pin reaches it's threshold (also stored as bit
+ *   planes), the new level is latched.
+ *
+ * The cost of a tick doesn't depend on the number of pins that are being
+ * debounced. The latched changes are stored as timestamped events in a
+ * lock-free ring buffer (one producer, the timer ISR, and one consumer).
+ *
+ */
+
+#ifndef _DRIVERS_GPIO_DEBOUNCING_CORE_H_
+#define _DRIVERS_GPIO_DEBOUNCING_CORE_H_
+
+#include <stdint.h>
+
+// Bits of the debouncing counters. Thresholds are up to 65535 us, that are
+// 3277 periods of 20 us.
+#define GPIO_DEBOUNCING_BITS 12
+
+// Max threshold, in timer periods
+#define GPIO_DEBOUNCING_MAX_THRESHOLD ((1 << GPIO_DEBOUNCING_BITS) - 1)
+
+// Number of events in the ring buffer (must be a power of 2)
+#define GPIO_DEBOUNCING_EVENTS 64
+
+typedef struct {
+	uint64_t latch;                           ///< Latched (debounced) values
+	uint64_t count[GPIO_DEBOUNCING_BITS];     ///< Counters, as bit planes
+	uint64_t threshold[GPIO_DEBOUNCING_BITS]; ///< Thresholds, as bit planes
+} gpio_debouncing_bank_t;
+
+typedef struct {
+	uint32_t time;  ///< Time, in microseconds
+	uint8_t pin;    ///< GPIO number
+	uint8_t level;  ///< New level
+} gpio_debouncing_event_t;
+
+typedef struct {
+	volatile uint32_t head;    ///< Next event to write (producer)
+	volatile uint32_t tail;    ///< Next event to read (consumer)
+	volatile uint32_t dropped; ///< Events lost because the ring was full
+	gpio_debouncing_event_t event[GPIO_DEBOUNCING_EVENTS];
+} gpio_debouncing_ring_t;
+
+/**
+ * @brief Set the debouncing threshold of a pin in a bank. The counter of the
+ *        pin is cleared.
+ *
+ * @param bank Bank.
+ * @param bit Pin position in the bank (0 to 63).
+ * @param threshold Threshold, in timer periods. Values out of the range 1 to
+ *                  GPIO_DEBOUNCING_MAX_THRESHOLD are clamped.
+ */
+void gpio_debouncing_bank_threshold(gpio_debouncing_bank_t *bank, uint8_t bit, uint32_t threshold);
+
+/**
+ * @brief Process a tick of the debouncing timer.
+ *
+ * @param bank Bank.
+ * @param current Current values of the pins.
+ * @param active Pins with an edge pending to debounce. On return, pins that
+ *               are latched, or that returned to the latch level, are removed.
+ *
+ * @return Mask of the pins that changed it's latch in this tick.
+ */
+uint64_t gpio_debouncing_bank_tick(gpio_debouncing_bank_t *bank, uint64_t current, uint64_t *active);
+
+/**
+ * @brief Store an event in the ring buffer for each pin that changed in a tick.
+ *
+ * @param ring Ring buffer.
+ * @param changed Mask of the pins that changed.
+ * @param latch Latched values of the pins.
+ * @param first GPIO number of the bit 0 of the masks.
+ * @param now Current time, in microseconds.
+ *
+ * @return Number of stored events. Events that don't fit are counted in
+ *         the dropped field.
+ */
+int gpio_debouncing_ring_put(gpio_debouncing_ring_t *ring, uint64_t changed, uint64_t latch, uint8_t first, uint32_t now);
+
+/**
+ * @brief Get events from the ring buffer.
+ *
+ * @param ring Ring buffer.
+ * @param event Where to store the events.
+ * @param max Max number of events to get.
+ *
+ * @return Number of events got.
+ */
+int gpio_debouncing_ring_get(gpio_debouncing_ring_t *ring, gpio_debouncing_event_t *event, int max);
+
+#endif /* _DRIVERS_GPIO_DEBOUNCING_CORE_H_ */
@@ -56,6 +56,7 @@
 #include "esp_event.h"
 #include "esp_event_loop.h"
 #include "esp_ota_ops.h"
+#include "esp_timer.h"
 #include <esp_task_wdt.h>
 
 #if CONFIG_LUA_RTOS_LUA_USE_MDNS
@@ -70,12 +71,16 @@
 #include <stdio.h>
 #include <errno.h>
 #include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <pthread.h>
 
 #include <sys/status.h>
 #include <sys/delay.h>
 
 #include <drivers/net.h>
 #include <drivers/net_http.h>
+#include <drivers/dns_cache.h>
 #include <drivers/wifi.h>
 #include <drivers/eth.h>
 
@@ -109,9 +114,140 @@ static uint8_t connect_retries = 0;
 // Event callbacks
 static net_event_register_callback_t callback[MAX_NET_EVENT_CALLBACKS] = {0};
 
+// DNS cache, shared by all the lookups
+static dns_cache_t dns_cache;
+static dns_cache_entry_t dns_cache_entry[CONFIG_LUA_RTOS_DNS_CACHE_ENTRIES > 0 ? CONFIG_LUA_RTOS_DNS_CACHE_ENTRIES : 1];
+static pthread_mutex_t dns_cache_mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t dns_cache_cond = PTHREAD_COND_INITIALIZER;
+
 /*
  * Helper functions
  */
+
+// Send a DNS query directly to a DNS server, and wait for the answer
+static int dns_query(const ip_addr_t *server, const char *name, uint32_t *addr, uint32_t *ttl) {
+    uint8_t query[DNS_CACHE_QUERY_SIZE];
+    uint8_t answer[512];
+    struct sockaddr_in to, from;
+    socklen_t from_len;
+    struct timeval tv;
+    int attempt;
+    int len, rlen;
+    int rc = DNS_CACHE_ERROR;
+    int s;
+
+    uint16_t id = (uint16_t)esp_random();
+
+    if ((len = dns_cache_query(query, id, name)) < 0) {
+        return DNS_CACHE_NOT_FOUND;
+    }
+
+    if ((s = socket(AF_INET, SOCK_DGRAM, 0)) < 0) {
+        return DNS_CACHE_ERROR;
+    }
+
+    tv.tv_sec = NET_DNS_QUERY_TIMEOUT / 1000;
+    tv.tv_usec = (NET_DNS_QUERY_TIMEOUT % 1000) * 1000;
+    setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    memset(&to, 0, sizeof(to));
+    to.sin_family = AF_INET;
+    to.sin_port = htons(53);
+    to.sin_addr.s_addr = ip_2_ip4(server)->addr;
+
+    for(attempt = 0; (attempt < NET_DNS_QUERY_ATTEMPTS) && (rc == DNS_CACHE_ERROR); attempt++) {
+        if (sendto(s, query, len, 0, (struct sockaddr *)&to, sizeof(to)) != len) {
+            delay(500);
+            continue;
+        }
+
+        // Wait for an answer from the server, until the timeout
+        for(;;) {
+            from_len = sizeof(from);
+            if ((rlen = recvfrom(s, answer, sizeof(answer), 0, (struct sockaddr *)&from, &from_len)) < 0) {
+                break;
+            }
+
+            if (from.sin_addr.s_addr == to.sin_addr.s_addr) {
+                rc = dns_cache_answer(answer, rlen, id, name, addr, ttl);
+                break;
+            }
+        }
+    }
+
+    close(s);
+
+    return rc;
+}
+
+static int dns_resolve(void *arg, const char *name, uint32_t *addr, uint32_t *ttl) {
+    struct addrinfo hints = {0, AF_INET, SOCK_STREAM, IPPROTO_TCP, 0, NULL, NULL, NULL};
+    struct addrinfo *result = NULL;
+    struct addrinfo *res;
+    const ip_addr_t *server;
+    size_t len = strlen(name);
+    int rc = DNS_CACHE_ERROR;
+    int i;
+
+    if (!wait_for_network(20000)) {
+        return DNS_CACHE_ERROR;
+    }
+
+    // Ask the DNS servers, to know the TTL of the record. Multicast DNS
+    // names are resolved by lwIP.
+    if ((len < 6) || strcasecmp(name + len - 6, ".local")) {
+        for(i = 0; i < DNS_MAX_SERVERS; i++) {
+            server = dns_getserver(i);
+            if (!server || !IP_IS_V4(server) || ip_addr_isany(server)) {
+                continue;
+            }
+
+            if ((rc = dns_query(server, name, addr, ttl)) != DNS_CACHE_ERROR) {
+                return rc;
+            }
+        }
+    }
+
+    // No DNS server answered, fall back to lwIP (the TTL is unknown)
+    if (getaddrinfo(name, NULL, &hints, &result) == 0) {
+        for(res = result; res; res = res->ai_next) {
+            if (res->ai_family == AF_INET) {
+                *addr = ((struct sockaddr_in *)(res->ai_addr))->sin_addr.s_addr;
+                *ttl = NET_DNS_DEFAULT_TTL;
+                rc = DNS_CACHE_OK;
+                break;
+            }
+        }
+
+        freeaddrinfo(result);
+    }
+
+    return rc;
+}
+
+static uint64_t dns_now(void *arg) {
+    return esp_timer_get_time() / 1000;
+}
+
+static void dns_lock(void *arg) {
+    pthread_mutex_lock(&dns_cache_mtx);
+}
+
+static void dns_unlock(void *arg) {
+    pthread_mutex_unlock(&dns_cache_mtx);
+}
+
+static void dns_wait(void *arg) {
+    pthread_cond_wait(&dns_cache_cond, &dns_cache_mtx);
+}
+
+static void dns_notify(void *arg) {
+    pthread_cond_broadcast(&dns_cache_cond);
+}
+
+static const dns_cache_ops_t dns_cache_ops = {
+    dns_resolve, dns_now, dns_lock, dns_unlock, dns_wait, dns_notify
+};
 static esp_err_t event_handler(void *ctx, system_event_t *event) {
     EventBits_t bits = 0;
 
@@ -157,6 +293,7 @@ static esp_err_t event_handler(void *ctx, system_event_t *event) {
 
         case SYSTEM_EVENT_STA_GOT_IP: // ESP32 station got IP from connected AP
             status_set(STATUS_WIFI_HAS_IP, 0x00000000);
+            net_dns_flush(NULL);
             bits |= evWIFI_CONNECTED;
             break;
 
@@ -227,6 +364,7 @@ static esp_err_t event_handler(void *ctx, system_event_t *event) {
 
         case SYSTEM_EVENT_ETH_GOT_IP: // ESP32 ethernet got IP from connected AP
             status_set(STATUS_ETH_HAS_IP, 0x00000000);
+            net_dns_flush(NULL);
             bits |= evETH_CONNECTED;
             break;
 #endif
@@ -253,6 +391,7 @@ static esp_err_t event_handler(void *ctx, system_event_t *event) {
 
         case SYSTEM_EVENT_SPI_ETH_GOT_IP: // ESP32 spi ethernet got IP from connected AP
             status_set(STATUS_SPI_ETH_HAS_IP, 0x00000000);
+            net_dns_flush(NULL);
             bits |= evSPI_ETH_CONNECTED;
             break;
 #endif
@@ -287,6 +426,10 @@ driver_error_t *net_init() {
 
         netEvent = xEventGroupCreate();
 
+        dns_cache_init(&dns_cache, dns_cache_entry, CONFIG_LUA_RTOS_DNS_CACHE_ENTRIES,
+                       CONFIG_LUA_RTOS_DNS_CACHE_MAX_TTL, CONFIG_LUA_RTOS_DNS_CACHE_NEGATIVE_TTL,
+                       &dns_cache_ops, NULL);
+
         tcpip_adapter_init();
 
         esp_event_loop_init(event_handler, NULL);
@@ -306,48 +449,38 @@ driver_error_t *net_check_connectivity() {
 }
 
 driver_error_t *net_lookup(const char *name, int port, struct sockaddr_in *address) {
-    int rc = 0;
-    int lookup_retries = 0;
+    struct in_addr ip;
+    uint32_t addr;
 
-retry:
-    if (!wait_for_network(20000)) {
+    // The cache is created with the network
+    if (!status_get(STATUS_TCPIP_INITED) && !wait_for_network(20000)) {
         return driver_error(NET_DRIVER, NET_ERR_NOT_AVAILABLE,NULL);
     }
 
-    sa_family_t family = AF_INET;
-    struct addrinfo *result = NULL;
-    struct addrinfo hints = {0, AF_INET, SOCK_STREAM, IPPROTO_TCP, 0, NULL, NULL, NULL};
-
-    if ((rc = getaddrinfo(name, NULL, &hints, &result)) == 0) {
-        struct addrinfo *res = result;
-        while (res) {
-            if (res->ai_family == AF_INET) {
-                result = res;
-                break;
-            }
-            res = res->ai_next;
-        }
-
-        if (result->ai_family == AF_INET) {
-            address->sin_port = htons(port);
-            address->sin_family = family = AF_INET;
-            address->sin_addr = ((struct sockaddr_in*)(result->ai_addr))->sin_addr;
-        }
-
-        freeaddrinfo(result);
-    } else {
-        lookup_retries++;
-        if (lookup_retries < 4) {
-            vTaskDelay(500 / portTICK_PERIOD_MS);
-            goto retry;
+    // IP addresses don't need a lookup
+    if (inet_aton(name, &ip)) {
+        addr = ip.s_addr;
+    } else if (dns_cache_lookup(&dns_cache, name, &addr) != DNS_CACHE_OK) {
+        if (!NETWORK_AVAILABLE()) {
+            return driver_error(NET_DRIVER, NET_ERR_NOT_AVAILABLE,NULL);
         }
 
         return driver_error(NET_DRIVER, NET_ERR_NAME_CANNOT_BE_RESOLVED,NULL);
     }
 
+    address->sin_port = htons(port);
+    address->sin_family = AF_INET;
+    address->sin_addr.s_addr = addr;
+
     return NULL;
 }
 
+void net_dns_flush(const char *name) {
+    if (status_get(STATUS_TCPIP_INITED)) {
+        dns_cache_flush(&dns_cache, name);
+    }
+}
+
 driver_error_t *net_event_register_callback(net_event_register_callback_t func) {
     int i = 0;
 
@@ -66,6 +66,15 @@
 
 #define MAX_NET_EVENT_CALLBACKS 3
 
+// DNS queries: attempts for each server, and timeout of each attempt in
+// milliseconds
+#define NET_DNS_QUERY_ATTEMPTS 3
+#define NET_DNS_QUERY_TIMEOUT  1000
+
+// TTL for names resolved by lwIP, that doesn't tell the TTL of the record,
+// in seconds
+#define NET_DNS_DEFAULT_TTL 60
+
 #define evWIFI_SCAN_END         ( 1 << 0 )
 #define evWIFI_CONNECTED        ( 1 << 1 )
 #define evWIFI_CANT_CONNECT     ( 1 << 2 )
@@ -131,7 +140,10 @@ driver_error_t *net_init();
 driver_error_t *net_check_connectivity();
 
 /**
- * @brief Lookup for a hostname, and get the IP, doing a DNS search.
+ * @brief Lookup for a hostname, and get the IP, doing a DNS search. Names are
+ *        cached for the TTL of their DNS record, and names that don't exist
+ *        for CONFIG_LUA_RTOS_DNS_CACHE_NEGATIVE_TTL seconds. Concurrent
+ *        lookups of the same name wait for the same DNS query.
  *
  * @param name The hostname.
  * @param name The port number.
@@ -142,9 +154,17 @@ driver_error_t *net_check_connectivity();
  *     - Pointer to driver_error_t if some error occurs.
  *
  *          NET_ERR_NOT_AVAILABLE
+ *          NET_ERR_NAME_CANNOT_BE_RESOLVED
  */
 driver_error_t *net_lookup(const char *name, int port, struct sockaddr_in *address);
 
+/**
+ * @brief Remove a name, or all the names, from the DNS cache.
+ *
+ * @param name The hostname, or NULL for all the names.
+ */
+void net_dns_flush(const char *name);
+
 /**
  * @brief Register a function callback in the network event loop. When an event is
  *        received in the event loop the net driver executes the default treatment
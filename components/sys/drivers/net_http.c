@@ -44,6 +44,7 @@
  */
 
 #include <stddef.h>
+#include <stdlib.h>
 #include <stdio.h>
 #include <errno.h>
 #include <string.h>
@@ -101,37 +102,58 @@ static int net_http_read_chunk(net_http_client_t *client, uint8_t *buffer, size_
 }
 
 driver_error_t *net_http_create_client(const char *server, const char *port, net_http_client_t *client) {
+    struct sockaddr_in address;
     struct addrinfo hints;
     struct addrinfo *result, *rp;
+    driver_error_t *error;
     int connected = 0;
 
-    // Obtain address matching host/port
-    memset(&hints, 0, sizeof(struct addrinfo));
-    hints.ai_family = AF_UNSPEC;
-    hints.ai_socktype = SOCK_STREAM;
-    hints.ai_flags = 0;
-    hints.ai_protocol = 0;
-
-    if (getaddrinfo(server, port, &hints, &result) != 0) {
-        return driver_error(NET_DRIVER, NET_ERR_NAME_CANNOT_BE_RESOLVED,NULL);
+    // Try first the address in the DNS cache
+    if ((error = net_lookup(server, atoi(port), &address))) {
+        free(error);
+    } else if ((client->socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP)) >= 0) {
+        if (!connect(client->socket, (struct sockaddr *)&address, sizeof(address))) {
+            connected = 1;
+        } else {
+            // The server may have moved, resolve it again next time
+            close(client->socket);
+            net_dns_flush(server);
+        }
     }
 
-    // Try each address until we successfully connect
-    for (rp = result; rp != NULL; rp = rp->ai_next) {
-        if ((client->socket = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol)) < 0) {
-            continue;
+    if (!connected) {
+        // Obtain address matching host/port
+        memset(&hints, 0, sizeof(struct addrinfo));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = 0;
+        hints.ai_protocol = 0;
+
+        if (getaddrinfo(server, port, &hints, &result) != 0) {
+            client->socket = -1;
+            net_http_destroy_client(client);
+
+            return driver_error(NET_DRIVER, NET_ERR_NAME_CANNOT_BE_RESOLVED,NULL);
         }
 
-        if (!connect(client->socket, rp->ai_addr, rp->ai_addrlen)) {
-            connected = 1;
-            break;
-        }
+        // Try each address until we successfully connect
+        for (rp = result; rp != NULL; rp = rp->ai_next) {
+            if ((client->socket = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol)) < 0) {
+                continue;
+            }
 
-        close(client->socket);
+            if (!connect(client->socket, rp->ai_addr, rp->ai_addrlen)) {
+                connected = 1;
+                break;
+            }
+
+            close(client->socket);
+        }
+        freeaddrinfo(result);
     }
-    freeaddrinfo(result);
 
     if (!connected) {
+        client->socket = -1;
         net_http_destroy_client(client);
 
         return driver_error(NET_DRIVER, NET_ERR_NAME_CANNOT_CONNECT,NULL);
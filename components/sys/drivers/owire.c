@@ -11,14 +11,42 @@
 
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 
 #include <sys/drivers/cpu.h>
 #include <sys/drivers/owire.h>
+#include <sys/drivers/owire_slots.h>
 #include <sys/drivers/gpio.h>
 
 #include <sys/syslog.h>
 #include <sys/delay.h>
 
+#if CONFIG_LUA_RTOS_LUA_USE_RMT
+#include "freertos/ringbuf.h"
+
+#include <driver/rmt.h>
+#include <soc/gpio_struct.h>
+
+#include <sys/drivers/rmt.h>
+
+// Slots sent in each RMT transaction. Each slot is captured in one RX item,
+// and the RX channel uses one RMT memory block (64 items).
+#define OWIRE_RMT_MAX_SLOTS  32
+
+// RMT time base is 1 usec
+#define OWIRE_RMT_CLK_DIV    (APB_CLK_FREQ / 1000000UL)
+
+// Pulses shorter than this (in APB clock ticks) are ignored by the RX channel
+#define OWIRE_RMT_FILTER_TICKS 100
+
+// A high level longer than this ends the capture, must be longer than the
+// longest high level inside a transaction (write 1 / read slot)
+#define OWIRE_RMT_IDLE_US    100
+
+// Time to wait for the captured items, once the transmission has ended
+#define OWIRE_RMT_TIMEOUT_MS 10
+#endif
+
 #define OWIRE_FIRST_PIN	1
 #define OWIRE_LAST_PIN	31
 
@@ -125,6 +153,12 @@ driver_error_t *owire_setup_pin(int8_t pin) {
 		return error;
 	}
 
+#if CONFIG_LUA_RTOS_LUA_USE_RMT
+    // Use hardware-timed slots if there are 2 free RMT channels, otherwise
+    // slots are bit-banged
+    owire_rmt_setup(owire_checkpin(pin));
+#endif
+
     return NULL;
 }
 
@@ -136,20 +170,244 @@ void owire_init() {
 // ONEWIRE FUNCTIONS
 //******************
 
+static unsigned char owire_bb_reset(uint8_t dev);
+static void owire_bb_write_bit(uint8_t dev, unsigned char bit);
+static unsigned char owire_bb_read_bit(uint8_t dev);
+
 //--------------------------------
 void owdevice_input(uint8_t dev) {
+#if CONFIG_LUA_RTOS_LUA_USE_RMT
+	if (ow_devices[dev].device.rmt) {
+		// Back to open drain, RMT TX idle level releases the line
+		GPIO.pin[ow_devices[dev].device.pin].pad_driver = 1;
+		return;
+	}
+#endif
+
     gpio_pin_input(ow_devices[dev].device.pin);
     gpio_pin_pullup(ow_devices[dev].device.pin);
 }
 
 //-----------------------------------
 void owdevice_pinpower(uint8_t dev) {
+#if CONFIG_LUA_RTOS_LUA_USE_RMT
+	if (ow_devices[dev].device.rmt) {
+		// Push-pull, RMT TX idle level drives the line high (strong pull-up)
+		GPIO.pin[ow_devices[dev].device.pin].pad_driver = 0;
+		return;
+	}
+#endif
+
     gpio_pin_output(ow_devices[dev].device.pin);
     gpio_pin_set(ow_devices[dev].device.pin);
 }
 
+#if CONFIG_LUA_RTOS_LUA_USE_RMT
+//*************************
+// RMT HARDWARE-TIMED SLOTS
+//*************************
+
+// Slots are encoded as RMT items and sent by a TX channel, while a RX channel
+// attached to the same pin captures the bus. The calling task waits for the
+// end of the transaction, but interrupts are not disabled.
+
+//-------------------------------------------------------------------
+static void owire_rmt_unsetup(uint8_t dev) {
+	TM_One_Wire_t *ow = &ow_devices[dev].device;
+
+	if (ow->rmt_tx >= 0) {
+		rmt_driver_uninstall(ow->rmt_tx);
+		rmt_release_channel(ow->rmt_tx);
+	}
+
+	if (ow->rmt_rx >= 0) {
+		rmt_driver_uninstall(ow->rmt_rx);
+		rmt_release_channel(ow->rmt_rx);
+	}
+
+	ow->rmt_tx = -1;
+	ow->rmt_rx = -1;
+	ow->rmt = 0;
+}
+
+//-------------------------------------------------------------------
+static int owire_rmt_setup(uint8_t dev) {
+	TM_One_Wire_t *ow = &ow_devices[dev].device;
+	driver_error_t *error;
+	rmt_config_t config;
+	int channel;
+
+	ow->rmt = 0;
+	ow->rmt_tx = -1;
+	ow->rmt_rx = -1;
+
+	if ((error = rmt_reserve_channel(ow->pin, &channel))) {
+		free(error);
+		return -1;
+	}
+	ow->rmt_tx = channel;
+
+	if ((error = rmt_reserve_channel(ow->pin, &channel))) {
+		free(error);
+		owire_rmt_unsetup(dev);
+		return -1;
+	}
+	ow->rmt_rx = channel;
+
+	// TX channel, idle level releases the line
+	memset(&config, 0, sizeof(config));
+	config.rmt_mode = RMT_MODE_TX;
+	config.channel = ow->rmt_tx;
+	config.gpio_num = ow->pin;
+	config.clk_div = OWIRE_RMT_CLK_DIV;
+	config.mem_block_num = 1;
+	config.tx_config.idle_output_en = 1;
+	config.tx_config.idle_level = 1;
+
+	if ((rmt_config(&config) != ESP_OK) || (rmt_driver_install(ow->rmt_tx, 0, 0) != ESP_OK)) {
+		owire_rmt_unsetup(dev);
+		return -1;
+	}
+
+	// RX channel
+	memset(&config, 0, sizeof(config));
+	config.rmt_mode = RMT_MODE_RX;
+	config.channel = ow->rmt_rx;
+	config.gpio_num = ow->pin;
+	config.clk_div = OWIRE_RMT_CLK_DIV;
+	config.mem_block_num = 1;
+	config.rx_config.filter_en = 1;
+	config.rx_config.filter_ticks_thresh = OWIRE_RMT_FILTER_TICKS;
+	config.rx_config.idle_threshold = OWIRE_RMT_IDLE_US;
+
+	if ((rmt_config(&config) != ESP_OK) || (rmt_driver_install(ow->rmt_rx, 512, 0) != ESP_OK)) {
+		owire_rmt_unsetup(dev);
+		return -1;
+	}
+
+	if ((rmt_get_ringbuf_handle(ow->rmt_rx, (RingbufHandle_t *)&ow->rmt_rb) != ESP_OK) || !ow->rmt_rb) {
+		owire_rmt_unsetup(dev);
+		return -1;
+	}
+
+	// Route both channels to the pin, and set it as open drain, so that RX
+	// channel sees the TX pulses, and the pulses driven by the devices
+	rmt_set_pin(ow->rmt_tx, RMT_MODE_TX, ow->pin);
+	rmt_set_pin(ow->rmt_rx, RMT_MODE_RX, ow->pin);
+	gpio_set_direction(ow->pin, GPIO_MODE_INPUT_OUTPUT_OD);
+	gpio_set_pull_mode(ow->pin, GPIO_PULLUP_ONLY);
+
+	ow->rmt = 1;
+
+	return 0;
+}
+
+// Transmit items, and get the captured items. Returns the number of
+// captured items.
+//-------------------------------------------------------------------
+static uint32_t owire_rmt_xfer(uint8_t dev, uint32_t *tx, uint32_t tx_len, uint32_t *rx, uint32_t rx_len) {
+	TM_One_Wire_t *ow = &ow_devices[dev].device;
+	rmt_item32_t *items;
+	size_t size = 0;
+
+	rmt_rx_start(ow->rmt_rx, 1);
+	rmt_write_items(ow->rmt_tx, (rmt_item32_t *)tx, tx_len, 1);
+
+	items = (rmt_item32_t *)xRingbufferReceive(ow->rmt_rb, &size, OWIRE_RMT_TIMEOUT_MS / portTICK_PERIOD_MS + 1);
+
+	rmt_rx_stop(ow->rmt_rx);
+
+	if (!items) {
+		return 0;
+	}
+
+	size /= sizeof(rmt_item32_t);
+	if (size > rx_len) {
+		size = rx_len;
+	}
+
+	memcpy(rx, items, size * sizeof(uint32_t));
+	vRingbufferReturnItem(ow->rmt_rb, (void *)items);
+
+	return size;
+}
+
+// Write bits (or read them, writing 1's), LSB first. Returns the read bits
+// in data.
+//-------------------------------------------------------------------
+static void owire_rmt_bits(uint8_t dev, uint8_t *data, uint32_t bits) {
+	uint32_t tx[OWIRE_RMT_MAX_SLOTS];
+	uint32_t rx[OWIRE_RMT_MAX_SLOTS + 1];
+	uint32_t slots, len;
+
+	while (bits > 0) {
+		slots = (bits > OWIRE_RMT_MAX_SLOTS)?OWIRE_RMT_MAX_SLOTS:bits;
+
+		owire_encode_bits(data, slots, tx);
+		len = owire_rmt_xfer(dev, tx, slots, rx, OWIRE_RMT_MAX_SLOTS + 1);
+
+		if (owire_decode_bits(rx, len, data, slots) < slots) {
+			// Lost slots are read as the idle line
+			memset(data, 0xff, (slots + 7) >> 3);
+		}
+
+		data += slots >> 3;
+		bits -= slots;
+	}
+}
+#endif
+
 //-------------------------------------------
 unsigned char TM_OneWire_Reset(uint8_t dev) {
+#if CONFIG_LUA_RTOS_LUA_USE_RMT
+	if (ow_devices[dev].device.rmt) {
+		uint32_t tx[OWIRE_RESET_ITEMS];
+		uint32_t rx[8];
+		uint32_t len;
+
+		owire_encode_reset(tx);
+		len = owire_rmt_xfer(dev, tx, OWIRE_RESET_ITEMS, rx, sizeof(rx) / sizeof(uint32_t));
+
+		return owire_decode_reset(rx, len);
+	}
+#endif
+
+	return owire_bb_reset(dev);
+}
+
+//---------------------------------------------------------------
+static void TM_OneWire_WriteBit(uint8_t dev, unsigned char bit) {
+#if CONFIG_LUA_RTOS_LUA_USE_RMT
+	if (ow_devices[dev].device.rmt) {
+		owire_rmt_bits(dev, &bit, 1);
+		return;
+	}
+#endif
+
+	owire_bb_write_bit(dev, bit);
+}
+
+//---------------------------------------------
+unsigned char TM_OneWire_ReadBit(uint8_t dev) {
+#if CONFIG_LUA_RTOS_LUA_USE_RMT
+	if (ow_devices[dev].device.rmt) {
+		unsigned char bit = 1;
+
+		owire_rmt_bits(dev, &bit, 1);
+
+		return bit & 1;
+	}
+#endif
+
+	return owire_bb_read_bit(dev);
+}
+
+//*********************
+// BIT-BANGED SLOTS
+//*********************
+
+//-------------------------------------------
+static unsigned char owire_bb_reset(uint8_t dev) {
 	unsigned char bit = 1;
 	int i;
 
@@ -185,7 +443,7 @@ unsigned char TM_OneWire_Reset(uint8_t dev) {
 
 // ow WRITE slot
 //---------------------------------------------------------------
-static void TM_OneWire_WriteBit(uint8_t dev, unsigned char bit) {
+static void owire_bb_write_bit(uint8_t dev, unsigned char bit) {
   portMUX_TYPE timeCriticalMutex = portMUX_INITIALIZER_UNLOCKED;
   portENTER_CRITICAL(&timeCriticalMutex);
 
@@ -220,7 +478,7 @@ static void TM_OneWire_WriteBit(uint8_t dev, unsigned char bit) {
 
 // ow READ slot
 //---------------------------------------------
-unsigned char TM_OneWire_ReadBit(uint8_t dev) {
+static unsigned char owire_bb_read_bit(uint8_t dev) {
 	unsigned char bit = 1;
 	int i;
 
@@ -256,6 +514,14 @@ unsigned char TM_OneWire_ReadBit(uint8_t dev) {
 
 //----------------------------------------------------------
 void TM_OneWire_WriteByte(uint8_t dev, unsigned char byte) {
+#if CONFIG_LUA_RTOS_LUA_USE_RMT
+  if (ow_devices[dev].device.rmt) {
+    // All the bits in one transaction
+    owire_rmt_bits(dev, &byte, 8);
+    return;
+  }
+#endif
+
   unsigned char i = 8;
   // Write 8 bits
   while (i--) {
@@ -267,6 +533,16 @@ void TM_OneWire_WriteByte(uint8_t dev, unsigned char byte) {
 
 //----------------------------------------------
 unsigned char TM_OneWire_ReadByte(uint8_t dev) {
+#if CONFIG_LUA_RTOS_LUA_USE_RMT
+  if (ow_devices[dev].device.rmt) {
+    // Read slots are write slots of 1's
+    unsigned char byte = 0xff;
+
+    owire_rmt_bits(dev, &byte, 8);
+    return byte;
+  }
+#endif
+
   unsigned char i = 8, byte = 0;
   while (i--) {
     byte >>= 1;
@@ -275,6 +551,44 @@ unsigned char TM_OneWire_ReadByte(uint8_t dev) {
   return byte;
 }
 
+//--------------------------------------------------------------------------------
+void TM_OneWire_WriteBytes(uint8_t dev, const unsigned char *buf, unsigned int len) {
+#if CONFIG_LUA_RTOS_LUA_USE_RMT
+  if (ow_devices[dev].device.rmt) {
+    unsigned char tmp[OWIRE_RMT_MAX_SLOTS >> 3];
+    unsigned int chunk;
+
+    while (len > 0) {
+      chunk = (len > sizeof(tmp))?sizeof(tmp):len;
+      memcpy(tmp, buf, chunk);
+      owire_rmt_bits(dev, tmp, chunk << 3);
+      buf += chunk;
+      len -= chunk;
+    }
+    return;
+  }
+#endif
+
+  while (len--) {
+    TM_OneWire_WriteByte(dev, *buf++);
+  }
+}
+
+//--------------------------------------------------------------------------
+void TM_OneWire_ReadBytes(uint8_t dev, unsigned char *buf, unsigned int len) {
+#if CONFIG_LUA_RTOS_LUA_USE_RMT
+  if (ow_devices[dev].device.rmt) {
+    memset(buf, 0xff, len);
+    owire_rmt_bits(dev, buf, len << 3);
+    return;
+  }
+#endif
+
+  while (len--) {
+    *buf++ = TM_OneWire_ReadByte(dev);
+  }
+}
+
 //-----------------------------------------------
 static void TM_OneWire_ResetSearch(uint8_t dev) {
   // Reset the search state
@@ -471,11 +785,8 @@ static void TM_OneWire_Select(unsigned char* addr) {
 
 //------------------------------------------------------------------
 void TM_OneWire_SelectWithPointer(uint8_t dev, unsigned char *ROM) {
-  unsigned char i;
   TM_OneWire_WriteByte(dev, ONEWIRE_CMD_MATCHROM);
-  for (i = 0; i < 8; i++) {
-    TM_OneWire_WriteByte(dev, *(ROM + i));
-  }
+  TM_OneWire_WriteBytes(dev, ROM, 8);
 }
 
 //------------------------------------------------------------------
@@ -488,21 +799,7 @@ void TM_OneWire_GetFullROM(uint8_t dev, unsigned char *firstIndex) {
 
 //---------------------------------------------------------------------
 unsigned char TM_OneWire_CRC8(unsigned char *addr, unsigned char len) {
-  unsigned char crc = 0, inbyte, i, mix;
-
-  while (len--) {
-    inbyte = *addr++;
-    for (i = 8; i; i--) {
-      mix = (crc ^ inbyte) & 0x01;
-      crc >>= 1;
-      if (mix) {
-        crc ^= 0x8C;
-      }
-      inbyte >>= 1;
-    }
-  }
-  /* Return calculated CRC */
-  return crc;
+  return owire_crc8(addr, len);
 }
 
 //----------------------------------------
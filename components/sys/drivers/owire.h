@@ -46,6 +46,10 @@ typedef struct {
 	unsigned char LastFamilyDiscrepancy; 	// Search private
 	unsigned char LastDeviceFlag;        	// Search private
 	unsigned char ROM_NO[8];             	// 8-bytes address of last search device
+	uint8_t		  rmt;						// Slots are hardware-timed by RMT
+	int8_t		  rmt_tx;					// RMT TX channel
+	int8_t		  rmt_rx;					// RMT RX channel
+	void		  *rmt_rb;					// RMT RX ring buffer
 } TM_One_Wire_t;
 
 typedef struct {
@@ -68,6 +72,8 @@ void TM_OneWire_SelectWithPointer(uint8_t dev, unsigned char *ROM);
 unsigned char TM_OneWire_CRC8(unsigned char *addr, unsigned char len);
 void TM_OneWire_WriteByte(uint8_t dev, unsigned char byte);
 unsigned char TM_OneWire_ReadByte(uint8_t dev);
+void TM_OneWire_WriteBytes(uint8_t dev, const unsigned char *buf, unsigned int len);
+void TM_OneWire_ReadBytes(uint8_t dev, unsigned char *buf, unsigned int len);
 driver_error_t *owire_setup_pin(int8_t pin);
 int owire_checkpin(uint8_t pin);
 TM_One_Wire_Devices_t *ow_getdevice(uint8_t dev);
@@ -0,0 +1,119 @@
+/**
+ * ONE WIRE slot encoder / decoder for Lua-RTOS-ESP32
+ */
+
+#include <string.h>
+
+#include <sys/drivers/owire_slots.h>
+
+/*
+ * Helper functions
+ */
+
+// Iterate over the low pulses of the captured items. Returns the duration of
+// the next low pulse, or 0 when there are no more pulses.
+static uint32_t next_low(const uint32_t *items, uint32_t len, uint32_t *pos) {
+	uint32_t item, duration;
+	uint32_t half;
+
+	while (*pos < (len << 1)) {
+		item = items[*pos >> 1];
+		half = (*pos & 1)?(item >> 16):(item & 0xffff);
+
+		(*pos)++;
+
+		duration = half & 0x7fff;
+		if (duration == 0) {
+			// End marker
+			*pos = len << 1;
+			return 0;
+		}
+
+		if ((half & 0x8000) == 0) {
+			return duration;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Operation functions
+ */
+uint32_t owire_encode_reset(uint32_t *items) {
+	items[0] = OWIRE_ITEM(OWIRE_RESET_LOW_US, 0, OWIRE_RESET_HIGH_US, 1);
+
+	return OWIRE_RESET_ITEMS;
+}
+
+uint32_t owire_encode_bits(const uint8_t *data, uint32_t bits, uint32_t *items) {
+	uint32_t i;
+
+	for(i = 0; i < bits; i++) {
+		if (data[i >> 3] & (1 << (i & 7))) {
+			items[i] = OWIRE_ITEM(OWIRE_WRITE1_LOW_US, 0, OWIRE_WRITE1_HIGH_US, 1);
+		} else {
+			items[i] = OWIRE_ITEM(OWIRE_WRITE0_LOW_US, 0, OWIRE_WRITE0_HIGH_US, 1);
+		}
+	}
+
+	return bits;
+}
+
+int owire_decode_reset(const uint32_t *items, uint32_t len) {
+	uint32_t pos = 0;
+	uint32_t duration;
+
+	// First low pulse is the reset pulse
+	if (next_low(items, len, &pos) == 0) {
+		return 1;
+	}
+
+	// Then, a presence pulse from any device
+	while ((duration = next_low(items, len, &pos))) {
+		if (duration >= OWIRE_PRESENCE_MIN_US) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+uint32_t owire_decode_bits(const uint32_t *items, uint32_t len, uint8_t *data, uint32_t bits) {
+	uint32_t pos = 0;
+	uint32_t duration;
+	uint32_t i;
+
+	memset(data, 0, (bits + 7) >> 3);
+
+	for(i = 0; i < bits; i++) {
+		if ((duration = next_low(items, len, &pos)) == 0) {
+			break;
+		}
+
+		if (duration <= OWIRE_READ_SAMPLE_US) {
+			data[i >> 3] |= (1 << (i & 7));
+		}
+	}
+
+	return i;
+}
+
+uint8_t owire_crc8(const uint8_t *data, uint32_t len) {
+	uint8_t crc = 0, inbyte, mix;
+	int i;
+
+	while (len--) {
+		inbyte = *data++;
+		for (i = 8; i; i--) {
+			mix = (crc ^ inbyte) & 0x01;
+			crc >>= 1;
+			if (mix) {
+				crc ^= 0x8C;
+			}
+			inbyte >>= 1;
+		}
+	}
+
+	return crc;
+}
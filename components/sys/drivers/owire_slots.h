@@ -0,0 +1,88 @@
+/**
+ * ONE WIRE slot encoder / decoder for Lua-RTOS-ESP32
+ *
+ * Reset, write and read slots are encoded as RMT items, that are transmitted
+ * by a RMT TX channel. A RMT RX channel attached to the same (open drain) pin
+ * captures the bus, including the pulses driven by the devices, and the
+ * captured items are decoded to get the presence pulse and the read bits.
+ *
+ * Items use the RMT item layout (duration0:15, level0:1, duration1:15,
+ * level1:1), with durations in microseconds. A 0 duration marks the end of
+ * the captured items.
+ */
+
+#ifndef _OWIRE_SLOTS_H_
+#define _OWIRE_SLOTS_H_
+
+#include <stdint.h>
+
+// Slot timings, in microseconds
+#define OWIRE_RESET_LOW_US       480  // Reset pulse
+#define OWIRE_RESET_HIGH_US      410  // Wait for presence pulse, and recovery
+#define OWIRE_PRESENCE_MIN_US    50   // Minimum presence pulse, 60 us in spec
+#define OWIRE_WRITE1_LOW_US      6
+#define OWIRE_WRITE1_HIGH_US     64
+#define OWIRE_WRITE0_LOW_US      60
+#define OWIRE_WRITE0_HIGH_US     10
+#define OWIRE_READ_SAMPLE_US     15   // Low longer than this is a 0
+
+// Items needed to encode a reset
+#define OWIRE_RESET_ITEMS        1
+
+#define OWIRE_ITEM(d0, l0, d1, l1) \
+	(((uint32_t)(d0) & 0x7fff) | ((uint32_t)(l0) << 15) | (((uint32_t)(d1) & 0x7fff) << 16) | ((uint32_t)(l1) << 31))
+
+/**
+ * @brief Encode a reset slot.
+ *
+ * @param items Encoded items, OWIRE_RESET_ITEMS are needed.
+ *
+ * @return Number of items.
+ */
+uint32_t owire_encode_reset(uint32_t *items);
+
+/**
+ * @brief Encode write slots, one item per bit, LSB first. A read slot is a
+ *        write slot of a 1.
+ *
+ * @param data Bits to write.
+ * @param bits Number of bits.
+ * @param items Encoded items, one per bit.
+ *
+ * @return Number of items.
+ */
+uint32_t owire_encode_bits(const uint8_t *data, uint32_t bits, uint32_t *items);
+
+/**
+ * @brief Decode a captured reset slot.
+ *
+ * @param items Captured items.
+ * @param len Number of captured items.
+ *
+ * @return 0 if a presence pulse was detected, 1 if not (as TM_OneWire_Reset).
+ */
+int owire_decode_reset(const uint32_t *items, uint32_t len);
+
+/**
+ * @brief Decode captured slots, LSB first.
+ *
+ * @param items Captured items.
+ * @param len Number of captured items.
+ * @param data Decoded bits.
+ * @param bits Number of expected bits.
+ *
+ * @return Number of decoded bits. If less than bits, some slots were lost.
+ */
+uint32_t owire_decode_bits(const uint32_t *items, uint32_t len, uint8_t *data, uint32_t bits);
+
+/**
+ * @brief Compute the Dallas / Maxim CRC8 used in ROM codes and scratchpads.
+ *
+ * @param data Data.
+ * @param len Data length.
+ *
+ * @return CRC8.
+ */
+uint8_t owire_crc8(const uint8_t *data, uint32_t len);
+
+#endif /* _OWIRE_SLOTS_H_ */
@@ -80,7 +80,7 @@ static void _pwbus_init() {
 	driver_lock(PWBUS_DRIVER, 0, GPIO_DRIVER, CONFIG_LUA_RTOS_POWER_BUS_PIN, DRIVER_ALL_FLAGS, NULL);
 #endif
 
-	mtx_init(&mtx, NULL, NULL, 0);
+	mtx_init(&mtx, "power_bus", NULL, 0);
 
 	gpio_pin_output(CONFIG_LUA_RTOS_POWER_BUS_PIN);
 	gpio_pin_clr(CONFIG_LUA_RTOS_POWER_BUS_PIN);
@@ -50,11 +50,16 @@
 #include <math.h>
 #include <string.h>
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
 #include <esp_log.h>
 #include <soc/soc.h>
 #include <driver/rmt.h>
 
 #include <drivers/rmt.h>
+#include <drivers/rmt_stream.h>
 #include <drivers/cpu.h>
 #include <drivers/gpio.h>
 
@@ -74,16 +79,33 @@ DRIVER_REGISTER_BEGIN(RMT,rmt,CPU_LAST_RMT_CH - CPU_FIRST_RMT_CH + 1,rmt_init,NU
     DRIVER_REGISTER_ERROR(RMT, rmt, InvalidTimeout, "invalid timeout", RMT_ERR_INVALID_TIMEOUT);
     DRIVER_REGISTER_ERROR(RMT, rmt, InvalidFilterTicks, "invalid filter ticks", RMT_ERR_INVALID_FILTER_TICKS);
     DRIVER_REGISTER_ERROR(RMT, rmt, InvalidIdleThreshold, "invalid idle threshold", RMT_ERR_INVALID_IDLE_THRESHOLD);
+    DRIVER_REGISTER_ERROR(RMT, rmt, NotStreaming, "not in stream mode", RMT_ERR_NOT_STREAMING);
+    DRIVER_REGISTER_ERROR(RMT, rmt, Streaming, "already in stream mode", RMT_ERR_STREAMING);
 DRIVER_REGISTER_END(RMT,rmt,CPU_LAST_RMT_CH - CPU_FIRST_RMT_CH + 1,rmt_init,NULL);
 
 static rmt_device_t *devices = NULL;
 
+// RMT device in stream mode
+typedef struct {
+    rmt_stream_t ring;             // Received frames
+    uint32_t *buffer;              // Ring buffer storage
+    SemaphoreHandle_t frames;      // Counts the frames in the ring buffer
+    SemaphoreHandle_t stopped;     // Given by the stream task when it ends
+    SemaphoreHandle_t left;        // Given by the last reader, once the stream is stopped
+    TaskHandle_t task;
+    volatile uint8_t stop;
+    uint8_t self_stop;             // Stopped by the callback, the task frees the stream
+    uint8_t readers;               // Readers waiting for a frame
+    rmt_stream_callback_t callback;
+    void *arg;
+} rmt_rx_stream_t;
+
 /*
  * Helper functions
  */
 
 static void rmt_init() {
-    mtx_init(&mtx, NULL, NULL, 0);
+    mtx_init(&mtx, "rmt", NULL, 0);
 }
 
 static void tx_end(rmt_channel_t channel, void *arg) {
@@ -101,6 +123,90 @@ static void switch_rx(int channel) {
     rmt_rx_start(channel, 1);
 }
 
+// Detach a stopped stream from it's device, and wait until it's readers leave
+static void stream_detach(uint8_t channel, rmt_rx_stream_t *stream) {
+    int readers, i;
+
+    mtx_lock(&devices[channel].mtx);
+
+    assert(rmt_rx_stop(channel) == ESP_OK);
+
+    devices[channel].stream = NULL;
+
+    // Wake up the readers, they see that the stream is stopped
+    readers = stream->readers;
+    for(i = 0; i < readers; i++) {
+        xSemaphoreGive(stream->frames);
+    }
+
+    mtx_unlock(&devices[channel].mtx);
+
+    // Wait until the last reader leaves the stream
+    if (readers > 0) {
+        xSemaphoreTake(stream->left, portMAX_DELAY);
+    }
+}
+
+static void stream_free(rmt_rx_stream_t *stream) {
+    vSemaphoreDelete(stream->left);
+    vSemaphoreDelete(stream->stopped);
+    vSemaphoreDelete(stream->frames);
+    free(stream->buffer);
+    free(stream);
+}
+
+// Move the frames received by the RMT to the stream's ring buffer
+static void rmt_stream_task(void *arg) {
+    uint8_t channel = (uint32_t)arg;
+    rmt_rx_stream_t *stream = (rmt_rx_stream_t *)devices[channel].stream;
+    rmt_item_t items[RMT_STREAM_MAX_ITEMS];
+    rmt_item32_t *ritems;
+    size_t size;
+    uint32_t count, i;
+
+    while (!stream->stop) {
+        ritems = (rmt_item32_t *)xRingbufferReceive(devices[channel].rb, &size, 100 / portTICK_PERIOD_MS);
+        if (!ritems) {
+            continue;
+        }
+
+        // Ring buffer item size is in bytes
+        count = size / sizeof(rmt_item32_t);
+        if (count > RMT_STREAM_MAX_ITEMS) {
+            count = RMT_STREAM_MAX_ITEMS;
+        }
+
+        memcpy(items, ritems, count * sizeof(rmt_item32_t));
+        vRingbufferReturnItem(devices[channel].rb, (void *)ritems);
+
+        // Frames must be expressed in channel's range time units
+        if (devices[channel].rx.scale != 1.0) {
+            for(i = 0; i < count;i++) {
+                items[i].duration0 *= devices[channel].rx.scale;
+                items[i].duration1 *= devices[channel].rx.scale;
+            }
+        }
+
+        if (rmt_stream_put(&stream->ring, (uint32_t *)items, count) == 0) {
+            xSemaphoreGive(stream->frames);
+
+            if (stream->callback) {
+                stream->callback(channel, stream->arg);
+            }
+        }
+    }
+
+    if (stream->self_stop) {
+        // The stream was stopped from the callback, and nobody is waiting
+        // for this task
+        stream_free(stream);
+    } else {
+        xSemaphoreGive(stream->stopped);
+    }
+
+    vTaskDelete(NULL);
+}
+
 /*
  * Operation functions
  */
@@ -109,7 +215,7 @@ static int rmt_get_channel_by_pin(int pin) {
     int i;
 
     for (i = CPU_FIRST_RMT_CH; i < CPU_LAST_RMT_CH; i++) {
-        if (devices[i].pin == pin) {
+        if ((devices[i].pin == pin) && !devices[i].reserved) {
             return i;
         }
     }
@@ -409,6 +515,12 @@ driver_error_t *rmt_rx(int deviceid, rmt_item_t *rx, size_t rx_pulses, uint32_t
 
     mtx_lock(&devices[channel].mtx);
 
+    // Frames are received by the stream
+    if (devices[channel].stream) {
+        mtx_unlock(&devices[channel].mtx);
+        return driver_error(RMT_DRIVER, RMT_ERR_STREAMING, NULL);
+    }
+
     assert(rmt_set_pin(channel, RMT_MODE_RX, devices[channel].pin) == ESP_OK);
     assert(rmt_rx_start(channel, 1) == ESP_OK);
 
@@ -496,6 +608,12 @@ driver_error_t *rmt_tx_rx(int deviceid, rmt_item_t *tx, size_t tx_pulses, rmt_it
 
     mtx_lock(&devices[channel].mtx);
 
+    // Frames are received by the stream
+    if (devices[channel].stream) {
+        mtx_unlock(&devices[channel].mtx);
+        return driver_error(RMT_DRIVER, RMT_ERR_STREAMING, NULL);
+    }
+
     // TX buffer is expressed in channel's range time units, so scale values if it's required
     if (devices[channel].tx.scale != 1.0) {
         int i;
@@ -589,6 +707,259 @@ driver_error_t *rmt_tx_rx(int deviceid, rmt_item_t *tx, size_t tx_pulses, rmt_it
     return NULL;
 }
 
+driver_error_t *rmt_tx_rx_capture(int deviceid, rmt_item_t *tx, size_t tx_pulses, rmt_item_t *rx, size_t *rx_pulses, uint32_t timeout) {
+    uint8_t channel = deviceid; // RMT channel
+    rmt_item_t *cbuff;          // Current position in tx / rx buffer
+
+    mtx_lock(&devices[channel].mtx);
+
+    // Frames are received by the stream
+    if (devices[channel].stream) {
+        mtx_unlock(&devices[channel].mtx);
+        return driver_error(RMT_DRIVER, RMT_ERR_STREAMING, NULL);
+    }
+
+    // TX buffer is expressed in channel's range time units, so scale values if it's required
+    if (devices[channel].tx.scale != 1.0) {
+        int i;
+
+        cbuff = tx;
+        for(i = 0; i < tx_pulses;i++) {
+            cbuff->duration0 /= devices[channel].tx.scale;
+            cbuff->duration1 /= devices[channel].tx.scale;
+
+            cbuff++;
+        }
+    }
+
+    // Reception is started in the transmission end callback, as in rmt_tx_rx
+    devices[channel].tx.callback = switch_rx;
+
+    rmt_set_pin(channel, RMT_MODE_TX, devices[channel].pin);
+
+    assert(rmt_write_items(channel, (rmt_item32_t *)tx, tx_pulses, 1) == ESP_OK);
+
+    devices[channel].tx.callback = NULL;
+
+    // Convert timeout to FreeRTOS ticks
+    if (devices[channel].rx.range == RMTPulseRangeNSEC) {
+        timeout = ceil(((double)timeout / 1000000.0) / portTICK_PERIOD_MS);
+    } else if (devices[channel].rx.range == RMTPulseRangeUSEC) {
+        timeout = ceil(((double)timeout / 1000.0) / portTICK_PERIOD_MS);
+    } else if (devices[channel].rx.range == RMTPulseRangeMSEC) {
+        timeout = ceil((double)timeout / portTICK_PERIOD_MS);
+    }
+
+    // The RMT puts all the items captured until the idle threshold in one
+    // ring buffer item, so the capture is received at once, and the task
+    // is blocked until then
+    rmt_item32_t *ritems;
+    size_t items = 0;
+
+    ritems = (rmt_item32_t*)xRingbufferReceive(devices[channel].rb, &items, timeout);
+
+    assert(rmt_rx_stop(channel) == ESP_OK);
+
+    if (!ritems) {
+        mtx_unlock(&devices[channel].mtx);
+        return driver_error(RMT_DRIVER, RMT_ERR_TIMEOUT, NULL);
+    }
+
+    // Ring buffer item size is in bytes
+    items /= sizeof(rmt_item32_t);
+    if (items > *rx_pulses) {
+        items = *rx_pulses;
+    }
+
+    memcpy(rx, ritems, items * sizeof(rmt_item32_t));
+    vRingbufferReturnItem(devices[channel].rb, (void *)ritems);
+
+    mtx_unlock(&devices[channel].mtx);
+
+    *rx_pulses = items;
+
+    // RX buffer must be expressed in channel's range time units, so scale values if it's required
+    cbuff = rx;
+
+    if (devices[channel].rx.scale != 1.0) {
+        int i;
+
+        for(i = 0; i < items;i++) {
+            cbuff->duration0 *= devices[channel].rx.scale;
+            cbuff->duration1 *= devices[channel].rx.scale;
+
+            cbuff++;
+        }
+    }
+
+    return NULL;
+}
+
+driver_error_t *rmt_rx_stream_start(int deviceid, size_t items, rmt_stream_callback_t callback, void *arg) {
+    uint8_t channel = deviceid; // RMT channel
+    rmt_rx_stream_t *stream;
+    uint32_t words;
+
+    mtx_lock(&devices[channel].mtx);
+
+    if (devices[channel].stream) {
+        mtx_unlock(&devices[channel].mtx);
+        return driver_error(RMT_DRIVER, RMT_ERR_STREAMING, NULL);
+    }
+
+    // Ring buffer size must be a power of 2, with room for the largest frame
+    words = RMT_STREAM_MAX_ITEMS << 1;
+    while (words < items) {
+        words <<= 1;
+    }
+
+    stream = calloc(1, sizeof(rmt_rx_stream_t));
+    if (!stream) {
+        mtx_unlock(&devices[channel].mtx);
+        return driver_error(RMT_DRIVER, RMT_ERR_NOT_ENOUGH_MEMORY, NULL);
+    }
+
+    stream->buffer = malloc(words * sizeof(uint32_t));
+    stream->frames = xSemaphoreCreateCounting(words, 0);
+    stream->stopped = xSemaphoreCreateBinary();
+    stream->left = xSemaphoreCreateBinary();
+
+    if (!stream->buffer || !stream->frames || !stream->stopped || !stream->left) {
+        goto no_mem;
+    }
+
+    rmt_stream_init(&stream->ring, stream->buffer, words);
+    stream->callback = callback;
+    stream->arg = arg;
+
+    devices[channel].stream = stream;
+
+    assert(rmt_set_pin(channel, RMT_MODE_RX, devices[channel].pin) == ESP_OK);
+    assert(rmt_rx_start(channel, 1) == ESP_OK);
+
+    if (xTaskCreatePinnedToCore(rmt_stream_task, "rmt", CONFIG_LUA_RTOS_LUA_THREAD_STACK_SIZE, (void *)((uint32_t)channel),
+                                CONFIG_LUA_RTOS_LUA_THREAD_PRIORITY, &stream->task, xPortGetCoreID()) != pdPASS) {
+        assert(rmt_rx_stop(channel) == ESP_OK);
+        devices[channel].stream = NULL;
+        goto no_mem;
+    }
+
+    mtx_unlock(&devices[channel].mtx);
+
+    return NULL;
+
+no_mem:
+    if (stream->left) vSemaphoreDelete(stream->left);
+    if (stream->stopped) vSemaphoreDelete(stream->stopped);
+    if (stream->frames) vSemaphoreDelete(stream->frames);
+    free(stream->buffer);
+    free(stream);
+
+    mtx_unlock(&devices[channel].mtx);
+
+    return driver_error(RMT_DRIVER, RMT_ERR_NOT_ENOUGH_MEMORY, NULL);
+}
+
+driver_error_t *rmt_rx_stream_read(int deviceid, rmt_item_t *rx, size_t *rx_pulses, uint32_t timeout) {
+    uint8_t channel = deviceid; // RMT channel
+    rmt_rx_stream_t *stream;
+    uint32_t count = *rx_pulses;
+    int got;
+
+    mtx_lock(&devices[channel].mtx);
+
+    stream = (rmt_rx_stream_t *)devices[channel].stream;
+    if (!stream) {
+        mtx_unlock(&devices[channel].mtx);
+        return driver_error(RMT_DRIVER, RMT_ERR_NOT_STREAMING, NULL);
+    }
+
+    // The stream is not freed while there are readers
+    stream->readers++;
+
+    mtx_unlock(&devices[channel].mtx);
+
+    got = (xSemaphoreTake(stream->frames, timeout / portTICK_PERIOD_MS) == pdTRUE);
+
+    // There is one frame for each semaphore count, but the ring buffer has
+    // only one consumer, so serialize the readers
+    mtx_lock(&devices[channel].mtx);
+
+    if (got && !stream->stop) {
+        rmt_stream_get(&stream->ring, (uint32_t *)rx, &count);
+    }
+
+    if ((--stream->readers == 0) && stream->stop) {
+        xSemaphoreGive(stream->left);
+    }
+
+    if (stream->stop) {
+        mtx_unlock(&devices[channel].mtx);
+        return driver_error(RMT_DRIVER, RMT_ERR_NOT_STREAMING, NULL);
+    }
+
+    mtx_unlock(&devices[channel].mtx);
+
+    if (!got) {
+        return driver_error(RMT_DRIVER, RMT_ERR_TIMEOUT, NULL);
+    }
+
+    *rx_pulses = count;
+
+    return NULL;
+}
+
+uint32_t rmt_rx_stream_dropped(int deviceid) {
+    uint8_t channel = deviceid; // RMT channel
+    rmt_rx_stream_t *stream;
+    uint32_t dropped = 0;
+
+    mtx_lock(&devices[channel].mtx);
+
+    stream = (rmt_rx_stream_t *)devices[channel].stream;
+    if (stream) {
+        dropped = stream->ring.dropped;
+    }
+
+    mtx_unlock(&devices[channel].mtx);
+
+    return dropped;
+}
+
+void rmt_rx_stream_stop(int deviceid) {
+    uint8_t channel = deviceid; // RMT channel
+    rmt_rx_stream_t *stream;
+
+    mtx_lock(&devices[channel].mtx);
+
+    stream = (rmt_rx_stream_t *)devices[channel].stream;
+    if (!stream || stream->stop) {
+        // Not streaming, or already stopping
+        mtx_unlock(&devices[channel].mtx);
+        return;
+    }
+
+    stream->stop = 1;
+
+    mtx_unlock(&devices[channel].mtx);
+
+    if (xTaskGetCurrentTaskHandle() == stream->task) {
+        // Called from the callback, the task can't be waited for, so it
+        // frees the stream when the callback returns
+        stream->self_stop = 1;
+        stream_detach(channel, stream);
+
+        return;
+    }
+
+    // Wait for the stream task, without the lock, because the callback can
+    // call the driver
+    xSemaphoreTake(stream->stopped, portMAX_DELAY);
+
+    stream_detach(channel, stream);
+    stream_free(stream);
+}
+
 void rmt_unsetup_tx(int deviceid) {
     uint8_t channel = deviceid; // RMT channel
 
@@ -623,6 +994,8 @@ void rmt_unsetup_tx(int deviceid) {
 void rmt_unsetup_rx(int deviceid) {
     uint8_t channel = deviceid; // RMT channel
 
+    rmt_rx_stream_stop(deviceid);
+
     mtx_lock(&mtx);
 
     // Device now is not for RX
@@ -651,4 +1024,42 @@ void rmt_unsetup_rx(int deviceid) {
     return NULL;
 }
 
+driver_error_t *rmt_reserve_channel(int pin, int *channel) {
+    mtx_lock(&mtx);
+
+    // Create device structure, if required
+    if (create_devices() < 0) {
+        mtx_unlock(&mtx);
+
+        return driver_error(RMT_DRIVER, RMT_ERR_NOT_ENOUGH_MEMORY, NULL);
+    }
+
+    int free_channel = rmt_get_free_channel();
+    if (free_channel < 0) {
+        mtx_unlock(&mtx);
+
+        // No more channels
+        return driver_error(RMT_DRIVER, RMT_ERR_NO_MORE_RMT, NULL);
+    }
+
+    devices[free_channel].pin = pin;
+    devices[free_channel].reserved = 1;
+    *channel = free_channel;
+
+    mtx_unlock(&mtx);
+
+    return NULL;
+}
+
+void rmt_release_channel(int channel) {
+    mtx_lock(&mtx);
+
+    if (devices && devices[channel].reserved) {
+        devices[channel].reserved = 0;
+        devices[channel].pin = -1;
+    }
+
+    mtx_unlock(&mtx);
+}
+
 #endif
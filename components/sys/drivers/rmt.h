@@ -88,6 +88,8 @@ typedef struct {
     struct mtx mtx;
     RingbufHandle_t rb;
 
+    uint8_t reserved;
+
     uint8_t rx_config;
     struct {
         rmt_pulse_range_t range;
@@ -100,8 +102,16 @@ typedef struct {
         float scale;
         rmt_callback_t callback;
     } tx;
+
+    void *stream;
 } rmt_device_t;
 
+// Callback called by the RMT stream task when a frame is received
+typedef void (*rmt_stream_callback_t)(int deviceid, void *arg);
+
+// Largest frame received in stream mode (one RMT memory block)
+#define RMT_STREAM_MAX_ITEMS 64
+
 // RMT errors
 #define RMT_ERR_INVALID_PULSE_RANGE             (DRIVER_EXCEPTION_BASE(RMT_DRIVER_ID) |  0)
 #define RMT_ERR_NOT_ENOUGH_MEMORY               (DRIVER_EXCEPTION_BASE(RMT_DRIVER_ID) |  1)
@@ -112,6 +122,8 @@ typedef struct {
 #define RMT_ERR_INVALID_TIMEOUT                 (DRIVER_EXCEPTION_BASE(RMT_DRIVER_ID) |  6)
 #define RMT_ERR_INVALID_FILTER_TICKS            (DRIVER_EXCEPTION_BASE(RMT_DRIVER_ID) |  7)
 #define RMT_ERR_INVALID_IDLE_THRESHOLD          (DRIVER_EXCEPTION_BASE(RMT_DRIVER_ID) |  8)
+#define RMT_ERR_NOT_STREAMING                   (DRIVER_EXCEPTION_BASE(RMT_DRIVER_ID) |  9)
+#define RMT_ERR_STREAMING                       (DRIVER_EXCEPTION_BASE(RMT_DRIVER_ID) | 10)
 
 extern const int rmt_errors;
 extern const int rmt_error_map;
@@ -247,5 +259,124 @@ driver_error_t *rmt_tx(int deviceid, rmt_item_t *tx, size_t tx_pulses);
  */
 driver_error_t *rmt_tx_rx(int deviceid, rmt_item_t *tx, size_t tx_pulses, rmt_item_t *rx, size_t rx_pulses, uint32_t timeout);
 
+/**
+ * @brief Transmit a number of pulses to the RMT device, and then, capture the pulses received until the
+ *        device's idle threshold is reached. As in rmt_tx_rx, the switch between transmission and reception
+ *        is done inside an ISR. The calling task is blocked while the capture is in progress. This function
+ *        is thread safe.
+ *
+ * @param deviceid RMT device id.
+ *
+ * @param tx A pointer to a buffer of rmt_item_t structure, which contains the pulses to transmit.
+ *           In this buffer, all pulse duration is expressed in the device's pulse_range units
+ *           (nanoseconds, microseconds, or milliseconds).
+ *
+ * @param tx_pulses Number of pulses to transmit.
+ *
+ * @param rx A pointer to a buffer of rmt_item_t structure, in which the captured data will be returned.
+ *           In this buffer, all pulse duration data is expressed in the decvice's pulse_range units
+ *           (nanoseconds, microseconds, or milliseconds).
+ *
+ * @param rx_pulses On input, size of the rx buffer. On output, number of captured pulses.
+ *
+ * @param timeout A timeout, expressed in the device's pulse_range units, to wait for the capture.
+ *
+ * @return
+ *     - NULL success
+ *     - Pointer to driver_error_t if some error occurs.
+ *
+ *          RMT_ERR_TIMEOUT
+ */
+driver_error_t *rmt_tx_rx_capture(int deviceid, rmt_item_t *tx, size_t tx_pulses, rmt_item_t *rx, size_t *rx_pulses, uint32_t timeout);
+
+/**
+ * @brief Start the continuous reception of a RMT device. Each frame (the pulses received until the device's
+ *        idle threshold is reached) is put in a ring buffer by a task, and can be read with rmt_rx_stream_read.
+ *        If the ring buffer is full, received frames are dropped. While the stream is started, rmt_rx and
+ *        rmt_tx_rx can't be used with the device.
+ *
+ * @param deviceid RMT device id, set up for receive data.
+ *
+ * @param items Size of the ring buffer, in items. Each frame needs one more item for it's header.
+ *
+ * @param callback A function called by the stream task each time a frame is put in the ring buffer, or
+ *                 NULL.
+ *
+ * @param arg Argument passed to the callback.
+ *
+ * @return
+ *     - NULL success
+ *     - Pointer to driver_error_t if some error occurs.
+ *
+ *          RMT_ERR_STREAMING
+ *          RMT_ERR_NOT_ENOUGH_MEMORY
+ */
+driver_error_t *rmt_rx_stream_start(int deviceid, size_t items, rmt_stream_callback_t callback, void *arg);
+
+/**
+ * @brief Read the oldest frame received by a RMT device in stream mode. This function is thread safe.
+ *
+ * @param deviceid RMT device id.
+ *
+ * @param rx A pointer to a buffer of rmt_item_t structure, in which the frame will be returned.
+ *           In this buffer, all pulse duration data is expressed in the decvice's pulse_range units
+ *           (nanoseconds, microseconds, or milliseconds).
+ *
+ * @param rx_pulses On input, size of the rx buffer. On output, number of pulses in the frame.
+ *
+ * @param timeout A timeout, expressed in milliseconds, to wait for a frame.
+ *
+ * @return
+ *     - NULL success
+ *     - Pointer to driver_error_t if some error occurs.
+ *
+ *          RMT_ERR_NOT_STREAMING
+ *          RMT_ERR_TIMEOUT
+ */
+driver_error_t *rmt_rx_stream_read(int deviceid, rmt_item_t *rx, size_t *rx_pulses, uint32_t timeout);
+
+/**
+ * @brief Get the number of frames dropped by a RMT device in stream mode, because the ring buffer was full.
+ *
+ * @param deviceid RMT device id.
+ *
+ * @return Number of dropped frames.
+ */
+uint32_t rmt_rx_stream_dropped(int deviceid);
+
+/**
+ * @brief Stop the continuous reception of a RMT device, and free all the stream resources.
+ *        Readers waiting in rmt_rx_stream_read are woken up, and return RMT_ERR_NOT_STREAMING.
+ *
+ * @param deviceid RMT device id.
+ */
+void rmt_rx_stream_stop(int deviceid);
+
+/**
+ * @brief Reserve a free RMT channel for a driver that configures and uses the RMT channel by
+ *        itself, through the esp-idf RMT API. The channel is not available for this driver
+ *        until it is released.
+ *
+ * @param pin GPIO number that will be used by the channel.
+ *
+ * @param channel A pointer to an integer that will be used to get the reserved channel.
+ *
+ * @return
+ *     - NULL success
+ *     - Pointer to driver_error_t if some error occurs.
+ *
+ *          RMT_ERR_NOT_ENOUGH_MEMORY
+ *          RMT_ERR_NO_MORE_RMT
+ */
+driver_error_t *rmt_reserve_channel(int pin, int *channel);
+
+/**
+ * @brief Release a RMT channel reserved with rmt_reserve_channel.
+ *
+ * @param channel RMT channel.
+ *
+ */
+void rmt_release_channel(int channel);
+
 
 #endif /* _DRIVERS_RMT_H_ */
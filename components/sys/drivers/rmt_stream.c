@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, RMT receive stream
+ *
+ */
+
+#include <string.h>
+
+#include <sys/drivers/rmt_stream.h>
+
+/*
+ * Helper functions
+ */
+
+static int match(int32_t duration, uint16_t expected, uint8_t tolerance) {
+	int32_t diff = duration - expected;
+
+	if (diff < 0) {
+		diff = -diff;
+	}
+
+	return (diff * 100 <= expected * tolerance);
+}
+
+/*
+ * Operation functions
+ */
+int rmt_stream_init(rmt_stream_t *stream, uint32_t *buffer, uint32_t words) {
+	if ((words < 2) || (words & (words - 1))) {
+		return -1;
+	}
+
+	stream->buffer = buffer;
+	stream->mask = words - 1;
+	stream->head = 0;
+	stream->tail = 0;
+	stream->dropped = 0;
+
+	return 0;
+}
+
+int rmt_stream_put(rmt_stream_t *stream, const uint32_t *items, uint32_t count) {
+	uint32_t head = stream->head;
+	uint32_t i;
+
+	// Frame needs a header word with the number of items
+	if (count + 1 > (stream->mask + 1) - (head - stream->tail)) {
+		stream->dropped++;
+		return -1;
+	}
+
+	stream->buffer[head++ & stream->mask] = count;
+	for (i = 0; i < count; i++) {
+		stream->buffer[head++ & stream->mask] = items[i];
+	}
+
+	// Frame must be written before it's published
+	__sync_synchronize();
+	stream->head = head;
+
+	return 0;
+}
+
+int rmt_stream_get(rmt_stream_t *stream, uint32_t *items, uint32_t *count) {
+	uint32_t tail = stream->tail;
+	uint32_t frame, i;
+
+	if (tail == stream->head) {
+		return -1;
+	}
+
+	__sync_synchronize();
+
+	frame = stream->buffer[tail++ & stream->mask];
+	if (frame < *count) {
+		*count = frame;
+	}
+
+	for (i = 0; i < *count; i++) {
+		items[i] = stream->buffer[(tail + i) & stream->mask];
+	}
+
+	// Frame must be read before it's space is released
+	__sync_synchronize();
+	stream->tail = tail + frame;
+
+	return 0;
+}
+
+uint32_t rmt_stream_used(rmt_stream_t *stream) {
+	return stream->head - stream->tail;
+}
+
+uint32_t rmt_stream_pulses(const uint32_t *items, uint32_t count, int32_t *pulses, uint32_t max) {
+	uint32_t half, duration, level;
+	uint32_t n = 0;
+	int32_t pulse;
+
+	for (half = 0; half < (count << 1); half++) {
+		if (half & 1) {
+			duration = (items[half >> 1] >> 16) & 0x7fff;
+			level = items[half >> 1] >> 31;
+		} else {
+			duration = items[half >> 1] & 0x7fff;
+			level = (items[half >> 1] >> 15) & 1;
+		}
+
+		if (duration == 0) {
+			break;
+		}
+
+		pulse = level?(int32_t)duration:-(int32_t)duration;
+
+		if ((n > 0) && ((pulses[n - 1] > 0) == (pulse > 0))) {
+			pulses[n - 1] += pulse;
+		} else if (n < max) {
+			pulses[n++] = pulse;
+		} else {
+			break;
+		}
+	}
+
+	return n;
+}
+
+int rmt_stream_decode(const int32_t *pulses, uint32_t count, const rmt_stream_proto_t *proto, uint8_t *data, uint32_t max_bits) {
+	int32_t sign = proto->inverted?-1:1;
+	int32_t mark, space;
+	uint32_t pos = 0;
+	uint32_t bits = 0;
+	int bit;
+
+	if (proto->header[0]) {
+		if ((count < 2) ||
+			!match(pulses[0] * sign, proto->header[0], proto->tolerance) ||
+			!match(-pulses[1] * sign, proto->header[1], proto->tolerance)) {
+			return -1;
+		}
+
+		pos = 2;
+	}
+
+	memset(data, 0, (max_bits + 7) / 8);
+
+	while ((bits < max_bits) && (pos < count)) {
+		mark = pulses[pos] * sign;
+		if (mark <= 0) {
+			break;
+		}
+
+		if (pos + 1 < count) {
+			space = -pulses[pos + 1] * sign;
+
+			if (match(mark, proto->one[0], proto->tolerance) && match(space, proto->one[1], proto->tolerance)) {
+				bit = 1;
+			} else if (match(mark, proto->zero[0], proto->tolerance) && match(space, proto->zero[1], proto->tolerance)) {
+				bit = 0;
+			} else {
+				break;
+			}
+		} else {
+			// The space of the last bit ends in the idle level, and is not
+			// captured, so the bit can only be decoded from it's mark
+			if (proto->one[0] == proto->zero[0]) {
+				break;
+			}
+
+			if (match(mark, proto->one[0], proto->tolerance)) {
+				bit = 1;
+			} else if (match(mark, proto->zero[0], proto->tolerance)) {
+				bit = 0;
+			} else {
+				break;
+			}
+		}
+
+		if (bit) {
+			data[bits >> 3] |= (0x80 >> (bits & 7));
+		}
+
+		bits++;
+		pos += 2;
+	}
+
+	return bits;
+}
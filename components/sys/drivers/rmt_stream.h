@@ -0,0 +1,148 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, RMT receive stream
+ *
+ * A single producer / single consumer ring buffer of captured RMT frames
+ * (the items captured until the idle threshold is reached), and helpers to
+ * decode the pulses of a frame. The producer is the RMT stream task, and the
+ * consumer is the task that reads the frames, so no locks are needed.
+ *
+ * Items use the RMT item layout (duration0:15, level0:1, duration1:15,
+ * level1:1). A 0 duration marks the end of a frame.
+ *
+ */
+
+#ifndef _DRIVERS_RMT_STREAM_H_
+#define _DRIVERS_RMT_STREAM_H_
+
+#include <stdint.h>
+
+typedef struct {
+	uint32_t *buffer;         // Storage, one word per item plus one word per frame
+	uint32_t mask;            // Storage size (power of 2) - 1
+	volatile uint32_t head;   // Write position, only updated by the producer
+	volatile uint32_t tail;   // Read position, only updated by the consumer
+	volatile uint32_t dropped;// Frames dropped because the ring buffer was full
+} rmt_stream_t;
+
+// Bit encoding of a pulse distance / pulse width protocol. Durations are in
+// the device's range units. Each bit is a mark followed by a space, where a
+// mark is a high pulse, or a low pulse for inverted protocols (for example,
+// IR receivers).
+typedef struct {
+	uint16_t header[2];       // Header mark and space, 0 if no header
+	uint16_t zero[2];         // Mark and space of a 0
+	uint16_t one[2];          // Mark and space of a 1
+	uint8_t tolerance;        // Tolerance, in percent
+	uint8_t inverted;         // Marks are low pulses
+} rmt_stream_proto_t;
+
+/**
+ * @brief Initialize a ring buffer.
+ *
+ * @param stream Ring buffer.
+ * @param buffer Storage.
+ * @param words Storage size, in words. Must be a power of 2.
+ *
+ * @return 0 on success, -1 if words is not a power of 2.
+ */
+int rmt_stream_init(rmt_stream_t *stream, uint32_t *buffer, uint32_t words);
+
+/**
+ * @brief Put a frame in the ring buffer. If there is not enough room for the
+ *        frame it is dropped, and the dropped counter is incremented.
+ *
+ * @param stream Ring buffer.
+ * @param items Frame items.
+ * @param count Number of items.
+ *
+ * @return 0 on success, -1 if the frame was dropped.
+ */
+int rmt_stream_put(rmt_stream_t *stream, const uint32_t *items, uint32_t count);
+
+/**
+ * @brief Get the oldest frame from the ring buffer. If the frame doesn't fit
+ *        in items it is truncated.
+ *
+ * @param stream Ring buffer.
+ * @param items Frame items.
+ * @param count On input, size of items. On output, number of items copied.
+ *
+ * @return 0 on success, -1 if the ring buffer is empty.
+ */
+int rmt_stream_get(rmt_stream_t *stream, uint32_t *items, uint32_t *count);
+
+/**
+ * @brief Number of words used in the ring buffer.
+ */
+uint32_t rmt_stream_used(rmt_stream_t *stream);
+
+/**
+ * @brief Convert the items of a frame to pulses. Each pulse is a duration,
+ *        positive for a high level, and negative for a low level. Consecutive
+ *        halves with the same level are merged in one pulse.
+ *
+ * @param items Frame items.
+ * @param count Number of items.
+ * @param pulses Pulses.
+ * @param max Size of pulses.
+ *
+ * @return Number of pulses.
+ */
+uint32_t rmt_stream_pulses(const uint32_t *items, uint32_t count, int32_t *pulses, uint32_t max);
+
+/**
+ * @brief Decode the bits of a pulse distance / pulse width protocol, MSB
+ *        first. Decoding stops at the first pulse pair that doesn't match
+ *        a bit.
+ *
+ * @param pulses Pulses, as returned by rmt_stream_pulses.
+ * @param count Number of pulses.
+ * @param proto Protocol.
+ * @param data Decoded bits.
+ * @param max_bits Maximum number of bits to decode.
+ *
+ * @return Number of decoded bits, or -1 if the header doesn't match.
+ */
+int rmt_stream_decode(const int32_t *pulses, uint32_t count, const rmt_stream_proto_t *proto, uint8_t *data, uint32_t max_bits);
+
+#endif /* _DRIVERS_RMT_STREAM_H_ */
@@ -128,7 +128,7 @@ static void __rtc_init() {
     esp_sleep_pd_config(ESP_PD_DOMAIN_RTC_SLOW_MEM, ESP_PD_OPTION_ON);
 
     // Create mutex
-    mtx_init(&mtx, NULL, NULL, 0);
+    mtx_init(&mtx, "rtc", NULL, 0);
 }
 
 size_t rtc_mem_size() {
@@ -717,6 +717,10 @@ int IRAM_ATTR spi_ll_bulk_rw(int deviceid, uint32_t nbytes, uint8_t *data) {
     return 0;
 }
 
+void IRAM_ATTR spi_ll_bulk_transfer(int deviceid, uint32_t nbytes, uint8_t *tx, uint8_t *rx) {
+    spi_master_op(deviceid, 1, nbytes, tx, rx);
+}
+
 void IRAM_ATTR spi_ll_bulk_write16(int deviceid, uint32_t nelements, uint16_t *data) {
     spi_master_op(deviceid, 2, nelements, (uint8_t *) data, NULL);
 }
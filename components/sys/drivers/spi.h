@@ -238,6 +238,21 @@ void spi_ll_bulk_read(int deviceid, uint32_t nbytes, uint8_t *data);
  */
 int spi_ll_bulk_rw(int deviceid, uint32_t nbytes, uint8_t *data);
 
+/**
+ * @brief Transfer and read a chunk of bytes to / from the device in a single transaction,
+ *        using separate buffers, without allocating memory. Device must be selected
+ *        before calling this function (use spi_ll_select for that). This function is thread safe.
+ *        No sanity checks are done (use only in driver develop).
+ *
+ * @param deviceid Device identifier.
+ * @param nbytes Number of bytes to transfer.
+ * @param tx A pointer to the buffer with the data to transfer. If NULL, 0xff are transferred.
+ * @param rx A pointer to the buffer to store the read data. If NULL, read data are discarded.
+ *        If the device uses DMA, both buffers must be in internal RAM.
+ *
+ */
+void spi_ll_bulk_transfer(int deviceid, uint32_t nbytes, uint8_t *tx, uint8_t *rx);
+
 /**
  * @brief Transfer a chunk of 16-bit data to the device. Device must be selected
  *        before calling this function (use spi_ll_select for that). This function is thread safe.
@@ -55,6 +55,9 @@ DRIVER_REGISTER_BEGIN(STEPPER,stepper,0,stepper_init,NULL);
     DRIVER_REGISTER_ERROR(STEPPER, stepper, InvalidPin, "invalid pin", STEPPER_ERR_INVALID_PIN);
     DRIVER_REGISTER_ERROR(STEPPER, stepper, InvalidDirection, "invalid direction", STEPPER_ERR_INVALID_DIRECTION);
     DRIVER_REGISTER_ERROR(STEPPER, stepper, InvalidAcceleration, "invalid acceleration", STEPPER_ERR_INVALID_ACCELERATION);
+    DRIVER_REGISTER_ERROR(STEPPER, stepper, PathFull, "path is full", STEPPER_ERR_PATH_FULL);
+    DRIVER_REGISTER_ERROR(STEPPER, stepper, InvalidSpeed, "invalid speed", STEPPER_ERR_INVALID_SPEED);
+    DRIVER_REGISTER_ERROR(STEPPER, stepper, Busy, "stepper is busy", STEPPER_ERR_BUSY);
 DRIVER_REGISTER_END(STEPPER,stepper,0,stepper_init,NULL);
 
 static stepper_t stepper[NSTEP];
@@ -77,12 +80,46 @@ static struct mtx stepper_mutex;
 static portMUX_TYPE spinlock = portMUX_INITIALIZER_UNLOCKED;
 static TaskHandle_t waiting_task = NULL;
 
+// Path planner, for coordinated movements, and it's lock. The planner is
+// shared between the acceleration profile task and stepper_line, that can add
+// segments while the path is running.
+static planner_t planner;
+static struct mtx planner_mutex;
+
+// Steppers who are currently running a path
+static uint32_t path_mask = 0;
+
+// A path stop has been requested
+static uint8_t path_stop = 0;
+
 /*
  * Helper functions
  */
 static void stepper_init() {
-    mtx_init(&stepper_mutex, NULL, NULL, 0);
+    mtx_init(&stepper_mutex, "stepper", NULL, 0);
+    mtx_init(&planner_mutex, "planner", NULL, 0);
     memset(stepper,0,sizeof(stepper_t) * NSTEP);
+
+    planner_init(&planner, 0, STEPPER_RMT_TICKS_PER_SECOND, STEPPER_JUNCTION_DEVIATION, STEPPER_PULSE_TICKS);
+}
+
+/*
+ * Write a RMT item generated by the path planner into the RMT data circular
+ * buffer of a stepper.
+ */
+static int IRAM_ATTR path_emit(void *arg, uint8_t unit, uint32_t item) {
+    stepper_t *pstepper = &stepper[unit];
+    uint32_t next = ((pstepper->rmt_data_head + 1) % (STEPPER_RMT_DATA_SIZE));
+
+    if (next == pstepper->rmt_data_tail) {
+        // No space in buffer
+        return 0;
+    }
+
+    pstepper->rmt_data[pstepper->rmt_data_head] = item;
+    pstepper->rmt_data_head = next;
+
+    return 1;
 }
 
 static void IRAM_ATTR rmt_isr(void *arg) {
@@ -163,12 +200,20 @@ static void IRAM_ATTR acceleration_profile_task(void *args) {
         // Wait for cycle
         xQueueReceive(acceleration_queue, &cycle_for_mask, portMAX_DELAY);
 
+        // Steppers that are running a path are feed by the planner, that
+        // generates the data for all of them at once
+        if (cycle_for_mask & path_mask) {
+            mtx_lock(&planner_mutex);
+            planner_fill(&planner, path_emit, NULL);
+            mtx_unlock(&planner_mutex);
+        }
+
         // Run a new cycle with the involved steppers
         pstepper = stepper;
         stepper_num = 0;
 
         // For all the required steppers
-        cycle_mask = cycle_for_mask;
+        cycle_mask = cycle_for_mask & ~path_mask;
 
         while (cycle_mask) {
             if (cycle_mask & 0x01) {
@@ -194,7 +239,7 @@ static void IRAM_ATTR acceleration_profile_task(void *args) {
 
                     if (pstepper->rmt_ticks_remain == 0) {
                         // Compute RMT ticks for next step
-                        pstepper->rmt_ticks = floor(motion_next(&pstepper->motion) * 1000000000.0) / STEPPER_RMT_NANOS_PER_TICK;
+                        pstepper->rmt_ticks = motion_next_ticks(&pstepper->motion);
                         rmt_ticks = pstepper->rmt_ticks;
                     } else {
                         rmt_ticks = pstepper->rmt_ticks_remain;
@@ -309,20 +354,26 @@ static void IRAM_ATTR acceleration_profile_task(void *args) {
         pstepper = stepper;
         stepper_num = 0;
 
+        uint32_t tx_start_mask = 0;
+
         while (cycle_mask) {
             if (cycle_mask & 0x01) {
                 if (pstepper->rmt_start && !pstepper->rmt_started) {
                     int idx;
 
                     for(idx = 0;idx < STEPPER_RMT_BUFF_SIZE; idx++) {
-                        RMTMEM.chan[stepper_num].data32[idx].val = pstepper->rmt_data[pstepper->rmt_data_tail + idx];
+                        if (pstepper->rmt_data_tail != pstepper->rmt_data_head) {
+                            RMTMEM.chan[stepper_num].data32[idx].val = pstepper->rmt_data[pstepper->rmt_data_tail];
 
-                        // Advance tail
-                        pstepper->rmt_data_tail = ((pstepper->rmt_data_tail + 1) % (STEPPER_RMT_DATA_SIZE));
+                            // Advance tail
+                            pstepper->rmt_data_tail = ((pstepper->rmt_data_tail + 1) % (STEPPER_RMT_DATA_SIZE));
+                        } else {
+                            // No more data, end of transmission
+                            RMTMEM.chan[stepper_num].data32[idx].val = 0;
+                        }
                     }
 
-                    RMT.conf_ch[stepper_num].conf1.mem_rd_rst = 1;
-                    RMT.conf_ch[stepper_num].conf1.tx_start = 1;
+                    tx_start_mask |= (1 << stepper_num);
 
                     pstepper->rmt_started = 1;
                 }
@@ -332,6 +383,15 @@ static void IRAM_ATTR acceleration_profile_task(void *args) {
             pstepper++;
             stepper_num++;
         }
+
+        // Start all the steppers at the same time, as close as possible, because steppers
+        // in a path must be synchronized
+        for(stepper_num = 0;tx_start_mask;stepper_num++, tx_start_mask >>= 1) {
+            if (tx_start_mask & 0x01) {
+                RMT.conf_ch[stepper_num].conf1.mem_rd_rst = 1;
+                RMT.conf_ch[stepper_num].conf1.tx_start = 1;
+            }
+        }
     }
 }
 
@@ -429,6 +489,9 @@ driver_error_t *stepper_setup(uint8_t step_pin, uint8_t dir_pin, float min_spd,
     stepper[*unit].mac_acc = max_acc;
     stepper[*unit].setup = 1;
 
+    // Stepper can be used in paths
+    planner.axes_mask |= (1 << *unit);
+
     // Configure RMT for this stepper
     periph_module_enable(PERIPH_RMT_MODULE);
 
@@ -508,6 +571,12 @@ driver_error_t *stepper_move(uint8_t unit, float units, float initial_spd, float
         return driver_error(STEPPER_DRIVER, STEPPER_ERR_UNIT_NOT_SETUP, NULL);
     }
 
+    if (path_mask & (1 << unit)) {
+        // Unit is running a path
+        mtx_unlock(&stepper_mutex);
+        return driver_error(STEPPER_DRIVER, STEPPER_ERR_BUSY, NULL);
+    }
+
     stepper_t *pstepper = &stepper[unit];
 
     // Calculate direction
@@ -517,7 +586,8 @@ driver_error_t *stepper_move(uint8_t unit, float units, float initial_spd, float
     // Prepare motion
     motion_constraints_t constraints;
 
-    constraints.accleration_profile = MotionSCurve;
+    constraints.accleration_profile = STEPPER_MOTION_PROFILE;
+    constraints.ticks_per_second = STEPPER_RMT_TICKS_PER_SECOND;
 
     constraints.s_curve.v0 = initial_spd;
     constraints.s_curve.v = target_spd;
@@ -602,6 +672,141 @@ void stepper_start(int mask) {
     #endif
 }
 
+driver_error_t *stepper_line(int mask, float *units, float speed, float acc) {
+    float steps_per_unit[NSTEP];
+    int i, ret;
+
+    // Sanity checks
+    if (speed <= 0.0) {
+        return driver_error(STEPPER_DRIVER, STEPPER_ERR_INVALID_SPEED, NULL);
+    }
+
+    if (acc <= 0.0) {
+        return driver_error(STEPPER_DRIVER, STEPPER_ERR_INVALID_ACCELERATION, NULL);
+    }
+
+    mtx_lock(&stepper_mutex);
+
+    for(i = 0; i < NSTEP; i++) {
+        if (mask & (1 << i)) {
+            if (!stepper[i].setup) {
+                // Unit not setup
+                mtx_unlock(&stepper_mutex);
+                return driver_error(STEPPER_DRIVER, STEPPER_ERR_UNIT_NOT_SETUP, NULL);
+            }
+
+            steps_per_unit[i] = stepper[i].steps_per_unit;
+        } else {
+            steps_per_unit[i] = 0;
+        }
+    }
+
+    mtx_lock(&planner_mutex);
+    ret = planner_add_line(&planner, mask, units, steps_per_unit, speed, acc);
+    mtx_unlock(&planner_mutex);
+
+    mtx_unlock(&stepper_mutex);
+
+    if (ret == PLANNER_ERR_QUEUE_FULL) {
+        return driver_error(STEPPER_DRIVER, STEPPER_ERR_PATH_FULL, NULL);
+    }
+
+    return NULL;
+}
+
+driver_error_t *stepper_run() {
+    driver_error_t *error = NULL;
+    uint8_t dir_mask, run_mask;
+    uint8_t i;
+    int more;
+
+    mtx_lock(&stepper_mutex);
+
+    if (path_mask || start_mask) {
+        // Another path or movement is running, and the end of movement
+        // notification can only be sent to one task
+        mtx_unlock(&stepper_mutex);
+        return driver_error(STEPPER_DRIVER, STEPPER_ERR_BUSY, NULL);
+    }
+
+    path_stop = 0;
+
+    // Each run starts and ends at zero speed, and has a fixed direction for each stepper
+    for(;;) {
+        mtx_lock(&planner_mutex);
+        more = !path_stop && planner_begin_run(&planner, &dir_mask);
+        run_mask = planner.run_mask;
+        mtx_unlock(&planner_mutex);
+
+        if (!more) {
+            break;
+        }
+
+        // Only the steppers that move in the run are started
+        portENTER_CRITICAL(&spinlock);
+        if (start_mask & run_mask) {
+            portEXIT_CRITICAL(&spinlock);
+            error = driver_error(STEPPER_DRIVER, STEPPER_ERR_BUSY, NULL);
+            break;
+        }
+        portEXIT_CRITICAL(&spinlock);
+
+        for(i = 0;i < NSTEP;i++) {
+            if (run_mask & (1 << i)) {
+                if (dir_mask & (1 << i)) {
+                    gpio_ll_pin_set(stepper[i].dir_pin);
+                } else {
+                    gpio_ll_pin_clr(stepper[i].dir_pin);
+                }
+
+                stepper[i].steps = 0;
+                stepper[i].rmt_ticks_remain = 0;
+                stepper[i].rmt_data_head = 0;
+                stepper[i].rmt_data_tail = 0;
+                stepper[i].rmt_offset = 0;
+                stepper[i].rmt_start = 1;
+                stepper[i].rmt_started = 0;
+            }
+        }
+
+        // Start the steppers in the run
+        portENTER_CRITICAL(&spinlock);
+        path_mask = run_mask;
+        start_mask |= path_mask;
+        waiting_task = xTaskGetCurrentTaskHandle();
+
+        start_num = 0;
+
+        for (i = 0;i < NSTEP;i++) {
+            if (start_mask & (1 << i)) {
+                start_num++;
+            }
+        }
+
+        portEXIT_CRITICAL(&spinlock);
+
+        xQueueSend(acceleration_queue, &run_mask, portMAX_DELAY);
+
+        // Wait until run done. The mutex is released, so new segments can be
+        // added to the path while it's running.
+        mtx_unlock(&stepper_mutex);
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        mtx_lock(&stepper_mutex);
+    }
+
+    if (path_stop || error) {
+        mtx_lock(&planner_mutex);
+        planner_clear(&planner);
+        mtx_unlock(&planner_mutex);
+    }
+
+    path_mask = 0;
+
+    mtx_unlock(&stepper_mutex);
+
+    return error;
+}
+
 void stepper_stop(int mask) {
     uint8_t channel;
     int testMask = 0x01;
@@ -609,6 +814,10 @@ void stepper_stop(int mask) {
     // Stop required steppers
     portENTER_CRITICAL(&spinlock);
 
+    if (path_mask & mask) {
+        path_stop = 1;
+    }
+
     channel = 0;
 
     while (testMask != (1 << (NSTEP - 1))) {
@@ -29,6 +29,7 @@
 #include <driver/rmt.h>
 
 #include <motion/motion.h>
+#include <motion/planner.h>
 
 // Max number of steppers
 #define NSTEP 8
@@ -39,6 +40,17 @@
 // Nonos per RMT tick
 #define STEPPER_RMT_NANOS_PER_TICK 25
 
+// RMT ticks per second
+#define STEPPER_RMT_TICKS_PER_SECOND (1000000000 / STEPPER_RMT_NANOS_PER_TICK)
+
+// Motion profile used for compute the step intervals. MotionSCurveFixed computes
+// the intervals using only integer arithmetic, MotionSCurve uses floating point.
+#define STEPPER_MOTION_PROFILE MotionSCurveFixed
+
+// Junction deviation used by the path planner, in units. Higher values
+// allow higher speeds at the junctions between path segments.
+#define STEPPER_JUNCTION_DEVIATION 0.05
+
 // Step pulse duration in RMT ticks
 #define STEPPER_PULSE_TICKS (STEPPER_PULSE_NANOS / STEPPER_RMT_NANOS_PER_TICK)
 
@@ -91,6 +103,9 @@ typedef struct {
 #define STEPPER_ERR_INVALID_PIN              (DRIVER_EXCEPTION_BASE(STEPPER_DRIVER_ID) |  4)
 #define STEPPER_ERR_INVALID_DIRECTION        (DRIVER_EXCEPTION_BASE(STEPPER_DRIVER_ID) |  5)
 #define STEPPER_ERR_INVALID_ACCELERATION     (DRIVER_EXCEPTION_BASE(STEPPER_DRIVER_ID) |  6)
+#define STEPPER_ERR_PATH_FULL                (DRIVER_EXCEPTION_BASE(STEPPER_DRIVER_ID) |  7)
+#define STEPPER_ERR_INVALID_SPEED            (DRIVER_EXCEPTION_BASE(STEPPER_DRIVER_ID) |  8)
+#define STEPPER_ERR_BUSY                     (DRIVER_EXCEPTION_BASE(STEPPER_DRIVER_ID) |  9)
 
 extern const int stepper_errors;
 extern const int stepper_error_map;
@@ -98,7 +113,9 @@ extern const int stepper_error_map;
 driver_error_t *stepper_setup(uint8_t step_pin, uint8_t dir_pin, float min_spd, float max_spd, float max_acc, float stpu, uint8_t *unit);
 driver_error_t *stepper_move(uint8_t unit, float units, float initial_spd, float target_spd, float acc, float jerk);
 
+driver_error_t *stepper_line(int mask, float *units, float speed, float acc);
 void stepper_start(int mask);
+driver_error_t *stepper_run();
 void stepper_stop(int mask);
 
 #endif /* _STEPPER_H_ */
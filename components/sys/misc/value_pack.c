@@ -0,0 +1,357 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, compact binary value encoding
+ *
+ */
+
+#include "value_pack.h"
+
+#include <string.h>
+
+/*
+ * Writer
+ */
+
+void vpack_writer_init(vpack_writer_t *w, uint8_t *buf, size_t size) {
+    w->buf = buf;
+    w->size = buf ? size : 0;
+    w->len = 0;
+}
+
+void vpack_put_byte(vpack_writer_t *w, uint8_t byte) {
+    if (w->len < w->size) {
+        w->buf[w->len] = byte;
+    }
+
+    w->len++;
+}
+
+void vpack_put_bytes(vpack_writer_t *w, const void *data, size_t len) {
+    if (w->buf && (w->len + len <= w->size)) {
+        memcpy(w->buf + w->len, data, len);
+    }
+
+    w->len += len;
+}
+
+void vpack_put_varint(vpack_writer_t *w, uint64_t value) {
+    uint8_t tmp[10];
+    int len = 0;
+
+    while (value >= 0x80) {
+        tmp[len++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+
+    tmp[len++] = (uint8_t)value;
+
+    vpack_put_bytes(w, tmp, len);
+}
+
+void vpack_put_zigzag(vpack_writer_t *w, int64_t value) {
+    vpack_put_varint(w, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+void vpack_put_float(vpack_writer_t *w, float value) {
+    uint8_t tmp[4];
+    uint32_t bits;
+
+    memcpy(&bits, &value, sizeof(bits));
+
+    tmp[0] = bits;
+    tmp[1] = bits >> 8;
+    tmp[2] = bits >> 16;
+    tmp[3] = bits >> 24;
+
+    vpack_put_bytes(w, tmp, sizeof(tmp));
+}
+
+void vpack_put_double(vpack_writer_t *w, double value) {
+    uint8_t tmp[8];
+    uint64_t bits;
+    int i;
+
+    memcpy(&bits, &value, sizeof(bits));
+
+    for(i = 0; i < 8; i++) {
+        tmp[i] = bits >> (i * 8);
+    }
+
+    vpack_put_bytes(w, tmp, sizeof(tmp));
+}
+
+void vpack_put_nil(vpack_writer_t *w) {
+    vpack_put_byte(w, VPACK_TAG(VPACK_NIL, 0));
+}
+
+void vpack_put_boolean(vpack_writer_t *w, int value) {
+    vpack_put_byte(w, VPACK_TAG(VPACK_BOOLEAN, value ? 1 : 0));
+}
+
+void vpack_put_integer(vpack_writer_t *w, int64_t value) {
+    if ((value >= -8) && (value <= 7)) {
+        vpack_put_byte(w, VPACK_TAG(VPACK_SMALLINT, (((uint64_t)value << 1) ^ (uint64_t)(value >> 63)) & 0x0f));
+    } else {
+        vpack_put_byte(w, VPACK_TAG(VPACK_INTEGER, 0));
+        vpack_put_zigzag(w, value);
+    }
+}
+
+void vpack_put_number(vpack_writer_t *w, double value) {
+    float f = (float)value;
+
+    if ((double)f == value) {
+        vpack_put_byte(w, VPACK_TAG(VPACK_FLOAT, 0));
+        vpack_put_float(w, f);
+    } else {
+        vpack_put_byte(w, VPACK_TAG(VPACK_DOUBLE, 0));
+        vpack_put_double(w, value);
+    }
+}
+
+// Tag with a length or count, inline if it fits in the low nibble
+static void put_header(vpack_writer_t *w, vpack_type_t type, size_t n) {
+    if (n < VPACK_TAG_LONG) {
+        vpack_put_byte(w, VPACK_TAG(type, n));
+    } else {
+        vpack_put_byte(w, VPACK_TAG(type, VPACK_TAG_LONG));
+        vpack_put_varint(w, n);
+    }
+}
+
+void vpack_put_string(vpack_writer_t *w, const void *data, size_t len) {
+    put_header(w, VPACK_STRING, len);
+    vpack_put_bytes(w, data, len);
+}
+
+void vpack_put_array(vpack_writer_t *w, size_t count) {
+    put_header(w, VPACK_ARRAY, count);
+}
+
+void vpack_put_map(vpack_writer_t *w, size_t count) {
+    put_header(w, VPACK_MAP, count);
+}
+
+/*
+ * Reader
+ */
+
+void vpack_reader_init(vpack_reader_t *r, const void *data, size_t len) {
+    r->p = (const uint8_t *)data;
+    r->end = r->p + len;
+}
+
+int vpack_get_byte(vpack_reader_t *r, uint8_t *byte) {
+    if (r->p >= r->end) {
+        return -1;
+    }
+
+    *byte = *r->p++;
+
+    return 0;
+}
+
+int vpack_get_bytes(vpack_reader_t *r, size_t len, const uint8_t **data) {
+    if (len > (size_t)(r->end - r->p)) {
+        return -1;
+    }
+
+    *data = r->p;
+    r->p += len;
+
+    return 0;
+}
+
+int vpack_get_varint(vpack_reader_t *r, uint64_t *value) {
+    uint64_t v = 0;
+    int shift = 0;
+    uint8_t byte;
+
+    do {
+        if ((shift > 63) || (r->p >= r->end)) {
+            return -1;
+        }
+
+        byte = *r->p++;
+        v |= (uint64_t)(byte & 0x7f) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+
+    *value = v;
+
+    return 0;
+}
+
+int vpack_get_zigzag(vpack_reader_t *r, int64_t *value) {
+    uint64_t v;
+
+    if (vpack_get_varint(r, &v) < 0) {
+        return -1;
+    }
+
+    *value = (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+
+    return 0;
+}
+
+int vpack_get_float(vpack_reader_t *r, float *value) {
+    const uint8_t *p;
+    uint32_t bits;
+
+    if (vpack_get_bytes(r, 4, &p) < 0) {
+        return -1;
+    }
+
+    bits = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+    memcpy(value, &bits, sizeof(bits));
+
+    return 0;
+}
+
+int vpack_get_double(vpack_reader_t *r, double *value) {
+    const uint8_t *p;
+    uint64_t bits = 0;
+    int i;
+
+    if (vpack_get_bytes(r, 8, &p) < 0) {
+        return -1;
+    }
+
+    for(i = 7; i >= 0; i--) {
+        bits = (bits << 8) | p[i];
+    }
+
+    memcpy(value, &bits, sizeof(bits));
+
+    return 0;
+}
+
+int vpack_get(vpack_reader_t *r, vpack_value_t *value) {
+    uint8_t tag;
+    uint64_t n;
+    float f;
+
+    if (vpack_get_byte(r, &tag) < 0) {
+        return -1;
+    }
+
+    value->type = tag >> 4;
+    n = tag & 0x0f;
+
+    switch (value->type) {
+        case VPACK_NIL:
+            return (n == 0) ? 0 : -1;
+
+        case VPACK_BOOLEAN:
+            value->boolean = n;
+            return (n <= 1) ? 0 : -1;
+
+        case VPACK_SMALLINT:
+            value->type = VPACK_INTEGER;
+            value->integer = (int64_t)(n >> 1) ^ -(int64_t)(n & 1);
+            return 0;
+
+        case VPACK_INTEGER:
+            return vpack_get_zigzag(r, &value->integer);
+
+        case VPACK_FLOAT:
+            if (vpack_get_float(r, &f) < 0) {
+                return -1;
+            }
+
+            value->type = VPACK_DOUBLE;
+            value->number = f;
+            return 0;
+
+        case VPACK_DOUBLE:
+            return vpack_get_double(r, &value->number);
+
+        case VPACK_STRING:
+        case VPACK_ARRAY:
+        case VPACK_MAP:
+            if ((n == VPACK_TAG_LONG) && (vpack_get_varint(r, &n) < 0)) {
+                return -1;
+            }
+
+            // Every value, or string byte, takes at least one byte, so a
+            // greater length can't be valid
+            if (n > (uint64_t)(r->end - r->p)) {
+                return -1;
+            }
+
+            value->len = n;
+
+            if (value->type == VPACK_STRING) {
+                return vpack_get_bytes(r, n, &value->string);
+            }
+
+            return 0;
+    }
+
+    return -1;
+}
+
+int vpack_skip(vpack_reader_t *r, int depth) {
+    vpack_value_t value;
+    size_t n;
+
+    if (vpack_get(r, &value) < 0) {
+        return -1;
+    }
+
+    if ((value.type != VPACK_ARRAY) && (value.type != VPACK_MAP)) {
+        return 0;
+    }
+
+    if (depth >= VPACK_MAX_DEPTH) {
+        return -1;
+    }
+
+    n = (value.type == VPACK_MAP)?value.len * 2:value.len;
+    while (n--) {
+        if (vpack_skip(r, depth + 1) < 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, compact binary value encoding
+ *
+ * Values are encoded with a tag byte, with the type in the high nibble, and
+ * a small value in the low nibble:
+ *
+ *   0x00             nil
+ *   0x10 / 0x11      false / true
+ *   0x2n             integer -8 .. 7, zigzag encoded in n
+ *   0x30 + varint    integer, zigzag encoded
+ *   0x40 + 4 bytes   float, little endian
+ *   0x50 + 8 bytes   double, little endian
+ *   0x6n + bytes     string of n bytes (n < 15), or 0x6f + varint length
+ *   0x7n + values    array of n values (n < 15), or 0x7f + varint count
+ *   0x8n + pairs     map of n key / value pairs (n < 15), or 0x8f + varint count
+ *
+ * Varints are LEB128 (7 bits per byte, low bits first). Numbers are encoded
+ * as a float when it has the same value.
+ *
+ * Without tags (when both sides know the types) the same primitives can be
+ * used directly: vpack_put_varint, vpack_put_float, vpack_put_bytes, ...
+ *
+ */
+
+#ifndef _VALUE_PACK_H
+#define _VALUE_PACK_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef enum {
+    VPACK_NIL = 0,
+    VPACK_BOOLEAN,
+    VPACK_SMALLINT,
+    VPACK_INTEGER,
+    VPACK_FLOAT,
+    VPACK_DOUBLE,
+    VPACK_STRING,
+    VPACK_ARRAY,
+    VPACK_MAP
+} vpack_type_t;
+
+#define VPACK_TAG(type, n) (((type) << 4) | (n))
+#define VPACK_TAG_LONG     0x0f
+
+// Deepest nesting of arrays and maps. A value at depth d (values at the top
+// level are at depth 0) can be an array or a map only if d < VPACK_MAX_DEPTH.
+#define VPACK_MAX_DEPTH 16
+
+/*
+ * Writer. With a NULL buffer nothing is written, but len is updated, so the
+ * same code can measure the encoding, and then write it into a buffer of
+ * the right size.
+ */
+typedef struct {
+    uint8_t *buf;
+    size_t size;
+    size_t len;     // Bytes of the encoding so far, can be > size
+} vpack_writer_t;
+
+// Decoded value
+typedef struct {
+    vpack_type_t type;  // VPACK_SMALLINT is returned as VPACK_INTEGER, VPACK_FLOAT as VPACK_DOUBLE
+    int boolean;
+    int64_t integer;
+    double number;
+    const uint8_t *string;  // Points into the decoded data
+    size_t len;             // String length, or number of array values / map pairs
+} vpack_value_t;
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+} vpack_reader_t;
+
+void vpack_writer_init(vpack_writer_t *w, uint8_t *buf, size_t size);
+
+// Returns 1 if the encoding didn't fit in the buffer
+static inline int vpack_overflow(const vpack_writer_t *w) {
+    return (w->len > w->size);
+}
+
+// Untagged primitives
+void vpack_put_byte(vpack_writer_t *w, uint8_t byte);
+void vpack_put_bytes(vpack_writer_t *w, const void *data, size_t len);
+void vpack_put_varint(vpack_writer_t *w, uint64_t value);
+void vpack_put_zigzag(vpack_writer_t *w, int64_t value);
+void vpack_put_float(vpack_writer_t *w, float value);
+void vpack_put_double(vpack_writer_t *w, double value);
+
+// Tagged values
+void vpack_put_nil(vpack_writer_t *w);
+void vpack_put_boolean(vpack_writer_t *w, int value);
+void vpack_put_integer(vpack_writer_t *w, int64_t value);
+void vpack_put_number(vpack_writer_t *w, double value);
+void vpack_put_string(vpack_writer_t *w, const void *data, size_t len);
+
+// An array header is followed by count values, and a map header by count
+// key / value pairs
+void vpack_put_array(vpack_writer_t *w, size_t count);
+void vpack_put_map(vpack_writer_t *w, size_t count);
+
+void vpack_reader_init(vpack_reader_t *r, const void *data, size_t len);
+
+// Untagged primitives. All of them return 0, or -1 if the data is truncated
+// or not valid.
+int vpack_get_byte(vpack_reader_t *r, uint8_t *byte);
+int vpack_get_bytes(vpack_reader_t *r, size_t len, const uint8_t **data);
+int vpack_get_varint(vpack_reader_t *r, uint64_t *value);
+int vpack_get_zigzag(vpack_reader_t *r, int64_t *value);
+int vpack_get_float(vpack_reader_t *r, float *value);
+int vpack_get_double(vpack_reader_t *r, double *value);
+
+/**
+ * @brief Decode the next tagged value. For arrays and maps only the header
+ *        is decoded, the values follow.
+ *
+ * @param r Reader.
+ * @param value Decoded value.
+ *
+ * @return 0, or -1 if the data is truncated or not valid. A count or length
+ *         greater than the data left is not valid.
+ */
+int vpack_get(vpack_reader_t *r, vpack_value_t *value);
+
+/**
+ * @brief Skip the next tagged value, and the values of an array or map.
+ *
+ * @param r Reader.
+ * @param depth Depth of the value.
+ *
+ * @return 0, or -1 if the data is truncated or not valid, or if arrays and
+ *         maps are nested deeper than VPACK_MAX_DEPTH.
+ */
+int vpack_skip(vpack_reader_t *r, int depth);
+
+#endif /* _VALUE_PACK_H */
@@ -68,6 +68,7 @@
 #include <sys/delay.h>
 
 #include <sensors/dhtxx.h>
+#include <sensors/dhtxx_frame.h>
 
 #include <drivers/gpio.h>
 #include <drivers/sensor.h>
@@ -139,6 +140,9 @@ driver_error_t *dhtxx_setup(sensor_instance_t *unit) {
                 // Use RMT implementation
                 unit->args = (void *)((uint32_t)rmt_device);
             }
+    #else
+            // Use RMT implementation
+            unit->args = (void *)((uint32_t)rmt_device);
     #endif
         } else {
             free(error);
@@ -201,45 +205,28 @@ retry:
 #if CONFIG_LUA_RTOS_LUA_USE_RMT
     if ((uint32_t)unit->args != 0xffffffff) {
         driver_error_t *error;
-        rmt_item_t *item;
+        size_t items = DHTXX_CAPTURE_ITEMS;
+        int res;
 
         // First send, request pulse
-        rmt_item_t buffer[41];
+        rmt_item_t buffer[DHTXX_CAPTURE_ITEMS];
 
         buffer[0].level0 = 0;
         buffer[0].duration0 = rdelay * 1000;
         buffer[0].level1 = 1;
         buffer[0].duration1 = 40;
 
-        error = rmt_tx_rx((int)unit->args, buffer, 1, buffer, 41, 100000);
-        if (!error) {
-            item = buffer;
-
-            // Skip first item, because it corresponds to the pulse sent by the
-            // sensor to indicate that it will start to send the data.
-            item++;
-
-            for(byte=0;byte < 5;byte++) {
-                data[byte] = 0;
-
-                for(bit = 7;bit >= 0;bit--) {
-                    if (item->level0 == 0) {
-                        t0 = item->duration0;
-                        t1 = item->duration1;
-                    } else {
-                        t0 = item->duration1;
-                        t1 = item->duration0;
-                    }
-
-                    if (t1 > t0) {
-                        data[byte] |= (1 << bit);
-                    }
-
-                    item++;
-                }
-            }
-        } else {
-            return error;
+        // The task is blocked while the response is captured, and then the
+        // captured pulses are decoded
+        error = rmt_tx_rx_capture((int)unit->args, buffer, 1, buffer, &items, 100000);
+        if (error) {
+            free(error);
+            goto timeout;
+        }
+
+        res = dhtxx_frame_decode((uint32_t *)buffer, items, data);
+        if (res == DHTXX_FRAME_TRUNCATED) {
+            goto timeout;
         }
     } else {
 #endif
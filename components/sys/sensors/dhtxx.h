@@ -54,6 +54,9 @@
 // Tolerance in usecs when decoding bits
 #define DHTXX_TOLERANCE 4
 
+// Items captured by the RMT: frame, plus some room for glitches
+#define DHTXX_CAPTURE_ITEMS 48
+
 #include <stdint.h>
 
 #include <sys/driver.h>
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, DHT sensors frame decoder
+ *
+ */
+
+#include <string.h>
+
+#include <sys/sensors/dhtxx_frame.h>
+
+/*
+ * Operation functions
+ */
+int dhtxx_frame_decode(const uint32_t *items, uint32_t len, uint8_t *data) {
+	uint16_t low[DHTXX_FRAME_BITS];  // Last low pulses
+	uint16_t high[DHTXX_FRAME_BITS]; // Last high pulses
+	uint32_t pairs = 0;              // Low / high pairs found
+	uint32_t pending = 0;            // Duration of a low pulse without it's high pulse
+	uint32_t half, duration, level;
+	uint32_t i, pos;
+	uint8_t crc;
+
+	// Get the low / high pairs, keeping the last DHTXX_FRAME_BITS in a
+	// circular buffer
+	for (half = 0; half < (len << 1); half++) {
+		if (half & 1) {
+			duration = (items[half >> 1] >> 16) & 0x7fff;
+			level = items[half >> 1] >> 31;
+		} else {
+			duration = items[half >> 1] & 0x7fff;
+			level = (items[half >> 1] >> 15) & 1;
+		}
+
+		if (duration == 0) {
+			break;
+		}
+
+		if (!level) {
+			pending = duration;
+		} else if (pending) {
+			if ((pending > DHTXX_FRAME_MAX_PULSE) || (duration > DHTXX_FRAME_MAX_PULSE)) {
+				// Not a bit, start again
+				pairs = 0;
+			} else {
+				pos = pairs % DHTXX_FRAME_BITS;
+				low[pos] = pending;
+				high[pos] = duration;
+				pairs++;
+			}
+
+			pending = 0;
+		}
+	}
+
+	if (pairs < DHTXX_FRAME_BITS) {
+		return DHTXX_FRAME_TRUNCATED;
+	}
+
+	memset(data, 0, DHTXX_FRAME_BITS / 8);
+
+	for (i = 0; i < DHTXX_FRAME_BITS; i++) {
+		pos = (pairs + i) % DHTXX_FRAME_BITS;
+		if (high[pos] > low[pos]) {
+			data[i >> 3] |= (0x80 >> (i & 7));
+		}
+	}
+
+	crc = data[0] + data[1] + data[2] + data[3];
+	if (crc != data[4]) {
+		return DHTXX_FRAME_CRC;
+	}
+
+	return DHTXX_FRAME_OK;
+}
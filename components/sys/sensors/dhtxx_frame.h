@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, DHT sensors frame decoder
+ *
+ * Decodes the response of a DHT sensor captured by a RMT RX channel. Items
+ * use the RMT item layout (duration0:15, level0:1, duration1:15, level1:1),
+ * with durations in microseconds, and a 0 duration marks the end of the
+ * capture.
+ *
+ * The sensor sends a response (low 80 us, high 80 us), and then 40 bits,
+ * MSB first. Each bit is a low pulse of 50 us, followed by a high pulse of
+ * 26-28 us for a 0, or of 70 us for a 1. After the last bit the sensor
+ * pulls the bus low for 50 us, and releases it.
+ *
+ */
+
+#ifndef _SENSORS_DHTXX_FRAME_H_
+#define _SENSORS_DHTXX_FRAME_H_
+
+#include <stdint.h>
+
+// Bits in a frame
+#define DHTXX_FRAME_BITS 40
+
+// Items needed to capture a frame: response, 40 bits, and end of frame
+#define DHTXX_FRAME_ITEMS (DHTXX_FRAME_BITS + 2)
+
+// Longest valid pulse in a bit, in usecs. Longer pulses are glitches, or
+// the host's request pulse.
+#define DHTXX_FRAME_MAX_PULSE 120
+
+// Decoder errors
+#define DHTXX_FRAME_OK         0
+#define DHTXX_FRAME_TRUNCATED -1 // Less than 40 bits captured
+#define DHTXX_FRAME_CRC       -2 // Checksum error
+
+/**
+ * @brief Decode a captured DHT frame.
+ *
+ * The bits are the last 40 low / high pulse pairs of the capture, so the
+ * decoder doesn't depend on whether the response pulse, or the end of the
+ * host's request pulse, are captured or not. A bit is a 1 if the high pulse
+ * is longer than the low pulse.
+ *
+ * @param items Captured items.
+ * @param len Number of captured items.
+ * @param data Decoded data (5 bytes, the last one is the checksum).
+ *
+ * @return DHTXX_FRAME_OK, DHTXX_FRAME_TRUNCATED, or DHTXX_FRAME_CRC.
+ */
+int dhtxx_frame_decode(const uint32_t *items, uint32_t len, uint8_t *data);
+
+#endif /* _SENSORS_DHTXX_FRAME_H_ */
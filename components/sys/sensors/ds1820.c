@@ -17,8 +17,25 @@
 #include "time.h"
 #include <drivers/owire.h>
 #include <sys/driver.h>
+#include <sys/mutex.h>
+
+// Time, in milliseconds, that the temperatures read in a bus sweep are
+// used by the sensor's acquire function. Each temperature is used once, so
+// reading all the sensors of a bus only needs one sweep.
+#define DS1820_SWEEP_MAX_AGE 2000
+
+// Last sweep of a bus
+typedef struct {
+	struct mtx mtx;
+	TickType_t time;                                    // Sweep time
+	owState_t status;                                   // Sweep status
+	uint8_t resolution[MAX_ONEWIRE_SENSORS];            // Resolution of each device, 0 if not set up
+	uint8_t consumed[MAX_ONEWIRE_SENSORS];              // Temperature already used?
+	ds1820_bus_result_t results[MAX_ONEWIRE_SENSORS];
+} ds1820_sweep_t;
 
 static int ds_parasite_pwr = 0;
+static ds1820_sweep_t sweeps[MAX_ONEWIRE_PINS];
 extern TM_One_Wire_Devices_t ow_devices[MAX_ONEWIRE_PINS];
 
 #ifdef DS18B20ALARMFUNC
@@ -54,13 +71,7 @@ const sensor_t __attribute__((used,unused,section(".sensors"))) ds1820_sensor =
 //-----------------------------------------------
 unsigned char TM_DS18B20_Is(unsigned char *ROM) {
   /* Checks if first byte is equal to DS18B20's family code */
-  if ((*ROM == DS18B20_FAMILY_CODE) ||
-	  (*ROM == DS18S20_FAMILY_CODE) ||
-	  (*ROM == DS1822_FAMILY_CODE)  ||
-	  (*ROM == DS28EA00_FAMILY_CODE)) {
-    return *ROM;
-  }
-  return 0;
+  return ds1820_bus_is(ROM);
 }
 
 //-----------------------------------------------------------------
@@ -96,157 +107,6 @@ static int getPowerMode(uint8_t dev) {
 	return ow_OK;
 }
 
-//------------------------------------------------------------------
-static owState_t TM_DS18B20_Start(uint8_t dev, unsigned char *ROM) {
-  // Check if device is DS18B20
-  if (!TM_DS18B20_Is(ROM)) {
-    return owError_Not18b20;
-  }
-  if (getPowerMode(dev)) return owError_NoDevice;
-
-  // Reset line
-  if (TM_OneWire_Reset(dev) != 0) return owError_NoDevice;
-
-  // Select ROM number
-  TM_OneWire_SelectWithPointer(dev, ROM);
-  // Start temperature conversion
-  TM_OneWire_WriteByte(dev, DS18B20_CMD_CONVERTTEMP);
-
-  if (ds_parasite_pwr) owdevice_pinpower(dev);
-
-  return ow_OK;
-}
-
-//-------------------------------------------------
-#if 0
-static owState_t TM_DS18B20_StartAll(uint8_t dev) {
-  if (getPowerMode(dev)) return owError_NoDevice;
-
-  // Reset pulse
-  if (TM_OneWire_Reset(dev) != 0) return owError_NoDevice;;
-  // Skip rom
-  TM_OneWire_WriteByte(dev, ONEWIRE_CMD_SKIPROM);
-  // Start conversion on all connected devices
-  TM_OneWire_WriteByte(dev, DS18B20_CMD_CONVERTTEMP);
-
-  if (ds_parasite_pwr) owdevice_pinpower(dev);
-
-  return ow_OK;
-}
-#endif
-
-//--------------------------------------------------------------------------------------
-static owState_t TM_DS18B20_Read(uint8_t dev, unsigned char *ROM, double *destination) {
-  unsigned int temperature;
-  unsigned char resolution;
-  char digit, minus = 0;
-  double decimal;
-  unsigned char i = 0;
-  unsigned char data[9];
-  unsigned char crc;
-
-  /* Check if device is DS18B20 */
-  if (!TM_DS18B20_Is(ROM)) {
-    return owError_Not18b20;
-  }
-  /* Check if line is released, if it is, then conversion is complete */
-  if (!TM_OneWire_ReadBit(dev)) {
-    /* Conversion is not finished yet */
-    return owError_NotFinished;
-  }
-  /* Reset line */
-  if (TM_OneWire_Reset(dev) != 0) {
-    return owError_NoDevice;
-  }
-  /* Select ROM number */
-  TM_OneWire_SelectWithPointer(dev, ROM);
-  /* Read scratchpad command by onewire protocol */
-  TM_OneWire_WriteByte(dev, ONEWIRE_CMD_RSCRATCHPAD);
-
-  /* Get data */
-  for (i = 0; i < 9; i++) {
-    /* Read byte by byte */
-    data[i] = TM_OneWire_ReadByte(dev);
-  }
-  /* Calculate CRC */
-  crc = TM_OneWire_CRC8(data, 8);
-  /* Check if CRC is ok */
-  if (crc != data[8]) {
-    /* CRC invalid */
-    return owError_BadCRC;
-  }
-
-  /* First two bytes of scratchpad are temperature values */
-  temperature = data[0] | (data[1] << 8);
-  /* Reset line */
-  TM_OneWire_Reset(dev);
-  if (*ROM != DS18S20_FAMILY_CODE) {
-	  /* Check if temperature is negative */
-	  if (temperature & 0x8000) {
-		/* Two's complement, temperature is negative */
-		temperature = ~temperature + 1;
-		minus = 1;
-	  }
-	  /* Get sensor resolution */
-	  resolution = ((data[4] & 0x60) >> 5) + 9;
-	  /* Store temperature integer digits and decimal digits */
-	  digit = temperature >> 4;
-	  digit |= ((temperature >> 8) & 0x7) << 4;
-
-	  /* Store decimal digits */
-	  switch (resolution) {
-		case 9: {
-		  decimal = (temperature >> 3) & 0x01;
-		  decimal *= (double)DS18B20_DECIMAL_STEPS_9BIT;
-		} break;
-		case 10: {
-		  decimal = (temperature >> 2) & 0x03;
-		  decimal *= (double)DS18B20_DECIMAL_STEPS_10BIT;
-		} break;
-		case 11: {
-		  decimal = (temperature >> 1) & 0x07;
-		  decimal *= (double)DS18B20_DECIMAL_STEPS_11BIT;
-		} break;
-		case 12: {
-		  decimal = temperature & 0x0F;
-		  decimal *= (double)DS18B20_DECIMAL_STEPS_12BIT;
-		} break;
-		default: {
-		  decimal = 0xFF;
-		  digit = 0;
-		}
-	  }
-
-	  /* Check for negative part */
-	  decimal = digit + decimal;
-	  if (minus) {
-		decimal = 0 - decimal;
-	  }
-	  /* Set to pointer */
-	  *destination = decimal;
-
-  }
-  else {
-	if (!data[7]) {
-	    return owError_Convert;
-	}
-	if (data[1] == 0) {
-		temperature = ((int)(data[0] >> 1))*1000;
-	}
-	else { // negative
-		temperature = 1000*(-1*(int)(0x100-data[0]) >> 1);
-	}
-	temperature -= 250;
-	decimal = 1000*((int)(data[7] - data[6]));
-	decimal /= (int)data[7];
-	temperature += decimal;
-    /* Set to pointer */
-	*destination = (double)temperature / 1000.0;
-  }
-  /* Return 1, temperature valid */
-  return ow_OK;
-}
-
 //------------------------------------------------------------------------------
 static unsigned char TM_DS18B20_GetResolution(uint8_t dev, unsigned char *ROM) {
   unsigned char conf;
@@ -621,6 +481,77 @@ static uint8_t _set_resolution(uint8_t ds_res, uint8_t dev, uint8_t ds_dev) {
 	return res;
 }
 
+/*
+ * Bus sweep functions
+ */
+//-------------------------------------
+static int sweep_reset(void *arg) {
+	return TM_OneWire_Reset((uint8_t)(uintptr_t)arg);
+}
+
+//---------------------------------------------------------------------
+static void sweep_write(void *arg, const uint8_t *buf, uint32_t len) {
+	TM_OneWire_WriteBytes((uint8_t)(uintptr_t)arg, buf, len);
+}
+
+//---------------------------------------------------------------
+static void sweep_read(void *arg, uint8_t *buf, uint32_t len) {
+	TM_OneWire_ReadBytes((uint8_t)(uintptr_t)arg, buf, len);
+}
+
+//----------------------------------------
+static int sweep_read_bit(void *arg) {
+	return TM_OneWire_ReadBit((uint8_t)(uintptr_t)arg);
+}
+
+//-------------------------------------------------
+static void sweep_power(void *arg, int on) {
+	if (on) owdevice_pinpower((uint8_t)(uintptr_t)arg);
+	else owdevice_input((uint8_t)(uintptr_t)arg);
+}
+
+//------------------------------------------------------
+static void sweep_delay(void *arg, uint32_t ms) {
+	vTaskDelay(ms / portTICK_RATE_MS);
+}
+
+static const ds1820_bus_ops_t sweep_ops = {
+	.reset = sweep_reset,
+	.write = sweep_write,
+	.read = sweep_read,
+	.read_bit = sweep_read_bit,
+	.power = sweep_power,
+	.delay = sweep_delay,
+};
+
+// Start a conversion on all the devices of a bus, and read all the
+// temperatures. Must be called with the sweep's mutex held.
+//------------------------------------
+static void ds1820_sweep(uint8_t dev) {
+	ds1820_sweep_t *sweep = &sweeps[dev];
+	uint8_t resolution = 0;
+	uint8_t i;
+
+	// Conversion time is the conversion time of the highest resolution
+	for (i = 0; i < MAX_ONEWIRE_SENSORS; i++) {
+		if (sweep->resolution[i] > resolution) {
+			resolution = sweep->resolution[i];
+		}
+	}
+
+	for (i = 0; i < MAX_ONEWIRE_SENSORS; i++) {
+		sweep->results[i].status = owError_NoDevice;
+		sweep->consumed[i] = 0;
+	}
+
+	sweep->status = ds1820_bus_sweep(&sweep_ops, (void *)(uintptr_t)dev, ow_devices[dev].roms,
+									 ow_devices[dev].numdev, resolution, sweep->results);
+	sweep->time = xTaskGetTickCount();
+	if (sweep->time == 0) {
+		sweep->time = 1;
+	}
+}
+
 /*
  * Operation functions
  */
@@ -645,9 +576,18 @@ driver_error_t *ds1820_setup(sensor_instance_t *unit) {
 		return driver_error(SENSOR_DRIVER, SENSOR_ERR_CANT_INIT, "not DS1820 device");
 	}
 
+	if (!mtx_inited(&sweeps[dev].mtx)) {
+		mtx_init(&sweeps[dev].mtx, NULL, NULL, 0);
+	}
+
 	// Set default resolution (10 bits)
 	unit->properties[0].integerd.value = _set_resolution(10, dev, ds_dev);
 
+	mtx_lock(&sweeps[dev].mtx);
+	sweeps[dev].resolution[ds_dev - 1] = unit->properties[0].integerd.value;
+	sweeps[dev].time = 0;
+	mtx_unlock(&sweeps[dev].mtx);
+
 	// Set exfunc values
 	//unit->data[1].exfuncd.value = EXFUNC_DS1820_GETROM;
 //	unit->data[2].exfuncd.value = EXFUNC_DS1820_GETTYPE;
@@ -669,7 +609,11 @@ driver_error_t *ds1820_set(sensor_instance_t *unit, const char *id, sensor_value
 		memcpy(&unit->properties[0], property, sizeof(sensor_value_t));
 
 		// Set sensor's resolution
+		mtx_lock(&sweeps[dev].mtx);
 		unit->properties[0].integerd.value = _set_resolution(property->integerd.value, dev, ds_dev);
+		sweeps[dev].resolution[ds_dev - 1] = unit->properties[0].integerd.value;
+		sweeps[dev].time = 0;
+		mtx_unlock(&sweeps[dev].mtx);
 	}
 
 	return NULL;
@@ -679,90 +623,48 @@ driver_error_t *ds1820_set(sensor_instance_t *unit, const char *id, sensor_value
 driver_error_t *ds1820_acquire(sensor_instance_t *unit, sensor_value_t *values) {
 	unsigned char sens = unit->setup[0].owire.owsensor - 1;
 	uint8_t dev = unit->setup[0].owire.owdevice;
+	ds1820_sweep_t *sweep = &sweeps[dev];
+	TickType_t now;
 	int retries = 0;
 
 	sens = owire_addess_to_dev(dev, sens);
 
-	owState_t stat;
-	double temper;
-	uint16_t measure_time = 900;
-
-	// set measure time, it depends on resolution
-	switch (unit->properties[0].integerd.value) {
-	case 9:
-		measure_time = 150;
-		break;
-	case 10:
-		measure_time = 250;
-		break;
-	case 11:
-		measure_time = 450;
-		break;
-	case 12:
-		measure_time = 850;
-		break;
-	}
-
-	/* Start temperature conversion on all devices on one bus
-	TM_DS18B20_StartAll(dev);
-	*/
-	// Start temperature conversion on device
+	mtx_lock(&sweep->mtx);
 
-retry:
-	if (TM_DS18B20_Start(dev, (unsigned char *)&ow_devices[dev].roms[sens]) != ow_OK) {
-        retries++;
-        if (retries < 3) {
-            vTaskDelay(1 / portTICK_RATE_MS);
-            goto retry;
-        }
+	// Use the last sweep if the temperature of this device was not used yet,
+	// start a new sweep if not
+	now = xTaskGetTickCount();
+	if ((sweep->time == 0) || sweep->consumed[sens] ||
+		((now - sweep->time) > (DS1820_SWEEP_MAX_AGE / portTICK_RATE_MS))) {
 
-		values[0].floatd.value = -9997.0;
-		return NULL;
-	}
+		for (retries = 0; retries < 3; retries++) {
+			if (retries > 0) {
+				vTaskDelay(1 / portTICK_RATE_MS);
+			}
 
-	// Wait until measurement finished
-	if (ds_parasite_pwr) {
-		vTaskDelay(measure_time / portTICK_RATE_MS);
-		// Set owire pin to input mode
-		owdevice_input(dev);
-	}
-	else {
-		for (int mtime = 0; mtime < measure_time; mtime += 10) {
-			vTaskDelay(10 / portTICK_RATE_MS);
-			if (TM_OneWire_ReadBit(dev)) break;
+			ds1820_sweep(dev);
+			if ((sweep->status == ow_OK) && (sweep->results[sens].status == ow_OK)) {
+				break;
+			}
 		}
 	}
-	vTaskDelay(10 / portTICK_RATE_MS);
-
-	if (!TM_OneWire_ReadBit(dev)) {
-        retries++;
-        if (retries < 3) {
-            vTaskDelay(1 / portTICK_RATE_MS);
-            goto retry;
-        }
-        /* Timeout */
-		values[0].floatd.value = -9998.0;
 
-		return NULL;
-	}
+	sweep->consumed[sens] = 1;
 
-	// Read temperature from selected device
-	// Read temperature from ROM address and store it to temper variable
-	stat = TM_DS18B20_Read(dev, ow_devices[dev].roms[sens], &temper);
-	if ( stat == ow_OK) {
-		values[0].floatd.value = temper;
-	}
-	else {
+	if (sweep->status == owError_NoDevice) {
+		values[0].floatd.value = -9997.0;
+	} else if (sweep->status == owError_NotFinished) {
+		/* Timeout */
+		values[0].floatd.value = -9998.0;
+	} else if (sweep->results[sens].status != ow_OK) {
 		// Reading error
-        retries++;
-        if (retries < 3) {
-            vTaskDelay(1 / portTICK_RATE_MS);
-            goto retry;
-        }
-
-        values[0].floatd.value = -9999.0;
+		values[0].floatd.value = -9999.0;
+	} else {
+		values[0].floatd.value = sweep->results[sens].temperature;
 	}
 
+	mtx_unlock(&sweep->mtx);
+
 	return NULL;
 }
 
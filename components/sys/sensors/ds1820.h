@@ -14,26 +14,15 @@
 #include "driver/gpio.h"
 #include "rom/ets_sys.h"
 #include <drivers/sensor.h>
+#include <sys/sensors/ds1820_bus.h>
 
 //#define DS18B20ALARMFUNC
 //#define DS18B20_USE_CRC
 
-/* TM_DS18B20_Macros
-*  Every onewire chip has different ROM code, but all the same chips has same family code
-*  in case of DS18B20 this is 0x28 and this is first byte of ROM address
-*/
-#define DS18B20_FAMILY_CODE			0x28
-#define DS18S20_FAMILY_CODE			0x10
-#define DS1822_FAMILY_CODE			0x22
-#define DS28EA00_FAMILY_CODE		0x42
 #define DS18B20_CMD_ALARMSEARCH		0xEC
 
 /* DS18B20 read temperature command */
 #define DS18B20_CMD_CONVERTTEMP		0x44 	/* Convert temperature */
-#define DS18B20_DECIMAL_STEPS_12BIT	0.0625
-#define DS18B20_DECIMAL_STEPS_11BIT	0.125
-#define DS18B20_DECIMAL_STEPS_10BIT	0.25
-#define DS18B20_DECIMAL_STEPS_9BIT	0.5
 
 /* Bits locations for resolution */
 #define DS18B20_RESOLUTION_R1		6
@@ -48,18 +37,6 @@
 
 /* TM_DS18B20_Typedefs */
 
-/* DS1820 errors */
-typedef enum {
-  ow_OK = 0,
-  owError_NoDevice,
-  owError_Not18b20,
-  owError_NotFinished,
-  owError_BadCRC,
-  owError_NotReady,
-  owError_Convert
-} owState_t;
-
-
 /* DS18B0 Resolutions available */
 typedef enum {
   TM_DS18B20_Resolution_9bits = 	 9, /*!< DS18B20 9 bits resolution */
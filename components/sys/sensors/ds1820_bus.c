@@ -0,0 +1,207 @@
+/**
+ * DS1820 Family bus sweep for Lua-RTOS-ESP32
+ */
+
+#include <string.h>
+
+#include <sys/drivers/owire_slots.h>
+#include <sys/sensors/ds1820_bus.h>
+
+/* OneWire / DS1820 commands */
+#define DS1820_CMD_MATCHROM			0x55
+#define DS1820_CMD_SKIPROM			0xCC
+#define DS1820_CMD_RPWRSUPPLY		0xB4
+#define DS1820_CMD_CONVERTTEMP		0x44
+#define DS1820_CMD_RSCRATCHPAD		0xBE
+
+/*
+ * Helper functions
+ */
+
+// Read the scratchpad of a device, and check it's CRC
+static owState_t read_scratchpad(const ds1820_bus_ops_t *ops, void *arg, const uint8_t *rom, uint8_t *data) {
+	uint8_t cmd[10];
+
+	// Match ROM + ROM code + Read Scratchpad, in one write
+	cmd[0] = DS1820_CMD_MATCHROM;
+	memcpy(&cmd[1], rom, 8);
+	cmd[9] = DS1820_CMD_RSCRATCHPAD;
+
+	if (ops->reset(arg) != 0) {
+		return owError_NoDevice;
+	}
+
+	ops->write(arg, cmd, sizeof(cmd));
+	ops->read(arg, data, 9);
+
+	if (owire_crc8(data, 8) != data[8]) {
+		return owError_BadCRC;
+	}
+
+	return ow_OK;
+}
+
+/*
+ * Operation functions
+ */
+uint8_t ds1820_bus_is(const uint8_t *rom) {
+	if ((*rom == DS18B20_FAMILY_CODE) ||
+		(*rom == DS18S20_FAMILY_CODE) ||
+		(*rom == DS1822_FAMILY_CODE)  ||
+		(*rom == DS28EA00_FAMILY_CODE)) {
+		return *rom;
+	}
+
+	return 0;
+}
+
+uint32_t ds1820_bus_conversion_time(uint8_t resolution) {
+	switch (resolution) {
+		case 9:  return 150;
+		case 10: return 250;
+		case 11: return 450;
+		case 12: return 850;
+	}
+
+	return 900;
+}
+
+owState_t ds1820_bus_decode(const uint8_t *rom, const uint8_t *data, double *temperature) {
+	unsigned int raw;
+	uint8_t resolution;
+	char digit, minus = 0;
+	double decimal;
+	int value;
+
+	if (*rom != DS18S20_FAMILY_CODE) {
+		// First two bytes of scratchpad are temperature values
+		raw = data[0] | (data[1] << 8);
+
+		// Check if temperature is negative
+		if (raw & 0x8000) {
+			// Two's complement, temperature is negative
+			raw = ~raw + 1;
+			minus = 1;
+		}
+
+		// Get sensor resolution
+		resolution = ((data[4] & 0x60) >> 5) + 9;
+
+		// Store temperature integer digits and decimal digits
+		digit = raw >> 4;
+		digit |= ((raw >> 8) & 0x7) << 4;
+
+		switch (resolution) {
+			case 9:
+				decimal = (raw >> 3) & 0x01;
+				decimal *= (double)DS18B20_DECIMAL_STEPS_9BIT;
+				break;
+			case 10:
+				decimal = (raw >> 2) & 0x03;
+				decimal *= (double)DS18B20_DECIMAL_STEPS_10BIT;
+				break;
+			case 11:
+				decimal = (raw >> 1) & 0x07;
+				decimal *= (double)DS18B20_DECIMAL_STEPS_11BIT;
+				break;
+			default:
+				decimal = raw & 0x0F;
+				decimal *= (double)DS18B20_DECIMAL_STEPS_12BIT;
+				break;
+		}
+
+		decimal = digit + decimal;
+		if (minus) {
+			decimal = 0 - decimal;
+		}
+
+		*temperature = decimal;
+	} else {
+		// DS18S20: 0.5 degrees from the temperature register, extended
+		// using COUNT_REMAIN (data[6]) and COUNT_PER_C (data[7])
+		if (!data[7]) {
+			return owError_Convert;
+		}
+
+		if (data[1] == 0) {
+			value = ((int)(data[0] >> 1)) * 1000;
+		} else {
+			value = 1000 * (-1 * (int)(0x100 - data[0]) >> 1);
+		}
+
+		value -= 250;
+		value += (1000 * ((int)(data[7] - data[6]))) / (int)data[7];
+
+		*temperature = (double)value / 1000.0;
+	}
+
+	return ow_OK;
+}
+
+owState_t ds1820_bus_sweep(const ds1820_bus_ops_t *ops, void *arg, uint8_t (*roms)[8], uint8_t count,
+						   uint8_t resolution, ds1820_bus_result_t *results) {
+	uint8_t cmd[2];
+	uint8_t data[9];
+	uint32_t measure_time = ds1820_bus_conversion_time(resolution);
+	uint32_t mtime;
+	int parasite;
+	int retry;
+	uint8_t i;
+
+	// Test parasite power, if any device is parasite powered it pulls the
+	// bus low in the read slot
+	if (ops->reset(arg) != 0) {
+		return owError_NoDevice;
+	}
+
+	cmd[0] = DS1820_CMD_SKIPROM;
+	cmd[1] = DS1820_CMD_RPWRSUPPLY;
+	ops->write(arg, cmd, 2);
+	parasite = (ops->read_bit(arg) == 0);
+
+	// Start conversion on all devices
+	if (ops->reset(arg) != 0) {
+		return owError_NoDevice;
+	}
+
+	cmd[1] = DS1820_CMD_CONVERTTEMP;
+	ops->write(arg, cmd, 2);
+
+	// Wait until conversion is finished. Parasite powered devices can't
+	// signal the end of the conversion, and need the strong pull-up.
+	if (parasite) {
+		ops->power(arg, 1);
+		ops->delay(arg, measure_time);
+		ops->power(arg, 0);
+	} else {
+		for (mtime = 0; mtime < measure_time; mtime += DS1820_BUS_POLL_MS) {
+			ops->delay(arg, DS1820_BUS_POLL_MS);
+			if (ops->read_bit(arg)) break;
+		}
+	}
+
+	if (!ops->read_bit(arg)) {
+		return owError_NotFinished;
+	}
+
+	// Read all the scratchpads
+	for (i = 0; i < count; i++) {
+		if (!ds1820_bus_is(roms[i])) {
+			results[i].status = owError_Not18b20;
+			continue;
+		}
+
+		for (retry = 0; retry < DS1820_BUS_READ_RETRIES; retry++) {
+			results[i].status = read_scratchpad(ops, arg, roms[i], data);
+			if (results[i].status != owError_BadCRC) break;
+		}
+
+		if (results[i].status == ow_OK) {
+			results[i].status = ds1820_bus_decode(roms[i], data, &results[i].temperature);
+		}
+	}
+
+	ops->reset(arg);
+
+	return ow_OK;
+}
@@ -0,0 +1,117 @@
+/**
+ * DS1820 Family bus sweep for Lua-RTOS-ESP32
+ *
+ * A sweep starts the temperature conversion on all the devices of a bus at
+ * once (Skip ROM + Convert T), waits for the slowest conversion only once,
+ * and then reads the scratchpad of every device in one pass, checking the
+ * CRC of each one. A bus with N devices takes about one conversion time per
+ * sweep, instead of N conversion times.
+ *
+ * The sweep doesn't access the bus directly, it uses a set of bus operations,
+ * so it can be used with the ONE WIRE driver, or with a simulated bus.
+ */
+
+#ifndef _DS1820_BUS_H_
+#define _DS1820_BUS_H_
+
+#include <stdint.h>
+
+/* TM_DS18B20_Macros
+*  Every onewire chip has different ROM code, but all the same chips has same family code
+*  in case of DS18B20 this is 0x28 and this is first byte of ROM address
+*/
+#define DS18B20_FAMILY_CODE			0x28
+#define DS18S20_FAMILY_CODE			0x10
+#define DS1822_FAMILY_CODE			0x22
+#define DS28EA00_FAMILY_CODE		0x42
+
+#define DS18B20_DECIMAL_STEPS_12BIT	0.0625
+#define DS18B20_DECIMAL_STEPS_11BIT	0.125
+#define DS18B20_DECIMAL_STEPS_10BIT	0.25
+#define DS18B20_DECIMAL_STEPS_9BIT	0.5
+
+// Scratchpad reads for each device, if the CRC is not valid
+#define DS1820_BUS_READ_RETRIES		2
+
+// Poll interval while waiting for the conversion, in milliseconds
+#define DS1820_BUS_POLL_MS			10
+
+/* DS1820 errors */
+typedef enum {
+  ow_OK = 0,
+  owError_NoDevice,
+  owError_Not18b20,
+  owError_NotFinished,
+  owError_BadCRC,
+  owError_NotReady,
+  owError_Convert
+} owState_t;
+
+// Bus operations
+typedef struct {
+	int  (*reset)(void *arg);                                    // 0 if a presence pulse was detected
+	void (*write)(void *arg, const uint8_t *buf, uint32_t len);  // Write bytes
+	void (*read)(void *arg, uint8_t *buf, uint32_t len);         // Read bytes
+	int  (*read_bit)(void *arg);                                 // Read a bit
+	void (*power)(void *arg, int on);                            // Strong pull-up on / off (parasite power)
+	void (*delay)(void *arg, uint32_t ms);                       // Wait ms milliseconds
+} ds1820_bus_ops_t;
+
+// Result of a device in a sweep
+typedef struct {
+	double temperature;
+	owState_t status;
+} ds1820_bus_result_t;
+
+/**
+ * @brief Check if a ROM code belongs to a device of the DS1820 family.
+ *
+ * @param rom ROM code.
+ *
+ * @return The family code, or 0 if it is not a DS1820 device.
+ */
+uint8_t ds1820_bus_is(const uint8_t *rom);
+
+/**
+ * @brief Get the conversion time for a resolution.
+ *
+ * @param resolution Resolution, in bits (9 to 12).
+ *
+ * @return Conversion time, in milliseconds.
+ */
+uint32_t ds1820_bus_conversion_time(uint8_t resolution);
+
+/**
+ * @brief Decode the temperature stored in a scratchpad. The CRC of the
+ *        scratchpad must be checked before.
+ *
+ * @param rom ROM code of the device.
+ * @param data Scratchpad (9 bytes).
+ * @param temperature Decoded temperature, in celsius degrees.
+ *
+ * @return ow_OK, or owError_Convert if the scratchpad has not a valid value.
+ */
+owState_t ds1820_bus_decode(const uint8_t *rom, const uint8_t *data, double *temperature);
+
+/**
+ * @brief Start the temperature conversion on all the devices of the bus,
+ *        wait for the conversion, and read the temperature of the devices.
+ *
+ * @param ops Bus operations.
+ * @param arg Argument passed to the bus operations.
+ * @param roms ROM codes of the devices to read. Devices that are not of the
+ *             DS1820 family are skipped, with a owError_Not18b20 status.
+ * @param count Number of devices.
+ * @param resolution Highest resolution in the bus, used for the conversion
+ *                   time.
+ * @param results Result for each device.
+ *
+ * @return
+ *     - ow_OK: conversion done, the status of each device is in results
+ *     - owError_NoDevice: there are no devices in the bus
+ *     - owError_NotFinished: conversion not finished in time
+ */
+owState_t ds1820_bus_sweep(const ds1820_bus_ops_t *ops, void *arg, uint8_t (*roms)[8], uint8_t count,
+						   uint8_t resolution, ds1820_bus_result_t *results);
+
+#endif /* _DS1820_BUS_H_ */
@@ -419,7 +419,7 @@ void driver_unlock(const driver_t *owner_driver, int owner_unit, const driver_t
 
 void _driver_init() {
     // Create driver mutex
-    mtx_init(&driver_mtx, NULL, NULL, 0);
+    mtx_init(&driver_mtx, "driver", NULL, 0);
 
     // Init drivers
     const driver_t *cdriver = drivers;
@@ -43,157 +43,111 @@
  *
  */
 
+#include "sdkconfig.h"
 #include "history.h"
 
-#include <errno.h>
 #include <string.h>
 #include <stdio.h>
+#include <limits.h>
 
-#include <sys/tail.h>
+#include <sys/stat.h>
+#include <sys/seglog.h>
 #include <sys/mount.h>
 #include <sys/status.h>
 #include <sys/path.h>
 
-static void history_add_internal(const char *buf) {
-    // Get the history file name
+static seglog_t history;
+
+// Open the history log, or open it again if the file system of the
+// history has changed
+static seglog_t *history_open() {
     char fname[PATH_MAX + 1];
+    char segment[PATH_MAX + 12];
+    struct stat st;
+
+    // Get the history file name
     if (!mount_history_file(fname, sizeof(fname))) {
-        return;
+        return NULL;
     }
 
-    int retries = 0;
-
-again: {
-        // Open the history file
-        FILE *fp = fopen(fname,"a");
-        if (!fp) {
-            // File not found, try to create it, and open again
-            mkfile(fname);
-            fp = fopen(fname,"a");
-            if (!fp) {
-                return;
-            }
+    if (history.base) {
+        if (strcmp(history.base, fname) == 0) {
+            return &history;
         }
 
-        // Get file size
-        long size;
-
-        if ((size = ftell(fp)) < 0) {
-            fclose(fp);
-            return;
-        }
-
-        // Write to history file
-        int len = strlen(buf);
+        seglog_close(&history);
+    }
 
-        int no_space = 0;
+    // The history was kept in one file before, use it as the oldest segment
+    snprintf(segment, sizeof(segment), SEGLOG_SEGMENT_NAME, fname, 0);
+    if ((stat(fname, &st) == 0) && S_ISREG(st.st_mode) && (stat(segment, &st) < 0)) {
+        rename(fname, segment);
+    }
 
-        if (fwrite(buf, 1, len, fp) != len) {
-            no_space = (errno == ENOSPC);
-        }
+    if (seglog_open(&history, fname, CONFIG_LUA_RTOS_HISTORY_SEGMENT_SIZE, CONFIG_LUA_RTOS_HISTORY_SEGMENTS) < 0) {
+        return NULL;
+    }
 
-        if (!no_space) {
-            if (fflush(fp) == EOF) {
-                no_space = (errno == ENOSPC);
-            }
-        }
+    return &history;
+}
 
-        if (no_space) {
-            // Truncate file to the original size
-            if (ftruncate(fileno(fp), size) < 0) {
-                fclose(fp);
-                return;
-            }
-
-            if (retries == 0) {
-                // Tail file
-                fclose(fp);
-                file_tails(fname, fp->_blksize);
-
-                retries++;
-                goto again;
-            }
-        }
+void history_add(const char *line) {
+    seglog_t *log = history_open();
+    int len = strlen(line);
 
-        fclose(fp);
+    if (!log || !len) {
+        return;
     }
-}
 
-void history_add(const char *line) {
-    history_add_internal("\n");
-    history_add_internal(line);
+    seglog_append(log, line, len);
 }
 
 int history_get(int index, int up, char *buf, int buflen) {
-    // Get the history file name
-    char fname[PATH_MAX + 1];
-    if (!mount_history_file(fname, sizeof(fname))) {
+    seglog_t *log = history_open();
+    int len;
+
+    if (!log) {
         return -2;
     }
 
-    // Open history file
-    FILE *fp = fopen(fname,"r");
-    if (!fp) {
-        // File not found, try to create it, and open again
-        mkfile(fname);
-        fp = fopen(fname,"r");
-        if (!fp) {
-            return -2;
+    // index is the line being shown, counting from the newest one, or
+    // -1 if none
+    if (up) {
+        if (index + 1 >= seglog_count(log)) {
+            return -3;
         }
-    }
 
-    int pos, len, new_pos;
-    char c;
-
-    if (index == -1) {
-        fseek(fp, 0, SEEK_END);
-        pos = ftell(fp);
+        index++;
     } else {
-        pos = index;
-    }
-
-    if ((pos == 0) && (up)) {
-        fclose(fp);
-        return -3;
-    }
-
-    new_pos = pos;
-
-    while ((pos >= 0) && !feof(fp)) {
-        if (up)
-            fseek(fp, --pos, SEEK_SET);
-        else
-            fseek(fp, ++pos, SEEK_SET);
+        if (index < 0) {
+            buf[0] = 0;
+            return -1;
+        }
 
-        c = fgetc(fp);
-        if (c == '\n') {
-            break;
+        index--;
+        if (index < 0) {
+            buf[0] = 0;
+            return -1;
         }
     }
 
-    new_pos = pos;
+    if ((len = seglog_get(log, index, buf, buflen)) < 0) {
+        buf[0] = 0;
+        return -2;
+    }
 
-    if  ((pos >= 0) && !feof(fp)) {
-        // Get line
-        fgets(buf, buflen, fp);
-        len = strlen(buf);
+    // Strip \r chars at the end, if present
+    while ((len > 0) && (buf[len - 1] == '\r')) {
+        buf[--len] = '\0';
+    }
 
-        // Strip \r \n chars at the end, if present
-        while ((buf[len - 1] == '\r') || (buf[len - 1] == '\n')) {
-            len--;
-        }
+    return index;
+}
 
-        buf[len] = '\0';
-    } else {
-        if (feof(fp))
-            new_pos = -1;
-        else
-            new_pos = 0;
+void history_clear() {
+    seglog_t *log = history_open();
 
-        buf[0] = 0;
+    if (log) {
+        seglog_clear(log);
     }
-
-    fclose(fp);
-
-    return new_pos;
 }
@@ -46,12 +46,33 @@
 #define _HISTORY_H_
 
 /**
- * @brief Add a line to the history file. If the is not left space on the device
- *        the history file is tailed from the beginning.
+ * @brief Add a line to the history. The history is a segmented log (see
+ *        sys/seglog.h), when it is full, or if there is not left space on the
+ *        device, the oldest segment is removed.
  *
- * @param buf The line to add.
+ * @param line The line to add.
  */
 void history_add(const char *line);
+
+/**
+ * @brief Get the previous or the next line of the history.
+ *
+ * @param index The line being shown, counting from the newest one, or -1 if none.
+ * @param up 1 to get the previous (older) line, 0 to get the next one.
+ * @param buf Buffer for the line.
+ * @param buflen Size of buf.
+ *
+ * @return
+ *    - The index of the line copied to buf
+ *    - -1: there is no next line, buf is empty
+ *    - -2: the history is not available
+ *    - -3: there is no previous line, buf is not changed
+ */
 int history_get(int index, int up, char *buf, int buflen);
 
+/**
+ * @brief Remove all the lines of the history.
+ */
+void history_clear();
+
 #endif /* _HISTORY_H_ */
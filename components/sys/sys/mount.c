@@ -63,28 +63,28 @@
 struct mtx mtx;
 
 void _mount_init() {
-	mtx_init(&mtx, NULL, NULL, MTX_RECURSE);
+	mtx_init(&mtx, "mount", NULL, MTX_RECURSE);
 }
 
 // Current mount points
 struct mount_pt mountps[] = {
 #if (CONFIG_SD_CARD_MMC || CONFIG_SD_CARD_SPI) && CONFIG_LUA_RTOS_USE_FAT
-    {NULL, "fat", &vfs_fat_mount, &vfs_fat_umount, &vfs_fat_format, &vfs_fat_fsstat, 0},
+    {NULL, "fat", &vfs_fat_mount, &vfs_fat_umount, &vfs_fat_format, &vfs_fat_fsstat, NULL, 0},
 #endif
 #if CONFIG_LUA_RTOS_USE_LFS
-    {NULL, "lfs", &vfs_lfs_mount, &vfs_lfs_umount, &vfs_lfs_format, &vfs_lfs_fsstat, 0},
+    {NULL, "lfs", &vfs_lfs_mount, &vfs_lfs_umount, &vfs_lfs_format, &vfs_lfs_fsstat, NULL, 0},
 #endif
 #if CONFIG_LUA_RTOS_USE_RAM_FS
-    {NULL, "ramfs", &vfs_ramfs_mount, &vfs_ramfs_umount, &vfs_ramfs_format, &vfs_ramfs_fsstat, 0},
+    {NULL, "ramfs", &vfs_ramfs_mount, &vfs_ramfs_umount, &vfs_ramfs_format, &vfs_ramfs_fsstat, &vfs_ramfs_copy, 0},
 #endif
 #if CONFIG_LUA_RTOS_USE_ROM_FS
-    {NULL, "romfs", &vfs_romfs_mount, &vfs_romfs_umount, NULL, &vfs_romfs_fsstat, 0},
+    {NULL, "romfs", &vfs_romfs_mount, &vfs_romfs_umount, NULL, &vfs_romfs_fsstat, NULL, 0},
 #endif
 #if CONFIG_LUA_RTOS_USE_SPIFFS
-   {NULL, "spiffs", &vfs_spiffs_mount, &vfs_spiffs_umount, &vfs_spiffs_format, &vfs_spiffs_fsstat, 0},
+   {NULL, "spiffs", &vfs_spiffs_mount, &vfs_spiffs_umount, &vfs_spiffs_format, &vfs_spiffs_fsstat, NULL, 0},
 #endif
-    {"/dev", "dev", NULL, NULL, NULL, NULL, 0},
-    {NULL, NULL, NULL, NULL, NULL, NULL, 0}
+    {"/dev", "dev", NULL, NULL, NULL, NULL, NULL, 0},
+    {NULL, NULL, NULL, NULL, NULL, NULL, NULL, 0}
 };
 
 static char *dot_dot(char *rpath, char *cpath) {
@@ -591,6 +591,124 @@ struct mount_pt *mount_get_mount_point_for_path(const char *path) {
 }
 
 
+// Get the mount point of a physical path, and the path inside the file system
+static struct mount_pt *mount_get_mount_point_for_physical(const char *ppath, const char **fspath) {
+    struct mount_pt *cmount = &mountps[0];
+    size_t len;
+
+    while (cmount->fs) {
+        len = strlen(cmount->fs);
+
+        if ((*ppath == '/') && (strncmp(ppath + 1, cmount->fs, len) == 0) &&
+            ((ppath[len + 1] == '/') || (ppath[len + 1] == '\0'))) {
+            *fspath = ppath + len + 1;
+            return cmount;
+        }
+
+        cmount++;
+    }
+
+    return NULL;
+}
+
+// File copy function for vfs_copy. If src and dst are in the same file system,
+// and it has a copy function, copy the file with it.
+static int mount_copy_file(void *arg, const char *src, const char *dst) {
+    struct mount_pt *src_mount;
+    struct mount_pt *dst_mount;
+    const char *src_fspath;
+    const char *dst_fspath;
+    char *src_ppath;
+    char *dst_ppath;
+    mount_copy_f_t copy = NULL;
+    int ret = -1;
+
+    src_ppath = mount_resolve_to_physical(src);
+    if (!src_ppath) {
+        return -1;
+    }
+
+    dst_ppath = mount_resolve_to_physical(dst);
+    if (!dst_ppath) {
+        free(src_ppath);
+        return -1;
+    }
+
+    mtx_lock(&mtx);
+
+    src_mount = mount_get_mount_point_for_physical(src_ppath, &src_fspath);
+    dst_mount = mount_get_mount_point_for_physical(dst_ppath, &dst_fspath);
+
+    if (src_mount && (src_mount == dst_mount) && src_mount->mounted) {
+        copy = src_mount->copy;
+    }
+
+    mtx_unlock(&mtx);
+
+    // Copy without the lock, as the other file operations, so a long copy
+    // doesn't block the mount points
+    if (copy) {
+        ret = copy(src_fspath, dst_fspath);
+    } else {
+        errno = ENOTSUP;
+    }
+
+    free(src_ppath);
+    free(dst_ppath);
+
+    return ret;
+}
+
+int mount_copy(const char *src, const char *dst, vfs_copy_t *copy) {
+    char *nsrc;
+    char *ndst;
+    size_t len;
+    int ret;
+
+    if (!src || !dst) {
+        errno = EFAULT;
+        return -1;
+    }
+
+    nsrc = mount_normalize_path(src);
+    if (!nsrc) {
+        return -1;
+    }
+
+    ndst = mount_normalize_path(dst);
+    if (!ndst) {
+        free(nsrc);
+        return -1;
+    }
+
+    // If src and dst are the same file, there is nothing to copy
+    if (strcmp(nsrc, ndst) == 0) {
+        free(nsrc);
+        free(ndst);
+
+        return 0;
+    }
+
+    // A directory can't be copied inside itself
+    len = strlen(nsrc);
+    if ((strncmp(nsrc, ndst, len) == 0) && ((ndst[len] == '/') || (len == 1))) {
+        free(nsrc);
+        free(ndst);
+
+        errno = EINVAL;
+        return -1;
+    }
+
+    copy->file = mount_copy_file;
+
+    ret = vfs_copy(copy, nsrc, ndst);
+
+    free(nsrc);
+    free(ndst);
+
+    return ret;
+}
+
 struct mount_pt *mount_get_mount_point_for_fs(const char *fs) {
 	mtx_lock(&mtx);
 
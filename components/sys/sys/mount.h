@@ -50,10 +50,13 @@
 #include <stdint.h>
 #include <stddef.h>
 
+#include <sys/vfs/copy.h>
+
 typedef int (*mount_mount_f_t)(const char *);
 typedef int (*mount_umount_f_t)(const char *);
 typedef int (*mount_format_f_t)(const char *);
 typedef int (*mount_fsstat_f_t)(const char *, uint32_t *total, uint32_t *used);
+typedef int (*mount_copy_f_t)(const char *src, const char *dst);
 
 // Mount point structure
 struct mount_pt {
@@ -63,6 +66,7 @@ struct mount_pt {
     mount_umount_f_t umount;  // unmount function
     mount_format_f_t format;  // format function
     mount_fsstat_f_t fsstat;  // fs stat function
+    mount_copy_f_t copy;      // file copy function, inside the file system
     uint8_t mounted;          // Is the file system mounted?
 };
 
@@ -203,6 +207,23 @@ struct mount_pt *mount_get_mount_point_for_path(const char *path);
  */
 struct mount_pt *mount_get_mount_point_for_fs(const char *fs);
 
+/*
+ * @brief Copy a file, or a directory if the copy is recursive, between logical
+ *        paths. When a file is copied inside the same file system, the copy
+ *        function of the file system is used, if it has one.
+ *
+ * @param src The source path.
+ * @param dst The destination path.
+ * @param copy The copy context (see vfs_copy_init). The file function of the
+ *             context is set by this function.
+ *
+ * @return
+ *    Returns the value 0 if successful; otherwise the value -1 is returned and errno
+ *    is set to indicate the error. If src and dst are the same file nothing is
+ *    copied, and if dst is inside the src directory errno is set to EINVAL.
+ */
+int mount_copy(const char *src, const char *dst, vfs_copy_t *copy);
+
 int mount(const char *target, const char *fs);
 int umount(const char *target);
 
@@ -46,12 +46,164 @@
 #include "sdkconfig.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/adds.h"
+#include "freertos/task.h"
 
 #include "esp_attr.h"
+#include "esp_timer.h"
+
+#include <stddef.h>
+#include <string.h>
 
 #include <sys/mutex.h>
 #include <sys/panic.h>
 
+/*
+ * MTX_DEF mutexes are FreeRTOS mutexes, and MTX_RECURSE mutexes FreeRTOS
+ * recursive mutexes, both with priority inheritance: while a task holds
+ * a mutex that a higher priority task is waiting for, it runs at the
+ * priority of the waiting task.
+ *
+ * With CONFIG_LUA_RTOS_MUTEX_STATS, the acquisitions are accounted (see
+ * sys/mutex_stats.h), and the mutexes with a name are kept in a list, to
+ * get their statistics.
+ */
+
+#if CONFIG_LUA_RTOS_MUTEX_STATS
+
+#ifndef CONFIG_LUA_RTOS_MUTEX_SPIN
+#define CONFIG_LUA_RTOS_MUTEX_SPIN 0
+#endif
+
+static portMUX_TYPE named_mux = portMUX_INITIALIZER_UNLOCKED;
+static mtx_stats_t *named = NULL;
+
+static int IRAM_ATTR mtx_def_trylock(void *lock) {
+    return (xSemaphoreTake((SemaphoreHandle_t)lock, 0) == pdTRUE);
+}
+
+static void IRAM_ATTR mtx_def_lock(void *lock) {
+    xSemaphoreTake((SemaphoreHandle_t)lock, portMAX_DELAY);
+}
+
+static int IRAM_ATTR mtx_recurse_trylock(void *lock) {
+    return (xSemaphoreTakeRecursive((SemaphoreHandle_t)lock, 0) == pdTRUE);
+}
+
+static void IRAM_ATTR mtx_recurse_lock(void *lock) {
+    xSemaphoreTakeRecursive((SemaphoreHandle_t)lock, portMAX_DELAY);
+}
+
+static void * IRAM_ATTR mtx_self() {
+    return (void *)xTaskGetCurrentTaskHandle();
+}
+
+static int IRAM_ATTR mtx_running(void *task) {
+#if CONFIG_FREERTOS_UNICORE
+    return 0;
+#else
+    return (xTaskGetCurrentTaskHandleForCPU(!xPortGetCoreID()) == (TaskHandle_t)task);
+#endif
+}
+
+static uint32_t IRAM_ATTR mtx_now() {
+    return (uint32_t)esp_timer_get_time();
+}
+
+static const DRAM_ATTR mtx_stats_ops_t def_ops = {
+    mtx_def_trylock, mtx_def_lock, mtx_self, mtx_running, mtx_now, CONFIG_LUA_RTOS_MUTEX_SPIN, 0
+};
+
+static const DRAM_ATTR mtx_stats_ops_t recurse_ops = {
+    mtx_recurse_trylock, mtx_recurse_lock, mtx_self, mtx_running, mtx_now, CONFIG_LUA_RTOS_MUTEX_SPIN, 1
+};
+
+#define MTX_OPS(mutex) (((mutex)->opts == MTX_RECURSE)?&recurse_ops:&def_ops)
+
+#define MTX_FROM_STATS(cstats) ((struct mtx *)((char *)(cstats) - offsetof(struct mtx, stats)))
+
+// Keep the name of the new owner, as the owner task can be deleted while
+// it holds the mutex, called by the owner
+static void IRAM_ATTR mtx_set_owner(struct mtx *mutex) {
+    if (mutex->stats.depth == 1) {
+        strncpy(mutex->owner, pcTaskGetTaskName(NULL), sizeof(mutex->owner) - 1);
+        mutex->owner[sizeof(mutex->owner) - 1] = '\0';
+    }
+}
+
+static void mtx_add_named(struct mtx *mutex) {
+    mtx_stats_t *cstats;
+
+    portENTER_CRITICAL(&named_mux);
+
+    // A mutex can be initialized again
+    for (cstats = named; cstats; cstats = cstats->next) {
+        if (cstats == &mutex->stats) {
+            break;
+        }
+    }
+
+    if (!cstats) {
+        mutex->stats.next = named;
+        named = &mutex->stats;
+    }
+
+    portEXIT_CRITICAL(&named_mux);
+}
+
+static void mtx_remove_named(struct mtx *mutex) {
+    mtx_stats_t **cstats;
+
+    portENTER_CRITICAL(&named_mux);
+
+    for (cstats = &named; *cstats; cstats = &(*cstats)->next) {
+        if (*cstats == &mutex->stats) {
+            *cstats = mutex->stats.next;
+            break;
+        }
+    }
+
+    portEXIT_CRITICAL(&named_mux);
+}
+
+int mtx_get_stats(mtx_info_t *info, int max) {
+    mtx_stats_t *cstats;
+    int count = 0;
+
+    portENTER_CRITICAL(&named_mux);
+
+    for (cstats = named; cstats; cstats = cstats->next) {
+        if (info && (count < max)) {
+            memcpy(&info[count].stats, cstats, sizeof(mtx_stats_t));
+            info[count].stats.next = NULL;
+            info[count].owner[0] = '\0';
+
+            if (cstats->owner) {
+                memcpy(info[count].owner, MTX_FROM_STATS(cstats)->owner, sizeof(info[count].owner));
+                info[count].owner[sizeof(info[count].owner) - 1] = '\0';
+            }
+        }
+
+        count++;
+    }
+
+    portEXIT_CRITICAL(&named_mux);
+
+    return count;
+}
+
+void mtx_reset_stats() {
+    mtx_stats_t *cstats;
+
+    portENTER_CRITICAL(&named_mux);
+
+    for (cstats = named; cstats; cstats = cstats->next) {
+        mtx_stats_reset(cstats);
+    }
+
+    portEXIT_CRITICAL(&named_mux);
+}
+#endif
+
 int mtx_inited(struct mtx *mutex) {
     return (mutex->lock != 0);
 }
@@ -60,24 +212,26 @@ void mtx_init(struct mtx *mutex, const char *name, const char *type, int opts) {
     mutex->opts = opts;
 
     if (mutex->opts == MTX_DEF) {
-        mutex->lock = xSemaphoreCreateBinary();
+        mutex->lock = xSemaphoreCreateMutex();
     } else if (opts == MTX_RECURSE) {
         mutex->lock = xSemaphoreCreateRecursiveMutex();
     } else {
         return;
     }
 
+#if CONFIG_LUA_RTOS_MUTEX_STATS
     if (mutex->lock) {
-        if (xPortInIsrContext()) {
-            BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-            xSemaphoreGiveFromISR( mutex->lock, &xHigherPriorityTaskWoken);
-            portEND_SWITCHING_ISR( xHigherPriorityTaskWoken );
-        } else {
-            if (mutex->opts == MTX_DEF) {
-                xSemaphoreGive( mutex->lock );
-            }
+        mtx_stats_t *next = mutex->stats.next;
+
+        mtx_stats_init(&mutex->stats, name);
+
+        if (name) {
+            // Keep the link, if it's in the list
+            mutex->stats.next = next;
+            mtx_add_named(mutex);
         }
-    }    
+    }
+#endif
 }
 
 void IRAM_ATTR mtx_lock(struct mtx *mutex) {
@@ -86,15 +240,28 @@ void IRAM_ATTR mtx_lock(struct mtx *mutex) {
         xSemaphoreTakeFromISR( mutex->lock, &xHigherPriorityTaskWoken );
         portEND_SWITCHING_ISR( xHigherPriorityTaskWoken );
     } else {
+#if CONFIG_LUA_RTOS_MUTEX_STATS
+        mtx_stats_lock(MTX_OPS(mutex), mutex->lock, &mutex->stats);
+        mtx_set_owner(mutex);
+#else
         if (mutex->opts == MTX_DEF) {
             xSemaphoreTake( mutex->lock, portMAX_DELAY );
         } else if (mutex->opts == MTX_RECURSE) {
             xSemaphoreTakeRecursive( mutex->lock, portMAX_DELAY );
         }
+#endif
     }
 }
 
 int mtx_trylock(struct mtx *mutex) {
+#if CONFIG_LUA_RTOS_MUTEX_STATS
+    if (mtx_stats_trylock(MTX_OPS(mutex), mutex->lock, &mutex->stats)) {
+        mtx_set_owner(mutex);
+        return 1;
+    }
+
+    return 0;
+#else
     if (mutex->opts == MTX_DEF) {
         if (xSemaphoreTake( mutex->lock, 0 ) == pdTRUE) {
             return 1;
@@ -110,6 +277,7 @@ int mtx_trylock(struct mtx *mutex) {
     }
 
     return 0;
+#endif
 }
 
 void IRAM_ATTR mtx_unlock(struct mtx *mutex) {
@@ -118,6 +286,10 @@ void IRAM_ATTR mtx_unlock(struct mtx *mutex) {
         xSemaphoreGiveFromISR( mutex->lock, &xHigherPriorityTaskWoken );
         portEND_SWITCHING_ISR( xHigherPriorityTaskWoken );
     } else {
+#if CONFIG_LUA_RTOS_MUTEX_STATS
+        mtx_stats_unlock(MTX_OPS(mutex), &mutex->stats);
+#endif
+
         if (mutex->opts == MTX_DEF) {
             xSemaphoreGive( mutex->lock );
         } else if (mutex->opts == MTX_RECURSE) {
@@ -129,12 +301,15 @@ void IRAM_ATTR mtx_unlock(struct mtx *mutex) {
 void mtx_destroy(struct mtx *mutex) {
     if (!mutex->lock) return;
 
+#if CONFIG_LUA_RTOS_MUTEX_STATS
+    if (mutex->stats.name) {
+        mtx_remove_named(mutex);
+    }
+#endif
+
     if (mutex->opts == MTX_DEF) {
-        if (xPortInIsrContext()) {
-            BaseType_t xHigherPriorityTaskWoken = pdFALSE;
-            xSemaphoreGiveFromISR( mutex->lock, &xHigherPriorityTaskWoken );
-            portEND_SWITCHING_ISR( xHigherPriorityTaskWoken );
-        } else {
+        // Only the holder can give a mutex
+        if (xSemaphoreGetMutexHolder( mutex->lock ) == xTaskGetCurrentTaskHandle()) {
             xSemaphoreGive( mutex->lock );
         }
 
@@ -51,11 +51,25 @@
 #include "freertos/FreeRTOS.h"
 #include "freertos/semphr.h"
 
+#include <sys/mutex_stats.h>
+
 struct mtx {
     SemaphoreHandle_t lock;
     int opts;
+#if CONFIG_LUA_RTOS_MUTEX_STATS
+    mtx_stats_t stats;
+    char owner[configMAX_TASK_NAME_LEN]; ///< Name of the owner, copied when it takes the mutex
+#endif
 };
 
+#if CONFIG_LUA_RTOS_MUTEX_STATS
+// Statistics of a named mutex, with the name of the owner task
+typedef struct {
+    mtx_stats_t stats;
+    char owner[configMAX_TASK_NAME_LEN];
+} mtx_info_t;
+#endif
+
 #define MTX_DEF 0
 #define MTX_RECURSE 1
 
@@ -66,4 +80,22 @@ int  mtx_trylock(struct    mtx *mutex);
 void mtx_unlock(struct mtx *mutex);
 void mtx_destroy(struct    mtx *mutex);
 
+#if CONFIG_LUA_RTOS_MUTEX_STATS
+/**
+ * @brief Get the statistics of the named mutexes (the ones with a name in
+ *        mtx_init).
+ *
+ * @param info Array for the statistics, or NULL to get the number of mutexes.
+ * @param max Entries in info.
+ *
+ * @return The number of named mutexes.
+ */
+int mtx_get_stats(mtx_info_t *info, int max);
+
+/**
+ * @brief Clear the statistics of the named mutexes.
+ */
+void mtx_reset_stats();
+#endif
+
 #endif    /* _MUTEX_H */
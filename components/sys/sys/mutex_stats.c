@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, mutex contention statistics
+ *
+ */
+
+#include "esp_attr.h"
+
+#include <sys/mutex_stats.h>
+
+#include <string.h>
+
+/*
+ * Helper functions
+ */
+
+static void IRAM_ATTR acquired(const mtx_stats_ops_t *ops, mtx_stats_t *stats, void *self, uint32_t wait) {
+    stats->owner = self;
+    stats->depth = 1;
+    stats->locked_at = ops->now();
+
+    stats->acquisitions++;
+    stats->total_wait += wait;
+    if (wait > stats->max_wait) {
+        stats->max_wait = wait;
+    }
+}
+
+/*
+ * Operation functions
+ */
+
+void mtx_stats_init(mtx_stats_t *stats, const char *name) {
+    memset(stats, 0, sizeof(mtx_stats_t));
+    stats->name = name;
+}
+
+void IRAM_ATTR mtx_stats_lock(const mtx_stats_ops_t *ops, void *lock, mtx_stats_t *stats) {
+    void *self = ops->self();
+    uint32_t start;
+    int32_t attempts = 0;
+    int32_t limit;
+    void *owner;
+    int spun = 0;
+
+    if (ops->recursive && (stats->owner == self)) {
+        ops->lock(lock);
+        stats->depth++;
+        return;
+    }
+
+    if (ops->trylock(lock)) {
+        acquired(ops, stats, self, 0);
+        return;
+    }
+
+    start = ops->now();
+
+    // Spin while the owner is running on other CPU
+    if (ops->max_spin > 0) {
+        limit = stats->spin * 2 + 10;
+        if (limit > ops->max_spin) {
+            limit = ops->max_spin;
+        }
+
+        while (attempts < limit) {
+            attempts++;
+
+            if (ops->trylock(lock)) {
+                spun = 1;
+                break;
+            }
+
+            owner = stats->owner;
+            if (owner && !ops->running(owner)) {
+                break;
+            }
+        }
+
+        // The average is updated without holding the lock if the spin
+        // failed, it's only a hint
+        stats->spin += (attempts - stats->spin) / 8;
+    }
+
+    if (!spun) {
+        ops->lock(lock);
+    }
+
+    stats->contentions++;
+    if (spun) {
+        stats->spins++;
+    }
+
+    acquired(ops, stats, self, ops->now() - start);
+}
+
+int IRAM_ATTR mtx_stats_trylock(const mtx_stats_ops_t *ops, void *lock, mtx_stats_t *stats) {
+    void *self = ops->self();
+
+    if (!ops->trylock(lock)) {
+        return 0;
+    }
+
+    if (ops->recursive && (stats->owner == self)) {
+        stats->depth++;
+    } else {
+        acquired(ops, stats, self, 0);
+    }
+
+    return 1;
+}
+
+void IRAM_ATTR mtx_stats_unlock(const mtx_stats_ops_t *ops, mtx_stats_t *stats) {
+    uint32_t hold;
+
+    if (stats->depth > 1) {
+        stats->depth--;
+        return;
+    }
+
+    hold = ops->now() - stats->locked_at;
+
+    stats->total_hold += hold;
+    if (hold > stats->max_hold) {
+        stats->max_hold = hold;
+    }
+
+    stats->depth = 0;
+    stats->owner = NULL;
+}
+
+void mtx_stats_reset(mtx_stats_t *stats) {
+    stats->acquisitions = 0;
+    stats->contentions = 0;
+    stats->spins = 0;
+    stats->max_wait = 0;
+    stats->max_hold = 0;
+    stats->total_wait = 0;
+    stats->total_hold = 0;
+}
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, mutex contention statistics
+ *
+ * Acquisition of a mutex with contention accounting, and owner tracking.
+ * When the mutex is taken, and its owner is running on another CPU, the
+ * acquisition spins for a while before blocking, because the owner is
+ * likely to release it soon. The number of attempts adapts to the
+ * attempts that were needed before (as glibc adaptive mutexes do).
+ *
+ * The accounting doesn't depend on the OS: the lock primitives, the
+ * current thread and the clock are passed as a set of operations. The
+ * statistics are only written while the mutex is held.
+ *
+ */
+
+#ifndef _SYS_MUTEX_STATS_H
+#define _SYS_MUTEX_STATS_H
+
+#include <stdint.h>
+
+typedef struct mtx_stats {
+    const char *name;
+    void *owner;             ///< Thread that holds the mutex, or NULL
+    uint32_t depth;          ///< Acquisitions of the owner (recursive mutexes)
+    uint32_t locked_at;      ///< When the owner took the mutex, in usecs
+
+    uint32_t acquisitions;
+    uint32_t contentions;    ///< Acquisitions that found the mutex taken
+    uint32_t spins;          ///< Contentions solved spinning, without blocking
+    uint32_t max_wait;       ///< Longest wait, in usecs
+    uint32_t max_hold;       ///< Longest hold, in usecs
+    uint64_t total_wait;     ///< In usecs
+    uint64_t total_hold;     ///< In usecs
+
+    int32_t spin;            ///< Average spin attempts
+
+    struct mtx_stats *next;  ///< For the caller, to keep a list of mutexes
+} mtx_stats_t;
+
+typedef struct {
+    int  (*trylock)(void *lock);    ///< Take the lock if it is free, 1 if taken
+    void (*lock)(void *lock);       ///< Take the lock, waiting if it is taken
+    void *(*self)(void);            ///< Current thread
+    int  (*running)(void *thread);  ///< 1 if the thread is running on other CPU
+    uint32_t (*now)(void);          ///< Current time, in usecs
+    int32_t max_spin;               ///< Maximum spin attempts, 0 for no spinning
+    uint8_t recursive;              ///< The owner can take the lock again
+} mtx_stats_ops_t;
+
+/**
+ * @brief Initialize the statistics of a mutex.
+ *
+ * @param stats Statistics.
+ * @param name Name of the mutex, or NULL.
+ */
+void mtx_stats_init(mtx_stats_t *stats, const char *name);
+
+/**
+ * @brief Take a mutex.
+ *
+ * @param ops Lock operations.
+ * @param lock Lock, passed to the operations.
+ * @param stats Statistics of the mutex.
+ */
+void mtx_stats_lock(const mtx_stats_ops_t *ops, void *lock, mtx_stats_t *stats);
+
+/**
+ * @brief Take a mutex if it is free.
+ *
+ * @param ops Lock operations.
+ * @param lock Lock, passed to the operations.
+ * @param stats Statistics of the mutex.
+ *
+ * @return 1 if the mutex was taken, 0 if not.
+ */
+int mtx_stats_trylock(const mtx_stats_ops_t *ops, void *lock, mtx_stats_t *stats);
+
+/**
+ * @brief Account the release of a mutex. It must be called by the owner,
+ *        before releasing the lock.
+ *
+ * @param ops Lock operations.
+ * @param stats Statistics of the mutex.
+ */
+void mtx_stats_unlock(const mtx_stats_ops_t *ops, mtx_stats_t *stats);
+
+/**
+ * @brief Clear the counters of a mutex. The owner is kept.
+ *
+ * @param stats Statistics.
+ */
+void mtx_stats_reset(mtx_stats_t *stats);
+
+#endif /* _SYS_MUTEX_STATS_H */
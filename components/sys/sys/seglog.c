@@ -0,0 +1,484 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, segmented log
+ *
+ */
+
+#include <sys/seglog.h>
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*
+ * Helper functions
+ */
+
+static void segment_name(seglog_t *log, uint32_t seq, char *name, size_t size) {
+    snprintf(name, size, SEGLOG_SEGMENT_NAME, log->base, (unsigned int)seq);
+}
+
+static int index_add(seglog_segment_t *segment, uint32_t offset) {
+    uint32_t *offsets;
+    uint32_t capacity;
+
+    if (segment->records == segment->capacity) {
+        capacity = segment->capacity?(segment->capacity * 2):16;
+
+        offsets = realloc(segment->offset, capacity * sizeof(uint32_t));
+        if (!offsets) {
+            errno = ENOMEM;
+            return -1;
+        }
+
+        segment->offset = offsets;
+        segment->capacity = capacity;
+    }
+
+    segment->offset[segment->records++] = offset;
+
+    return 0;
+}
+
+// Build the index of a segment, reading it in blocks. Empty lines are not
+// records, a file not written by seglog (as the history before it) can
+// have them.
+static int index_segment(seglog_t *log, seglog_segment_t *segment) {
+    char name[PATH_MAX + 1];
+    char block[SEGLOG_BLOCK_SIZE];
+    uint32_t offset = 0;
+    int start = 1;
+    size_t len, i;
+    FILE *fp;
+
+    segment_name(log, segment->seq, name, sizeof(name));
+
+    fp = fopen(name, "r");
+    if (!fp) {
+        return -1;
+    }
+
+    while ((len = fread(block, 1, sizeof(block), fp)) > 0) {
+        log->stats.bytes_read += len;
+
+        for (i = 0; i < len; i++) {
+            if (start && (block[i] != '\n')) {
+                if (index_add(segment, offset + i) < 0) {
+                    fclose(fp);
+                    return -1;
+                }
+            }
+
+            start = (block[i] == '\n');
+        }
+
+        offset += len;
+    }
+
+    fclose(fp);
+
+    segment->size = offset;
+    segment->partial = !start;
+
+    return 0;
+}
+
+static void segment_free(seglog_segment_t *segment) {
+    free(segment->offset);
+    memset(segment, 0, sizeof(seglog_segment_t));
+}
+
+static void remove_oldest(seglog_t *log) {
+    char name[PATH_MAX + 1];
+
+    segment_name(log, log->segment[0].seq, name, sizeof(name));
+    remove(name);
+
+    segment_free(&log->segment[0]);
+
+    log->segments--;
+    memmove(&log->segment[0], &log->segment[1], log->segments * sizeof(seglog_segment_t));
+    memset(&log->segment[log->segments], 0, sizeof(seglog_segment_t));
+
+    log->stats.segments_removed++;
+}
+
+// Start a new segment, removing the oldest one if the log is full. The
+// file is created with the first record.
+static seglog_segment_t *new_segment(seglog_t *log) {
+    seglog_segment_t *segment;
+    uint32_t seq = 0;
+
+    if (log->segments) {
+        seq = log->segment[log->segments - 1].seq + 1;
+    }
+
+    if (log->segments == log->max_segments) {
+        remove_oldest(log);
+    }
+
+    segment = &log->segment[log->segments++];
+    segment->seq = seq;
+
+    log->stats.segments_created++;
+
+    return segment;
+}
+
+static int compare_seq(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+/*
+ * Operation functions
+ */
+
+int seglog_open(seglog_t *log, const char *base, uint32_t segment_size, int max_segments) {
+    char dir[PATH_MAX + 1];
+    char name[PATH_MAX + 1];
+    uint32_t *seqs = NULL;
+    uint32_t *tmp;
+    int count = 0, capacity = 0;
+    struct dirent *ent;
+    const char *file;
+    unsigned long seq;
+    size_t len;
+    char *end;
+    DIR *dp;
+    int i;
+
+    memset(log, 0, sizeof(seglog_t));
+
+    if ((max_segments < 2) || !segment_size || (strlen(base) > PATH_MAX - 12)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    log->base = strdup(base);
+    log->segment = calloc(max_segments, sizeof(seglog_segment_t));
+    if (!log->base || !log->segment) {
+        seglog_close(log);
+
+        errno = ENOMEM;
+        return -1;
+    }
+
+    log->segment_size = segment_size;
+    log->max_segments = max_segments;
+
+    // Split the base in directory and file name
+    file = strrchr(base, '/');
+    if (file) {
+        len = file - base;
+        if (len == 0) {
+            strcpy(dir, "/");
+        } else {
+            memcpy(dir, base, len);
+            dir[len] = '\0';
+        }
+
+        file++;
+    } else {
+        strcpy(dir, ".");
+        file = base;
+    }
+
+    len = strlen(file);
+
+    // Find the segments
+    dp = opendir(dir);
+    if (dp) {
+        while ((ent = readdir(dp))) {
+            if (strncmp(ent->d_name, file, len) || (ent->d_name[len] != '.') || !isdigit((int)ent->d_name[len + 1])) {
+                continue;
+            }
+
+            seq = strtoul(&ent->d_name[len + 1], &end, 10);
+            if (*end) {
+                continue;
+            }
+
+            if (count == capacity) {
+                capacity = capacity?(capacity * 2):8;
+
+                tmp = realloc(seqs, capacity * sizeof(uint32_t));
+                if (!tmp) {
+                    closedir(dp);
+                    free(seqs);
+                    seglog_close(log);
+
+                    errno = ENOMEM;
+                    return -1;
+                }
+
+                seqs = tmp;
+            }
+
+            seqs[count++] = seq;
+        }
+
+        closedir(dp);
+    }
+
+    if (count) {
+        qsort(seqs, count, sizeof(uint32_t), compare_seq);
+    }
+
+    // Index the newest segments, and remove the rest
+    for (i = 0; i < count; i++) {
+        if (count - i > max_segments) {
+            segment_name(log, seqs[i], name, sizeof(name));
+            remove(name);
+
+            log->stats.segments_removed++;
+            continue;
+        }
+
+        log->segment[log->segments].seq = seqs[i];
+        log->segments++;
+
+        if (index_segment(log, &log->segment[log->segments - 1]) < 0) {
+            free(seqs);
+            seglog_close(log);
+            return -1;
+        }
+    }
+
+    free(seqs);
+
+    return 0;
+}
+
+int seglog_append(seglog_t *log, const char *record, size_t len) {
+    char name[PATH_MAX + 1];
+    seglog_segment_t *segment = NULL;
+    size_t written;
+    int attempts;
+    int error;
+    FILE *fp;
+
+    if (memchr(record, '\n', len)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if (log->segments) {
+        segment = &log->segment[log->segments - 1];
+    }
+
+    // A record that doesn't fit in the current segment starts a new one
+    if (!segment || segment->partial || (segment->size && (segment->size + len + 1 > log->segment_size))) {
+        segment = new_segment(log);
+    }
+
+    for (attempts = 0; attempts < log->max_segments; attempts++) {
+        if (index_add(segment, segment->size) < 0) {
+            return -1;
+        }
+
+        segment_name(log, segment->seq, name, sizeof(name));
+
+        fp = fopen(name, "a");
+        if (!fp) {
+            segment->records--;
+            return -1;
+        }
+
+        written = fwrite(record, 1, len, fp);
+        if (written == len) {
+            written += fwrite("\n", 1, 1, fp);
+        }
+
+        if ((written == len + 1) && (fflush(fp) != EOF)) {
+            fclose(fp);
+
+            segment->size += len + 1;
+
+            log->stats.appends++;
+            log->stats.bytes_written += len + 1;
+
+            return 0;
+        }
+
+        error = errno;
+
+        // Remove what was written of the record
+        segment->records--;
+        if (ftruncate(fileno(fp), segment->size) < 0) {
+            segment->partial = 1;
+        }
+
+        fclose(fp);
+
+        if (error != ENOSPC) {
+            errno = error;
+            return -1;
+        }
+
+        // No space left on the device, make room removing the oldest
+        // segment. If it is the one in use, start it again.
+        if (log->segments > 1) {
+            remove_oldest(log);
+        } else if (segment->size || segment->partial) {
+            remove_oldest(log);
+            new_segment(log);
+        } else {
+            break;
+        }
+
+        segment = &log->segment[log->segments - 1];
+    }
+
+    errno = ENOSPC;
+    return -1;
+}
+
+int seglog_count(seglog_t *log) {
+    int count = 0;
+    int i;
+
+    for (i = 0; i < log->segments; i++) {
+        count += log->segment[i].records;
+    }
+
+    return count;
+}
+
+int seglog_get(seglog_t *log, int index, char *buf, size_t buflen) {
+    char name[PATH_MAX + 1];
+    seglog_segment_t *segment = NULL;
+    uint32_t start, end;
+    uint32_t record;
+    size_t len;
+    FILE *fp;
+    int i;
+
+    if ((index < 0) || !buflen) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // Find the segment of the record, from the newest one
+    for (i = log->segments - 1; i >= 0; i--) {
+        segment = &log->segment[i];
+        if ((uint32_t)index < segment->records) {
+            break;
+        }
+
+        index -= segment->records;
+    }
+
+    if (i < 0) {
+        errno = ENOENT;
+        return -1;
+    }
+
+    record = segment->records - 1 - index;
+    start = segment->offset[record];
+
+    if (record + 1 < segment->records) {
+        end = segment->offset[record + 1] - 1;
+    } else {
+        end = segment->size - (segment->partial?0:1);
+    }
+
+    len = end - start;
+    if (len > buflen - 1) {
+        len = buflen - 1;
+    }
+
+    segment_name(log, segment->seq, name, sizeof(name));
+
+    fp = fopen(name, "r");
+    if (!fp) {
+        return -1;
+    }
+
+    if (fseek(fp, start, SEEK_SET) < 0) {
+        fclose(fp);
+        return -1;
+    }
+
+    len = fread(buf, 1, len, fp);
+
+    // Skip the empty lines that follow the record
+    while ((len > 0) && (buf[len - 1] == '\n')) {
+        len--;
+    }
+
+    buf[len] = '\0';
+
+    fclose(fp);
+
+    log->stats.bytes_read += len;
+
+    return len;
+}
+
+void seglog_clear(seglog_t *log) {
+    while (log->segments) {
+        remove_oldest(log);
+    }
+}
+
+void seglog_close(seglog_t *log) {
+    int i;
+
+    if (log->segment) {
+        for (i = 0; i < log->segments; i++) {
+            segment_free(&log->segment[i]);
+        }
+    }
+
+    free(log->segment);
+    free(log->base);
+
+    memset(log, 0, sizeof(seglog_t));
+}
@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, segmented log
+ *
+ * A bounded log of text records (lines), kept in a set of files of a fixed
+ * size (segments) named <base>.<sequence number>. Records are appended to
+ * the newest segment, and when it is full a new one is started. When the
+ * log has the maximum number of segments, or the device runs out of space,
+ * the oldest segment is removed. Nothing is ever moved inside a file, so
+ * the cost of an append is the record itself, and the log can't grow
+ * beyond the maximum number of segments.
+ *
+ * The start of each record is kept in an index in memory, built when the
+ * log is opened, so any record can be read with a single seek, counting
+ * from the newest one.
+ *
+ */
+
+#ifndef _SYS_SEGLOG_H
+#define _SYS_SEGLOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Name of a segment file, from the base name and the sequence number
+#define SEGLOG_SEGMENT_NAME "%s.%u"
+
+// Bytes read at once when building the index
+#define SEGLOG_BLOCK_SIZE 256
+
+typedef struct {
+    uint32_t seq;         ///< Sequence number
+    uint32_t size;        ///< Bytes in the segment
+    uint32_t records;     ///< Records in the segment
+    uint32_t capacity;    ///< Entries allocated in offset
+    uint32_t *offset;     ///< Start of each record
+    uint8_t partial;      ///< The last record has not a \n (interrupted write)
+} seglog_segment_t;
+
+typedef struct {
+    uint32_t appends;           ///< Records appended
+    uint32_t bytes_written;
+    uint32_t bytes_read;
+    uint32_t segments_created;
+    uint32_t segments_removed;
+} seglog_stats_t;
+
+typedef struct {
+    char *base;
+    uint32_t segment_size;
+    int max_segments;
+    int segments;
+    seglog_segment_t *segment;  ///< Oldest first
+    seglog_stats_t stats;
+} seglog_t;
+
+/**
+ * @brief Open a log, indexing the segments that already exist. If there
+ *        are more segments than max_segments the oldest ones are removed.
+ *
+ * @param log Log.
+ * @param base Path of the log, the segments are <base>.<sequence number>.
+ * @param segment_size Size of a segment, in bytes. A record longer than
+ *                     this takes a segment for itself.
+ * @param max_segments Maximum number of segments, at least 2.
+ *
+ * @return
+ *    Returns the value 0 if successful; otherwise the value -1 is returned and errno
+ *    is set to indicate the error.
+ */
+int seglog_open(seglog_t *log, const char *base, uint32_t segment_size, int max_segments);
+
+/**
+ * @brief Append a record.
+ *
+ * @param log Log.
+ * @param record Record, without the ending \n. It can't have \n characters.
+ * @param len Length of the record.
+ *
+ * @return
+ *    Returns the value 0 if successful; otherwise the value -1 is returned and errno
+ *    is set to indicate the error.
+ */
+int seglog_append(seglog_t *log, const char *record, size_t len);
+
+/**
+ * @brief Get the number of records in the log.
+ *
+ * @param log Log.
+ *
+ * @return Number of records.
+ */
+int seglog_count(seglog_t *log);
+
+/**
+ * @brief Read a record, counting from the newest one.
+ *
+ * @param log Log.
+ * @param index Index of the record, 0 is the newest one.
+ * @param buf Buffer for the record, the \n is not copied. The record is
+ *            truncated if it doesn't fit.
+ * @param buflen Size of buf, including the terminating 0.
+ *
+ * @return
+ *    Returns the length of the record copied to buf if successful; otherwise the
+ *    value -1 is returned and errno is set to indicate the error.
+ */
+int seglog_get(seglog_t *log, int index, char *buf, size_t buflen);
+
+/**
+ * @brief Remove all the records, and their segments.
+ *
+ * @param log Log.
+ */
+void seglog_clear(seglog_t *log);
+
+/**
+ * @brief Close a log, the segments are kept.
+ *
+ * @param log Log.
+ */
+void seglog_close(seglog_t *log);
+
+#endif /* _SYS_SEGLOG_H */
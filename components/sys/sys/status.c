@@ -51,7 +51,7 @@ static uint32_t LuaRTOS_status;      // Current status
 static uint32_t LuaRTOS_prev_status; // Previous status
 
 void _status_init() {
-    mtx_init(&mtx, NULL, NULL, 0);
+    mtx_init(&mtx, "status", NULL, 0);
     LuaRTOS_status = 0;
     LuaRTOS_prev_status = 0;
 }
@@ -0,0 +1,316 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, hierarchical timing wheel
+ *
+ */
+
+#include <sys/timer_wheel.h>
+
+#include <string.h>
+
+#define SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+
+/*
+ * Helper functions
+ */
+
+// Move an expiration inside [due, due + window] to the tick with more
+// trailing zero bits, so the expirations of other timers are likely to
+// land in the same tick
+static uint32_t coalesce(uint32_t due, uint32_t window) {
+    uint32_t limit = due + window;
+    uint32_t mask;
+
+    if (!window) {
+        return due;
+    }
+
+    // Clear the bits of limit below the highest one that differs from due
+    mask = due ^ limit;
+    mask = (1UL << (31 - __builtin_clz(mask))) - 1;
+
+    return limit & ~mask;
+}
+
+static void enqueue(timer_wheel_t *wheel, timer_wheel_entry_t *entry) {
+    timer_wheel_entry_t **head;
+    uint32_t expires = entry->expires;
+    int32_t delta = (int32_t)(expires - wheel->now);
+    int level;
+
+    if (delta < 0) {
+        // Already expired, it goes in the slot of the tick being processed
+        expires = wheel->now;
+        delta = 0;
+    } else if ((uint32_t)delta > TIMER_WHEEL_MAX_DELAY) {
+        // Wait in the last wheel, and cascade from there
+        expires = wheel->now + TIMER_WHEEL_MAX_DELAY;
+        delta = TIMER_WHEEL_MAX_DELAY;
+    }
+
+    for (level = 0; level < TIMER_WHEEL_LEVELS - 1; level++) {
+        if (delta < (1L << (TIMER_WHEEL_BITS * (level + 1)))) {
+            break;
+        }
+    }
+
+    head = &wheel->slot[level][(expires >> (TIMER_WHEEL_BITS * level)) & SLOT_MASK];
+
+    entry->next = *head;
+    if (entry->next) {
+        entry->next->pprev = &entry->next;
+    }
+
+    entry->pprev = head;
+    *head = entry;
+}
+
+static void unlink(timer_wheel_t *wheel, timer_wheel_entry_t *entry) {
+    *entry->pprev = entry->next;
+    if (entry->next) {
+        entry->next->pprev = entry->pprev;
+    }
+
+    entry->next = NULL;
+    entry->pprev = NULL;
+    entry->active = 0;
+
+    wheel->count--;
+}
+
+// Move the timers of a slot of an upper wheel to the lower wheels
+static void cascade(timer_wheel_t *wheel, int level, int index) {
+    timer_wheel_entry_t *entry = wheel->slot[level][index];
+    timer_wheel_entry_t *next;
+
+    wheel->slot[level][index] = NULL;
+
+    while (entry) {
+        next = entry->next;
+        enqueue(wheel, entry);
+        entry = next;
+    }
+}
+
+static int expire(timer_wheel_t *wheel, timer_wheel_entry_t *entry, timer_wheel_expire_t handler, void *arg) {
+    int handed = 0;
+
+    unlink(wheel, entry);
+
+    if (entry->pending) {
+        // The executor has not finished with the previous expiration
+        entry->overruns++;
+    } else {
+        entry->pending = 1;
+
+        if (handler(arg, entry) == 0) {
+            entry->expirations++;
+            handed = 1;
+        } else {
+            entry->pending = 0;
+            entry->overruns++;
+        }
+    }
+
+    if (entry->period) {
+        // Reschedule from the nominal expiration, the window is lower
+        // than the period so it is always after the current tick
+        entry->due += entry->period;
+        entry->expires = coalesce(entry->due, entry->window);
+
+        enqueue(wheel, entry);
+        entry->active = 1;
+        wheel->count++;
+    }
+
+    return handed;
+}
+
+// Process the next tick
+static int tick(timer_wheel_t *wheel, timer_wheel_expire_t handler, void *arg) {
+    timer_wheel_entry_t *list;
+    uint32_t now = ++wheel->now;
+    int handed = 0;
+    int level;
+    int index;
+
+    // Cascade the upper wheels, when the lower ones wrap
+    for (level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+        if (now & ((1UL << (TIMER_WHEEL_BITS * level)) - 1)) {
+            break;
+        }
+
+        cascade(wheel, level, (now >> (TIMER_WHEEL_BITS * level)) & SLOT_MASK);
+    }
+
+    // Expire the timers of this tick. The slot is detached first, because
+    // periodic timers can be rescheduled in it.
+    index = now & SLOT_MASK;
+    list = wheel->slot[0][index];
+    if (list) {
+        list->pprev = &list;
+    }
+
+    wheel->slot[0][index] = NULL;
+
+    while (list) {
+        handed += expire(wheel, list, handler, arg);
+    }
+
+    return handed;
+}
+
+/*
+ * Operation functions
+ */
+
+void timer_wheel_init(timer_wheel_t *wheel, uint32_t now) {
+    memset(wheel, 0, sizeof(timer_wheel_t));
+    wheel->now = now;
+}
+
+void timer_wheel_entry_init(timer_wheel_entry_t *entry, void *arg) {
+    memset(entry, 0, sizeof(timer_wheel_entry_t));
+    entry->arg = arg;
+}
+
+void timer_wheel_start(timer_wheel_t *wheel, timer_wheel_entry_t *entry, uint32_t delay, uint32_t period, uint32_t window) {
+    if (entry->active) {
+        unlink(wheel, entry);
+    }
+
+    // Keep the expirations in the half of the tick range ahead of now
+    if (delay < 1) {
+        delay = 1;
+    } else if (delay > 0x3fffffff) {
+        delay = 0x3fffffff;
+    }
+
+    if (period > 0x3fffffff) {
+        period = 0x3fffffff;
+    }
+
+    if (period && (window >= period)) {
+        window = period - 1;
+    } else if (window > 0x3fffffff) {
+        window = 0x3fffffff;
+    }
+
+    entry->due = wheel->now + delay;
+    entry->period = period;
+    entry->window = window;
+    entry->expires = coalesce(entry->due, window);
+
+    enqueue(wheel, entry);
+    entry->active = 1;
+    wheel->count++;
+}
+
+void timer_wheel_stop(timer_wheel_t *wheel, timer_wheel_entry_t *entry) {
+    if (entry->active) {
+        unlink(wheel, entry);
+    }
+}
+
+void timer_wheel_done(timer_wheel_entry_t *entry) {
+    entry->pending = 0;
+}
+
+int timer_wheel_advance(timer_wheel_t *wheel, uint32_t now, timer_wheel_expire_t expire, void *arg) {
+    uint32_t next;
+    int handed = 0;
+
+    while ((int32_t)(now - wheel->now) > 0) {
+        // Skip the ticks without work
+        next = timer_wheel_next(wheel);
+        if ((next == TIMER_WHEEL_IDLE) || (next > now - wheel->now)) {
+            wheel->now = now;
+            break;
+        }
+
+        wheel->now += next - 1;
+        handed += tick(wheel, expire, arg);
+    }
+
+    return handed;
+}
+
+uint32_t timer_wheel_next(timer_wheel_t *wheel) {
+    uint32_t next = TIMER_WHEEL_IDLE;
+    uint32_t base;
+    uint32_t ticks;
+    int level;
+    int shift;
+    int i;
+
+    if (!wheel->count) {
+        return TIMER_WHEEL_IDLE;
+    }
+
+    // Timers of the first wheel expire in the next TIMER_WHEEL_SLOTS ticks
+    for (i = 1; i <= TIMER_WHEEL_SLOTS; i++) {
+        if (wheel->slot[0][(wheel->now + i) & SLOT_MASK]) {
+            next = i;
+            break;
+        }
+    }
+
+    // Timers of the upper wheels must be cascaded first, when the tick
+    // reaches the start of their slot
+    for (level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+        shift = TIMER_WHEEL_BITS * level;
+        base = wheel->now >> shift;
+
+        for (i = 1; i <= TIMER_WHEEL_SLOTS; i++) {
+            if (wheel->slot[level][(base + i) & SLOT_MASK]) {
+                ticks = ((base + i) << shift) - wheel->now;
+                if (ticks < next) {
+                    next = ticks;
+                }
+
+                break;
+            }
+        }
+    }
+
+    return next;
+}
@@ -0,0 +1,189 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, hierarchical timing wheel
+ *
+ * Many timers share a single tick source. A timer is kept in a slot of a
+ * wheel according to how far its expiration is: the first wheel has one
+ * slot per tick, and each of the next wheels has slots that span the
+ * whole previous wheel. When the tick reaches a slot of an upper wheel,
+ * its timers are moved down to the lower wheels (cascade), so starting,
+ * stopping and expiring a timer is O(1), regardless of the number of
+ * timers.
+ *
+ * A timer can have a coalescing window: it can expire up to window ticks
+ * late. The expiration is moved inside the window to the tick with more
+ * trailing zero bits, so timers with overlapping windows expire in the
+ * same tick, and the tick source is woken up less often. Periodic timers
+ * are always rescheduled from their nominal expiration, so the window
+ * doesn't add drift.
+ *
+ * Expired timers are handed to an executor. A timer that expires again
+ * before the executor has finished with it is not handed again, the
+ * expiration is counted as an overrun instead.
+ *
+ * The wheel doesn't depend on the OS, nor has locking: the caller must
+ * serialize the calls.
+ *
+ */
+
+#ifndef _SYS_TIMER_WHEEL_H
+#define _SYS_TIMER_WHEEL_H
+
+#include <stdint.h>
+
+#define TIMER_WHEEL_BITS   6
+#define TIMER_WHEEL_SLOTS  (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS 4
+
+// Longest delay that fits in the wheels, longer timers are cascaded from
+// the last wheel until they fit
+#define TIMER_WHEEL_MAX_DELAY ((1UL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1)
+
+// Returned by timer_wheel_next when there are no timers
+#define TIMER_WHEEL_IDLE 0xffffffff
+
+typedef struct timer_wheel_entry {
+    struct timer_wheel_entry *next;
+    struct timer_wheel_entry **pprev;  ///< Link that points to this timer
+
+    uint32_t due;          ///< Nominal expiration, in ticks
+    uint32_t expires;      ///< Expiration inside the coalescing window
+    uint32_t period;       ///< Period in ticks, 0 for a one-shot timer
+    uint32_t window;       ///< Coalescing window, in ticks
+
+    uint32_t expirations;  ///< Expirations handed to the executor
+    uint32_t overruns;     ///< Expirations lost because the executor was busy
+
+    uint8_t active;        ///< The timer is in the wheel
+    uint8_t pending;       ///< The timer is in the executor
+
+    void *arg;
+} timer_wheel_entry_t;
+
+typedef struct {
+    uint32_t now;          ///< Last processed tick
+    uint32_t count;        ///< Timers in the wheel
+    timer_wheel_entry_t *slot[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+} timer_wheel_t;
+
+/**
+ * @brief Hand an expired timer to the executor.
+ *
+ * @param arg Argument passed to timer_wheel_advance.
+ * @param entry Expired timer.
+ *
+ * @return 0 if the timer was accepted, -1 if not (it is counted as an
+ *         overrun).
+ */
+typedef int (*timer_wheel_expire_t)(void *arg, timer_wheel_entry_t *entry);
+
+/**
+ * @brief Initialize a wheel.
+ *
+ * @param wheel Wheel.
+ * @param now Current tick.
+ */
+void timer_wheel_init(timer_wheel_t *wheel, uint32_t now);
+
+/**
+ * @brief Initialize a timer. It must be called once, before the first start.
+ *
+ * @param entry Timer.
+ * @param arg Argument for the caller, not used by the wheel.
+ */
+void timer_wheel_entry_init(timer_wheel_entry_t *entry, void *arg);
+
+/**
+ * @brief Start a timer, or restart it if it is already started.
+ *
+ * @param wheel Wheel.
+ * @param entry Timer.
+ * @param delay Ticks from now to the first expiration, at least 1.
+ * @param period Ticks between expirations, 0 for a one-shot timer.
+ * @param window Ticks the expirations can be delayed to coalesce them with
+ *               other timers. For periodic timers it is limited to
+ *               period - 1.
+ */
+void timer_wheel_start(timer_wheel_t *wheel, timer_wheel_entry_t *entry, uint32_t delay, uint32_t period, uint32_t window);
+
+/**
+ * @brief Stop a timer. If it is in the executor, it stays there until
+ *        timer_wheel_done is called.
+ *
+ * @param wheel Wheel.
+ * @param entry Timer.
+ */
+void timer_wheel_stop(timer_wheel_t *wheel, timer_wheel_entry_t *entry);
+
+/**
+ * @brief The executor has finished with a timer, so it can be handed again.
+ *
+ * @param entry Timer.
+ */
+void timer_wheel_done(timer_wheel_entry_t *entry);
+
+/**
+ * @brief Process the ticks up to now, handing the expired timers to the
+ *        executor. Periodic timers are rescheduled.
+ *
+ * @param wheel Wheel.
+ * @param now Current tick.
+ * @param expire Executor.
+ * @param arg Argument for the executor.
+ *
+ * @return Number of timers handed to the executor.
+ */
+int timer_wheel_advance(timer_wheel_t *wheel, uint32_t now, timer_wheel_expire_t expire, void *arg);
+
+/**
+ * @brief Get the ticks until the wheel must be advanced again. When the
+ *        next timer is in an upper wheel, this is the tick of its cascade,
+ *        so it can be earlier than the expiration.
+ *
+ * @param wheel Wheel.
+ *
+ * @return Ticks from the last processed tick, or TIMER_WHEEL_IDLE if there
+ *         are no timers.
+ */
+uint32_t timer_wheel_next(timer_wheel_t *wheel);
+
+#endif /* _SYS_TIMER_WHEEL_H */
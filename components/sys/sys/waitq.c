@@ -0,0 +1,163 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, FIFO wait queue
+ *
+ */
+
+#include <sys/waitq.h>
+
+#include <stddef.h>
+
+/*
+ * Helper functions
+ */
+
+static void unlink_waiter(waitq_t *queue, waitq_waiter_t *waiter) {
+    *waiter->pprev = waiter->next;
+    if (waiter->next) {
+        waiter->next->pprev = waiter->pprev;
+    } else {
+        queue->tail = waiter->pprev;
+    }
+
+    waiter->next = NULL;
+    waiter->pprev = NULL;
+    queue->waiters--;
+}
+
+static void wake_head(const waitq_ops_t *ops, waitq_t *queue) {
+    waitq_waiter_t *waiter = queue->head;
+
+    unlink_waiter(queue, waiter);
+
+    // The waiter can return as soon as the queue lock is released, so it
+    // can't be used after that
+    waiter->woken = 1;
+    queue->wakeups++;
+    ops->wake(waiter->thread);
+}
+
+/*
+ * Operation functions
+ */
+
+void waitq_init(waitq_t *queue) {
+    queue->head = NULL;
+    queue->tail = &queue->head;
+    queue->waiters = 0;
+    queue->wakeups = 0;
+    queue->timeouts = 0;
+    queue->spurious = 0;
+}
+
+void waitq_prepare(const waitq_ops_t *ops, void *lock, waitq_t *queue, waitq_waiter_t *waiter) {
+    if (ops->self) {
+        waiter->thread = ops->self();
+    }
+
+    waiter->woken = 0;
+    waiter->next = NULL;
+
+    ops->lock(lock);
+    waiter->pprev = queue->tail;
+    *queue->tail = waiter;
+    queue->tail = &waiter->next;
+    queue->waiters++;
+    ops->unlock(lock);
+}
+
+int waitq_wait(const waitq_ops_t *ops, void *lock, waitq_t *queue, waitq_waiter_t *waiter, uint64_t deadline) {
+    uint64_t now;
+    int blocked = 0;
+
+    for(;;) {
+        ops->lock(lock);
+
+        if (waiter->woken) {
+            ops->unlock(lock);
+            return 0;
+        }
+
+        now = (deadline == WAITQ_FOREVER)?0:ops->now();
+        if ((deadline != WAITQ_FOREVER) && (now >= deadline)) {
+            unlink_waiter(queue, waiter);
+            queue->timeouts++;
+            ops->unlock(lock);
+            return -1;
+        }
+
+        if (blocked) {
+            queue->spurious++;
+        }
+
+        ops->unlock(lock);
+
+        ops->block(waiter->thread, (deadline == WAITQ_FOREVER)?WAITQ_FOREVER:(deadline - now));
+        blocked = 1;
+    }
+}
+
+int waitq_wake_one(const waitq_ops_t *ops, void *lock, waitq_t *queue) {
+    int woken = 0;
+
+    ops->lock(lock);
+    if (queue->head) {
+        wake_head(ops, queue);
+        woken = 1;
+    }
+    ops->unlock(lock);
+
+    return woken;
+}
+
+int waitq_wake_all(const waitq_ops_t *ops, void *lock, waitq_t *queue) {
+    int woken = 0;
+
+    ops->lock(lock);
+    while (queue->head) {
+        wake_head(ops, queue);
+        woken++;
+    }
+    ops->unlock(lock);
+
+    return woken;
+}
@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, FIFO wait queue
+ *
+ * Threads wait in a queue in arrival order, each one with its own wake
+ * up: waking one thread wakes the oldest waiter only, instead of waking
+ * all the waiters to let them race for the condition. There is no limit
+ * in the number of waiters, the waiters are linked through a structure
+ * that lives in the stack of the waiting thread.
+ *
+ * A wait is done in two steps: the thread is queued with waitq_prepare,
+ * and then waits with waitq_wait. Between them the caller can release
+ * the lock that protects the condition (as a condition variable does),
+ * without losing a wake up done in between.
+ *
+ * Timeouts are deadlines in a monotonic clock. An early return of the
+ * block operation (a wake up left from an older wait, for example) is
+ * not seen by the caller: the thread blocks again for the remaining time.
+ *
+ * The queue doesn't depend on the OS: the queue lock, the current thread,
+ * blocking and waking up a thread, and the clock are passed as a set of
+ * operations.
+ *
+ */
+
+#ifndef _SYS_WAITQ_H
+#define _SYS_WAITQ_H
+
+#include <stdint.h>
+
+// No deadline
+#define WAITQ_FOREVER 0xffffffffffffffffULL
+
+typedef struct waitq_waiter {
+    struct waitq_waiter *next;
+    struct waitq_waiter **pprev;  ///< Link that points to this waiter, NULL if not queued
+
+    void *thread;                 ///< Thread to wake up, or the wake up of the waiter
+    uint8_t woken;                ///< The waiter was woken up
+} waitq_waiter_t;
+
+typedef struct {
+    waitq_waiter_t *head;
+    waitq_waiter_t **tail;
+
+    uint32_t waiters;     ///< Threads in the queue
+    uint32_t wakeups;     ///< Waiters woken up
+    uint32_t timeouts;    ///< Waits that reached the deadline
+    uint32_t spurious;    ///< Early returns of the block operation
+} waitq_t;
+
+typedef struct {
+    void (*lock)(void *lock);        ///< Take the queue lock
+    void (*unlock)(void *lock);      ///< Release the queue lock
+    void *(*self)(void);             ///< Current thread, or NULL if the caller sets the
+                                     ///< thread of the waiter before waitq_prepare
+    void (*wake)(void *thread);      ///< Wake up a thread, called with the queue lock taken
+    void (*block)(void *thread, uint64_t timeout); ///< Block the current thread (the thread of
+                                     ///< its waiter) until it is woken up, or for timeout
+                                     ///< usecs (WAITQ_FOREVER for no timeout)
+    uint64_t (*now)(void);           ///< Monotonic time, in usecs
+} waitq_ops_t;
+
+/**
+ * @brief Initialize a queue.
+ *
+ * @param queue Queue.
+ */
+void waitq_init(waitq_t *queue);
+
+/**
+ * @brief Queue the current thread, at the end of the queue.
+ *
+ * @param ops Queue operations.
+ * @param lock Queue lock, passed to the operations.
+ * @param queue Queue.
+ * @param waiter Waiter of the current thread, valid until waitq_wait returns.
+ *               If ops->self is NULL, waiter->thread must be set before.
+ */
+void waitq_prepare(const waitq_ops_t *ops, void *lock, waitq_t *queue, waitq_waiter_t *waiter);
+
+/**
+ * @brief Wait until the waiter is woken up, or the deadline is reached. The
+ *        waiter must be queued with waitq_prepare before.
+ *
+ * @param ops Queue operations.
+ * @param lock Queue lock, passed to the operations.
+ * @param queue Queue.
+ * @param waiter Waiter of the current thread.
+ * @param deadline Deadline, in usecs of the ops->now clock, or WAITQ_FOREVER.
+ *
+ * @return 0 if the waiter was woken up, -1 if the deadline was reached (the
+ *         waiter is removed from the queue).
+ */
+int waitq_wait(const waitq_ops_t *ops, void *lock, waitq_t *queue, waitq_waiter_t *waiter, uint64_t deadline);
+
+/**
+ * @brief Wake up the oldest waiter of a queue.
+ *
+ * @param ops Queue operations.
+ * @param lock Queue lock, passed to the operations.
+ * @param queue Queue.
+ *
+ * @return 1 if a waiter was woken up, 0 if the queue is empty.
+ */
+int waitq_wake_one(const waitq_ops_t *ops, void *lock, waitq_t *queue);
+
+/**
+ * @brief Wake up all the waiters of a queue, in arrival order.
+ *
+ * @param ops Queue operations.
+ * @param lock Queue lock, passed to the operations.
+ * @param queue Queue.
+ *
+ * @return Number of waiters woken up.
+ */
+int waitq_wake_all(const waitq_ops_t *ops, void *lock, waitq_t *queue);
+
+#endif /* _SYS_WAITQ_H */
@@ -0,0 +1,582 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, windowed file transfer
+ *
+ */
+
+#include <sys/xfer.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <zlib.h>
+
+// Frames are deflated as raw streams, with a 1 Kb window, that is enough
+// for the largest frame
+#define XFER_DEFLATE_BITS 10
+
+typedef struct {
+    const xfer_ops_t *ops;
+    const xfer_config_t *config;
+    xfer_stats_t *stats;
+
+    // Link input, and frame parser
+    uint8_t rx[128];
+    int rx_pos;
+    int rx_len;
+    int frame_len;
+
+    // Last frame received
+    uint8_t type;
+    uint16_t len;
+    uint32_t offset;
+    uint8_t *payload;
+
+    uint8_t *in;     ///< Frame being received
+    uint8_t *out;    ///< Frame being sent
+    uint8_t *data;   ///< File data of a frame
+
+    z_stream z;
+    int deflate;     ///< 1 deflating, -1 inflating, 0 none
+} xfer_t;
+
+/*
+ * Helper functions
+ */
+
+static void put16(uint8_t *buf, uint16_t value) {
+    buf[0] = value & 0xff;
+    buf[1] = value >> 8;
+}
+
+static void put32(uint8_t *buf, uint32_t value) {
+    buf[0] = value & 0xff;
+    buf[1] = (value >> 8) & 0xff;
+    buf[2] = (value >> 16) & 0xff;
+    buf[3] = value >> 24;
+}
+
+static uint16_t get16(const uint8_t *buf) {
+    return buf[0] | (buf[1] << 8);
+}
+
+static uint32_t get32(const uint8_t *buf) {
+    return buf[0] | (buf[1] << 8) | (buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+static uint32_t now(xfer_t *x) {
+    return x->ops->now(x->ops->arg);
+}
+
+static int start(xfer_t *x, const xfer_ops_t *ops, const xfer_config_t *config, xfer_stats_t *stats) {
+    memset(x, 0, sizeof(xfer_t));
+    memset(stats, 0, sizeof(xfer_stats_t));
+
+    x->ops = ops;
+    x->config = config;
+    x->stats = stats;
+
+    x->in = malloc(2 * (XFER_OVERHEAD + XFER_MAX_FRAME) + XFER_MAX_FRAME);
+    if (!x->in) {
+        return XFER_ERR_NOMEM;
+    }
+
+    x->out = x->in + XFER_OVERHEAD + XFER_MAX_FRAME;
+    x->data = x->out + XFER_OVERHEAD + XFER_MAX_FRAME;
+
+    stats->elapsed = now(x);
+
+    return XFER_OK;
+}
+
+static int finish(xfer_t *x, int res) {
+    if (x->deflate > 0) {
+        deflateEnd(&x->z);
+    } else if (x->deflate < 0) {
+        inflateEnd(&x->z);
+    }
+
+    free(x->in);
+
+    x->stats->elapsed = now(x) - x->stats->elapsed;
+
+    return res;
+}
+
+static void send_frame(xfer_t *x, uint8_t type, uint32_t offset, const uint8_t *payload, uint16_t len) {
+    uint8_t *frame = x->out;
+
+    frame[0] = XFER_SYNC;
+    frame[1] = type;
+    put16(&frame[2], len);
+    put32(&frame[4], offset);
+
+    if (len && (payload != &frame[XFER_HEADER_SIZE])) {
+        memcpy(&frame[XFER_HEADER_SIZE], payload, len);
+    }
+
+    put32(&frame[XFER_HEADER_SIZE + len], crc32(0, &frame[1], XFER_HEADER_SIZE - 1 + len));
+
+    x->ops->write(x->ops->arg, frame, XFER_OVERHEAD + len);
+}
+
+// Send the file data in x->data as a DATA frame, or as a DATA_Z frame if
+// it deflates to less bytes
+static void send_data(xfer_t *x, uint32_t offset, int len) {
+    uint8_t *payload = &x->out[XFER_HEADER_SIZE];
+
+    if (x->deflate > 0) {
+        deflateReset(&x->z);
+
+        x->z.next_in = x->data;
+        x->z.avail_in = len;
+        x->z.next_out = payload;
+        x->z.avail_out = len - 1;
+
+        if (deflate(&x->z, Z_FINISH) == Z_STREAM_END) {
+            send_frame(x, XFER_DATA_Z, offset, payload, x->z.total_out);
+            x->stats->wire_bytes += XFER_OVERHEAD + x->z.total_out;
+            return;
+        }
+    }
+
+    send_frame(x, XFER_DATA, offset, x->data, len);
+    x->stats->wire_bytes += XFER_OVERHEAD + len;
+}
+
+// Add a byte to the frame being received. Returns 1 when a frame is
+// complete, and its CRC is right.
+static int parse(xfer_t *x, uint8_t byte) {
+    uint8_t *frame = x->in;
+    uint16_t len;
+
+    if (!x->frame_len && (byte != XFER_SYNC)) {
+        return 0;
+    }
+
+    frame[x->frame_len++] = byte;
+    if (x->frame_len < XFER_HEADER_SIZE) {
+        return 0;
+    }
+
+    len = get16(&frame[2]);
+    if (len > XFER_MAX_FRAME) {
+        // Not a frame, look for the next sync
+        x->frame_len = 0;
+        return 0;
+    }
+
+    if (x->frame_len < XFER_OVERHEAD + len) {
+        return 0;
+    }
+
+    x->frame_len = 0;
+
+    if (crc32(0, &frame[1], XFER_HEADER_SIZE - 1 + len) != get32(&frame[XFER_HEADER_SIZE + len])) {
+        x->stats->crc_errors++;
+        return 0;
+    }
+
+    x->type = frame[1];
+    x->len = len;
+    x->offset = get32(&frame[4]);
+    x->payload = &frame[XFER_HEADER_SIZE];
+
+    return 1;
+}
+
+// Wait for a frame until deadline. Returns the frame type, or 0 if the
+// deadline was reached.
+static int recv_frame(xfer_t *x, uint32_t deadline) {
+    int32_t remaining;
+
+    for(;;) {
+        while (x->rx_pos < x->rx_len) {
+            if (parse(x, x->rx[x->rx_pos++])) {
+                return x->type;
+            }
+        }
+
+        remaining = (int32_t)(deadline - now(x));
+        if (remaining <= 0) {
+            return 0;
+        }
+
+        x->rx_pos = 0;
+        x->rx_len = x->ops->read(x->ops->arg, x->rx, sizeof(x->rx), remaining);
+        if (x->rx_len < 0) {
+            x->rx_len = 0;
+        }
+    }
+}
+
+// Stay after the END echo, until the sender is silent for two timeouts,
+// echoing the END frame again to the frames that the sender sends again,
+// in case the echo was lost
+static void linger(xfer_t *x, uint32_t size) {
+    uint32_t deadline = now(x) + 2 * x->config->timeout;
+
+    for(;;) {
+        switch (recv_frame(x, deadline)) {
+            case XFER_DATA:
+            case XFER_DATA_Z:
+            case XFER_END:
+                send_frame(x, XFER_END, size, NULL, 0);
+                deadline = now(x) + 2 * x->config->timeout;
+                break;
+
+            case XFER_ABORT:
+            case 0:
+                return;
+        }
+    }
+}
+
+/*
+ * Operation functions
+ */
+
+void xfer_config_default(xfer_config_t *config) {
+    config->frame_size = 256;
+    config->window = 4;
+    config->deflate = 0;
+    config->timeout = 1000;
+    config->retries = 10;
+}
+
+int xfer_send(const xfer_ops_t *ops, const xfer_config_t *config, xfer_stats_t *stats) {
+    uint32_t frame_size = config->frame_size;
+    xfer_stats_t tmp_stats;
+    xfer_t x;
+    uint32_t base, next, sent, size, last, window;
+    int end_sent = 0;
+    int eof = 0;
+    int tries = 0;
+    int type;
+    int res;
+    int len;
+
+    if ((res = start(&x, ops, config, stats?stats:&tmp_stats)) != XFER_OK) {
+        return res;
+    }
+
+    // Wait for the receiver
+    for(;;) {
+        type = recv_frame(&x, now(&x) + config->timeout);
+        if (type == XFER_READY) {
+            break;
+        } else if (type == XFER_ABORT) {
+            return finish(&x, XFER_ERR_ABORTED);
+        } else if (!type && (++tries > config->retries)) {
+            return finish(&x, XFER_ERR_TIMEOUT);
+        }
+    }
+
+    // Don't exceed what the receiver can buffer
+    window = config->window;
+    if (x.len >= 4) {
+        if (x.payload[0] < window) {
+            window = x.payload[0];
+        }
+
+        if (get16(&x.payload[2]) < frame_size) {
+            frame_size = get16(&x.payload[2]);
+        }
+    }
+
+    if (!window) {
+        window = 1;
+    }
+
+    if (!frame_size || (frame_size > XFER_MAX_FRAME)) {
+        frame_size = XFER_MAX_FRAME;
+    }
+
+    if (config->deflate && (x.len >= 4) && (x.payload[1] & XFER_F_DEFLATE)) {
+        if (deflateInit2(&x.z, Z_BEST_SPEED, Z_DEFLATED, -XFER_DEFLATE_BITS, 2, Z_DEFAULT_STRATEGY) != Z_OK) {
+            send_frame(&x, XFER_ABORT, 0, NULL, 0);
+            return finish(&x, XFER_ERR_NOMEM);
+        }
+
+        x.deflate = 1;
+    }
+
+    base = next = sent = size = x.offset;
+    x.stats->offset = x.offset;
+
+    last = now(&x);
+    tries = 0;
+
+    for(;;) {
+        // Fill the window
+        while (!end_sent && (next - base < window * frame_size)) {
+            if (eof && (next == size)) {
+                send_frame(&x, XFER_END, size, NULL, 0);
+                end_sent = 1;
+                break;
+            }
+
+            len = ops->file_read(ops->arg, next, x.data, frame_size);
+            if (len < 0) {
+                send_frame(&x, XFER_ABORT, next, NULL, 0);
+                return finish(&x, XFER_ERR_FILE);
+            }
+
+            if (len == 0) {
+                eof = 1;
+                size = next;
+                continue;
+            }
+
+            send_data(&x, next, len);
+
+            if (next < sent) {
+                x.stats->retransmissions++;
+            } else {
+                x.stats->frames++;
+            }
+
+            next += len;
+            if (next > sent) {
+                sent = next;
+            }
+        }
+
+        type = recv_frame(&x, last + config->timeout);
+        switch (type) {
+            case XFER_ACK:
+                if ((x.offset > base) && (x.offset <= sent)) {
+                    base = x.offset;
+                    if (next < base) {
+                        next = base;
+                    }
+
+                    last = now(&x);
+                    tries = 0;
+                }
+                break;
+
+            case XFER_NAK:
+            case XFER_READY:
+                // Go back to the offset that the receiver expects
+                if ((x.offset >= base) && (x.offset <= sent)) {
+                    base = next = x.offset;
+                    end_sent = 0;
+
+                    last = now(&x);
+                    tries = 0;
+                }
+                break;
+
+            case XFER_END:
+                // The echo can come after a timeout, when the sender is
+                // sending again, or be an echo of an END sent again
+                if (eof && (x.offset == size)) {
+                    x.stats->size = size;
+                    return finish(&x, XFER_OK);
+                }
+                break;
+
+            case XFER_ABORT:
+                return finish(&x, XFER_ERR_ABORTED);
+
+            case 0:
+                if (++tries > config->retries) {
+                    send_frame(&x, XFER_ABORT, base, NULL, 0);
+                    return finish(&x, XFER_ERR_TIMEOUT);
+                }
+
+                // Nothing acknowledged, go back to the last acknowledged
+                // offset
+                next = base;
+                end_sent = 0;
+                last = now(&x);
+                break;
+        }
+    }
+}
+
+int xfer_receive(const xfer_ops_t *ops, const xfer_config_t *config, uint32_t offset, xfer_stats_t *stats) {
+    xfer_stats_t tmp_stats;
+    uint8_t ready[4];
+    xfer_t x;
+    uint32_t expected = offset;
+    uint32_t last;
+    const uint8_t *data;
+    int started = 0;
+    int nak_sent = 0;
+    int tries = 0;
+    int res;
+    int len;
+
+    if ((res = start(&x, ops, config, stats?stats:&tmp_stats)) != XFER_OK) {
+        return res;
+    }
+
+    if (inflateInit2(&x.z, -XFER_DEFLATE_BITS) != Z_OK) {
+        send_frame(&x, XFER_ABORT, 0, NULL, 0);
+        return finish(&x, XFER_ERR_NOMEM);
+    }
+
+    x.deflate = -1;
+    x.stats->offset = offset;
+
+    ready[0] = config->window;
+    ready[1] = XFER_F_DEFLATE;
+    put16(&ready[2], config->frame_size);
+    send_frame(&x, XFER_READY, offset, ready, sizeof(ready));
+
+    last = now(&x);
+
+    for(;;) {
+        switch (recv_frame(&x, last + config->timeout)) {
+            case XFER_DATA:
+            case XFER_DATA_Z:
+                started = 1;
+                last = now(&x);
+                tries = 0;
+
+                if (x.offset != expected) {
+                    if (x.offset > expected) {
+                        // A frame was lost, ask for it once
+                        if (!nak_sent) {
+                            send_frame(&x, XFER_NAK, expected, NULL, 0);
+                            nak_sent = 1;
+                        }
+                    } else {
+                        // Sent again, the acknowledge was lost
+                        send_frame(&x, XFER_ACK, expected, NULL, 0);
+                    }
+
+                    break;
+                }
+
+                data = x.payload;
+                len = x.len;
+
+                if (x.type == XFER_DATA_Z) {
+                    inflateReset(&x.z);
+
+                    x.z.next_in = x.payload;
+                    x.z.avail_in = x.len;
+                    x.z.next_out = x.data;
+                    x.z.avail_out = XFER_MAX_FRAME;
+
+                    if (inflate(&x.z, Z_FINISH) != Z_STREAM_END) {
+                        x.stats->crc_errors++;
+                        if (!nak_sent) {
+                            send_frame(&x, XFER_NAK, expected, NULL, 0);
+                            nak_sent = 1;
+                        }
+
+                        break;
+                    }
+
+                    data = x.data;
+                    len = x.z.total_out;
+                }
+
+                if (ops->file_write(ops->arg, expected, data, len) < 0) {
+                    send_frame(&x, XFER_ABORT, expected, NULL, 0);
+                    return finish(&x, XFER_ERR_FILE);
+                }
+
+                x.stats->frames++;
+                x.stats->wire_bytes += XFER_OVERHEAD + x.len;
+
+                expected += len;
+                nak_sent = 0;
+
+                send_frame(&x, XFER_ACK, expected, NULL, 0);
+                break;
+
+            case XFER_END:
+                started = 1;
+                last = now(&x);
+                tries = 0;
+
+                if (x.offset == expected) {
+                    send_frame(&x, XFER_END, expected, NULL, 0);
+                    x.stats->size = expected;
+                    linger(&x, expected);
+                    return finish(&x, XFER_OK);
+                } else if ((x.offset > expected) && !nak_sent) {
+                    send_frame(&x, XFER_NAK, expected, NULL, 0);
+                    nak_sent = 1;
+                }
+                break;
+
+            case XFER_ABORT:
+                return finish(&x, XFER_ERR_ABORTED);
+
+            case 0:
+                if (++tries > config->retries) {
+                    send_frame(&x, XFER_ABORT, expected, NULL, 0);
+                    return finish(&x, XFER_ERR_TIMEOUT);
+                }
+
+                // Tell again where to go on from, the last frame sent can
+                // be lost
+                if (started) {
+                    send_frame(&x, XFER_ACK, expected, NULL, 0);
+                } else {
+                    send_frame(&x, XFER_READY, expected, ready, sizeof(ready));
+                }
+
+                nak_sent = 0;
+                last = now(&x);
+                break;
+        }
+    }
+}
+
+const char *xfer_error(int error) {
+    switch (error) {
+        case XFER_OK:           return "no error";
+        case XFER_ERR_TIMEOUT:  return "timeout";
+        case XFER_ERR_ABORTED:  return "aborted by the other side";
+        case XFER_ERR_FILE:     return "file error";
+        case XFER_ERR_NOMEM:    return "not enough memory";
+    }
+
+    return "unknown error";
+}
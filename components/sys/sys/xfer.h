@@ -0,0 +1,190 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, windowed file transfer
+ *
+ * Moves a file over a serial link. The data is sent in frames, and each
+ * frame carries the file offset of its data and a CRC32. The sender keeps
+ * up to a window of frames in flight, instead of waiting for an
+ * acknowledge after each one, so the transfer is limited by the link
+ * speed and not by its round trip time.
+ *
+ * Frame format (little endian):
+ *
+ *   0  sync (XFER_SYNC)
+ *   1  type
+ *   2  payload length (16 bits)
+ *   4  offset (32 bits)
+ *   8  payload
+ *   .  CRC32 of type, length, offset, and payload
+ *
+ * Bytes out of a frame, and frames with a bad CRC, are discarded.
+ *
+ * The receiver starts the transfer with a READY frame, that has the
+ * offset to start from (the bytes it already has, to resume an
+ * interrupted transfer), and a payload with its window (1 byte), its flags
+ * (1 byte), and its largest frame (16 bits). Then:
+ *
+ *   - The sender sends DATA frames (or DATA_Z frames, with the data
+ *     deflated) while it has less than a window of frames not acknowledged,
+ *     and an END frame at the end of the file.
+ *   - The receiver accepts the frames in order, and acknowledges each one
+ *     with an ACK frame that has the next offset it expects. The first time
+ *     it gets a frame past that offset (a frame was lost), it sends a NAK
+ *     frame with the offset it expects, and the sender goes back to it.
+ *   - If nothing is acknowledged in a timeout, the sender goes back to the
+ *     last acknowledged offset.
+ *   - The receiver echoes the END frame when it has all the data. As the
+ *     echo can be lost, the receiver echoes the frames sent again until the
+ *     sender is silent for two timeouts, and the sender takes any echo of
+ *     the END frame as the end of the transfer.
+ *
+ * Any side can cancel the transfer with an ABORT frame.
+ *
+ * DATA_Z frames are raw deflate streams (RFC 1951), each one independent
+ * of the others, so they can be sent again in any order.
+ *
+ * The transfer doesn't depend on the OS: the link, the file, and the
+ * clock are passed as a set of operations.
+ *
+ */
+
+#ifndef _SYS_XFER_H
+#define _SYS_XFER_H
+
+#include <stdint.h>
+
+#define XFER_SYNC        0xa5
+#define XFER_HEADER_SIZE 8
+#define XFER_OVERHEAD    (XFER_HEADER_SIZE + 4)
+
+// Largest payload of a frame
+#define XFER_MAX_FRAME   1024
+
+// Frame types
+#define XFER_READY  'R'
+#define XFER_DATA   'D'
+#define XFER_DATA_Z 'Z'
+#define XFER_ACK    'A'
+#define XFER_NAK    'N'
+#define XFER_END    'E'
+#define XFER_ABORT  'X'
+
+// READY flags
+#define XFER_F_DEFLATE 0x01  ///< The receiver accepts DATA_Z frames
+
+// Errors
+#define XFER_OK            0
+#define XFER_ERR_TIMEOUT  -1  ///< No answer after all the retries
+#define XFER_ERR_ABORTED  -2  ///< Cancelled by the other side
+#define XFER_ERR_FILE     -3  ///< File read / write error
+#define XFER_ERR_NOMEM    -4
+
+typedef struct {
+    int  (*read)(void *arg, uint8_t *buf, int len, uint32_t timeout); ///< Read up to len bytes from the link, waiting up to
+                                                                      ///< timeout msecs for the first one. Returns the bytes read.
+    void (*write)(void *arg, const uint8_t *buf, int len);           ///< Write to the link
+    int  (*file_read)(void *arg, uint32_t offset, uint8_t *buf, int len);        ///< Bytes read, 0 at the end, -1 on error
+    int  (*file_write)(void *arg, uint32_t offset, const uint8_t *buf, int len); ///< 0, or -1 on error
+    uint32_t (*now)(void *arg);                                       ///< Current time, in msecs
+    void *arg;
+} xfer_ops_t;
+
+typedef struct {
+    uint16_t frame_size;   ///< Data in a frame, up to XFER_MAX_FRAME
+    uint8_t  window;       ///< Frames in flight (for the receiver, the frames it can buffer)
+    uint8_t  deflate;      ///< Sender: deflate the frames, if the receiver accepts it
+    uint32_t timeout;      ///< Retransmission timeout, in msecs
+    uint8_t  retries;      ///< Timeouts in a row before giving up
+} xfer_config_t;
+
+typedef struct {
+    uint32_t offset;           ///< Offset the transfer started from
+    uint32_t size;             ///< File size, when the transfer is done
+    uint32_t frames;           ///< Data frames sent / accepted
+    uint32_t retransmissions;  ///< Sender: frames sent again
+    uint32_t crc_errors;       ///< Frames discarded for a bad CRC
+    uint32_t wire_bytes;       ///< Bytes of the data frames sent / accepted
+    uint32_t elapsed;          ///< In msecs
+} xfer_stats_t;
+
+/**
+ * @brief Set a configuration to the default values.
+ *
+ * @param config Configuration.
+ */
+void xfer_config_default(xfer_config_t *config);
+
+/**
+ * @brief Send a file. The transfer starts when the READY frame of the
+ *        receiver arrives.
+ *
+ * @param ops Link, file and clock operations.
+ * @param config Configuration.
+ * @param stats Statistics of the transfer, can be NULL.
+ *
+ * @return XFER_OK, or an error code.
+ */
+int xfer_send(const xfer_ops_t *ops, const xfer_config_t *config, xfer_stats_t *stats);
+
+/**
+ * @brief Receive a file.
+ *
+ * @param ops Link, file and clock operations.
+ * @param config Configuration.
+ * @param offset Bytes of the file that the receiver has, the transfer
+ *               goes on from this offset.
+ * @param stats Statistics of the transfer, can be NULL.
+ *
+ * @return XFER_OK, or an error code.
+ */
+int xfer_receive(const xfer_ops_t *ops, const xfer_config_t *config, uint32_t offset, xfer_stats_t *stats);
+
+/**
+ * @brief Get the message of an error code.
+ *
+ * @param error Error code.
+ *
+ * @return Message.
+ */
+const char *xfer_error(int error);
+
+#endif /* _SYS_XFER_H */
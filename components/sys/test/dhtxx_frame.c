@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, DHT sensors frame decoder test cases
+ *
+ */
+
+#include "unity.h"
+
+#include <string.h>
+#include <stdint.h>
+
+#include <sys/sensors/dhtxx_frame.h>
+
+#define ITEM(d0, l0, d1, l1) \
+	(((uint32_t)(d0) & 0x7fff) | ((uint32_t)(l0) << 15) | (((uint32_t)(d1) & 0x7fff) << 16) | ((uint32_t)(l1) << 31))
+
+// DHT22 capture: 65.2 %RH, 35.1 C
+static const uint32_t capture[] = {
+	ITEM(80, 0, 80, 1), ITEM(54, 0, 28, 1), ITEM(48, 0, 23, 1),
+	ITEM(56, 0, 23, 1), ITEM(53, 0, 27, 1), ITEM(48, 0, 27, 1),
+	ITEM(51, 0, 23, 1), ITEM(49, 0, 71, 1), ITEM(54, 0, 23, 1),
+	ITEM(51, 0, 68, 1), ITEM(56, 0, 26, 1), ITEM(48, 0, 29, 1),
+	ITEM(49, 0, 24, 1), ITEM(48, 0, 72, 1), ITEM(54, 0, 68, 1),
+	ITEM(51, 0, 23, 1), ITEM(56, 0, 29, 1), ITEM(50, 0, 25, 1),
+	ITEM(54, 0, 24, 1), ITEM(56, 0, 23, 1), ITEM(52, 0, 27, 1),
+	ITEM(50, 0, 23, 1), ITEM(51, 0, 25, 1), ITEM(49, 0, 27, 1),
+	ITEM(49, 0, 72, 1), ITEM(48, 0, 27, 1), ITEM(51, 0, 71, 1),
+	ITEM(56, 0, 26, 1), ITEM(53, 0, 71, 1), ITEM(55, 0, 70, 1),
+	ITEM(52, 0, 69, 1), ITEM(50, 0, 73, 1), ITEM(51, 0, 68, 1),
+	ITEM(52, 0, 72, 1), ITEM(55, 0, 70, 1), ITEM(55, 0, 70, 1),
+	ITEM(49, 0, 23, 1), ITEM(56, 0, 71, 1), ITEM(50, 0, 74, 1),
+	ITEM(53, 0, 69, 1), ITEM(55, 0, 26, 1), ITEM(48, 0, 0, 1),
+};
+
+#define CAPTURE_ITEMS (sizeof(capture) / sizeof(uint32_t))
+
+static const uint8_t expected[5] = {0x02, 0x8c, 0x01, 0x5f, 0xee};
+
+TEST_CASE("dhtxx frame decode", "[dhtxx]") {
+	uint8_t data[5];
+
+	TEST_ASSERT_EQUAL(DHTXX_FRAME_OK, dhtxx_frame_decode(capture, CAPTURE_ITEMS, data));
+	TEST_ASSERT_EQUAL_MEMORY(expected, data, 5);
+
+	// Response pulse not captured
+	TEST_ASSERT_EQUAL(DHTXX_FRAME_OK, dhtxx_frame_decode(&capture[1], CAPTURE_ITEMS - 1, data));
+	TEST_ASSERT_EQUAL_MEMORY(expected, data, 5);
+}
+
+TEST_CASE("dhtxx frame with request pulse", "[dhtxx]") {
+	uint32_t items[CAPTURE_ITEMS + 1];
+	uint8_t data[5];
+
+	// End of the host's request pulse, and the 40 us release, captured
+	// before the response
+	items[0] = ITEM(18000, 0, 40, 1);
+	memcpy(&items[1], capture, sizeof(capture));
+
+	TEST_ASSERT_EQUAL(DHTXX_FRAME_OK, dhtxx_frame_decode(items, CAPTURE_ITEMS + 1, data));
+	TEST_ASSERT_EQUAL_MEMORY(expected, data, 5);
+}
+
+TEST_CASE("dhtxx frame errors", "[dhtxx]") {
+	uint32_t items[CAPTURE_ITEMS];
+	uint8_t data[5];
+
+	// Capture ends before the last bits
+	memcpy(items, capture, sizeof(capture));
+	items[30] = ITEM(50, 0, 0, 1);
+	TEST_ASSERT_EQUAL(DHTXX_FRAME_TRUNCATED, dhtxx_frame_decode(items, CAPTURE_ITEMS, data));
+
+	// No response
+	TEST_ASSERT_EQUAL(DHTXX_FRAME_TRUNCATED, dhtxx_frame_decode(items, 0, data));
+
+	// A 0 read as a 1
+	memcpy(items, capture, sizeof(capture));
+	items[2] = ITEM(48, 0, 70, 1);
+	TEST_ASSERT_EQUAL(DHTXX_FRAME_CRC, dhtxx_frame_decode(items, CAPTURE_ITEMS, data));
+
+	// A glitch in the middle of the frame
+	memcpy(items, capture, sizeof(capture));
+	items[20] = ITEM(52, 0, 400, 1);
+	TEST_ASSERT_EQUAL(DHTXX_FRAME_TRUNCATED, dhtxx_frame_decode(items, CAPTURE_ITEMS, data));
+}
@@ -0,0 +1,308 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, DNS cache test cases
+ *
+ */
+
+#include "unity.h"
+
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <sys/drivers/dns_cache.h>
+
+#define ADDR(a, b, c, d) ((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+
+#define SHARED_LOOKUPS 4
+
+// Stub resolver, and fake clock
+static pthread_mutex_t mtx = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+static uint64_t now_ms;
+static int queries;
+static dns_cache_t cache;
+static dns_cache_entry_t entry[2];
+
+static int stub_resolve(void *arg, const char *name, uint32_t *addr, uint32_t *ttl) {
+	queries++;
+
+	if (!strcmp(name, "nx.com")) {
+		return DNS_CACHE_NOT_FOUND;
+	}
+
+	if (!strcmp(name, "down.com")) {
+		return DNS_CACHE_ERROR;
+	}
+
+	*addr = ADDR(10, 0, 0, name[0]);
+	*ttl = !strcmp(name, "long.com") ? 100000 : 60;
+
+	return DNS_CACHE_OK;
+}
+
+// Waits until the other lookups are waiting for this query
+static int slow_resolve(void *arg, const char *name, uint32_t *addr, uint32_t *ttl) {
+	int waiting;
+	int i;
+
+	queries++;
+
+	for(i = 0; i < 1000; i++) {
+		pthread_mutex_lock(&mtx);
+		waiting = cache.shared;
+		pthread_mutex_unlock(&mtx);
+
+		if (waiting >= SHARED_LOOKUPS - 1) {
+			break;
+		}
+
+		usleep(1000);
+	}
+
+	*addr = ADDR(10, 0, 0, 1);
+	*ttl = 60;
+
+	return DNS_CACHE_OK;
+}
+
+static uint64_t stub_now(void *arg) {
+	return now_ms;
+}
+
+static void stub_lock(void *arg) {
+	pthread_mutex_lock(&mtx);
+}
+
+static void stub_unlock(void *arg) {
+	pthread_mutex_unlock(&mtx);
+}
+
+static void stub_wait(void *arg) {
+	pthread_cond_wait(&cond, &mtx);
+}
+
+static void stub_notify(void *arg) {
+	pthread_cond_broadcast(&cond);
+}
+
+static const dns_cache_ops_t stub_ops = {
+	stub_resolve, stub_now, stub_lock, stub_unlock, stub_wait, stub_notify
+};
+
+static const dns_cache_ops_t slow_ops = {
+	slow_resolve, stub_now, stub_lock, stub_unlock, stub_wait, stub_notify
+};
+
+static int lookup(const char *name, uint32_t *addr) {
+	*addr = 0;
+
+	return dns_cache_lookup(&cache, name, addr);
+}
+
+static void *lookup_thread(void *arg) {
+	uint32_t addr;
+
+	*(int *)arg = (lookup("a.com", &addr) == DNS_CACHE_OK) && (addr == ADDR(10, 0, 0, 1));
+
+	return NULL;
+}
+
+TEST_CASE("dns cache ttl", "[dns_cache]") {
+	uint32_t addr;
+
+	now_ms = 0xfffff000; // Crosses 2^32 during the test
+	queries = 0;
+	dns_cache_init(&cache, entry, 2, 3600, 10, &stub_ops, NULL);
+
+	// Cached for the TTL of the record
+	TEST_ASSERT_EQUAL(DNS_CACHE_OK, lookup("a.com", &addr));
+	TEST_ASSERT_EQUAL_HEX32(ADDR(10, 0, 0, 'a'), addr);
+	now_ms += 59000;
+	TEST_ASSERT_EQUAL(DNS_CACHE_OK, lookup("A.com", &addr));
+	TEST_ASSERT_EQUAL_HEX32(ADDR(10, 0, 0, 'a'), addr);
+	TEST_ASSERT_EQUAL(1, queries);
+
+	now_ms += 1000;
+	TEST_ASSERT_EQUAL(DNS_CACHE_OK, lookup("a.com", &addr));
+	TEST_ASSERT_EQUAL(2, queries);
+
+	// Names not found are cached for the negative TTL
+	TEST_ASSERT_EQUAL(DNS_CACHE_NOT_FOUND, lookup("nx.com", &addr));
+	now_ms += 9000;
+	TEST_ASSERT_EQUAL(DNS_CACHE_NOT_FOUND, lookup("nx.com", &addr));
+	TEST_ASSERT_EQUAL(3, queries);
+	now_ms += 1000;
+	TEST_ASSERT_EQUAL(DNS_CACHE_NOT_FOUND, lookup("nx.com", &addr));
+	TEST_ASSERT_EQUAL(4, queries);
+
+	// Temporary failures are not cached
+	TEST_ASSERT_EQUAL(DNS_CACHE_ERROR, lookup("down.com", &addr));
+	TEST_ASSERT_EQUAL(DNS_CACHE_ERROR, lookup("down.com", &addr));
+	TEST_ASSERT_EQUAL(6, queries);
+
+	// Long TTLs are limited
+	dns_cache_flush(&cache, NULL);
+	TEST_ASSERT_EQUAL(DNS_CACHE_OK, lookup("long.com", &addr));
+	now_ms += 3599000;
+	TEST_ASSERT_EQUAL(DNS_CACHE_OK, lookup("long.com", &addr));
+	TEST_ASSERT_EQUAL(7, queries);
+	now_ms += 1000;
+	TEST_ASSERT_EQUAL(DNS_CACHE_OK, lookup("long.com", &addr));
+	TEST_ASSERT_EQUAL(8, queries);
+
+	// Flush
+	dns_cache_flush(&cache, "LONG.com");
+	TEST_ASSERT_EQUAL(DNS_CACHE_OK, lookup("long.com", &addr));
+	TEST_ASSERT_EQUAL(9, queries);
+
+	// The least recently used name is replaced
+	TEST_ASSERT_EQUAL(DNS_CACHE_OK, lookup("b.com", &addr));
+	now_ms += 1000;
+	TEST_ASSERT_EQUAL(DNS_CACHE_OK, lookup("long.com", &addr));
+	TEST_ASSERT_EQUAL(DNS_CACHE_OK, lookup("c.com", &addr));
+	TEST_ASSERT_EQUAL(11, queries);
+	TEST_ASSERT_EQUAL(DNS_CACHE_OK, lookup("long.com", &addr));
+	TEST_ASSERT_EQUAL(11, queries);
+	TEST_ASSERT_EQUAL(DNS_CACHE_OK, lookup("b.com", &addr));
+	TEST_ASSERT_EQUAL(12, queries);
+
+	// Names too long are not cached
+	TEST_ASSERT_EQUAL(DNS_CACHE_OK, lookup("a234567890123456789012345678901234567890123456789012345678901234.com", &addr));
+	TEST_ASSERT_EQUAL(DNS_CACHE_OK, lookup("a234567890123456789012345678901234567890123456789012345678901234.com", &addr));
+	TEST_ASSERT_EQUAL(14, queries);
+
+	// Entries expire, even if they are not used for a long time
+	TEST_ASSERT_EQUAL(DNS_CACHE_OK, lookup("b.com", &addr));
+	TEST_ASSERT_EQUAL(14, queries);
+	now_ms += 25ULL * 24 * 3600 * 1000;
+	TEST_ASSERT_EQUAL(DNS_CACHE_OK, lookup("b.com", &addr));
+	TEST_ASSERT_EQUAL(15, queries);
+}
+
+TEST_CASE("dns cache shared query", "[dns_cache]") {
+	pthread_t thread[SHARED_LOOKUPS];
+	int ok[SHARED_LOOKUPS];
+	int i;
+
+	now_ms = 0;
+	queries = 0;
+	dns_cache_init(&cache, entry, 2, 3600, 10, &slow_ops, NULL);
+
+	for(i = 0; i < SHARED_LOOKUPS; i++) {
+		TEST_ASSERT_EQUAL(0, pthread_create(&thread[i], NULL, lookup_thread, &ok[i]));
+	}
+
+	for(i = 0; i < SHARED_LOOKUPS; i++) {
+		pthread_join(thread[i], NULL);
+		TEST_ASSERT_TRUE(ok[i]);
+	}
+
+	TEST_ASSERT_EQUAL(1, queries);
+	TEST_ASSERT_EQUAL(1, cache.misses);
+	TEST_ASSERT_EQUAL(SHARED_LOOKUPS - 1, cache.hits);
+}
+
+TEST_CASE("dns cache messages", "[dns_cache]") {
+	static const uint8_t query[] = {
+		0x12, 0x34, 0x01, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+		3, 'w', 'w', 'w', 7, 'e', 'x', 'a', 'm', 'p', 'l', 'e', 3, 'c', 'o', 'm', 0,
+		0x00, 0x01, 0x00, 0x01
+	};
+	// www.example.com CNAME example.com (TTL 300), example.com A 93.184.216.34 (TTL 3600)
+	static const uint8_t answer[] = {
+		0x12, 0x34, 0x81, 0x80, 0x00, 0x01, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00,
+		3, 'w', 'w', 'w', 7, 'e', 'x', 'a', 'm', 'p', 'l', 'e', 3, 'c', 'o', 'm', 0,
+		0x00, 0x01, 0x00, 0x01,
+		0xc0, 0x0c, 0x00, 0x05, 0x00, 0x01, 0x00, 0x00, 0x01, 0x2c, 0x00, 0x02, 0xc0, 0x10,
+		0xc0, 0x10, 0x00, 0x01, 0x00, 0x01, 0x00, 0x00, 0x0e, 0x10, 0x00, 0x04, 93, 184, 216, 34
+	};
+	uint8_t buffer[DNS_CACHE_QUERY_SIZE];
+	uint8_t modified[sizeof(answer)];
+	char name[80];
+	uint32_t addr, ttl;
+	int len;
+
+	len = dns_cache_query(buffer, 0x1234, "www.example.com");
+	TEST_ASSERT_EQUAL(sizeof(query), len);
+	TEST_ASSERT_EQUAL_MEMORY(query, buffer, sizeof(query));
+	TEST_ASSERT_EQUAL(sizeof(query), dns_cache_query(buffer, 0x1234, "www.example.com."));
+
+	TEST_ASSERT_EQUAL(-1, dns_cache_query(buffer, 1, ""));
+	TEST_ASSERT_EQUAL(-1, dns_cache_query(buffer, 1, "a..com"));
+	memset(name, 'a', 64);
+	strcpy(name + 64, ".com");
+	TEST_ASSERT_EQUAL(-1, dns_cache_query(buffer, 1, name));
+
+	TEST_ASSERT_EQUAL(DNS_CACHE_OK, dns_cache_answer(answer, sizeof(answer), 0x1234, "www.example.com", &addr, &ttl));
+	TEST_ASSERT_EQUAL_HEX32(ADDR(93, 184, 216, 34), addr);
+	TEST_ASSERT_EQUAL(300, ttl);
+
+	// Other query
+	TEST_ASSERT_EQUAL(DNS_CACHE_ERROR, dns_cache_answer(answer, sizeof(answer), 0x1235, "www.example.com", &addr, &ttl));
+
+	// Truncated
+	for(len = 0; len < sizeof(answer); len++) {
+		TEST_ASSERT_EQUAL(DNS_CACHE_ERROR, dns_cache_answer(answer, len, 0x1234, "www.example.com", &addr, &ttl));
+	}
+
+	// Name error, and server failure
+	memcpy(modified, answer, sizeof(answer));
+	modified[3] = 0x83;
+	TEST_ASSERT_EQUAL(DNS_CACHE_NOT_FOUND, dns_cache_answer(modified, sizeof(modified), 0x1234, "www.example.com", &addr, &ttl));
+	modified[3] = 0x82;
+	TEST_ASSERT_EQUAL(DNS_CACHE_ERROR, dns_cache_answer(modified, sizeof(modified), 0x1234, "www.example.com", &addr, &ttl));
+
+	// Answer to other name, or to other record type
+	TEST_ASSERT_EQUAL(DNS_CACHE_ERROR, dns_cache_answer(answer, sizeof(answer), 0x1234, "example.com", &addr, &ttl));
+	TEST_ASSERT_EQUAL(DNS_CACHE_ERROR, dns_cache_answer(answer, sizeof(answer), 0x1234, "www.example.co", &addr, &ttl));
+	TEST_ASSERT_EQUAL(DNS_CACHE_OK, dns_cache_answer(answer, sizeof(answer), 0x1234, "WWW.example.com.", &addr, &ttl));
+	memcpy(modified, answer, sizeof(answer));
+	modified[12 + 17 + 1] = 28;
+	TEST_ASSERT_EQUAL(DNS_CACHE_ERROR, dns_cache_answer(modified, sizeof(modified), 0x1234, "www.example.com", &addr, &ttl));
+
+	// Only the CNAME, no address
+	memcpy(modified, answer, sizeof(answer));
+	modified[7] = 1;
+	TEST_ASSERT_EQUAL(DNS_CACHE_NOT_FOUND, dns_cache_answer(modified, sizeof(modified), 0x1234, "www.example.com", &addr, &ttl));
+}
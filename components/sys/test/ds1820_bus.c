@@ -0,0 +1,428 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, DS1820 bus sweep test cases
+ *
+ * A simulated ONE WIRE bus, with DS1820 devices that answer to the ROM and
+ * function commands, and that accounts the time spent in the bus.
+ *
+ */
+
+#include "unity.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <sys/drivers/owire_slots.h>
+#include <sys/sensors/ds1820_bus.h>
+
+#define SIM_MAX_DEVICES 32
+
+#define SIM_RESET_US 960 // Reset + presence
+#define SIM_SLOT_US  70  // Read / write slot
+
+// Simulated device
+typedef struct {
+	uint8_t rom[8];
+	uint8_t scratchpad[9];
+	int parasite;
+	int corrupt;        // Corrupt the next N scratchpad reads
+	uint64_t ready;     // Time when conversion ends
+} sim_device_t;
+
+// Simulated bus
+typedef struct {
+	sim_device_t dev[SIM_MAX_DEVICES];
+	int count;
+
+	uint64_t us;        // Elapsed time
+	int selected;       // Selected device, -1 all, -2 none
+	int state;          // 0: ROM command, 1: match ROM, 2: function command, 3: read scratchpad, 4: read power supply
+	uint8_t match[8];
+	int pos;
+	int power;
+	int converts;       // Number of Convert T commands received
+	int scratchpads;    // Number of scratchpad reads
+} sim_bus_t;
+
+static void sim_add(sim_bus_t *bus, uint8_t family, uint8_t serial, uint16_t raw, uint8_t res) {
+	sim_device_t *dev = &bus->dev[bus->count++];
+
+	memset(dev, 0, sizeof(sim_device_t));
+
+	dev->rom[0] = family;
+	dev->rom[1] = serial;
+	dev->rom[7] = owire_crc8(dev->rom, 7);
+
+	dev->scratchpad[0] = raw & 0xff;
+	dev->scratchpad[1] = raw >> 8;
+	dev->scratchpad[2] = 0x4b;
+	dev->scratchpad[3] = 0x46;
+	dev->scratchpad[4] = ((res - 9) << 5) | 0x1f;
+	dev->scratchpad[5] = 0xff;
+	dev->scratchpad[6] = 0x0c;
+	dev->scratchpad[7] = 0x10;
+	dev->scratchpad[8] = owire_crc8(dev->scratchpad, 8);
+}
+
+static int sim_is_selected(sim_bus_t *bus, int i) {
+	return (bus->selected == -1) || (bus->selected == i);
+}
+
+static uint32_t sim_conversion_us(sim_device_t *dev) {
+	if (dev->rom[0] == DS18S20_FAMILY_CODE) {
+		return 750000;
+	}
+
+	return 93750 << ((dev->scratchpad[4] >> 5) & 3);
+}
+
+static int sim_reset(void *arg) {
+	sim_bus_t *bus = (sim_bus_t *)arg;
+
+	bus->us += SIM_RESET_US;
+	bus->state = 0;
+	bus->selected = -2;
+
+	return (bus->count > 0)?0:1;
+}
+
+static void sim_write(void *arg, const uint8_t *buf, uint32_t len) {
+	sim_bus_t *bus = (sim_bus_t *)arg;
+	int i;
+
+	bus->us += len * 8 * SIM_SLOT_US;
+
+	while (len--) {
+		uint8_t b = *buf++;
+
+		switch (bus->state) {
+			case 0:
+				if (b == 0xcc) {
+					bus->selected = -1;
+					bus->state = 2;
+				} else if (b == 0x55) {
+					bus->pos = 0;
+					bus->state = 1;
+				}
+				break;
+
+			case 1:
+				bus->match[bus->pos++] = b;
+				if (bus->pos == 8) {
+					for (i = 0; i < bus->count; i++) {
+						if (memcmp(bus->match, bus->dev[i].rom, 8) == 0) {
+							bus->selected = i;
+						}
+					}
+					bus->state = 2;
+				}
+				break;
+
+			case 2:
+				if (b == 0x44) {
+					bus->converts++;
+					for (i = 0; i < bus->count; i++) {
+						if (sim_is_selected(bus, i)) {
+							bus->dev[i].ready = bus->us + sim_conversion_us(&bus->dev[i]);
+						}
+					}
+				} else if (b == 0xbe) {
+					bus->pos = 0;
+					bus->state = 3;
+					bus->scratchpads++;
+				} else if (b == 0xb4) {
+					bus->state = 4;
+				}
+				break;
+		}
+	}
+}
+
+static int sim_read_bit(void *arg) {
+	sim_bus_t *bus = (sim_bus_t *)arg;
+	int i;
+
+	bus->us += SIM_SLOT_US;
+
+	for (i = 0; i < bus->count; i++) {
+		// Parasite powered devices pull the bus low after Read Power Supply
+		if ((bus->state == 4) && sim_is_selected(bus, i) && bus->dev[i].parasite) {
+			return 0;
+		}
+
+		// Externally powered devices pull the bus low while converting
+		if ((bus->state == 2) && !bus->dev[i].parasite && (bus->us < bus->dev[i].ready)) {
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+static void sim_read(void *arg, uint8_t *buf, uint32_t len) {
+	sim_bus_t *bus = (sim_bus_t *)arg;
+	sim_device_t *dev;
+
+	bus->us += len * 8 * SIM_SLOT_US;
+
+	while (len--) {
+		if ((bus->state != 3) || (bus->selected < 0) || (bus->pos >= 9)) {
+			*buf++ = 0xff;
+			continue;
+		}
+
+		dev = &bus->dev[bus->selected];
+
+		// Scratchpad is not updated until the conversion ends
+		*buf = dev->scratchpad[bus->pos];
+		if (dev->corrupt && (bus->pos == 0)) {
+			*buf ^= 0x01;
+		}
+
+		buf++;
+		bus->pos++;
+
+		if ((bus->pos == 9) && dev->corrupt) {
+			dev->corrupt--;
+		}
+	}
+}
+
+static void sim_power(void *arg, int on) {
+	((sim_bus_t *)arg)->power = on;
+}
+
+static void sim_delay(void *arg, uint32_t ms) {
+	((sim_bus_t *)arg)->us += ms * 1000;
+}
+
+static const ds1820_bus_ops_t sim_ops = {
+	.reset = sim_reset,
+	.write = sim_write,
+	.read = sim_read,
+	.read_bit = sim_read_bit,
+	.power = sim_power,
+	.delay = sim_delay,
+};
+
+static void sim_roms(sim_bus_t *bus, uint8_t (*roms)[8]) {
+	int i;
+
+	for (i = 0; i < bus->count; i++) {
+		memcpy(roms[i], bus->dev[i].rom, 8);
+	}
+}
+
+// Read the devices one by one: conversion, wait, and read, as the sensor's
+// acquire function did before bus sweeps
+static void sim_sequential(sim_bus_t *bus, uint8_t res) {
+	uint8_t cmd[10];
+	uint8_t data[9];
+	uint32_t mtime;
+	int i;
+
+	for (i = 0; i < bus->count; i++) {
+		cmd[0] = 0x55;
+		memcpy(&cmd[1], bus->dev[i].rom, 8);
+
+		sim_reset(bus);
+		cmd[9] = 0x44;
+		sim_write(bus, cmd, 10);
+
+		for (mtime = 0; mtime < ds1820_bus_conversion_time(res); mtime += 10) {
+			sim_delay(bus, 10);
+			if (sim_read_bit(bus)) break;
+		}
+
+		sim_reset(bus);
+		cmd[9] = 0xbe;
+		sim_write(bus, cmd, 10);
+		sim_read(bus, data, 9);
+	}
+}
+
+TEST_CASE("ds1820 scratchpad decode", "[ds1820]") {
+	uint8_t b20[8] = {DS18B20_FAMILY_CODE};
+	uint8_t s20[8] = {DS18S20_FAMILY_CODE};
+	uint8_t data[9] = {0};
+	double t;
+
+	// DS18B20 12 bits, datasheet values
+	data[4] = 0x7f;
+
+	data[0] = 0xd0; data[1] = 0x07;
+	TEST_ASSERT_EQUAL(ow_OK, ds1820_bus_decode(b20, data, &t));
+	TEST_ASSERT_DOUBLE_WITHIN(0.0001, 125.0, t);
+
+	data[0] = 0x91; data[1] = 0x01;
+	TEST_ASSERT_EQUAL(ow_OK, ds1820_bus_decode(b20, data, &t));
+	TEST_ASSERT_DOUBLE_WITHIN(0.0001, 25.0625, t);
+
+	data[0] = 0x5e; data[1] = 0xff;
+	TEST_ASSERT_EQUAL(ow_OK, ds1820_bus_decode(b20, data, &t));
+	TEST_ASSERT_DOUBLE_WITHIN(0.0001, -10.125, t);
+
+	data[0] = 0x90; data[1] = 0xfc;
+	TEST_ASSERT_EQUAL(ow_OK, ds1820_bus_decode(b20, data, &t));
+	TEST_ASSERT_DOUBLE_WITHIN(0.0001, -55.0, t);
+
+	// DS18B20 9 bits, lower bits are undefined
+	data[4] = 0x1f;
+	data[0] = 0x97; data[1] = 0x01;
+	TEST_ASSERT_EQUAL(ow_OK, ds1820_bus_decode(b20, data, &t));
+	TEST_ASSERT_DOUBLE_WITHIN(0.0001, 25.0, t);
+
+	// DS18S20, extended resolution
+	data[0] = 0x32; data[1] = 0x00; data[6] = 0x0c; data[7] = 0x10;
+	TEST_ASSERT_EQUAL(ow_OK, ds1820_bus_decode(s20, data, &t));
+	TEST_ASSERT_DOUBLE_WITHIN(0.0001, 25.0, t);
+
+	data[0] = 0xce; data[1] = 0xff; data[6] = 0x08;
+	TEST_ASSERT_EQUAL(ow_OK, ds1820_bus_decode(s20, data, &t));
+	TEST_ASSERT_DOUBLE_WITHIN(0.0001, -25.0 - 0.25 + 0.5, t);
+
+	data[7] = 0;
+	TEST_ASSERT_EQUAL(owError_Convert, ds1820_bus_decode(s20, data, &t));
+}
+
+TEST_CASE("ds1820 bus sweep", "[ds1820]") {
+	static sim_bus_t bus;
+	static uint8_t roms[SIM_MAX_DEVICES][8];
+	ds1820_bus_result_t results[SIM_MAX_DEVICES];
+	int i;
+
+	memset(&bus, 0, sizeof(bus));
+
+	// No devices
+	TEST_ASSERT_EQUAL(owError_NoDevice, ds1820_bus_sweep(&sim_ops, &bus, roms, 0, 12, results));
+
+	// Mixed resolutions and families, and a device that is not a DS1820
+	sim_add(&bus, DS18B20_FAMILY_CODE, 1, 0x0191, 12);
+	sim_add(&bus, DS18B20_FAMILY_CODE, 2, 0xff5c, 10);
+	sim_add(&bus, DS18S20_FAMILY_CODE, 3, 0x0032, 9);
+	sim_add(&bus, 0x01, 4, 0, 9);
+	sim_add(&bus, DS1822_FAMILY_CODE, 5, 0x07d0, 9);
+	sim_roms(&bus, roms);
+
+	TEST_ASSERT_EQUAL(ow_OK, ds1820_bus_sweep(&sim_ops, &bus, roms, bus.count, 12, results));
+	TEST_ASSERT_EQUAL(1, bus.converts);
+
+	TEST_ASSERT_EQUAL(ow_OK, results[0].status);
+	TEST_ASSERT_DOUBLE_WITHIN(0.0001, 25.0625, results[0].temperature);
+	TEST_ASSERT_EQUAL(ow_OK, results[1].status);
+	TEST_ASSERT_DOUBLE_WITHIN(0.0001, -10.25, results[1].temperature);
+	TEST_ASSERT_EQUAL(ow_OK, results[2].status);
+	TEST_ASSERT_DOUBLE_WITHIN(0.0001, 25.0, results[2].temperature);
+	TEST_ASSERT_EQUAL(owError_Not18b20, results[3].status);
+	TEST_ASSERT_EQUAL(ow_OK, results[4].status);
+	TEST_ASSERT_DOUBLE_WITHIN(0.0001, 125.0, results[4].temperature);
+
+	// A corrupted read is retried
+	bus.dev[1].corrupt = 1;
+	TEST_ASSERT_EQUAL(ow_OK, ds1820_bus_sweep(&sim_ops, &bus, roms, bus.count, 12, results));
+	TEST_ASSERT_EQUAL(ow_OK, results[1].status);
+	TEST_ASSERT_DOUBLE_WITHIN(0.0001, -10.25, results[1].temperature);
+
+	// A device that always fails doesn't affect the other ones
+	bus.dev[1].corrupt = DS1820_BUS_READ_RETRIES;
+	TEST_ASSERT_EQUAL(ow_OK, ds1820_bus_sweep(&sim_ops, &bus, roms, bus.count, 12, results));
+	TEST_ASSERT_EQUAL(owError_BadCRC, results[1].status);
+	TEST_ASSERT_EQUAL(ow_OK, results[0].status);
+	TEST_ASSERT_EQUAL(ow_OK, results[2].status);
+
+	// Conversion time is too short for a 12 bits device
+	TEST_ASSERT_EQUAL(owError_NotFinished, ds1820_bus_sweep(&sim_ops, &bus, roms, bus.count, 9, results));
+
+	// Parasite power: fixed wait with the strong pull-up
+	bus.dev[0].parasite = 1;
+	bus.us = 0;
+	TEST_ASSERT_EQUAL(ow_OK, ds1820_bus_sweep(&sim_ops, &bus, roms, bus.count, 12, results));
+	TEST_ASSERT_EQUAL(0, bus.power);
+	TEST_ASSERT_GREATER_OR_EQUAL(ds1820_bus_conversion_time(12) * 1000, bus.us);
+	for (i = 0; i < bus.count; i++) {
+		if (i != 3) {
+			TEST_ASSERT_EQUAL(ow_OK, results[i].status);
+		}
+	}
+}
+
+TEST_CASE("ds1820 bus sweep time", "[ds1820]") {
+	static sim_bus_t bus;
+	static uint8_t roms[SIM_MAX_DEVICES][8];
+	ds1820_bus_result_t results[SIM_MAX_DEVICES];
+	uint64_t sweep_us, seq_us;
+	int i;
+
+	memset(&bus, 0, sizeof(bus));
+
+	for (i = 0; i < SIM_MAX_DEVICES; i++) {
+		sim_add(&bus, DS18B20_FAMILY_CODE, i, (i - 16) << 4, 12);
+	}
+	sim_roms(&bus, roms);
+
+	bus.us = 0;
+	TEST_ASSERT_EQUAL(ow_OK, ds1820_bus_sweep(&sim_ops, &bus, roms, bus.count, 12, results));
+	sweep_us = bus.us;
+
+	TEST_ASSERT_EQUAL(1, bus.converts);
+	TEST_ASSERT_EQUAL(SIM_MAX_DEVICES, bus.scratchpads);
+
+	for (i = 0; i < SIM_MAX_DEVICES; i++) {
+		TEST_ASSERT_EQUAL(ow_OK, results[i].status);
+		TEST_ASSERT_DOUBLE_WITHIN(0.0001, (double)(i - 16), results[i].temperature);
+	}
+
+	// One conversion (750 ms, polled each 10 ms), plus one scratchpad
+	// read per device (reset + 10 bytes written + 9 bytes read)
+	TEST_ASSERT_LESS_OR_EQUAL(760000 + 2 * SIM_RESET_US + 4 * 8 * SIM_SLOT_US * 2 +
+							  SIM_MAX_DEVICES * (SIM_RESET_US + 19 * 8 * SIM_SLOT_US) + SIM_RESET_US, sweep_us);
+
+	bus.us = 0;
+	sim_sequential(&bus, 12);
+	seq_us = bus.us;
+
+	printf("ds1820 sweep of %d devices: %u ms, sequential: %u ms\r\n", SIM_MAX_DEVICES,
+		   (unsigned)(sweep_us / 1000), (unsigned)(seq_us / 1000));
+
+	TEST_ASSERT_LESS_THAN(seq_us / 10, sweep_us);
+}
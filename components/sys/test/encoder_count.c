@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, encoder counter extension test cases
+ *
+ */
+
+#include "unity.h"
+
+#include <stdint.h>
+
+#include <sys/drivers/encoder_count.h>
+
+#define H_LIM  32767
+#define L_LIM -32768
+
+// Simulated 16 bits pulse counter, that resets on limits
+typedef struct {
+	int16_t counter;
+	uint32_t pending;
+} pcnt_sim_t;
+
+static void pcnt_sim_step(pcnt_sim_t *pcnt, int dir) {
+	pcnt->counter += dir;
+
+	if (pcnt->counter == H_LIM) {
+		pcnt->counter = 0;
+		pcnt->pending |= ENCODER_COUNT_H_LIM;
+	} else if (pcnt->counter == L_LIM) {
+		pcnt->counter = 0;
+		pcnt->pending |= ENCODER_COUNT_L_LIM;
+	}
+}
+
+static void pcnt_sim_isr(pcnt_sim_t *pcnt, encoder_count_t *count) {
+	encoder_count_event(count, pcnt->pending);
+	pcnt->pending = 0;
+}
+
+// Read sequence used by the driver
+static int64_t pcnt_sim_read(pcnt_sim_t *pcnt, encoder_count_t *count) {
+	int16_t counter = pcnt->counter;
+
+	if (pcnt->pending) {
+		pcnt_sim_isr(pcnt, count);
+		counter = pcnt->counter;
+	}
+
+	return encoder_count_value(count, counter);
+}
+
+TEST_CASE("encoder count extension", "[encoder]") {
+	encoder_count_t count;
+	pcnt_sim_t pcnt = {0, 0};
+	int64_t expected = 0;
+	int i;
+
+	encoder_count_init(&count, H_LIM, L_LIM);
+
+	// Forward, across several overflows
+	for (i = 0; i < 200000; i++) {
+		pcnt_sim_step(&pcnt, 1);
+		pcnt_sim_isr(&pcnt, &count);
+		expected++;
+	}
+	TEST_ASSERT(pcnt_sim_read(&pcnt, &count) == expected);
+
+	// Backward, below 0
+	for (i = 0; i < 500000; i++) {
+		pcnt_sim_step(&pcnt, -1);
+		pcnt_sim_isr(&pcnt, &count);
+		expected--;
+	}
+	TEST_ASSERT(pcnt_sim_read(&pcnt, &count) == expected);
+
+	// Limit event pending when the counter is read (ISR delayed)
+	while (!pcnt.pending) {
+		pcnt_sim_step(&pcnt, -1);
+		expected--;
+	}
+	TEST_ASSERT(pcnt_sim_read(&pcnt, &count) == expected);
+	TEST_ASSERT_EQUAL(0, pcnt.pending);
+
+	// Set
+	encoder_count_set(&count, 5000000000LL);
+	pcnt.counter = 0;
+	pcnt_sim_step(&pcnt, 1);
+	TEST_ASSERT(pcnt_sim_read(&pcnt, &count) == 5000000001LL);
+}
+
+TEST_CASE("encoder rate limiter", "[encoder]") {
+	encoder_rate_t rate;
+	int32_t delta, velocity;
+
+	encoder_rate_init(&rate, 0, 1000, 100);
+
+	// Interval not elapsed
+	TEST_ASSERT_EQUAL(0, encoder_rate_update(&rate, 10, 1050, &delta, &velocity));
+
+	// Moving
+	TEST_ASSERT_EQUAL(1, encoder_rate_update(&rate, 50, 1100, &delta, &velocity));
+	TEST_ASSERT_EQUAL(50, delta);
+	TEST_ASSERT_EQUAL(500, velocity);
+
+	TEST_ASSERT_EQUAL(1, encoder_rate_update(&rate, 30, 1300, &delta, &velocity));
+	TEST_ASSERT_EQUAL(-20, delta);
+	TEST_ASSERT_EQUAL(-100, velocity);
+
+	// Stopped, 0 velocity is notified once
+	TEST_ASSERT_EQUAL(1, encoder_rate_update(&rate, 30, 1400, &delta, &velocity));
+	TEST_ASSERT_EQUAL(0, delta);
+	TEST_ASSERT_EQUAL(0, velocity);
+
+	TEST_ASSERT_EQUAL(0, encoder_rate_update(&rate, 30, 1500, &delta, &velocity));
+	TEST_ASSERT_EQUAL(0, encoder_rate_update(&rate, 30, 1600, &delta, &velocity));
+
+	// Moving again
+	TEST_ASSERT_EQUAL(1, encoder_rate_update(&rate, 40, 1700, &delta, &velocity));
+	TEST_ASSERT_EQUAL(10, delta);
+	TEST_ASSERT_EQUAL(100, velocity);
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, gpio debouncing core test cases
+ *
+ */
+
+#include "unity.h"
+
+#include <stdint.h>
+
+#include <sys/drivers/gpio_debouncing_core.h>
+
+TEST_CASE("gpio debouncing bank", "[gpio]") {
+	gpio_debouncing_bank_t bank = {0};
+	uint64_t active, changed;
+	int i;
+
+	gpio_debouncing_bank_threshold(&bank, 4, 3);
+	gpio_debouncing_bank_threshold(&bank, 39, 50);
+	gpio_debouncing_bank_threshold(&bank, 63, 100000);
+
+	// Bounce on pin 4, shorter than the threshold
+	active = (1ULL << 4);
+	TEST_ASSERT(gpio_debouncing_bank_tick(&bank, (1ULL << 4), &active) == 0);
+	TEST_ASSERT(gpio_debouncing_bank_tick(&bank, (1ULL << 4), &active) == 0);
+	TEST_ASSERT(gpio_debouncing_bank_tick(&bank, 0, &active) == 0);
+	TEST_ASSERT(active == 0);
+
+	// Stable on pin 4, latched after 3 ticks. The counter was cleared by
+	// the bounce.
+	active = (1ULL << 4);
+	TEST_ASSERT(gpio_debouncing_bank_tick(&bank, (1ULL << 4), &active) == 0);
+	TEST_ASSERT(gpio_debouncing_bank_tick(&bank, (1ULL << 4), &active) == 0);
+	changed = gpio_debouncing_bank_tick(&bank, (1ULL << 4), &active);
+	TEST_ASSERT(changed == (1ULL << 4));
+	TEST_ASSERT(bank.latch == (1ULL << 4));
+	TEST_ASSERT(active == 0);
+
+	// Pins 4 and 39 at once, with different thresholds
+	active = (1ULL << 4) | (1ULL << 39);
+	for(i = 1;i < 3;i++) {
+		TEST_ASSERT(gpio_debouncing_bank_tick(&bank, (1ULL << 39), &active) == 0);
+	}
+	TEST_ASSERT(gpio_debouncing_bank_tick(&bank, (1ULL << 39), &active) == (1ULL << 4));
+	TEST_ASSERT(active == (1ULL << 39));
+	for(i = 4;i < 50;i++) {
+		TEST_ASSERT(gpio_debouncing_bank_tick(&bank, (1ULL << 39), &active) == 0);
+	}
+	TEST_ASSERT(gpio_debouncing_bank_tick(&bank, (1ULL << 39), &active) == (1ULL << 39));
+	TEST_ASSERT(bank.latch == (1ULL << 39));
+
+	// Threshold clamped to the counter range
+	active = (1ULL << 63);
+	for(i = 1;i < GPIO_DEBOUNCING_MAX_THRESHOLD;i++) {
+		TEST_ASSERT(gpio_debouncing_bank_tick(&bank, (1ULL << 63) | (1ULL << 39), &active) == 0);
+	}
+	TEST_ASSERT(gpio_debouncing_bank_tick(&bank, (1ULL << 63) | (1ULL << 39), &active) == (1ULL << 63));
+
+	// Pins not active are not debounced
+	active = 0;
+	TEST_ASSERT(gpio_debouncing_bank_tick(&bank, 0xffffffffffffffffULL, &active) == 0);
+}
+
+TEST_CASE("gpio debouncing ring", "[gpio]") {
+	static gpio_debouncing_ring_t ring;
+	gpio_debouncing_event_t event[GPIO_DEBOUNCING_EVENTS];
+	int i;
+
+	TEST_ASSERT_EQUAL(0, gpio_debouncing_ring_get(&ring, event, 4));
+
+	// A batch of events, in pin order
+	TEST_ASSERT_EQUAL(3, gpio_debouncing_ring_put(&ring, (1ULL << 2) | (1ULL << 5) | (1ULL << 39), (1ULL << 5), 0, 1234));
+	TEST_ASSERT_EQUAL(2, gpio_debouncing_ring_put(&ring, (1ULL << 0) | (1ULL << 1), (1ULL << 1), 40, 1300));
+
+	TEST_ASSERT_EQUAL(4, gpio_debouncing_ring_get(&ring, event, 4));
+	TEST_ASSERT_EQUAL(2, event[0].pin);
+	TEST_ASSERT_EQUAL(0, event[0].level);
+	TEST_ASSERT_EQUAL(1234, event[0].time);
+	TEST_ASSERT_EQUAL(5, event[1].pin);
+	TEST_ASSERT_EQUAL(1, event[1].level);
+	TEST_ASSERT_EQUAL(39, event[2].pin);
+	TEST_ASSERT_EQUAL(40, event[3].pin);
+	TEST_ASSERT_EQUAL(1300, event[3].time);
+
+	TEST_ASSERT_EQUAL(1, gpio_debouncing_ring_get(&ring, event, 4));
+	TEST_ASSERT_EQUAL(41, event[0].pin);
+	TEST_ASSERT_EQUAL(1, event[0].level);
+
+	// Overflow, the newest events are dropped
+	for(i = 0;i < GPIO_DEBOUNCING_EVENTS + 3;i++) {
+		gpio_debouncing_ring_put(&ring, 1ULL << (i & 63), 0, 0, i);
+	}
+	TEST_ASSERT_EQUAL(3, ring.dropped);
+
+	TEST_ASSERT_EQUAL(GPIO_DEBOUNCING_EVENTS, gpio_debouncing_ring_get(&ring, event, GPIO_DEBOUNCING_EVENTS));
+	TEST_ASSERT_EQUAL(0, event[0].time);
+	TEST_ASSERT_EQUAL(GPIO_DEBOUNCING_EVENTS - 1, event[GPIO_DEBOUNCING_EVENTS - 1].time);
+	TEST_ASSERT_EQUAL(0, gpio_debouncing_ring_get(&ring, event, 4));
+}
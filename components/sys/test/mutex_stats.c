@@ -0,0 +1,257 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, mutex contention statistics test cases
+ *
+ */
+
+#include "unity.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include <sys/mutex_stats.h>
+
+#define BENCH_THREADS 4
+#define BENCH_LOCKS   20000
+
+// Lock operations over pthread mutexes
+static int owner_running = 1;
+
+static int pth_trylock(void *lock) {
+	return (pthread_mutex_trylock((pthread_mutex_t *)lock) == 0);
+}
+
+static void pth_lock(void *lock) {
+	pthread_mutex_lock((pthread_mutex_t *)lock);
+}
+
+static void *pth_self() {
+	return (void *)pthread_self();
+}
+
+static int pth_running(void *thread) {
+	return owner_running;
+}
+
+static uint32_t pth_now() {
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+
+	return (uint32_t)(tv.tv_sec * 1000000ULL + tv.tv_usec);
+}
+
+static mtx_stats_ops_t ops = {pth_trylock, pth_lock, pth_self, pth_running, pth_now, 0, 0};
+
+typedef struct {
+	pthread_mutex_t lock;
+	mtx_stats_t stats;
+	uint32_t hold;
+	volatile uint32_t counter;
+} test_mutex_t;
+
+static void lock(test_mutex_t *mutex) {
+	mtx_stats_lock(&ops, &mutex->lock, &mutex->stats);
+}
+
+static void unlock(test_mutex_t *mutex) {
+	mtx_stats_unlock(&ops, &mutex->stats);
+	pthread_mutex_unlock(&mutex->lock);
+}
+
+static void *holder(void *arg) {
+	test_mutex_t *mutex = (test_mutex_t *)arg;
+
+	lock(mutex);
+	usleep(mutex->hold);
+	unlock(mutex);
+
+	return NULL;
+}
+
+static void *worker(void *arg) {
+	test_mutex_t *mutex = (test_mutex_t *)arg;
+	volatile int work;
+	int i;
+
+	// Short critical sections, as most driver locks
+	for (i = 0; i < BENCH_LOCKS; i++) {
+		lock(mutex);
+		mutex->counter++;
+		for (work = 0; work < 50; work++);
+		unlock(mutex);
+
+		for (work = 0; work < 50; work++);
+	}
+
+	return NULL;
+}
+
+static long bench(test_mutex_t *mutex, int32_t max_spin) {
+	pthread_t threads[BENCH_THREADS];
+	struct timeval start, end;
+	int i;
+
+	pthread_mutex_init(&mutex->lock, NULL);
+	mtx_stats_init(&mutex->stats, "bench");
+	mutex->counter = 0;
+
+	ops.max_spin = max_spin;
+	owner_running = 1;
+
+	gettimeofday(&start, NULL);
+
+	for (i = 0; i < BENCH_THREADS; i++) {
+		pthread_create(&threads[i], NULL, worker, mutex);
+	}
+
+	for (i = 0; i < BENCH_THREADS; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	gettimeofday(&end, NULL);
+
+	pthread_mutex_destroy(&mutex->lock);
+
+	return (end.tv_sec - start.tv_sec) * 1000000L + (end.tv_usec - start.tv_usec);
+}
+
+TEST_CASE("mutex statistics", "[mutex_stats]") {
+	pthread_mutexattr_t attr;
+	test_mutex_t mutex;
+	pthread_t thread;
+
+	ops.max_spin = 0;
+	ops.recursive = 0;
+
+	pthread_mutex_init(&mutex.lock, NULL);
+	mtx_stats_init(&mutex.stats, "test");
+
+	// Hold time and owner
+	lock(&mutex);
+	TEST_ASSERT_TRUE(mutex.stats.owner == pth_self());
+	usleep(2000);
+	unlock(&mutex);
+
+	TEST_ASSERT_NULL(mutex.stats.owner);
+	TEST_ASSERT_EQUAL(1, mutex.stats.acquisitions);
+	TEST_ASSERT_EQUAL(0, mutex.stats.contentions);
+	TEST_ASSERT_TRUE(mutex.stats.max_hold >= 2000);
+
+	// Wait time, with the owner not running there is no spin
+	ops.max_spin = 100;
+	owner_running = 0;
+	mutex.hold = 20000;
+
+	pthread_create(&thread, NULL, holder, &mutex);
+	while (!mutex.stats.owner) {
+		usleep(100);
+	}
+
+	TEST_ASSERT_EQUAL(0, mtx_stats_trylock(&ops, &mutex.lock, &mutex.stats));
+
+	lock(&mutex);
+	TEST_ASSERT_TRUE(mutex.stats.owner == pth_self());
+	unlock(&mutex);
+	pthread_join(thread, NULL);
+
+	TEST_ASSERT_EQUAL(3, mutex.stats.acquisitions);
+	TEST_ASSERT_EQUAL(1, mutex.stats.contentions);
+	TEST_ASSERT_EQUAL(0, mutex.stats.spins);
+	TEST_ASSERT_TRUE(mutex.stats.max_wait >= 10000);
+	TEST_ASSERT_TRUE(mutex.stats.max_hold >= 20000);
+
+	mtx_stats_reset(&mutex.stats);
+	TEST_ASSERT_EQUAL(0, mutex.stats.acquisitions);
+	TEST_ASSERT_EQUAL(0, mutex.stats.max_hold);
+
+	pthread_mutex_destroy(&mutex.lock);
+
+	// Recursive mutex, only the outermost acquisition is accounted
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&mutex.lock, &attr);
+	mtx_stats_init(&mutex.stats, "recursive");
+	ops.recursive = 1;
+
+	lock(&mutex);
+	TEST_ASSERT_EQUAL(1, mtx_stats_trylock(&ops, &mutex.lock, &mutex.stats));
+	lock(&mutex);
+	TEST_ASSERT_EQUAL(3, mutex.stats.depth);
+
+	unlock(&mutex);
+	unlock(&mutex);
+	TEST_ASSERT_TRUE(mutex.stats.owner == pth_self());
+	unlock(&mutex);
+	TEST_ASSERT_NULL(mutex.stats.owner);
+	TEST_ASSERT_EQUAL(1, mutex.stats.acquisitions);
+
+	ops.recursive = 0;
+	pthread_mutex_destroy(&mutex.lock);
+	pthread_mutexattr_destroy(&attr);
+}
+
+TEST_CASE("mutex contention", "[mutex_stats]") {
+	test_mutex_t mutex;
+	long blocking, spinning;
+	uint32_t contentions;
+
+	ops.recursive = 0;
+
+	blocking = bench(&mutex, 0);
+	TEST_ASSERT_EQUAL(BENCH_THREADS * BENCH_LOCKS, mutex.counter);
+	TEST_ASSERT_EQUAL(BENCH_THREADS * BENCH_LOCKS, mutex.stats.acquisitions);
+	TEST_ASSERT_EQUAL(0, mutex.stats.spins);
+	contentions = mutex.stats.contentions;
+
+	spinning = bench(&mutex, 100);
+	TEST_ASSERT_EQUAL(BENCH_THREADS * BENCH_LOCKS, mutex.counter);
+	TEST_ASSERT_EQUAL(BENCH_THREADS * BENCH_LOCKS, mutex.stats.acquisitions);
+	TEST_ASSERT_TRUE(mutex.stats.spins <= mutex.stats.contentions);
+
+	printf("%d threads x %d locks: %ld usecs blocking (%u contentions), %ld usecs spinning (%u contentions, %u solved spinning)\n",
+		BENCH_THREADS, BENCH_LOCKS, blocking, contentions, spinning, mutex.stats.contentions, mutex.stats.spins);
+}
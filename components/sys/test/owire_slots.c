@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, ONE WIRE slot encoder / decoder test cases
+ *
+ * Slots are encoded, and then a bus model (open drain, wired-AND) with
+ * simulated devices generates the waveform captured by the RMT RX channel.
+ *
+ */
+
+#include "unity.h"
+
+#include <string.h>
+#include <stdint.h>
+
+#include <sys/drivers/owire_slots.h>
+
+#define BUS_US 4096
+
+// Bus model: 1 us per sample
+typedef struct {
+	uint8_t level[BUS_US];
+	uint32_t len;
+} bus_t;
+
+static void bus_master(bus_t *bus, const uint32_t *items, uint32_t len) {
+	uint32_t i, t = 0, d;
+
+	memset(bus->level, 1, sizeof(bus->level));
+
+	for(i = 0; i < len; i++) {
+		d = items[i] & 0x7fff;
+		memset(&bus->level[t], (items[i] >> 15) & 1, d);
+		t += d;
+
+		d = (items[i] >> 16) & 0x7fff;
+		memset(&bus->level[t], (items[i] >> 31) & 1, d);
+		t += d;
+	}
+
+	bus->len = t;
+}
+
+// A device pulls the line low from the start (falling edge) plus from, during
+// duration us
+static void bus_device(bus_t *bus, uint32_t edge, uint32_t from, uint32_t duration) {
+	memset(&bus->level[edge + from], 0, duration);
+}
+
+// Falling edges of the master slots
+static uint32_t bus_slot_edge(const uint32_t *items, uint32_t slot) {
+	uint32_t i, t = 0;
+
+	for(i = 0; i < slot; i++) {
+		t += (items[i] & 0x7fff) + ((items[i] >> 16) & 0x7fff);
+	}
+
+	return t;
+}
+
+// Capture the bus as the RMT RX channel does, with a 100 us idle threshold
+static uint32_t bus_capture(bus_t *bus, uint32_t *items) {
+	uint32_t t = 0, n = 0, half = 0;
+	uint32_t start, d;
+	uint8_t level;
+
+	// Capture starts on the first edge
+	while ((t < bus->len) && bus->level[t]) t++;
+
+	while (t < BUS_US) {
+		start = t;
+		level = bus->level[t];
+
+		while ((t < BUS_US) && (bus->level[t] == level) && (!level || (t - start < 100))) t++;
+
+		d = t - start;
+		if (level && (d >= 100)) {
+			d = 0;
+		}
+
+		if (half == 0) {
+			items[n] = d | (level << 15);
+		} else {
+			items[n] |= (d << 16) | (level << 31);
+			n++;
+		}
+
+		half ^= 1;
+
+		if (d == 0) {
+			break;
+		}
+	}
+
+	return n + half;
+}
+
+TEST_CASE("owire slot encoding", "[owire]") {
+	uint32_t items[8];
+	uint8_t byte = 0xa5;
+	int i;
+
+	TEST_ASSERT_EQUAL(1, owire_encode_reset(items));
+	TEST_ASSERT_EQUAL(OWIRE_ITEM(480, 0, 410, 1), items[0]);
+
+	TEST_ASSERT_EQUAL(8, owire_encode_bits(&byte, 8, items));
+
+	for(i = 0; i < 8; i++) {
+		if (byte & (1 << i)) {
+			TEST_ASSERT_EQUAL(OWIRE_ITEM(6, 0, 64, 1), items[i]);
+		} else {
+			TEST_ASSERT_EQUAL(OWIRE_ITEM(60, 0, 10, 1), items[i]);
+		}
+	}
+}
+
+TEST_CASE("owire reset and presence", "[owire]") {
+	static bus_t bus;
+	uint32_t tx[1], rx[16];
+	uint32_t len;
+
+	// No devices
+	owire_encode_reset(tx);
+	bus_master(&bus, tx, 1);
+	len = bus_capture(&bus, rx);
+	TEST_ASSERT_EQUAL(1, owire_decode_reset(rx, len));
+
+	// A device, presence pulse 30 us after the rising edge, during 120 us
+	bus_master(&bus, tx, 1);
+	bus_device(&bus, 0, 480 + 30, 120);
+	len = bus_capture(&bus, rx);
+	TEST_ASSERT_EQUAL(0, owire_decode_reset(rx, len));
+
+	// Nothing captured
+	TEST_ASSERT_EQUAL(1, owire_decode_reset(rx, 0));
+}
+
+TEST_CASE("owire read and write slots", "[owire]") {
+	static bus_t bus;
+	uint32_t tx[32], rx[40];
+	uint8_t data[4], out[4];
+	uint8_t device[4] = {0x28, 0xff, 0x00, 0x5a};
+	uint32_t len;
+	int i;
+
+	// Write slots are captured as they were sent
+	memcpy(data, device, 4);
+	owire_encode_bits(data, 32, tx);
+	bus_master(&bus, tx, 32);
+	len = bus_capture(&bus, rx);
+	TEST_ASSERT_EQUAL(32, owire_decode_bits(rx, len, out, 32));
+	TEST_ASSERT_EQUAL_MEMORY(device, out, 4);
+
+	// Read slots, the device holds the line low for 0 bits
+	memset(data, 0xff, 4);
+	owire_encode_bits(data, 32, tx);
+	bus_master(&bus, tx, 32);
+
+	for(i = 0; i < 32; i++) {
+		if (!(device[i >> 3] & (1 << (i & 7)))) {
+			bus_device(&bus, bus_slot_edge(tx, i), 0, 30);
+		}
+	}
+
+	len = bus_capture(&bus, rx);
+	TEST_ASSERT_EQUAL(32, owire_decode_bits(rx, len, out, 32));
+	TEST_ASSERT_EQUAL_MEMORY(device, out, 4);
+
+	// Lost slots
+	TEST_ASSERT_EQUAL(5, owire_decode_bits(rx, 5, out, 32));
+}
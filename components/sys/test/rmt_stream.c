@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, RMT receive stream test cases
+ *
+ */
+
+#include "unity.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <sys/drivers/rmt_stream.h>
+
+#define ITEM(d0, l0, d1, l1) \
+	(((uint32_t)(d0) & 0x7fff) | ((uint32_t)(l0) << 15) | (((uint32_t)(d1) & 0x7fff) << 16) | ((uint32_t)(l1) << 31))
+
+// Build a NEC IR frame, as captured from an active low IR receiver
+static uint32_t nec_frame(uint32_t code, uint32_t *items) {
+	uint32_t n = 0;
+	int i;
+
+	items[n++] = ITEM(9000, 0, 4500, 1);
+	for (i = 31; i >= 0; i--) {
+		items[n++] = ITEM(560, 0, ((code >> i) & 1)?1690:560, 1);
+	}
+	items[n++] = ITEM(560, 0, 0, 1);
+
+	return n;
+}
+
+static const rmt_stream_proto_t nec = {
+	.header = {9000, 4500},
+	.zero = {560, 560},
+	.one = {560, 1690},
+	.tolerance = 25,
+	.inverted = 1,
+};
+
+TEST_CASE("rmt stream ring buffer", "[rmt]") {
+	static uint32_t buffer[64];
+	rmt_stream_t stream;
+	uint32_t frame[40], out[40];
+	uint32_t count, i, n;
+
+	TEST_ASSERT_EQUAL(-1, rmt_stream_init(&stream, buffer, 48));
+	TEST_ASSERT_EQUAL(0, rmt_stream_init(&stream, buffer, 64));
+
+	count = 40;
+	TEST_ASSERT_EQUAL(-1, rmt_stream_get(&stream, out, &count));
+
+	for (i = 0; i < 40; i++) {
+		frame[i] = i;
+	}
+
+	// Frames wrap around the end of the storage
+	for (n = 0; n < 10; n++) {
+		frame[0] = n;
+		TEST_ASSERT_EQUAL(0, rmt_stream_put(&stream, frame, 30));
+		TEST_ASSERT_EQUAL(31, rmt_stream_used(&stream));
+
+		count = 40;
+		TEST_ASSERT_EQUAL(0, rmt_stream_get(&stream, out, &count));
+		TEST_ASSERT_EQUAL(30, count);
+		TEST_ASSERT_EQUAL_MEMORY(frame, out, 30 * sizeof(uint32_t));
+		TEST_ASSERT_EQUAL(0, rmt_stream_used(&stream));
+	}
+
+	// Full ring buffer drops frames
+	TEST_ASSERT_EQUAL(0, rmt_stream_put(&stream, frame, 30));
+	TEST_ASSERT_EQUAL(0, rmt_stream_put(&stream, frame, 30));
+	TEST_ASSERT_EQUAL(-1, rmt_stream_put(&stream, frame, 30));
+	TEST_ASSERT_EQUAL(1, stream.dropped);
+	TEST_ASSERT_EQUAL(0, rmt_stream_put(&stream, frame, 1));
+
+	// Truncated read consumes the whole frame
+	count = 10;
+	TEST_ASSERT_EQUAL(0, rmt_stream_get(&stream, out, &count));
+	TEST_ASSERT_EQUAL(10, count);
+	count = 40;
+	TEST_ASSERT_EQUAL(0, rmt_stream_get(&stream, out, &count));
+	TEST_ASSERT_EQUAL(30, count);
+	count = 40;
+	TEST_ASSERT_EQUAL(0, rmt_stream_get(&stream, out, &count));
+	TEST_ASSERT_EQUAL(1, count);
+	count = 40;
+	TEST_ASSERT_EQUAL(-1, rmt_stream_get(&stream, out, &count));
+}
+
+TEST_CASE("rmt stream pulses", "[rmt]") {
+	uint32_t items[4];
+	int32_t pulses[8];
+
+	// Halves with the same level are merged, 0 duration ends the frame
+	items[0] = ITEM(100, 1, 200, 0);
+	items[1] = ITEM(50, 0, 300, 1);
+	items[2] = ITEM(400, 0, 0, 1);
+	items[3] = ITEM(500, 1, 500, 0);
+
+	TEST_ASSERT_EQUAL(4, rmt_stream_pulses(items, 4, pulses, 8));
+	TEST_ASSERT_EQUAL(100, pulses[0]);
+	TEST_ASSERT_EQUAL(-250, pulses[1]);
+	TEST_ASSERT_EQUAL(300, pulses[2]);
+	TEST_ASSERT_EQUAL(-400, pulses[3]);
+
+	TEST_ASSERT_EQUAL(2, rmt_stream_pulses(items, 4, pulses, 2));
+}
+
+TEST_CASE("rmt stream decode", "[rmt]") {
+	uint32_t items[40];
+	int32_t pulses[80];
+	uint8_t data[4];
+	uint32_t n;
+
+	// NEC (pulse distance)
+	n = rmt_stream_pulses(items, nec_frame(0x20df10ef, items), pulses, 80);
+	TEST_ASSERT_EQUAL(32, rmt_stream_decode(pulses, n, &nec, data, 32));
+	TEST_ASSERT_EQUAL_HEX8(0x20, data[0]);
+	TEST_ASSERT_EQUAL_HEX8(0xdf, data[1]);
+	TEST_ASSERT_EQUAL_HEX8(0x10, data[2]);
+	TEST_ASSERT_EQUAL_HEX8(0xef, data[3]);
+
+	// Jitter within tolerance
+	pulses[10] = -700;
+	pulses[11] = 1500;
+	TEST_ASSERT_EQUAL(32, rmt_stream_decode(pulses, n, &nec, data, 32));
+
+	// Bad header
+	pulses[0] = -2000;
+	TEST_ASSERT_EQUAL(-1, rmt_stream_decode(pulses, n, &nec, data, 32));
+
+	// rc-switch protocol 1 (pulse width, 350 us), last space not captured
+	static const rmt_stream_proto_t rc = {
+		.zero = {350, 1050},
+		.one = {1050, 350},
+		.tolerance = 30,
+	};
+	int32_t rcp[] = {350, -1050, 1050, -350, 1050, -350, 350, -1050, 1050};
+
+	TEST_ASSERT_EQUAL(5, rmt_stream_decode(rcp, 9, &rc, data, 24));
+	TEST_ASSERT_EQUAL_HEX8(0x68, data[0]);
+
+	// Decoding stops at the first pulse pair that is not a bit
+	rcp[4] = 3000;
+	TEST_ASSERT_EQUAL(2, rmt_stream_decode(rcp, 9, &rc, data, 24));
+}
+
+TEST_CASE("rmt stream benchmark", "[rmt]") {
+	static uint32_t buffer[1024];
+	rmt_stream_t stream;
+	uint32_t frame[40], out[64];
+	int32_t pulses[128];
+	uint8_t data[4];
+	uint32_t count, n, i;
+	uint32_t frames = 20000;
+	uint32_t decoded = 0;
+	clock_t start, elapsed;
+
+	rmt_stream_init(&stream, buffer, 1024);
+	n = nec_frame(0x20df10ef, frame);
+
+	start = clock();
+
+	for (i = 0; i < frames; i++) {
+		rmt_stream_put(&stream, frame, n);
+
+		count = 64;
+		rmt_stream_get(&stream, out, &count);
+
+		count = rmt_stream_pulses(out, count, pulses, 128);
+		if (rmt_stream_decode(pulses, count, &nec, data, 32) == 32) {
+			decoded++;
+		}
+	}
+
+	elapsed = clock() - start;
+
+	TEST_ASSERT_EQUAL(frames, decoded);
+	TEST_ASSERT_EQUAL(0, stream.dropped);
+
+	printf("rmt stream: %u NEC frames queued and decoded in %u ms\r\n", (unsigned)frames,
+		   (unsigned)((uint64_t)elapsed * 1000 / CLOCKS_PER_SEC));
+}
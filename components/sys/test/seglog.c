@@ -0,0 +1,291 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, segmented log test cases
+ *
+ */
+
+#include "sdkconfig.h"
+
+#include "unity.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/time.h>
+
+#include <sys/seglog.h>
+#include <sys/tail.h>
+
+// Directory for the logs: a ram file system on the board, /tmp on the host
+#if CONFIG_LUA_RTOS_USE_RAM_FS
+#include <sys/mount.h>
+#define TEST_DIR "/ramfs"
+#else
+#define TEST_DIR "/tmp"
+#endif
+
+#define TEST_LOG TEST_DIR "/seglog"
+
+#define BENCH_RECORDS 2000
+#define BENCH_SEGMENT 512
+#define BENCH_SEGMENTS 4
+
+static void test_init() {
+#if CONFIG_LUA_RTOS_USE_RAM_FS
+	mount(TEST_DIR, "ramfs");
+#endif
+}
+
+static int count_segments() {
+	struct dirent *ent;
+	int count = 0;
+	DIR *dp;
+
+	dp = opendir(TEST_DIR);
+	TEST_ASSERT_NOT_NULL(dp);
+
+	while ((ent = readdir(dp))) {
+		if (strncmp(ent->d_name, "seglog.", 7) == 0) {
+			count++;
+		}
+	}
+
+	closedir(dp);
+
+	return count;
+}
+
+static long elapsed(struct timeval *start) {
+	struct timeval end;
+
+	gettimeofday(&end, NULL);
+
+	return (end.tv_sec - start->tv_sec) * 1000000L + (end.tv_usec - start->tv_usec);
+}
+
+TEST_CASE("segmented log rotation", "[seglog]") {
+	char record[32];
+	char buf[32];
+	seglog_t log;
+	int count;
+	int i;
+
+	test_init();
+
+	TEST_ASSERT_EQUAL(0, seglog_open(&log, TEST_LOG, 64, 3));
+	seglog_clear(&log);
+	TEST_ASSERT_EQUAL(0, seglog_count(&log));
+	TEST_ASSERT_EQUAL(-1, seglog_get(&log, 0, buf, sizeof(buf)));
+
+	// Records of 8 bytes with the \n, 8 records for segment
+	for (i = 0; i < 100; i++) {
+		sprintf(record, "line %02d", i);
+		TEST_ASSERT_EQUAL(0, seglog_append(&log, record, strlen(record)));
+	}
+
+	TEST_ASSERT_EQUAL(3, count_segments());
+	TEST_ASSERT_EQUAL(3, log.segments);
+
+	count = seglog_count(&log);
+	TEST_ASSERT_TRUE((count > 16) && (count <= 24));
+
+	// Only the records are written, nothing is moved
+	TEST_ASSERT_EQUAL(100 * 8, log.stats.bytes_written);
+
+	for (i = 0; i < count; i++) {
+		sprintf(record, "line %02d", 99 - i);
+		TEST_ASSERT_EQUAL(7, seglog_get(&log, i, buf, sizeof(buf)));
+		TEST_ASSERT_EQUAL_STRING(record, buf);
+	}
+
+	TEST_ASSERT_EQUAL(-1, seglog_get(&log, count, buf, sizeof(buf)));
+	TEST_ASSERT_EQUAL(ENOENT, errno);
+
+	// Truncated record
+	TEST_ASSERT_EQUAL(4, seglog_get(&log, 0, buf, 5));
+	TEST_ASSERT_EQUAL_STRING("line", buf);
+
+	// Records with \n are not allowed
+	TEST_ASSERT_EQUAL(-1, seglog_append(&log, "a\nb", 3));
+	TEST_ASSERT_EQUAL(EINVAL, errno);
+
+	seglog_close(&log);
+
+	// The index is built again when the log is opened
+	TEST_ASSERT_EQUAL(0, seglog_open(&log, TEST_LOG, 64, 3));
+	TEST_ASSERT_EQUAL(count, seglog_count(&log));
+	TEST_ASSERT_EQUAL(7, seglog_get(&log, count - 1, buf, sizeof(buf)));
+	sprintf(record, "line %02d", 100 - count);
+	TEST_ASSERT_EQUAL_STRING(record, buf);
+
+	TEST_ASSERT_EQUAL(0, seglog_append(&log, "last", 4));
+	TEST_ASSERT_EQUAL(4, seglog_get(&log, 0, buf, sizeof(buf)));
+	TEST_ASSERT_EQUAL_STRING("last", buf);
+	seglog_close(&log);
+
+	// Less segments, the oldest ones are removed
+	TEST_ASSERT_EQUAL(0, seglog_open(&log, TEST_LOG, 64, 2));
+	TEST_ASSERT_EQUAL(2, count_segments());
+	TEST_ASSERT_EQUAL(4, seglog_get(&log, 0, buf, sizeof(buf)));
+
+	seglog_clear(&log);
+	TEST_ASSERT_EQUAL(0, count_segments());
+	seglog_close(&log);
+}
+
+TEST_CASE("segmented log empty lines", "[seglog]") {
+	char name[32];
+	char buf[32];
+	seglog_t log;
+	FILE *fp;
+
+	test_init();
+
+	TEST_ASSERT_EQUAL(0, seglog_open(&log, TEST_LOG, 64, 3));
+	seglog_clear(&log);
+	seglog_close(&log);
+
+	// A file written before the log, with empty lines, is used as a segment
+	sprintf(name, SEGLOG_SEGMENT_NAME, TEST_LOG, 0);
+	fp = fopen(name, "w");
+	TEST_ASSERT_NOT_NULL(fp);
+	fputs("\nfirst\n\n\nsecond\n\n", fp);
+	fclose(fp);
+
+	TEST_ASSERT_EQUAL(0, seglog_open(&log, TEST_LOG, 64, 3));
+	TEST_ASSERT_EQUAL(2, seglog_count(&log));
+	TEST_ASSERT_EQUAL(6, seglog_get(&log, 0, buf, sizeof(buf)));
+	TEST_ASSERT_EQUAL_STRING("second", buf);
+	TEST_ASSERT_EQUAL(5, seglog_get(&log, 1, buf, sizeof(buf)));
+	TEST_ASSERT_EQUAL_STRING("first", buf);
+
+	TEST_ASSERT_EQUAL(0, seglog_append(&log, "third", 5));
+	TEST_ASSERT_EQUAL(3, seglog_count(&log));
+	TEST_ASSERT_EQUAL(5, seglog_get(&log, 0, buf, sizeof(buf)));
+	TEST_ASSERT_EQUAL_STRING("third", buf);
+	TEST_ASSERT_EQUAL(6, seglog_get(&log, 1, buf, sizeof(buf)));
+	TEST_ASSERT_EQUAL_STRING("second", buf);
+
+	seglog_clear(&log);
+	seglog_close(&log);
+}
+
+TEST_CASE("segmented log wear and latency", "[seglog]") {
+	char name[] = TEST_DIR "/seglog_tail";
+	uint32_t tail_written = 0;
+	long seglog_usecs, tail_usecs, get_usecs;
+	struct timeval start;
+	char record[48];
+	char buf[48];
+	seglog_t log;
+	long size;
+	FILE *fp;
+	int count;
+	int i;
+
+	test_init();
+
+	// Segmented log, for the same bound as the tailed file
+	TEST_ASSERT_EQUAL(0, seglog_open(&log, TEST_LOG, BENCH_SEGMENT, BENCH_SEGMENTS));
+	seglog_clear(&log);
+	memset(&log.stats, 0, sizeof(log.stats));
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < BENCH_RECORDS; i++) {
+		sprintf(record, "print(\"history line %d\")", i);
+		TEST_ASSERT_EQUAL(0, seglog_append(&log, record, strlen(record)));
+	}
+	seglog_usecs = elapsed(&start);
+
+	count = seglog_count(&log);
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < count; i++) {
+		TEST_ASSERT_TRUE(seglog_get(&log, i, buf, sizeof(buf)) > 0);
+	}
+	get_usecs = elapsed(&start);
+
+	sprintf(record, "print(\"history line %d\")", BENCH_RECORDS - count);
+	TEST_ASSERT_EQUAL_STRING(record, buf);
+
+	// One file, tailed when it reaches the bound, as the history did
+	remove(name);
+
+	gettimeofday(&start, NULL);
+	for (i = 0; i < BENCH_RECORDS; i++) {
+		sprintf(record, "print(\"history line %d\")\n", i);
+
+		fp = fopen(name, "a");
+		TEST_ASSERT_NOT_NULL(fp);
+		fputs(record, fp);
+		size = ftell(fp);
+		fclose(fp);
+
+		tail_written += strlen(record);
+
+		if (size > BENCH_SEGMENT * BENCH_SEGMENTS) {
+			TEST_ASSERT_EQUAL(0, file_tails(name, BENCH_SEGMENT));
+
+			// The rest of the file is written again
+			fp = fopen(name, "r");
+			fseek(fp, 0, SEEK_END);
+			tail_written += ftell(fp);
+			fclose(fp);
+		}
+	}
+	tail_usecs = elapsed(&start);
+
+	remove(name);
+
+	printf("%d records: segmented log %u bytes written in %ld usecs, tailed file %u bytes written in %ld usecs\n",
+		BENCH_RECORDS, log.stats.bytes_written, seglog_usecs, tail_written, tail_usecs);
+	printf("%d records read, newest to oldest, in %ld usecs\n", count, get_usecs);
+
+	// Each record is written once
+	TEST_ASSERT_TRUE(log.stats.bytes_written * 3 < tail_written);
+
+	seglog_clear(&log);
+	seglog_close(&log);
+}
@@ -0,0 +1,257 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, hierarchical timing wheel test cases
+ *
+ */
+
+#include "unity.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+#include <sys/timer_wheel.h>
+
+#define BENCH_TIMERS 1000
+#define BENCH_TICKS  200000
+
+static timer_wheel_t wheel;
+static timer_wheel_entry_t entries[BENCH_TIMERS];
+
+// Executor stub
+static uint32_t fired_at[BENCH_TIMERS];
+static int fired;
+static int accept;
+static int late;
+static uint32_t wakeups;
+static uint32_t last_wakeup;
+
+static int handler(void *arg, timer_wheel_entry_t *entry) {
+	int i = (int)(intptr_t)entry->arg;
+
+	fired_at[i] = wheel.now;
+	fired++;
+
+	// The expiration is inside the coalescing window
+	if ((wheel.now != entry->expires) || ((int32_t)(wheel.now - entry->due) < 0) ||
+		(wheel.now - entry->due > entry->window)) {
+		late++;
+	}
+
+	if (wheel.now != last_wakeup) {
+		last_wakeup = wheel.now;
+		wakeups++;
+	}
+
+	if (!accept) {
+		return -1;
+	}
+
+	// Finished immediately
+	if (arg) {
+		timer_wheel_done(entry);
+	}
+
+	return 0;
+}
+
+static uint32_t rnd(uint32_t *seed) {
+	*seed = *seed * 1103515245 + 12345;
+
+	return (*seed >> 8) & 0xffff;
+}
+
+static uint32_t run(uint32_t window, uint32_t ticks, int step) {
+	uint32_t seed = 1;
+	uint32_t now;
+	int i;
+
+	timer_wheel_init(&wheel, 0);
+	fired = 0;
+	late = 0;
+	wakeups = 0;
+	last_wakeup = 0;
+	accept = 1;
+
+	for (i = 0; i < BENCH_TIMERS; i++) {
+		uint32_t period = 50 + rnd(&seed) % 2000;
+
+		timer_wheel_entry_init(&entries[i], (void *)(intptr_t)i);
+		timer_wheel_start(&wheel, &entries[i], period, period, period * window / 100);
+	}
+
+	for (now = step; now <= ticks; now += step) {
+		timer_wheel_advance(&wheel, now, handler, (void *)1);
+	}
+
+	return wakeups;
+}
+
+TEST_CASE("timer wheel expirations", "[timer_wheel]") {
+	static const uint32_t delays[] = {
+		1, 2, 63, 64, 65, 127, 128, 4095, 4096, 4097, 100000, 262143, 262144,
+		TIMER_WHEEL_MAX_DELAY, TIMER_WHEEL_MAX_DELAY + 1, TIMER_WHEEL_MAX_DELAY + 1000
+	};
+
+	const int count = sizeof(delays) / sizeof(delays[0]);
+	uint32_t start;
+	int i, pass;
+
+	// Tick by tick, and with long jumps, from a start near the wrap around
+	for (pass = 0; pass < 2; pass++) {
+		start = 0xffffff00 + pass * 7;
+		timer_wheel_init(&wheel, start);
+		accept = 1;
+		fired = 0;
+		late = 0;
+
+		for (i = 0; i < count; i++) {
+			timer_wheel_entry_init(&entries[i], (void *)(intptr_t)i);
+			timer_wheel_start(&wheel, &entries[i], delays[i], 0, 0);
+			fired_at[i] = 0;
+		}
+
+		TEST_ASSERT_EQUAL(count, wheel.count);
+
+		if (pass == 0) {
+			while (wheel.count) {
+				timer_wheel_advance(&wheel, wheel.now + 1, handler, (void *)1);
+			}
+		} else {
+			while (wheel.count) {
+				timer_wheel_advance(&wheel, wheel.now + 100003, handler, (void *)1);
+			}
+		}
+
+		TEST_ASSERT_EQUAL(count, fired);
+		TEST_ASSERT_EQUAL(0, late);
+		TEST_ASSERT_EQUAL(TIMER_WHEEL_IDLE, timer_wheel_next(&wheel));
+
+		for (i = 0; i < count; i++) {
+			TEST_ASSERT_EQUAL_UINT32(start + delays[i], fired_at[i]);
+			TEST_ASSERT_EQUAL(0, entries[i].active);
+		}
+	}
+
+	// A stopped timer doesn't expire, a restarted one expires from the restart
+	timer_wheel_init(&wheel, 0);
+	fired = 0;
+	timer_wheel_entry_init(&entries[0], (void *)0);
+	timer_wheel_entry_init(&entries[1], (void *)1);
+	timer_wheel_start(&wheel, &entries[0], 100, 0, 0);
+	timer_wheel_start(&wheel, &entries[1], 100, 0, 0);
+	TEST_ASSERT_EQUAL_UINT32(64, timer_wheel_next(&wheel));
+
+	timer_wheel_advance(&wheel, 50, handler, (void *)1);
+	timer_wheel_stop(&wheel, &entries[0]);
+	timer_wheel_start(&wheel, &entries[1], 100, 0, 0);
+	timer_wheel_advance(&wheel, 1000, handler, (void *)1);
+
+	TEST_ASSERT_EQUAL(1, fired);
+	TEST_ASSERT_EQUAL_UINT32(150, fired_at[1]);
+	TEST_ASSERT_EQUAL(0, wheel.count);
+}
+
+TEST_CASE("timer wheel overruns", "[timer_wheel]") {
+	timer_wheel_entry_t *entry = &entries[0];
+
+	timer_wheel_init(&wheel, 0);
+	timer_wheel_entry_init(entry, (void *)0);
+	timer_wheel_start(&wheel, entry, 10, 10, 0);
+	accept = 1;
+	fired = 0;
+
+	// The executor doesn't finish, the next expirations are overruns
+	TEST_ASSERT_EQUAL(1, timer_wheel_advance(&wheel, 55, handler, NULL));
+	TEST_ASSERT_EQUAL(1, fired);
+	TEST_ASSERT_EQUAL(1, entry->expirations);
+	TEST_ASSERT_EQUAL(4, entry->overruns);
+	TEST_ASSERT_EQUAL(1, entry->pending);
+
+	timer_wheel_done(entry);
+	TEST_ASSERT_EQUAL(1, timer_wheel_advance(&wheel, 60, handler, NULL));
+	TEST_ASSERT_EQUAL(2, entry->expirations);
+
+	// The executor rejects the timer
+	timer_wheel_done(entry);
+	accept = 0;
+	TEST_ASSERT_EQUAL(0, timer_wheel_advance(&wheel, 70, handler, NULL));
+	TEST_ASSERT_EQUAL(5, entry->overruns);
+	TEST_ASSERT_EQUAL(0, entry->pending);
+
+	// Stopped while in the executor
+	accept = 1;
+	TEST_ASSERT_EQUAL(1, timer_wheel_advance(&wheel, 80, handler, NULL));
+	timer_wheel_stop(&wheel, entry);
+	TEST_ASSERT_EQUAL(1, entry->pending);
+	TEST_ASSERT_EQUAL(0, entry->active);
+	TEST_ASSERT_EQUAL(TIMER_WHEEL_IDLE, timer_wheel_next(&wheel));
+}
+
+TEST_CASE("timer wheel coalescing", "[timer_wheel]") {
+	struct timeval start, end;
+	uint32_t exact, coalesced;
+	long usecs;
+
+	exact = run(0, BENCH_TICKS, 1);
+	TEST_ASSERT_EQUAL(0, late);
+
+	gettimeofday(&start, NULL);
+	coalesced = run(5, BENCH_TICKS, 1);
+	gettimeofday(&end, NULL);
+	TEST_ASSERT_EQUAL(0, late);
+
+	usecs = (end.tv_sec - start.tv_sec) * 1000000L + (end.tv_usec - start.tv_usec);
+
+	// A window of 5% of the period saves more than 40% of the wake ups
+	TEST_ASSERT_TRUE(coalesced * 10 < exact * 6);
+
+	printf("%d timers, %d ticks: %u wake ups, %u with coalescing (%d expirations in %ld usecs)\n",
+		BENCH_TIMERS, BENCH_TICKS, exact, coalesced, fired, usecs);
+
+	// Advancing in long steps gives the same expirations
+	coalesced = fired;
+	run(5, BENCH_TICKS, 800);
+	TEST_ASSERT_EQUAL(0, late);
+	TEST_ASSERT_EQUAL(coalesced, (uint32_t)fired);
+}
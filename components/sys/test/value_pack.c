@@ -0,0 +1,334 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, compact binary value encoding test cases
+ *
+ */
+
+#include "unity.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/time.h>
+
+#include <sys/misc/value_pack.h>
+
+#define BENCH_PAYLOADS 20000
+
+static volatile int humidity = 65;
+
+// Not inlined, so the benchmark loops are not optimized out
+static size_t __attribute__((noinline)) encode(uint8_t *buf, size_t size, void (*fill)(vpack_writer_t *)) {
+	vpack_writer_t w;
+
+	vpack_writer_init(&w, buf, size);
+	fill(&w);
+
+	return w.len;
+}
+
+// Typical sensor payload: temperature, humidity, pressure, alarm, node id
+static void sensor_payload(vpack_writer_t *w) {
+	vpack_put_number(w, 25.3f);
+	vpack_put_integer(w, humidity);
+	vpack_put_integer(w, 1013);
+	vpack_put_boolean(w, 1);
+	vpack_put_string(w, "node1", 5);
+}
+
+// The same payload with the former pack.pack format: a type nibble per value,
+// with the raw values, all hex encoded (lua_Integer and lua_Number of 32 bits)
+static const char hex_digit[] = "0123456789ABCDEF";
+
+static int legacy_hex(char *out, const void *data, int len) {
+	const uint8_t *p = data;
+	int i;
+
+	for(i = 0; i < len; i++) {
+		*out++ = hex_digit[p[i] >> 4];
+		*out++ = hex_digit[p[i] & 0x0f];
+	}
+
+	return len * 2;
+}
+
+static int __attribute__((noinline)) legacy_sensor_payload(char *out) {
+	uint8_t header[4] = {5, 0x01, 0x13, 0x40};
+	float temperature = 25.3f;
+	int32_t hum = humidity, pressure = 1013;
+	char alarm = 1;
+	int len = 0;
+
+	len += legacy_hex(out + len, header, sizeof(header));
+	len += legacy_hex(out + len, &temperature, sizeof(temperature));
+	len += legacy_hex(out + len, &hum, sizeof(hum));
+	len += legacy_hex(out + len, &pressure, sizeof(pressure));
+	len += legacy_hex(out + len, &alarm, sizeof(alarm));
+	len += legacy_hex(out + len, "node1", 6);
+	out[len] = 0;
+
+	return len;
+}
+
+TEST_CASE("value pack encoding", "[value_pack]") {
+	static const uint8_t expected[] = {
+		0x00,                                   // nil
+		0x10, 0x11,                             // false, true
+		0x26, 0x2f, 0x2e,                       // 3, -8, 7
+		0x30, 0xd8, 0x04,                       // 300
+		0x30, 0x11,                             // -9
+		0x40, 0x00, 0x00, 0xcc, 0x41,           // 25.5
+		0x50, 0x9a, 0x99, 0x99, 0x99, 0x99, 0x99, 0xb9, 0x3f, // 0.1
+		0x63, 'a', 'b', 'c',                    // "abc"
+		0x72, 0x22, 0x81, 0x61, 'k', 0x10,      // {1, {k = false}}
+	};
+	uint8_t buf[64];
+	vpack_writer_t w;
+
+	vpack_writer_init(&w, buf, sizeof(buf));
+	vpack_put_nil(&w);
+	vpack_put_boolean(&w, 0);
+	vpack_put_boolean(&w, 1);
+	vpack_put_integer(&w, 3);
+	vpack_put_integer(&w, -8);
+	vpack_put_integer(&w, 7);
+	vpack_put_integer(&w, 300);
+	vpack_put_integer(&w, -9);
+	vpack_put_number(&w, 25.5);
+	vpack_put_number(&w, 0.1);
+	vpack_put_string(&w, "abc", 3);
+	vpack_put_array(&w, 2);
+	vpack_put_integer(&w, 1);
+	vpack_put_map(&w, 1);
+	vpack_put_string(&w, "k", 1);
+	vpack_put_boolean(&w, 0);
+
+	TEST_ASSERT_FALSE(vpack_overflow(&w));
+	TEST_ASSERT_EQUAL(sizeof(expected), w.len);
+	TEST_ASSERT_EQUAL_MEMORY(expected, buf, sizeof(expected));
+
+	// Measure only
+	TEST_ASSERT_EQUAL(18, encode(NULL, 0, sensor_payload));
+
+	// Don't write past the buffer
+	memset(buf, 0xaa, sizeof(buf));
+	TEST_ASSERT_EQUAL(18, encode(buf, 10, sensor_payload));
+	TEST_ASSERT_EQUAL_HEX8(0xaa, buf[10]);
+}
+
+TEST_CASE("value pack round trip", "[value_pack]") {
+	static const int64_t integers[] = {
+		0, 1, -1, 7, -8, 8, -9, 63, -64, 64, 8191, -8192, 8192,
+		INT32_MAX, INT32_MIN, INT64_MAX, INT64_MIN
+	};
+	static const double numbers[] = {0.5, -1.25, 25.3, 1e300, -1e-300, 3.4028234663852886e38};
+	char long_string[300];
+	uint8_t buf[1024];
+	vpack_writer_t w;
+	vpack_reader_t r;
+	vpack_value_t v;
+	int i;
+
+	memset(long_string, 'x', sizeof(long_string));
+
+	vpack_writer_init(&w, buf, sizeof(buf));
+	for(i = 0; i < sizeof(integers) / sizeof(integers[0]); i++) vpack_put_integer(&w, integers[i]);
+	for(i = 0; i < sizeof(numbers) / sizeof(numbers[0]); i++) vpack_put_number(&w, numbers[i]);
+	vpack_put_string(&w, "", 0);
+	vpack_put_string(&w, long_string, 14);
+	vpack_put_string(&w, long_string, 15);
+	vpack_put_string(&w, long_string, sizeof(long_string));
+	vpack_put_array(&w, 20);
+	for(i = 0; i < 20; i++) vpack_put_nil(&w);
+	TEST_ASSERT_FALSE(vpack_overflow(&w));
+
+	vpack_reader_init(&r, buf, w.len);
+	for(i = 0; i < sizeof(integers) / sizeof(integers[0]); i++) {
+		TEST_ASSERT_EQUAL(0, vpack_get(&r, &v));
+		TEST_ASSERT_EQUAL(VPACK_INTEGER, v.type);
+		TEST_ASSERT_TRUE(v.integer == integers[i]);
+	}
+
+	for(i = 0; i < sizeof(numbers) / sizeof(numbers[0]); i++) {
+		TEST_ASSERT_EQUAL(0, vpack_get(&r, &v));
+		TEST_ASSERT_EQUAL(VPACK_DOUBLE, v.type);
+		TEST_ASSERT_TRUE(v.number == numbers[i]);
+	}
+
+	TEST_ASSERT_EQUAL(0, vpack_get(&r, &v));
+	TEST_ASSERT_EQUAL(VPACK_STRING, v.type);
+	TEST_ASSERT_EQUAL(0, v.len);
+
+	TEST_ASSERT_EQUAL(0, vpack_get(&r, &v));
+	TEST_ASSERT_EQUAL(14, v.len);
+
+	TEST_ASSERT_EQUAL(0, vpack_get(&r, &v));
+	TEST_ASSERT_EQUAL(15, v.len);
+
+	TEST_ASSERT_EQUAL(0, vpack_get(&r, &v));
+	TEST_ASSERT_EQUAL(sizeof(long_string), v.len);
+	TEST_ASSERT_EQUAL_MEMORY(long_string, v.string, sizeof(long_string));
+
+	TEST_ASSERT_EQUAL(0, vpack_get(&r, &v));
+	TEST_ASSERT_EQUAL(VPACK_ARRAY, v.type);
+	TEST_ASSERT_EQUAL(20, v.len);
+	for(i = 0; i < 20; i++) {
+		TEST_ASSERT_EQUAL(0, vpack_get(&r, &v));
+		TEST_ASSERT_EQUAL(VPACK_NIL, v.type);
+	}
+
+	TEST_ASSERT_TRUE(r.p == r.end);
+	TEST_ASSERT_EQUAL(-1, vpack_get(&r, &v));
+}
+
+TEST_CASE("value pack invalid data", "[value_pack]") {
+	static const uint8_t overlong[] = {0x30, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x01};
+	static const uint8_t big_count[] = {0x7f, 0xff, 0xff, 0xff, 0xff, 0x0f, 0x00};
+	static const uint8_t bad_tags[] = {0x01, 0x12, 0x90, 0xf0};
+	uint8_t buf[64];
+	vpack_reader_t r;
+	vpack_value_t v;
+	size_t len;
+	size_t i;
+	int values;
+
+	// Every truncation of a payload is detected
+	len = encode(buf, sizeof(buf), sensor_payload);
+	for(i = 0; i < len; i++) {
+		vpack_reader_init(&r, buf, i);
+		for(values = 0; vpack_get(&r, &v) == 0; values++);
+		TEST_ASSERT_TRUE(values < 5);
+		TEST_ASSERT_TRUE(r.p <= r.end);
+	}
+
+	vpack_reader_init(&r, buf, len - 1);
+	TEST_ASSERT_EQUAL(0, vpack_get(&r, &v));
+	TEST_ASSERT_EQUAL(0, vpack_get(&r, &v));
+	TEST_ASSERT_EQUAL(0, vpack_get(&r, &v));
+	TEST_ASSERT_EQUAL(0, vpack_get(&r, &v));
+	TEST_ASSERT_EQUAL(-1, vpack_get(&r, &v));
+
+	vpack_reader_init(&r, overlong, sizeof(overlong));
+	TEST_ASSERT_EQUAL(-1, vpack_get(&r, &v));
+
+	vpack_reader_init(&r, big_count, sizeof(big_count));
+	TEST_ASSERT_EQUAL(-1, vpack_get(&r, &v));
+
+	for(i = 0; i < sizeof(bad_tags); i++) {
+		vpack_reader_init(&r, &bad_tags[i], 1);
+		TEST_ASSERT_EQUAL(-1, vpack_get(&r, &v));
+	}
+}
+
+TEST_CASE("value pack nesting limit", "[value_pack]") {
+	uint8_t buf[2 * (VPACK_MAX_DEPTH + 1) + 8];
+	vpack_writer_t w;
+	vpack_reader_t r;
+	int i;
+
+	// VPACK_MAX_DEPTH nested arrays, at depths 0 .. VPACK_MAX_DEPTH - 1
+	vpack_writer_init(&w, buf, sizeof(buf));
+	for(i = 0; i < VPACK_MAX_DEPTH; i++) {
+		vpack_put_array(&w, 1);
+	}
+	vpack_put_integer(&w, 1);
+	TEST_ASSERT_FALSE(vpack_overflow(&w));
+
+	vpack_reader_init(&r, buf, w.len);
+	TEST_ASSERT_EQUAL(0, vpack_skip(&r, 0));
+	TEST_ASSERT_TRUE(r.p == r.end);
+
+	// One more level
+	vpack_writer_init(&w, buf, sizeof(buf));
+	for(i = 0; i < VPACK_MAX_DEPTH + 1; i++) {
+		vpack_put_map(&w, 1);
+		vpack_put_nil(&w);
+	}
+	vpack_put_integer(&w, 1);
+	TEST_ASSERT_FALSE(vpack_overflow(&w));
+
+	vpack_reader_init(&r, buf, w.len);
+	TEST_ASSERT_EQUAL(-1, vpack_skip(&r, 0));
+
+	// Truncated
+	vpack_reader_init(&r, buf, VPACK_MAX_DEPTH);
+	TEST_ASSERT_EQUAL(-1, vpack_skip(&r, 0));
+}
+
+TEST_CASE("value pack size and speed", "[value_pack]") {
+	struct timeval start, end;
+	char legacy[64];
+	uint8_t buf[64];
+	vpack_reader_t r;
+	vpack_value_t v;
+	long usecs[3];
+	size_t len = 0;
+	int legacy_len = 0;
+	int values = 0;
+	int i;
+
+	gettimeofday(&start, NULL);
+	for(i = 0; i < BENCH_PAYLOADS; i++) legacy_len = legacy_sensor_payload(legacy);
+	gettimeofday(&end, NULL);
+	usecs[0] = (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_usec - start.tv_usec);
+
+	gettimeofday(&start, NULL);
+	for(i = 0; i < BENCH_PAYLOADS; i++) len = encode(buf, sizeof(buf), sensor_payload);
+	gettimeofday(&end, NULL);
+	usecs[1] = (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_usec - start.tv_usec);
+
+	gettimeofday(&start, NULL);
+	for(i = 0; i < BENCH_PAYLOADS; i++) {
+		vpack_reader_init(&r, buf, len);
+		while (vpack_get(&r, &v) == 0) values++;
+	}
+	gettimeofday(&end, NULL);
+	usecs[2] = (end.tv_sec - start.tv_sec) * 1000000 + (end.tv_usec - start.tv_usec);
+
+	TEST_ASSERT_EQUAL(46, legacy_len);
+	TEST_ASSERT_EQUAL(18, len);
+	TEST_ASSERT_EQUAL(BENCH_PAYLOADS * 5, values);
+
+	printf("sensor payload: %d bytes (hex pack %d bytes)\n", (int)len, legacy_len);
+	printf("%d payloads encoded in %ld usecs, decoded in %ld usecs (hex pack encode %ld usecs)\n",
+		BENCH_PAYLOADS, usecs[1], usecs[2], usecs[0]);
+}
@@ -0,0 +1,392 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, file copy test cases
+ *
+ */
+
+#include "sdkconfig.h"
+
+#include "unity.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include <sys/vfs/copy.h>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#else
+#include "freertos/FreeRTOS.h"
+#endif
+
+// Directory for the files: a ram file system on the board, /tmp on the host
+#if CONFIG_LUA_RTOS_USE_RAM_FS
+#include <sys/mount.h>
+#include <sys/vfs/vfs.h>
+#define TEST_DIR "/ramfs"
+#else
+#define TEST_DIR "/tmp"
+#endif
+
+#define TEST_SRC TEST_DIR "/copy.src"
+#define TEST_DST TEST_DIR "/copy.dst"
+#define TEST_TREE TEST_DIR "/copy.tree"
+#define TEST_TREE_COPY TEST_DIR "/copy.tree2"
+
+#define BENCH_SIZE (32 * 1024)
+#define BENCH_ROUNDS 8
+
+// Heap used, in bytes. On the board it is the free heap, negated, which is
+// enough to compare the heap used before and during a copy.
+static long heap_used() {
+#if defined(__GLIBC__)
+#if (__GLIBC__ > 2) || ((__GLIBC__ == 2) && (__GLIBC_MINOR__ >= 33))
+	struct mallinfo2 info = mallinfo2();
+#else
+	struct mallinfo info = mallinfo();
+#endif
+
+	return (long)info.uordblks;
+#else
+	return -(long)xPortGetFreeHeapSize();
+#endif
+}
+
+static long heap_base;
+static long heap_peak;
+
+static void heap_sample() {
+	long used = heap_used() - heap_base;
+
+	if (used > heap_peak) {
+		heap_peak = used;
+	}
+}
+
+static long elapsed(struct timeval *start) {
+	struct timeval end;
+
+	gettimeofday(&end, NULL);
+
+	return (end.tv_sec - start->tv_sec) * 1000000L + (end.tv_usec - start->tv_usec);
+}
+
+static void test_init() {
+#if CONFIG_LUA_RTOS_USE_RAM_FS
+	mount(TEST_DIR, "ramfs");
+#endif
+}
+
+static void create_file(const char *name, int size, int seed) {
+	FILE *fp;
+	int i;
+
+	fp = fopen(name, "w");
+	TEST_ASSERT_NOT_NULL(fp);
+
+	for (i = 0; i < size; i++) {
+		fputc((i * 31 + seed) & 0xff, fp);
+	}
+
+	fclose(fp);
+}
+
+static void check_file(const char *name, int size, int seed) {
+	FILE *fp;
+	int i;
+
+	fp = fopen(name, "r");
+	TEST_ASSERT_NOT_NULL(fp);
+
+	for (i = 0; i < size; i++) {
+		TEST_ASSERT_EQUAL((i * 31 + seed) & 0xff, fgetc(fp));
+	}
+
+	TEST_ASSERT_EQUAL(EOF, fgetc(fp));
+
+	fclose(fp);
+}
+
+// The copy that os.cp did, a byte at a time through stdio
+static int legacy_copy(const char *src, const char *dst) {
+	FILE *fsrc, *fdst;
+	int c;
+
+	fsrc = fopen(src, "r");
+	if (!fsrc) {
+		return -1;
+	}
+
+	fdst = fopen(dst, "w");
+	if (!fdst) {
+		fclose(fsrc);
+		return -1;
+	}
+
+	c = fgetc(fsrc);
+	while (!feof(fsrc)) {
+		fputc(c, fdst);
+		heap_sample();
+		c = fgetc(fsrc);
+	}
+
+	fclose(fsrc);
+	return fclose(fdst);
+}
+
+static int progress_calls;
+static int progress_cancel;
+
+static int progress(void *arg, const char *path, uint32_t done, uint32_t total) {
+	heap_sample();
+
+	progress_calls++;
+
+	return (progress_cancel && (progress_calls >= progress_cancel));
+}
+
+static int file_calls;
+
+static int file_not_supported(void *arg, const char *src, const char *dst) {
+	file_calls++;
+
+	errno = ENOTSUP;
+	return -1;
+}
+
+static void remove_tree() {
+	unlink(TEST_TREE "/a");
+	unlink(TEST_TREE "/sub/b");
+	rmdir(TEST_TREE "/sub");
+	rmdir(TEST_TREE);
+
+	unlink(TEST_TREE_COPY "/a");
+	unlink(TEST_TREE_COPY "/sub/b");
+	rmdir(TEST_TREE_COPY "/sub");
+	rmdir(TEST_TREE_COPY);
+}
+
+TEST_CASE("vfs copy file", "[vfs_copy]") {
+	vfs_copy_t copy;
+
+	test_init();
+
+	create_file(TEST_SRC, 10000, 1);
+	create_file(TEST_DST, 20000, 2);
+
+	// The destination is replaced, in chunks of the buffer size
+	vfs_copy_init(&copy);
+	copy.buffer_size = 1024;
+	copy.progress = progress;
+	copy.file = file_not_supported;
+
+	progress_calls = 0;
+	progress_cancel = 0;
+	file_calls = 0;
+
+	TEST_ASSERT_EQUAL(0, vfs_copy(&copy, TEST_SRC, TEST_DST));
+	check_file(TEST_DST, 10000, 1);
+
+	TEST_ASSERT_EQUAL(1, file_calls);
+	TEST_ASSERT_EQUAL(10, progress_calls);
+	TEST_ASSERT_EQUAL(1, copy.stats.files);
+	TEST_ASSERT_EQUAL(0, copy.stats.fast);
+	TEST_ASSERT_EQUAL(10000, copy.stats.bytes);
+	TEST_ASSERT_EQUAL(1024, copy.stats.buffer);
+	TEST_ASSERT_NULL(copy.buf);
+
+	// A canceled copy doesn't leave a partial file
+	vfs_copy_init(&copy);
+	copy.buffer_size = 1024;
+	copy.progress = progress;
+
+	progress_calls = 0;
+	progress_cancel = 3;
+
+	unlink(TEST_DST);
+	TEST_ASSERT_EQUAL(-1, vfs_copy(&copy, TEST_SRC, TEST_DST));
+	TEST_ASSERT_EQUAL(ECANCELED, errno);
+	TEST_ASSERT_EQUAL(3, progress_calls);
+	TEST_ASSERT_EQUAL(-1, access(TEST_DST, F_OK));
+
+	// Missing source
+	unlink(TEST_SRC);
+	TEST_ASSERT_EQUAL(-1, vfs_copy(&copy, TEST_SRC, TEST_DST));
+	TEST_ASSERT_EQUAL(ENOENT, errno);
+}
+
+TEST_CASE("vfs copy directory", "[vfs_copy]") {
+	vfs_copy_t copy;
+
+	test_init();
+	remove_tree();
+
+	TEST_ASSERT_EQUAL(0, mkdir(TEST_TREE, 0755));
+	TEST_ASSERT_EQUAL(0, mkdir(TEST_TREE "/sub", 0755));
+	create_file(TEST_TREE "/a", 3000, 3);
+	create_file(TEST_TREE "/sub/b", 5000, 4);
+
+	// Directories are only copied in a recursive copy
+	vfs_copy_init(&copy);
+	TEST_ASSERT_EQUAL(-1, vfs_copy(&copy, TEST_TREE, TEST_TREE_COPY));
+	TEST_ASSERT_EQUAL(EISDIR, errno);
+
+	copy.recursive = 1;
+	TEST_ASSERT_EQUAL(0, vfs_copy(&copy, TEST_TREE, TEST_TREE_COPY));
+	check_file(TEST_TREE_COPY "/a", 3000, 3);
+	check_file(TEST_TREE_COPY "/sub/b", 5000, 4);
+
+	TEST_ASSERT_EQUAL(2, copy.stats.files);
+	TEST_ASSERT_EQUAL(2, copy.stats.dirs);
+	TEST_ASSERT_EQUAL(8000, copy.stats.bytes);
+
+	// Copying again merges with the existing directories
+	create_file(TEST_TREE "/a", 100, 5);
+	TEST_ASSERT_EQUAL(0, vfs_copy(&copy, TEST_TREE, TEST_TREE_COPY));
+	check_file(TEST_TREE_COPY "/a", 100, 5);
+
+	remove_tree();
+}
+
+#if CONFIG_LUA_RTOS_USE_RAM_FS
+TEST_CASE("vfs copy ramfs blocks sharing", "[vfs_copy]") {
+	uint32_t used_before, used_after;
+	vfs_copy_t copy;
+	FILE *fp;
+
+	test_init();
+
+	unlink(TEST_DST);
+	create_file(TEST_SRC, 10000, 6);
+
+	vfs_ramfs_fsstat(NULL, NULL, &used_before);
+
+	// The copy shares the blocks, it doesn't use more space
+	vfs_copy_init(&copy);
+	TEST_ASSERT_EQUAL(0, mount_copy(TEST_SRC, TEST_DST, &copy));
+	TEST_ASSERT_EQUAL(1, copy.stats.fast);
+	TEST_ASSERT_EQUAL(0, copy.stats.buffer);
+
+	vfs_ramfs_fsstat(NULL, NULL, &used_after);
+	TEST_ASSERT_TRUE(used_after - used_before < 256);
+
+	check_file(TEST_DST, 10000, 6);
+
+	// Writing the copy doesn't change the original file
+	fp = fopen(TEST_DST, "r+");
+	TEST_ASSERT_NOT_NULL(fp);
+	fputc(0, fp);
+	fclose(fp);
+
+	check_file(TEST_SRC, 10000, 6);
+
+	// Same file, and a directory inside itself
+	TEST_ASSERT_EQUAL(0, mount_copy(TEST_SRC, TEST_SRC, &copy));
+
+	copy.recursive = 1;
+	TEST_ASSERT_EQUAL(-1, mount_copy(TEST_DIR, TEST_DIR "/x", &copy));
+	TEST_ASSERT_EQUAL(EINVAL, errno);
+
+	unlink(TEST_SRC);
+	unlink(TEST_DST);
+}
+#endif
+
+TEST_CASE("vfs copy throughput and memory", "[vfs_copy]") {
+	long legacy_usecs = 0, copy_usecs = 0;
+	long legacy_peak, copy_peak;
+	struct timeval start;
+	vfs_copy_t copy;
+	int i;
+
+	test_init();
+
+	create_file(TEST_SRC, BENCH_SIZE, 7);
+
+	heap_peak = 0;
+	heap_base = heap_used();
+
+	for (i = 0; i < BENCH_ROUNDS; i++) {
+		unlink(TEST_DST);
+
+		gettimeofday(&start, NULL);
+		TEST_ASSERT_EQUAL(0, legacy_copy(TEST_SRC, TEST_DST));
+		legacy_usecs += elapsed(&start);
+	}
+
+	check_file(TEST_DST, BENCH_SIZE, 7);
+	legacy_peak = heap_peak;
+
+	heap_peak = 0;
+	heap_base = heap_used();
+
+	for (i = 0; i < BENCH_ROUNDS; i++) {
+		unlink(TEST_DST);
+
+		vfs_copy_init(&copy);
+		copy.progress = progress;
+		progress_cancel = 0;
+
+		gettimeofday(&start, NULL);
+		TEST_ASSERT_EQUAL(0, vfs_copy(&copy, TEST_SRC, TEST_DST));
+		copy_usecs += elapsed(&start);
+	}
+
+	check_file(TEST_DST, BENCH_SIZE, 7);
+	copy_peak = heap_peak;
+
+	printf("%d bytes x %d: byte copy %ld usecs, %ld bytes of heap\n", BENCH_SIZE, BENCH_ROUNDS, legacy_usecs, legacy_peak);
+	printf("%d bytes x %d: buffer copy %ld usecs, %ld bytes of heap (%u bytes buffer)\n", BENCH_SIZE, BENCH_ROUNDS, copy_usecs, copy_peak,
+		   (unsigned int)copy.stats.buffer);
+
+	TEST_ASSERT_TRUE(copy_usecs < legacy_usecs);
+
+	unlink(TEST_SRC);
+	unlink(TEST_DST);
+}
@@ -0,0 +1,434 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, FIFO wait queue test cases
+ *
+ */
+
+#include "unity.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include <sys/waitq.h>
+
+#define ORDER_WAITERS 4
+#define BENCH_WAITERS 8
+#define BENCH_ROUNDS  2000
+
+// Queue operations over pthreads. Each thread has a counting wake up,
+// as a task notification.
+typedef struct {
+	pthread_mutex_t mtx;
+	pthread_cond_t cond;
+	int count;
+} test_thread_t;
+
+static __thread test_thread_t *current;
+
+static void pth_lock(void *lock) {
+	pthread_mutex_lock((pthread_mutex_t *)lock);
+}
+
+static void pth_unlock(void *lock) {
+	pthread_mutex_unlock((pthread_mutex_t *)lock);
+}
+
+static void *pth_self() {
+	if (!current) {
+		current = calloc(1, sizeof(test_thread_t));
+		pthread_mutex_init(&current->mtx, NULL);
+		pthread_cond_init(&current->cond, NULL);
+	}
+
+	return current;
+}
+
+// Free the state of the calling thread, before it ends
+static void pth_release() {
+	if (current) {
+		pthread_cond_destroy(&current->cond);
+		pthread_mutex_destroy(&current->mtx);
+		free(current);
+		current = NULL;
+	}
+}
+
+static void pth_wake(void *thread) {
+	test_thread_t *t = (test_thread_t *)thread;
+
+	pthread_mutex_lock(&t->mtx);
+	t->count++;
+	pthread_cond_signal(&t->cond);
+	pthread_mutex_unlock(&t->mtx);
+}
+
+static uint64_t pth_now() {
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+
+	return tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+static void pth_block(void *thread, uint64_t timeout) {
+	test_thread_t *t = (test_thread_t *)thread;
+	struct timespec abstime;
+	uint64_t deadline;
+
+	deadline = pth_now() + ((timeout == WAITQ_FOREVER)?3600000000ULL:timeout);
+	abstime.tv_sec = deadline / 1000000;
+	abstime.tv_nsec = (deadline % 1000000) * 1000;
+
+	pthread_mutex_lock(&t->mtx);
+	while (!t->count) {
+		if (pthread_cond_timedwait(&t->cond, &t->mtx, &abstime)) break;
+	}
+
+	if (t->count) {
+		t->count--;
+	}
+	pthread_mutex_unlock(&t->mtx);
+}
+
+static const waitq_ops_t ops = {pth_lock, pth_unlock, pth_self, pth_wake, pth_block, pth_now};
+
+// The same operations, with the wake up set by the caller for each wait
+static const waitq_ops_t waiter_ops = {pth_lock, pth_unlock, NULL, pth_wake, pth_block, pth_now};
+
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static waitq_t queue;
+
+/*
+ * Order test
+ */
+static volatile int order[ORDER_WAITERS];
+static volatile int finished;
+
+static void *order_waiter(void *arg) {
+	waitq_waiter_t waiter;
+
+	waitq_prepare(&ops, &queue_lock, &queue, &waiter);
+	TEST_ASSERT(waitq_wait(&ops, &queue_lock, &queue, &waiter, WAITQ_FOREVER) == 0);
+
+	pthread_mutex_lock(&queue_lock);
+	order[finished++] = (int)(intptr_t)arg;
+	pthread_mutex_unlock(&queue_lock);
+
+	pth_release();
+
+	return NULL;
+}
+
+static int get_finished() {
+	int n;
+
+	pthread_mutex_lock(&queue_lock);
+	n = finished;
+	pthread_mutex_unlock(&queue_lock);
+
+	return n;
+}
+
+static uint32_t get_waiters() {
+	uint32_t n;
+
+	pthread_mutex_lock(&queue_lock);
+	n = queue.waiters;
+	pthread_mutex_unlock(&queue_lock);
+
+	return n;
+}
+
+/*
+ * Benchmark: consumers wait on a condition protected by a mutex, and a
+ * producer posts one token at a time
+ */
+static pthread_mutex_t bench_mtx = PTHREAD_MUTEX_INITIALIZER;
+
+// Protected by bench_mtx
+static int tokens;
+static int stop;
+static uint64_t posted_at;
+static uint64_t latency;
+static uint32_t wakeups;
+
+static void *consumer(void *arg) {
+	waitq_waiter_t waiter;
+
+	pthread_mutex_lock(&bench_mtx);
+	for(;;) {
+		while (!tokens && !stop) {
+			waitq_prepare(&ops, &queue_lock, &queue, &waiter);
+			pthread_mutex_unlock(&bench_mtx);
+			waitq_wait(&ops, &queue_lock, &queue, &waiter, WAITQ_FOREVER);
+			pthread_mutex_lock(&bench_mtx);
+			wakeups++;
+		}
+
+		if (stop) break;
+
+		tokens--;
+		latency += pth_now() - posted_at;
+	}
+	pthread_mutex_unlock(&bench_mtx);
+
+	pth_release();
+
+	return NULL;
+}
+
+static int get_tokens() {
+	int n;
+
+	pthread_mutex_lock(&bench_mtx);
+	n = tokens;
+	pthread_mutex_unlock(&bench_mtx);
+
+	return n;
+}
+
+static void bench(int all, uint32_t *bench_wakeups, uint64_t *bench_latency) {
+	pthread_t threads[BENCH_WAITERS];
+	int i;
+
+	waitq_init(&queue);
+	tokens = 0;
+	stop = 0;
+	latency = 0;
+	wakeups = 0;
+
+	for(i = 0;i < BENCH_WAITERS;i++) {
+		TEST_ASSERT(pthread_create(&threads[i], NULL, consumer, NULL) == 0);
+	}
+
+	while (get_waiters() < BENCH_WAITERS) {
+		usleep(1000);
+	}
+
+	for(i = 0;i < BENCH_ROUNDS;i++) {
+		pthread_mutex_lock(&bench_mtx);
+		tokens++;
+		posted_at = pth_now();
+		pthread_mutex_unlock(&bench_mtx);
+
+		if (all) {
+			waitq_wake_all(&ops, &queue_lock, &queue);
+		} else {
+			waitq_wake_one(&ops, &queue_lock, &queue);
+		}
+
+		// Wait until the token is consumed, and every consumer is waiting
+		// again, so each round starts from the same state
+		while (get_tokens() || (get_waiters() < BENCH_WAITERS)) {
+			usleep(0);
+		}
+	}
+
+	pthread_mutex_lock(&bench_mtx);
+	stop = 1;
+	pthread_mutex_unlock(&bench_mtx);
+	waitq_wake_all(&ops, &queue_lock, &queue);
+
+	for(i = 0;i < BENCH_WAITERS;i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	*bench_wakeups = wakeups - BENCH_WAITERS;
+	*bench_latency = latency / BENCH_ROUNDS;
+}
+
+TEST_CASE("wait queue order", "[waitq]") {
+	pthread_t threads[ORDER_WAITERS];
+	int i;
+
+	waitq_init(&queue);
+	finished = 0;
+
+	// Queue the waiters one by one, so the arrival order is known
+	for(i = 0;i < ORDER_WAITERS;i++) {
+		TEST_ASSERT(pthread_create(&threads[i], NULL, order_waiter, (void *)(intptr_t)i) == 0);
+		while (get_waiters() < (uint32_t)(i + 1)) {
+			usleep(1000);
+		}
+	}
+
+	// Each wake up releases the oldest waiter, and only that one
+	for(i = 0;i < ORDER_WAITERS;i++) {
+		TEST_ASSERT(waitq_wake_one(&ops, &queue_lock, &queue) == 1);
+		while (get_finished() < i + 1) {
+			usleep(1000);
+		}
+
+		usleep(10000);
+		TEST_ASSERT(get_finished() == i + 1);
+		TEST_ASSERT(order[i] == i);
+		TEST_ASSERT(queue.waiters == (uint32_t)(ORDER_WAITERS - i - 1));
+	}
+
+	TEST_ASSERT(waitq_wake_one(&ops, &queue_lock, &queue) == 0);
+	TEST_ASSERT(queue.wakeups == ORDER_WAITERS);
+
+	for(i = 0;i < ORDER_WAITERS;i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	// Broadcast
+	finished = 0;
+	for(i = 0;i < ORDER_WAITERS;i++) {
+		TEST_ASSERT(pthread_create(&threads[i], NULL, order_waiter, (void *)(intptr_t)i) == 0);
+		while (get_waiters() < (uint32_t)(i + 1)) {
+			usleep(1000);
+		}
+	}
+
+	TEST_ASSERT(waitq_wake_all(&ops, &queue_lock, &queue) == ORDER_WAITERS);
+	TEST_ASSERT(queue.waiters == 0);
+
+	for(i = 0;i < ORDER_WAITERS;i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	TEST_ASSERT(finished == ORDER_WAITERS);
+}
+
+TEST_CASE("wait queue timeouts", "[waitq]") {
+	waitq_waiter_t waiter;
+	uint64_t start, elapsed;
+
+	waitq_init(&queue);
+
+	// Deadline reached
+	start = pth_now();
+	waitq_prepare(&ops, &queue_lock, &queue, &waiter);
+	TEST_ASSERT(queue.waiters == 1);
+	TEST_ASSERT(waitq_wait(&ops, &queue_lock, &queue, &waiter, start + 20000) == -1);
+	elapsed = pth_now() - start;
+
+	TEST_ASSERT(elapsed >= 20000);
+	TEST_ASSERT(queue.waiters == 0);
+	TEST_ASSERT(queue.head == NULL);
+	TEST_ASSERT(queue.timeouts == 1);
+
+	// Deadline in the past
+	waitq_prepare(&ops, &queue_lock, &queue, &waiter);
+	TEST_ASSERT(waitq_wait(&ops, &queue_lock, &queue, &waiter, start) == -1);
+	TEST_ASSERT(queue.waiters == 0);
+
+	// A wake up left from other wait returns the block early, the wait
+	// goes on until the deadline
+	pth_wake(pth_self());
+
+	start = pth_now();
+	waitq_prepare(&ops, &queue_lock, &queue, &waiter);
+	TEST_ASSERT(waitq_wait(&ops, &queue_lock, &queue, &waiter, start + 20000) == -1);
+	elapsed = pth_now() - start;
+
+	TEST_ASSERT(elapsed >= 20000);
+	TEST_ASSERT(queue.spurious == 1);
+	TEST_ASSERT(queue.timeouts == 3);
+
+	// Woken up before waiting
+	waitq_prepare(&ops, &queue_lock, &queue, &waiter);
+	TEST_ASSERT(waitq_wake_one(&ops, &queue_lock, &queue) == 1);
+	TEST_ASSERT(waitq_wait(&ops, &queue_lock, &queue, &waiter, pth_now() + 20000) == 0);
+	TEST_ASSERT(queue.waiters == 0);
+
+	// Consume the wake up, it is not needed anymore
+	pth_block(pth_self(), 0);
+
+	pth_release();
+}
+
+TEST_CASE("wait queue wake up of the waiter", "[waitq]") {
+	test_thread_t wake;
+	waitq_waiter_t waiter;
+	uint64_t start;
+
+	memset(&wake, 0, sizeof(wake));
+	pthread_mutex_init(&wake.mtx, NULL);
+	pthread_cond_init(&wake.cond, NULL);
+
+	waitq_init(&queue);
+
+	// The waiter keeps the wake up set by the caller
+	waiter.thread = &wake;
+	waitq_prepare(&waiter_ops, &queue_lock, &queue, &waiter);
+	TEST_ASSERT(waiter.thread == &wake);
+	TEST_ASSERT(waitq_wake_one(&waiter_ops, &queue_lock, &queue) == 1);
+	TEST_ASSERT(waitq_wait(&waiter_ops, &queue_lock, &queue, &waiter, pth_now() + 20000) == 0);
+	TEST_ASSERT(wake.count == 1);
+
+	// A new wait with a new wake up doesn't see the wake up of the last one
+	wake.count = 0;
+	start = pth_now();
+	waiter.thread = &wake;
+	waitq_prepare(&waiter_ops, &queue_lock, &queue, &waiter);
+	TEST_ASSERT(waitq_wait(&waiter_ops, &queue_lock, &queue, &waiter, start + 20000) == -1);
+	TEST_ASSERT(pth_now() - start >= 20000);
+	TEST_ASSERT(queue.spurious == 0);
+	TEST_ASSERT(queue.timeouts == 1);
+
+	pthread_cond_destroy(&wake.cond);
+	pthread_mutex_destroy(&wake.mtx);
+}
+
+TEST_CASE("wait queue wake-up latency", "[waitq]") {
+	uint32_t one_wakeups, all_wakeups;
+	uint64_t one_latency, all_latency;
+
+	bench(0, &one_wakeups, &one_latency);
+	bench(1, &all_wakeups, &all_latency);
+
+	printf("%d consumers, %d tokens\n", BENCH_WAITERS, BENCH_ROUNDS);
+	printf("wake one: %u wake-ups, %llu usecs average latency\n", one_wakeups, (unsigned long long)one_latency);
+	printf("wake all: %u wake-ups, %llu usecs average latency\n", all_wakeups, (unsigned long long)all_latency);
+
+	// Waking one waiter per token wakes a consumer per token, waking all
+	// the waiters wakes every consumer per token
+	TEST_ASSERT(one_wakeups == BENCH_ROUNDS);
+	TEST_ASSERT(all_wakeups == BENCH_ROUNDS * BENCH_WAITERS);
+}
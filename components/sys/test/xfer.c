@@ -0,0 +1,430 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, windowed file transfer test cases
+ *
+ * The serial link is emulated with two pty pairs joined by a line that
+ * delays the bytes as a UART (baud rate, and latency of the USB bridge),
+ * so it can only run on a Linux host.
+ *
+ */
+
+#include "unity.h"
+
+#if defined(__linux__)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pty.h>
+#include <termios.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include <sys/xfer.h>
+
+#define TEST_SIZE     32768
+#define LINE_BAUD     921600
+#define LINE_LATENCY  2000
+#define LINE_CHUNKS   256
+
+static uint64_t now_us() {
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+
+	return tv.tv_sec * 1000000ULL + tv.tv_usec;
+}
+
+/*
+ * Emulated line, in one direction
+ */
+typedef struct {
+	int in;
+	int out;
+	int corrupt;          // Corrupt 1 chunk out of corrupt, 0 for none
+	int drop_end;         // Drop the chunks with an END frame, up to drop_end
+	volatile int stop;
+	pthread_t thread;
+} line_t;
+
+typedef struct {
+	uint64_t at;
+	int len;
+	uint8_t data[256];
+} line_chunk_t;
+
+static void write_all(int fd, const uint8_t *buf, int len) {
+	int n;
+
+	while (len > 0) {
+		n = write(fd, buf, len);
+		if (n <= 0) break;
+
+		buf += n;
+		len -= n;
+	}
+}
+
+static int has_end(const uint8_t *buf, int len) {
+	int i;
+
+	for(i = 0;i + 1 < len;i++) {
+		if ((buf[i] == XFER_SYNC) && (buf[i + 1] == XFER_END)) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static void *line_thread(void *arg) {
+	line_t *line = (line_t *)arg;
+	line_chunk_t *queue = calloc(LINE_CHUNKS, sizeof(line_chunk_t));
+	struct pollfd pfd;
+	uint64_t now, wire = 0;
+	uint32_t chunks = 0;
+	int head = 0, tail = 0;
+	int timeout;
+	int n;
+
+	while (!line->stop) {
+		now = now_us();
+
+		timeout = 10;
+		if (head != tail) {
+			timeout = (queue[head].at > now)?(queue[head].at - now + 999) / 1000:0;
+		}
+
+		if (((tail + 1) % LINE_CHUNKS) != head) {
+			pfd.fd = line->in;
+			pfd.events = POLLIN;
+
+			if (poll(&pfd, 1, timeout) > 0) {
+				n = read(line->in, queue[tail].data, sizeof(queue[tail].data));
+				if (n > 0) {
+					// The bytes leave the wire when the previous ones are
+					// sent, at 10 bits per byte
+					if (wire < now) {
+						wire = now;
+					}
+
+					wire += (n * 10 * 1000000ULL) / LINE_BAUD;
+
+					queue[tail].at = wire + LINE_LATENCY;
+					queue[tail].len = n;
+
+					if (line->corrupt && ((++chunks % line->corrupt) == 0)) {
+						queue[tail].data[n / 2] ^= 0x10;
+					}
+
+					if (line->drop_end && has_end(queue[tail].data, n)) {
+						line->drop_end--;
+						continue;
+					}
+
+					tail = (tail + 1) % LINE_CHUNKS;
+				}
+			}
+		} else {
+			usleep(timeout * 1000);
+		}
+
+		now = now_us();
+		while ((head != tail) && (queue[head].at <= now)) {
+			write_all(line->out, queue[head].data, queue[head].len);
+			head = (head + 1) % LINE_CHUNKS;
+		}
+	}
+
+	free(queue);
+
+	return NULL;
+}
+
+/*
+ * End points, with the file in memory
+ */
+typedef struct {
+	int fd;
+	uint8_t *file;
+	uint32_t size;
+} endpoint_t;
+
+static int ep_read(void *arg, uint8_t *buf, int len, uint32_t timeout) {
+	endpoint_t *ep = (endpoint_t *)arg;
+	struct pollfd pfd;
+
+	pfd.fd = ep->fd;
+	pfd.events = POLLIN;
+
+	if (poll(&pfd, 1, timeout) <= 0) {
+		return 0;
+	}
+
+	return read(ep->fd, buf, len);
+}
+
+static void ep_write(void *arg, const uint8_t *buf, int len) {
+	write_all(((endpoint_t *)arg)->fd, buf, len);
+}
+
+static int ep_file_read(void *arg, uint32_t offset, uint8_t *buf, int len) {
+	endpoint_t *ep = (endpoint_t *)arg;
+
+	if (offset >= ep->size) {
+		return 0;
+	}
+
+	if (offset + len > ep->size) {
+		len = ep->size - offset;
+	}
+
+	memcpy(buf, ep->file + offset, len);
+
+	return len;
+}
+
+static int ep_file_write(void *arg, uint32_t offset, const uint8_t *buf, int len) {
+	endpoint_t *ep = (endpoint_t *)arg;
+
+	if ((offset != ep->size) || (offset + len > TEST_SIZE)) {
+		return -1;
+	}
+
+	memcpy(ep->file + offset, buf, len);
+	ep->size += len;
+
+	return 0;
+}
+
+static uint32_t ep_now(void *arg) {
+	return now_us() / 1000;
+}
+
+/*
+ * Transfer
+ */
+static uint8_t source[TEST_SIZE];
+static uint8_t dest[TEST_SIZE];
+
+typedef struct {
+	xfer_ops_t ops;
+	xfer_config_t config;
+	uint32_t offset;
+	xfer_stats_t stats;
+	int res;
+} receiver_t;
+
+static void *receiver_thread(void *arg) {
+	receiver_t *r = (receiver_t *)arg;
+
+	r->res = xfer_receive(&r->ops, &r->config, r->offset, &r->stats);
+
+	return NULL;
+}
+
+static int open_pty(int *master, int *slave) {
+	struct termios tio;
+
+	if (openpty(master, slave, NULL, NULL, NULL) < 0) {
+		return -1;
+	}
+
+	tcgetattr(*slave, &tio);
+	cfmakeraw(&tio);
+	tcsetattr(*slave, TCSANOW, &tio);
+
+	return 0;
+}
+
+static int transfer(xfer_config_t *config, uint32_t offset, int corrupt, int drop_end, xfer_stats_t *stats, xfer_stats_t *rstats) {
+	int master[2], slave[2];
+	line_t line[2];
+	endpoint_t sender, receiver;
+	receiver_t r;
+	pthread_t thread;
+	int res, i;
+
+	TEST_ASSERT(open_pty(&master[0], &slave[0]) == 0);
+	TEST_ASSERT(open_pty(&master[1], &slave[1]) == 0);
+
+	// Sender -> receiver, and receiver -> sender
+	memset(line, 0, sizeof(line));
+	line[0].in = master[0];
+	line[0].out = master[1];
+	line[0].corrupt = corrupt;
+	line[1].in = master[1];
+	line[1].out = master[0];
+	line[1].drop_end = drop_end;
+
+	for(i = 0;i < 2;i++) {
+		pthread_create(&line[i].thread, NULL, line_thread, &line[i]);
+	}
+
+	sender.fd = slave[0];
+	sender.file = source;
+	sender.size = TEST_SIZE;
+
+	receiver.fd = slave[1];
+	receiver.file = dest;
+	receiver.size = offset;
+
+	memset(&r, 0, sizeof(r));
+	r.ops.read = ep_read;
+	r.ops.write = ep_write;
+	r.ops.file_read = ep_file_read;
+	r.ops.file_write = ep_file_write;
+	r.ops.now = ep_now;
+	r.ops.arg = &receiver;
+	r.config = *config;
+	r.config.window = 8;
+	r.offset = offset;
+
+	pthread_create(&thread, NULL, receiver_thread, &r);
+
+	xfer_ops_t ops = r.ops;
+	ops.arg = &sender;
+
+	res = xfer_send(&ops, config, stats);
+
+	pthread_join(thread, NULL);
+
+	for(i = 0;i < 2;i++) {
+		line[i].stop = 1;
+		pthread_join(line[i].thread, NULL);
+		close(master[i]);
+		close(slave[i]);
+	}
+
+	TEST_ASSERT(r.res == XFER_OK);
+	TEST_ASSERT(receiver.size == TEST_SIZE);
+	TEST_ASSERT(memcmp(source, dest, TEST_SIZE) == 0);
+
+	*rstats = r.stats;
+
+	return res;
+}
+
+static void fill_source() {
+	int i, len = 0;
+
+	// Source code like data, that deflates
+	srand(1);
+	for(i = 0;len < TEST_SIZE;i++) {
+		len += snprintf((char *)source + len, TEST_SIZE - len, "local v%d = sensor.read(%d) * %d -- %x\n", i, rand() % 8, rand() % 1000, rand());
+	}
+}
+
+static void print_stats(const char *name, xfer_stats_t *stats) {
+	printf("%s: %u bytes in %u msecs (%u Kbytes/s), %u frames, %u wire bytes, %u retransmissions\n",
+		name, stats->size - stats->offset, stats->elapsed,
+		stats->elapsed?(stats->size - stats->offset) / stats->elapsed:0,
+		stats->frames, stats->wire_bytes, stats->retransmissions);
+}
+
+TEST_CASE("file transfer throughput", "[xfer]") {
+	xfer_stats_t stop_wait, windowed, deflated, rstats;
+	xfer_config_t config;
+
+	fill_source();
+
+	xfer_config_default(&config);
+	config.timeout = 200;
+
+	printf("%d bytes, %d bauds, %d usecs latency\n", TEST_SIZE, LINE_BAUD, LINE_LATENCY);
+
+	// A frame at once, as the legacy protocol
+	config.window = 1;
+	TEST_ASSERT(transfer(&config, 0, 0, 0, &stop_wait, &rstats) == XFER_OK);
+	print_stats("stop and wait", &stop_wait);
+
+	config.window = 8;
+	TEST_ASSERT(transfer(&config, 0, 0, 0, &windowed, &rstats) == XFER_OK);
+	print_stats("window 8", &windowed);
+	TEST_ASSERT(windowed.retransmissions == 0);
+
+	config.deflate = 1;
+	TEST_ASSERT(transfer(&config, 0, 0, 0, &deflated, &rstats) == XFER_OK);
+	print_stats("window 8, deflate", &deflated);
+
+	TEST_ASSERT(windowed.size == TEST_SIZE);
+	TEST_ASSERT(windowed.elapsed * 10 < stop_wait.elapsed * 8);
+	TEST_ASSERT(deflated.wire_bytes < windowed.wire_bytes);
+	TEST_ASSERT(rstats.wire_bytes == deflated.wire_bytes);
+}
+
+TEST_CASE("file transfer errors", "[xfer]") {
+	xfer_stats_t stats, rstats;
+	xfer_config_t config;
+
+	fill_source();
+
+	xfer_config_default(&config);
+	config.timeout = 100;
+	config.window = 8;
+
+	// Corrupted bytes
+	memset(dest, 0, sizeof(dest));
+	TEST_ASSERT(transfer(&config, 0, 10, 0, &stats, &rstats) == XFER_OK);
+	print_stats("corrupted", &stats);
+	TEST_ASSERT(rstats.crc_errors > 0);
+	TEST_ASSERT(stats.retransmissions > 0);
+
+	// Resume
+	memset(dest, 0, sizeof(dest));
+	memcpy(dest, source, 10000);
+	TEST_ASSERT(transfer(&config, 10000, 0, 0, &stats, &rstats) == XFER_OK);
+	print_stats("resumed", &stats);
+	TEST_ASSERT(stats.offset == 10000);
+	TEST_ASSERT(rstats.frames == (uint32_t)((TEST_SIZE - 10000 + config.frame_size - 1) / config.frame_size));
+
+	// Lost END echoes, the sender sends the END frame again
+	memset(dest, 0, sizeof(dest));
+	TEST_ASSERT(transfer(&config, 0, 0, 2, &stats, &rstats) == XFER_OK);
+	print_stats("lost end", &stats);
+	TEST_ASSERT(stats.size == TEST_SIZE);
+}
+
+#endif
@@ -0,0 +1,313 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, file copy
+ *
+ */
+
+#include <sys/vfs/copy.h>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+
+/*
+ * Helper functions
+ */
+
+// Allocate the copy buffer, halving its size until it fits in memory
+static int alloc_buffer(vfs_copy_t *copy) {
+    size_t size = copy->buffer_size;
+
+    if (copy->buf) {
+        return 0;
+    }
+
+    if (size < VFS_COPY_MIN_BUFFER_SIZE) {
+        size = VFS_COPY_MIN_BUFFER_SIZE;
+    }
+
+    while (!(copy->buf = malloc(size))) {
+        if (size == VFS_COPY_MIN_BUFFER_SIZE) {
+            errno = ENOMEM;
+            return -1;
+        }
+
+        size /= 2;
+        if (size < VFS_COPY_MIN_BUFFER_SIZE) {
+            size = VFS_COPY_MIN_BUFFER_SIZE;
+        }
+    }
+
+    copy->buffer_size = size;
+    copy->stats.buffer = size;
+
+    return 0;
+}
+
+static int progress(vfs_copy_t *copy, const char *path, uint32_t done, uint32_t total) {
+    if (copy->progress && copy->progress(copy->arg, path, done, total)) {
+        errno = ECANCELED;
+        return -1;
+    }
+
+    return 0;
+}
+
+static int copy_file_generic(vfs_copy_t *copy, const char *src, const char *dst, struct stat *st) {
+    uint32_t done = 0;
+    ssize_t size, written;
+    uint8_t *cbuf;
+    int fsrc, fdst;
+    int err = 0;
+
+    if (alloc_buffer(copy) < 0) {
+        return -1;
+    }
+
+    fsrc = open(src, O_RDONLY);
+    if (fsrc < 0) {
+        return -1;
+    }
+
+    fdst = open(dst, O_WRONLY | O_CREAT | O_TRUNC, st->st_mode & 0777);
+    if (fdst < 0) {
+        err = errno;
+        close(fsrc);
+        errno = err;
+        return -1;
+    }
+
+    while ((size = read(fsrc, copy->buf, copy->buffer_size)) > 0) {
+        // Write the chunk, write can write less bytes than requested
+        cbuf = copy->buf;
+        while (size > 0) {
+            written = write(fdst, cbuf, size);
+            if (written <= 0) {
+                err = written?errno:ENOSPC;
+                break;
+            }
+
+            cbuf += written;
+            size -= written;
+            done += written;
+        }
+
+        if (err) {
+            break;
+        }
+
+        if (progress(copy, src, done, st->st_size) < 0) {
+            err = errno;
+            break;
+        }
+    }
+
+    if ((size < 0) && !err) {
+        err = errno;
+    }
+
+    if ((close(fdst) < 0) && !err) {
+        err = errno;
+    }
+
+    close(fsrc);
+
+    if (err) {
+        // Don't leave a partial copy
+        unlink(dst);
+        errno = err;
+        return -1;
+    }
+
+    copy->stats.bytes += done;
+
+    return 0;
+}
+
+static int copy_file(vfs_copy_t *copy, const char *src, const char *dst, struct stat *st) {
+    if (copy->file) {
+        if (copy->file(copy->arg, src, dst) == 0) {
+            copy->stats.files++;
+            copy->stats.fast++;
+            copy->stats.bytes += st->st_size;
+
+            return progress(copy, src, st->st_size, st->st_size);
+        }
+
+        if (errno != ENOTSUP) {
+            return -1;
+        }
+    }
+
+    if (copy_file_generic(copy, src, dst, st) < 0) {
+        return -1;
+    }
+
+    copy->stats.files++;
+
+    return 0;
+}
+
+// Build the path of a directory entry
+static char *entry_path(const char *dir, const char *name) {
+    char *path;
+
+    if (strlen(dir) + strlen(name) + 1 > PATH_MAX) {
+        errno = ENAMETOOLONG;
+        return NULL;
+    }
+
+    path = malloc(strlen(dir) + strlen(name) + 2);
+    if (!path) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    strcpy(path, dir);
+    strcat(path, "/");
+    strcat(path, name);
+
+    return path;
+}
+
+static int copy_entry(vfs_copy_t *copy, const char *src, const char *dst) {
+    char *src_path, *dst_path;
+    struct dirent *ent;
+    struct stat st;
+    int ret = 0;
+    int err;
+    DIR *dir;
+
+    if (stat(src, &st) < 0) {
+        return -1;
+    }
+
+    if (!S_ISDIR(st.st_mode)) {
+        return copy_file(copy, src, dst, &st);
+    }
+
+    if (!copy->recursive) {
+        errno = EISDIR;
+        return -1;
+    }
+
+    if (mkdir(dst, 0755) < 0) {
+        err = errno;
+
+        // Merge with an existing directory
+        if ((err != EEXIST) || (stat(dst, &st) < 0) || !S_ISDIR(st.st_mode)) {
+            errno = (err == EEXIST)?ENOTDIR:err;
+            return -1;
+        }
+    }
+
+    copy->stats.dirs++;
+
+    dir = opendir(src);
+    if (!dir) {
+        return -1;
+    }
+
+    while ((ent = readdir(dir))) {
+        if ((strcmp(ent->d_name, ".") == 0) || (strcmp(ent->d_name, "..") == 0)) {
+            continue;
+        }
+
+        src_path = entry_path(src, ent->d_name);
+        dst_path = entry_path(dst, ent->d_name);
+
+        if (src_path && dst_path) {
+            ret = copy_entry(copy, src_path, dst_path);
+        } else {
+            ret = -1;
+        }
+
+        err = errno;
+        free(src_path);
+        free(dst_path);
+        errno = err;
+
+        if (ret < 0) {
+            break;
+        }
+    }
+
+    err = errno;
+    closedir(dir);
+    errno = err;
+
+    return ret;
+}
+
+/*
+ * Operation functions
+ */
+
+void vfs_copy_init(vfs_copy_t *copy) {
+    memset(copy, 0, sizeof(vfs_copy_t));
+
+    copy->buffer_size = VFS_COPY_BUFFER_SIZE;
+}
+
+int vfs_copy(vfs_copy_t *copy, const char *src, const char *dst) {
+    int ret;
+    int err;
+
+    ret = copy_entry(copy, src, dst);
+
+    err = errno;
+
+    if (copy->buf) {
+        free(copy->buf);
+        copy->buf = NULL;
+    }
+
+    errno = err;
+
+    return ret;
+}
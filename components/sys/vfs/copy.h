@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, file copy
+ *
+ * Copies a file, or a directory tree, using only the POSIX file functions,
+ * so it works across any of the mounted file systems. Files are copied with
+ * read / write calls of a large buffer, that is allocated once for the whole
+ * copy, and is halved if there is not enough memory for it.
+ *
+ * A file system can provide a faster way to copy a file when the source
+ * and the destination are in the same file system (for example, sharing
+ * the file blocks instead of copying them). It is used through the file
+ * function of the copy context, and if it can't copy a file, the generic
+ * copy is used. A file copied this way is done in one call, so the progress
+ * function is called only once for it, and it can't be canceled in the
+ * middle. File systems that need to move the file data don't provide a
+ * file function.
+ *
+ */
+
+#ifndef _SYS_VFS_COPY_H
+#define _SYS_VFS_COPY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Default size of the copy buffer
+#define VFS_COPY_BUFFER_SIZE 4096
+
+// Smallest copy buffer, if there is not memory for a bigger one
+#define VFS_COPY_MIN_BUFFER_SIZE 128
+
+/**
+ * @brief Progress function, called after each chunk of a file is copied, or
+ *        once for a file copied by the file copy function.
+ *
+ * @param arg Argument of the copy context.
+ * @param path Source file.
+ * @param done Bytes copied of the file.
+ * @param total Size of the file.
+ *
+ * @return 0 to continue, or other value to cancel the copy.
+ */
+typedef int (*vfs_copy_progress_f_t)(void *arg, const char *path, uint32_t done, uint32_t total);
+
+/**
+ * @brief File copy function of a file system.
+ *
+ * @param arg Argument of the copy context.
+ * @param src Source file.
+ * @param dst Destination file.
+ *
+ * @return
+ *    Returns the value 0 if successful; otherwise the value -1 is returned and errno
+ *    is set to indicate the error. If errno is ENOTSUP the generic copy is used.
+ */
+typedef int (*vfs_copy_file_f_t)(void *arg, const char *src, const char *dst);
+
+typedef struct {
+    uint32_t files;       ///< Files copied
+    uint32_t dirs;        ///< Directories copied
+    uint32_t bytes;       ///< Bytes copied
+    uint32_t fast;        ///< Files copied by the file copy function
+    uint32_t buffer;      ///< Size of the buffer used, 0 if it was not needed
+} vfs_copy_stats_t;
+
+typedef struct {
+    size_t buffer_size;              ///< Size of the copy buffer
+    uint8_t recursive;               ///< Copy directories
+    vfs_copy_progress_f_t progress;  ///< Progress function, or NULL
+    vfs_copy_file_f_t file;          ///< File copy function, or NULL
+    void *arg;                       ///< Argument for progress and file
+    vfs_copy_stats_t stats;
+
+    uint8_t *buf;                    ///< Copy buffer, allocated when needed
+} vfs_copy_t;
+
+/**
+ * @brief Initialize a copy context with the default values: a buffer of
+ *        VFS_COPY_BUFFER_SIZE bytes, not recursive, and without progress
+ *        and file copy functions.
+ *
+ * @param copy Copy context.
+ */
+void vfs_copy_init(vfs_copy_t *copy);
+
+/**
+ * @brief Copy a file, or a directory if the copy is recursive. The
+ *        destination is the path of the copy, an existing file is
+ *        replaced, and the contents of a directory are merged with an
+ *        existing directory. If a file can't be copied, the partial copy
+ *        is removed.
+ *
+ * @param copy Copy context. The statistics are updated with the copy.
+ * @param src Source path.
+ * @param dst Destination path.
+ *
+ * @return
+ *    Returns the value 0 if successful; otherwise the value -1 is returned and errno
+ *    is set to indicate the error:
+ *
+ *    EISDIR: src is a directory, and the copy is not recursive.
+ *    ECANCELED: the progress function canceled the copy.
+ */
+int vfs_copy(vfs_copy_t *copy, const char *src, const char *dst);
+
+#endif /* _SYS_VFS_COPY_H */
@@ -631,4 +631,15 @@ int vfs_ramfs_fsstat(const char *target, u32_t *total, u32_t *used) {
     return 0;
 }
 
+int vfs_ramfs_copy(const char *src, const char *dst) {
+    int result;
+
+    if ((result = ramfs_copy(&fs, src, dst)) < 0) {
+        errno = ramfs_to_errno(result);
+        return -1;
+    }
+
+    return 0;
+}
+
 #endif
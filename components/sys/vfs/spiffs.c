@@ -1220,9 +1220,9 @@ int vfs_spiffs_mount(const char *target) {
     }
 
     // Init mutex
-    mtx_init(&vfs_mtx, NULL, NULL, MTX_RECURSE);
+    mtx_init(&vfs_mtx, "spiffs", NULL, MTX_RECURSE);
 
-    mtx_init(&ll_mtx, NULL, NULL, 0);
+    mtx_init(&ll_mtx, "spiffs_ll", NULL, 0);
     fs.user_data = &ll_mtx;
 
     while (retries < 2) {
@@ -1295,7 +1295,7 @@ int vfs_spiffs_umount(const char *target) {
 int vfs_spiffs_format(const char *target) {
     vfs_spiffs_umount(target);
 
-    mtx_init(&ll_mtx, NULL, NULL, 0);
+    mtx_init(&ll_mtx, "spiffs_ll", NULL, 0);
 
     int res = SPIFFS_format(&fs);
     if (res < 0) {
@@ -108,6 +108,7 @@ int vfs_ramfs_mount(const char *target);
 int vfs_ramfs_umount(const char *target);
 int vfs_ramfs_format(const char *target);
 int vfs_ramfs_fsstat(const char *target, u32_t *total, u32_t *used);
+int vfs_ramfs_copy(const char *src, const char *dst);
 
 int vfs_romfs_mount(const char *target);
 int vfs_romfs_umount(const char *target);
@@ -0,0 +1,320 @@
+/*
+ * Copyright (C) 2015 - 2018, IBEROXARXA SERVICIOS INTEGRALES, S.L.
+ * Copyright (C) 2015 - 2018, Jaume Olivé Petrus (jolive@whitecatboard.org)
+ *
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of the <organization> nor the
+ *       names of its contributors may be used to endorse or promote products
+ *       derived from this software without specific prior written permission.
+ *     * The WHITECAT logotype cannot be changed, you can remove it, but you
+ *       cannot change it in any way. The WHITECAT logotype is:
+ *
+ *          /\       /\
+ *         /  \_____/  \
+ *        /_____________\
+ *        W H I T E C A T
+ *
+ *     * Redistributions in binary form must retain all copyright notices printed
+ *       to any local or remote output device. This include any reference to
+ *       Lua RTOS, whitecatboard.org, Lua, and other copyright notices that may
+ *       appear in the future.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ * DISCLAIMED. IN NO EVENT SHALL <COPYRIGHT HOLDER> BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ * (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ * LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Lua RTOS, host side of the windowed file transfer
+ *
+ * Copies files to / from a board through its console, with the io.xreceive
+ * and io.xsend functions, using the same transfer code as the board.
+ *
+ * Build:
+ *
+ *   cc -O2 -Icomponents/sys -o xfer tools/xfer.c components/sys/sys/xfer.c -lz
+ *
+ * Usage:
+ *
+ *   xfer -p port [-b baud] [-z] [-r] put local remote
+ *   xfer -p port [-b baud] [-z] [-r] get remote local
+ *
+ *   -z  deflate the frames (get: the board deflates them)
+ *   -r  resume an interrupted transfer, from the end of the destination file
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+
+#include <sys/xfer.h>
+
+typedef struct {
+    int fd;
+    FILE *f;
+    uint32_t pos;
+} link_t;
+
+static int link_read(void *arg, uint8_t *buf, int len, uint32_t timeout) {
+    link_t *link = (link_t *)arg;
+    struct pollfd pfd;
+    int n;
+
+    pfd.fd = link->fd;
+    pfd.events = POLLIN;
+
+    if (poll(&pfd, 1, timeout) <= 0) {
+        return 0;
+    }
+
+    n = read(link->fd, buf, len);
+
+    return (n < 0)?0:n;
+}
+
+static void link_write(void *arg, const uint8_t *buf, int len) {
+    link_t *link = (link_t *)arg;
+    int n;
+
+    while (len > 0) {
+        n = write(link->fd, buf, len);
+        if (n <= 0) break;
+
+        buf += n;
+        len -= n;
+    }
+}
+
+static int link_file_read(void *arg, uint32_t offset, uint8_t *buf, int len) {
+    link_t *link = (link_t *)arg;
+    size_t n;
+
+    if ((offset != link->pos) && (fseek(link->f, offset, SEEK_SET) != 0)) {
+        return -1;
+    }
+
+    n = fread(buf, 1, len, link->f);
+    if ((n == 0) && ferror(link->f)) {
+        return -1;
+    }
+
+    link->pos = offset + n;
+
+    return n;
+}
+
+static int link_file_write(void *arg, uint32_t offset, const uint8_t *buf, int len) {
+    link_t *link = (link_t *)arg;
+
+    if ((offset != link->pos) || (fwrite(buf, 1, len, link->f) != (size_t)len)) {
+        return -1;
+    }
+
+    link->pos += len;
+
+    return 0;
+}
+
+static uint32_t link_now(void *arg) {
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+
+    return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+static speed_t baud_rate(int baud) {
+    switch (baud) {
+        case 9600:    return B9600;
+        case 19200:   return B19200;
+        case 38400:   return B38400;
+        case 57600:   return B57600;
+        case 115200:  return B115200;
+        case 230400:  return B230400;
+#ifdef B460800
+        case 460800:  return B460800;
+#endif
+#ifdef B921600
+        case 921600:  return B921600;
+#endif
+    }
+
+    return 0;
+}
+
+static int open_port(const char *port, int baud) {
+    struct termios tio;
+    int fd;
+
+    fd = open(port, O_RDWR | O_NOCTTY);
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (tcgetattr(fd, &tio) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    cfmakeraw(&tio);
+    cfsetspeed(&tio, baud_rate(baud));
+    tio.c_cflag |= CLOCAL | CREAD;
+
+    if (tcsetattr(fd, TCSANOW, &tio) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    tcflush(fd, TCIOFLUSH);
+
+    return fd;
+}
+
+// Type a Lua call in the console of the board
+static void console_call(link_t *link, const char *function, const char *path, const char *flag) {
+    char command[PATH_MAX * 2 + 64];
+    int len;
+
+    len = snprintf(command, sizeof(command), "io.%s(\"", function);
+    for(;*path && (len < (int)sizeof(command) - 32);path++) {
+        if ((*path == '"') || (*path == '\\')) {
+            command[len++] = '\\';
+        }
+
+        command[len++] = *path;
+    }
+
+    len += snprintf(command + len, sizeof(command) - len, "\", %s)\r", flag);
+
+    link_write(link, (const uint8_t *)command, len);
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s -p port [-b baud] [-z] [-r] put local remote\n", name);
+    fprintf(stderr, "       %s -p port [-b baud] [-z] [-r] get remote local\n", name);
+    exit(1);
+}
+
+int main(int argc, char **argv) {
+    const char *port = NULL;
+    xfer_config_t config;
+    xfer_stats_t stats;
+    xfer_ops_t ops;
+    link_t link;
+    struct stat s;
+    int baud = 115200;
+    int deflate = 0;
+    int resume = 0;
+    int put;
+    int opt;
+    int res;
+
+    while ((opt = getopt(argc, argv, "p:b:zr")) != -1) {
+        switch (opt) {
+            case 'p': port = optarg; break;
+            case 'b': baud = atoi(optarg); break;
+            case 'z': deflate = 1; break;
+            case 'r': resume = 1; break;
+            default: usage(argv[0]);
+        }
+    }
+
+    if (!port || (argc - optind != 3)) {
+        usage(argv[0]);
+    }
+
+    if (strcmp(argv[optind], "put") == 0) {
+        put = 1;
+    } else if (strcmp(argv[optind], "get") == 0) {
+        put = 0;
+    } else {
+        usage(argv[0]);
+    }
+
+    if (!baud_rate(baud)) {
+        fprintf(stderr, "unsupported baud rate %d\n", baud);
+        return 1;
+    }
+
+    link.pos = 0;
+
+    if (put) {
+        link.f = fopen(argv[optind + 1], "r");
+    } else if (resume && (stat(argv[optind + 2], &s) == 0)) {
+        link.pos = s.st_size;
+        link.f = fopen(argv[optind + 2], "a");
+    } else {
+        link.f = fopen(argv[optind + 2], "w");
+    }
+
+    if (!link.f) {
+        fprintf(stderr, "%s\n", strerror(errno));
+        return 1;
+    }
+
+    link.fd = open_port(port, baud);
+    if (link.fd < 0) {
+        fprintf(stderr, "%s: %s\n", port, strerror(errno));
+        return 1;
+    }
+
+    ops.read = link_read;
+    ops.write = link_write;
+    ops.file_read = link_file_read;
+    ops.file_write = link_file_write;
+    ops.now = link_now;
+    ops.arg = &link;
+
+    xfer_config_default(&config);
+    config.deflate = deflate;
+    config.window = 16;
+
+    if (put) {
+        console_call(&link, "xreceive", argv[optind + 2], resume?"true":"false");
+        res = xfer_send(&ops, &config, &stats);
+    } else {
+        config.frame_size = XFER_MAX_FRAME;
+        console_call(&link, "xsend", argv[optind + 1], deflate?"true":"false");
+        res = xfer_receive(&ops, &config, link.pos, &stats);
+    }
+
+    fclose(link.f);
+    close(link.fd);
+
+    if (res != XFER_OK) {
+        fprintf(stderr, "transfer failed: %s\n", xfer_error(res));
+        return 1;
+    }
+
+    printf("%u bytes in %u msecs", stats.size - stats.offset, stats.elapsed);
+    if (stats.elapsed) {
+        printf(" (%u bytes/s)", (uint32_t)((uint64_t)(stats.size - stats.offset) * 1000 / stats.elapsed));
+    }
+    printf(", %u retransmissions\n", stats.retransmissions);
+
+    return 0;
+}